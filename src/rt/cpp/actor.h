@@ -0,0 +1,181 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../sched/mpmcq.h"
+#include "../sched/notification.h"
+#include "cown.h"
+#include "lambdabehaviour.h"
+
+#include <atomic>
+#include <utility>
+
+namespace verona::cpp
+{
+  using namespace verona::rt;
+
+  /**
+   * A cown holding a `T`, with a mailbox of `Msg`s that are handled in
+   * batches.
+   *
+   *   auto a = make_actor<State, Msg>(
+   *     [](State& s, Msg* m) { ...; delete m; }, state_args...);
+   *   a.send(new Msg(...));
+   *
+   * Sending a message does not create a behaviour: it is pushed on a lock-free
+   * queue, and only the send that finds the actor idle notifies it.  The
+   * actor then runs as a single behaviour, with write access to the state,
+   * that passes up to `BATCH` messages to the handler.  If more are waiting
+   * it runs again, so that other work on its core is not starved.  Messages
+   * from one sender are handled in the order they were sent.
+   *
+   * `Msg` is intrusive, and must have a `std::atomic<Msg*> next_in_queue`
+   * field, as for `MPMCQ`.  Messages are allocated with `new`, and the
+   * handler takes ownership of each.  Messages still queued when the actor is
+   * collected are deleted.
+   *
+   * The handle is reference counted, and the actor is collected once the
+   * handles are gone and its messages have been handled.
+   */
+  template<typename T, typename Msg>
+  class ActorCown
+  {
+  public:
+    /// Maximum number of messages handled by one run of the actor.
+    static constexpr size_t BATCH = 64;
+
+  private:
+    struct Actor
+    {
+      T state;
+      MPMCQ<Msg> queue;
+      /// Set while the actor is notified, so that other sends do not need to
+      /// notify it.
+      std::atomic<bool> armed{false};
+      /// Not counted, the actor is only run through this notification.
+      Notification* self = nullptr;
+
+      template<typename... Args>
+      Actor(Args&&... args) : state(std::forward<Args>(args)...)
+      {}
+
+      ~Actor()
+      {
+        while (!queue.is_empty())
+        {
+          auto m = queue.dequeue();
+          if (m != nullptr)
+            delete m;
+        }
+      }
+
+      void send(Msg* m)
+      {
+        queue.enqueue(m);
+        // Pairs with the fence in `drain`, so that either this send sees the
+        // actor disarmed, or the drain sees the message.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (
+          !armed.load(std::memory_order_relaxed) &&
+          !armed.exchange(true, std::memory_order_acq_rel))
+          self->notify();
+      }
+
+      template<typename F>
+      void drain(F& f)
+      {
+        armed.store(false, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        for (size_t i = 0; i < BATCH; i++)
+        {
+          auto m = queue.dequeue();
+          if (m == nullptr)
+            break;
+          f(state, m);
+        }
+
+        // Either the batch is full, or a send has not finished linking its
+        // message in.  The notification runs again after this one.
+        if (!queue.is_empty() && !armed.exchange(true))
+          self->notify();
+      }
+    };
+
+    using Cell = ActualCown<Actor>;
+
+    Cell* actor = nullptr;
+
+    explicit ActorCown(Cell* a) : actor(a) {}
+
+    template<typename F, typename... Args>
+    static ActorCown create(F&& f, Args&&... args)
+    {
+      Scheduler::stats().cown();
+      auto a = new Cell(std::forward<Args>(args)...);
+
+      Request requests[] = {Request::write(a)};
+      a->value.get().self = verona::rt::make_notification(
+        1, requests, [a, f = std::forward<F>(f)]() mutable {
+          a->value.get().drain(f);
+        });
+
+      // The notification holds its own reference to the cown.
+      Shared::release(a);
+      return ActorCown(a);
+    }
+
+    template<typename TT, typename M, typename F, typename... Args>
+    friend ActorCown<TT, M> make_actor(F&& f, Args&&... args);
+
+  public:
+    ActorCown() = default;
+
+    ActorCown(const ActorCown& other) : actor(other.actor)
+    {
+      if (actor != nullptr)
+        Shared::acquire(actor->value.get().self);
+    }
+
+    ActorCown(ActorCown&& other) : actor(other.actor)
+    {
+      other.actor = nullptr;
+    }
+
+    ActorCown& operator=(ActorCown other)
+    {
+      std::swap(actor, other.actor);
+      return *this;
+    }
+
+    /**
+     * The handle holds a reference to the notification, which holds the cown.
+     */
+    ~ActorCown()
+    {
+      if (actor != nullptr)
+        Shared::release(actor->value.get().self);
+    }
+
+    /**
+     * Queue `m` for the handler.  This takes ownership of `m`.  It can be
+     * called from any thread, including from the handler itself.
+     */
+    void send(Msg* m)
+    {
+      assert(actor != nullptr);
+      actor->value.get().send(m);
+    }
+  };
+
+  /**
+   * Create an actor whose state is constructed from `args`, and whose
+   * messages are passed to `f` as `f(T& state, Msg* m)`, see `ActorCown`.
+   */
+  template<typename T, typename Msg, typename F, typename... Args>
+  ActorCown<T, Msg> make_actor(F&& f, Args&&... args)
+  {
+    return ActorCown<T, Msg>::create(
+      std::forward<F>(f), std::forward<Args>(args)...);
+  }
+} // namespace verona::cpp
@@ -0,0 +1,196 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../region/region_api.h"
+#include "vobject.h"
+
+#include <array>
+#include <new>
+#include <utility>
+
+namespace verona::cpp
+{
+  using namespace verona::rt;
+
+  namespace arena_detail
+  {
+    /// Smallest and largest block sizes, as powers of two.
+    static constexpr size_t MIN_BITS = 4;
+    static constexpr size_t MAX_BITS = 40;
+
+    /**
+     * Raw blocks of memory are trivial objects in the region, with one
+     * descriptor per power of two size.  They have no fields to trace, and
+     * are freed with the region.
+     */
+    inline void trace_nothing(const Object*, ObjectStack&) {}
+
+    constexpr size_t block_size(size_t bits)
+    {
+      return snmalloc::bits::align_up(
+        (size_t{1} << bits) + sizeof(Object::Header), Object::ALIGNMENT);
+    }
+
+    template<size_t... Is>
+    constexpr std::array<Descriptor, sizeof...(Is)>
+    make_block_descs(std::index_sequence<Is...>)
+    {
+      return {{Descriptor{block_size(Is), trace_nothing, nullptr}...}};
+    }
+
+    inline constexpr auto block_descs =
+      make_block_descs(std::make_index_sequence<MAX_BITS + 1>());
+
+    inline void* alloc_block(size_t size)
+    {
+      assert(
+        Region::get_type(api::RegionContext::get_region()) ==
+        RegionType::Arena);
+
+      size_t bits = MIN_BITS;
+      while ((size_t{1} << bits) < size)
+        bits++;
+      assert(bits <= MAX_BITS);
+
+      // The object starts after its header, so this is the usable memory.
+      return api::create_object(&block_descs[bits]);
+    }
+  }
+
+  /**
+   * A standard allocator that allocates from the arena region that is
+   * currently open, see `arena`.  Deallocation does nothing, the memory is
+   * reclaimed when the region is released.
+   */
+  template<typename U>
+  class arena_allocator
+  {
+  public:
+    using value_type = U;
+
+    arena_allocator() = default;
+
+    template<typename W>
+    arena_allocator(const arena_allocator<W>&)
+    {}
+
+    U* allocate(size_t n)
+    {
+      return static_cast<U*>(arena_detail::alloc_block(n * sizeof(U)));
+    }
+
+    void deallocate(U*, size_t) {}
+
+    template<typename W>
+    bool operator==(const arena_allocator<W>&) const
+    {
+      return true;
+    }
+
+    template<typename W>
+    bool operator!=(const arena_allocator<W>&) const
+    {
+      return false;
+    }
+  };
+
+  /**
+   * A value of type `T` that lives, with everything it allocates, in an
+   * arena region owned by the cown holding it:
+   *
+   *   auto c = make_cown<arena<Book>>(args...);
+   *   when(c) << [](acquired_cown<arena<Book>> a) {
+   *     a->use([](Book& b) { b.orders.push_back(...); });
+   *   };
+   *
+   * `T` is constructed, and `use` runs, with the region open, so objects
+   * created with `new` from `V`, and containers using `arena_allocator`,
+   * are bump allocated next to the value.  Nothing is freed until the cown
+   * is collected, when the region is released in one sweep of its arenas,
+   * so this suits state that mostly grows.  Memory allocated elsewhere can
+   * be handed to the region without a copy, see `adopt`.
+   */
+  template<typename T>
+  class arena
+  {
+    struct Root : public V<Root>
+    {
+      alignas(T) unsigned char storage[sizeof(T)];
+
+      T& get()
+      {
+        return *std::launder(reinterpret_cast<T*>(storage));
+      }
+
+      ~Root()
+      {
+        get().~T();
+      }
+    };
+
+    Root* root;
+
+  public:
+    template<typename... Args>
+    arena(Args&&... args)
+    {
+      root = new (RegionType::Arena) Root;
+      api::UsingRegion r(root);
+      new (root->storage) T(std::forward<Args>(args)...);
+    }
+
+    arena(const arena&) = delete;
+
+    ~arena()
+    {
+      Region::release(root);
+    }
+
+    /**
+     * Run `f` on the value with the region open, so that it can allocate.
+     * This requires write access to the cown.
+     */
+    template<typename F>
+    decltype(auto) use(F&& f)
+    {
+      api::UsingRegion r(root);
+      return std::forward<F>(f)(root->get());
+    }
+
+    /**
+     * Make the region the owner of the `size` bytes at `buf`, which were
+     * allocated elsewhere, such as an I/O buffer from `io::buffer_pool`,
+     * without copying them.  They can be used for as long as the cown, and
+     * are given back to `pool` when it is collected.  This requires write
+     * access to the cown.
+     */
+    template<typename U>
+    U* adopt(U* buf, size_t size, BufferPool* pool)
+    {
+      RegionArena::adopt(root, (void*)buf, size, pool);
+      return buf;
+    }
+
+    /**
+     * Access the value without opening the region.  Nothing may be
+     * allocated through this.
+     * @{
+     */
+    T& get()
+    {
+      return root->get();
+    }
+
+    T* operator->()
+    {
+      return &root->get();
+    }
+
+    T& operator*()
+    {
+      return root->get();
+    }
+    /// @}
+  };
+} // namespace verona::cpp
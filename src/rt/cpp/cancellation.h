@@ -0,0 +1,71 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../sched/cancellation.h"
+
+#include <utility>
+
+namespace verona::cpp
+{
+  using namespace verona::rt;
+
+  /**
+   * A token for cancelling behaviours that have not started yet.
+   *
+   *   cancellation c;
+   *   when(a, b).cancel_with(c) << [](...) { ... };
+   *   ((when(a) << f) + (when(b) << g)).cancel_with(c);
+   *   ...
+   *   c.cancel();
+   *
+   * A cancelled behaviour still waits for its cowns, so it stays ordered with
+   * the other behaviours on them, but then releases them without running
+   * its closure.  The closure and its captures are destroyed as usual.
+   * Copies of this handle share the token.
+   */
+  class cancellation
+  {
+    Cancellation* c;
+
+  public:
+    /// A new token, which is not cancelled.
+    cancellation() : c(Cancellation::make()) {}
+
+    cancellation(const cancellation& other) : c(other.c)
+    {
+      c->acquire();
+    }
+
+    cancellation& operator=(cancellation other)
+    {
+      std::swap(c, other.c);
+      return *this;
+    }
+
+    ~cancellation()
+    {
+      c->release();
+    }
+
+    /**
+     * Skip the closures of the behaviours using this token that have not
+     * started.  It is not known which behaviours had already started.
+     */
+    void cancel()
+    {
+      c->cancel();
+    }
+
+    bool is_cancelled() const
+    {
+      return c->is_cancelled();
+    }
+
+    /// The runtime token, for attaching to behaviours.
+    Cancellation* get() const
+    {
+      return c;
+    }
+  };
+} // namespace verona::cpp
@@ -0,0 +1,162 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+/**
+ * Coroutines that wait for cowns with `co_await when(...)`.
+ *
+ * The rest of the runtime only requires C++17, so this is only available
+ * when the including translation unit is built with coroutine support, e.g.
+ * with `-std=c++20`.
+ */
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#  include "when.h"
+
+#  include <coroutine>
+#  include <exception>
+#  include <tuple>
+
+namespace verona::cpp
+{
+  /**
+   * Return type of a coroutine that runs behaviours.
+   *
+   * A `task` starts running when it is called, and runs on the calling
+   * thread until it first waits for cowns with
+   *
+   *   auto [a, b] = co_await when(cown_a, cown_b);
+   *
+   * This schedules a behaviour on the cowns, exactly as `when` with a
+   * closure would, and suspends the coroutine.  The behaviour resumes it with
+   * the cowns acquired, and the `acquired_cown`s it returns are valid until
+   * the coroutine next suspends or returns, when the behaviour completes and
+   * releases the cowns.  They must not be used after the next `co_await`.
+   *
+   * Nothing can wait for a task, so it must report its results through cowns
+   * or promises.  Exceptions escaping a task terminate the program, as they
+   * would from a behaviour.
+   *
+   * Coroutine frames are allocated like behaviours, so with
+   * `USE_BEHAVIOUR_POOL` they come from the scheduler thread's pool.
+   */
+  class task
+  {
+  public:
+    struct promise_type
+    {
+      task get_return_object() noexcept
+      {
+        return {};
+      }
+
+      std::suspend_never initial_suspend() noexcept
+      {
+        return {};
+      }
+
+      std::suspend_never final_suspend() noexcept
+      {
+        return {};
+      }
+
+      void return_void() noexcept {}
+
+      void unhandled_exception() noexcept
+      {
+        std::terminate();
+      }
+
+      static void* operator new(size_t size)
+      {
+#  ifdef USE_BEHAVIOUR_POOL
+        return BehaviourPool::alloc(size);
+#  else
+        return heap::alloc(size);
+#  endif
+      }
+
+      static void operator delete(void* p, size_t size)
+      {
+#  ifdef USE_BEHAVIOUR_POOL
+        snmalloc::UNUSED(size);
+        BehaviourPool::dealloc(p);
+#  else
+        heap::dealloc(p, size);
+#  endif
+      }
+    };
+  };
+
+  /**
+   * Awaiter for `co_await when(...)`, see `task`.
+   */
+  template<typename... Args>
+  class WhenAwaiter
+  {
+    template<typename A>
+    struct acquired;
+
+    template<typename T>
+    struct acquired<Access<T>>
+    {
+      using type = acquired_cown<T>;
+    };
+
+    template<typename T>
+    struct acquired<AccessBatch<T>>
+    {
+      using type = acquired_cown_span<T>;
+    };
+
+    PreWhen<Args...> pre;
+
+    /// Set by the behaviour before it resumes the coroutine.
+    std::tuple<typename acquired<Args>::type*...> cowns;
+
+  public:
+    WhenAwaiter(PreWhen<Args...>&& pre) : pre(std::move(pre)) {}
+
+    bool await_ready() noexcept
+    {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+      // The behaviour may resume the coroutine on another thread before this
+      // returns, so nothing here may touch the awaiter after scheduling.
+      std::move(pre) << [this, h](typename acquired<Args>::type... a) {
+        cowns = std::make_tuple(&a...);
+        h.resume();
+      };
+    }
+
+    decltype(auto) await_resume() noexcept
+    {
+      if constexpr (sizeof...(Args) == 1)
+        return *std::get<0>(cowns);
+      else
+        return std::apply(
+          [](auto*... a) { return std::tie(*a...); }, cowns);
+    }
+  };
+
+  template<typename... Args>
+  WhenAwaiter<Args...> operator co_await(PreWhen<Args...>&& pre)
+  {
+    return {std::move(pre)};
+  }
+
+  /**
+   * Allows `co_await when(...).on(core)` and the other modifiers, which
+   * return the `PreWhen` by reference.
+   */
+  template<typename... Args>
+  WhenAwaiter<Args...> operator co_await(PreWhen<Args...>& pre)
+  {
+    return {std::move(pre)};
+  }
+} // namespace verona::cpp
+
+#endif
@@ -3,6 +3,8 @@
 #pragma once
 
 #include <functional>
+#include <memory>
+#include <new>
 #include <tuple>
 #include <utility>
 #include <verona.h>
@@ -34,6 +36,281 @@ namespace verona::cpp
   template<typename T>
   class cown_ptr;
 
+  /**
+   * Specialise this to `std::true_type` to allow cowns of type T to be read
+   * without acquiring them, see `when_optimistic`.  Behaviours that write
+   * such a cown then keep a version count on it, at the cost of two stores
+   * each.  `acquired_cown::release_early` is not supported for such cowns.
+   */
+  template<typename T>
+  struct optimistic_reads : std::false_type
+  {};
+
+  /**
+   * Version count of a cown for optimistic reads, which is odd while a
+   * behaviour that writes the cown is running.  This is a sequence lock with
+   * a single writer, as writers have exclusive access to the cown.
+   */
+  class OptimisticVersion
+  {
+    std::atomic<uint64_t> version{0};
+
+  public:
+    /// Start of a write.  Does nothing if a write has already started, for
+    /// a cown that occurs more than once in a behaviour.
+    void begin_write()
+    {
+      auto v = version.load(std::memory_order_relaxed);
+      if ((v % 2) == 1)
+        return;
+      version.store(v + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void end_write()
+    {
+      auto v = version.load(std::memory_order_relaxed);
+      if ((v % 2) == 0)
+        return;
+      version.store(v + 1, std::memory_order_release);
+    }
+
+    uint64_t begin_read()
+    {
+      return version.load(std::memory_order_acquire);
+    }
+
+    /// Returns true if no write overlapped the read started by
+    /// `begin_read`, which returned `v`.
+    bool validate(uint64_t v)
+    {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return ((v % 2) == 0) && (version.load(std::memory_order_relaxed) == v);
+    }
+  };
+
+  /**
+   * Used in place of `OptimisticVersion` for the cowns of other types.
+   */
+  class NoOptimisticVersion
+  {
+  public:
+    void begin_write() {}
+
+    void end_write() {}
+  };
+
+  /**
+   * Specialise this to `std::true_type` to allow cowns of type T to be read
+   * from a snapshot, see `cown_ptr::read_snapshot`.  Each behaviour that
+   * writes such a cown then copies its value into a new snapshot when it
+   * finishes, at the cost of an allocation and a copy of T.  T must be copy
+   * constructible.
+   * `acquired_cown::release_early` is not supported for such cowns.
+   */
+  template<typename T>
+  struct snapshot_reads : std::false_type
+  {};
+
+  /**
+   * True if behaviours that write cowns of type T must call `begin_write` and
+   * `end_write` on them.
+   */
+  template<typename T>
+  struct tracks_writes
+  : std::bool_constant<optimistic_reads<T>::value || snapshot_reads<T>::value>
+  {};
+
+  /**
+   * The value of a cown as the last behaviour that wrote it left it, for
+   * readers that can use a slightly stale value without waiting for the
+   * cown.  Snapshots are immutable and shared, and replaced, not changed,
+   * so a reader holds on to the one it took for as long as it likes.
+   *
+   * Only the behaviour holding the cown publishes, so there is one writer
+   * at a time.  Without `std::atomic<std::shared_ptr>`, the current snapshot
+   * is reached through a raw pointer, and readers count themselves in while
+   * they copy it.  A replaced pointer is retired, and freed by a later
+   * `publish` that sees no readers, as any reader that could still have it
+   * counted itself in before it was replaced.
+   */
+  template<typename T>
+  class CownSnapshot
+  {
+#ifdef __cpp_lib_atomic_shared_ptr
+    std::atomic<std::shared_ptr<const T>> snapshot;
+
+  public:
+    void publish(const T& value)
+    {
+      snapshot.store(
+        std::make_shared<const T>(value), std::memory_order_release);
+    }
+
+    std::shared_ptr<const T> load() const
+    {
+      return snapshot.load(std::memory_order_acquire);
+    }
+#else
+    struct Holder
+    {
+      std::shared_ptr<const T> value;
+      Holder* next = nullptr;
+    };
+
+    std::atomic<Holder*> current{nullptr};
+
+    /// Readers between counting themselves in and copying `current`.
+    mutable std::atomic<size_t> readers{0};
+
+    /// Replaced holders not yet freed.  Only accessed by the writer.
+    Holder* retired = nullptr;
+
+    static void free_all(Holder* h)
+    {
+      while (h != nullptr)
+        delete std::exchange(h, h->next);
+    }
+
+  public:
+    CownSnapshot() = default;
+    CownSnapshot(const CownSnapshot&) = delete;
+    CownSnapshot& operator=(const CownSnapshot&) = delete;
+
+    ~CownSnapshot()
+    {
+      free_all(retired);
+      delete current.load(std::memory_order_relaxed);
+    }
+
+    void publish(const T& value)
+    {
+      auto h = new Holder{std::make_shared<const T>(value)};
+      auto old = current.exchange(h, std::memory_order_seq_cst);
+      if (old != nullptr)
+      {
+        old->next = retired;
+        retired = old;
+      }
+
+      if (readers.load(std::memory_order_seq_cst) == 0)
+        free_all(std::exchange(retired, nullptr));
+    }
+
+    std::shared_ptr<const T> load() const
+    {
+      readers.fetch_add(1, std::memory_order_seq_cst);
+      auto result = current.load(std::memory_order_seq_cst)->value;
+      readers.fetch_sub(1, std::memory_order_release);
+      return result;
+    }
+#endif
+  };
+
+  /**
+   * Used in place of `CownSnapshot` for the cowns of other types.
+   */
+  class NoCownSnapshot
+  {};
+
+  /**
+   * Specialise this to `std::true_type` to keep a cown's `T` off the cache
+   * lines of its reference counts and scheduling queue.  Readers of such a
+   * cown update its read count, and writers of it are enqueued, without
+   * invalidating the lines that behaviours use for `T`.  This costs up to
+   * two cache lines per cown.
+   */
+  template<typename T>
+  struct padded_cown : std::false_type
+  {};
+
+  /**
+   * Space between the runtime's fields of a cown and a padded `T`, see
+   * `padded_cown`.  The object is not allocated on a cache line boundary,
+   * so this is a full line, rather than an alignment.
+   */
+  template<bool padded>
+  struct CownPadding
+  {};
+
+  template<>
+  struct CownPadding<true>
+  {
+    char padding[64];
+  };
+
+  /**
+   * Specialise this to `std::true_type` for cowns of type T that are only
+   * ever written, such as the many idle cowns of a large store.  Such a cown
+   * has no reader count and no waiting writer, so is three words smaller,
+   * and `read` does not compile for it.
+   */
+  template<typename T>
+  struct write_only_cown : std::false_type
+  {};
+
+  /**
+   * Specialise this to `std::integral_constant<size_t, N>` to prefetch the
+   * first N cache lines of a cown of type T, rather than
+   * `Cown::DEFAULT_PREFETCH_LINES`, when a behaviour on it is about to run,
+   * for instance for a large T whose hot fields are not at its start.  At
+   * most 255, and 0 turns prefetching off for such cowns.
+   */
+  template<typename T>
+  struct prefetch_cown_lines
+  : std::integral_constant<size_t, Cown::DEFAULT_PREFETCH_LINES>
+  {};
+
+  /**
+   * Storage for the contents of a cown.  Cowns are only aligned to
+   * `Object::ALIGNMENT`, so a `T` that needs more is placed at the first
+   * suitably aligned address of a larger buffer.
+   */
+  template<typename T, bool over_aligned = (alignof(T) > Object::ALIGNMENT)>
+  class CownValue
+  {
+    T value;
+
+  public:
+    template<typename... Args>
+    CownValue(Args&&... ts) : value(std::forward<Args>(ts)...)
+    {}
+
+    T& get()
+    {
+      return value;
+    }
+  };
+
+  template<typename T>
+  class CownValue<T, true>
+  {
+    alignas(Object::ALIGNMENT)
+      std::byte storage[sizeof(T) + alignof(T) - Object::ALIGNMENT];
+
+    void* address()
+    {
+      return snmalloc::pointer_align_up<alignof(T)>(storage);
+    }
+
+  public:
+    template<typename... Args>
+    CownValue(Args&&... ts)
+    {
+      new (address()) T(std::forward<Args>(ts)...);
+    }
+
+    ~CownValue()
+    {
+      get().~T();
+    }
+
+    T& get()
+    {
+      return *std::launder(static_cast<T*>(address()));
+    }
+  };
+
   /**
    * Internal Verona runtime cown for the type T.
    *
@@ -41,14 +318,54 @@ namespace verona::cpp
    * through the correct usage of cown_ptr and when.
    */
   template<typename T>
-  class ActualCown : public VCown<ActualCown<T>>
+  class ActualCown
+  : public VCown<ActualCown<T>, write_only_cown<T>::value>,
+    public std::conditional_t<
+      optimistic_reads<T>::value,
+      OptimisticVersion,
+      NoOptimisticVersion>,
+    public std::conditional_t<
+      snapshot_reads<T>::value,
+      CownSnapshot<T>,
+      NoCownSnapshot>,
+    public CownPadding<padded_cown<T>::value>
   {
   private:
-    T value;
+    using Version = std::conditional_t<
+      optimistic_reads<T>::value,
+      OptimisticVersion,
+      NoOptimisticVersion>;
+
+    CownValue<T> value;
 
     template<typename... Args>
     ActualCown(Args&&... ts) : value(std::forward<Args>(ts)...)
-    {}
+    {
+      static_assert(prefetch_cown_lines<T>::value <= UINT8_MAX);
+      if constexpr (
+        prefetch_cown_lines<T>::value != Cown::DEFAULT_PREFETCH_LINES)
+        this->set_prefetch_lines(prefetch_cown_lines<T>::value);
+      if constexpr (snapshot_reads<T>::value)
+        this->publish(value.get());
+    }
+
+  public:
+    /// Start of a behaviour that writes this cown.
+    void begin_write()
+    {
+      Version::begin_write();
+    }
+
+    /// End of a behaviour that writes this cown, which publishes a snapshot
+    /// of it, if enabled.
+    void end_write()
+    {
+      Version::end_write();
+      if constexpr (snapshot_reads<T>::value)
+        this->publish(value.get());
+    }
+
+  private:
 
     template<typename TT>
     friend class acquired_cown;
@@ -58,6 +375,9 @@ namespace verona::cpp
 
     template<typename TT, typename... Args>
     friend cown_ptr<TT> make_cown(Args&&... ts);
+
+    template<typename TT, typename Msg>
+    friend class ActorCown;
   };
 
   /**
@@ -195,6 +515,9 @@ namespace verona::cpp
     template<typename TT>
     friend class AccessBatch;
 
+    template<typename TT>
+    friend struct cown_set;
+
     /**
      * Internal Verona runtime cown for this type.
      */
@@ -226,7 +549,7 @@ namespace verona::cpp
     {
       allocated_cown = other.allocated_cown;
       if (allocated_cown != nullptr)
-        verona::rt::Cown::acquire(allocated_cown);
+        DeferredRelease::acquire(allocated_cown);
     }
 
     /**
@@ -237,7 +560,7 @@ namespace verona::cpp
       clear();
       allocated_cown = other.allocated_cown;
       if (allocated_cown != nullptr)
-        verona::rt::Cown::acquire(allocated_cown);
+        DeferredRelease::acquire(allocated_cown);
       return *this;
     }
 
@@ -296,18 +619,128 @@ namespace verona::cpp
 
     /**
      * Sets the cown_ptr to nullptr, and decrements the reference count
-     * if it was not already nullptr.
+     * if it was not already nullptr.  Inside a behaviour the decrement is
+     * deferred, see `DeferredRelease`.
      */
     void clear()
     {
       // Condition to handle moved cown ptrs.
       if (allocated_cown != nullptr)
       {
-        verona::rt::Cown::release(allocated_cown);
+        DeferredRelease::release(allocated_cown);
         allocated_cown = nullptr;
       }
     }
 
+    /**
+     * Override the order in which behaviours acquire this cown, see
+     * `Cown::set_order_key`.
+     */
+    void set_order_key(uint64_t key)
+    {
+      assert(allocated_cown != nullptr);
+      allocated_cown->set_order_key(key);
+    }
+
+    /**
+     * Bind this cown to `core` in share-nothing mode, see
+     * `Cown::set_home_core`.
+     */
+    void set_home_core(Core* core)
+    {
+      assert(allocated_cown != nullptr);
+      allocated_cown->set_home_core(core);
+    }
+
+    /**
+     * Put this cown in scheduling group `group`, see `Cown::set_group`.
+     */
+    void set_group(size_t group)
+    {
+      assert(allocated_cown != nullptr);
+      allocated_cown->set_group(group);
+    }
+
+    /**
+     * Move the pages that lie entirely within this cown to NUMA node `node`,
+     * see `numa::bind`.  This only helps cowns of a page or more, such as
+     * those with large inline state.
+     */
+    void set_numa_node(size_t node)
+    {
+      assert(allocated_cown != nullptr);
+      using A = std::remove_pointer_t<decltype(allocated_cown)>;
+      numa::bind(allocated_cown->real_start(), vsizeof<A>, node);
+    }
+
+    /**
+     * Use a scalable reader count for this cown, see
+     * `Cown::enable_scalable_readers`.
+     */
+    void enable_scalable_readers()
+    {
+      static_assert(
+        !write_only_cown<std::remove_const_t<T>>::value,
+        "Write only cowns have no readers");
+      assert(allocated_cown != nullptr);
+      allocated_cown->enable_scalable_readers();
+    }
+
+#ifdef USE_QUEUE_DEPTH
+    /**
+     * Approximate number of behaviours queued on, or running on, this cown,
+     * see `Cown::queue_depth`.
+     */
+    size_t queue_depth() const
+    {
+      assert(allocated_cown != nullptr);
+      return allocated_cown->queue_depth();
+    }
+#endif
+
+    /**
+     * Run `f` on the value of the cown without acquiring it.  Returns false
+     * if a behaviour was queued on the cown, or wrote it while `f` ran, in
+     * which case `f` may have seen an inconsistent value, and anything it
+     * computed must be discarded.  So `f` must only write to state owned by
+     * the caller, and must not follow pointers it reads from the value.
+     *
+     * Requires `optimistic_reads<T>`.  See `when_optimistic` for a version
+     * that falls back to a read behaviour.
+     */
+    template<typename F>
+    bool try_read_optimistic(F&& f) const
+    {
+      static_assert(
+        optimistic_reads<std::remove_const_t<T>>::value,
+        "Optimistic reads are not enabled for this type");
+      assert(allocated_cown != nullptr);
+
+      auto v = allocated_cown->begin_read();
+      if (((v % 2) == 1) || !allocated_cown->is_idle())
+        return false;
+
+      const std::remove_const_t<T>& value = allocated_cown->value.get();
+      std::forward<F>(f)(value);
+
+      return allocated_cown->validate(v);
+    }
+
+    /**
+     * The value of the cown when the last behaviour that wrote it finished,
+     * without waiting for the cown, and without waiting for, or holding up,
+     * the behaviours queued on it.  A behaviour running now may have changed
+     * the cown since.  Requires `snapshot_reads<T>`.
+     */
+    std::shared_ptr<const std::remove_const_t<T>> read_snapshot() const
+    {
+      static_assert(
+        snapshot_reads<std::remove_const_t<T>>::value,
+        "Snapshot reads are not enabled for this type");
+      assert(allocated_cown != nullptr);
+      return allocated_cown->load();
+    }
+
     weak get_weak()
     {
       if (allocated_cown != nullptr)
@@ -333,6 +766,18 @@ namespace verona::cpp
 
     template<typename F, typename... Args2>
     friend class When;
+
+    friend struct Bulk;
+
+    friend struct Fusion;
+
+    friend class notification;
+
+    template<typename, typename, typename>
+    friend class sharded_cown;
+
+    template<typename, typename>
+    friend class cown_group;
   };
 
   /* A cown_ptr<const T> is used to mark that the cown is being accessed as
@@ -345,6 +790,9 @@ namespace verona::cpp
   template<typename T>
   class cown_ptr<const T> : public cown_ptr<T>
   {
+    static_assert(
+      !write_only_cown<T>::value, "Cannot read a cown of a write only type");
+
   public:
     cown_ptr(const cown_ptr<T>& other) : cown_ptr<T>(other){};
   };
@@ -372,6 +820,48 @@ namespace verona::cpp
     return cown_ptr<T>(new ActualCown<T>(std::forward<Args>(ts)...));
   }
 
+  /**
+   * Tag for `make_cown` to create a cown whose readers are counted with a
+   * scalable count, for read-mostly cowns shared by many cores:
+   *
+   *   auto c = make_cown<T>(ScalableReaders{}, args...);
+   */
+  struct ScalableReaders
+  {};
+
+  template<typename T, typename... Args>
+  cown_ptr<T> make_cown(ScalableReaders, Args&&... ts)
+  {
+    auto c = make_cown<T>(std::forward<Args>(ts)...);
+    c.enable_scalable_readers();
+    return c;
+  }
+
+  /**
+   * Tag for `make_cown` to create a cown for `core`, rather than for the
+   * core it is created on:
+   *
+   *   auto c = make_cown<T>(Placement{core}, args...);
+   *
+   * `core` becomes the cown's home core, see `cown_ptr::set_home_core`, and
+   * the cown is moved to the NUMA node of `core`, see
+   * `cown_ptr::set_numa_node`.  The arenas of a region the cown owns can be
+   * placed with `RegionArena::set_numa_node`.
+   */
+  struct Placement
+  {
+    Core* core;
+  };
+
+  template<typename T, typename... Args>
+  cown_ptr<T> make_cown(Placement placement, Args&&... ts)
+  {
+    auto c = make_cown<T>(std::forward<Args>(ts)...);
+    c.set_home_core(placement.core);
+    c.set_numa_node(placement.core->numa_node);
+    return c;
+  }
+
   template<typename T>
   bool operator==(std::nullptr_t, const cown_ptr<T>& rhs)
   {
@@ -410,6 +900,20 @@ namespace verona::cpp
     template<typename T2>
     friend class AccessBatch;
 
+    friend struct Bulk;
+
+    friend struct Fusion;
+
+    friend class notification;
+
+    /// Needed to build a read-only one in `downgrade`.
+    template<typename T2>
+    friend class acquired_cown;
+
+    /// Needed to reach the members of a group held through its parent.
+    template<typename, typename>
+    friend class cown_group;
+
   private:
     /// Underlying cown that has been acquired.
     /// Runtime is actually holding this reference count.
@@ -431,9 +935,9 @@ namespace verona::cpp
     T& get_ref() const
     {
       if constexpr (std::is_const<T>())
-        return const_cast<T&>(origin_cown.value);
+        return const_cast<T&>(origin_cown.value.get());
       else
-        return origin_cown.value;
+        return origin_cown.value.get();
     }
 
     T& operator*()
@@ -451,6 +955,35 @@ namespace verona::cpp
       return get_ref();
     }
 
+    /**
+     * Release the cown before the behaviour ends, so that the next behaviour
+     * waiting on it can start while the rest of the body runs.  The
+     * acquired_cown must not be used afterwards.
+     */
+    void release_early()
+    {
+      static_assert(
+        !optimistic_reads<std::remove_const_t<T>>::value,
+        "Early release is not supported with optimistic reads");
+      static_assert(
+        !snapshot_reads<std::remove_const_t<T>>::value,
+        "Early release is not supported with snapshot reads");
+      verona::rt::Behaviour::release_early(&origin_cown);
+    }
+
+    /**
+     * Give up write access to the cown, but keep read access until the
+     * behaviour ends.  Behaviours waiting to read the cown can then run
+     * alongside the rest of the body.  The returned acquired_cown is used for
+     * the remaining reads, and this one must not be used afterwards.
+     */
+    acquired_cown<const T> downgrade()
+    {
+      static_assert(!std::is_const_v<T>, "Already read-only");
+      verona::rt::Behaviour::downgrade(&origin_cown);
+      return acquired_cown<const T>(origin_cown);
+    }
+
     /**
      * Deleted to prevent accidental copying or
      * moving.  The lifetime is tied to the `when`,
@@ -10,12 +10,17 @@ namespace verona::cpp
    *
    * The default constructor takes an array of cown_ptr and heap allocates
    * another array to hold those pointers after incrementing the reference
-   * count. Alternatively, the constructor takes a template argument to move
-   * the cown_ptr array and avoid the allocation.
+   * count. Alternatively, the constructor takes a template argument to take
+   * over a heap allocated cown_ptr array and avoid the allocation.
    * In both cases cown_array has ownership over the cown_ptr
    *
    * The destructor calls the destructor of each cown_ptr and frees the
    * allocated array.
+   *
+   * `borrow` instead makes a span that refers to the caller's array, without
+   * copying it or touching the reference counts.  A borrowed span, and its
+   * copies, must not outlive the array, but a `when` only needs the cowns
+   * until it has been scheduled, so they can be borrowed for the call.
    */
   template<typename T>
   struct cown_array
@@ -23,6 +28,9 @@ namespace verona::cpp
     cown_ptr<T>* array;
     size_t length;
 
+    /// False for a borrowed span, which does not own the array.
+    bool owning = true;
+
     void constr_helper(cown_ptr<T>* arr)
     {
       array = reinterpret_cast<cown_ptr<T>*>(
@@ -32,6 +40,19 @@ namespace verona::cpp
         new (&array[i]) cown_ptr<T>(arr[i]);
     }
 
+    /**
+     * Free the array without releasing the cowns, once their references have
+     * been moved elsewhere.
+     */
+    void forget()
+    {
+      assert(owning);
+      if (array)
+        heap::dealloc(array);
+      array = nullptr;
+      length = 0;
+    }
+
     template<bool should_move = false>
     cown_array(cown_ptr<T>* array_, size_t length_) : length(length_)
     {
@@ -39,17 +60,39 @@ namespace verona::cpp
       {
         constr_helper(array_);
       }
+      else
+      {
+        // The array must have been allocated with heap::alloc.
+        array = array_;
+      }
     }
 
-    cown_array(const cown_array& o)
+    /**
+     * Make a span over `array_` that does not own it.
+     */
+    static cown_array borrow(cown_ptr<T>* array_, size_t length_)
     {
-      length = o.length;
-      constr_helper(o.array);
+      return cown_array(array_, length_, false);
+    }
+
+    cown_array(const cown_array& o) : length(o.length), owning(o.owning)
+    {
+      if (owning)
+        constr_helper(o.array);
+      else
+        array = o.array;
+    }
+
+    cown_array(cown_array&& old)
+    : array(old.array), length(old.length), owning(old.owning)
+    {
+      old.array = nullptr;
+      old.length = 0;
     }
 
     ~cown_array()
     {
-      if (array)
+      if (array && owning)
       {
         for (size_t i = 0; i < length; i++)
           array[i].~cown_ptr<T>();
@@ -58,11 +101,13 @@ namespace verona::cpp
       }
     }
 
-    // Not needed at the moment. Marked as delete to avoid bugs
-    // Could be implemented if necessary
-    cown_array(cown_array&& old) = delete;
     cown_array& operator=(cown_array&&) = delete;
     cown_array& operator=(const cown_array&) = delete;
+
+  private:
+    cown_array(cown_ptr<T>* array_, size_t length_, bool owning_)
+    : array(array_), length(length_), owning(owning_)
+    {}
   };
 
   /* A cown_array<const T> is used to mark that the cown is being accessed as
@@ -75,14 +120,19 @@ namespace verona::cpp
   template<typename T>
   class cown_array<const T> : public cown_array<T>
   {
+    static_assert(
+      !write_only_cown<T>::value, "Cannot read a cown of a write only type");
+
   public:
     cown_array(const cown_array<T>& other) : cown_array<T>(other){};
+
+    cown_array(cown_array<T>&& other) : cown_array<T>(std::move(other)){};
   };
 
   template<typename T>
   cown_array<const T> read(cown_array<T> cown)
   {
-    Logging::cout() << "Read returning const array ptr" << Logging::endl;
+    VERONA_LOG << "Read returning const array ptr" << Logging::endl;
     return cown;
   }
 }
@@ -0,0 +1,110 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "when.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace verona::cpp
+{
+  /**
+   * A group of member cowns, such as the rows of a table, covered by a
+   * parent cown, so that a behaviour on the whole group acquires one cown
+   * rather than every member.
+   *
+   *   auto table = make_cown_group<Table, Row>(rows);
+   *   when(table.intent(), table.member(i)) <<
+   *     [](acquired_cown<const Table>, acquired_cown<Row> row) { ... };
+   *   when(table.whole()) << [table](acquired_cown<Table> t) {
+   *     for (size_t i = 0; i < table.size(); i++)
+   *       table.held(t, i)->...;
+   *   };
+   *
+   * This follows intention locks: a behaviour on some members also reads
+   * the parent, its `intent`, and a behaviour on the whole group writes the
+   * parent, its `whole`.  Behaviours on different members only share the
+   * read of the parent, so they still run concurrently, while a behaviour
+   * on the whole group waits for those before it, and is waited for by
+   * those after it, and can then reach every member with `held`.  The
+   * parent is made with `ScalableReaders`, so that the readers of a busy
+   * group do not all count on one cache line.
+   *
+   * Every behaviour on a member must acquire the `intent` as well, or it can
+   * run alongside a behaviour on the whole group.  A behaviour that only
+   * reads the whole group must still acquire `whole`, as members are written
+   * while the parent is read.  Members that track their writes, see
+   * `tracks_writes`, are not supported, as writes through `held` are not
+   * tracked.
+   *
+   * Copies of this handle share the members.
+   */
+  template<typename P, typename C>
+  class cown_group
+  {
+    static_assert(
+      !tracks_writes<C>::value,
+      "Members of a cown_group cannot track their writes");
+
+    cown_ptr<P> parent;
+    std::shared_ptr<const std::vector<cown_ptr<C>>> members;
+
+  public:
+    cown_group(cown_ptr<P> parent_, std::vector<cown_ptr<C>> members_)
+    : parent(std::move(parent_)),
+      members(
+        std::make_shared<const std::vector<cown_ptr<C>>>(std::move(members_)))
+    {}
+
+    size_t size() const
+    {
+      return members->size();
+    }
+
+    /// The parent, to acquire for a behaviour on the whole group.
+    cown_ptr<P> whole() const
+    {
+      return parent;
+    }
+
+    /// The parent, to acquire alongside the members a behaviour is on.
+    cown_ptr<const P> intent() const
+    {
+      return read(parent);
+    }
+
+    /// The member at `index`, which must be acquired with the `intent`.
+    cown_ptr<C> member(size_t index) const
+    {
+      return (*members)[index];
+    }
+
+    /**
+     * Access to the member at `index`, in a behaviour that has acquired the
+     * `whole` group as `w`.  The result must not outlive that behaviour.
+     */
+    acquired_cown<C> held(acquired_cown<P>& w, size_t index) const
+    {
+      assert(&w.origin_cown == parent.allocated_cown);
+      snmalloc::UNUSED(w);
+      return acquired_cown<C>(*(*members)[index].allocated_cown);
+    }
+  };
+
+  /**
+   * Create a `cown_group` with a parent made from `p`, and `count` members,
+   * each starting as `C(ts...)`.
+   */
+  template<typename P, typename C, typename... Args>
+  cown_group<P, C> make_cown_group(P p, size_t count, Args... ts)
+  {
+    std::vector<cown_ptr<C>> members;
+    members.reserve(count);
+    for (size_t i = 0; i < count; i++)
+      members.push_back(make_cown<C>(ts...));
+    return cown_group<P, C>(
+      make_cown<P>(ScalableReaders{}, std::move(p)), std::move(members));
+  }
+} // namespace verona::cpp
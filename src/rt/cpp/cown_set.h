@@ -0,0 +1,68 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../sched/behaviourcore.h"
+#include "cown_array.h"
+
+#include <algorithm>
+
+namespace verona::cpp
+{
+  /**
+   * A cown_array whose cowns are sorted into the order the runtime acquires
+   * them in, with duplicates removed.
+   *
+   * The sorting happens once, on construction.  A `when` over a single
+   * cown_set is scheduled without sorting or duplicate elimination, so it is
+   * worth building one for a set of cowns that is used by many behaviours.
+   *
+   * The closure receives the cowns in the order of the set, which is not the
+   * order they were given in, and each cown only once.
+   */
+  template<typename T>
+  struct cown_set : public cown_array<T>
+  {
+    cown_set(cown_ptr<T>* array_, size_t length_)
+    : cown_array<T>(array_, length_)
+    {
+      auto first = this->array;
+      auto last = first + this->length;
+
+      auto less = [](const cown_ptr<T>& a, const cown_ptr<T>& b) {
+        return verona::rt::BehaviourCore::cown_less(
+          a.allocated_cown, b.allocated_cown);
+      };
+      auto same = [](const cown_ptr<T>& a, const cown_ptr<T>& b) {
+        return a.allocated_cown == b.allocated_cown;
+      };
+
+      std::sort(first, last, less);
+      auto end = std::unique(first, last, same);
+
+      // Release the duplicates left beyond the new end.
+      for (auto it = end; it != last; it++)
+        it->~cown_ptr<T>();
+
+      this->length = static_cast<size_t>(end - first);
+    }
+  };
+
+  /* A cown_set<const T> is used to mark that all the cowns are being accessed
+   * as read-only, as for cown_array<const T>.  Construction from a
+   * cown_set<T> preserves the order.
+   */
+  template<typename T>
+  class cown_set<const T> : public cown_array<const T>
+  {
+  public:
+    cown_set(const cown_set<T>& other) : cown_array<const T>(other){};
+  };
+
+  template<typename T>
+  cown_set<const T> read(cown_set<T> cown)
+  {
+    VERONA_LOG << "Read returning const set" << Logging::endl;
+    return cown;
+  }
+}
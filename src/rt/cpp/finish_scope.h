@@ -0,0 +1,105 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <utility>
+#include <verona.h>
+
+namespace verona::cpp
+{
+  using namespace verona::rt;
+
+  /**
+   * Waits for all the behaviours spawned inside it, however indirectly, to
+   * finish, without waiting for the whole runtime to become quiescent.
+   *
+   *   finish_scope job;
+   *   job.run([&]() {
+   *     for (auto& part : parts)
+   *       when(part) << [](acquired_cown<Part> p) { ... };
+   *   });
+   *   job.then([]() { next_job(); });
+   *
+   * Every behaviour created inside `run`, and every behaviour that they
+   * create in turn, joins the scope, as do closures with no cowns, such as
+   * `task_group` tasks.  This is inherited through `when` by a count on the
+   * scope, so nothing goes through the cown queues.  A scope created inside
+   * another is part of the outer one until its continuation has run.
+   *
+   * Work with no cowns is counted until its closure returns, and behaviours
+   * until their closures are destroyed and their cowns released.
+   * Notifications, and work scheduled from other threads, do not join.
+   * Copies of this handle share the scope.
+   */
+  class finish_scope
+  {
+    FinishScope* s;
+
+  public:
+    /// A new scope, with no work, inside the current scope if any.
+    finish_scope() : s(FinishScope::make()) {}
+
+    finish_scope(const finish_scope& other) : s(other.s)
+    {
+      s->acquire();
+    }
+
+    finish_scope& operator=(finish_scope other)
+    {
+      std::swap(s, other.s);
+      return *this;
+    }
+
+    ~finish_scope()
+    {
+      s->release();
+    }
+
+    /**
+     * Run `f` on this thread, so that the work it spawns joins this scope.
+     * This can be called from inside or outside a behaviour, and more than
+     * once, until `then` is called.
+     */
+    template<typename F>
+    void run(F&& f) const
+    {
+      FinishScope::Enter in_scope(s);
+      std::forward<F>(f)();
+    }
+
+    /**
+     * Run `f` once all the work that has joined this scope has finished.
+     * This must be called once, after the last `run`.
+     */
+    template<typename F>
+    void then(F&& f)
+    {
+      auto scope = s;
+      scope->acquire();
+      s->close(Closure::make([f = std::forward<F>(f), scope](Work*) mutable {
+        {
+          // Work spawned by the continuation is part of the enclosing scope.
+          FinishScope::Enter in_scope(scope->get_parent());
+          f();
+        }
+        scope->leave_parent();
+        scope->release();
+        return true;
+      }));
+    }
+
+    /**
+     * A promise that is fulfilled once all the work that has joined this
+     * scope has finished, for use with `when`.  Either this or `then` must
+     * be called once.
+     */
+    Promise<bool>::PromiseR done()
+    {
+      auto pp = Promise<bool>::create_promise();
+      then([w = std::move(pp.second)]() mutable {
+        Promise<bool>::fulfill(std::move(w), true);
+      });
+      return std::move(pp.first);
+    }
+  };
+} // namespace verona::cpp
@@ -0,0 +1,209 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "cown.h"
+
+#include <algorithm>
+#include <atomic>
+#include <verona.h>
+
+namespace verona::cpp
+{
+  using namespace verona::rt;
+
+  /**
+   * Per thread buffers of closures for `when_fused`.
+   *
+   * Closures for the same cown are appended to one buffer, and each buffer
+   * becomes a single behaviour that runs its closures in order.  All the
+   * buffers of a thread are scheduled together as one atomic batch, so that
+   * fusing does not reorder closures that are causally related.  This
+   * happens when a buffer fills up, when the thread needs a buffer for
+   * another cown and has none free, before the thread schedules any other
+   * behaviour with `when`, and when the behaviour running on the thread
+   * returns.
+   */
+  struct Fusion
+  {
+    /// Maximum number of cowns a thread buffers closures for at once.
+    static constexpr size_t BUFFERS = 8;
+
+    struct Node
+    {
+      Node* next;
+      /// Runs the closure on the given `ActualCown`, and frees the node.
+      void (*run)(Node*, void*);
+    };
+
+    template<typename T, typename F>
+    struct Entry : Node
+    {
+      F f;
+
+      Entry(F&& f_) : Node{nullptr, &Entry::run_entry}, f(std::forward<F>(f_))
+      {}
+
+      static void run_entry(Node* n, void* cown)
+      {
+        auto* e = static_cast<Entry*>(n);
+        std::move(e->f)(acquired_cown<T>(*static_cast<ActualCown<T>*>(cown)));
+        e->~Entry();
+        heap::dealloc(e, sizeof(Entry));
+      }
+    };
+
+    struct Buffer
+    {
+      Cown* cown;
+      Node* head;
+      Node* tail;
+      size_t count;
+      /// Builds the behaviour that runs the closures in the buffer.
+      BehaviourCore* (*make)(Cown*, Node*);
+    };
+
+    struct Buffers
+    {
+      Buffer entries[BUFFERS];
+      size_t used = 0;
+    };
+
+    static Buffers& local()
+    {
+      static thread_local Buffers buffers;
+      return buffers;
+    }
+
+    static std::atomic<size_t>& limit()
+    {
+      static std::atomic<size_t> l{16};
+      return l;
+    }
+
+    template<typename T>
+    static BehaviourCore* make(Cown* cown, Node* head)
+    {
+      auto* t = static_cast<ActualCown<T>*>(cown);
+      auto* body = Behaviour::make(1, [t, head]() {
+        t->begin_write();
+        Node* n = head;
+        while (n != nullptr)
+        {
+          // Read before the node is freed.
+          Node* next = n->next;
+          n->run(n, t);
+          n = next;
+        }
+        t->end_write();
+      });
+
+      // The buffer's reference count on the cown moves to the behaviour.
+      auto* s = new (body->get_slots()) Slot(t);
+      s->set_move();
+      body->enter_queues();
+      return body;
+    }
+
+    static void flush()
+    {
+      auto& buffers = local();
+      if (buffers.used == 0)
+        return;
+
+      BehaviourCore* bodies[BUFFERS];
+      for (size_t i = 0; i < buffers.used; i++)
+      {
+        auto& b = buffers.entries[i];
+        VERONA_LOG << "Flushing " << b.count << " fused closures for " << b.cown
+                   << Logging::endl;
+        bodies[i] = b.make(b.cown, b.head);
+      }
+
+      auto count = std::exchange(buffers.used, 0);
+      BehaviourCore::schedule_many(bodies, count);
+    }
+
+    template<typename T, typename F>
+    static void add(const cown_ptr<T>& c, F&& f)
+    {
+      static_assert(
+        !std::is_const_v<T>, "Fused closures require write access");
+      Cown* cown = c.allocated_cown;
+      assert(cown != nullptr);
+
+      auto& buffers = local();
+      size_t i = 0;
+      while ((i < buffers.used) && (buffers.entries[i].cown != cown))
+        i++;
+
+      if (i == buffers.used)
+      {
+        if (i == BUFFERS)
+        {
+          flush();
+          i = 0;
+        }
+
+        // Held until the buffer is scheduled.
+        Cown::acquire(cown);
+        buffers.entries[i] = {cown, nullptr, nullptr, 0, &make<T>};
+        buffers.used++;
+
+        // Flush once the running behaviour returns.
+        Behaviour::flush_hook() = &flush;
+      }
+
+      using E = Entry<T, std::decay_t<F>>;
+      Node* n =
+        new (heap::alloc(sizeof(E))) E(std::decay_t<F>(std::forward<F>(f)));
+
+      auto& b = buffers.entries[i];
+      if (b.tail == nullptr)
+        b.head = n;
+      else
+        b.tail->next = n;
+      b.tail = n;
+
+      if (++b.count >= limit().load(std::memory_order_relaxed))
+        flush();
+    }
+  };
+
+  /**
+   * Schedule `f` to run with write access to `c`, like `when(c) << f`, but
+   * allow it to be fused with other closures this thread sends to `c`, into
+   * a single behaviour that runs them back to back.  See `Fusion` for when
+   * the fused behaviours are scheduled.
+   *
+   * The closures sent to a cown still run in the order they were sent, and
+   * after any behaviour this thread scheduled earlier.  Outside a behaviour,
+   * `flush_fused` must be called to schedule the remaining closures.
+   *
+   * As the closures share a behaviour, they must not use
+   * `Behaviour::rerun`, or release the cown early.
+   */
+  template<typename T, typename F>
+  void when_fused(const cown_ptr<T>& c, F&& f)
+  {
+    Scheduler::stats().behaviour(1);
+    Fusion::add(c, std::forward<F>(f));
+  }
+
+  /**
+   * Schedule the closures buffered by `when_fused` on this thread.
+   */
+  inline void flush_fused()
+  {
+    Fusion::flush();
+  }
+
+  /**
+   * Set the maximum number of closures fused into one behaviour.
+   */
+  inline void set_fusion_limit(size_t limit)
+  {
+    Fusion::limit().store(
+      std::max<size_t>(limit, 1), std::memory_order_relaxed);
+  }
+} // namespace verona::cpp
@@ -0,0 +1,208 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../sched/ioqueue.h"
+#include "promise.h"
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <verona.h>
+
+/**
+ * Asynchronous I/O from behaviours, on the I/O queue of the core the
+ * behaviour runs on, see `IOQueue`.
+ *
+ *   when(c) << [](acquired_cown<File> f) {
+ *     io::submit(io::read(f->fd, f->buf, f->len, 0), [c](int r) {
+ *       when(c) << [r](acquired_cown<File> f) { ... };
+ *     });
+ *   };
+ *
+ * The continuation runs on the same core once the operation has completed,
+ * with what the system call would have returned, or a negative errno.  It
+ * does not hold the cowns of the behaviour that submitted the operation, so
+ * must schedule a behaviour on them to use them, and the buffer must be kept
+ * alive until it runs.  Operations must be submitted on a scheduler thread,
+ * and keep the runtime alive until they complete.
+ */
+namespace verona::cpp::io
+{
+  using namespace verona::rt;
+
+  /// Passed as an offset for the current file position.
+  static constexpr uint64_t CURRENT = IOOp::CURRENT_POSITION;
+
+  /// Reads at `offset`, or from the current file position by default.
+  inline IOOp read(int fd, void* buf, uint32_t len, uint64_t offset = CURRENT)
+  {
+    return {IOOpcode::Read, fd, buf, len, offset};
+  }
+
+  /// Writes at `offset`, or at the current file position by default.
+  inline IOOp
+  write(int fd, const void* buf, uint32_t len, uint64_t offset = CURRENT)
+  {
+    return {IOOpcode::Write, fd, const_cast<void*>(buf), len, offset};
+  }
+
+  /**
+   * Reads into part of the buffer registered with `register_buffers` at
+   * `index`, without the kernel mapping it for this operation.
+   */
+  inline IOOp read_fixed(
+    int fd, uint16_t index, void* buf, uint32_t len, uint64_t offset = CURRENT)
+  {
+    return {IOOpcode::ReadFixed, fd, buf, len, offset, 0, index};
+  }
+
+  inline IOOp write_fixed(
+    int fd,
+    uint16_t index,
+    const void* buf,
+    uint32_t len,
+    uint64_t offset = CURRENT)
+  {
+    return {
+      IOOpcode::WriteFixed, fd, const_cast<void*>(buf), len, offset, 0, index};
+  }
+
+  inline IOOp recv(int fd, void* buf, uint32_t len, int flags = 0)
+  {
+    return {IOOpcode::Recv, fd, buf, len, 0, flags};
+  }
+
+  inline IOOp send(int fd, const void* buf, uint32_t len, int flags = 0)
+  {
+    return {IOOpcode::Send, fd, const_cast<void*>(buf), len, 0, flags};
+  }
+
+  /// Completes with the accepted socket.
+  inline IOOp accept(int fd)
+  {
+    return {IOOpcode::Accept, fd};
+  }
+
+  inline IOOp nop()
+  {
+    return {};
+  }
+
+  /**
+   * Start `op`, and call `f` with its result on this core once it has
+   * completed.
+   */
+  template<typename F>
+  void submit(const IOOp& op, F&& f)
+  {
+    static_assert(
+      std::is_invocable_v<F, int>, "The continuation must take the result");
+
+    auto req = new (heap::alloc<sizeof(IORequest)>()) IORequest();
+    req->work =
+      Closure::make([req, f = std::forward<F>(f)](Work*) mutable {
+        int result = req->result;
+        heap::dealloc<sizeof(IORequest)>(req);
+        f(result);
+        return true;
+      });
+    Scheduler::submit_io(op, req);
+  }
+
+  /**
+   * Start `op`, and return a promise of its result, fulfilled on this core
+   * once it has completed.
+   */
+  inline Promise<int>::PromiseR submit(const IOOp& op)
+  {
+    auto pp = Promise<int>::create_promise();
+    submit(op, [w = std::move(pp.second)](int result) mutable {
+      Promise<int>::fulfill(std::move(w), std::move(result));
+    });
+    return std::move(pp.first);
+  }
+
+  /**
+   * `count` buffers of `size` bytes, allocated together, for receiving into
+   * and then handing to a cown without a copy:
+   *
+   *   auto buf = pool.acquire();
+   *   io::submit(io::recv(fd, buf, pool.size()), [c, buf](int r) {
+   *     when(c) << [buf, r](acquired_cown<arena<Stream>> s) {
+   *       s->get().packets.push_back({s->adopt(buf, r, &pool), r});
+   *     };
+   *   });
+   *
+   * A buffer adopted by an arena region comes back to the pool when the
+   * region is reset or released, see `RegionArena::adopt`, on whichever
+   * thread does that, so the pool is thread safe.  The pool must outlive the
+   * regions its buffers are adopted by.  Its memory is not from the runtime's
+   * heap, so a pool can outlive the runtime.
+   */
+  class buffer_pool : public BufferPool
+  {
+    size_t buffer_size;
+    size_t count;
+    char* memory;
+    std::vector<void*> free;
+    snmalloc::FlagWord lock;
+
+  public:
+    buffer_pool(size_t count_, size_t size_)
+    : BufferPool{[](BufferPool* p, void* buf, size_t) {
+        static_cast<buffer_pool*>(p)->release(buf);
+      }},
+      buffer_size(size_),
+      count(count_),
+      memory(new char[count_ * size_])
+    {
+      free.reserve(count);
+      for (size_t i = count; i > 0; i--)
+        free.push_back(memory + ((i - 1) * buffer_size));
+    }
+
+    buffer_pool(const buffer_pool&) = delete;
+
+    ~buffer_pool()
+    {
+      assert(free.size() == count);
+      delete[] memory;
+    }
+
+    size_t size() const
+    {
+      return buffer_size;
+    }
+
+    /// A free buffer, or nullptr if all are in use.
+    void* acquire()
+    {
+      snmalloc::FlagLock l{lock};
+      if (free.empty())
+        return nullptr;
+      auto buf = free.back();
+      free.pop_back();
+      return buf;
+    }
+
+    /// Return a buffer that was not adopted by a region.
+    void release(void* buf)
+    {
+      assert((buf >= memory) && (buf < memory + (count * buffer_size)));
+      snmalloc::FlagLock l{lock};
+      free.push_back(buf);
+    }
+  };
+
+  /**
+   * Register `count` buffers, an array of `iovec`, for `read_fixed` and
+   * `write_fixed` on this core.  Returns 0, or a negative errno, which is
+   * `-ENOTSUP` where the core's I/O does not use io_uring.  Fixed operations
+   * must be submitted on the core that registered the buffers.
+   */
+  inline int register_buffers(const void* buffers, unsigned count)
+  {
+    return Scheduler::register_io_buffers(buffers, count);
+  }
+} // namespace verona::cpp::io
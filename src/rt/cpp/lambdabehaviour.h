@@ -26,18 +26,79 @@ namespace verona::rt
     Behaviour::schedule(count, requests, std::forward<Be>(f));
   }
 
+  /**
+   * Wrap a lambda that does not require any cowns as work.  Like a
+   * behaviour, it joins the current `FinishScope`, and runs inside it.
+   */
   template<typename Be>
-  static void schedule_lambda(Be&& f)
+  static Work* make_lambda_work(Be&& f)
   {
-    auto w = Closure::make([f = std::forward<Be>(f)](Work* w) mutable {
-      f();
+    return Closure::make([f = std::forward<Be>(f),
+                          scope = FinishScope::join()](Work*) mutable {
+      {
+        FinishScope::Enter in_scope(scope);
+        f();
+      }
+      if (scope != nullptr)
+        scope->leave();
       return true;
     });
+  }
+
+  template<typename Be>
+  static void schedule_lambda(Be&& f)
+  {
+    auto w = make_lambda_work(std::forward<Be>(f));
     Scheduler::schedule(w);
   }
 
-  // TODO super minimal version initially, just to get the tests working.
-  // Should be expanded to cover multiple cowns.
+  /**
+   * Schedule a lambda that does not require any cowns onto the queue of a
+   * specific core.
+   */
+  template<typename Be>
+  static void schedule_lambda_on(Core* core, Be&& f)
+  {
+    auto w = make_lambda_work(std::forward<Be>(f));
+    Scheduler::schedule_on(core, w);
+  }
+
+  /**
+   * Schedule a lambda that does not require any cowns onto the high priority
+   * queue of `core`, or of the current core if `core` is nullptr.
+   */
+  template<typename Be>
+  static void schedule_lambda_high(Core* core, Be&& f)
+  {
+    auto w = make_lambda_work(std::forward<Be>(f));
+    Scheduler::schedule_high(w, core);
+  }
+
+  /**
+   * Schedule a lambda that does not require any cowns onto a reserved core,
+   * `core` if it is one, see `ThreadPool::schedule_critical`.
+   */
+  template<typename Be>
+  static void schedule_lambda_critical(Core* core, Be&& f)
+  {
+    auto w = make_lambda_work(std::forward<Be>(f));
+    Scheduler::schedule_critical(w, core);
+  }
+
+  /**
+   * Schedule a lambda that does not require any cowns onto the deadline
+   * queue of `core`, or of the current core if `core` is nullptr.
+   */
+  template<typename Be>
+  static void schedule_lambda_deadline(Core* core, uint64_t deadline, Be&& f)
+  {
+    auto w = make_lambda_work(std::forward<Be>(f));
+    Scheduler::schedule_deadline(w, deadline, core);
+  }
+
+  /**
+   * Create a notification that runs `f` with write access to `cown`.
+   */
   template<typename Be>
   inline Notification* make_notification(Cown* cown, Be&& f)
   {
@@ -45,4 +106,16 @@ namespace verona::rt
     return Notification::make<Be>(1, requests, std::forward<Be>(f));
   }
 
+  /**
+   * Create a notification that runs `f` on `count` cowns, each requested in
+   * read or write mode.
+   */
+  template<typename Be>
+  inline Notification* make_notification(
+    size_t count, Request* requests, Be&& f)
+  {
+    return Notification::make<std::decay_t<Be>>(
+      count, requests, std::forward<Be>(f));
+  }
+
 } // namespace verona::rt
@@ -0,0 +1,192 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../sched/notification.h"
+#include "cown.h"
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace verona::cpp
+{
+  using namespace verona::rt;
+
+  /**
+   * A closure on a fixed set of cowns that runs each time it is notified.
+   * Notifications that arrive before it starts running are coalesced into a
+   * single run, see `Notification`.
+   *
+   *   auto n = make_notification(
+   *     [](acquired_cown<A> a, acquired_cown<const B> b) { ... }, a, read(b));
+   *   n.notify();
+   *
+   * Cowns passed with `read` are acquired in read mode, and the others in
+   * write mode.  The notification keeps the cowns alive, and is itself
+   * reference counted, so copies of this handle share it.
+   *
+   * `recurring_when` builds one with the syntax of `when`, for a behaviour
+   * that is rescheduled repeatedly, such as a periodic tick:
+   *
+   *   auto tick = recurring_when(a, read(b)) <<
+   *     [](acquired_cown<A> a, acquired_cown<const B> b) { ... };
+   *   tick.fire();
+   *
+   * Each run reuses the same behaviour, so firing never allocates.
+   */
+  class notification
+  {
+    Notification* n = nullptr;
+
+    explicit notification(Notification* n_) : n(n_) {}
+
+    template<typename T>
+    static ActualCown<std::remove_const_t<T>>* actual(const cown_ptr<T>& c)
+    {
+      return c.allocated_cown;
+    }
+
+    template<typename T>
+    static Request request(const cown_ptr<T>& c)
+    {
+      assert(c.allocated_cown != nullptr);
+      if constexpr (std::is_const_v<T>)
+        return Request::read(c.allocated_cown);
+      else
+        return Request::write(c.allocated_cown);
+    }
+
+    template<typename F, typename... Ts>
+    struct Body
+    {
+      F f;
+      std::tuple<ActualCown<std::remove_const_t<Ts>>*...> cowns;
+
+      template<typename T>
+      static void begin_write(ActualCown<std::remove_const_t<T>>* c)
+      {
+        if constexpr (!std::is_const_v<T>)
+          c->begin_write();
+      }
+
+      template<typename T>
+      static void end_write(ActualCown<std::remove_const_t<T>>* c)
+      {
+        if constexpr (!std::is_const_v<T>)
+          c->end_write();
+      }
+
+      template<size_t... Is>
+      void run(std::index_sequence<Is...>)
+      {
+        (begin_write<Ts>(std::get<Is>(cowns)), ...);
+        f(acquired_cown<Ts>(*std::get<Is>(cowns))...);
+        (end_write<Ts>(std::get<Is>(cowns)), ...);
+      }
+
+      void operator()()
+      {
+        run(std::index_sequence_for<Ts...>{});
+      }
+    };
+
+    template<typename F, typename... Ts>
+    friend notification make_notification(F&& f, const cown_ptr<Ts>&... cowns);
+
+  public:
+    notification() = default;
+
+    notification(const notification& other) : n(other.n)
+    {
+      if (n != nullptr)
+        Shared::acquire(n);
+    }
+
+    notification(notification&& other) : n(other.n)
+    {
+      other.n = nullptr;
+    }
+
+    notification& operator=(notification other)
+    {
+      std::swap(n, other.n);
+      return *this;
+    }
+
+    ~notification()
+    {
+      if (n != nullptr)
+        Shared::release(n);
+    }
+
+    /**
+     * Request the closure is run.  This does not allocate, so it is cheap
+     * to call repeatedly, see `Notification::notify`.
+     */
+    void notify()
+    {
+      assert(n != nullptr);
+      n->notify();
+    }
+
+    /// The same as `notify`, for a handle from `recurring_when`.
+    void fire()
+    {
+      notify();
+    }
+  };
+
+  /**
+   * Create a `notification` that runs `f` on `cowns`.  `f` takes an
+   * `acquired_cown` for each cown, as with `when`.
+   */
+  template<typename F, typename... Ts>
+  notification make_notification(F&& f, const cown_ptr<Ts>&... cowns)
+  {
+    static_assert(sizeof...(Ts) > 0, "A notification needs at least one cown");
+    using B = notification::Body<std::decay_t<F>, Ts...>;
+
+    Request requests[] = {notification::request(cowns)...};
+    return notification(Notification::make<B>(
+      sizeof...(Ts),
+      requests,
+      B{std::forward<F>(f), std::make_tuple(notification::actual(cowns)...)}));
+  }
+
+  /**
+   * The cowns of a `recurring_when`, waiting for the closure.
+   */
+  template<typename... Ts>
+  class RecurringWhen
+  {
+    std::tuple<cown_ptr<Ts>...> cowns;
+
+  public:
+    RecurringWhen(const cown_ptr<Ts>&... cowns_) : cowns(cowns_...) {}
+
+    /// Make the `notification` that runs `f` on the cowns each time it is
+    /// fired.  It does not run until it is first fired.
+    template<typename F>
+    notification operator<<(F&& f)
+    {
+      return std::apply(
+        [&f](auto&... cs) {
+          return make_notification(std::forward<F>(f), cs...);
+        },
+        cowns);
+    }
+  };
+
+  /**
+   * Start a behaviour on `cowns` that can be run again and again without
+   * allocating, see `notification`.
+   */
+  template<typename... Ts>
+  RecurringWhen<Ts...> recurring_when(const cown_ptr<Ts>&... cowns)
+  {
+    static_assert(
+      sizeof...(Ts) > 0, "A recurring when needs at least one cown");
+    return RecurringWhen<Ts...>(cowns...);
+  }
+} // namespace verona::cpp
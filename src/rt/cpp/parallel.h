@@ -0,0 +1,163 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "task_group.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace verona::cpp
+{
+  /**
+   * Data-parallel algorithms on the scheduler threads, built on
+   * `task_group`.  None of them wait: each returns straight away, and runs
+   * its `then` continuation once the work is done, so they may be called
+   * from inside a behaviour.  The data must stay alive until then.
+   *
+   * Ranges are split in half recursively, and each half that is split off
+   * is spawned as a task onto the current core, from where idle cores steal
+   * it.  A range of at most `grain` elements is not split further.  A
+   * `grain` of zero picks one that gives each core several pieces of work.
+   */
+  namespace internal
+  {
+    inline size_t default_grain(size_t n)
+    {
+      size_t pieces = Scheduler::get_active_core_count() * 8;
+      return std::max<size_t>(1, n / std::max<size_t>(1, pieces));
+    }
+
+    template<typename F>
+    void split(
+      task_group g, size_t lo, size_t hi, size_t grain, std::shared_ptr<F> f)
+    {
+      while (hi - lo > grain)
+      {
+        size_t mid = lo + (hi - lo) / 2;
+        g.spawn([g, mid, hi, grain, f]() { split(g, mid, hi, grain, f); });
+        hi = mid;
+      }
+      (*f)(lo, hi);
+    }
+
+    template<typename It, typename Compare>
+    void
+    sort_split(task_group g, It first, It last, size_t grain, Compare cmp)
+    {
+      while (static_cast<size_t>(last - first) > grain)
+      {
+        // Everything before `mid` is then ordered before everything after.
+        It mid = first + (last - first) / 2;
+        std::nth_element(first, mid, last, cmp);
+        g.spawn([g, first, mid, grain, cmp]() {
+          sort_split(g, first, mid, grain, cmp);
+        });
+        first = mid;
+      }
+      std::sort(first, last, cmp);
+    }
+  } // namespace internal
+
+  /**
+   * Run `f(lo, hi)` over pieces that cover `[begin, end)`, then `then()`.
+   */
+  template<typename F, typename K>
+  void parallel_for(size_t begin, size_t end, size_t grain, F&& f, K&& then)
+  {
+    if (grain == 0)
+      grain = internal::default_grain(end - begin);
+
+    task_group g;
+    if (begin < end)
+    {
+      auto body = std::make_shared<std::decay_t<F>>(std::forward<F>(f));
+      g.spawn([g, begin, end, grain, body]() {
+        internal::split(g, begin, end, grain, body);
+      });
+    }
+    g.then(std::forward<K>(then));
+  }
+
+  /**
+   * Compute `map(lo, hi)` for pieces of at most `grain` elements that cover
+   * `[begin, end)`, and call `then` with the results folded with `combine`,
+   * starting from `identity`.  The pieces are combined in order, so
+   * `combine` only needs to be associative.
+   */
+  template<typename T, typename Map, typename Combine, typename K>
+  void parallel_reduce(
+    size_t begin,
+    size_t end,
+    size_t grain,
+    T identity,
+    Map&& map,
+    Combine&& combine,
+    K&& then)
+  {
+    if (grain == 0)
+      grain = internal::default_grain(end - begin);
+
+    // Wrapped, so that each piece has its own object to write to.
+    struct Partial
+    {
+      T value;
+    };
+
+    size_t pieces = (end > begin) ? (end - begin + grain - 1) / grain : 0;
+    auto partials =
+      std::make_shared<std::vector<Partial>>(pieces, Partial{identity});
+
+    parallel_for(
+      0,
+      pieces,
+      1,
+      [partials, begin, end, grain, map = std::forward<Map>(map)](
+        size_t lo, size_t hi) mutable {
+        for (size_t p = lo; p < hi; p++)
+        {
+          size_t first = begin + p * grain;
+          (*partials)[p].value = map(first, std::min(end, first + grain));
+        }
+      },
+      [partials,
+       identity = std::move(identity),
+       combine = std::forward<Combine>(combine),
+       then = std::forward<K>(then)]() mutable {
+        T result = std::move(identity);
+        for (auto& p : *partials)
+          result = combine(std::move(result), std::move(p.value));
+        then(std::move(result));
+      });
+  }
+
+  /**
+   * Sort `[first, last)` with `cmp`, then call `then()`.  The sort is not
+   * stable.
+   */
+  template<typename It, typename Compare, typename K>
+  void parallel_sort(It first, It last, size_t grain, Compare cmp, K&& then)
+  {
+    size_t n = static_cast<size_t>(last - first);
+    if (grain == 0)
+      grain = internal::default_grain(n);
+
+    task_group g;
+    if (n > 0)
+    {
+      g.spawn([g, first, last, grain, cmp]() {
+        internal::sort_split(g, first, last, grain, cmp);
+      });
+    }
+    g.then(std::forward<K>(then));
+  }
+
+  template<typename It, typename K>
+  void parallel_sort(It first, It last, K&& then)
+  {
+    parallel_sort(first, last, 0, std::less<>(), std::forward<K>(then));
+  }
+} // namespace verona::cpp
@@ -0,0 +1,401 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <verona.h>
+
+namespace verona::cpp
+{
+  using namespace verona::rt;
+
+  /**
+   * Persistent containers, whose versions are immutable object graphs that
+   * share structure.  An update copies only the path from the root to the
+   * changed entry into a fresh trace region, and freezes that region.  The
+   * copied nodes point to the rest of the old version, which freezing counts
+   * as references into already immutable state.  An update is then
+   * O(log n) in time and memory, where freezing the whole container would be
+   * O(n).
+   *
+   * Each handle holds a reference to the root of its version, so versions
+   * can be kept, shared between threads, or published through a
+   * `Noticeboard` with `get_root`.  Keys and values are copied into the nodes,
+   * and must not hold pointers to Verona objects, as the nodes do not trace
+   * them.
+   */
+  namespace internal
+  {
+    static constexpr size_t PERSISTENT_BITS = 4;
+    static constexpr size_t PERSISTENT_WIDTH = size_t(1) << PERSISTENT_BITS;
+    static constexpr size_t PERSISTENT_MASK = PERSISTENT_WIDTH - 1;
+
+    /// An inner node, whose children are of either kind of node.
+    struct PersistentBranch : public V<PersistentBranch>
+    {
+      Object* children[PERSISTENT_WIDTH] = {};
+
+      /// Only used on the root, see `persistent_map` and `persistent_vector`.
+      size_t size = 0;
+      size_t shift = 0;
+
+      PersistentBranch() = default;
+
+      /// A copy of `other` in the current region.
+      PersistentBranch(const PersistentBranch& other)
+      : V<PersistentBranch>(), size(other.size), shift(other.shift)
+      {
+        std::copy(
+          std::begin(other.children),
+          std::end(other.children),
+          std::begin(children));
+      }
+
+      void trace(ObjectStack& st) const
+      {
+        for (auto* c : children)
+        {
+          if (c != nullptr)
+            st.push(c);
+        }
+      }
+    };
+
+    /**
+     * Holds a reference to the frozen root of a version.
+     */
+    class PersistentRoot
+    {
+    protected:
+      PersistentBranch* root;
+
+      explicit PersistentRoot(PersistentBranch* r) : root(r) {}
+
+      PersistentRoot(const PersistentRoot& other) : root(other.root)
+      {
+        Immutable::acquire(root);
+      }
+
+      PersistentRoot& operator=(const PersistentRoot& other)
+      {
+        Immutable::acquire(other.root);
+        Immutable::release(root);
+        root = other.root;
+        return *this;
+      }
+
+      ~PersistentRoot()
+      {
+        Immutable::release(root);
+      }
+
+      /**
+       * Copy the root into a fresh region, apply `update` to the copy, and
+       * freeze the region.
+       */
+      template<typename F>
+      static PersistentBranch* update_root(PersistentBranch* old, F&& update)
+      {
+        auto* r = new (RegionType::Trace) PersistentBranch(*old);
+        {
+          UsingRegion rr(r);
+          update(r);
+        }
+        return freeze(r);
+      }
+
+      static PersistentBranch* empty_root(size_t shift)
+      {
+        auto* r = new (RegionType::Trace) PersistentBranch();
+        r->shift = shift;
+        return freeze(r);
+      }
+
+    public:
+      /// The root of this version, to share it as an immutable object.
+      Object* get_root() const
+      {
+        return root;
+      }
+
+      size_t size() const
+      {
+        return root->size;
+      }
+
+      bool empty() const
+      {
+        return size() == 0;
+      }
+    };
+  } // namespace internal
+
+  /**
+   * A persistent hash map: a hash array mapped trie, where each level
+   * consumes `internal::PERSISTENT_BITS` of the hash.  Entries whose whole
+   * hashes are equal are chained.
+   */
+  template<typename K, typename Val, typename Hash = std::hash<K>>
+  class persistent_map : public internal::PersistentRoot
+  {
+    using Branch = internal::PersistentBranch;
+    static constexpr size_t BITS = internal::PERSISTENT_BITS;
+    static constexpr size_t MASK = internal::PERSISTENT_MASK;
+
+    struct Leaf : public V<Leaf>
+    {
+      uint64_t hash;
+      K key;
+      Val value;
+      Leaf* next;
+
+      Leaf(uint64_t h, K k, Val v, Leaf* n)
+      : hash(h), key(std::move(k)), value(std::move(v)), next(n)
+      {}
+
+      void trace(ObjectStack& st) const
+      {
+        if (next != nullptr)
+          st.push(next);
+      }
+    };
+
+    static bool is_leaf(Object* o)
+    {
+      return o->get_descriptor() == Leaf::desc();
+    }
+
+    static uint64_t hash_of(const K& key)
+    {
+      return static_cast<uint64_t>(Hash()(key));
+    }
+
+    static size_t index(uint64_t hash, size_t level)
+    {
+      return (hash >> (level * BITS)) & MASK;
+    }
+
+    explicit persistent_map(Branch* r) : PersistentRoot(r) {}
+
+    /**
+     * Copy the chain `l` into the current region without `key`, and return
+     * the new head.  The part after `key` is shared.
+     */
+    static Leaf* without(Leaf* l, const K& key)
+    {
+      if (l == nullptr)
+        return nullptr;
+      if (l->key == key)
+        return l->next;
+      return new Leaf(l->hash, l->key, l->value, without(l->next, key));
+    }
+
+    static void
+    insert(Branch* b, size_t level, uint64_t hash, const K& key, const Val& v)
+    {
+      while (true)
+      {
+        auto& slot = b->children[index(hash, level)];
+
+        if (slot == nullptr)
+        {
+          slot = new Leaf(hash, key, v, nullptr);
+          return;
+        }
+
+        if (!is_leaf(slot))
+        {
+          auto* copy = new Branch(*static_cast<Branch*>(slot));
+          slot = copy;
+          b = copy;
+          level++;
+          continue;
+        }
+
+        auto* l = static_cast<Leaf*>(slot);
+        if (l->hash == hash)
+        {
+          slot = new Leaf(hash, key, v, without(l, key));
+          return;
+        }
+
+        // Push the old leaf down a level, and try again there.
+        auto* split = new Branch();
+        split->children[index(l->hash, level + 1)] = l;
+        slot = split;
+        b = split;
+        level++;
+      }
+    }
+
+    static void erase_from(Branch* b, size_t level, uint64_t hash, const K& key)
+    {
+      auto& slot = b->children[index(hash, level)];
+      if (is_leaf(slot))
+      {
+        slot = without(static_cast<Leaf*>(slot), key);
+        return;
+      }
+
+      // Empty branches are kept, so that nothing above has to change.
+      auto* copy = new Branch(*static_cast<Branch*>(slot));
+      slot = copy;
+      erase_from(copy, level + 1, hash, key);
+    }
+
+  public:
+    /// An empty map.
+    persistent_map() : PersistentRoot(empty_root(0)) {}
+
+    /// A pointer to the value for `key`, or nullptr if it is not present.
+    /// This is valid for as long as this version is.
+    const Val* find(const K& key) const
+    {
+      uint64_t hash = hash_of(key);
+      Object* o = root;
+      for (size_t level = 0; o != nullptr; level++)
+      {
+        if (is_leaf(o))
+        {
+          for (auto* l = static_cast<Leaf*>(o); l != nullptr; l = l->next)
+          {
+            if ((l->hash == hash) && (l->key == key))
+              return &l->value;
+          }
+          return nullptr;
+        }
+        o = static_cast<Branch*>(o)->children[index(hash, level)];
+      }
+      return nullptr;
+    }
+
+    bool contains(const K& key) const
+    {
+      return find(key) != nullptr;
+    }
+
+    /// A new version, with `key` mapped to `v`.
+    persistent_map set(const K& key, const Val& v) const
+    {
+      uint64_t hash = hash_of(key);
+      bool added = !contains(key);
+      return persistent_map(update_root(root, [&](Branch* r) {
+        insert(r, 0, hash, key, v);
+        r->size += added;
+      }));
+    }
+
+    /// A new version, without `key`.
+    persistent_map erase(const K& key) const
+    {
+      if (!contains(key))
+        return *this;
+
+      uint64_t hash = hash_of(key);
+      return persistent_map(update_root(root, [&](Branch* r) {
+        erase_from(r, 0, hash, key);
+        r->size--;
+      }));
+    }
+  };
+
+  /**
+   * A persistent vector: a radix trie of `internal::PERSISTENT_WIDTH` way
+   * branches over chunks of that many elements.  `T` must be default
+   * constructible.
+   */
+  template<typename T>
+  class persistent_vector : public internal::PersistentRoot
+  {
+    using Branch = internal::PersistentBranch;
+    static constexpr size_t BITS = internal::PERSISTENT_BITS;
+    static constexpr size_t WIDTH = internal::PERSISTENT_WIDTH;
+    static constexpr size_t MASK = internal::PERSISTENT_MASK;
+
+    struct Chunk : public V<Chunk>
+    {
+      T values[WIDTH];
+
+      Chunk() = default;
+
+      Chunk(const Chunk& other) : V<Chunk>()
+      {
+        std::copy(
+          std::begin(other.values), std::end(other.values), std::begin(values));
+      }
+
+      static constexpr bool no_pointers = true;
+    };
+
+    explicit persistent_vector(Branch* r) : PersistentRoot(r) {}
+
+    /**
+     * Copy the path to element `i` into the current region below the root
+     * `r`, creating the nodes that do not exist yet, and return its chunk.
+     */
+    static Chunk* path_to(Branch* r, size_t i)
+    {
+      Branch* b = r;
+      for (size_t shift = r->shift; shift > BITS; shift -= BITS)
+      {
+        auto& slot = b->children[(i >> shift) & MASK];
+        if (slot == nullptr)
+          slot = new Branch();
+        else
+          slot = new Branch(*static_cast<Branch*>(slot));
+        b = static_cast<Branch*>(slot);
+      }
+
+      auto& slot = b->children[(i >> BITS) & MASK];
+      auto* chunk =
+        (slot == nullptr) ? new Chunk() : new Chunk(*static_cast<Chunk*>(slot));
+      slot = chunk;
+      return chunk;
+    }
+
+  public:
+    /// An empty vector.
+    persistent_vector() : PersistentRoot(empty_root(BITS)) {}
+
+    /// The element at `i`, which must be less than `size()`.  This is valid
+    /// for as long as this version is.
+    const T& operator[](size_t i) const
+    {
+      assert(i < size());
+      Object* o = root;
+      for (size_t shift = root->shift; shift > 0; shift -= BITS)
+        o = static_cast<Branch*>(o)->children[(i >> shift) & MASK];
+      return static_cast<Chunk*>(o)->values[i & MASK];
+    }
+
+    /// A new version, with the element at `i` replaced by `v`.
+    persistent_vector set(size_t i, const T& v) const
+    {
+      assert(i < size());
+      return persistent_vector(update_root(
+        root, [&](Branch* r) { path_to(r, i)->values[i & MASK] = v; }));
+    }
+
+    /// A new version, with `v` appended.
+    persistent_vector push_back(const T& v) const
+    {
+      size_t i = size();
+      Branch* old = root;
+      return persistent_vector(update_root(root, [&](Branch* r) {
+        // Full, so the old root becomes the first child of a deeper one.
+        if ((i >> (r->shift + BITS)) != 0)
+        {
+          std::fill(std::begin(r->children), std::end(r->children), nullptr);
+          r->children[0] = old;
+          r->shift += BITS;
+        }
+        path_to(r, i)->values[i & MASK] = v;
+        r->size++;
+      }));
+    }
+  };
+} // namespace verona::cpp
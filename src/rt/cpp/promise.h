@@ -2,6 +2,10 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include <atomic>
+#include <optional>
+#include <tuple>
+#include <utility>
 #include <variant>
 
 namespace verona::rt
@@ -32,6 +36,8 @@ namespace verona::rt
     class PromiseErr
     {
       friend class Promise;
+      template<typename U>
+      friend class OneShotPromise;
 
       int err_code;
       PromiseErr(int code) : err_code(code) {}
@@ -51,6 +57,9 @@ namespace verona::rt
       PromiseR& operator=(const PromiseR&) = delete;
 
     public:
+      using value_type = T;
+      using promise_type = Promise;
+
       template<
         typename F,
         typename =
@@ -180,7 +189,7 @@ namespace verona::rt
         std::enable_if_t<std::is_invocable_v<F, std::variant<T, PromiseErr>>>>
     void then(F&& fn)
     {
-      Logging::cout() << "Promise: then" << this << std::endl;
+      VERONA_LOG << "Promise: then" << this << std::endl;
       schedule_lambda(this, [fn = std::move(fn), this] {
         if (fulfilled)
         {
@@ -225,6 +234,19 @@ namespace verona::rt
       return std::make_pair(std::move(r), std::move(w));
     }
 
+    /**
+     * The value of the promise, or an error if the writer was dropped
+     * without fulfilling it.  Only for use in a behaviour on the promise,
+     * which runs once it is settled, such as a `when` that is passed the
+     * read end-point.
+     */
+    std::variant<T, PromiseErr> settled_value() const
+    {
+      if (fulfilled)
+        return val;
+      return PromiseErr(-1);
+    }
+
     /**
      * Fulfill the promise with a value and put the promise cown in a
      * scheduler thread queue. A PromiseW can be fulfilled only once.
@@ -235,8 +257,334 @@ namespace verona::rt
       tmp.promise->val = std::move(v);
       tmp.promise->fulfilled = true;
       Cown::acquire(tmp.promise);
-      Logging::cout() << "Fulfilling promise" << tmp.promise << std::endl;
+      VERONA_LOG << "Fulfilling promise" << tmp.promise << std::endl;
       tmp.promise->slot.release();
     }
   };
+
+  /**
+   * A promise with a single reader, for use as a one-shot future.
+   *
+   * Unlike `Promise`, this is not a cown.  Its state is a single atomic word
+   * that each end point exchanges exactly once: the writer when it fulfills
+   * or drops the promise, and the reader when it calls `then` or drops the
+   * promise.  Whichever end comes second finishes the job, so fulfilling a
+   * promise that has a continuation waiting schedules the continuation
+   * directly, and calling `then` on a promise that is already fulfilled
+   * schedules it immediately.  The continuation, or the second end point to
+   * be dropped, frees the promise.
+   *
+   * The interface mirrors `Promise`, except that `PromiseR` cannot be copied
+   * and `then` consumes it.
+   */
+  template<typename T>
+  class OneShotPromise
+  {
+  public:
+    using PromiseErr = typename Promise<T>::PromiseErr;
+
+  private:
+    /// States of `word`, any other value is the continuation `Work*`.
+    static constexpr uintptr_t EMPTY = 0;
+    static constexpr uintptr_t FULFILLED = 1;
+    static constexpr uintptr_t BROKEN = 2;
+    static constexpr uintptr_t DROPPED = 3;
+
+    std::atomic<uintptr_t> word{EMPTY};
+
+    /// Set by the writer before it exchanges `word`.
+    std::optional<T> val;
+
+    OneShotPromise() = default;
+
+    void destroy()
+    {
+      this->~OneShotPromise();
+      heap::dealloc(this, sizeof(OneShotPromise));
+    }
+
+    /// The writer is done, with `state` FULFILLED or BROKEN.
+    void settle(uintptr_t state)
+    {
+      auto old = word.exchange(state, std::memory_order_acq_rel);
+      if (old == DROPPED)
+        destroy();
+      else if (old != EMPTY)
+        Scheduler::schedule(reinterpret_cast<Work*>(old));
+    }
+
+    template<typename F>
+    void then(F&& fn)
+    {
+      VERONA_LOG << "OneShotPromise: then" << this << std::endl;
+      auto w = Closure::make([fn = std::forward<F>(fn), this](Work*) mutable {
+        if (val.has_value())
+          fn(std::move(*val));
+        else
+          fn(PromiseErr(-1));
+        destroy();
+        return true;
+      });
+
+      auto old =
+        word.exchange(reinterpret_cast<uintptr_t>(w), std::memory_order_acq_rel);
+      if (old != EMPTY)
+        Scheduler::schedule(w);
+    }
+
+    void drop_reader()
+    {
+      auto old = word.exchange(DROPPED, std::memory_order_acq_rel);
+      if (old != EMPTY)
+        destroy();
+    }
+
+  public:
+    /**
+     * The read end-point.  There is only one, and `then` consumes it.
+     */
+    class PromiseR
+    {
+      friend class OneShotPromise;
+
+      OneShotPromise* promise;
+
+      PromiseR(OneShotPromise* p) : promise(p) {}
+
+      PromiseR(const PromiseR&) = delete;
+
+      PromiseR& operator=(const PromiseR&) = delete;
+
+    public:
+      PromiseR() : promise(nullptr) {}
+
+      PromiseR(PromiseR&& old) : promise(old.promise)
+      {
+        old.promise = nullptr;
+      }
+
+      PromiseR& operator=(PromiseR&& old)
+      {
+        if (promise)
+          promise->drop_reader();
+        promise = old.promise;
+        old.promise = nullptr;
+        return *this;
+      }
+
+      ~PromiseR()
+      {
+        if (promise)
+          promise->drop_reader();
+      }
+
+      /**
+       * Run `fn` with the value once the promise is fulfilled, or with an
+       * error if the writer is dropped without fulfilling it.
+       */
+      template<
+        typename F,
+        typename =
+          std::enable_if_t<std::is_invocable_v<F, std::variant<T, PromiseErr>>>>
+      void then(F&& fn) &&
+      {
+        auto p = promise;
+        promise = nullptr;
+        p->then(std::forward<F>(fn));
+      }
+    };
+
+    /**
+     * The write end-point.  Dropping it without fulfilling the promise
+     * passes an error to the reader.
+     */
+    class PromiseW
+    {
+      friend class OneShotPromise;
+
+      OneShotPromise* promise;
+
+      PromiseW(OneShotPromise* p) : promise(p) {}
+
+      PromiseW(const PromiseW&) = delete;
+
+      PromiseW& operator=(const PromiseW&) = delete;
+
+    public:
+      PromiseW() : promise(nullptr) {}
+
+      PromiseW(PromiseW&& old) : promise(old.promise)
+      {
+        old.promise = nullptr;
+      }
+
+      PromiseW& operator=(PromiseW&& old)
+      {
+        if (promise)
+          promise->settle(BROKEN);
+        promise = old.promise;
+        old.promise = nullptr;
+        return *this;
+      }
+
+      ~PromiseW()
+      {
+        if (promise)
+          promise->settle(BROKEN);
+      }
+    };
+
+    /**
+     * Create a promise and get its read and write end-points
+     */
+    static std::pair<PromiseR, PromiseW> create_promise()
+    {
+      auto p = new (heap::alloc(sizeof(OneShotPromise))) OneShotPromise;
+      return std::make_pair(PromiseR(p), PromiseW(p));
+    }
+
+    /**
+     * Fulfill the promise with a value.  If the reader is already waiting,
+     * this schedules its continuation.
+     */
+    static void fulfill(PromiseW&& wp, T&& v)
+    {
+      auto p = wp.promise;
+      wp.promise = nullptr;
+      p->val.emplace(std::move(v));
+      VERONA_LOG << "Fulfilling one-shot promise" << p << std::endl;
+      p->settle(FULFILLED);
+    }
+  };
+
+  namespace promise_detail
+  {
+    template<typename S, typename... Args>
+    S* make_state(Args&&... args)
+    {
+      return new (heap::alloc(sizeof(S))) S(std::forward<Args>(args)...);
+    }
+
+    template<typename S>
+    void drop_state(S* s)
+    {
+      s->~S();
+      heap::dealloc(s, sizeof(S));
+    }
+
+    template<typename... Ts>
+    struct AllState
+    {
+      using Result = Promise<std::tuple<Ts...>>;
+
+      std::atomic<size_t> remaining{sizeof...(Ts)};
+      std::atomic<bool> failed{false};
+      std::tuple<std::optional<Ts>...> vals;
+      typename Result::PromiseW w;
+
+      AllState(typename Result::PromiseW&& w_) : w(std::move(w_)) {}
+
+      template<size_t I, typename V>
+      void arrive(V&& v)
+      {
+        using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+        if (std::holds_alternative<T>(v))
+          std::get<I>(vals).emplace(std::get<T>(std::move(v)));
+        else if (!failed.exchange(true, std::memory_order_acq_rel))
+        {
+          // Fail the result now, rather than after the other promises.
+          auto tmp = std::move(w);
+        }
+
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+          return;
+
+        if (!failed.load(std::memory_order_relaxed))
+          Result::fulfill(
+            std::move(w),
+            std::apply(
+              [](auto&... o) { return std::tuple<Ts...>(std::move(*o)...); },
+              vals));
+        drop_state(this);
+      }
+    };
+
+    template<typename... Ts>
+    struct AnyState
+    {
+      using Result = Promise<std::variant<Ts...>>;
+
+      std::atomic<size_t> remaining{sizeof...(Ts)};
+      std::atomic<bool> done{false};
+      typename Result::PromiseW w;
+
+      AnyState(typename Result::PromiseW&& w_) : w(std::move(w_)) {}
+
+      template<size_t I, typename V>
+      void arrive(V&& v)
+      {
+        using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+        if (
+          std::holds_alternative<T>(v) &&
+          !done.exchange(true, std::memory_order_acq_rel))
+          Result::fulfill(
+            std::move(w),
+            std::variant<Ts...>(
+              std::in_place_index<I>, std::get<T>(std::move(v))));
+
+        // If none was fulfilled, dropping the writer fails the result.
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+          drop_state(this);
+      }
+    };
+
+    template<typename S, typename... Rs, size_t... Is>
+    void subscribe(S* s, std::index_sequence<Is...>, Rs&... rs)
+    {
+      (rs.then(
+         [s](std::variant<
+             typename Rs::value_type,
+             typename Promise<typename Rs::value_type>::PromiseErr> v) {
+           s->template arrive<Is>(std::move(v));
+         }),
+       ...);
+    }
+  }
+
+  /**
+   * Combine `Promise` read end-points into one that is fulfilled with a
+   * tuple of all their values, once they are all fulfilled.  If any of them
+   * fails, the result fails as soon as that is known.
+   *
+   * This counts down atomically as the promises complete, so it takes no
+   * behaviours beyond the ones that read each promise.
+   */
+  template<typename... Rs>
+  auto when_all(Rs&... rs)
+  {
+    static_assert(sizeof...(Rs) > 0, "when_all needs at least one promise");
+    using State = promise_detail::AllState<typename Rs::value_type...>;
+
+    auto pp = State::Result::create_promise();
+    auto s = promise_detail::make_state<State>(std::move(pp.second));
+    promise_detail::subscribe(s, std::index_sequence_for<Rs...>{}, rs...);
+    return std::move(pp.first);
+  }
+
+  /**
+   * Combine `Promise` read end-points into one that is fulfilled with the
+   * value of whichever is fulfilled first, with the index of the variant
+   * identifying which.  The result only fails if all of them fail.
+   */
+  template<typename... Rs>
+  auto when_any(Rs&... rs)
+  {
+    static_assert(sizeof...(Rs) > 0, "when_any needs at least one promise");
+    using State = promise_detail::AnyState<typename Rs::value_type...>;
+
+    auto pp = State::Result::create_promise();
+    auto s = promise_detail::make_state<State>(std::move(pp.second));
+    promise_detail::subscribe(s, std::index_sequence_for<Rs...>{}, rs...);
+    return std::move(pp.first);
+  }
 }
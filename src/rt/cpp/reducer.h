@@ -0,0 +1,125 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "when.h"
+
+#include <functional>
+#include <memory>
+#include <utility>
+
+namespace verona::cpp
+{
+  /**
+   * A cown whose state only changes by updates that commute, such as a
+   * counter, a histogram or a top-K sketch.
+   *
+   *   auto hits = make_reducer_cown<size_t>();
+   *   hits.update([](size_t& n) { n++; });
+   *   when(read(hits)) << [](acquired_cown<const size_t> n) { ... };
+   *
+   * `update` does not schedule a behaviour: it applies the update to a
+   * partial result for the current core, which starts from `T{}`.  Each
+   * partial has a spin lock, which is only contended while a merge takes it.
+   * Threads without a core share one more partial.
+   *
+   * `read` first schedules a behaviour that folds the partials into the
+   * cown with `Merge`, which returns the combination of two `T`s, so the
+   * readers that follow see every update made before it.  Copies of this
+   * handle share the cown and the partials.
+   */
+  template<typename T, typename Merge = std::plus<T>>
+  class reducer_cown
+  {
+    struct alignas(64) Partial
+    {
+      snmalloc::FlagWord lock;
+      T value{};
+    };
+
+    struct Partials
+    {
+      // One for each core, and a last one for threads without a core.
+      size_t count;
+      std::unique_ptr<Partial[]> parts;
+      Merge merge;
+
+      Partials(size_t count_, Merge merge_)
+      : count(count_),
+        parts(std::make_unique<Partial[]>(count_ + 1)),
+        merge(std::move(merge_))
+      {}
+
+      Partial& local()
+      {
+        auto* core = Scheduler::local_core();
+        if ((core == nullptr) || (core->index >= count))
+          return parts[count];
+        return parts[core->index];
+      }
+
+      void merge_into(T& into)
+      {
+        for (size_t i = 0; i <= count; i++)
+        {
+          auto& p = parts[i];
+          snmalloc::FlagLock l(p.lock);
+          into = merge(std::move(into), std::move(p.value));
+          p.value = T{};
+        }
+      }
+    };
+
+    cown_ptr<T> cown;
+    std::shared_ptr<Partials> partials;
+
+  public:
+    reducer_cown(cown_ptr<T> cown_, Merge merge = Merge())
+    : cown(std::move(cown_)),
+      partials(std::make_shared<Partials>(
+        Scheduler::get_core_count(), std::move(merge)))
+    {}
+
+    /**
+     * Apply `f`, which takes a `T&`, to the partial of the current core.
+     */
+    template<typename F>
+    void update(F&& f) const
+    {
+      auto& p = partials->local();
+      snmalloc::FlagLock l(p.lock);
+      std::forward<F>(f)(p.value);
+    }
+
+    /**
+     * Schedule the merge of the partials into the cown, and return the cown.
+     * Behaviours on the cown that are scheduled after this see the updates
+     * made before it.
+     */
+    cown_ptr<T> merged() const
+    {
+      when(cown) << [partials = partials](acquired_cown<T> c) {
+        partials->merge_into(*c);
+      };
+      return cown;
+    }
+  };
+
+  /**
+   * Read access to the merged state of `r`, see `reducer_cown::merged`.
+   */
+  template<typename T, typename Merge>
+  cown_ptr<const T> read(const reducer_cown<T, Merge>& r)
+  {
+    return read(r.merged());
+  }
+
+  /**
+   * Create a `reducer_cown` whose state starts as `T(ts...)`.
+   */
+  template<typename T, typename Merge = std::plus<T>, typename... Args>
+  reducer_cown<T, Merge> make_reducer_cown(Args&&... ts)
+  {
+    return reducer_cown<T, Merge>(make_cown<T>(std::forward<Args>(ts)...));
+  }
+} // namespace verona::cpp
@@ -0,0 +1,152 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../region/region_api.h"
+#include "vobject.h"
+
+#include <cstddef>
+#include <utility>
+
+namespace verona::cpp
+{
+  using namespace verona::rt;
+
+  /**
+   * Owning handle to a region, through its entry point, so that a mutable
+   * graph of objects can be handed to another behaviour without copying it:
+   *
+   *   auto batch = make_region<Batch>(RegionType::Trace, args...);
+   *   batch.use([](Batch& b) { b.items = new Item; });
+   *   when(next_stage) << [batch = std::move(batch)](
+   *                         acquired_cown<Stage> s) mutable {
+   *     s->pending = std::move(batch);
+   *   };
+   *
+   * Only one handle owns the region, so it can only be moved, and whoever
+   * holds it is the only one that can reach the objects in it.  Sending it
+   * moves no objects, and needs none of the cowns it came from.  The region
+   * is released when the handle is destroyed while it still owns it.
+   *
+   * The region keeps its `RememberedSet`, so the immutable objects and
+   * cowns that it refers to stay alive while it moves, and its
+   * `ExternalReferenceTable`, so external references into it remain valid
+   * and resolve for whichever behaviour holds it.  The region must not be
+   * open when the handle is moved.
+   *
+   * A region that is held by an object of another region, its parent, can
+   * be detached from it with `take`, and a handle can give its region to an
+   * object of an open region with `release`.
+   */
+  template<typename T>
+  class region_ptr
+  {
+    T* root = nullptr;
+
+  public:
+    region_ptr() = default;
+
+    region_ptr(std::nullptr_t) {}
+
+    /// Take ownership of the region whose entry point is `iso`.
+    explicit region_ptr(T* iso) : root(iso)
+    {
+      assert((root == nullptr) || root->debug_is_iso());
+    }
+
+    region_ptr(region_ptr&& o) : root(std::exchange(o.root, nullptr)) {}
+
+    region_ptr& operator=(region_ptr&& o)
+    {
+      if (this != &o)
+      {
+        reset();
+        root = std::exchange(o.root, nullptr);
+      }
+      return *this;
+    }
+
+    region_ptr(const region_ptr&) = delete;
+    region_ptr& operator=(const region_ptr&) = delete;
+
+    ~region_ptr()
+    {
+      reset();
+    }
+
+    /**
+     * Detach the region that `field`, of an object in the open region,
+     * refers to, and take ownership of it.  `field` is set to nullptr.
+     */
+    static region_ptr take(T*& field)
+    {
+      assert((field == nullptr) || api::is_region_ref(field));
+      return region_ptr(std::exchange(field, nullptr));
+    }
+
+    /**
+     * Give up ownership of the region, and return its entry point, for
+     * storing in a field of an object in the open region, which then holds
+     * it as a subregion.
+     */
+    T* release()
+    {
+      return std::exchange(root, nullptr);
+    }
+
+    /// Release the region, if this still owns one.
+    void reset()
+    {
+      if (root != nullptr)
+        Region::release(std::exchange(root, nullptr));
+    }
+
+    /**
+     * Run `f` on the entry point with the region open, so that objects can
+     * be allocated in it and it can be collected.
+     */
+    template<typename F>
+    decltype(auto) use(F&& f)
+    {
+      api::UsingRegion r(root);
+      return std::forward<F>(f)(*root);
+    }
+
+    /**
+     * Access the entry point without opening the region.  Nothing may be
+     * allocated through this.
+     * @{
+     */
+    T* get() const
+    {
+      return root;
+    }
+
+    T* operator->() const
+    {
+      return root;
+    }
+
+    T& operator*() const
+    {
+      return *root;
+    }
+    /// @}
+
+    explicit operator bool() const
+    {
+      return root != nullptr;
+    }
+  };
+
+  /**
+   * Create a region of `type`, whose entry point is `T(args...)`.  Objects
+   * it refers to must be added with `region_ptr::use`.
+   */
+  template<typename T, typename... Args>
+  region_ptr<T> make_region(RegionType type, Args&&... args)
+  {
+    auto root = new (type) T(std::forward<Args>(args)...);
+    return region_ptr<T>(root);
+  }
+} // namespace verona::cpp
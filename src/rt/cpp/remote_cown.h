@@ -0,0 +1,266 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../ds/ring.h"
+#include "../pal/sharedmemory.h"
+#include "when.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace verona::cpp
+{
+  namespace detail
+  {
+    /**
+     * The shared memory behind a `remote_cown`, which every process that
+     * uses it maps.  Only plain values are stored in it, as it may be mapped
+     * at a different address in each process.
+     */
+    template<typename Msg, size_t Capacity>
+    struct RemoteSegment
+    {
+      static constexpr uint64_t READY = 0x7665726f6e61726d;
+
+      static_assert(std::atomic<uint64_t>::is_always_lock_free);
+      static_assert(std::atomic<size_t>::is_always_lock_free);
+
+      /// Set once the ring has been initialised by the receiving process.
+      std::atomic<uint64_t> ready;
+      rt::MPMCRing<Msg, Capacity> ring;
+    };
+  } // namespace detail
+
+  /**
+   * A cown in this process that other processes on the same host can send
+   * messages to, through a ring in shared memory.
+   *
+   *   // Receiving process.
+   *   remote_cown<Log, Entry> log("/log", make_cown<Log>(),
+   *     [](Log& l, const Entry& e) { l.append(e); });
+   *   log.listen();
+   *
+   *   // Sending process.
+   *   auto out = remote_cown_ref<Entry>::connect("/log");
+   *   out.send(Entry{...});
+   *
+   * Messages are delivered, in the order each sender sent them, to a
+   * behaviour on the local cown, which runs the handler on each of them.
+   * A poll moves all of the messages that have arrived into one behaviour,
+   * so a busy ring costs one behaviour per batch rather than per message.
+   *
+   * Behaviours, closures and cowns are local to a process, so nothing but
+   * the message is shared: `Msg` must be trivially copyable and must not
+   * hold pointers, and the sender never touches the queues of the receiving
+   * runtime.  Senders need not run the runtime at all.
+   *
+   * Messages are collected either by calling `poll`, for instance from the
+   * I/O poller, or by `listen`, which polls from a closure that reschedules
+   * itself until `close` is called, which keeps a scheduler thread busy but
+   * picks messages up within a pass of its queue.  Copies of this handle
+   * share the cown and the ring, which is removed once the last is dropped.
+   */
+  template<typename T, typename Msg, size_t Capacity = 1024>
+  class remote_cown
+  {
+    using Segment = detail::RemoteSegment<Msg, Capacity>;
+
+    /// The most messages moved into a single behaviour.
+    static constexpr size_t BATCH = Capacity / 4;
+
+    struct State
+    {
+      std::string name;
+      Segment* segment = nullptr;
+      cown_ptr<T> cown;
+      std::function<void(T&, const Msg&)> handler;
+      std::atomic<bool> listening{false};
+
+      ~State()
+      {
+        if (segment == nullptr)
+          return;
+        rt::shm::remove(name.c_str());
+        rt::shm::unmap(segment, sizeof(Segment));
+      }
+    };
+
+    std::shared_ptr<State> state;
+
+    static size_t poll(const std::shared_ptr<State>& st, size_t max)
+    {
+      std::vector<Msg> batch;
+      st->segment->ring.dequeue_some(
+        max, [&](const Msg& m) { batch.push_back(m); });
+
+      size_t n = batch.size();
+      if (n == 0)
+        return 0;
+
+      when(st->cown) << [st, batch = std::move(batch)](acquired_cown<T> t) {
+        for (auto& m : batch)
+          st->handler(*t, m);
+      };
+      return n;
+    }
+
+    static void poll_loop(std::shared_ptr<State> st)
+    {
+      if (!st->listening.load(std::memory_order_acquire))
+      {
+        // Deliver what was sent before `close`.
+        while (poll(st, BATCH) != 0)
+        {}
+        return;
+      }
+
+      poll(st, BATCH);
+      schedule_lambda([st = std::move(st)]() mutable {
+        poll_loop(std::move(st));
+      });
+    }
+
+  public:
+    /**
+     * Create the shared ring called `name`, see `shm::create`, delivering
+     * messages to `cown` with `handler(T&, const Msg&)`.  Check that this
+     * succeeded, which fails if the name is in use, with `operator bool`.
+     */
+    template<typename Handler>
+    remote_cown(std::string name, cown_ptr<T> cown, Handler handler)
+    : state(std::make_shared<State>())
+    {
+      state->name = std::move(name);
+      state->cown = std::move(cown);
+      state->handler = std::move(handler);
+
+      void* p = rt::shm::create(state->name.c_str(), sizeof(Segment));
+      if (p == nullptr)
+        return;
+
+      auto* s = static_cast<Segment*>(p);
+      new (&s->ring) rt::MPMCRing<Msg, Capacity>();
+      s->ready.store(Segment::READY, std::memory_order_release);
+      state->segment = s;
+    }
+
+    explicit operator bool() const
+    {
+      return state->segment != nullptr;
+    }
+
+    const cown_ptr<T>& cown() const
+    {
+      return state->cown;
+    }
+
+    /**
+     * Schedule a behaviour for up to `max` of the messages that have
+     * arrived, and return how many.  Calls must not overlap, so that
+     * batches stay in order, and not be made while listening.
+     */
+    size_t poll(size_t max = BATCH) const
+    {
+      return poll(state, max);
+    }
+
+    /**
+     * Keep polling on the scheduler threads until `close`.  The runtime
+     * does not stop while this is listening.
+     */
+    void listen() const
+    {
+      assert(state->segment != nullptr);
+      if (state->listening.exchange(true, std::memory_order_acq_rel))
+        return;
+
+      schedule_lambda([st = state]() mutable { poll_loop(std::move(st)); });
+    }
+
+    /**
+     * Stop listening.  Messages sent before this are still delivered, but
+     * not those sent after it, which stay in the ring until a `poll`.
+     */
+    void close() const
+    {
+      state->listening.store(false, std::memory_order_release);
+    }
+  };
+
+  /**
+   * Sends messages to a `remote_cown` in another process, or in this one.
+   * This may be used from any thread, with or without a runtime.
+   */
+  template<typename Msg, size_t Capacity = 1024>
+  class remote_cown_ref
+  {
+    using Segment = detail::RemoteSegment<Msg, Capacity>;
+
+    Segment* segment = nullptr;
+
+    remote_cown_ref(Segment* s) : segment(s) {}
+
+  public:
+    remote_cown_ref() = default;
+
+    remote_cown_ref(remote_cown_ref&& other)
+    : segment(std::exchange(other.segment, nullptr))
+    {}
+
+    remote_cown_ref& operator=(remote_cown_ref&& other)
+    {
+      std::swap(segment, other.segment);
+      return *this;
+    }
+
+    ~remote_cown_ref()
+    {
+      if (segment != nullptr)
+        rt::shm::unmap(segment, sizeof(Segment));
+    }
+
+    /**
+     * Map the ring of the `remote_cown` called `name`.  Check that this
+     * succeeded, which fails if it does not exist yet, with `operator bool`.
+     */
+    static remote_cown_ref connect(const std::string& name)
+    {
+      void* p = rt::shm::open(name.c_str(), sizeof(Segment));
+      if (p == nullptr)
+        return {};
+
+      auto* s = static_cast<Segment*>(p);
+      if (s->ready.load(std::memory_order_acquire) != Segment::READY)
+      {
+        rt::shm::unmap(p, sizeof(Segment));
+        return {};
+      }
+      return remote_cown_ref(s);
+    }
+
+    explicit operator bool() const
+    {
+      return segment != nullptr;
+    }
+
+    /// Send `m`, or return false if the ring is full.
+    bool try_send(const Msg& m) const
+    {
+      return segment->ring.try_enqueue(m);
+    }
+
+    /// Send `m`, waiting for the receiver to make space if the ring is full.
+    void send(const Msg& m) const
+    {
+      while (!try_send(m))
+      {
+        Systematic::yield();
+        snmalloc::Aal::pause();
+      }
+    }
+  };
+} // namespace verona::cpp
@@ -0,0 +1,326 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "io.h"
+#include "when.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#  include <sys/socket.h>
+#endif
+
+namespace verona::cpp
+{
+  /**
+   * A cown on another node, reached over a connected stream socket, which
+   * messages can be sent to.  The node that owns the cown delivers them
+   * with a `cown_endpoint` on the other end of the socket.
+   *
+   *   remote_cown_ptr<Update> peer(fd);
+   *   if (!peer.send(Update{...}))
+   *     ... back off, too much is queued for the peer ...
+   *
+   * Closures cannot leave the process, so this carries values of `Msg`,
+   * which must be trivially copyable and not hold pointers, and which the
+   * endpoint's handler turns into work on the cown.  The nodes must agree on
+   * the layout of `Msg`.  A `remote_cown_ptr` is not a `cown_ptr`, so it
+   * cannot be part of a `when` with other cowns: a behaviour that spans
+   * nodes is a message to each, and the reply to each is another message.
+   *
+   * Messages are written by a behaviour on a local cown for the connection,
+   * with I/O from `cpp/io.h`.  Those sent while a write is in flight are
+   * written together by the next, so a busy connection costs one system
+   * call for each batch.  At most `limit` messages are queued for the
+   * connection at once, after which `send` fails until the peer has taken
+   * some, so a slow peer pushes back on its senders through the socket.
+   *
+   * If the connection fails, the messages still queued are dropped, and
+   * `send` fails from then on.  Copies of this handle share the connection.
+   * The socket is not closed by this, see `close`.
+   */
+  template<typename Msg>
+  class remote_cown_ptr
+  {
+    static_assert(std::is_trivially_copyable_v<Msg>);
+
+    struct Outbox
+    {
+      int fd;
+      /// Queued while `sending` is being written.
+      std::vector<Msg> pending;
+      std::vector<Msg> sending;
+      size_t sent_bytes = 0;
+      bool in_flight = false;
+      bool closing = false;
+
+      Outbox(int fd_) : fd(fd_) {}
+    };
+
+    struct State
+    {
+      cown_ptr<Outbox> outbox;
+      size_t limit;
+      std::atomic<size_t> queued{0};
+      std::atomic<bool> failed{false};
+    };
+
+    std::shared_ptr<State> state;
+
+    static void flush(const std::shared_ptr<State>& st, Outbox& o)
+    {
+      if (o.in_flight)
+        return;
+
+      if (o.pending.empty())
+      {
+        if (o.closing)
+        {
+          o.closing = false;
+#if defined(__unix__) || defined(__APPLE__)
+          shutdown(o.fd, SHUT_WR);
+#endif
+        }
+        return;
+      }
+
+      std::swap(o.pending, o.sending);
+      o.sent_bytes = 0;
+      o.in_flight = true;
+      write_some(st, o);
+    }
+
+    static void write_some(const std::shared_ptr<State>& st, Outbox& o)
+    {
+      auto bytes = reinterpret_cast<const char*>(o.sending.data());
+      size_t left = (o.sending.size() * sizeof(Msg)) - o.sent_bytes;
+      auto len = (uint32_t)std::min<size_t>(left, INT32_MAX);
+
+      io::submit(io::send(o.fd, bytes + o.sent_bytes, len), [st](int r) {
+        when(st->outbox) << [st, r](acquired_cown<Outbox> o) {
+          written(st, *o, r);
+        };
+      });
+    }
+
+    static void written(const std::shared_ptr<State>& st, Outbox& o, int r)
+    {
+      if ((r == -EAGAIN) || (r == -EINTR))
+        r = 0;
+
+      if (r < 0)
+      {
+        st->failed.store(true, std::memory_order_release);
+        st->queued.fetch_sub(
+          o.sending.size() + o.pending.size(), std::memory_order_release);
+        o.sending.clear();
+        o.pending.clear();
+        o.in_flight = false;
+        return;
+      }
+
+      o.sent_bytes += (size_t)r;
+      if (o.sent_bytes < o.sending.size() * sizeof(Msg))
+      {
+        write_some(st, o);
+        return;
+      }
+
+      st->queued.fetch_sub(o.sending.size(), std::memory_order_release);
+      o.sending.clear();
+      o.in_flight = false;
+      flush(st, o);
+    }
+
+  public:
+    /// Send to the endpoint on the other end of the connected socket `fd`.
+    remote_cown_ptr(int fd, size_t limit = 4096)
+    : state(std::make_shared<State>())
+    {
+      state->outbox = make_cown<Outbox>(fd);
+      state->limit = limit;
+    }
+
+    /**
+     * Queue `m` to be sent.  Returns false, and drops `m`, if `limit`
+     * messages are already queued, or the connection has failed.
+     */
+    bool send(const Msg& m) const
+    {
+      if (state->failed.load(std::memory_order_acquire))
+        return false;
+
+      if (
+        state->queued.fetch_add(1, std::memory_order_acquire) >=
+        state->limit)
+      {
+        state->queued.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+      }
+
+      when(state->outbox) << [st = state, m](acquired_cown<Outbox> o) {
+        if (st->failed.load(std::memory_order_acquire))
+        {
+          st->queued.fetch_sub(1, std::memory_order_relaxed);
+          return;
+        }
+        o->pending.push_back(m);
+        flush(st, *o);
+      };
+      return true;
+    }
+
+    /// The number of messages queued that have not been written yet.
+    size_t queued() const
+    {
+      return state->queued.load(std::memory_order_relaxed);
+    }
+
+    bool failed() const
+    {
+      return state->failed.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Shut down the sending side of the socket once the messages sent
+     * before this have been written, so that the endpoint sees the end of
+     * the stream.
+     */
+    void close() const
+    {
+      when(state->outbox) << [st = state](acquired_cown<Outbox> o) {
+        o->closing = true;
+        flush(st, *o);
+      };
+    }
+  };
+
+  /**
+   * Delivers the messages sent by a `remote_cown_ptr` on the other end of a
+   * connected stream socket to a local cown.
+   *
+   *   cown_endpoint<Table, Update> ep(fd, table,
+   *     [](Table& t, const Update& u) { t.apply(u); });
+   *   ep.start();
+   *
+   * Each read from the socket becomes one behaviour on the cown, which runs
+   * `handler` on each whole message that arrived, in order.  The next read
+   * is only started once that behaviour has run, so a cown that is not
+   * keeping up stops reading, and the sender's queue fills.  Once the
+   * stream ends, or fails, `on_close` runs in a behaviour on the cown with
+   * zero or the negative errno.
+   *
+   * Reads are in flight until the stream ends, which keeps the runtime
+   * running.  The socket is not closed by this.
+   */
+  template<typename T, typename Msg>
+  class cown_endpoint
+  {
+    static_assert(std::is_trivially_copyable_v<Msg>);
+
+    struct State
+    {
+      int fd;
+      cown_ptr<T> cown;
+      std::function<void(T&, const Msg&)> handler;
+      std::function<void(T&, int)> on_close;
+      /// Only used by the read in flight, and the behaviour it schedules.
+      std::vector<char> buffer;
+      size_t filled = 0;
+    };
+
+    std::shared_ptr<State> state;
+
+    static void receive(std::shared_ptr<State> st)
+    {
+      auto len = (uint32_t)(st->buffer.size() - st->filled);
+      auto buf = st->buffer.data() + st->filled;
+      io::submit(io::recv(st->fd, buf, len), [st](int r) mutable {
+        received(std::move(st), r);
+      });
+    }
+
+    static void received(std::shared_ptr<State> st, int r)
+    {
+      if ((r == -EAGAIN) || (r == -EINTR))
+      {
+        // Nothing yet on a non-blocking socket, so try again later.
+        schedule_lambda([st = std::move(st)]() mutable {
+          receive(std::move(st));
+        });
+        return;
+      }
+
+      if (r <= 0)
+      {
+        when(st->cown) << [st, r](acquired_cown<T> t) {
+          if (st->on_close)
+            st->on_close(*t, r);
+        };
+        return;
+      }
+
+      st->filled += (size_t)r;
+      size_t count = st->filled / sizeof(Msg);
+      if (count == 0)
+      {
+        receive(std::move(st));
+        return;
+      }
+
+      when(st->cown) << [st](acquired_cown<T> t) {
+        size_t count = st->filled / sizeof(Msg);
+        for (size_t i = 0; i < count; i++)
+        {
+          Msg m;
+          std::memcpy(&m, st->buffer.data() + (i * sizeof(Msg)), sizeof(Msg));
+          st->handler(*t, m);
+        }
+
+        // Keep the start of a message that has not all arrived yet.
+        size_t used = count * sizeof(Msg);
+        std::memmove(
+          st->buffer.data(), st->buffer.data() + used, st->filled - used);
+        st->filled -= used;
+        receive(st);
+      };
+    }
+
+  public:
+    /**
+     * Deliver the messages that arrive on `fd` to `cown`, with
+     * `handler(T&, const Msg&)`, reading up to `batch` messages at a time.
+     */
+    template<typename Handler>
+    cown_endpoint(
+      int fd, cown_ptr<T> cown, Handler handler, size_t batch = 256)
+    : state(std::make_shared<State>())
+    {
+      assert(batch > 0);
+      state->fd = fd;
+      state->cown = std::move(cown);
+      state->handler = std::move(handler);
+      state->buffer.resize(batch * sizeof(Msg));
+    }
+
+    /// Run `f(T&, int)` once the stream has ended.  Call before `start`.
+    template<typename F>
+    void on_close(F&& f)
+    {
+      state->on_close = std::forward<F>(f);
+    }
+
+    /// Start reading.  This must be called once, on a scheduler thread.
+    void start() const
+    {
+      receive(state);
+    }
+  };
+} // namespace verona::cpp
@@ -0,0 +1,289 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "when.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace verona::cpp
+{
+  /**
+   * One logical structure split across several cowns, the shards, each of
+   * which holds the keys whose hash falls in its range.
+   *
+   *   auto map = make_sharded_cown<Map, std::string>(8);
+   *   {
+   *     auto r = map.route();
+   *     when(r.shard_for(key)) << [key](acquired_cown<Map> m) { ... };
+   *     when(r.all_shards()) << [](acquired_cown_span<Map> ms) { ... };
+   *   }
+   *
+   * Keys are placed by consistent hashing: the hashes are divided into
+   * ranges, one for each shard, so that splitting a shard only moves the
+   * keys of that shard.  `split` moves the upper half of the range of a
+   * shard to a new shard, with a function that the caller provides to move
+   * the keys, which runs in a behaviour on both shards.  `rebalance` splits
+   * the shard with the deepest queue, see `Cown::queue_depth`, which is what
+   * the `CownProfile` samples, so the shards can be tuned while they are in
+   * use.
+   *
+   * A `routing`, from `route`, stops shards being split while it is alive,
+   * so a behaviour scheduled through it is ordered with respect to every
+   * split: it runs either before the keys move, on the shard they move
+   * from, or after, on the shard they move to.  Routings only share a
+   * counter, so they can be taken concurrently, but should only be held
+   * while scheduling.
+   *
+   * `Hash` need not spread its results, as they are mixed before they are
+   * placed.  Copies of this handle share the shards.
+   */
+  template<typename T, typename Key = size_t, typename Hash = std::hash<Key>>
+  class sharded_cown
+  {
+    struct Shard
+    {
+      /// The first hash of the range of this shard, which ends where the
+      /// next one starts.
+      size_t start;
+      cown_ptr<T> cown;
+    };
+
+    struct State
+    {
+      /// Twice the number of live routes, with the bottom bit set while a
+      /// split is waiting for them or changing the shards.
+      std::atomic<size_t> guard{0};
+      /// In order of `start`, with the first starting at zero.
+      std::vector<Shard> shards;
+      Hash hash;
+
+      State(Hash hash_) : hash(std::move(hash_)) {}
+    };
+
+    std::shared_ptr<State> state;
+
+    static size_t mix(size_t h)
+    {
+      // Finaliser of splitmix64.
+      h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+      h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+      return h ^ (h >> 31);
+    }
+
+    /// The end of the range of shard `i`, or zero for the last.
+    static size_t end_of(const State& s, size_t i)
+    {
+      return (i + 1 < s.shards.size()) ? s.shards[i + 1].start : 0;
+    }
+
+    static size_t index_for(const State& s, size_t h)
+    {
+      auto it = std::upper_bound(
+        s.shards.begin(), s.shards.end(), h, [](size_t h, const Shard& sh) {
+          return h < sh.start;
+        });
+      return (size_t)(it - s.shards.begin()) - 1;
+    }
+
+    static void lock_shards(State& s)
+    {
+      size_t g = s.guard.load(std::memory_order_relaxed);
+      while (((g & 1) != 0) ||
+             !s.guard.compare_exchange_weak(
+               g, g | 1, std::memory_order_acquire))
+      {
+        snmalloc::Aal::pause();
+        g = s.guard.load(std::memory_order_relaxed);
+      }
+
+      while (s.guard.load(std::memory_order_acquire) != 1)
+        snmalloc::Aal::pause();
+    }
+
+    static void unlock_shards(State& s)
+    {
+      s.guard.store(0, std::memory_order_release);
+    }
+
+  public:
+    /**
+     * Stops the shards being split while it is alive, so that the shards it
+     * returns hold the keys they are found for.
+     */
+    class routing
+    {
+      State* s;
+
+      friend sharded_cown;
+
+      routing(State* s_) : s(s_)
+      {
+        size_t g = s->guard.load(std::memory_order_relaxed);
+        while (((g & 1) != 0) ||
+               !s->guard.compare_exchange_weak(
+                 g, g + 2, std::memory_order_acquire))
+        {
+          snmalloc::Aal::pause();
+          g = s->guard.load(std::memory_order_relaxed);
+        }
+      }
+
+    public:
+      routing(const routing&) = delete;
+      routing& operator=(const routing&) = delete;
+
+      ~routing()
+      {
+        s->guard.fetch_sub(2, std::memory_order_release);
+      }
+
+      /// The shard that holds `key`.
+      cown_ptr<T> shard_for(const Key& key) const
+      {
+        return s->shards[index_for(*s, mix(s->hash(key)))].cown;
+      }
+
+      /// All of the shards, in order of their ranges.
+      cown_array<T> all_shards() const
+      {
+        std::vector<cown_ptr<T>> cowns;
+        for (auto& sh : s->shards)
+          cowns.push_back(sh.cown);
+        return cown_array<T>(cowns.data(), cowns.size());
+      }
+
+      size_t shard_count() const
+      {
+        return s->shards.size();
+      }
+    };
+
+    /**
+     * Split `count` empty shards, created with `make`, which returns a
+     * `cown_ptr<T>`, so that each has an equal range.
+     */
+    template<typename Make>
+    sharded_cown(size_t count, Make make, Hash hash = Hash())
+    : state(std::make_shared<State>(std::move(hash)))
+    {
+      assert(count > 0);
+      size_t width = ~(size_t)0 / count;
+      for (size_t i = 0; i < count; i++)
+        state->shards.push_back({i * width, make()});
+    }
+
+    /**
+     * Find the shards for scheduling behaviours on.  This must not be held
+     * while calling `split`.
+     */
+    routing route() const
+    {
+      return routing(state.get());
+    }
+
+    /**
+     * Move the upper half of the range of shard `index` to a new shard,
+     * created with `make`.  `move` is called in a behaviour on both shards
+     * as `move(from, to, moves)`, where `from` and `to` are `T&`, and should
+     * move each key of `from` for which `moves(key)` returns true to `to`.
+     * Returns false if the range of the shard cannot be split.
+     *
+     * Behaviours on the keys that are scheduled after this queue behind the
+     * move, on the new shard.
+     */
+    template<typename Make, typename Move>
+    bool split(size_t index, Make make, Move move)
+    {
+      auto& s = *state;
+      lock_shards(s);
+
+      // The range of the last shard wraps around to zero, so this is one
+      // less than its width, which may not fit.
+      size_t last = 0;
+      size_t start = 0;
+      size_t end = 0;
+      if (index < s.shards.size())
+      {
+        start = s.shards[index].start;
+        end = end_of(s, index);
+        last = end - start - 1;
+      }
+      if (last == 0)
+      {
+        unlock_shards(s);
+        return false;
+      }
+
+      size_t mid = start + (last / 2) + 1;
+      cown_ptr<T> from = s.shards[index].cown;
+      cown_ptr<T> to = make();
+      s.shards.insert(s.shards.begin() + index + 1, Shard{mid, to});
+
+      when(from, to) << [state = state, mid, end, move = std::move(move)](
+                          acquired_cown<T> src, acquired_cown<T> dst) mutable {
+        auto moves = [&](const Key& key) {
+          size_t h = mix(state->hash(key));
+          return (h >= mid) && ((end == 0) || (h < end));
+        };
+        move(*src, *dst, moves);
+      };
+
+      unlock_shards(s);
+      return true;
+    }
+
+#ifdef USE_QUEUE_DEPTH
+    /**
+     * Split the shard with the most behaviours queued on it, if it has at
+     * least `min_depth`, see `split`.  Returns true if a shard was split.
+     * Only built with `USE_QUEUE_DEPTH`.
+     */
+    template<typename Make, typename Move>
+    bool rebalance(size_t min_depth, Make make, Move move)
+    {
+      size_t hottest = 0;
+      size_t depth = 0;
+      {
+        auto r = route();
+        auto& shards = state->shards;
+        for (size_t i = 0; i < shards.size(); i++)
+        {
+          auto d = shards[i].cown.underlying_cown()->queue_depth();
+          if (d > depth)
+          {
+            depth = d;
+            hottest = i;
+          }
+        }
+      }
+
+      if (depth < min_depth)
+        return false;
+
+      // Another split may have moved the shard, which only makes this one
+      // split a neighbour.
+      return split(hottest, make, move);
+    }
+#endif
+  };
+
+  /**
+   * Create a `sharded_cown` with `count` shards, each starting as
+   * `T(ts...)`.
+   */
+  template<
+    typename T,
+    typename Key = size_t,
+    typename Hash = std::hash<Key>,
+    typename... Args>
+  sharded_cown<T, Key, Hash> make_sharded_cown(size_t count, Args... ts)
+  {
+    return sharded_cown<T, Key, Hash>(
+      count, [ts...]() { return make_cown<T>(ts...); });
+  }
+} // namespace verona::cpp
@@ -0,0 +1,115 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <verona.h>
+
+namespace verona::cpp
+{
+  using namespace verona::rt;
+
+  /**
+   * A set of tasks that need no cowns, and a continuation that runs once all
+   * of them have finished.
+   *
+   *   task_group g;
+   *   for (auto& part : parts)
+   *     g.spawn([part]() { sort(part); });
+   *   g.then([]() { merge(); });
+   *
+   * Tasks are pushed onto the current core's queue, from where idle cores
+   * steal them.  The join is a single atomic count, so it does not go
+   * through the cown queues.  A task may spawn more tasks into the group with
+   * a copy of this handle, and the continuation waits for those too.  Once
+   * `then` has been called, only the group's own tasks may spawn into it.
+   * Copies of this handle share the group.
+   */
+  class task_group
+  {
+    struct State
+    {
+      std::atomic<size_t> rc{1};
+      // One for each unfinished task, and one until `then` is called.
+      std::atomic<size_t> pending{1};
+      Work* continuation = nullptr;
+
+      void acquire()
+      {
+        rc.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      void release()
+      {
+        if (rc.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+          this->~State();
+          heap::dealloc(this, sizeof(State));
+        }
+      }
+
+      void finish()
+      {
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+          Scheduler::schedule(continuation);
+      }
+    };
+
+    State* s;
+
+  public:
+    /// A new group, with no tasks.
+    task_group() : s(new (heap::alloc(sizeof(State))) State()) {}
+
+    task_group(const task_group& other) : s(other.s)
+    {
+      s->acquire();
+    }
+
+    task_group& operator=(task_group other)
+    {
+      std::swap(s, other.s);
+      return *this;
+    }
+
+    ~task_group()
+    {
+      s->release();
+    }
+
+    /**
+     * Schedule `f` as a task of this group.
+     */
+    template<typename F>
+    void spawn(F&& f)
+    {
+      assert(s->pending.load(std::memory_order_relaxed) > 0);
+      s->pending.fetch_add(1, std::memory_order_relaxed);
+      s->acquire();
+
+      schedule_lambda([state = s, f = std::forward<F>(f)]() mutable {
+        f();
+        state->finish();
+        state->release();
+      });
+    }
+
+    /**
+     * Run `f` once every task of this group has finished.  This may only be
+     * called once.  If the group has no unfinished tasks, `f` is scheduled
+     * straight away.
+     */
+    template<typename F>
+    void then(F&& f)
+    {
+      assert(s->continuation == nullptr);
+      s->continuation =
+        Closure::make([f = std::forward<F>(f)](Work*) mutable {
+          f();
+          return true;
+        });
+      s->finish();
+    }
+  };
+} // namespace verona::cpp
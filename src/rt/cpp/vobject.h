@@ -41,6 +41,105 @@ namespace verona::rt
     constexpr static bool value = !std::is_trivially_destructible_v<T>;
   };
 
+  /**
+   * The pointer fields of a class, as pointers to its members.  A class that
+   * declares
+   *
+   *   using fields = Fields<&Node::left, &Node::right>;
+   *
+   * instead of a trace method is traced through a table of the offsets of
+   * these fields in its descriptor, without an indirect call.  A class that
+   * holds no pointers can instead declare
+   *
+   *   static constexpr bool no_pointers = true;
+   *
+   * and its objects are never traced at all.
+   */
+  template<auto... Members>
+  struct Fields
+  {};
+
+  template<class T, class = void>
+  struct has_fields : std::false_type
+  {};
+  template<class T>
+  struct has_fields<T, std::void_t<typename T::fields>> : std::true_type
+  {};
+
+  template<class T, class = void>
+  struct has_no_pointers : std::false_type
+  {};
+  template<class T>
+  struct has_no_pointers<T, std::enable_if_t<T::no_pointers>> : std::true_type
+  {};
+
+  /**
+   * The field offset table of `T`, whose pointer fields are `Members`.
+   */
+  template<class T, class F>
+  struct FieldTable;
+
+  template<class T, auto... Members>
+  struct FieldTable<T, Fields<Members...>>
+  {
+    static constexpr size_t count = sizeof...(Members);
+
+    /// Storage for a `T` that is never constructed, to take offsets in.
+    union Layout
+    {
+      T t;
+      char c;
+
+      Layout() : c() {}
+      ~Layout() {}
+    };
+
+    template<auto Member>
+    static uint32_t offset(const Layout& l)
+    {
+      using Field =
+        std::remove_cv_t<std::remove_reference_t<decltype(l.t.*Member)>>;
+      static_assert(std::is_pointer_v<Field>, "Fields must be pointers");
+      static_assert(
+        std::is_base_of_v<Object, std::remove_pointer_t<Field>>,
+        "Fields must point to Objects");
+
+      auto base = (uintptr_t)(static_cast<const Object*>(&l.t));
+      auto field = (uintptr_t)(&(l.t.*Member));
+      return (uint32_t)(field - base);
+    }
+
+    static const uint32_t* offsets()
+    {
+      // One spare entry, so that there is an array when there are no fields.
+      static const Layout layout;
+      static const uint32_t table[count + 1] = {offset<Members>(layout)..., 0};
+      return table;
+    }
+
+    static void trace(const Object* o, ObjectStack& st)
+    {
+      auto* fields = offsets();
+      for (size_t i = 0; i < count; i++)
+      {
+        auto p = *(Object* const*)((uintptr_t)o + fields[i]);
+        if (p != nullptr)
+          st.push(p);
+      }
+    }
+  };
+
+  template<class T, class = void>
+  struct field_list
+  {
+    using type = Fields<>;
+  };
+  template<class T>
+  struct field_list<T, std::void_t<typename T::fields>>
+  {
+    using type = typename T::fields;
+  };
+
   /**
    * Common base class for V and VCown to build descriptors
    * from C++ objects using compile time reflection.
@@ -49,9 +148,33 @@ namespace verona::rt
   class VBase : public Base
   {
   private:
+    static constexpr bool has_field_table()
+    {
+      return has_fields<T>::value || has_no_pointers<T>::value;
+    }
+
     static void gc_trace(const Object* o, ObjectStack& st)
     {
-      ((T*)o)->trace(st);
+      if constexpr (has_field_table())
+        FieldTable<T, typename field_list<T>::type>::trace(o, st);
+      else
+        ((T*)o)->trace(st);
+    }
+
+    static const uint32_t* field_offsets()
+    {
+      if constexpr (has_field_table())
+        return FieldTable<T, typename field_list<T>::type>::offsets();
+      else
+        return nullptr;
+    }
+
+    static size_t field_count()
+    {
+      if constexpr (has_field_table())
+        return FieldTable<T, typename field_list<T>::type>::count;
+      else
+        return 0;
     }
 
     static void gc_notified(Object* o)
@@ -93,7 +216,9 @@ namespace verona::rt
         gc_trace,
         has_finaliser<T>::value ? gc_final : nullptr,
         has_notified<T>::value ? gc_notified : nullptr,
-        has_destructor<T>::value ? gc_destructor : nullptr};
+        has_destructor<T>::value ? gc_destructor : nullptr,
+        field_offsets(),
+        field_count()};
 
       return &desc;
     }
@@ -156,18 +281,22 @@ namespace verona::rt
   /**
    * Converts a C++ class into a Verona Cown
    *
-   * Will fill the Verona descriptor with relevant fields.
+   * Will fill the Verona descriptor with relevant fields.  If `write_only`,
+   * the cown is a `Cown` rather than a `ReadableCown`, and must never be
+   * acquired for reading.
    */
-  template<class T>
-  class VCown : public VBase<T, Cown>
+  template<class T, bool write_only = false>
+  class VCown
+  : public VBase<T, std::conditional_t<write_only, Cown, ReadableCown>>
   {
+    using Base = VBase<T, std::conditional_t<write_only, Cown, ReadableCown>>;
+
   public:
-    VCown() : VBase<T, Cown>() {}
+    VCown() : Base() {}
 
     void* operator new(size_t)
     {
-      return Object::register_object(
-        heap::alloc<vsizeof<T>>(), VBase<T, Cown>::desc());
+      return Object::register_object(heap::alloc<vsizeof<T>>(), Base::desc());
     }
   };
 } // namespace verona::rt
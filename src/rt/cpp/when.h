@@ -3,12 +3,28 @@
 #pragma once
 
 #include "../sched/behaviour.h"
+#include "actor.h"
+#include "arena.h"
+#include "cancellation.h"
 #include "cown.h"
 #include "cown_array.h"
-
+#include "cown_set.h"
+#include "finish_scope.h"
+#include "fusion.h"
+#include "io.h"
+#include "notification.h"
+#include "parallel.h"
+#include "task_group.h"
+
+#include <algorithm>
+#include <chrono>
 #include <functional>
+#include <optional>
+#include <thread>
 #include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
 #include <verona.h>
 
 namespace verona::cpp
@@ -53,73 +69,127 @@ namespace verona::cpp
    * Used to track the type of access request in the case of cown_array
    * Ownership is handled the same for all cown_ptr in the span.
    * If is_move is true, all cown_ptrs will be moved.
+   *
+   * This holds the `acquired_cown` for each cown, followed by space for the
+   * requests that schedule the behaviour.  Up to `INLINE_COWNS` cowns are
+   * held inline, and larger batches make a single allocation.  It moves into
+   * the behaviour with the closure, so the span itself, which may be borrowed,
+   * is only needed until the behaviour is scheduled.
    */
   template<typename T>
   class AccessBatch
   {
+  public:
+    /// Largest batch that does not allocate.
+    static constexpr size_t INLINE_COWNS = 4;
+
+  private:
     using Type = T;
-    ActualCown<std::remove_const_t<T>>** act_array;
+
+    static constexpr size_t ENTRY_SIZE =
+      sizeof(acquired_cown<T>) + sizeof(Request);
+    static constexpr size_t INLINE_SIZE = INLINE_COWNS * ENTRY_SIZE;
+
     acquired_cown<T>* acq_array;
     size_t arr_len;
     bool is_move;
 
-    void constr_helper(const cown_array<T>& ptr_span)
+    /// Set if the cowns come from a cown_set, so are sorted and distinct.
+    bool presorted = false;
+
+    alignas(acquired_cown<T>) unsigned char inline_array[INLINE_SIZE];
+
+    acquired_cown<T>* inline_start()
     {
-      // Allocate the actual_cown and the acquired_cown array
-      // The acquired_cown array is after the actual_cown one
-      size_t act_size =
-        ptr_span.length * sizeof(ActualCown<std::remove_const_t<T>>*);
-      size_t acq_size =
-        ptr_span.length * sizeof(acquired_cown<std::remove_const_t<T>>);
-      act_array = reinterpret_cast<ActualCown<std::remove_const_t<T>>**>(
-        heap::alloc(act_size + acq_size));
+      return reinterpret_cast<acquired_cown<T>*>(inline_array);
+    }
 
-      for (size_t i = 0; i < ptr_span.length; i++)
-      {
-        act_array[i] = ptr_span.array[i].allocated_cown;
-      }
-      arr_len = ptr_span.length;
+    /// Point `acq_array` at space for `arr_len` cowns and their requests.
+    void alloc_array()
+    {
+      if (arr_len <= INLINE_COWNS)
+        acq_array = inline_start();
+      else
+        acq_array = reinterpret_cast<acquired_cown<T>*>(
+          heap::alloc(arr_len * ENTRY_SIZE));
+    }
 
-      acq_array =
-        reinterpret_cast<acquired_cown<T>*>((char*)(act_array) + act_size);
+    void constr_helper(const cown_array<T>& ptr_span)
+    {
+      arr_len = ptr_span.length;
+      alloc_array();
 
-      for (size_t i = 0; i < ptr_span.length; i++)
+      for (size_t i = 0; i < arr_len; i++)
       {
         new (&acq_array[i]) acquired_cown<T>(*ptr_span.array[i].allocated_cown);
       }
     }
 
+    ActualCown<std::remove_const_t<T>>* act(size_t i)
+    {
+      return &acq_array[i].origin_cown;
+    }
+
+    /// Space for `arr_len` requests, after the acquired cowns.
+    Request* requests()
+    {
+      return reinterpret_cast<Request*>(acq_array + arr_len);
+    }
+
   public:
     AccessBatch(const cown_array<T>& ptr_span) : is_move(false)
     {
       constr_helper(ptr_span);
     }
 
-    AccessBatch(cown_array<T>&& ptr_span) : is_move(true)
+    AccessBatch(const cown_set<T>& ptr_set) : is_move(false), presorted(true)
+    {
+      constr_helper(ptr_set);
+    }
+
+    /**
+     * Take over the references of an owning span, so that scheduling does
+     * not change the reference counts.  A borrowed span has no references
+     * to give, so is treated as a copy.
+     */
+    AccessBatch(cown_array<T>&& ptr_span) : is_move(ptr_span.owning)
     {
       constr_helper(ptr_span);
 
-      ptr_span.length = 0;
-      ptr_span.arary = nullptr;
+      if (is_move)
+        ptr_span.forget();
     }
 
+    /**
+     * An inline batch is copied.  The requests are not, as they are built in
+     * the batch the closure was moved from, which outlives scheduling, see
+     * `When::to_tuple`.
+     */
     AccessBatch(AccessBatch&& old)
     {
-      act_array = old.act_array;
-      acq_array = old.acq_array;
       arr_len = old.arr_len;
       is_move = old.is_move;
+      presorted = old.presorted;
 
-      old.acq_array = nullptr;
-      old.act_array = nullptr;
-      old.arr_len = 0;
+      if (old.acq_array == old.inline_start())
+      {
+        acq_array = inline_start();
+        for (size_t i = 0; i < arr_len; i++)
+          new (&acq_array[i]) acquired_cown<T>(*old.act(i));
+      }
+      else
+      {
+        acq_array = old.acq_array;
+        old.acq_array = nullptr;
+        old.arr_len = 0;
+      }
     }
 
     ~AccessBatch()
     {
-      if (act_array)
+      if (acq_array && (acq_array != inline_start()))
       {
-        heap::dealloc(act_array);
+        heap::dealloc(acq_array);
       }
     }
 
@@ -131,6 +201,48 @@ namespace verona::cpp
     friend class When;
   };
 
+  /**
+   * Used to wait for a `Promise` in a `when`, by reading the promise cown.
+   * The behaviour's slot on the promise queues behind the slot the promise
+   * holds until it is settled, so the behaviour is only resolved once the
+   * promise is fulfilled, or its writer is dropped, along with its other
+   * cowns.  The closure is passed the value, see `Promise::settled_value`.
+   */
+  template<typename T>
+  class AccessPromise
+  {
+    using Type = T;
+    Promise<T>* t;
+    bool is_move;
+
+  public:
+    /// Takes a new reference, which the behaviour owns.
+    AccessPromise(typename Promise<T>::PromiseR& r)
+    : t(r.template get_promise<NoTransfer>()), is_move(true)
+    {
+      assert(t != nullptr);
+    }
+
+    AccessPromise(typename Promise<T>::PromiseR&& r)
+    : t(r.template get_promise<YesTransfer>()), is_move(true)
+    {
+      assert(t != nullptr);
+    }
+
+    template<typename F, typename... Args>
+    friend class When;
+  };
+
+  /// True for the read end-point of a `Promise`.
+  template<typename R, typename = void>
+  struct is_promise_reader : std::false_type
+  {};
+
+  template<typename R>
+  struct is_promise_reader<R, std::void_t<typename R::promise_type>>
+  : std::is_same<R, typename R::promise_type::PromiseR>
+  {};
+
   template<typename T>
   auto convert_access(const cown_ptr<T>& c)
   {
@@ -149,6 +261,29 @@ namespace verona::cpp
     return AccessBatch<T>(c);
   }
 
+  template<typename T>
+  auto convert_access(cown_array<T>&& c)
+  {
+    return AccessBatch<T>(std::move(c));
+  }
+
+  template<typename T>
+  auto convert_access(const cown_set<T>& c)
+  {
+    return AccessBatch<T>(c);
+  }
+
+  template<
+    typename R,
+    typename = std::enable_if_t<is_promise_reader<std::decay_t<R>>::value>>
+  auto convert_access(R&& r)
+  {
+    return AccessPromise<typename std::decay_t<R>::value_type>(
+      std::forward<R>(r));
+  }
+
+  class dynamic_batch;
+
   template<typename... Args>
   class Batch
   {
@@ -167,6 +302,8 @@ namespace verona::cpp
     template<typename... Args2>
     friend class Batch;
 
+    friend class dynamic_batch;
+
     template<size_t index = 0>
     void create_behaviour(BehaviourCore** barray)
     {
@@ -177,6 +314,8 @@ namespace verona::cpp
       else
       {
         auto&& w = std::get<index>(when_batch);
+        // Must be read before `to_tuple` moves the cowns out.
+        bool presorted = w.is_presorted();
         // Add the behaviour here
         auto t = w.to_tuple();
         barray[index] = Behaviour::prepare_to_schedule<
@@ -184,6 +323,15 @@ namespace verona::cpp
           std::move(std::get<0>(t)),
           std::move(std::get<1>(t)),
           std::move(std::get<2>(t)));
+        barray[index]->affinity = w.affinity;
+        barray[index]->priority = w.priority;
+        barray[index]->deadline = w.deadline;
+        barray[index]->presorted = presorted;
+        if (w.cancel_token != nullptr)
+        {
+          w.cancel_token->acquire();
+          barray[index]->cancellation = w.cancel_token;
+        }
         create_behaviour<index + 1>(barray);
       }
     }
@@ -207,6 +355,20 @@ namespace verona::cpp
       }
     }
 
+    /**
+     * Attach `c` to every behaviour in the batch, see `cancellation`.  The
+     * batch is only scheduled at the end of the statement, so this must be
+     * applied to the whole batch:
+     *
+     *   ((when(a) << f) + (when(b) << g)).cancel_with(c);
+     */
+    Batch& cancel_with(const cancellation& c)
+    {
+      std::apply(
+        [&](auto&... w) { ((w.cancel_token = c.get()), ...); }, when_batch);
+      return *this;
+    }
+
     template<typename... Args2>
     auto operator+(Batch<Args2...>&& wb)
     {
@@ -234,6 +396,9 @@ namespace verona::cpp
     template<class T>
     struct is_read_only<AccessBatch<const T>&> : std::true_type
     {};
+    template<class T>
+    struct is_read_only<AccessPromise<T>&> : std::true_type
+    {};
 
     template<class T>
     struct is_batch : std::false_type
@@ -245,6 +410,25 @@ namespace verona::cpp
     template<typename... Args2>
     friend class Batch;
 
+    template<typename... Args2>
+    friend class NoAllocPreWhen;
+
+    template<typename... Args2>
+    friend class BoundedPreWhen;
+
+    /// Number of requests for an argument that fit in `requests`, which is
+    /// enough for batches that are held inline.
+    template<class T>
+    struct inline_requests : std::integral_constant<size_t, 1>
+    {};
+    template<class T>
+    struct inline_requests<AccessBatch<T>>
+    : std::integral_constant<size_t, AccessBatch<T>::INLINE_COWNS>
+    {};
+
+    static constexpr size_t INLINE_REQUESTS =
+      (0 + ... + inline_requests<Args>::value);
+
     /// Set of cowns used by this behaviour.
     std::tuple<Args...> cown_tuple;
 
@@ -254,15 +438,28 @@ namespace verona::cpp
     /// Used as a temporary to build the behaviour.
     /// The stack lifetime is tricky, and this avoids
     /// a heap allocation.
-    Request requests[sizeof...(Args)];
+    Request requests[INLINE_REQUESTS];
 
-    // If cown_ptr spans provided more requests are required
+    // If large cown_ptr spans are provided more requests are required
     // and thus are dynamically allocated.
     // If is_req_extended is true, then req_extended holds an array of Request
     // and the above requests[] array is not used.
     Request* req_extended;
     bool is_req_extended;
 
+    /// If set, the core the behaviour should be scheduled on.
+    Core* affinity = nullptr;
+
+    /// Scheduling class of the behaviour.
+    Priority priority = Priority::Normal;
+
+    /// If non-zero, the deadline of the behaviour, see `DeadlineQueue::now`.
+    uint64_t deadline = 0;
+
+    /// If set, cancels the behaviour, see `cancellation`.  Not counted, as
+    /// the token outlives the statement that schedules the behaviour.
+    Cancellation* cancel_token = nullptr;
+
     /**
      * This uses template programming to turn the std::tuple into a C style
      * stack allocated array.
@@ -283,6 +480,15 @@ namespace verona::cpp
       assert(req->cown() != nullptr);
     }
 
+    template<typename C>
+    static void array_assign_helper_access(Request* req, AccessPromise<C>& p)
+    {
+      // Many behaviours may wait for the same promise.
+      *req = Request::read(p.t);
+      if (p.is_move)
+        req->mark_move();
+    }
+
     template<typename C>
     static size_t
     array_assign_helper_access_batch(Request* req, AccessBatch<C>& p)
@@ -291,9 +497,9 @@ namespace verona::cpp
       for (size_t i = 0; i < p.arr_len; i++)
       {
         if constexpr (is_read_only<decltype(p)>())
-          *req = Request::read(p.act_array[i]);
+          *req = Request::read(p.act(i));
         else
-          *req = Request::write(p.act_array[i]);
+          *req = Request::write(p.act(i));
 
         if (p.is_move)
           req->mark_move();
@@ -372,6 +578,89 @@ namespace verona::cpp
       return acquired_cown<C>(*c.t);
     }
 
+    template<typename C>
+    static auto access_to_acquired(AccessPromise<C>& c)
+    {
+      return c.t->settled_value();
+    }
+
+    /**
+     * Maintain the version count of cowns that are written, for optimistic
+     * reads, and publish their snapshots, for snapshot reads.  These do
+     * nothing for the cowns of other types.
+     * @{
+     */
+    template<typename C>
+    static void begin_write(Access<C>& c)
+    {
+      if constexpr (!std::is_const_v<C>)
+        c.t->begin_write();
+    }
+
+    template<typename C>
+    static void begin_write(AccessPromise<C>&)
+    {}
+
+    template<typename C>
+    static void begin_write(AccessBatch<C>& c)
+    {
+      if constexpr (!std::is_const_v<C> && tracks_writes<C>::value)
+      {
+        for (size_t i = 0; i < c.arr_len; i++)
+          c.act(i)->begin_write();
+      }
+    }
+
+    template<typename C>
+    static void end_write(Access<C>& c)
+    {
+      if constexpr (!std::is_const_v<C>)
+        c.t->end_write();
+    }
+
+    template<typename C>
+    static void end_write(AccessPromise<C>&)
+    {}
+
+    template<typename C>
+    static void end_write(AccessBatch<C>& c)
+    {
+      if constexpr (!std::is_const_v<C> && tracks_writes<C>::value)
+      {
+        for (size_t i = 0; i < c.arr_len; i++)
+          c.act(i)->end_write();
+      }
+    }
+    /// @}
+
+    /**
+     * True if the requests are already in acquire order with no duplicates,
+     * which is the case for a `when` over a single cown_set.
+     */
+    bool is_presorted()
+    {
+      if constexpr (sizeof...(Args) == 1)
+      {
+        auto& p = std::get<0>(cown_tuple);
+        if constexpr (is_batch<
+                        typename std::remove_reference<decltype(p)>::type>())
+          return p.presorted;
+      }
+      return false;
+    }
+
+    /**
+     * True for a `when` over a single cown_array, whose requests are built
+     * in the batch's own allocation.
+     */
+    static constexpr bool is_single_batch()
+    {
+      if constexpr (sizeof...(Args) == 1)
+        return is_batch<std::tuple_element_t<0, std::tuple<Args...>>>();
+      else
+        return false;
+    }
+
     auto to_tuple()
     {
       if constexpr (sizeof...(Args) == 0)
@@ -383,6 +672,8 @@ namespace verona::cpp
         Request* r;
         if (is_req_extended)
           r = req_extended;
+        else if constexpr (is_single_batch())
+          r = std::get<0>(cown_tuple).requests();
         else
           r = reinterpret_cast<Request*>(&requests);
 
@@ -395,7 +686,9 @@ namespace verona::cpp
             /// Effectively converts ActualCown<T>... to
             /// acquired_cown... .
             auto lift_f = [f = std::move(f)](Args... args) mutable {
+              (begin_write(args), ...);
               std::move(f)(access_to_acquired<typename Args::Type>(args)...);
+              (end_write(args), ...);
             };
 
             std::apply(std::move(lift_f), std::move(cown_tuple));
@@ -403,16 +696,76 @@ namespace verona::cpp
       }
     }
 
+#ifdef USE_QUEUE_DEPTH
+    /**
+     * Deepest queue of the cowns in `cowns`, see `Cown::queue_depth`.
+     * @{
+     */
+    template<typename C>
+    static size_t queue_depth(Access<C>& c)
+    {
+      return c.t->queue_depth();
+    }
+
+    template<typename C>
+    static size_t queue_depth(AccessPromise<C>& c)
+    {
+      return c.t->queue_depth();
+    }
+
+    template<typename C>
+    static size_t queue_depth(AccessBatch<C>& c)
+    {
+      size_t depth = 0;
+      for (size_t i = 0; i < c.arr_len; i++)
+        depth = std::max(depth, c.act(i)->queue_depth());
+      return depth;
+    }
+
+    static size_t queue_depth(std::tuple<Args...>& cowns)
+    {
+      return std::apply(
+        [](auto&... c) { return std::max({size_t{0}, queue_depth(c)...}); },
+        cowns);
+    }
+    /// @}
+#endif
+
+    /**
+     * Size of the behaviour this creates, which is only known statically if
+     * there are no batches.
+     */
+    static constexpr size_t behaviour_size()
+    {
+      static_assert(
+        sizeof...(Args) > 0 && !(is_batch<Args>() || ...),
+        "The size of the behaviour depends on the length of the batches");
+      using Be = std::remove_reference_t<decltype(std::get<2>(
+        std::declval<When&>().to_tuple()))>;
+      return BehaviourCore::alloc_size(
+        sizeof...(Args), sizeof(Be), alignof(Be));
+    }
+
   public:
     When(F&& f_) : f(std::forward<F>(f_)) {}
 
-    When(F&& f_, std::tuple<Args...> cown_tuple_)
+    When(
+      F&& f_,
+      std::tuple<Args...> cown_tuple_,
+      Core* affinity_ = nullptr,
+      Priority priority_ = Priority::Normal,
+      uint64_t deadline_ = 0,
+      Cancellation* cancel_token_ = nullptr)
     : f(std::forward<F>(f_)),
       cown_tuple(std::move(cown_tuple_)),
-      is_req_extended(false)
+      is_req_extended(false),
+      affinity(affinity_),
+      priority(priority_),
+      deadline(deadline_),
+      cancel_token(cancel_token_)
     {
       const size_t req_count = get_cown_count();
-      if (req_count > sizeof...(Args))
+      if ((req_count > INLINE_REQUESTS) && !is_single_batch())
       {
         is_req_extended = true;
         req_extended = reinterpret_cast<Request*>(
@@ -424,7 +777,11 @@ namespace verona::cpp
     : cown_tuple(std::move(o.cown_tuple)),
       f(std::forward<F>(o.f)),
       is_req_extended(o.is_req_extended),
-      req_extended(o.req_extended)
+      req_extended(o.req_extended),
+      affinity(o.affinity),
+      priority(o.priority),
+      deadline(o.deadline),
+      cancel_token(o.cancel_token)
     {
       o.req_extended = nullptr;
       o.is_req_extended = false;
@@ -461,33 +818,321 @@ namespace verona::cpp
     template<typename... Args2>
     friend auto when(Args2&&... args);
 
+    template<typename... Args2>
+    friend class NoAllocPreWhen;
+
+    template<typename... Args2>
+    friend class BoundedPreWhen;
+
     /**
      * Internally uses AcquiredCown.  The cown is only acquired after the
      * behaviour is scheduled.
      */
     std::tuple<Args...> cown_tuple;
 
+    /// If set, the core the behaviour should be scheduled on.
+    Core* affinity = nullptr;
+
+    /// Scheduling class of the behaviour.
+    Priority priority = Priority::Normal;
+
+    /// If non-zero, the deadline of the behaviour, see `DeadlineQueue::now`.
+    uint64_t deadline = 0;
+
+    /// If set, cancels the behaviour, see `cancellation`.
+    Cancellation* cancel_token = nullptr;
+
     PreWhen(Args... args) : cown_tuple(std::move(args)...) {}
 
+    /// Schedule a closure that has no cowns.
+    template<typename F>
+    void schedule_now(F&& f)
+    {
+      if (deadline != 0)
+        verona::rt::schedule_lambda_deadline(
+          affinity, deadline, std::forward<F>(f));
+      else if (priority == Priority::Critical)
+        verona::rt::schedule_lambda_critical(affinity, std::forward<F>(f));
+      else if (priority == Priority::High)
+        verona::rt::schedule_lambda_high(affinity, std::forward<F>(f));
+      else if (affinity != nullptr)
+        verona::rt::schedule_lambda_on(affinity, std::forward<F>(f));
+      else
+        verona::rt::schedule_lambda(std::forward<F>(f));
+    }
+
   public:
+    /**
+     * Hint that the behaviour should run on `core`, once all its cowns are
+     * available.
+     *
+     *   when (cown1, ..., cownn).on(core) << closure;
+     */
+    PreWhen& on(Core* core)
+    {
+      affinity = core;
+      return *this;
+    }
+
+    /**
+     * Hint that the behaviour should run on a core on the NUMA node `node`.
+     */
+    PreWhen& on_numa_node(size_t node)
+    {
+      return on(Scheduler::get_core_on_numa_node(node));
+    }
+
+    /**
+     * Set the scheduling class of the behaviour.  High priority behaviours
+     * run ahead of normal ones once their cowns are available, and critical
+     * ones only on the reserved cores, see
+     * `ThreadPool::set_reserved_core_count`.
+     *
+     *   when (cown1, ..., cownn).with_priority(Priority::High) << closure;
+     */
+    PreWhen& with_priority(Priority p)
+    {
+      priority = p;
+      return *this;
+    }
+
+    /**
+     * Set a deadline `d` from now by which the behaviour should start.  Once
+     * their cowns are available, behaviours with deadlines run in earliest
+     * deadline first order, ahead of other work.
+     *
+     *   when (cown1, ..., cownn).with_deadline(std::chrono::milliseconds(5))
+     *     << closure;
+     */
+    template<typename Rep, typename Period>
+    PreWhen& with_deadline(std::chrono::duration<Rep, Period> d)
+    {
+      // Zero means no deadline.
+      deadline = std::max<uint64_t>(
+        DeadlineQueue::now() +
+          std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(),
+        1);
+      return *this;
+    }
+
+    /**
+     * Skip the closure if `c` is cancelled before the behaviour starts, see
+     * `cancellation`.
+     *
+     *   when (cown1, ..., cownn).cancel_with(c) << closure;
+     */
+    PreWhen& cancel_with(const cancellation& c)
+    {
+      cancel_token = c.get();
+      return *this;
+    }
+
     template<typename F>
     auto operator<<(F&& f)
     {
+      // Keep this behaviour after the closures this thread has fused.
+      Fusion::flush();
       Scheduler::stats().behaviour(sizeof...(Args));
 
       if constexpr (sizeof...(Args) == 0)
       {
         // Execute now atomic batch makes no sense.
-        verona::rt::schedule_lambda(std::forward<F>(f));
+        if (cancel_token != nullptr)
+        {
+          cancel_token->acquire();
+          schedule_now(
+            [c = cancel_token, f = std::forward<F>(f)]() mutable {
+              bool cancelled = c->is_cancelled();
+              c->release();
+              if (cancelled)
+                Scheduler::stats().cancelled();
+              else
+                f();
+            });
+        }
+        else
+        {
+          schedule_now(std::forward<F>(f));
+        }
         return Batch(std::make_tuple());
       }
       else
       {
-        return Batch(
-          std::make_tuple(When(std::forward<F>(f), std::move(cown_tuple))));
+        return Batch(std::make_tuple(
+          When(
+            std::forward<F>(f),
+            std::move(cown_tuple),
+            affinity,
+            priority,
+            deadline,
+            cancel_token)));
+      }
+    }
+  };
+
+  /**
+   * Class for staging a `when_noalloc`.  This is a `PreWhen` that checks the
+   * closure fits in a pooled behaviour.
+   */
+  template<typename... Args>
+  class NoAllocPreWhen
+  {
+    template<typename... Args2>
+    friend auto when_noalloc(Args2&&... args);
+
+    PreWhen<Args...> pre;
+
+    NoAllocPreWhen(Args... args) : pre(std::move(args)...) {}
+
+  public:
+    /// See `PreWhen::on`.
+    NoAllocPreWhen& on(Core* core)
+    {
+      pre.on(core);
+      return *this;
+    }
+
+    /// See `PreWhen::with_priority`.
+    NoAllocPreWhen& with_priority(Priority p)
+    {
+      pre.with_priority(p);
+      return *this;
+    }
+
+    /// See `PreWhen::with_deadline`.
+    template<typename Rep, typename Period>
+    NoAllocPreWhen& with_deadline(std::chrono::duration<Rep, Period> d)
+    {
+      pre.with_deadline(d);
+      return *this;
+    }
+
+    /// See `PreWhen::cancel_with`.
+    NoAllocPreWhen& cancel_with(const cancellation& c)
+    {
+      pre.cancel_with(c);
+      return *this;
+    }
+
+    template<typename F>
+    auto operator<<(F&& f)
+    {
+      static_assert(
+        When<std::decay_t<F>, Args...>::behaviour_size() <=
+          BehaviourPool::MAX_POOLED,
+        "The closure and cowns of when_noalloc must fit in a pooled "
+        "behaviour");
+      return pre << std::forward<F>(f);
+    }
+  };
+
+#ifdef USE_QUEUE_DEPTH
+  /**
+   * What `when_bounded` does when a cown's queue is too deep.
+   */
+  enum class Overload
+  {
+    /// Do not schedule the behaviour.
+    Reject,
+    /**
+     * Do not schedule the behaviour, and run the calling behaviour again,
+     * still holding its cowns, once other work on its core has run, see
+     * `Behaviour::rerun`.  The caller must return, and send again when it
+     * reruns.  Only for use from a behaviour.
+     */
+    Mute,
+    /**
+     * Wait for the queues to drain, then schedule the behaviour.  Only for
+     * use from threads outside the runtime, as the cowns may be waiting for
+     * the caller.
+     */
+    Block,
+  };
+
+  /**
+   * Class for staging a `when_bounded`.  This is a `PreWhen` that only
+   * schedules the behaviour if the queues of its cowns are shallow enough.
+   */
+  template<typename... Args>
+  class BoundedPreWhen
+  {
+    template<typename... Args2>
+    friend auto when_bounded(size_t limit, Overload overload, Args2&&... args);
+
+    PreWhen<Args...> pre;
+    size_t limit;
+    Overload overload;
+
+    BoundedPreWhen(size_t limit_, Overload overload_, Args... args)
+    : pre(std::move(args)...), limit(limit_), overload(overload_)
+    {}
+
+  public:
+    /// See `PreWhen::on`.
+    BoundedPreWhen& on(Core* core)
+    {
+      pre.on(core);
+      return *this;
+    }
+
+    /// See `PreWhen::with_priority`.
+    BoundedPreWhen& with_priority(Priority p)
+    {
+      pre.with_priority(p);
+      return *this;
+    }
+
+    /// See `PreWhen::with_deadline`.
+    template<typename Rep, typename Period>
+    BoundedPreWhen& with_deadline(std::chrono::duration<Rep, Period> d)
+    {
+      pre.with_deadline(d);
+      return *this;
+    }
+
+    /// See `PreWhen::cancel_with`.
+    BoundedPreWhen& cancel_with(const cancellation& c)
+    {
+      pre.cancel_with(c);
+      return *this;
+    }
+
+    /**
+     * Schedule the closure, unless a cown has `limit` or more behaviours
+     * queued on it, or fewer under memory pressure, see
+     * `MemoryPressure::admission_limit`.  Returns true if the closure was
+     * scheduled.  This is a single behaviour, so is not combined into a
+     * batch.
+     */
+    template<typename F>
+    bool operator<<(F&& f)
+    {
+      using W = When<std::decay_t<F>, Args...>;
+      while (W::queue_depth(pre.cown_tuple) >=
+             MemoryPressure::admission_limit(limit))
+      {
+        switch (overload)
+        {
+          case Overload::Reject:
+            return false;
+
+          case Overload::Mute:
+            assert(Behaviour::in_behaviour());
+            Behaviour::rerun();
+            return false;
+
+          case Overload::Block:
+            assert(Scheduler::local_core() == nullptr);
+            std::this_thread::yield();
+            break;
+        }
       }
+
+      pre << std::forward<F>(f);
+      return true;
     }
   };
+#endif
 
   /**
    * Template deduction guide for Access.
@@ -501,6 +1146,69 @@ namespace verona::cpp
   template<typename... Args>
   Batch(std::tuple<Args...>) -> Batch<Args...>;
 
+  /**
+   * A batch whose size is only known at runtime.  The behaviours added to it
+   * are scheduled atomically, as with `+`, by `schedule` or at the end of its
+   * lifetime.
+   *
+   *   dynamic_batch b;
+   *   for (auto& piece : pieces)
+   *     b += when(piece.a, piece.b) << [](auto a, auto b) { ... };
+   *   b.schedule();
+   *
+   * A `when` with no cowns is still run straight away.
+   */
+  class dynamic_batch
+  {
+    std::vector<BehaviourCore*> behaviours;
+
+  public:
+    /// An empty batch, with room for `capacity` behaviours.
+    dynamic_batch(size_t capacity = 0)
+    {
+      behaviours.reserve(capacity);
+    }
+
+    dynamic_batch(const dynamic_batch&) = delete;
+
+    ~dynamic_batch()
+    {
+      schedule();
+    }
+
+    template<typename... Args>
+    dynamic_batch& operator+=(Batch<Args...>&& b)
+    {
+      b.part_of_larger_batch = true;
+      if constexpr (sizeof...(Args) > 0)
+      {
+        size_t first = behaviours.size();
+        behaviours.resize(first + sizeof...(Args));
+        b.create_behaviour(&behaviours[first]);
+      }
+      return *this;
+    }
+
+    /// Number of behaviours waiting to be scheduled.
+    size_t size() const
+    {
+      return behaviours.size();
+    }
+
+    /**
+     * Schedule the behaviours added so far in one atomic step, and empty the
+     * batch.
+     */
+    void schedule()
+    {
+      if (behaviours.empty())
+        return;
+
+      BehaviourCore::schedule_many(behaviours.data(), behaviours.size());
+      behaviours.clear();
+    }
+  };
+
   /**
    * Implements a Verona-like `when` statement.
    *
@@ -511,6 +1219,12 @@ namespace verona::cpp
    * cown_array<A1>&& )... To get the universal reference type to work, we
    * can't place this constraint on it directly, as it needs to be on a type
    * argument.
+   *
+   * The read end-point of a `Promise` can also be passed, and the closure
+   * is then passed its value once it is settled, see `AccessPromise`:
+   *
+   *   when(promise_r, cown_a) << [](std::variant<T, PromiseErr> v,
+   *                                 acquired_cown<A> a) { ... };
    */
   template<typename... Args>
   auto when(Args&&... args)
@@ -518,4 +1232,132 @@ namespace verona::cpp
     return PreWhen(convert_access(std::forward<Args>(args))...);
   }
 
+  /**
+   * A `when` that makes no allocation other than the behaviour.  It is a
+   * compile error if the cowns include a `cown_array`, or if the behaviour
+   * would be larger than `BehaviourPool::MAX_POOLED`, so when built with
+   * `USE_BEHAVIOUR_POOL` the behaviour comes from the scheduler thread's pool.
+   *
+   *   when_noalloc(cown1, ..., cownn) << closure;
+   *
+   * A plain `when` also avoids allocating beyond the behaviour when its
+   * batches are small, see `AccessBatch`, but this states the intent and
+   * checks it.
+   */
+  template<typename... Args>
+  auto when_noalloc(Args&&... args)
+  {
+    return NoAllocPreWhen(convert_access(std::forward<Args>(args))...);
+  }
+
+#ifdef USE_QUEUE_DEPTH
+  /**
+   * A `when` with admission control: if any of the cowns already has `limit`
+   * behaviours queued or running on it, see `Cown::queue_depth`, the
+   * behaviour is handled by `overload` instead of joining the queues.
+   *
+   *   if (!(when_bounded(64, Overload::Mute, cown1, ..., cownn) << closure))
+   *     return;
+   *
+   * The depth is approximate, as other threads may be scheduling on the
+   * same cowns, so the limit may be slightly exceeded.  Under memory
+   * pressure the limit is lowered, see `ThreadPool::memory_pressure`.
+   * Only built with `USE_QUEUE_DEPTH`.
+   */
+  template<typename... Args>
+  auto when_bounded(size_t limit, Overload overload, Args&&... args)
+  {
+    static_assert(sizeof...(Args) > 0, "when_bounded needs at least one cown");
+    return BoundedPreWhen(
+      limit, overload, convert_access(std::forward<Args>(args))...);
+  }
+#endif
+
+  /**
+   * Run `compute` on the value of `c` without acquiring it, and pass the
+   * result to `consume`.  If a writer interferes, see
+   * `cown_ptr::try_read_optimistic`, this falls back to running both in a
+   * behaviour that reads `c`.
+   *
+   *   when_optimistic(table, [](const Table& t) { return t.lookup(k); },
+   *                   [](Route r) { ... });
+   *
+   * `compute` may run more than once, and on an inconsistent value, so it
+   * must be free of side effects, whereas `consume` runs exactly once.  The
+   * optimistic path runs on the calling thread.  Requires
+   * `optimistic_reads<T>`.
+   */
+  template<typename T, typename Compute, typename Consume>
+  void when_optimistic(const cown_ptr<T>& c, Compute compute, Consume consume)
+  {
+    using R = std::invoke_result_t<Compute&, const std::remove_const_t<T>&>;
+
+    std::optional<R> result;
+    if (c.try_read_optimistic(
+          [&](const std::remove_const_t<T>& v) { result.emplace(compute(v)); }))
+    {
+      consume(std::move(*result));
+      return;
+    }
+
+    using Value = const std::remove_const_t<T>;
+    when(read(c)) <<
+      [compute = std::move(compute),
+       consume = std::move(consume)](acquired_cown<Value> v) mutable {
+        consume(compute(*v));
+      };
+  }
+
+  /**
+   * Builds the behaviours for `when_bulk`.
+   */
+  struct Bulk
+  {
+    template<typename T, typename F>
+    static BehaviourCore* make(const cown_ptr<T>& c, const F& f)
+    {
+      auto* t = c.allocated_cown;
+      assert(t != nullptr);
+
+      auto* body = Behaviour::make(1, [f, t]() mutable {
+        t->begin_write();
+        std::move(f)(acquired_cown<T>(*t));
+        t->end_write();
+      });
+      new (body->get_slots()) Slot(t);
+      body->enter_queues();
+      return body;
+    }
+  };
+
+  /**
+   * Schedule one behaviour for each (cown, closure) pair in the range
+   * [first, last), which runs the closure with exclusive access to the cown.
+   * The closures are copied and the cown_ptrs are not consumed.
+   *
+   *   std::vector<std::pair<cown_ptr<T>, F>> items = ...;
+   *   when_bulk(items.begin(), items.end());
+   *
+   * The behaviours for the same cown run in the order of the range, but the
+   * range is not an atomic batch.  This is cheaper than a `when` per pair, as
+   * the behaviours for each cown join its queue together, see
+   * `BehaviourCore::schedule_bulk`.
+   */
+  template<typename It>
+  void when_bulk(It first, It last)
+  {
+    size_t count = static_cast<size_t>(std::distance(first, last));
+    StackArray<BehaviourCore*> bodies(count);
+
+    size_t i = 0;
+    for (auto it = first; it != last; ++it)
+    {
+      Scheduler::stats().behaviour(1);
+      bodies[i++] = Bulk::make(std::get<0>(*it), std::get<1>(*it));
+    }
+
+    Fusion::flush();
+    BehaviourCore::schedule_bulk(bodies.get(), count);
+  }
+
 } // namespace verona::cpp
@@ -0,0 +1,206 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+/**
+ * A cost model for systematic testing, to compare scheduling policies, such
+ * as stealing or batching, deterministically.
+ *
+ * Systematic testing runs one thread at a time, in an order chosen by the
+ * seed, so wall clock time says nothing about how a workload would scale.
+ * Once `CostModel::enable` is called, each scheduler thread instead has a
+ * virtual clock, advanced by a fixed number of cycles for each behaviour it
+ * runs, each steal and each enqueue onto another core.  A behaviour starts no
+ * earlier than the clock of the thread that made it runnable, so the clocks
+ * respect the dependencies between behaviours.
+ *
+ * `report` then gives, for the run so far,
+ *
+ *   work         the cycles of all behaviours,
+ *   span         the cycles of the longest chain of behaviours, each made
+ *                runnable by the one before (the critical path),
+ *   makespan     the latest clock, which is how long the run takes on the
+ *                virtual cores, including the cost of steals and enqueues,
+ *
+ * from which `speedup`, work over makespan, and `parallelism`, work over
+ * span, the speedup with unlimited cores, follow.  All of these depend only
+ * on the seed.  The harness enables the model with `--cost-model`.
+ *
+ * Without `USE_SYSTEMATIC_TESTING` the model does nothing.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+namespace verona::rt
+{
+  /// Cycles charged for each event by the `CostModel`.
+  struct CostModelCosts
+  {
+    uint64_t behaviour = 100;
+    uint64_t steal = 20;
+    uint64_t remote_enqueue = 5;
+  };
+
+  /// Stored in a behaviour when it becomes runnable.
+  struct CostModelStamp
+  {
+    /// Clock of the thread that made it runnable.
+    uint64_t ready = 0;
+    /// Length of the chain of behaviours that made it runnable.
+    uint64_t span = 0;
+  };
+
+  struct CostModelReport
+  {
+    uint64_t behaviours = 0;
+    uint64_t work = 0;
+    uint64_t span = 0;
+    uint64_t makespan = 0;
+
+    double speedup() const
+    {
+      return makespan == 0 ? 0 : (double)work / (double)makespan;
+    }
+
+    double parallelism() const
+    {
+      return span == 0 ? 0 : (double)work / (double)span;
+    }
+  };
+
+  class CostModel
+  {
+  public:
+    static constexpr bool enabled =
+#ifdef USE_SYSTEMATIC_TESTING
+      true;
+#else
+      false;
+#endif
+
+    using Costs = CostModelCosts;
+    using Stamp = CostModelStamp;
+    using Report = CostModelReport;
+
+  private:
+    /// The virtual clock of a thread.  It is reset the first time the thread
+    /// is used in each run.
+    struct Clock
+    {
+      uint64_t run = 0;
+      uint64_t time = 0;
+      /// Length of the chain ending with the last behaviour this thread ran.
+      uint64_t span = 0;
+    };
+
+    // Systematic testing runs one thread at a time, so this state needs no
+    // synchronisation.
+    static inline bool active = false;
+    static inline uint64_t run = 0;
+    static inline Costs costs;
+    static inline Report totals;
+
+    static Clock& clock()
+    {
+      static thread_local Clock clock;
+      if (clock.run != run)
+        clock = {run, 0, 0};
+      return clock;
+    }
+
+    static void charge(uint64_t cycles)
+    {
+      auto& c = clock();
+      c.time += cycles;
+      totals.makespan = std::max(totals.makespan, c.time);
+    }
+
+  public:
+    /**
+     * Start a new run of the model with the given costs, and clear the
+     * report.
+     */
+    static void enable(Costs c = {})
+    {
+      if constexpr (enabled)
+      {
+        active = true;
+        run++;
+        costs = c;
+        totals = {};
+      }
+      else
+      {
+        (void)c;
+      }
+    }
+
+    static void disable()
+    {
+      active = false;
+    }
+
+    static bool is_active()
+    {
+      return enabled && active;
+    }
+
+    /**
+     * Returns the stamp for a behaviour the current thread has made runnable.
+     */
+    static Stamp runnable()
+    {
+      if (!is_active())
+        return {};
+
+      auto& c = clock();
+      return {c.time, c.span};
+    }
+
+    /**
+     * Charge the current thread for starting a behaviour stamped `s`.
+     */
+    static void start(const Stamp& s)
+    {
+      if (!is_active())
+        return;
+
+      auto& c = clock();
+      c.time = std::max(c.time, s.ready);
+      c.span = s.span + costs.behaviour;
+      charge(costs.behaviour);
+
+      totals.behaviours++;
+      totals.work += costs.behaviour;
+      totals.span = std::max(totals.span, c.span);
+    }
+
+    static void steal()
+    {
+      if (is_active())
+        charge(costs.steal);
+    }
+
+    static void remote_enqueue()
+    {
+      if (is_active())
+        charge(costs.remote_enqueue);
+    }
+
+    static Report report()
+    {
+      return totals;
+    }
+
+    static void print(std::ostream& o, size_t cores)
+    {
+      auto r = report();
+      o << "Cost model: cores " << cores << " behaviours " << r.behaviours
+        << " work " << r.work << " span " << r.span << " makespan "
+        << r.makespan << " speedup " << r.speedup() << " parallelism "
+        << r.parallelism() << std::endl;
+    }
+  };
+} // namespace verona::rt
@@ -2,8 +2,12 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "perfresult.h"
+
 #include <cassert>
 #include <chrono>
+#include <cstring>
+#include <fstream>
 #include <list>
 #include <test/opt.h>
 #include <verona.h>
@@ -75,10 +79,25 @@ class SystematicTestHarness
    */
   std::list<PlatformThread> external_threads;
 
+  /**
+   * Set by `--json`, so that each call to `run` reports the time of each
+   * seed as a `PerfResult`, to `--output path` if given, and otherwise to
+   * standard output among the harness's own lines.  Results are named after
+   * the program, and the number of the call to `run`, so are stable as long
+   * as the program's calls are.
+   */
+  bool json = false;
+  std::ofstream json_file;
+  std::string program;
+  size_t run_count = 0;
+
 public:
   opt::Opt opt;
 
   bool detect_leaks;
+  /// Set by `--cost-model`, see `CostModel`.
+  bool cost_model;
+  CostModel::Costs costs;
   size_t cores;
   size_t seed_lower;
   size_t seed_upper;
@@ -93,6 +112,30 @@ public:
     for (int i = 0; i < argc; i++)
     {
       std::cout << " " << argv[i];
+      // `opt::Opt` only parses numbers.
+      if ((strcmp(argv[i], "--output") == 0) && (i + 1 < argc))
+        json_file.open(argv[i + 1], std::ios::app);
+      // As `VERONA_AFFINITY`, see `ThreadPool::set_affinity_policy`.
+      if ((strcmp(argv[i], "--affinity") == 0) && (i + 1 < argc))
+      {
+        AffinityPolicy policy;
+        std::vector<size_t> cpus;
+        if (!parse_affinity_policy(argv[i + 1], policy, cpus))
+          abort();
+        if (policy == AffinityPolicy::Explicit)
+          Scheduler::set_affinity_cpus(std::move(cpus));
+        else
+          Scheduler::set_affinity_policy(policy);
+      }
+    }
+
+    json = opt.has("--json");
+    if (argc > 0)
+    {
+      program = argv[0];
+      auto slash = program.find_last_of("/\\");
+      if (slash != std::string::npos)
+        program = program.substr(slash + 1);
     }
 
 #ifdef USE_SYSTEMATIC_TESTING
@@ -125,11 +168,21 @@ public:
     if (opt.has("--log-all") || (seed_lower + 1 == seed_upper))
       Logging::enable_logging();
 
+    // --cores 0 uses as many cores as this process can run on, taking any
+    // CPU quota into account.
     cores = opt.is<size_t>("--cores", 4);
+    if (cores == 0)
+      cores = Scheduler::default_thread_count();
 
     detect_leaks = !opt.has("--allow_leaks");
     Scheduler::set_detect_leaks(detect_leaks);
 
+    cost_model = opt.has("--cost-model");
+    costs.behaviour = opt.is<uint64_t>("--cost-behaviour", costs.behaviour);
+    costs.steal = opt.is<uint64_t>("--cost-steal", costs.steal);
+    costs.remote_enqueue =
+      opt.is<uint64_t>("--cost-remote-enqueue", costs.remote_enqueue);
+
 #if defined(_WIN32) && defined(CI_BUILD)
     _set_error_mode(_OUT_TO_STDERR);
     _set_abort_behavior(0, _WRITE_ABORT_MSG);
@@ -139,6 +192,7 @@ public:
   template<typename F, typename... Args>
   void run(F&& f, Args... args)
   {
+    std::vector<uint64_t> seed_ns;
     for (seed = seed_lower; seed < seed_upper; seed++)
     {
       std::cout << "Seed: " << seed << std::endl;
@@ -146,23 +200,27 @@ public:
       Scheduler& sched = Scheduler::get();
 #ifdef USE_SYSTEMATIC_TESTING
       Systematic::set_seed(seed);
-      if (seed % 2 == 1)
-      {
-        sched.set_fair(true);
-      }
-      else
-      {
-        sched.set_fair(false);
-      }
+      // Cover each fairness policy.
+      sched.set_fairness(FairnessPolicy(seed % 3));
 #else
       UNUSED(seed);
 #endif
 
+      if (cost_model)
+        CostModel::enable(costs);
+
       sched.init(cores, run_at_termination);
 
+      auto run_start = steady_clock::now();
       f(std::forward<Args>(args)...);
 
       sched.run();
+      seed_ns.push_back(
+        (uint64_t)duration_cast<nanoseconds>(steady_clock::now() - run_start)
+          .count());
+
+      if (cost_model)
+        CostModel::print(std::cout, cores);
 
       Logging::cout() << "Joining external threads" << std::endl;
 
@@ -186,6 +244,14 @@ public:
                 << std::endl;
     }
 
+    if (json)
+    {
+      auto name = program + "." + std::to_string(run_count);
+      PerfResult::summarise(name, cores, std::move(seed_ns))
+        .write_json(json_file.is_open() ? json_file : std::cout);
+    }
+    run_count++;
+
     std::cout << "Test Harness Finished!" << std::endl;
   }
 
@@ -24,6 +24,7 @@
 #endif
 
 #include "../ds/asymlock.h"
+#include "../pal/clock.h"
 #include "ds/morebits.h"
 
 #include <iomanip>
@@ -46,6 +47,9 @@ namespace Logging
   static constexpr bool flight_recorder = false;
 #endif
 
+  /// Whether log statements do anything, see `VERONA_LOG`.
+  static constexpr bool enabled = systematic || flight_recorder;
+
   struct Header
   {
     size_t time;
@@ -98,7 +102,7 @@ namespace Logging
   private:
     static size_t get_start()
     {
-      static size_t start = snmalloc::Aal::tick();
+      static size_t start = verona::rt::Clock::fast();
       return start;
     }
 
@@ -116,7 +120,7 @@ namespace Logging
       alock.internal_acquire();
       systematic_id = get_systematic_id();
       working_index = verona::rt::bits::inc_mod(working_index, size);
-      log[working_index].header.time = snmalloc::Aal::tick() - get_start();
+      log[working_index].header.time = verona::rt::Clock::fast() - get_start();
       log[working_index].header.items = (working_index - index + size) % size;
       index = working_index;
       alock.internal_release();
@@ -610,6 +614,12 @@ namespace Logging
     return cout_log;
   }
 
+  /// Turns a log statement into a `void` expression, see `VERONA_LOG`.
+  struct Voidify
+  {
+    void operator&(SysLog&) {}
+  };
+
   inline std::ostream& endl(std::ostream& os)
   {
     if constexpr (systematic || flight_recorder)
@@ -620,3 +630,14 @@ namespace Logging
     return os;
   }
 } // namespace Logging
+
+/**
+ * Starts a log statement, `VERONA_LOG << ... << Logging::endl;`.
+ *
+ * Unless systematic testing or the flight recorder is enabled, the whole
+ * statement is compiled out, and its operands are never evaluated, so
+ * logging costs nothing on hot paths in release builds.  This should be
+ * used rather than `Logging::cout()` in the runtime.
+ */
+#define VERONA_LOG \
+  !Logging::enabled ? (void)0 : Logging::Voidify() & Logging::cout()
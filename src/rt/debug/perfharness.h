@@ -0,0 +1,331 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+/**
+ * A harness for benchmarks, separate from `SystematicTestHarness`, so that
+ * each benchmark need not time itself and print its own format.
+ *
+ * For each core count, `PerfHarness::run` initialises the runtime, calls the
+ * benchmark's setup to schedule its work, and times `Scheduler::run`.  It
+ * does so for a number of warmup trials, which are discarded, then for the
+ * measured trials, and reports the median, 99th percentile, minimum and
+ * maximum times, and the median per operation if the benchmark gives its
+ * operation count.  Each is also reported as a speedup over the first core
+ * count run, which is one core in a sweep, as the same work is done on each
+ * count.  The options are
+ *
+ *   --cores n      cores to run on, 0 for all available (default 4)
+ *   --sweep        run on 1, 2, 4, ... cores, up to and including --cores
+ *   --warmup n     discarded trials for each core count (default 1)
+ *   --trials n     measured trials for each core count (default 5)
+ *   --csv          report as CSV, with a header line
+ *   --json         report as JSON, one object per line, see `PerfResult`
+ *   --output path  append the results to `path`, rather than writing them
+ *                  to standard output
+ *   --seed n       seed for systematic testing builds
+ *
+ *   --baseline     also run the benchmark's baselines, see `run_baseline`
+ *
+ * and the benchmark may read its own from `opt`.  Anything else a benchmark
+ * prints should go to standard error, so that the results of a sweep can be
+ * collected and compared across releases.
+ */
+
+#include "perfresult.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <test/opt.h>
+#include <thread>
+#include <verona.h>
+#include <vector>
+
+namespace verona::rt
+{
+  /**
+   * A pool of threads taking tasks from one locked queue, the simplest
+   * task-based thread pool, as a baseline for the scheduler.  Tasks may
+   * submit more tasks, and `wait` returns once all have run.
+   */
+  class TaskPool
+  {
+    std::mutex m;
+    std::condition_variable work;
+    std::condition_variable idle;
+    std::deque<std::function<void()>> tasks;
+    /// Tasks submitted that have not finished.
+    size_t pending = 0;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+
+    void worker()
+    {
+      std::unique_lock<std::mutex> lock(m);
+      while (true)
+      {
+        work.wait(lock, [this]() { return stopping || !tasks.empty(); });
+        if (tasks.empty())
+          return;
+
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+
+        if (--pending == 0)
+          idle.notify_all();
+      }
+    }
+
+  public:
+    TaskPool(size_t count)
+    {
+      for (size_t i = 0; i < count; i++)
+        threads.emplace_back([this]() { worker(); });
+    }
+
+    ~TaskPool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(m);
+        stopping = true;
+      }
+      work.notify_all();
+      for (auto& t : threads)
+        t.join();
+    }
+
+    void submit(std::function<void()> task)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m);
+        tasks.push_back(std::move(task));
+        pending++;
+      }
+      work.notify_one();
+    }
+
+    void wait()
+    {
+      std::unique_lock<std::mutex> lock(m);
+      idle.wait(lock, [this]() { return pending == 0; });
+    }
+  };
+
+  class PerfHarness
+  {
+  public:
+    enum class Format
+    {
+      Text,
+      CSV,
+      JSON,
+    };
+
+    opt::Opt opt;
+
+    size_t cores;
+    bool sweep;
+    size_t warmup;
+    size_t trials;
+    size_t seed;
+    Format format = Format::Text;
+    bool baselines;
+
+    std::vector<PerfResult> results;
+
+  private:
+    bool header_written = false;
+    std::ofstream file;
+
+    std::ostream& out()
+    {
+      return file.is_open() ? file : std::cout;
+    }
+
+    void report(const PerfResult& r)
+    {
+      auto& o = out();
+      switch (format)
+      {
+        case Format::Text:
+          o << r.benchmark << ": cores " << r.cores << " trials " << r.trials
+            << " median " << r.median_ns << " ns p99 " << r.p99_ns
+            << " ns min " << r.min_ns << " ns max " << r.max_ns << " ns";
+          if (r.ops != 0)
+            o << " median/op " << r.median_ns_per_op() << " ns";
+          o << " speedup " << r.speedup << std::endl;
+          break;
+
+        case Format::CSV:
+        {
+          CSVStream csv(o);
+          if (!header_written)
+          {
+            csv << "Benchmark"
+                << "Cores"
+                << "Trials"
+                << "Median ns"
+                << "P99 ns"
+                << "Min ns"
+                << "Max ns"
+                << "Ops"
+                << "Median ns/op"
+                << "Speedup" << std::endl;
+            header_written = true;
+          }
+          csv << r.benchmark << r.cores << r.trials << r.median_ns << r.p99_ns
+              << r.min_ns << r.max_ns << r.ops << r.median_ns_per_op()
+              << r.speedup << std::endl;
+          break;
+        }
+
+        case Format::JSON:
+          r.write_json(o);
+          break;
+      }
+    }
+
+    static uint64_t elapsed_ns(std::chrono::steady_clock::time_point start)
+    {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+    }
+
+    /**
+     * Run `trial`, which takes a core count and returns the time taken, for
+     * the warmup and measured trials on each core count, and report the
+     * results as those of `name`.
+     */
+    template<typename Trial>
+    void measure(const std::string& name, Trial trial, uint64_t ops)
+    {
+      uint64_t baseline = 0;
+      for (auto count : core_counts())
+      {
+        for (size_t i = 0; i < warmup; i++)
+          trial(count);
+
+        std::vector<uint64_t> ns;
+        for (size_t i = 0; i < trials; i++)
+          ns.push_back(trial(count));
+
+        auto r = PerfResult::summarise(name, count, std::move(ns));
+        r.ops = ops;
+        if (baseline == 0)
+          baseline = r.median_ns;
+        if (r.median_ns != 0)
+          r.speedup = (double)baseline / (double)r.median_ns;
+        report(r);
+        results.push_back(r);
+      }
+    }
+
+  public:
+    PerfHarness(int argc, const char* const* argv) : opt(argc, argv)
+    {
+      for (int i = 0; i < argc; i++)
+      {
+        std::cerr << " " << argv[i];
+        // `opt::Opt` only parses numbers.
+        if ((strcmp(argv[i], "--output") == 0) && (i + 1 < argc))
+          file.open(argv[i + 1], std::ios::app);
+      }
+      std::cerr << std::endl;
+
+      cores = opt.is<size_t>("--cores", 4);
+      if (cores == 0)
+        cores = Scheduler::default_thread_count();
+      sweep = opt.has("--sweep");
+      warmup = opt.is<size_t>("--warmup", 1);
+      trials = opt.is<size_t>("--trials", 5);
+      if (trials == 0)
+        trials = 1;
+      seed = opt.is<size_t>("--seed", 5489);
+      baselines = opt.has("--baseline");
+
+      if (opt.has("--json"))
+        format = Format::JSON;
+      else if (opt.has("--csv"))
+        format = Format::CSV;
+    }
+
+    /**
+     * The core counts to run on: `cores`, or with `--sweep` the powers of
+     * two below it and then `cores` itself.
+     */
+    std::vector<size_t> core_counts() const
+    {
+      std::vector<size_t> counts;
+      if (sweep)
+      {
+        for (size_t c = 1; c < cores; c *= 2)
+          counts.push_back(c);
+      }
+      counts.push_back(cores);
+      return counts;
+    }
+
+    /**
+     * Run the benchmark `name` on each core count, and report its results.
+     * `setup` is called after the runtime is initialised, to schedule the
+     * work of a trial, which is timed until the runtime has no more work.
+     * `ops` is the number of operations in each trial, if it is meaningful,
+     * to also report the time per operation.
+     */
+    template<typename Setup>
+    void run(const std::string& name, Setup setup, uint64_t ops = 0)
+    {
+      measure(
+        name,
+        [this, &setup](size_t count) {
+          auto& sched = Scheduler::get();
+#ifdef USE_SYSTEMATIC_TESTING
+          Systematic::set_seed(seed);
+#endif
+          sched.init(count);
+          setup();
+
+          auto start = std::chrono::steady_clock::now();
+          sched.run();
+          return elapsed_ns(start);
+        },
+        ops);
+    }
+
+    /**
+     * With `--baseline`, run a version of a benchmark that does not use the
+     * runtime, such as one using threads and locks or a `TaskPool`, to
+     * compare against.  `body` is called with the number of threads to use,
+     * for each core count, and timed until it returns.  It is reported as
+     * the benchmark `name`, which should be that of the runtime version
+     * followed by what the baseline uses.
+     */
+    template<typename Body>
+    void run_baseline(const std::string& name, Body body, uint64_t ops = 0)
+    {
+      if (!baselines)
+        return;
+
+      measure(
+        name,
+        [&body](size_t count) {
+          auto start = std::chrono::steady_clock::now();
+          body(count);
+          return elapsed_ns(start);
+        },
+        ops);
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,107 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+/**
+ * The result of a benchmark on one core count, as reported by `PerfHarness`
+ * and by `SystematicTestHarness` with `--json`.
+ *
+ * As JSON, each result is one object on a line of its own, so results can be
+ * appended to a file and compared across releases with
+ * `utils/perfcompare`.  Its `id` is stable across releases as long as the
+ * benchmark's name is, and its `samples_ns` are the times of the measured
+ * trials, for a test of significance.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace verona::rt
+{
+  struct PerfResult
+  {
+    std::string benchmark;
+    size_t cores = 0;
+    size_t trials = 0;
+    uint64_t median_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t min_ns = 0;
+    uint64_t max_ns = 0;
+    /// Operations in each trial, or 0 if the benchmark did not say.
+    uint64_t ops = 0;
+    /// Median time on the first core count run over this median.
+    double speedup = 1;
+    /// Times of the measured trials, in order.
+    std::vector<uint64_t> samples_ns;
+
+    double median_ns_per_op() const
+    {
+      return ops == 0 ? 0 : (double)median_ns / (double)ops;
+    }
+
+    /**
+     * The identifier results are matched by when compared, the benchmark's
+     * name and the core count.
+     */
+    std::string id() const
+    {
+      return benchmark + "/" + std::to_string(cores);
+    }
+
+    /**
+     * Summarise the times of the measured trials.
+     */
+    static PerfResult
+    summarise(std::string benchmark, size_t cores, std::vector<uint64_t> ns)
+    {
+      PerfResult r;
+      r.benchmark = std::move(benchmark);
+      r.cores = cores;
+      r.trials = ns.size();
+      r.samples_ns = ns;
+      if (ns.empty())
+        return r;
+
+      std::sort(ns.begin(), ns.end());
+      auto n = ns.size();
+      r.median_ns =
+        (n % 2 == 1) ? ns[n / 2] : (ns[(n / 2) - 1] + ns[n / 2]) / 2;
+      // Nearest rank, so with fewer than 100 trials this is the maximum.
+      r.p99_ns = ns[((n * 99) + 99) / 100 - 1];
+      r.min_ns = ns.front();
+      r.max_ns = ns.back();
+      return r;
+    }
+
+    static void write_json_string(std::ostream& o, const std::string& s)
+    {
+      o << '"';
+      for (auto c : s)
+      {
+        if ((c == '"') || (c == '\\'))
+          o << '\\';
+        o << c;
+      }
+      o << '"';
+    }
+
+    void write_json(std::ostream& o) const
+    {
+      o << "{\"id\":";
+      write_json_string(o, id());
+      o << ",\"benchmark\":";
+      write_json_string(o, benchmark);
+      o << ",\"cores\":" << cores << ",\"trials\":" << trials
+        << ",\"median_ns\":" << median_ns << ",\"p99_ns\":" << p99_ns
+        << ",\"min_ns\":" << min_ns << ",\"max_ns\":" << max_ns
+        << ",\"ops\":" << ops << ",\"median_ns_per_op\":" << median_ns_per_op()
+        << ",\"speedup\":" << speedup << ",\"samples_ns\":[";
+      for (size_t i = 0; i < samples_ns.size(); i++)
+        o << (i == 0 ? "" : ",") << samples_ns[i];
+      o << "]}" << std::endl;
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,45 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+/**
+ * Static tracepoints, enabled by building with `USE_USDT`.
+ *
+ * Each probe is a SystemTap SDT (USDT) probe in the provider `verona`, which
+ * compiles to a single NOP and a note describing where its arguments are, so
+ * a probe costs nothing until a tool such as bpftrace, perf or SystemTap
+ * attaches to it.  For instance
+ *
+ *   bpftrace -e 'usdt:./app:verona:behaviour_start { @s[arg0] = nsecs; }
+ *                usdt:./app:verona:behaviour_end /@s[arg0]/ {
+ *                  @ns = hist(nsecs - @s[arg0]); delete(@s[arg0]); }'
+ *
+ * gives a live histogram of how long behaviours run.  The probes are
+ *
+ *   behaviour_create(behaviour, cowns)
+ *   behaviour_runnable(behaviour)     all cowns acquired by the 2PL
+ *   behaviour_start(behaviour)
+ *   behaviour_end(behaviour)
+ *   steal(core, victim)               core indices
+ *   steal_failed(core, victim, contended)
+ *   pause(paused_threads)             a thread is about to sleep
+ *   unpause(count)                    up to `count` threads are woken
+ *   gc_start(region)
+ *   gc_end(region)
+ *
+ * Unlike `Trace`, which records into memory to be dumped later, the probes
+ * record nothing themselves.  They require `sys/sdt.h`, from the SystemTap
+ * development package.
+ */
+
+#ifdef USE_USDT
+#  include <sys/sdt.h>
+
+#  define VERONA_PROBE1(name, a) DTRACE_PROBE1(verona, name, a)
+#  define VERONA_PROBE2(name, a, b) DTRACE_PROBE2(verona, name, a, b)
+#  define VERONA_PROBE3(name, a, b, c) DTRACE_PROBE3(verona, name, a, b, c)
+#else
+#  define VERONA_PROBE1(name, a) ((void)0)
+#  define VERONA_PROBE2(name, a, b) ((void)0)
+#  define VERONA_PROBE3(name, a, b, c) ((void)0)
+#endif
@@ -0,0 +1,158 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+/**
+ * Binary event tracing, enabled by building with `USE_TRACE`.
+ *
+ * Unlike the flight recorder in logging.h, which keeps formatted log lines
+ * for crash dumps, this records a few kinds of fixed size event, see
+ * `TraceKind`, cheaply enough to leave on in production.  Each thread
+ * records into its own ring of the most recent `RING_SIZE` events with plain
+ * stores, so recording takes no locks and does not contend.
+ *
+ * `Trace::dump` writes the rings to a file, in the format of traceformat.h,
+ * and can be called at any time, for instance when a service notices a slow
+ * request.  Events being recorded during the dump may be torn.  The decoder
+ * in `utils/tracedecode` turns the file into Chrome trace JSON, for viewing
+ * in Perfetto or chrome://tracing.  The `Handoff` events record each cown
+ * passing from one behaviour to the next, from which `utils/tracedag`
+ * rebuilds the dependency graph, and reports its critical path and the
+ * cowns that serialise it.
+ */
+
+#include "../pal/clock.h"
+#include "traceformat.h"
+
+#include <atomic>
+#include <fstream>
+#include <snmalloc/snmalloc.h>
+#include <vector>
+
+namespace verona::rt
+{
+  /**
+   * The ring of events of a thread.
+   */
+  class TraceRing : public snmalloc::Pooled<TraceRing>
+  {
+  private:
+    friend class Trace;
+
+    static constexpr size_t RING_SIZE = 1 << 14;
+
+    static inline std::atomic<uint64_t> next_thread{0};
+
+    uint64_t thread = next_thread.fetch_add(1, std::memory_order_relaxed);
+    /// Number of events ever recorded, so the next event goes in
+    /// `events[count % RING_SIZE]`.
+    std::atomic<size_t> count{0};
+    TraceEvent events[RING_SIZE];
+
+    void record(TraceKind kind, uint64_t arg)
+    {
+      auto i = count.load(std::memory_order_relaxed);
+      events[i % RING_SIZE] = {Clock::fast(), arg, kind, 0};
+      count.store(i + 1, std::memory_order_release);
+    }
+  };
+
+  using TraceRingPool = snmalloc::Pool<TraceRing, snmalloc::Alloc::Config>;
+
+  /**
+   * Handles lifetime management of the ring of a thread.  The ring is kept
+   * in the pool when the thread exits, so its events are still dumped.
+   */
+  class ThreadLocalTrace
+  {
+  private:
+    friend class Trace;
+    TraceRing* ptr;
+
+    ThreadLocalTrace()
+    {
+      ptr = TraceRingPool::acquire();
+    }
+
+    ~ThreadLocalTrace()
+    {
+      TraceRingPool::release(ptr);
+    }
+  };
+
+  class Trace
+  {
+  private:
+    static TraceRing* local()
+    {
+      static thread_local ThreadLocalTrace thread_local_trace;
+      return thread_local_trace.ptr;
+    }
+
+  public:
+    static constexpr bool enabled =
+#ifdef USE_TRACE
+      true;
+#else
+      false;
+#endif
+
+    /**
+     * Record an event on this thread, if tracing is enabled.
+     */
+    static void record(TraceKind kind, uint64_t arg = 0)
+    {
+      if constexpr (enabled)
+      {
+        local()->record(kind, arg);
+      }
+      else
+      {
+        snmalloc::UNUSED(kind, arg);
+      }
+    }
+
+    template<typename T>
+    static void record(TraceKind kind, T* arg)
+    {
+      record(kind, (uint64_t)(uintptr_t)arg);
+    }
+
+    /**
+     * Write the events of all threads to the file at `path`.  Returns false
+     * if the file could not be written.
+     */
+    static bool dump(const char* path)
+    {
+      std::vector<TraceRing*> rings;
+      for (auto r = TraceRingPool::iterate(); r != nullptr;
+           r = TraceRingPool::iterate(r))
+        rings.push_back(r);
+
+      TraceFileHeader header{
+        TraceFileHeader::MAGIC, Clock::ticks_per_ns() * 1000, rings.size()};
+
+      std::ofstream out(path, std::ios::binary);
+      out.write((const char*)&header, sizeof(header));
+
+      for (auto r : rings)
+      {
+        size_t count = r->count.load(std::memory_order_acquire);
+        size_t first = (count > TraceRing::RING_SIZE) ?
+          (count - TraceRing::RING_SIZE) :
+          0;
+
+        TraceThreadHeader thread{r->thread, count - first};
+        out.write((const char*)&thread, sizeof(thread));
+        for (size_t i = first; i < count; i++)
+        {
+          out.write(
+            (const char*)&r->events[i % TraceRing::RING_SIZE],
+            sizeof(TraceEvent));
+        }
+      }
+
+      return out.good();
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,113 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+/**
+ * The binary format of the trace written by `Trace::dump`, shared with the
+ * decoder in `utils/tracedecode`, so this must not depend on the rest of the
+ * runtime.
+ *
+ * A trace file is a `TraceFileHeader`, followed for each thread by a
+ * `TraceThreadHeader` and its events, oldest first.  Values are in the byte
+ * order of the machine that wrote the trace.  `read_trace` reads one back.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <vector>
+
+namespace verona::rt
+{
+  enum class TraceKind : uint32_t
+  {
+    /// The behaviour `arg` has all of its cowns and can run.
+    Runnable,
+    /// The behaviour `arg` started or finished running its body.
+    BehaviourStart,
+    BehaviourEnd,
+    /// Work was stolen from the core with index `arg`.
+    Steal,
+    /// This thread paused, or unpaused the core with index `arg`.
+    Pause,
+    Unpause,
+    /// A collection of the region `arg` started or finished.
+    GCStart,
+    GCEnd,
+    /// The behaviour `arg` is releasing its cowns.  The `Handoff` events
+    /// that follow on the same thread are from this behaviour.
+    Release,
+    /// The cown `arg` passes to the behaviour in the `HandoffTo` event that
+    /// immediately follows, which is an edge of the dependency graph.
+    Handoff,
+    HandoffTo,
+  };
+
+  struct TraceEvent
+  {
+    /// `Clock::fast` when the event was recorded.
+    uint64_t time;
+    uint64_t arg;
+    TraceKind kind;
+    uint32_t reserved;
+  };
+
+  static_assert(sizeof(TraceEvent) == 24);
+
+  struct TraceFileHeader
+  {
+    static constexpr uint64_t MAGIC = 0x3130454341525456; // "VTRACE01"
+
+    uint64_t magic;
+    /// Ticks per microsecond, as calibrated by `Clock`.
+    double ticks_per_us;
+    uint64_t thread_count;
+  };
+
+  struct TraceThreadHeader
+  {
+    uint64_t thread;
+    uint64_t event_count;
+  };
+
+  struct TraceThread
+  {
+    uint64_t thread;
+    std::vector<TraceEvent> events;
+  };
+
+  /**
+   * Read a trace written by `Trace::dump` into `header` and `threads`, with
+   * the events of each thread sorted by time.  Returns false if `in` is not
+   * a whole trace.
+   */
+  inline bool read_trace(
+    std::istream& in, TraceFileHeader& header, std::vector<TraceThread>& threads)
+  {
+    if (
+      !in.read((char*)&header, sizeof(header)) ||
+      (header.magic != TraceFileHeader::MAGIC))
+      return false;
+
+    for (uint64_t i = 0; i < header.thread_count; i++)
+    {
+      TraceThreadHeader thread;
+      if (!in.read((char*)&thread, sizeof(thread)))
+        return false;
+
+      TraceThread t{thread.thread, std::vector<TraceEvent>(thread.event_count)};
+      if (!in.read(
+            (char*)t.events.data(), thread.event_count * sizeof(TraceEvent)))
+        return false;
+
+      // Events may have been torn while the trace was written.  The sort is
+      // stable, so events recorded in the same tick keep their order.
+      std::stable_sort(
+        t.events.begin(), t.events.end(), [](auto& a, auto& b) {
+          return a.time < b.time;
+        });
+      threads.push_back(std::move(t));
+    }
+    return true;
+  }
+} // namespace verona::rt
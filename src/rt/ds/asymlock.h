@@ -8,6 +8,13 @@ namespace verona::rt
   /**
    * AsymmetricLock allows a single owning thread to use the internal
    * acquire/release API. Other threads must use the external API.
+   *
+   * The internal side is taken on every use of an epoch, so it issues no
+   * fences: it stores its count, and then checks the external flag, with
+   * only a compiler barrier between them.  The external side, which is rare,
+   * pays for both with `Barrier::memory`, which makes every other thread of
+   * the process execute a fence, see `FlushProcessWriteBuffers`.  So either
+   * the owner sees the flag, or the external side sees the count.
    */
   class AsymmetricLock
   {
@@ -3,12 +3,13 @@
 #pragma once
 
 #include "heap.h"
+#include "stack.h"
 
 #include <cassert>
 
 namespace verona::rt
 {
-  template<class E>
+  template<class E, size_t BlockBytes = DEFAULT_BLOCK_BYTES>
   class BagBase
   {
     union MaybeElem
@@ -17,7 +18,7 @@ namespace verona::rt
       E item;
     };
 
-    static constexpr size_t ITEM_COUNT = 512 / sizeof(E);
+    static constexpr size_t ITEM_COUNT = BlockBytes / sizeof(E);
     static_assert(
       snmalloc::bits::next_pow2_const(ITEM_COUNT) == ITEM_COUNT,
       "Should be power of 2 for alignment.");
@@ -46,8 +47,8 @@ namespace verona::rt
       (ITEM_COUNT - 1) * sizeof(MaybeElem);
 
     /// Pointer into a block.  As the blocks are strongly aligned
-    /// the bits 9-3 represent the element in the block, with 0 being
-    /// a pointer to the `prev` pointer, and implying the empty block.
+    /// the bits of `INDEX_MASK` represent the element in the block, with 0
+    /// being a pointer to the `prev` pointer, and implying the empty block.
     MaybeElem* index;
 
     // Used to thread a freelist pointer through the bag.
@@ -72,7 +73,7 @@ namespace verona::rt
     }
 
   public:
-    BagBase<E>() : index(null_index), next_free(nullptr)
+    BagBase() : index(null_index), next_free(nullptr)
     {
       static_assert(
         sizeof(*this) == sizeof(void*) * 2,
@@ -159,12 +160,12 @@ namespace verona::rt
       friend class BagBase;
 
     public:
-      iterator(BagBase<E>* bag) : bag(bag)
+      iterator(BagBase* bag) : bag(bag)
       {
         ptr = bag->next_non_empty(bag->index);
       }
 
-      iterator(BagBase<E>* bag, MaybeElem* p) : bag(bag), ptr(p) {}
+      iterator(BagBase* bag, MaybeElem* p) : bag(bag), ptr(p) {}
 
       iterator operator++()
       {
@@ -202,7 +203,7 @@ namespace verona::rt
       }
 
     private:
-      BagBase<E>* bag;
+      BagBase* bag;
       MaybeElem* ptr;
     };
 
@@ -238,16 +239,16 @@ namespace verona::rt
    * To maintain an internal freelist with no additional space requirements, the
    * item `T` must be at least 1 machine word in size.
    */
-  template<class T, class U>
-  class Bag : public BagBase<BagElem<T, U>>
+  template<class T, class U, size_t BlockBytes = DEFAULT_BLOCK_BYTES>
+  class Bag : public BagBase<BagElem<T, U>, BlockBytes>
   {
   public:
     using Elem = BagElem<T, U>;
-    using B = BagBase<Elem>;
+    using B = BagBase<Elem, BlockBytes>;
     using iterator = typename B::iterator;
 
   public:
-    Bag<T, U>() : BagBase<Elem>() {}
+    Bag() : B() {}
   };
 
   template<class T>
@@ -263,16 +264,16 @@ namespace verona::rt
    * This is similar to the bag data structure with the key difference that each
    * element holds only a `T*`, without an additional field.
    */
-  template<class T>
-  class BagThin : public BagBase<BagThinElem<T>>
+  template<class T, size_t BlockBytes = DEFAULT_BLOCK_BYTES>
+  class BagThin : public BagBase<BagThinElem<T>, BlockBytes>
   {
   public:
     using Elem = BagThinElem<T>;
-    using B = BagBase<Elem>;
+    using B = BagBase<Elem, BlockBytes>;
     using iterator = typename B::iterator;
 
   public:
-    BagThin<T>() : BagBase<Elem>() {}
+    BagThin() : B() {}
   };
 
 } // namespace verona::rt
@@ -44,7 +44,12 @@ namespace verona::rt
 #if !defined(_WIN32) && !defined(VERONA_EXTERNAL_THREADING)
 #  ifdef __linux__
     /**
-     * Linux version of `FlushProcessWriteBuffers`, uses membarrier.
+     * Linux version of `FlushProcessWriteBuffers`, uses the private expedited
+     * membarrier, which only interrupts the cores running threads of this
+     * process.  The process registers for it the first time this is called.
+     * Without it, this falls back to the portable version below rather than
+     * to a shared membarrier, which waits for a scheduler grace period and
+     * so takes milliseconds.
      */
     static void FlushProcessWriteBuffers()
     {
@@ -53,46 +58,17 @@ namespace verona::rt
         return (int)syscall(__NR_membarrier, cmd, flags);
       };
 
-      static bool broken_membarrier = false;
-      // If `USE_MEMBARRIER_EXPEDITED` is defined to one, then the first time
-      // we enter this function try to register the command that we want
-      // otherwise just use a shared barrier.
-      static int cmd = []() -> int {
+      // The expedited command fails unless registering succeeded, and then
+      // no barrier is issued, so both must be checked.
+      static bool expedited = []() {
         int r = membarrier(MEMBARRIER_CMD_QUERY, 0);
-
-        if (r == -1)
-        {
-          if (membarrier(MEMBARRIER_CMD_SHARED, 0) != -1)
-          {
-            return MEMBARRIER_CMD_SHARED;
-          }
-          broken_membarrier = true;
-          return -1;
-        }
-
-        if (r & MEMBARRIER_CMD_PRIVATE_EXPEDITED)
-        {
-          membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0);
-          return MEMBARRIER_CMD_PRIVATE_EXPEDITED;
-        }
-
-        if (r & MEMBARRIER_CMD_SHARED)
-        {
-          return MEMBARRIER_CMD_SHARED;
-        }
-
-        broken_membarrier = true;
-        return -1;
+        return (r != -1) && ((r & MEMBARRIER_CMD_PRIVATE_EXPEDITED) != 0) &&
+          (membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0);
       }();
 
-      if (broken_membarrier)
-      {
+      if (
+        !expedited || (membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0) != 0))
         FlushProcessWriteBuffersPortable();
-      }
-      else
-      {
-        membarrier(cmd, 0);
-      }
     }
 #    define FlushProcessWriteBuffers FlushProcessWriteBuffersPortable
 #  endif
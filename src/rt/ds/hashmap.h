@@ -9,6 +9,8 @@ namespace verona::rt
   /**
    * Robin Hood hash map where the key type is `K*`, where `K` is derrived from
    * `Object`. The `Entry` type must be either `K*` or `std::pair<K*, Value>`.
+   *
+   * A map can be made to grow incrementally, see `set_incremental`.
    */
   template<typename Entry>
   class ObjectMap
@@ -18,6 +20,24 @@ namespace verona::rt
     uint8_t capacity_shift;
     uint8_t longest_probe = 0;
 
+    /// Whether the map grows incrementally, see `set_incremental`.
+    bool incremental = false;
+
+    /**
+     * While the map is growing incrementally, the previous allocation, whose
+     * entries are moved to `slots` a few at a time.  `filled_slots` counts the
+     * entries in both.
+     */
+    Entry* old_slots = nullptr;
+    uint8_t old_capacity_shift = 0;
+    uint8_t old_longest_probe = 0;
+
+    /// The next slot of `old_slots` to move.
+    size_t migrate_index = 0;
+
+    /// How many slots of `old_slots` each insertion moves.
+    static constexpr size_t MIGRATE_STEP = 8;
+
     /**
      * The key type must be derrived from `Object` because the low bits are used
      * to encode a mark bit and the probe length of the entry from its ideal
@@ -98,30 +118,122 @@ namespace verona::rt
       slots = (Entry*)heap::calloc<init_capacity * sizeof(Entry)>();
     }
 
+    size_t old_capacity() const
+    {
+      return (old_slots == nullptr) ? 0 : ((size_t)1 << old_capacity_shift);
+    }
+
+    /**
+     * The slot at `index`, where the slots of `old_slots` follow those of
+     * `slots`.
+     */
+    Entry& slot(size_t index) const
+    {
+      if (index < capacity())
+        return slots[index];
+      return old_slots[index - capacity()];
+    }
+
     /**
      * Double the allocation size. The entries in the previous allocation will
-     * be reinserted.
+     * be reinserted, or moved over the next insertions if the map grows
+     * incrementally.
      */
     void resize()
+    {
+      if (incremental && (old_slots == nullptr))
+      {
+        old_slots = slots;
+        old_capacity_shift = capacity_shift;
+        old_longest_probe = longest_probe;
+        migrate_index = 0;
+
+        capacity_shift++;
+        slots = (Entry*)heap::calloc(capacity() * sizeof(Entry));
+        longest_probe = 0;
+        return;
+      }
+
+      resize((uint8_t)(capacity_shift + 1));
+    }
+
+    /**
+     * Change the allocation size to `1 << shift` entries, which must hold the
+     * current entries.  The entries in the previous allocation, and in
+     * `old_slots`, will be reinserted.
+     */
+    void resize(uint8_t shift)
     {
       auto prev = *this;
 
-      capacity_shift++;
+      capacity_shift = shift;
       slots = (Entry*)heap::calloc(capacity() * sizeof(Entry));
       filled_slots = 0;
       longest_probe = 0;
+      old_slots = nullptr;
 
       for (auto it = prev.begin(); it != prev.end(); ++it)
       {
-        if constexpr (is_set)
-          insert(it.key());
-        else
-          insert(std::make_pair(it.key(), std::move(it.value())));
-
+        reinsert(it.entry());
         key_of(it.entry()) = 0;
       }
     }
 
+    /**
+     * Insert an entry moved from another allocation, keeping its mark.
+     */
+    void reinsert(Entry& e)
+    {
+      bool marked = (key_of(e) & MARK_MASK) != 0;
+      auto key = (KeyType*)unmark_key(key_of(e));
+      if constexpr (is_set)
+      {
+        auto r = insert_new(key);
+        if (marked)
+          r.second.mark();
+      }
+      else
+      {
+        auto r = insert_new(std::make_pair(key, std::move(e.second)));
+        if (marked)
+          r.second.mark();
+      }
+    }
+
+    /**
+     * Move the entry in slot `index` of `old_slots`, if any, to `slots`.
+     */
+    void migrate_slot(size_t index)
+    {
+      Entry& e = old_slots[index];
+      if (key_of(e) == 0)
+        return;
+
+      Entry moved = std::move(e);
+      e.~Entry();
+      key_of(e) = 0;
+      filled_slots--;
+      reinsert(moved);
+    }
+
+    /**
+     * Move the next `MIGRATE_STEP` slots of `old_slots`, and free it once it
+     * is empty.  Inserting may resize the map, which empties `old_slots`.
+     */
+    void migrate_some(size_t step = MIGRATE_STEP)
+    {
+      for (size_t n = 0; (n < step) && (old_slots != nullptr); n++)
+      {
+        migrate_slot(migrate_index++);
+
+        if ((old_slots != nullptr) && (migrate_index == old_capacity()))
+        {
+          heap::dealloc(old_slots, old_capacity() * sizeof(Entry));
+          old_slots = nullptr;
+        }
+      }
+    }
+
     /**
      * Place an entry into the map at the given index, overwriting any existing
      * entry. The probe bits of the key are set to `probe_len` and the
@@ -152,7 +264,7 @@ namespace verona::rt
 
       Entry& entry()
       {
-        return map->slots[index];
+        return map->slot(index);
       }
 
       Iterator(const ObjectMap* m, size_t i) : map(m), index(i) {}
@@ -194,9 +306,10 @@ namespace verona::rt
 
       Iterator& operator++()
       {
-        while (++index < map->capacity())
+        size_t slot_count = map->capacity() + map->old_capacity();
+        while (++index < slot_count)
         {
-          const auto key = key_of(map->slots[index]);
+          const auto key = key_of(map->slot(index));
           if (key != 0)
             break;
         }
@@ -246,6 +359,36 @@ namespace verona::rt
       return filled_slots;
     }
 
+    /**
+     * Choose whether the map grows incrementally.  Growing a map normally
+     * moves every entry at once, which stalls the insertion that triggers it
+     * for a time proportional to the size of the map.  A map that grows
+     * incrementally keeps its previous allocation, and each insertion moves a
+     * few of its entries, so no insertion moves more than a few.  `find`,
+     * `erase` and iteration cover both allocations.
+     */
+    void set_incremental(bool on)
+    {
+      if (!on)
+      {
+        while (old_slots != nullptr)
+          migrate_some(old_capacity());
+      }
+      incremental = on;
+    }
+
+    /**
+     * Make room for `n` entries, so that inserting up to that many does not
+     * resize the map repeatedly.  The map is left at most two thirds full, to
+     * keep the probes short.
+     */
+    void reserve(size_t n)
+    {
+      size_t target = n + (n >> 1);
+      if (target > capacity())
+        resize((uint8_t)bits::next_pow2_bits(target));
+    }
+
     /**
      * Return the capacity for entries in the map. Note that this should not be
      * used to approximate when the map will resize.
@@ -266,7 +409,7 @@ namespace verona::rt
 
     Iterator end() const
     {
-      return Iterator(this, capacity());
+      return Iterator(this, capacity() + old_capacity());
     }
 
     /**
@@ -291,6 +434,9 @@ namespace verona::rt
           index = 0;
       }
 
+      if (old_slots != nullptr)
+        return find_old((uintptr_t)key);
+
       return end();
     }
 
@@ -302,6 +448,48 @@ namespace verona::rt
      */
     template<typename E>
     std::pair<bool, Iterator> insert(E entry)
+    {
+      if (old_slots != nullptr)
+      {
+        migrate_some();
+
+        // An entry for the key still in `old_slots` is moved first, so that
+        // it is found and updated.
+        if (old_slots != nullptr)
+        {
+          auto it = find_old(unmark_key(key_of(entry)));
+          if (it != end())
+            migrate_slot(it.index - capacity());
+        }
+      }
+
+      return insert_new(std::forward<E>(entry));
+    }
+
+  private:
+    /**
+     * Find the slot of `key` in `old_slots`, or return `end()`.
+     */
+    Iterator find_old(uintptr_t key) const
+    {
+      const auto hash = bits::hash(((const Object*)key)->id());
+      auto index = hash & (old_capacity() - 1);
+      for (size_t probe_len = 0; probe_len <= old_longest_probe; probe_len++)
+      {
+        if (unmark_key(key_of(old_slots[index])) == key)
+          return Iterator(this, capacity() + index);
+
+        if (++index == old_capacity())
+          index = 0;
+      }
+      return end();
+    }
+
+    /**
+     * As `insert`, but into `slots` only.
+     */
+    template<typename E>
+    std::pair<bool, Iterator> insert_new(E entry)
     {
       if (SNMALLOC_UNLIKELY(size() == capacity()))
         resize();
@@ -356,13 +544,14 @@ namespace verona::rt
       // Maximum probe length reached, resize and retry.
       resize();
       // Entry may have been swapped prior to resize.
-      auto it = insert(std::forward<E>(entry)).second;
+      auto it = insert_new(std::forward<E>(entry)).second;
       if ((uintptr_t)it.key() != key)
         it = find((const KeyType*)key);
 
       return std::make_pair(true, std::move(it));
     }
 
+  public:
     /**
      * Remove an entry from the map corresponding to the given key. The return
      * value is false if no entry was found for the key and true otherwise.
@@ -406,6 +595,12 @@ namespace verona::rt
 
       longest_probe = 0;
 
+      if (old_slots != nullptr)
+      {
+        heap::dealloc(old_slots, old_capacity() * sizeof(Entry));
+        old_slots = nullptr;
+      }
+
       if (!skip_deallocate && (capacity() > 8))
       {
         heap::dealloc(slots, capacity() * sizeof(Entry));
@@ -433,6 +628,8 @@ namespace verona::rt
             << ", probe " << (size_t)probe_index(key) << ")";
       }
       out << " } cap: " << capacity();
+      if (old_slots != nullptr)
+        out << " old cap: " << old_capacity() << " moved: " << migrate_index;
       return out;
     }
   };
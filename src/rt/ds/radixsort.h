@@ -0,0 +1,70 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+namespace verona::rt
+{
+  /**
+   * Stable least significant digit radix sort of `count` elements of `data`
+   * by the 64 bit `key(element)`, using `scratch`, which must have room for
+   * `count` elements.  The result is in `data`.
+   *
+   * The keys are read once, to count every byte of every key, and a byte
+   * that is the same in all of the keys, such as the high bits of pointers
+   * into one heap, is skipped.  This costs a pass over the elements for
+   * each byte that differs, so is only worth it over a comparison sort for
+   * a few hundred elements or more.
+   *
+   * As the sort is stable, sorting by a secondary key and then by a primary
+   * key orders by both.
+   */
+  template<typename T, typename Key>
+  void radix_sort(T* data, T* scratch, size_t count, Key key)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    static constexpr size_t DIGITS = sizeof(uint64_t);
+    static constexpr size_t RADIX = 256;
+
+    if (count < 2)
+      return;
+
+    size_t histogram[DIGITS][RADIX];
+    std::memset(histogram, 0, sizeof(histogram));
+    for (size_t i = 0; i < count; i++)
+    {
+      uint64_t k = key(data[i]);
+      for (size_t d = 0; d < DIGITS; d++)
+        histogram[d][(k >> (d * 8)) & 0xff]++;
+    }
+
+    T* from = data;
+    T* to = scratch;
+    for (size_t d = 0; d < DIGITS; d++)
+    {
+      auto& h = histogram[d];
+
+      // Every key has the same byte here, so the order does not change.
+      if (h[(key(from[0]) >> (d * 8)) & 0xff] == count)
+        continue;
+
+      size_t offset = 0;
+      for (size_t b = 0; b < RADIX; b++)
+        offset += std::exchange(h[b], offset);
+
+      for (size_t i = 0; i < count; i++)
+        to[h[(key(from[i]) >> (d * 8)) & 0xff]++] = from[i];
+
+      std::swap(from, to);
+    }
+
+    if (from != data)
+      std::memcpy(
+        static_cast<void*>(data), static_cast<void*>(from), count * sizeof(T));
+  }
+} // namespace verona::rt
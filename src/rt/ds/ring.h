@@ -0,0 +1,277 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <snmalloc/snmalloc.h>
+#include <type_traits>
+
+namespace verona::rt
+{
+  /**
+   * Bounded Multiple Producer Multiple Consumer ring buffer.
+   *
+   * The ring is an array of `Capacity` slots, each with a sequence number
+   * that says whether it is ready to be written or read for the current lap
+   * of the ring (Vyukov's bounded queue).  Producers and consumers each claim
+   * a position with a compare and swap on their own counter, so neither
+   * allocates nor waits for the other, except to see a slot that the other
+   * has claimed but not yet finished with.
+   *
+   * Unlike `MPMCQ`, elements need no intrusive link, and the memory used is
+   * fixed.  `try_enqueue` fails when the ring is full, and `try_dequeue` when
+   * it is empty, so the caller chooses what to do about backpressure.  This
+   * suits staging buffers, such as work from threads outside the runtime,
+   * that scheduler threads drain in batches with `dequeue_some`.
+   */
+  template<typename T, size_t Capacity>
+  class MPMCRing
+  {
+    static_assert(
+      snmalloc::bits::is_pow2(Capacity), "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    static constexpr size_t MASK = Capacity - 1;
+    static constexpr size_t CACHELINE = 64;
+
+    struct Slot
+    {
+      std::atomic<size_t> sequence;
+      T value;
+    };
+
+    /// The counters are on their own cache lines, so that producers and
+    /// consumers do not contend on them.
+    alignas(CACHELINE) std::atomic<size_t> enqueue_pos{0};
+    alignas(CACHELINE) std::atomic<size_t> dequeue_pos{0};
+    alignas(CACHELINE) Slot slots[Capacity];
+
+  public:
+    MPMCRing()
+    {
+      for (size_t i = 0; i < Capacity; i++)
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MPMCRing(const MPMCRing&) = delete;
+    MPMCRing& operator=(const MPMCRing&) = delete;
+
+    static constexpr size_t capacity()
+    {
+      return Capacity;
+    }
+
+    /**
+     * Add `value` to the ring.  Returns false, and does nothing, if the ring
+     * is full.
+     */
+    bool try_enqueue(const T& value)
+    {
+      size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+      while (true)
+      {
+        auto& slot = slots[pos & MASK];
+        size_t seq = slot.sequence.load(std::memory_order_acquire);
+        auto diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+          if (enqueue_pos.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed))
+          {
+            slot.value = value;
+            slot.sequence.store(pos + 1, std::memory_order_release);
+            return true;
+          }
+        }
+        else if (diff < 0)
+        {
+          // The slot still holds the value from the previous lap.
+          return false;
+        }
+        else
+        {
+          pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    /**
+     * Remove the oldest value from the ring into `value`.  Returns false if
+     * the ring is empty, or the oldest value is still being written.
+     */
+    bool try_dequeue(T& value)
+    {
+      size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+      while (true)
+      {
+        auto& slot = slots[pos & MASK];
+        size_t seq = slot.sequence.load(std::memory_order_acquire);
+        auto diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0)
+        {
+          if (dequeue_pos.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed))
+          {
+            value = slot.value;
+            slot.sequence.store(pos + Capacity, std::memory_order_release);
+            return true;
+          }
+        }
+        else if (diff < 0)
+        {
+          return false;
+        }
+        else
+        {
+          pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    /**
+     * Remove up to `max` values, passing each to `f` in order.  Returns the
+     * number removed.
+     */
+    template<typename F>
+    size_t dequeue_some(size_t max, F f)
+    {
+      size_t n = 0;
+      T value;
+      while ((n < max) && try_dequeue(value))
+      {
+        f(value);
+        n++;
+      }
+      return n;
+    }
+
+    /**
+     * An estimate of the number of values in the ring, which may be out of
+     * date by the time it returns.
+     */
+    size_t size_estimate() const
+    {
+      size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+      size_t head = dequeue_pos.load(std::memory_order_relaxed);
+      return (tail > head) ? (tail - head) : 0;
+    }
+  };
+
+  /**
+   * Bounded Single Producer Single Consumer ring buffer.
+   *
+   * Each side owns one counter, and only reads the other's, so neither
+   * needs a compare and swap.  Each side also remembers the last value it
+   * read of the other's counter, and only reads it again when the ring looks
+   * full or empty, so the two sides rarely touch the same cache line.  This
+   * suits a channel between a fixed pair of threads, such as the inboxes of
+   * `Core`.
+   *
+   * Only one thread may enqueue, and only one dequeue, at a time.
+   * `is_empty` and `size_estimate` may be called from any thread.
+   */
+  template<typename T, size_t Capacity>
+  class SPSCRing
+  {
+    static_assert(
+      snmalloc::bits::is_pow2(Capacity), "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    static constexpr size_t MASK = Capacity - 1;
+    static constexpr size_t CACHELINE = 64;
+
+    alignas(CACHELINE) std::atomic<size_t> enqueue_pos{0};
+    /// The producer's last view of `dequeue_pos`.
+    size_t dequeue_cached = 0;
+    alignas(CACHELINE) std::atomic<size_t> dequeue_pos{0};
+    /// The consumer's last view of `enqueue_pos`.
+    size_t enqueue_cached = 0;
+    alignas(CACHELINE) T slots[Capacity];
+
+  public:
+    SPSCRing() = default;
+
+    SPSCRing(const SPSCRing&) = delete;
+    SPSCRing& operator=(const SPSCRing&) = delete;
+
+    static constexpr size_t capacity()
+    {
+      return Capacity;
+    }
+
+    /**
+     * Add `value` to the ring.  Returns false, and does nothing, if the ring
+     * is full.
+     */
+    bool try_enqueue(const T& value)
+    {
+      size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+      if (pos - dequeue_cached == Capacity)
+      {
+        dequeue_cached = dequeue_pos.load(std::memory_order_acquire);
+        if (pos - dequeue_cached == Capacity)
+          return false;
+      }
+
+      slots[pos & MASK] = value;
+      enqueue_pos.store(pos + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * Remove the oldest value from the ring into `value`.  Returns false if
+     * the ring is empty.
+     */
+    bool try_dequeue(T& value)
+    {
+      size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+      if (pos == enqueue_cached)
+      {
+        enqueue_cached = enqueue_pos.load(std::memory_order_acquire);
+        if (pos == enqueue_cached)
+          return false;
+      }
+
+      value = slots[pos & MASK];
+      dequeue_pos.store(pos + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * Remove up to `max` values, passing each to `f` in order.  Returns the
+     * number removed.
+     */
+    template<typename F>
+    size_t dequeue_some(size_t max, F f)
+    {
+      size_t n = 0;
+      T value;
+      while ((n < max) && try_dequeue(value))
+      {
+        f(value);
+        n++;
+      }
+      return n;
+    }
+
+    bool is_empty() const
+    {
+      return enqueue_pos.load(std::memory_order_acquire) ==
+        dequeue_pos.load(std::memory_order_acquire);
+    }
+
+    /**
+     * An estimate of the number of values in the ring, which may be out of
+     * date by the time it returns.
+     */
+    size_t size_estimate() const
+    {
+      size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+      size_t head = dequeue_pos.load(std::memory_order_relaxed);
+      return (tail > head) ? (tail - head) : 0;
+    }
+  };
+} // namespace verona::rt
@@ -24,17 +24,26 @@ namespace verona::rt
     }
   };
 
+  /// Default size in bytes of the blocks of `StackThin`, `Stack` and bags.
+  static constexpr size_t DEFAULT_BLOCK_BYTES = 512;
+
   /**
    * This class contains the core functionality for a stack using aligned blocks
    * of memory. The stack is the size of a single pointer when empty.
+   *
+   * `BlockBytes` is the size of each block.  Larger blocks allocate less often
+   * in deep traversals, but cost more for stacks that stay shallow.
    */
-  template<class T, class Alloc = HeapAlloc>
+  template<
+    class T,
+    class Alloc = HeapAlloc,
+    size_t BlockBytes = DEFAULT_BLOCK_BYTES>
   class StackThin
   {
     static inline HeapAlloc default_alloc{};
 
   private:
-    static constexpr size_t POINTER_COUNT = 64;
+    static constexpr size_t POINTER_COUNT = BlockBytes / sizeof(T*);
     static_assert(
       snmalloc::bits::next_pow2_const(POINTER_COUNT) == POINTER_COUNT,
       "Should be power of 2 for alignment.");
@@ -43,12 +52,13 @@ namespace verona::rt
 
     /**
      * The assumes that the allocations are aligned to the same threshold as
-     * their size. The blocks contain one previous pointer, and 63 pointers to
-     * Ts.  This is a power of two, so we can use the bottom part of the
-     * pointer to track the index.
+     * their size. The blocks contain one previous pointer, and
+     * `POINTER_COUNT - 1` pointers to Ts.  This is a power of two, so we can
+     * use the bottom part of the pointer to track the index.
      *
-     * As the block contains a previous pointer, there are only 64 possible
-     * states for a block, that is 0 - 63 live entries.
+     * As the block contains a previous pointer, there are only
+     * `POINTER_COUNT` possible states for a block, that is 0 to
+     * `POINTER_COUNT - 1` live entries.
      *
      * The stack is represented by a single interior pointer, index, of type
      * T**.
@@ -82,8 +92,8 @@ namespace verona::rt
     static constexpr uintptr_t INDEX_MASK = (POINTER_COUNT - 1) * sizeof(T*);
 
     /// Pointer into a block.  As the blocks are strongly aligned
-    /// the bits 9-3 represent the element in the block, with 0 being
-    /// a pointer to the `prev` pointer, and implying the empty block.
+    /// the bits of `INDEX_MASK` represent the element in the block, with 0
+    /// being a pointer to the `prev` pointer, and implying the empty block.
     T** index;
 
     /// Takes an index and returns the pointer to the Block
@@ -137,6 +147,22 @@ namespace verona::rt
       return *index;
     }
 
+    /// Call `f` on each element, from the top of the stack down.
+    template<typename F>
+    void for_each(F f)
+    {
+      for (T** i = index; i != null_index;)
+      {
+        if (is_empty(i))
+        {
+          i = get_block(i)->prev;
+          continue;
+        }
+        f(*i);
+        i--;
+      }
+    }
+
     /// Call this to pop an element from the stack.
     ALWAYSINLINE T* pop(Alloc& alloc = default_alloc)
     {
@@ -223,7 +249,7 @@ namespace verona::rt
    * elements and pops them on each iteration may trigger allocation the first
    * time but will then not trigger allocation on any subsequent iteration.
    */
-  template<class T>
+  template<class T, size_t BlockBytes = DEFAULT_BLOCK_BYTES>
   class Stack
   {
     /**
@@ -232,7 +258,7 @@ namespace verona::rt
      */
     class BackupAlloc
     {
-      using Block = typename StackThin<T, BackupAlloc>::Block;
+      using Block = typename StackThin<T, BackupAlloc, BlockBytes>::Block;
 
       /// A one place pool of Block.
       Block* backup = nullptr;
@@ -276,7 +302,7 @@ namespace verona::rt
     };
 
     /// Underlying stack
-    StackThin<T, BackupAlloc> stack;
+    StackThin<T, BackupAlloc, BlockBytes> stack;
 
     /// Allocator for new blocks of stack
     BackupAlloc backup_alloc;
@@ -2,8 +2,12 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "heap.h"
+
 #include <cassert>
 #include <cstddef>
+#include <new>
+#include <type_traits>
 
 /**
  * @brief A stack allocated array.
@@ -11,6 +15,11 @@
  * Due to portability allocates a largeish array on the stack, if this array is
  * not big enough then dynamically allocates something of the correct size. This
  * is done to avoid the need for a dynamic allocation in the common case.
+ *
+ * Larger arrays come from the runtime's heap.  Elements are value
+ * initialised, unless constructed with `uninitialised`, which leaves
+ * elements of trivial types, such as pointers, for the caller to write
+ * before reading them.
  */
 template<typename T>
 class StackArray
@@ -19,7 +28,7 @@ class StackArray
   static constexpr size_t Size = 128;
 
   // Stack allocated array. Untyped to avoid initialisation and destruction.
-  char main[Size * sizeof(T)];
+  alignas(T) char main[Size * sizeof(T)];
 
   // Pointer to the array in use, may be main or a dynamically allocated array.
   // If current != &main[0], then current is an owning reference.
@@ -33,32 +42,54 @@ class StackArray
     return reinterpret_cast<T*>(&main[0]);
   }
 
-public:
-  StackArray(std::size_t size) : size(size)
+  void init(bool value_initialise)
   {
     if (size > Size)
-    {
-      current = new T[size]();
-    }
+      current = static_cast<T*>(verona::rt::heap::alloc(size * sizeof(T)));
     else
-    {
       current = main_as_T();
+
+    if (value_initialise)
+    {
       for (size_t i = 0; i < size; i++)
         new (&current[i]) T();
     }
+    else if constexpr (!std::is_trivially_default_constructible_v<T>)
+    {
+      for (size_t i = 0; i < size; i++)
+        new (&current[i]) T;
+    }
+  }
+
+public:
+  /// Tag for the constructor that does not value initialise.
+  struct Uninitialised
+  {};
+  static constexpr Uninitialised uninitialised{};
+
+  StackArray(std::size_t size) : size(size)
+  {
+    init(true);
+  }
+
+  StackArray(std::size_t size, Uninitialised) : size(size)
+  {
+    init(false);
   }
 
+  StackArray(const StackArray&) = delete;
+  StackArray& operator=(const StackArray&) = delete;
+
   ~StackArray()
   {
-    if (current != main_as_T())
-    {
-      delete[] current;
-    }
-    else
+    if constexpr (!std::is_trivially_destructible_v<T>)
     {
       for (size_t i = 0; i < size; i++)
         current[i].~T();
     }
+
+    if (current != main_as_T())
+      verona::rt::heap::dealloc(current, size * sizeof(T));
   }
 
   /**
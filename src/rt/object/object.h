@@ -106,6 +106,68 @@ namespace verona::rt
     FinalFunction finaliser;
     NotifiedFunction notified = nullptr;
     DestructorFunction destructor = nullptr;
+
+    // If `fields` is not null, the pointers of the object are exactly its
+    // `field_count` fields at the byte offsets in `fields`. These are traced
+    // inline, without calling `trace`, and an object with no such fields
+    // costs nothing to trace.
+    const uint32_t* fields = nullptr;
+    size_t field_count = 0;
+
+    // Properties of the descriptor, worked out once when it is created, so
+    // that the region code can test them with a single load.
+    enum Flags : uint8_t
+    {
+      HAS_FINALISER = 1 << 0,
+      HAS_DESTRUCTOR = 1 << 1,
+      HAS_NOTIFIED = 1 << 2,
+      // Neither a finaliser nor a destructor, so the object can be dropped
+      // without running any code.
+      IS_TRIVIAL = 1 << 3,
+    };
+
+    uint8_t flags;
+
+    constexpr Descriptor(
+      size_t size_,
+      TraceFunction trace_,
+      FinalFunction finaliser_,
+      NotifiedFunction notified_ = nullptr,
+      DestructorFunction destructor_ = nullptr,
+      const uint32_t* fields_ = nullptr,
+      size_t field_count_ = 0)
+    : size(size_),
+      trace(trace_),
+      finaliser(finaliser_),
+      notified(notified_),
+      destructor(destructor_),
+      fields(fields_),
+      field_count(field_count_),
+      flags(compute_flags(finaliser_, notified_, destructor_))
+    {}
+
+    static constexpr uint8_t compute_flags(
+      FinalFunction finaliser,
+      NotifiedFunction notified,
+      DestructorFunction destructor)
+    {
+      uint8_t f = 0;
+      if (finaliser != nullptr)
+        f |= HAS_FINALISER;
+      if (destructor != nullptr)
+        f |= HAS_DESTRUCTOR;
+      if (notified != nullptr)
+        f |= HAS_NOTIFIED;
+      if ((finaliser == nullptr) && (destructor == nullptr))
+        f |= IS_TRIVIAL;
+      return f;
+    }
+
+    constexpr bool has(Flags f) const
+    {
+      return (flags & f) != 0;
+    }
+
     // TODO: virtual dispatch, pattern matching on type, reflection
   };
 
@@ -399,6 +461,8 @@ namespace verona::rt
     friend class RegionArena;
     friend class RegionRc;
     friend class RememberedSet;
+    friend class Snapshot;
+    friend class CycleCollector;
     friend class ExternalReferenceTable;
     template<typename Entry>
     friend class ObjectMap;
@@ -462,6 +526,8 @@ namespace verona::rt
       return (size_t)(get_header().bits >> SHIFT);
     }
 
+    /// The count of an object in an rc region is only touched by the thread
+    /// that has the region open, so unlike `incref` this is a plain add.
     inline void incref_rc_region()
     {
       assert(
@@ -471,6 +537,7 @@ namespace verona::rt
       get_header().bits += ONE_RC;
     }
 
+    /// As `incref_rc_region`, a plain subtract.
     inline void decref_rc_region()
     {
       assert(
@@ -642,6 +709,21 @@ namespace verona::rt
       get_header().bits |= (uint8_t)RegionMD::MARKED;
     }
 
+    /**
+     * As `mark`, but safe to call on the same object from several threads.
+     * Returns true for the one call that marked the object.  The object must
+     * be unmarked or marked, as the other classes use the mark bit.
+     */
+    inline bool try_mark_atomic()
+    {
+      auto old = get_header().rc.fetch_or(
+        (uint8_t)RegionMD::MARKED, std::memory_order_relaxed);
+      assert(
+        ((old & MASK) == (uint8_t)RegionMD::UNMARKED) ||
+        ((old & MASK) == (uint8_t)RegionMD::MARKED));
+      return (old & MASK) == (uint8_t)RegionMD::UNMARKED;
+    }
+
     inline void mark_iso()
     {
       assert(get_class() == RegionMD::ISO);
@@ -681,7 +763,7 @@ namespace verona::rt
     inline void set_has_ext_ref()
     {
       assert(!debug_is_immutable());
-      assert(((uintptr_t)get_header().descriptor.load() & MARK_MASK) == 0);
+      assert(!has_ext_ref());
 
       get_header().descriptor.store(
         (const Descriptor*)((uintptr_t)get_header().descriptor.load() | (uintptr_t)1),
@@ -696,6 +778,58 @@ namespace verona::rt
         std::memory_order_relaxed);
     }
 
+    /// Set on objects in the nursery of a trace region, see `RegionTrace`.
+    static constexpr uintptr_t YOUNG_BIT = 2;
+
+    inline bool is_young()
+    {
+      assert(!debug_is_immutable());
+      return ((uintptr_t)get_header().descriptor.load() & YOUNG_BIT) != 0;
+    }
+
+    inline void set_young()
+    {
+      get_header().descriptor.store(
+        (const Descriptor*)((uintptr_t)get_header().descriptor.load() | YOUNG_BIT),
+        std::memory_order_relaxed);
+    }
+
+    inline void clear_young()
+    {
+      get_header().descriptor.store(
+        (const Descriptor*)((uintptr_t)get_header().descriptor.load() & ~YOUNG_BIT),
+        std::memory_order_relaxed);
+    }
+
+    /// Set on SCC roots with a sharded count, see `Immutable::pin`.
+    static constexpr uintptr_t PINNED_BIT = 4;
+
+    inline bool is_pinned()
+    {
+      return ((uintptr_t)get_header().descriptor.load() & PINNED_BIT) != 0;
+    }
+
+    /// Returns false if the object was already pinned.
+    inline bool set_pinned()
+    {
+      auto d = get_header().descriptor.load();
+      do
+      {
+        if (((uintptr_t)d & PINNED_BIT) != 0)
+          return false;
+      } while (!get_header().descriptor.compare_exchange_weak(
+        d, (const Descriptor*)((uintptr_t)d | PINNED_BIT)));
+      return true;
+    }
+
+    inline void clear_pinned()
+    {
+      auto d = get_header().descriptor.load();
+      while (!get_header().descriptor.compare_exchange_weak(
+        d, (const Descriptor*)((uintptr_t)d & ~PINNED_BIT)))
+      {}
+    }
+
     inline void incref_nonatomic()
     {
       assert(get_class() == RegionMD::NONATOMIC_RC);
@@ -749,7 +883,7 @@ namespace verona::rt
      **/
     inline bool decref_shared(bool& release_weak)
     {
-      Logging::cout() << "decref_shared " << (void*)this << std::endl;
+      VERONA_LOG << "decref_shared " << (void*)this << std::endl;
       // This always performs the atomic subtraction, since the shared object
       // should see its own rc as zero this is due to how weak reference to
       // shared objects interact.  An attempt to acquire a weak reference will
@@ -768,7 +902,7 @@ namespace verona::rt
 
       yield();
 
-      Logging::cout() << "decref_shared part 2" << (void*)this << std::endl;
+      VERONA_LOG << "decref_shared part 2" << (void*)this << std::endl;
       size_t zero_rc = (size_t)RegionMD::SHARED;
       auto result =
         get_header().rc.compare_exchange_strong(zero_rc, FINISHED_RC);
@@ -807,22 +941,22 @@ namespace verona::rt
 
     inline bool has_finaliser()
     {
-      return get_descriptor()->finaliser != nullptr;
+      return get_descriptor()->has(Descriptor::HAS_FINALISER);
     }
 
     inline bool has_notified()
     {
-      return get_descriptor()->notified != nullptr;
+      return get_descriptor()->has(Descriptor::HAS_NOTIFIED);
     }
 
     inline bool has_destructor()
     {
-      return get_descriptor()->destructor != nullptr;
+      return get_descriptor()->has(Descriptor::HAS_DESTRUCTOR);
     }
 
     static inline bool is_trivial(const Descriptor* desc)
     {
-      return desc->destructor == nullptr && desc->finaliser == nullptr;
+      return desc->has(Descriptor::IS_TRIVIAL);
     }
 
     inline bool is_trivial()
@@ -841,7 +975,19 @@ namespace verona::rt
   private:
     inline void trace(ObjectStack& f) const
     {
-      get_descriptor()->trace(this, f);
+      auto desc = get_descriptor();
+      if (desc->fields != nullptr)
+      {
+        for (size_t i = 0; i < desc->field_count; i++)
+        {
+          auto p = *(Object* const*)((uintptr_t)this + desc->fields[i]);
+          if (p != nullptr)
+            f.push(p);
+        }
+        return;
+      }
+
+      desc->trace(this, f);
     }
 
     inline void finalise(Object* region, ObjectStack& isos)
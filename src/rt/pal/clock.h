@@ -0,0 +1,183 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <snmalloc/snmalloc.h>
+#if defined(__linux__)
+#  include <time.h>
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
+namespace verona::rt
+{
+  /**
+   * The clocks used by the scheduler's timing heuristics, its statistics,
+   * the flight recorder and tracing, so that they behave the same on any
+   * hardware.
+   *
+   * `fast` is read on hot paths.  It is the cycle counter, `Aal::tick`,
+   * where that runs at a constant rate and the kernel trusts it, and
+   * otherwise `steady_clock` in nanoseconds, as on some virtual machines
+   * the cycle counter is emulated, slow, or varies with the cpu frequency.
+   * `VERONA_CLOCK=tick` or `VERONA_CLOCK=steady` overrides the choice.  Its
+   * rate is measured against `steady_clock` once per process, so times
+   * configured in nanoseconds can be converted to its ticks.
+   *
+   * `coarse_ns` is cheaper still where the platform has a coarse clock, but
+   * only advances every few milliseconds, so is for timestamps that need
+   * not be precise.
+   */
+  class Clock
+  {
+    enum class Source : uint8_t
+    {
+      Tick,
+      Steady,
+    };
+
+    /// Whether the cycle counter runs at a constant rate.
+    static bool tick_is_invariant()
+    {
+#if defined(__x86_64__) || defined(_M_X64)
+      // Invariant TSC, CPUID.80000007H:EDX[8].
+      unsigned int regs[4] = {};
+#  if defined(_MSC_VER)
+      int info[4];
+      __cpuid(info, 0x80000007);
+      regs[3] = (unsigned int)info[3];
+#  else
+      if (__get_cpuid(0x80000007, &regs[0], &regs[1], &regs[2], &regs[3]) == 0)
+        return false;
+#  endif
+      if ((regs[3] & (1 << 8)) == 0)
+        return false;
+
+#  if defined(__linux__)
+      // A kernel that does not use the TSC as its clock source has found it
+      // unreliable, or is a guest with a paravirtual clock.
+      FILE* f = fopen(
+        "/sys/devices/system/clocksource/clocksource0/current_clocksource",
+        "r");
+      if (f != nullptr)
+      {
+        char name[32] = {};
+        bool tsc = (fscanf(f, "%31s", name) == 1) && (strcmp(name, "tsc") == 0);
+        fclose(f);
+        return tsc;
+      }
+#  endif
+      return true;
+#else
+      // Other architectures' counters, such as the Arm generic timer, run at
+      // a constant rate.
+      return true;
+#endif
+    }
+
+    static Source choose()
+    {
+      const char* env = getenv("VERONA_CLOCK");
+      if (env != nullptr)
+      {
+        if (strcmp(env, "tick") == 0)
+          return Source::Tick;
+        if (strcmp(env, "steady") == 0)
+          return Source::Steady;
+      }
+      return tick_is_invariant() ? Source::Tick : Source::Steady;
+    }
+
+    static Source source()
+    {
+      static const Source s = choose();
+      return s;
+    }
+
+    static uint64_t steady_ns()
+    {
+      return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+    }
+
+    static double measure()
+    {
+      if (source() == Source::Steady)
+        return 1.0;
+
+      using namespace std::chrono;
+      auto tick = fast();
+      auto start = steady_clock::now();
+      auto now = start;
+      while (now - start < CALIBRATION)
+      {
+        snmalloc::Aal::pause();
+        now = steady_clock::now();
+      }
+
+      auto ticks = (double)(fast() - tick);
+      auto ns = (double)duration_cast<nanoseconds>(now - start).count();
+      if ((ticks <= 0) || (ns <= 0))
+        return 1.0;
+      return ticks / ns;
+    }
+
+  public:
+    /// How long the rate of `fast` is measured over, once per process.
+    static constexpr std::chrono::microseconds CALIBRATION{200};
+
+    /// Ticks of the fast clock, see `ticks_per_ns` for their length.
+    static uint64_t fast()
+    {
+      if (SNMALLOC_LIKELY(source() == Source::Tick))
+        return snmalloc::Aal::tick();
+      return steady_ns();
+    }
+
+    /// Whether `fast` reads the cycle counter.
+    static bool fast_is_tick()
+    {
+      return source() == Source::Tick;
+    }
+
+    static double ticks_per_ns()
+    {
+      static double rate = measure();
+      return rate;
+    }
+
+    static uint64_t from_ns(uint64_t ns)
+    {
+      return static_cast<uint64_t>((double)ns * ticks_per_ns());
+    }
+
+    static uint64_t to_ns(uint64_t ticks)
+    {
+      return static_cast<uint64_t>((double)ticks / ticks_per_ns());
+    }
+
+    /// Monotonic nanoseconds, with a resolution of a few milliseconds where
+    /// the platform has a cheaper clock with that resolution.
+    static uint64_t coarse_ns()
+    {
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+      timespec ts;
+      if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0)
+        return ((uint64_t)ts.tv_sec * 1'000'000'000) + (uint64_t)ts.tv_nsec;
+#endif
+      return steady_ns();
+    }
+  };
+} // namespace verona::rt
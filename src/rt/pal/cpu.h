@@ -5,9 +5,11 @@
 #include <snmalloc/snmalloc.h>
 
 #if defined(__linux__)
+#  include <dirent.h>
 #  include <sched.h>
 #  include <stdio.h>
 #  include <stdlib.h>
+#  include <string.h>
 #  include <unistd.h>
 #elif defined(_WIN32)
 #  include <processtopologyapi.h>
@@ -30,6 +32,7 @@
 
 #include <algorithm>
 #include <functional>
+#include <utility>
 #include <vector>
 
 namespace verona::rt
@@ -37,6 +40,13 @@ namespace verona::rt
   using namespace snmalloc;
   class Topology
   {
+  public:
+    /// The `capacity` of the fastest cpus.
+    static constexpr size_t CAPACITY_SCALE = 1024;
+    /// Cpus with less capacity than this are efficiency cores.  It allows for
+    /// the few percent by which the fastest cores of some parts turbo higher.
+    static constexpr size_t EFFICIENCY_CAPACITY = (CAPACITY_SCALE * 7) / 8;
+
   private:
     struct CPU
     {
@@ -45,6 +55,11 @@ namespace verona::rt
       size_t group;
       size_t id;
       bool hyperthread;
+      /// Unique id of the physical core; SMT siblings share the same value.
+      size_t core;
+      /// How fast the cpu runs relative to the others, found by `init`, or 0
+      /// if it is not known.
+      size_t capacity = 0;
 
       size_t get()
       {
@@ -61,6 +76,10 @@ namespace verona::rt
         if (hyperthread != that.hyperthread)
           return !hyperthread;
 
+        // Then performance cores, on hybrid parts.
+        if (capacity != that.capacity)
+          return capacity > that.capacity;
+
         // Sort by numa node.
         if (numa_node < that.numa_node)
           return true;
@@ -89,6 +108,9 @@ namespace verona::rt
 
     std::vector<CPU> cpus;
 
+    /// CPU bandwidth quota in whole cpus, or 0 if there is no quota.
+    size_t quota = 0;
+
 #if defined(CPU_COUNT) && defined(CPU_ISSET)
     template<typename CPUSet>
     void get_cpuset(std::function<void(CPUSet&)> getaffinity)
@@ -100,12 +122,15 @@ namespace verona::rt
       uint32_t index = 0;
       uint32_t found = 0;
 
-      // TODO: CPU topology detection for Linux
       while (found < count)
       {
         if (CPU_ISSET(index, &all_cpus))
         {
-          cpus.push_back(CPU{0, 0, 0, index, false});
+#  if defined(__linux__)
+          cpus.push_back(get_linux_cpu(index));
+#  else
+          cpus.push_back(CPU{0, 0, 0, index, false, index});
+#  endif
           found++;
         }
 
@@ -142,6 +167,8 @@ namespace verona::rt
         {
           size_t group = p->Processor.GroupMask[j].Group;
           bool hyperthread = false;
+          // Higher classes are faster, so this is only relative.
+          size_t efficiency_class = p->Processor.EfficiencyClass;
 
           for (size_t id = 0; id < 64; id++)
           {
@@ -154,7 +181,9 @@ namespace verona::rt
                 get_package(group, id, package, package_count),
                 group,
                 id,
-                hyperthread});
+                hyperthread,
+                i,
+                efficiency_class + 1});
 
               hyperthread = true;
             }
@@ -171,6 +200,7 @@ namespace verona::rt
       top->get_cpuset<cpu_set_t>([](cpu_set_t& all_cpus) {
         sched_getaffinity(0, sizeof(cpu_set_t), &all_cpus);
       });
+      top->quota = get_linux_cpu_quota();
 #elif defined(FreeBSD_KERNEL)
       top->get_cpuset<cpuset_t>(
         [](cpuset_t& all_cpus) { CPU_COPY(cpuset_root, &all_cpus); });
@@ -193,13 +223,14 @@ namespace verona::rt
         top->cpus.reserve(core_count);
         for (uint32_t index = 0; index < core_count; index++)
         {
-          top->cpus.push_back(CPU{0, 0, 0, index, false});
+          top->cpus.push_back(CPU{0, 0, 0, index, false, index});
         }
       }
 #else
 #  error Missing CPU enumeration for your OS.
 #endif
 
+      top->scale_capacity();
       std::sort(top->cpus.begin(), top->cpus.end());
     }
 
@@ -220,7 +251,297 @@ namespace verona::rt
       return cpus.size();
     }
 
+    /**
+     * Returns the index in the order used by `get` of the cpu with the id
+     * `cpu`, or `size()` if this process cannot run on it.
+     */
+    size_t index_of(size_t cpu)
+    {
+      for (size_t i = 0; i < cpus.size(); i++)
+      {
+        if (cpus[i].get() == cpu)
+          return i;
+      }
+      return cpus.size();
+    }
+
+    /**
+     * Returns the indices, in the order used by `get`, of a cpu from each
+     * NUMA node and package in turn.  Physical cores still come before
+     * hyperthreads.
+     */
+    std::vector<size_t> scatter_order()
+    {
+      // Indices of each NUMA node and package, in the order used by `get`.
+      std::vector<std::pair<size_t, size_t>> keys;
+      std::vector<std::vector<size_t>> groups;
+      for (size_t i = 0; i < cpus.size(); i++)
+      {
+        std::pair<size_t, size_t> key{cpus[i].numa_node, cpus[i].package};
+        auto it = std::find(keys.begin(), keys.end(), key);
+        if (it == keys.end())
+        {
+          keys.push_back(key);
+          groups.emplace_back();
+          it = keys.end() - 1;
+        }
+        groups[(size_t)(it - keys.begin())].push_back(i);
+      }
+
+      std::vector<size_t> order;
+      for (size_t round = 0; order.size() < cpus.size(); round++)
+      {
+        for (auto& group : groups)
+        {
+          if (round < group.size())
+            order.push_back(group[round]);
+        }
+      }
+
+      // Take the physical cores of every group before any hyperthread.
+      std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return !cpus[a].hyperthread && cpus[b].hyperthread;
+      });
+      return order;
+    }
+
+    /**
+     * Returns how many cpus this process can usefully run on.  This is the
+     * number of cpus in the affinity mask, further limited on Linux by the
+     * cgroup CPU bandwidth quota, rounded up.  Running more threads than this
+     * only leads to the process being throttled.
+     */
+    size_t available()
+    {
+      if (quota == 0)
+        return size();
+
+      return std::min(quota, size());
+    }
+
+    /**
+     * Returns the NUMA node of the cpu at `index` in the sorted order used by
+     * `get`.
+     */
+    size_t numa_node(size_t index)
+    {
+      if (cpus.size() == 0)
+        abort();
+
+      return cpus.at(index % cpus.size()).numa_node;
+    }
+
+    /**
+     * Returns how fast the cpu at `index` in the sorted order used by `get`
+     * runs, relative to the fastest, which is `CAPACITY_SCALE`.  On hybrid
+     * parts, efficiency cores have less than `EFFICIENCY_CAPACITY`.  Cpus
+     * are taken to be equal where the platform does not say.
+     */
+    size_t capacity(size_t index)
+    {
+      if (cpus.size() == 0)
+        abort();
+
+      return cpus.at(index % cpus.size()).capacity;
+    }
+
+    /**
+     * Returns an identifier for the physical core of the cpu at `index` in the
+     * sorted order used by `get`.  SMT siblings return the same value.
+     */
+    size_t physical_core(size_t index)
+    {
+      if (cpus.size() == 0)
+        abort();
+
+      return cpus.at(index % cpus.size()).core;
+    }
+
   private:
+    /**
+     * Scale the raw capacity of each cpu, as found by the platform code, so
+     * that the fastest has `CAPACITY_SCALE`.  Cpus with no capacity are
+     * taken to be as fast as the fastest.
+     */
+    void scale_capacity()
+    {
+      size_t fastest = 0;
+      for (auto& cpu : cpus)
+        fastest = std::max(fastest, cpu.capacity);
+
+      for (auto& cpu : cpus)
+      {
+        if ((fastest == 0) || (cpu.capacity == 0))
+          cpu.capacity = CAPACITY_SCALE;
+        else
+          cpu.capacity = (cpu.capacity * CAPACITY_SCALE) / fastest;
+      }
+    }
+
+#if defined(__linux__)
+    /**
+     * Reads the leading unsigned integer from a sysfs file.  For cpu lists,
+     * such as "0-3,8-11", this is the lowest cpu in the list.
+     *
+     * Returns false if the file does not exist or cannot be parsed.
+     */
+    static bool read_sysfs_value(const char* path, size_t& value)
+    {
+      FILE* f = fopen(path, "r");
+      if (f == nullptr)
+        return false;
+
+      unsigned long v;
+      bool success = fscanf(f, "%lu", &v) == 1;
+      fclose(f);
+
+      if (success)
+        value = v;
+      return success;
+    }
+
+    /**
+     * Returns the cgroup CPU bandwidth quota, in whole cpus rounded up, or 0
+     * if there is no quota.  Checks cgroup v2 `cpu.max` and then cgroup v1
+     * `cpu.cfs_quota_us`.  Only the cgroup mounted at /sys/fs/cgroup is
+     * considered, which in a container is the container's own cgroup.
+     */
+    static size_t get_linux_cpu_quota()
+    {
+      long quota = -1;
+      unsigned long period = 0;
+
+      FILE* f = fopen("/sys/fs/cgroup/cpu.max", "r");
+      if (f != nullptr)
+      {
+        // Either "max <period>" or "<quota> <period>".
+        char buffer[32];
+        if (fscanf(f, "%31s %lu", buffer, &period) == 2)
+        {
+          if (strcmp(buffer, "max") != 0)
+            quota = strtol(buffer, nullptr, 10);
+        }
+        fclose(f);
+      }
+      else
+      {
+        f = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r");
+        if (f != nullptr)
+        {
+          // -1 means no quota.
+          if (fscanf(f, "%ld", &quota) != 1)
+            quota = -1;
+          fclose(f);
+        }
+
+        size_t v1_period;
+        if (read_sysfs_value(
+              "/sys/fs/cgroup/cpu/cpu.cfs_period_us", v1_period))
+          period = v1_period;
+      }
+
+      if ((quota <= 0) || (period == 0))
+        return 0;
+
+      return (static_cast<size_t>(quota) + period - 1) / period;
+    }
+
+    /**
+     * The NUMA node of a cpu is exposed as a `nodeN` link in the cpu's sysfs
+     * directory.  Returns 0 if the kernel does not expose NUMA information.
+     */
+    static size_t get_linux_numa_node(uint32_t index)
+    {
+      char path[64];
+      snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", index);
+
+      DIR* dir = opendir(path);
+      if (dir == nullptr)
+        return 0;
+
+      size_t node = 0;
+      struct dirent* entry;
+      while ((entry = readdir(dir)) != nullptr)
+      {
+        if (
+          (strncmp(entry->d_name, "node", 4) == 0) &&
+          (entry->d_name[4] >= '0') && (entry->d_name[4] <= '9'))
+        {
+          node = strtoul(entry->d_name + 4, nullptr, 10);
+          break;
+        }
+      }
+
+      closedir(dir);
+      return node;
+    }
+
+    /**
+     * The raw capacity of a cpu, from `cpu_capacity`, which arm big.LITTLE
+     * and Intel hybrid kernels expose already scaled, or otherwise from the
+     * highest frequency in cpufreq, or 0 if neither is available.
+     */
+    static size_t get_linux_capacity(uint32_t index)
+    {
+      char path[96];
+      size_t capacity = 0;
+
+      snprintf(
+        path,
+        sizeof(path),
+        "/sys/devices/system/cpu/cpu%u/cpu_capacity",
+        index);
+      if (read_sysfs_value(path, capacity))
+        return capacity;
+
+      snprintf(
+        path,
+        sizeof(path),
+        "/sys/devices/system/cpu/cpu%u/cpufreq/cpuinfo_max_freq",
+        index);
+      if (read_sysfs_value(path, capacity))
+        return capacity;
+      return 0;
+    }
+
+    /**
+     * Builds the topology information for a single cpu from sysfs.
+     *
+     * A cpu is treated as a hyperthread if it is not the lowest numbered
+     * thread on its physical core.  If sysfs is unavailable, for instance in
+     * some containers, this falls back to a flat topology.
+     */
+    static CPU get_linux_cpu(uint32_t index)
+    {
+      char path[96];
+      size_t package = 0;
+      size_t first_sibling = index;
+
+      snprintf(
+        path,
+        sizeof(path),
+        "/sys/devices/system/cpu/cpu%u/topology/physical_package_id",
+        index);
+      read_sysfs_value(path, package);
+
+      snprintf(
+        path,
+        sizeof(path),
+        "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list",
+        index);
+      read_sysfs_value(path, first_sibling);
+
+      return CPU{
+        get_linux_numa_node(index),
+        package,
+        0,
+        index,
+        first_sibling != index,
+        first_sibling,
+        get_linux_capacity(index)};
+    }
+#endif
+
 #ifdef _WIN32
     static PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX
     get_info(LOGICAL_PROCESSOR_RELATIONSHIP relation, size_t& count)
@@ -0,0 +1,80 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../ds/heap.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(__linux__)
+#  include <sys/mman.h>
+#endif
+
+/**
+ * Memory backed by huge pages, for blocks that are large and long lived, such
+ * as the arenas of big arena regions.
+ *
+ * On Linux, the memory is populated by the calling thread, so under the
+ * default first touch policy it is on the NUMA node of the allocating core.
+ * Reserved huge pages (`MAP_HUGETLB`) are used if there are enough of them.
+ * Otherwise the memory is aligned to the page size and transparent huge pages
+ * are requested for it.  On other platforms, this uses the heap.
+ */
+namespace verona::rt::hugepage
+{
+  static constexpr size_t SIZE_2MIB = (size_t)1 << 21;
+  static constexpr size_t SIZE_1GIB = (size_t)1 << 30;
+
+#if defined(__linux__)
+  inline void* alloc(size_t size, size_t page_size)
+  {
+    size = snmalloc::bits::align_up(size, page_size);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE;
+
+#  if defined(MAP_HUGETLB) && defined(MAP_HUGE_2MB) && defined(MAP_HUGE_1GB)
+    int huge =
+      MAP_HUGETLB | ((page_size == SIZE_1GIB) ? MAP_HUGE_1GB : MAP_HUGE_2MB);
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags | huge, -1, 0);
+    if (p != MAP_FAILED)
+      return p;
+#  endif
+
+    // Over allocate, so that an aligned block can be cut out of the mapping.
+    size_t mapped = size + page_size;
+    void* q = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (q == MAP_FAILED)
+      abort();
+
+    auto start = (uintptr_t)q;
+    auto aligned = snmalloc::bits::align_up(start, page_size);
+    if (aligned != start)
+      munmap(q, aligned - start);
+    size_t tail = (start + mapped) - (aligned + size);
+    if (tail != 0)
+      munmap((void*)(aligned + size), tail);
+
+#  if defined(MADV_HUGEPAGE)
+    madvise((void*)aligned, size, MADV_HUGEPAGE);
+#  endif
+    return (void*)aligned;
+  }
+
+  /// Free a block from `alloc`, with the same `size` and `page_size`.
+  inline void dealloc(void* p, size_t size, size_t page_size)
+  {
+    munmap(p, snmalloc::bits::align_up(size, page_size));
+  }
+#else
+  inline void* alloc(size_t size, size_t)
+  {
+    return heap::alloc(size);
+  }
+
+  inline void dealloc(void* p, size_t size, size_t)
+  {
+    heap::dealloc(p, size);
+  }
+#endif
+} // namespace verona::rt::hugepage
@@ -0,0 +1,213 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+/**
+ * A minimal io_uring instance, driven with the raw system calls so that the
+ * runtime does not depend on liburing.  Each scheduler core owns one, see
+ * `IOQueue`, so a ring is only ever used by one thread, and needs no locks.
+ *
+ * `VERONA_IO_URING` is defined where io_uring can be used.  Elsewhere, and
+ * where the kernel refuses to create a ring, `IOQueue` runs operations
+ * synchronously instead.
+ */
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#  define VERONA_IO_URING
+#  include <algorithm>
+#  include <atomic>
+#  include <cerrno>
+#  include <cstdint>
+#  include <cstring>
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+#  include <unistd.h>
+
+namespace verona::rt::pal
+{
+  class IOUring
+  {
+    int fd = -1;
+
+    void* sq_map = nullptr;
+    size_t sq_map_size = 0;
+    void* cq_map = nullptr;
+    size_t cq_map_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+
+    std::atomic<uint32_t>* sq_head = nullptr;
+    std::atomic<uint32_t>* sq_tail = nullptr;
+    uint32_t sq_mask = 0;
+    uint32_t* sq_array = nullptr;
+
+    std::atomic<uint32_t>* cq_head = nullptr;
+    std::atomic<uint32_t>* cq_tail = nullptr;
+    uint32_t cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    /// Entries taken by `get_sqe` and not yet passed to the kernel.
+    uint32_t unsubmitted = 0;
+
+    template<typename T>
+    static T* at(void* base, uint32_t offset)
+    {
+      return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+    }
+
+    static void* map(int fd, size_t size, uint64_t offset)
+    {
+      auto p = mmap(
+        nullptr,
+        size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        fd,
+        (off_t)offset);
+      return p == MAP_FAILED ? nullptr : p;
+    }
+
+  public:
+    uint32_t sq_entries = 0;
+    uint32_t cq_entries = 0;
+
+    IOUring() = default;
+
+    IOUring(const IOUring&) = delete;
+
+    ~IOUring()
+    {
+      if (sqes != nullptr)
+        munmap(sqes, sqes_size);
+      if ((cq_map != nullptr) && (cq_map != sq_map))
+        munmap(cq_map, cq_map_size);
+      if (sq_map != nullptr)
+        munmap(sq_map, sq_map_size);
+      if (fd >= 0)
+        close(fd);
+    }
+
+    /**
+     * Create the ring, with room for `entries` submissions.  Returns false
+     * if the kernel does not support io_uring or does not allow it.
+     */
+    bool init(uint32_t entries)
+    {
+      io_uring_params p;
+      memset(&p, 0, sizeof(p));
+      fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+      if (fd < 0)
+        return false;
+
+      sq_entries = p.sq_entries;
+      cq_entries = p.cq_entries;
+      sq_map_size = p.sq_off.array + (p.sq_entries * sizeof(uint32_t));
+      cq_map_size = p.cq_off.cqes + (p.cq_entries * sizeof(io_uring_cqe));
+      if ((p.features & IORING_FEAT_SINGLE_MMAP) != 0)
+        sq_map_size = cq_map_size = std::max(sq_map_size, cq_map_size);
+
+      sq_map = map(fd, sq_map_size, IORING_OFF_SQ_RING);
+      if (sq_map == nullptr)
+        return false;
+      if ((p.features & IORING_FEAT_SINGLE_MMAP) != 0)
+        cq_map = sq_map;
+      else if ((cq_map = map(fd, cq_map_size, IORING_OFF_CQ_RING)) == nullptr)
+        return false;
+      sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+      sqes = static_cast<io_uring_sqe*>(map(fd, sqes_size, IORING_OFF_SQES));
+      if (sqes == nullptr)
+        return false;
+
+      sq_head = at<std::atomic<uint32_t>>(sq_map, p.sq_off.head);
+      sq_tail = at<std::atomic<uint32_t>>(sq_map, p.sq_off.tail);
+      sq_mask = *at<uint32_t>(sq_map, p.sq_off.ring_mask);
+      sq_array = at<uint32_t>(sq_map, p.sq_off.array);
+      cq_head = at<std::atomic<uint32_t>>(cq_map, p.cq_off.head);
+      cq_tail = at<std::atomic<uint32_t>>(cq_map, p.cq_off.tail);
+      cq_mask = *at<uint32_t>(cq_map, p.cq_off.ring_mask);
+      cqes = at<io_uring_cqe>(cq_map, p.cq_off.cqes);
+      return true;
+    }
+
+    /**
+     * A cleared submission entry to fill in, or nullptr if the submission
+     * queue is full, in which case `submit` makes room.
+     */
+    io_uring_sqe* get_sqe()
+    {
+      auto tail = sq_tail->load(std::memory_order_relaxed);
+      if (tail - sq_head->load(std::memory_order_acquire) == sq_entries)
+        return nullptr;
+
+      auto index = tail & sq_mask;
+      auto* sqe = &sqes[index];
+      memset(sqe, 0, sizeof(*sqe));
+      sq_array[index] = index;
+      sq_tail->store(tail + 1, std::memory_order_release);
+      unsubmitted++;
+      return sqe;
+    }
+
+    bool has_unsubmitted() const
+    {
+      return unsubmitted != 0;
+    }
+
+    /**
+     * Pass the entries filled in since the last call to the kernel, and
+     * wait for at least `wait` completions.  Returns a negative errno on
+     * failure.  A wait interrupted by a signal is not an error.
+     */
+    int submit(uint32_t wait = 0)
+    {
+      if ((unsubmitted == 0) && (wait == 0))
+        return 0;
+
+      auto r = (int)syscall(
+        __NR_io_uring_enter,
+        fd,
+        unsubmitted,
+        wait,
+        wait == 0 ? 0 : IORING_ENTER_GETEVENTS,
+        nullptr,
+        0);
+      if (r < 0)
+        return errno == EINTR ? 0 : -errno;
+      unsubmitted -= std::min<uint32_t>((uint32_t)r, unsubmitted);
+      return r;
+    }
+
+    /**
+     * Call `f` with the user data and result of each completion, and
+     * return how many there were.
+     */
+    template<typename F>
+    size_t reap(F&& f)
+    {
+      auto head = cq_head->load(std::memory_order_relaxed);
+      auto tail = cq_tail->load(std::memory_order_acquire);
+      size_t count = 0;
+      for (; head != tail; head++, count++)
+      {
+        auto& cqe = cqes[head & cq_mask];
+        f(cqe.user_data, cqe.res);
+      }
+      cq_head->store(head, std::memory_order_release);
+      return count;
+    }
+
+    /**
+     * Register `count` buffers, so that fixed reads and writes can name
+     * them by index, and the kernel does not map them for each operation.
+     */
+    int register_buffers(const iovec* buffers, unsigned count)
+    {
+      auto r = (int)syscall(
+        __NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, buffers, count);
+      return r < 0 ? -errno : 0;
+    }
+  };
+} // namespace verona::rt::pal
+#endif
@@ -0,0 +1,74 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <optional>
+#include <string>
+
+/**
+ * The memory limit the process runs under, for deciding the level to report
+ * to `ThreadPool::memory_pressure`.
+ *
+ * On Linux, this reads the cgroup v2 files of the process's cgroup, under
+ * `/sys/fs/cgroup`.  On other platforms, and without a cgroup v2 memory
+ * limit, there is nothing to read.
+ */
+namespace verona::rt::memorylimit
+{
+  struct Usage
+  {
+    /// Bytes charged to the cgroup, including the page cache.
+    size_t current;
+    size_t limit;
+  };
+
+#if defined(__linux__)
+  /// The directory of the process's cgroup v2, or an empty string.
+  inline std::string cgroup_directory()
+  {
+    std::ifstream f("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(f, line))
+    {
+      // The unified hierarchy is the line with id 0 and no controllers.
+      if (line.rfind("0::", 0) == 0)
+        return "/sys/fs/cgroup" + line.substr(3);
+    }
+    return "";
+  }
+
+  inline std::optional<size_t> read_bytes(const std::string& path)
+  {
+    std::ifstream f(path);
+    std::string value;
+    if (!(f >> value) || (value == "max"))
+      return std::nullopt;
+    return std::stoull(value);
+  }
+
+  /**
+   * The memory charged to the process's cgroup, and its `memory.max`, or
+   * nothing if it has no limit.  This reads files, so should be called
+   * periodically from a monitoring thread, rather than on every request.
+   */
+  inline std::optional<Usage> cgroup_usage()
+  {
+    auto dir = cgroup_directory();
+    if (dir.empty())
+      return std::nullopt;
+
+    auto limit = read_bytes(dir + "/memory.max");
+    auto current = read_bytes(dir + "/memory.current");
+    if (!limit || !current)
+      return std::nullopt;
+    return Usage{*current, *limit};
+  }
+#else
+  inline std::optional<Usage> cgroup_usage()
+  {
+    return std::nullopt;
+  }
+#endif
+} // namespace verona::rt::memorylimit
@@ -0,0 +1,68 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <snmalloc/snmalloc.h>
+
+#if defined(__linux__)
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+/**
+ * Placement of memory on NUMA nodes, numbered as in `Core::numa_node`.
+ *
+ * Memory is placed by page, so only the pages that lie entirely within a
+ * block are moved, which suits blocks of many pages, such as arenas and
+ * large cowns, and does nothing for small ones.  On Linux, this uses
+ * `mbind` directly, so that the runtime does not depend on libnuma.  On
+ * other platforms, and on kernels without NUMA support, memory stays where
+ * the allocator first touched it.
+ */
+namespace verona::rt::numa
+{
+  /// Highest node number, plus one, that `bind` accepts.
+  static constexpr size_t MAX_NODES = 1024;
+
+#if defined(__linux__) && defined(SYS_mbind)
+  /**
+   * Prefer node `node` for the pages within `[p, p + size)`, and move those
+   * already populated there.  Returns false if there are no such pages, or
+   * the kernel refused.
+   */
+  inline bool bind(void* p, size_t size, size_t node)
+  {
+    // From <numaif.h>.
+    static constexpr int MPOL_PREFERRED = 1;
+    static constexpr unsigned MPOL_MF_MOVE = 1 << 1;
+    static constexpr size_t BITS = sizeof(unsigned long) * 8;
+
+    if (node >= MAX_NODES)
+      return false;
+
+    static const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    auto start = snmalloc::bits::align_up((uintptr_t)p, page);
+    auto end = snmalloc::bits::align_down((uintptr_t)p + size, page);
+    if (start >= end)
+      return false;
+
+    unsigned long mask[MAX_NODES / BITS] = {};
+    mask[node / BITS] = 1UL << (node % BITS);
+    return syscall(
+             SYS_mbind,
+             start,
+             end - start,
+             MPOL_PREFERRED,
+             mask,
+             MAX_NODES,
+             MPOL_MF_MOVE) == 0;
+  }
+#else
+  inline bool bind(void*, size_t, size_t)
+  {
+    return false;
+  }
+#endif
+} // namespace verona::rt::numa
@@ -0,0 +1,51 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstddef>
+#include <snmalloc/snmalloc.h>
+
+#if defined(__linux__)
+#  include <sys/mman.h>
+#endif
+
+/**
+ * Faulting in memory ahead of time, for `ThreadPool::set_low_jitter`, so
+ * that the first uses of it do not take page faults.
+ */
+namespace verona::rt::prefault
+{
+  /// Bytes of stack that `stack` faults in.
+  static constexpr size_t STACK_SIZE = 256 * 1024;
+
+  /// Smallest page size, so that every page is touched.
+  static constexpr size_t PAGE_SIZE = 4096;
+
+  /**
+   * Fault in `STACK_SIZE` bytes of the calling thread's stack below the
+   * caller.
+   */
+  SNMALLOC_SLOW_PATH inline void stack()
+  {
+    volatile char buffer[STACK_SIZE];
+    for (size_t i = 0; i < STACK_SIZE; i += PAGE_SIZE)
+      buffer[i] = 0;
+  }
+
+#if defined(__linux__)
+  /**
+   * Lock every page of the process in memory, those mapped now and those
+   * mapped later, which also faults them in.  Returns false if this is not
+   * allowed, such as past `RLIMIT_MEMLOCK` without `CAP_IPC_LOCK`.
+   */
+  inline bool lock_all()
+  {
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+  }
+#else
+  inline bool lock_all()
+  {
+    return false;
+  }
+#endif
+} // namespace verona::rt::prefault
@@ -4,6 +4,7 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstdint>
 /**
  * This file provides a mechanism for threads to sleep and be woken.
  *
@@ -18,87 +19,162 @@
 #  if __has_include(<version>)
 #    include <version>
 #  endif
-#  if defined(__cpp_lib_semaphore)
-#    include <semaphore>
+#  if defined(__linux__)
+#    include <linux/futex.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
 namespace verona::rt::pal
 {
+  /**
+   * Binary semaphore built directly on futex.
+   *
+   * The state is 0 when empty, 1 when released and not yet acquired, and 2
+   * when the thread calling acquire may be sleeping in the kernel.  Release
+   * only makes a system call if there may be a sleeper.
+   */
   class SemaphoreImpl
   {
-    std::binary_semaphore semaphore_{0};
+    std::atomic<uint32_t> state{0};
+
+    static constexpr uint32_t Empty = 0;
+    static constexpr uint32_t Released = 1;
+    static constexpr uint32_t Sleeping = 2;
 
   public:
     void release()
     {
-      semaphore_.release();
+      if (state.exchange(Released, std::memory_order_release) == Sleeping)
+      {
+        syscall(
+          SYS_futex, &state, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+      }
     }
 
     void acquire()
     {
-      semaphore_.acquire();
+      while (true)
+      {
+        auto expected = Released;
+        if (state.compare_exchange_strong(
+              expected, Empty, std::memory_order_acquire))
+          return;
+
+        if (
+          (expected == Empty) &&
+          !state.compare_exchange_strong(
+            expected, Sleeping, std::memory_order_relaxed))
+          continue;
+
+        // Returns immediately if the state is no longer Sleeping.  Spurious
+        // wake ups and EINTR are handled by retrying.
+        syscall(
+          SYS_futex,
+          &state,
+          FUTEX_WAIT_PRIVATE,
+          Sleeping,
+          nullptr,
+          nullptr,
+          0);
+      }
     }
   };
 } // namespace verona::rt::pal
-#  elif defined(__APPLE__)
-#    include <dispatch/dispatch.h>
+#  elif defined(WIN32)
+#    define WIN32_LEAN_AND_MEAN
+#    ifndef NOMINMAX
+#      define NOMINMAX
+#    endif
+#    include <windows.h>
+#    pragma comment(lib, "Synchronization.lib")
 namespace verona::rt::pal
 {
+  /**
+   * Binary semaphore built on WaitOnAddress.  Uses the same protocol as the
+   * futex implementation.
+   */
   class SemaphoreImpl
   {
-    dispatch_semaphore_t semaphore_;
+    std::atomic<uint32_t> state{0};
+
+    static constexpr uint32_t Empty = 0;
+    static constexpr uint32_t Released = 1;
+    static constexpr uint32_t Sleeping = 2;
 
   public:
-    SemaphoreImpl()
+    void release()
     {
-      semaphore_ = dispatch_semaphore_create(0);
+      if (state.exchange(Released, std::memory_order_release) == Sleeping)
+        WakeByAddressSingle(&state);
     }
 
-    ~SemaphoreImpl()
+    void acquire()
     {
-      dispatch_release(semaphore_);
+      while (true)
+      {
+        auto expected = Released;
+        if (state.compare_exchange_strong(
+              expected, Empty, std::memory_order_acquire))
+          return;
+
+        if (
+          (expected == Empty) &&
+          !state.compare_exchange_strong(
+            expected, Sleeping, std::memory_order_relaxed))
+          continue;
+
+        uint32_t sleeping = Sleeping;
+        WaitOnAddress(&state, &sleeping, sizeof(state), INFINITE);
+      }
     }
+  };
+} // namespace verona::rt::pal
+#  elif defined(__cpp_lib_semaphore)
+#    include <semaphore>
+namespace verona::rt::pal
+{
+  class SemaphoreImpl
+  {
+    std::binary_semaphore semaphore_{0};
 
+  public:
     void release()
     {
-      dispatch_semaphore_signal(semaphore_);
+      semaphore_.release();
     }
 
     void acquire()
     {
-      dispatch_semaphore_wait(semaphore_, DISPATCH_TIME_FOREVER);
+      semaphore_.acquire();
     }
   };
 } // namespace verona::rt::pal
-#  elif defined(WIN32)
-#    define WIN32_LEAN_AND_MEAN
-#    ifndef NOMINMAX
-#      define NOMINMAX
-#    endif
-#    include <windows.h>
+#  elif defined(__APPLE__)
+#    include <dispatch/dispatch.h>
 namespace verona::rt::pal
 {
   class SemaphoreImpl
   {
-    HANDLE semaphore_;
+    dispatch_semaphore_t semaphore_;
 
   public:
     SemaphoreImpl()
     {
-      semaphore_ = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+      semaphore_ = dispatch_semaphore_create(0);
     }
 
     ~SemaphoreImpl()
     {
-      CloseHandle(semaphore_);
+      dispatch_release(semaphore_);
     }
 
     void release()
     {
-      ReleaseSemaphore(semaphore_, 1, NULL);
+      dispatch_semaphore_signal(semaphore_);
     }
 
     void acquire()
     {
-      WaitForSingleObject(semaphore_, INFINITE);
+      dispatch_semaphore_wait(semaphore_, DISPATCH_TIME_FOREVER);
     }
   };
 } // namespace verona::rt::pal
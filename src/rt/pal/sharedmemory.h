@@ -0,0 +1,86 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstddef>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+/**
+ * Named memory that can be mapped by several processes on the same host,
+ * such as the rings of `verona::cpp::remote_cown`.
+ *
+ * Names follow the rules of `shm_open`, so should start with a `/` and
+ * contain no others.  The memory is zeroed when it is created.  On platforms
+ * without POSIX shared memory, these fail and return nullptr.
+ */
+namespace verona::rt::shm
+{
+#if defined(__unix__) || defined(__APPLE__)
+  namespace detail
+  {
+    inline void* map(const char* name, size_t size, int flags)
+    {
+      int fd = shm_open(name, flags, 0600);
+      if (fd < 0)
+        return nullptr;
+
+      void* p = MAP_FAILED;
+      if (((flags & O_CREAT) == 0) || (ftruncate(fd, (off_t)size) == 0))
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      close(fd);
+
+      if ((p == MAP_FAILED) && ((flags & O_CREAT) != 0))
+        shm_unlink(name);
+      return (p == MAP_FAILED) ? nullptr : p;
+    }
+  }
+
+  /**
+   * Create and map `size` bytes called `name`.  Fails if the name is
+   * already in use.
+   */
+  inline void* create(const char* name, size_t size)
+  {
+    return detail::map(name, size, O_RDWR | O_CREAT | O_EXCL);
+  }
+
+  /// Map `size` bytes that another process created as `name`.
+  inline void* open(const char* name, size_t size)
+  {
+    return detail::map(name, size, O_RDWR);
+  }
+
+  inline void unmap(void* p, size_t size)
+  {
+    munmap(p, size);
+  }
+
+  /**
+   * Remove the name, so that no more processes can open it.  The memory is
+   * freed once every process has unmapped it.
+   */
+  inline void remove(const char* name)
+  {
+    shm_unlink(name);
+  }
+#else
+  inline void* create(const char*, size_t)
+  {
+    return nullptr;
+  }
+
+  inline void* open(const char*, size_t)
+  {
+    return nullptr;
+  }
+
+  inline void unmap(void*, size_t) {}
+
+  inline void remove(const char*) {}
+#endif
+} // namespace verona::rt::shm
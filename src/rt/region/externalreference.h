@@ -7,6 +7,7 @@
 #include "immutable.h"
 
 #include <snmalloc/snmalloc.h>
+#include <utility>
 
 namespace verona::rt
 {
@@ -85,6 +86,23 @@ namespace verona::rt
         return new (obj) ExternalRef(ert, o);
       }
 
+      /**
+       * Create external references to the `count` objects of `objects` in
+       * `region`, into `refs`.  The table makes room for all of them at once,
+       * rather than growing while they are added.
+       */
+      static void create_many(
+        ExternalReferenceTable* ert,
+        Object* const* objects,
+        size_t count,
+        ExternalRef** refs)
+      {
+        auto map = ert->get_map();
+        map->reserve(map->size() + count);
+        for (size_t i = 0; i < count; i++)
+          refs[i] = create(ert, objects[i]);
+      }
+
       /**
        * May only be called when `is_in` returns `true`.
        */
@@ -108,22 +126,64 @@ namespace verona::rt
     // entry in the map (if any) is removed as well.
     using ExternalMap = ObjectMap<std::pair<Object*, ExternalRef*>>;
 
-    ExternalMap* external_map;
+    /// Allocated on the first external reference, see `get_map`.
+    ExternalMap* external_map = nullptr;
+
+    static size_t size_of(const ExternalMap* map)
+    {
+      return (map == nullptr) ? 0 : map->size();
+    }
+
+    /**
+     * The map, allocated if this is the first external reference, so that
+     * regions without any cost no allocation.  The map grows incrementally,
+     * as the remembered set does, so creating an external reference does not
+     * pause to move every entry.
+     */
+    ExternalMap* get_map()
+    {
+      if (SNMALLOC_UNLIKELY(external_map == nullptr))
+      {
+        external_map = ExternalMap::create();
+        external_map->set_incremental(true);
+      }
+      return external_map;
+    }
 
   public:
-    ExternalReferenceTable() : external_map(ExternalMap::create()) {}
+    ExternalReferenceTable() {}
 
     void dealloc()
     {
+      if (external_map == nullptr)
+        return;
+
       for (auto it = external_map->begin(); it != external_map->end(); ++it)
         remove_ref(it);
 
       external_map->dealloc();
       heap::dealloc<sizeof(ExternalMap)>(external_map);
+      external_map = nullptr;
     }
 
+    /**
+     * Move the external references of `that` to this table.  As in
+     * `RememberedSet::merge`, only the smaller map is rehashed; the
+     * references of the larger one just have their table updated.
+     */
     void merge(ExternalReferenceTable* that)
     {
+      if (size_of(that->external_map) > size_of(external_map))
+      {
+        std::swap(external_map, that->external_map);
+        for (auto e : *external_map)
+          (*e.second)->ert.store(this, std::memory_order_relaxed);
+      }
+      if (size_of(that->external_map) == 0)
+        return;
+
+      external_map->reserve(external_map->size() + that->external_map->size());
+
       for (auto e : *that->external_map)
       {
         auto* ext_ref = *e.second;
@@ -136,7 +196,7 @@ namespace verona::rt
 
     void insert(Object* object, ExternalRef* ext_ref)
     {
-      auto unique = external_map->insert(std::make_pair(object, ext_ref)).first;
+      auto unique = get_map()->insert(std::make_pair(object, ext_ref)).first;
       assert(unique);
       UNUSED(unique);
     }
@@ -148,6 +208,23 @@ namespace verona::rt
       remove_ref(it);
     }
 
+    /**
+     * Remove the external references to every object except `keep`, as the
+     * objects have been collected.  This only visits the objects that have
+     * an external reference.
+     */
+    void erase_all_except(Object* keep)
+    {
+      if (external_map == nullptr)
+        return;
+
+      for (auto it = external_map->begin(); it != external_map->end(); ++it)
+      {
+        if (it.key() != keep)
+          remove_ref(it);
+      }
+    }
+
     void remove_ref(ExternalMap::Iterator& it)
     {
       auto*& ext_ref = it.value();
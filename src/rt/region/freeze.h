@@ -113,6 +113,11 @@ namespace verona::rt
    *  * `Object::RC` and `Object::SHARED` refer to immutable objects outside the
    *    current isolate.
    *
+   * Once the SCCs are complete, every `SCC_PTR` is pointed directly at its
+   * root.  Finding the root of an immutable object then never writes to it,
+   * whereas path halving would write to objects that other threads are
+   * reading.
+   *
    * The objects stack is used to keep track of the set of objects in the
    * region. Rather than copy the set up front, we lazily construct it using the
    * ring in the isolated regions. Every time we break the ring, we keep track
@@ -120,6 +125,8 @@ namespace verona::rt
    */
   class Freeze
   {
+    friend class ParallelFreeze;
+
   private:
     static Object* post_order_mark(Object* o)
     {
@@ -136,212 +143,338 @@ namespace verona::rt
     {
       assert(o->debug_is_iso());
 
-      ObjectStack objects;
-      ObjectStack dfs;
       ObjectStack iso;
-      ObjectStack pending;
-      ObjectStack dealloc_regions;
-
       iso.push(o);
 
       while (!iso.empty())
-      {
-        assert(objects.empty());
-        assert(dfs.empty());
+        apply_region(iso.pop(), iso);
 
-        Object* p = iso.pop();
-        assert(p->debug_is_iso());
+      assert(iso.empty());
+    }
 
-        // TODO(region): Right now we can only freeze trace regions. We'll
-        // probably need different strategies if we want to freeze other kinds
-        // of regions, e.g. copying objects out of an arena region.
-        assert(RegionTrace::is_trace_region(p->get_region()));
-        RegionTrace* reg = RegionTrace::get(p);
+    /**
+     * As `apply`, but freezes each region as a single SCC rooted at its iso
+     * object, with a count of one, without searching for the SCCs.  The
+     * rings of a region are scanned in order, pointing each object at the
+     * root and counting the pointers that leave the region, so this costs a
+     * linear pass over the objects rather than a depth first search.  This
+     * suits a graph that is published as a whole, such as a document tree,
+     * where the finer SCCs that `apply` finds would only be freed together.
+     *
+     * The graph is freed by a search from the root once its count reaches
+     * zero, so each region is collected first, as objects its iso object
+     * cannot reach would otherwise never be freed.  This adds a mark and
+     * sweep of the region, which is still linear in its objects.
+     */
+    static void apply_as_single_scc(Object* o)
+    {
+      assert(o->debug_is_iso());
 
-        // Drop the ISO mark on the entry point.
-        p->init_next(reg);
+      ObjectStack iso;
+      iso.push(o);
 
-        // Start with the graph entry point.
-        dfs.push(p);
+      while (!iso.empty())
+        apply_region_as_single_scc(iso.pop(), iso);
+    }
 
-        // Add the finaliser, and non-finaliser rings to objects.
-        objects.push(reg->next_not_root);
-        objects.push(reg->get_next());
+  private:
+    /**
+     * Freeze the region of the iso object `p` as a single SCC, see
+     * `apply_as_single_scc`, and push the iso objects of its subregions onto
+     * `iso`.
+     */
+    static void apply_region_as_single_scc(Object* p, ObjectStack& iso)
+    {
+      assert(p->debug_is_iso());
+      assert(RegionTrace::is_trace_region(p->get_region()));
+      RegionTrace* reg = RegionTrace::get(p);
 
-        // Mark region metadata object, so sweeping does not travel through it.
-        reg->Object::mark();
+      // Objects kept alive by additional roots are not reachable from `p`,
+      // so they could not be freed with the rest of the SCC.
+      if (!reg->additional_entry_points.empty())
+        abort();
 
-        while (!dfs.empty())
+      // Sweep the objects `p` cannot reach, so every object left in the
+      // rings is found by the search that frees the SCC.
+      RegionTrace::gc(p);
+      reg->settle(p);
+
+      // Drop the ISO mark on the entry point, so that it ends its ring.
+      p->init_next(reg);
+
+      ObjectStack fields;
+      for (Object* q : {reg->get_next(), reg->next_not_root})
+      {
+        while (q != reg)
         {
-          Object::RegionMD c;
+          Object* next = q->get_next();
+          q->clear_has_ext_ref();
+          q->trace(fields);
 
-          // Depth-first search has reached vertex q.
-          // This may be either a pre-order and post-order visit
-          Object* q_mark = dfs.pop();
-          Object* q = remove_post_order_mark(q_mark);
+          if (q == p)
+            q->make_nonatomic_scc();
+          else
+            q->set_scc(p);
 
-          if (q != q_mark)
+          while (!fields.empty())
           {
-            // Finished this part of the spanning tree
-            // If this is the head of the pending list, this means we have
-            // processed all children in the spanning tree and this should now
-            // be turned into a complete SCC with ref count 1.
-            if (q == pending.peek())
+            Object::RegionMD c;
+            Object* f = fields.pop();
+            Object* r = f->root_and_class(c);
+
+            switch (c)
             {
-              pending.pop();
-              q->root_and_class(c)->make_nonatomic_scc();
-              assert(c == Object::PENDING);
+              case Object::UNMARKED:
+              case Object::NONATOMIC_RC:
+                // In this region, whether or not it has been scanned yet.
+                assert((c == Object::UNMARKED) || (r == p));
+                break;
+
+              case Object::ISO:
+                iso.push(f);
+                break;
+
+              case Object::RC:
+              case Object::SHARED:
+                VERONA_LOG << "External reference during freeze: " << r
+                           << Logging::endl;
+                r->incref();
+                break;
+
+              default:
+                assert(0);
             }
-            continue;
           }
 
-          auto r = q->root_and_class(c);
+          q = next;
+        }
+      }
 
-          switch (c)
+      p->make_atomic();
+
+      reg->discard();
+      reg->dealloc();
+    }
+
+    /**
+     * Freeze the region of the iso object `p`, and push the iso objects of
+     * its subregions onto `iso`.  Regions can be frozen in any order, and in
+     * parallel, as a subregion is only reachable from its iso object, and
+     * the only state shared with other regions is the reference counts of
+     * complete immutable objects, which are atomic.
+     */
+    static void apply_region(Object* p, ObjectStack& iso)
+    {
+      ObjectStack objects;
+      ObjectStack dfs;
+      ObjectStack pending;
+      ObjectStack dealloc_regions;
+
+      assert(p->debug_is_iso());
+
+      // TODO(region): Right now we can only freeze trace regions. We'll
+      // probably need different strategies if we want to freeze other kinds
+      // of regions, e.g. copying objects out of an arena region.
+      assert(RegionTrace::is_trace_region(p->get_region()));
+      RegionTrace* reg = RegionTrace::get(p);
+      reg->settle(p);
+
+      // Drop the ISO mark on the entry point.
+      p->init_next(reg);
+
+      // Start with the graph entry point.
+      dfs.push(p);
+
+      // Add the finaliser, and non-finaliser rings to objects.
+      objects.push(reg->next_not_root);
+      objects.push(reg->get_next());
+
+      // Mark region metadata object, so sweeping does not travel through it.
+      reg->Object::mark();
+
+      while (!dfs.empty())
+      {
+        Object::RegionMD c;
+
+        // Depth-first search has reached vertex q.
+        // This may be either a pre-order and post-order visit
+        Object* q_mark = dfs.pop();
+        Object* q = remove_post_order_mark(q_mark);
+
+        // The search is order sensitive, so it cannot run ahead as `mark`
+        // does, but it can prefetch the next vertex while visiting this one.
+        if (!dfs.empty())
+          Aal::prefetch(remove_post_order_mark(dfs.peek())->real_start());
+
+        if (q != q_mark)
+        {
+          // Finished this part of the spanning tree
+          // If this is the head of the pending list, this means we have
+          // processed all children in the spanning tree and this should now
+          // be turned into a complete SCC with ref count 1.
+          if (q == pending.peek())
+          {
+            pending.pop();
+            q->root_and_class(c)->make_nonatomic_scc();
+            assert(c == Object::PENDING);
+          }
+          continue;
+        }
+
+        auto r = q->root_and_class(c);
+
+        switch (c)
+        {
+          case Object::PENDING:
           {
-            case Object::PENDING:
+            // We have found a reference back into one of the SCCs
+            // on the current path.  Collapse the path by unioning
+            // all the nodes up to that SCC.
+            auto rank = r->pending_rank();
+            while (r != (p = pending.peek()->root_and_class(c)))
             {
-              // We have found a reference back into one of the SCCs
-              // on the current path.  Collapse the path by unioning
-              // all the nodes up to that SCC.
-              auto rank = r->pending_rank();
-              while (r != (p = pending.peek()->root_and_class(c)))
+              assert(c == Object::PENDING);
+              // Rank used to keep the union/find data structure balanced
+              auto p_rank = p->pending_rank();
+              if (p_rank <= rank)
               {
-                assert(c == Object::PENDING);
-                // Rank used to keep the union/find data structure balanced
-                auto p_rank = p->pending_rank();
-                if (p_rank <= rank)
-                {
-                  p->set_scc(r);
-                  if (p_rank == rank)
-                    r->set_pending_rank(++rank);
-                }
-                else
-                {
-                  r->set_scc(p);
-                  rank = p_rank;
-                  r = p;
-                }
-                pending.pop();
+                p->set_scc(r);
+                if (p_rank == rank)
+                  r->set_pending_rank(++rank);
               }
-              break;
-            }
-
-            case Object::ISO:
-            {
-              // External Iso, process that later.
-              iso.push(q);
-              break;
+              else
+              {
+                r->set_scc(p);
+                rank = p_rank;
+                r = p;
+              }
+              pending.pop();
             }
+            break;
+          }
 
-            case Object::RC:
-            case Object::SHARED:
-            {
-              Logging::cout()
-                << "External reference during freeze: " << r << Logging::endl;
-              // External reference
-              r->incref();
-              break;
-            }
+          case Object::ISO:
+          {
+            // External Iso, process that later.
+            iso.push(q);
+            break;
+          }
 
-            case Object::NONATOMIC_RC:
-            {
-              // Reference to an already complete SCC, so incref it.
-              r->incref_nonatomic();
-              break;
-            }
+          case Object::RC:
+          case Object::SHARED:
+          {
+            VERONA_LOG << "External reference during freeze: " << r
+                       << Logging::endl;
+            // External reference
+            r->incref();
+            break;
+          }
 
-            case Object::UNMARKED:
-            {
-              // Lazily construct stack of sublists for gcing
-              objects.push(q->get_next());
-              // Clear the `has_ext_ref` bit.
-              q->clear_has_ext_ref();
-              // Add this to the current path we are exploring
-              q->set_pending();
-              pending.push(q);
-              // Push post-order mark, so we can revisit once subtree complete
-              dfs.push(post_order_mark(q));
-              // Add all the fields to the dfs
-              q->trace(dfs);
-              break;
-            }
+          case Object::NONATOMIC_RC:
+          {
+            // Reference to an already complete SCC, so incref it.
+            r->incref_nonatomic();
+            break;
+          }
 
-            default:
-              assert(0);
+          case Object::UNMARKED:
+          {
+            // Lazily construct stack of sublists for gcing
+            objects.push(q->get_next());
+            // Clear the `has_ext_ref` bit.
+            q->clear_has_ext_ref();
+            // Add this to the current path we are exploring
+            q->set_pending();
+            pending.push(q);
+            // Push post-order mark, so we can revisit once subtree complete
+            dfs.push(post_order_mark(q));
+            // Add all the fields to the dfs
+            q->trace(dfs);
+            break;
           }
+
+          default:
+            assert(0);
         }
+      }
 
-        // Finalise all the objects
-        // Move non-atomics to atomics
-        // Calculate list of things to be deallocated
-        LinkedObjectStack to_dealloc;
-        p = objects.pop();
-        while (true)
+      // Finalise all the objects
+      // Move non-atomics to atomics
+      // Flatten the union-find structure
+      // Calculate list of things to be deallocated
+      LinkedObjectStack to_dealloc;
+      p = objects.pop();
+      while (true)
+      {
+        switch (p->get_class())
         {
-          switch (p->get_class())
+          case Object::UNMARKED:
           {
-            case Object::UNMARKED:
-            {
-              // Node was unreachable deallocate it
-              auto next = p->get_next();
+            // Node was unreachable deallocate it
+            auto next = p->get_next();
 
-              assert(p != reg);
+            assert(p != reg);
 
-              // ISO marker has been dropped on entry point, so
-              // can pass nullptr here.
-              p->finalise(nullptr, dealloc_regions);
-              to_dealloc.push(p);
-              // Deallocate unreachable sub-regions
-              while (!dealloc_regions.empty())
-              {
-                Object* q = dealloc_regions.pop();
-                Region::release(q);
-              }
-
-              p = next;
-              continue;
-            }
-
-            case Object::NONATOMIC_RC:
+            // ISO marker has been dropped on entry point, so
+            // can pass nullptr here.
+            p->finalise(nullptr, dealloc_regions);
+            to_dealloc.push(p);
+            // Deallocate unreachable sub-regions
+            while (!dealloc_regions.empty())
             {
-              // Convert to atomic rc to allow sharing.
-              p->make_atomic();
-              break;
+              Object* q = dealloc_regions.pop();
+              Region::release(q);
             }
 
-            case Object::MARKED:
-              assert(p == reg);
+            p = next;
+            continue;
+          }
 
-            case Object::RC:
-            case Object::SCC_PTR:
-              break;
+          case Object::NONATOMIC_RC:
+          {
+            // Convert to atomic rc to allow sharing.
+            p->make_atomic();
+            break;
+          }
 
-            default:
-              assert(0);
+          case Object::SCC_PTR:
+          {
+            // Point straight at the root, so that finding it never writes
+            // to the objects once they are shared, see `root_and_class`.
+            Object::RegionMD c;
+            p->set_scc(p->root_and_class(c));
+            break;
           }
 
-          if (objects.empty())
+          case Object::MARKED:
+            assert(p == reg);
+
+          case Object::RC:
             break;
 
-          p = objects.pop();
+          default:
+            assert(0);
         }
 
-        // Finally deallocate objects.
-        while (!to_dealloc.empty())
-        {
-          Object* q = to_dealloc.pop();
-          q->destructor();
-          q->dealloc();
-        }
+        if (objects.empty())
+          break;
 
-        reg->discard();
-        reg->dealloc();
+        p = objects.pop();
+      }
+
+      // Finally deallocate objects.
+      while (!to_dealloc.empty())
+      {
+        Object* q = to_dealloc.pop();
+        q->destructor();
+        q->dealloc();
       }
 
+      reg->discard();
+      reg->dealloc();
+
       assert(objects.empty());
       assert(dfs.empty());
-      assert(iso.empty());
       assert(pending.empty());
       assert(dealloc_regions.empty());
     }
@@ -2,8 +2,12 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../debug/systematic.h"
 #include "../object/object.h"
 #include "linked_object_stack.h"
+#include "prefetch_queue.h"
+
+#include <atomic>
 
 namespace verona::rt
 {
@@ -14,39 +18,267 @@ namespace verona::rt
     inline void release(Object* o);
   } // namespace shared
 
+  namespace reclaimer
+  {
+    // This is used only to break a dependency cycle, see `Reclaimer`.
+    inline bool defer(Object* o);
+  } // namespace reclaimer
+
+  /**
+   * A shard of the counts of pinned SCC roots, see `Immutable::pin`.  Each
+   * thread uses its own shard, so changing a count only writes to memory
+   * the thread owns.  Shards are pooled: the deltas are not owned by the
+   * thread that recorded them, so a thread that exits leaves them to the
+   * next thread to take the shard.
+   */
+  class ImmutableShard : public snmalloc::Pooled<ImmutableShard>
+  {
+    friend class Immutable;
+
+    static constexpr size_t SLOTS = 16;
+
+    struct Entry
+    {
+      std::atomic<Object*> root{nullptr};
+
+      /// Change in the count of `root`, modulo the word size.
+      std::atomic<size_t> delta{0};
+    };
+
+    /// Set while the owning thread updates a pinned count.
+    std::atomic<bool> busy{false};
+
+    Entry entries[SLOTS];
+
+    Entry& entry(Object* root)
+    {
+      return entries[(reinterpret_cast<uintptr_t>(root) >> 6) % SLOTS];
+    }
+
+    static ImmutableShard& local();
+  };
+
+  using ImmutableShardPool =
+    snmalloc::Pool<ImmutableShard, snmalloc::Alloc::Config>;
+
+  class ThreadLocalImmutableShard
+  {
+    friend class ImmutableShard;
+
+    ImmutableShard* ptr;
+
+    ThreadLocalImmutableShard() : ptr(ImmutableShardPool::acquire()) {}
+
+    ~ThreadLocalImmutableShard()
+    {
+      ImmutableShardPool::release(ptr);
+    }
+  };
+
+  inline ImmutableShard& ImmutableShard::local()
+  {
+    static thread_local ThreadLocalImmutableShard shard;
+    return *shard.ptr;
+  }
+
   class Immutable
   {
+    friend class Reclaimer;
+
+    static inline std::atomic<bool> background{false};
+
+    /**
+     * Added to the count of a pinned root, so that it cannot reach zero while
+     * the deltas in the shards are outstanding.
+     */
+    static constexpr size_t PIN_BIAS = size_t{1} << 40;
+
   public:
     static void acquire(Object* o)
     {
       assert(o->debug_is_immutable());
-      o->immutable()->incref();
+      auto root = o->immutable();
+
+      if (root->is_pinned() && update_pinned(root, 1))
+        return;
+
+      root->incref();
     }
 
+    /**
+     * Release a reference to the immutable graph of `o`, and return the
+     * number of bytes freed.  If the graph is freed in the background, see
+     * `set_background_free`, this returns 0.
+     */
     static size_t release(Object* o)
     {
       assert(o->debug_is_immutable());
       auto root = o->immutable();
 
+      if (root->is_pinned() && update_pinned(root, size_t(-1)))
+        return 0;
+
       if (root->decref())
-        return free(root);
+        return collect(root);
+
+      return 0;
+    }
+
+    /**
+     * Shard the count of the SCC root of `o`, which is expected to be shared
+     * by many threads and to live a long time.  Until `retire` is called,
+     * `acquire` and `release` on the graph only write to a shard owned by
+     * the calling thread, instead of the root.  The graph is not freed while
+     * it is pinned, even if its last reference is released.
+     *
+     * The caller must hold a reference to the graph.  Returns false if the
+     * root was already pinned.  Pinning and retiring the same root must not
+     * race.
+     */
+    static bool pin(Object* o)
+    {
+      assert(o->debug_is_immutable());
+      auto root = o->immutable();
+
+      // The bias goes on before the bit, so that no count taken from a shard
+      // can reach zero on the root.
+      root->get_header().rc.fetch_add(PIN_BIAS * Object::ONE_RC);
+      if (!root->set_pinned())
+      {
+        root->get_header().rc.fetch_sub(PIN_BIAS * Object::ONE_RC);
+        return false;
+      }
+
+      VERONA_LOG << "Immutable pinned: " << root << Logging::endl;
+      return true;
+    }
+
+    /**
+     * Stop sharding the count of the SCC root of `o`, which must be pinned.
+     * The deltas in all the shards are added back to the root.  If the graph
+     * has no references left, it is freed, and the number of bytes freed is
+     * returned, as for `release`.
+     */
+    static size_t retire(Object* o)
+    {
+      assert(o->debug_is_immutable());
+      auto root = o->immutable();
+      assert(root->is_pinned());
+      root->clear_pinned();
+
+      // A thread that saw the bit is busy until it has updated its shard.
+      // Once it is not busy, the entry for this root can be drained, as
+      // later updates see the bit is clear.
+      size_t total = 0;
+      for (auto s = ImmutableShardPool::iterate(); s != nullptr;
+           s = ImmutableShardPool::iterate(s))
+      {
+        while (s->busy.load())
+        {
+          Systematic::yield();
+          Aal::pause();
+        }
+
+        for (auto& e : s->entries)
+        {
+          if (e.root.load(std::memory_order_relaxed) != root)
+            continue;
+
+          total += e.delta.load(std::memory_order_relaxed);
+          e.delta.store(0, std::memory_order_relaxed);
+          e.root.store(nullptr, std::memory_order_release);
+        }
+      }
+
+      VERONA_LOG << "Immutable retired: " << root << Logging::endl;
+
+      size_t remove = (PIN_BIAS - total) * Object::ONE_RC;
+      auto old = root->get_header().rc.fetch_sub(remove);
+      if ((old - remove) == (size_t)Object::RC)
+        return collect(root);
 
       return 0;
     }
 
+    /**
+     * Free graphs whose last reference is released on a scheduler thread in
+     * a separate work item, see `Reclaimer`, so that the releasing behaviour
+     * only does the final decref.  Off by default.
+     */
+    static void set_background_free(bool on)
+    {
+      background.store(on, std::memory_order_relaxed);
+    }
+
   private:
+    /**
+     * Record a change of `delta` to the count of the pinned `root` in this
+     * thread's shard.  Returns false if `root` is no longer pinned, and the
+     * count must be changed on the root.
+     */
+    static bool update_pinned(Object* root, size_t delta)
+    {
+      auto& s = ImmutableShard::local();
+
+      // Pairs with clearing the bit and reading `busy` in `retire`.
+      s.busy.store(true);
+      if (!root->is_pinned())
+      {
+        s.busy.store(false, std::memory_order_release);
+        return false;
+      }
+
+      auto& e = s.entry(root);
+      auto r = e.root.load(std::memory_order_acquire);
+      if ((r == root) || (r == nullptr))
+      {
+        e.root.store(root, std::memory_order_relaxed);
+        e.delta.store(
+          e.delta.load(std::memory_order_relaxed) + delta,
+          std::memory_order_relaxed);
+      }
+      else
+      {
+        // The entry is used by another root.  The bias keeps this from
+        // reaching zero, so there is nothing to check.
+        root->get_header().rc.fetch_add(delta * Object::ONE_RC);
+      }
+
+      s.busy.store(false, std::memory_order_release);
+      return true;
+    }
+
+    /// Free the graph of `root`, whose count has reached zero.
+    static size_t collect(Object* root)
+    {
+      if (background.load(std::memory_order_relaxed) && reclaimer::defer(root))
+        return 0;
+
+      return free(root);
+    }
+
     static size_t free(Object* o)
     {
       assert(o == o->immutable());
+      LinkedObjectStack dfs;
+      dfs.push(o);
+      return free_all(dfs, [](LinkedObjectStack&) {});
+    }
+
+    /**
+     * Free the graphs of the SCC roots on `dfs`, whose counts have reached
+     * zero.  After each SCC, `split` is given `dfs`, and may take roots off
+     * it to free elsewhere, as the graphs of the roots are independent.
+     */
+    template<typename Split>
+    static size_t free_all(LinkedObjectStack& dfs, Split&& split)
+    {
       size_t total = 0;
 
       // Free immutable graph.
       ObjectStack f;
       LinkedObjectStack fl;
       LinkedObjectStack scc;
-      LinkedObjectStack dfs;
-
-      dfs.push(o);
 
       while (!dfs.empty())
       {
@@ -62,9 +294,10 @@ namespace verona::rt
           fl.push(w);
           w->trace(f);
 
-          while (!f.empty())
+          PrefetchQueue<> queue(f);
+          while (!queue.empty())
           {
-            Object* u = f.pop();
+            Object* u = queue.pop();
             scc_classify(u, dfs, scc);
           }
         }
@@ -79,6 +312,8 @@ namespace verona::rt
           w->destructor();
           w->dealloc();
         }
+
+        split(dfs);
       }
 
       assert(f.empty());
@@ -122,7 +357,7 @@ namespace verona::rt
 
         case Object::SHARED:
         {
-          Logging::cout() << "Immutable releasing cown: " << w << Logging::endl;
+          VERONA_LOG << "Immutable releasing cown: " << w << Logging::endl;
           shared::release(w);
           break;
         }
@@ -0,0 +1,75 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../object/object.h"
+
+namespace verona::rt
+{
+  /**
+   * Helper class for popping objects off an `ObjectStack` a little ahead of
+   * when they are processed.
+   *
+   * Objects are taken off the stack into a small FIFO, and the header of each
+   * is prefetched as it enters, so that by the time it leaves the header is
+   * likely to be in cache.  The traversal pushes the fields it finds to the
+   * stack as usual.  This only suits traversals whose correctness does not
+   * depend on the order objects are visited in.
+   *
+   * Objects still in the FIFO are pushed back to the stack on destruction, so
+   * a traversal may stop early.
+   **/
+  template<size_t N = 8>
+  class PrefetchQueue
+  {
+    static_assert(bits::is_pow2(N), "Queue size must be a power of two");
+
+  private:
+    ObjectStack& stack;
+    Object* queue[N];
+    size_t head = 0;
+    size_t count = 0;
+
+    void fill()
+    {
+      while ((count < N) && !stack.empty())
+      {
+        Object* p = stack.pop();
+        Aal::prefetch(p->real_start());
+        queue[(head + count) & (N - 1)] = p;
+        count++;
+      }
+    }
+
+  public:
+    explicit PrefetchQueue(ObjectStack& s) : stack(s) {}
+
+    PrefetchQueue(const PrefetchQueue&) = delete;
+    PrefetchQueue& operator=(const PrefetchQueue&) = delete;
+
+    ~PrefetchQueue()
+    {
+      while (count > 0)
+      {
+        count--;
+        stack.push(queue[(head + count) & (N - 1)]);
+      }
+    }
+
+    bool empty()
+    {
+      return (count == 0) && stack.empty();
+    }
+
+    Object* pop()
+    {
+      fill();
+      assert(count > 0);
+
+      Object* p = queue[head];
+      head = (head + 1) & (N - 1);
+      count--;
+      return p;
+    }
+  };
+} // namespace verona::rt
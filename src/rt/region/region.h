@@ -134,6 +134,56 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Empty the arena region represented by Iso object `o`, so that it only
+     * holds `o`, see `RegionArena::reset_internal`.  The regions that the
+     * discarded objects owned are released.
+     **/
+    static void reset(Object* o)
+    {
+      ObjectStack collect;
+      RegionArena::get(o)->reset_internal(o, collect);
+
+      while (!collect.empty())
+      {
+        o = collect.pop();
+        assert(o->debug_is_iso());
+        Region::release_internal(o, collect);
+      }
+    }
+
+    /**
+     * Copy the region represented by the Iso object `o` into a new region of
+     * the same kind, and return the copy of `o`, or nullptr if the region
+     * cannot be copied.  The copy refers to the same immutable objects and
+     * cowns, and holds its own references to them.  External references to
+     * the region are not copied.
+     *
+     * The objects are copied byte by byte, so every object must be clonable,
+     * see `RegionBase::is_clonable`, and the region must not refer to other
+     * regions, or hold adopted buffers.  For arena regions, this costs about
+     * as much as copying the arenas, see `RegionArena::clone_internal`.
+     * Trace and rc regions only copy the objects reachable from `o`, see
+     * `clone_reachable`.
+     **/
+    static Object* clone(Object* o)
+    {
+      assert(o->debug_is_iso());
+      auto r = o->get_region();
+      switch (Region::get_type(r))
+      {
+        case RegionType::Trace:
+          ((RegionTrace*)r)->settle(o);
+          return clone_reachable<RegionType::Trace>(o);
+        case RegionType::Arena:
+          return ((RegionArena*)r)->clone_internal(o);
+        case RegionType::Rc:
+          return clone_reachable<RegionType::Rc>(o);
+        default:
+          abort();
+      }
+    }
+
     /**
      * Returns the region metadata object for the given Iso object `o`.
      *
@@ -147,6 +197,122 @@ namespace verona::rt
     }
 
   private:
+    /**
+     * Copy the objects reachable from the Iso object `o` into a new region
+     * of kind `type`, see `clone`.  The reachable objects are found first,
+     * so that nothing is allocated for a region that cannot be copied, and
+     * are kept in a map from each object to its copy, through which the
+     * pointers of the copies are then redirected.
+     *
+     * In an rc region, each object starts with a count of one, for the first
+     * pointer to it, and each further pointer adds one.  Each pointer to an
+     * immutable object or cown holds a reference to it.  In a trace region,
+     * these are held by the remembered set instead.
+     **/
+    template<RegionType type>
+    static Object* clone_reachable(Object* o)
+    {
+      using RegionClass = typename RegionType_to_class<type>::T;
+      RegionBase* r = o->get_region();
+
+      ObjectMap<std::pair<Object*, Object*>> forward;
+      ObjectStack dfs;
+      forward.insert(std::make_pair(o, (Object*)nullptr));
+      dfs.push(o);
+      while (!dfs.empty())
+      {
+        Object* p = dfs.pop();
+        auto desc = p->get_descriptor();
+        if (!RegionBase::is_clonable(desc))
+          return nullptr;
+
+        for (size_t i = 0; i < desc->field_count; i++)
+        {
+          Object* f = RegionBase::field(p, desc, i);
+          switch (r->clone_target(f))
+          {
+            case RegionBase::CloneTarget::Internal:
+              if (forward.insert(std::make_pair(f, (Object*)nullptr)).first)
+                dfs.push(f);
+              break;
+
+            case RegionBase::CloneTarget::Invalid:
+              return nullptr;
+
+            default:
+              break;
+          }
+        }
+      }
+
+      Object* root = RegionClass::create(o->get_descriptor());
+      for (auto it = forward.begin(); it != forward.end(); ++it)
+      {
+        Object* p = it.key();
+        auto desc = p->get_descriptor();
+        Object* q = root;
+        if (p != o)
+        {
+          if constexpr (type == RegionType::Rc)
+            q = RegionRc::alloc(RegionRc::get(root), desc);
+          else
+            q = RegionClass::alloc(root, desc);
+        }
+        memcpy((void*)q, (void*)p, desc->size - sizeof(Object::Header));
+        it.value() = q;
+      }
+
+      size_t entry_points = 1;
+      for (auto it = forward.begin(); it != forward.end(); ++it)
+      {
+        Object* q = it.value();
+        auto desc = q->get_descriptor();
+        for (size_t i = 0; i < desc->field_count; i++)
+        {
+          auto& f = RegionBase::field(q, desc, i);
+          switch (r->clone_target(f))
+          {
+            case RegionBase::CloneTarget::Internal:
+              f = forward.find(f).value();
+              if constexpr (type == RegionType::Rc)
+              {
+                if (f == root)
+                  entry_points++;
+                else
+                  RegionRc::incref(f);
+              }
+              break;
+
+            case RegionBase::CloneTarget::External:
+            {
+              Object::RegionMD c;
+              Object* t = f->root_and_class(c);
+              t->incref();
+              if constexpr (type != RegionType::Rc)
+                RegionClass::template insert<YesTransfer>(root, t);
+              break;
+            }
+
+            default:
+              break;
+          }
+        }
+      }
+
+      if constexpr (type == RegionType::Rc)
+      {
+        // Undo the count of one that each object was allocated with.
+        for (auto it = forward.begin(); it != forward.end(); ++it)
+        {
+          if (it.value() != root)
+            RegionRc::decref_inner(it.value());
+        }
+        RegionRc::get(root)->entry_point_count = entry_points;
+      }
+
+      return root;
+    }
+
     /**
      * Internal method for releasing and deallocating regions, that takes
      * a worklist (represented by `f` and `collect`).
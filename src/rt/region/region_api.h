@@ -15,10 +15,35 @@ namespace verona::rt::api
       {
         Object* entry_point;
         RegionBase* region;
-        RegionFrame* prev;
       };
 
-      RegionFrame* top;
+      /// Depth of the stack of open regions that needs no allocation.  Deeper
+      /// stacks move to the heap, until they are half as deep again.
+      static constexpr size_t INLINE_FRAMES = 16;
+
+      RegionFrame inline_frames[INLINE_FRAMES];
+
+      /// The stack of open regions, the current region last.  This is
+      /// `inline_frames` unless the stack has been deeper than that.
+      RegionFrame* frames = inline_frames;
+      size_t capacity = INLINE_FRAMES;
+      size_t depth = 0;
+
+      RegionFrame& top()
+      {
+        assert(depth > 0);
+        return frames[depth - 1];
+      }
+
+      /// Move the stack to a block of `new_capacity` frames.
+      void move_frames(RegionFrame* to, size_t new_capacity)
+      {
+        std::copy(frames, frames + depth, to);
+        if (frames != inline_frames)
+          heap::dealloc(frames, capacity * sizeof(RegionFrame));
+        frames = to;
+        capacity = new_capacity;
+      }
 
     public:
       static RegionContext& get_region_context()
@@ -29,29 +54,48 @@ namespace verona::rt::api
 
       static void push(Object* entry_point, RegionBase* region)
       {
-        RegionFrame* frame = new RegionFrame();
-        frame->entry_point = entry_point;
-        frame->region = region;
-        frame->prev = get_region_context().top;
-        get_region_context().top = frame;
+        auto& t = get_region_context();
+        if (SNMALLOC_UNLIKELY(t.depth == t.capacity))
+        {
+          size_t new_capacity = t.capacity * 2;
+          t.move_frames(
+            (RegionFrame*)heap::alloc(new_capacity * sizeof(RegionFrame)),
+            new_capacity);
+        }
+        t.frames[t.depth++] = {entry_point, region};
       }
 
       static void pop()
       {
         auto& t = get_region_context();
-        RegionFrame* frame = t.top;
-        t.top = frame->prev;
-        delete frame;
+        assert(t.depth > 0);
+        t.depth--;
+        if (SNMALLOC_UNLIKELY(
+              (t.frames != t.inline_frames) && (t.depth <= INLINE_FRAMES / 2)))
+          t.move_frames(t.inline_frames, INLINE_FRAMES);
       }
 
       static Object*& get_entry_point()
       {
-        return get_region_context().top->entry_point;
+        return get_region_context().top().entry_point;
       }
 
       static RegionBase* get_region()
       {
-        return get_region_context().top->region;
+        return get_region_context().top().region;
+      }
+
+      /// Whether the current region is also open further down the stack.
+      static bool is_nested()
+      {
+        auto& t = get_region_context();
+        auto region = t.top().region;
+        for (size_t i = t.depth - 1; i > 0; i--)
+        {
+          if (t.frames[i - 1].region == region)
+            return true;
+        }
+        return false;
       }
     };
   }
@@ -92,7 +136,10 @@ namespace verona::rt::api
   }
 
   /**
-   * Close current region
+   * Close current region.  A trace region that has grown enough is collected
+   * when it is no longer open, see `RegionTrace::set_gc_growth_factor`, and
+   * the cycles of an rc region are collected once enough candidates are
+   * buffered, see `RegionRc::set_cycle_threshold`.
    */
   inline void close_region()
   {
@@ -100,9 +147,15 @@ namespace verona::rt::api
     switch (Region::get_type(md))
     {
       case RegionType::Trace:
+        if (!RegionContext::is_nested())
+          RegionTrace::auto_gc(RegionContext::get_entry_point());
+        break;
       case RegionType::Arena:
         break;
       case RegionType::Rc:
+        if (!RegionContext::is_nested())
+          RegionRc::auto_gc_cycles(
+            RegionContext::get_entry_point(), (RegionRc*)md);
         ((RegionRc*)md)->close(RegionContext::get_entry_point());
         break;
       default:
@@ -137,6 +190,17 @@ namespace verona::rt::api
     return r;
   }
 
+  /**
+   * Freeze region as a single immutable SCC, see
+   * `Freeze::apply_as_single_scc`.
+   */
+  template<typename T = Object>
+  inline T* freeze_as_single_scc(T* r)
+  {
+    Freeze::apply_as_single_scc(r);
+    return r;
+  }
+
   /**
    * Add supplied region to the current region
    * and return the entry point.
@@ -171,6 +235,16 @@ namespace verona::rt::api
     return ExternalRef::create(RegionContext::get_region(), o);
   }
 
+  /**
+   * Create external references to the `count` objects of `objects` in the
+   * current region, into `refs`.
+   */
+  inline void create_external_references(
+    Object* const* objects, size_t count, ExternalRef** refs)
+  {
+    ExternalRef::create_many(RegionContext::get_region(), objects, count, refs);
+  }
+
   /**
    * Check if external reference is in the current region and still valid.
    */
@@ -188,6 +262,31 @@ namespace verona::rt::api
     return e->get();
   }
 
+  /**
+   * Resolve the `count` external references of `refs` into `objects`, where
+   * a reference that is not valid in the current region resolves to
+   * `nullptr`.  Returns how many were valid.
+   */
+  inline size_t resolve_external_references(
+    ExternalRef* const* refs, size_t count, Object** objects)
+  {
+    auto* region = RegionContext::get_region();
+    size_t valid = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      if (refs[i]->is_in(region))
+      {
+        objects[i] = refs[i]->get();
+        valid++;
+      }
+      else
+      {
+        objects[i] = nullptr;
+      }
+    }
+    return valid;
+  }
+
   /**
    * Create object in current region
    */
@@ -207,6 +306,19 @@ namespace verona::rt::api
     abort();
   }
 
+  /**
+   * Make the current region, which must be an arena region, the owner of the
+   * `size` bytes at `buf`, without copying them.  They are given back to
+   * `pool` when the region is reset or released, see `RegionArena::adopt`.
+   */
+  inline void* adopt_buffer(void* buf, size_t size, BufferPool* pool)
+  {
+    assert(
+      Region::get_type(RegionContext::get_region()) == RegionType::Arena);
+    return RegionArena::adopt(
+      RegionContext::get_entry_point(), buf, size, pool);
+  }
+
   inline void add_reference(Object*)
   {
     // TODO
@@ -284,12 +396,109 @@ namespace verona::rt::api
     }
   }
 
+  /**
+   * Collect the current region and move its surviving objects together, if
+   * it is a trace region, see `RegionTrace::compact`.  Pointers into the
+   * region held elsewhere than in its entry point and additional roots are
+   * no longer valid afterwards.
+   **/
+  inline void region_compact()
+  {
+    if (Region::get_type(RegionContext::get_region()) == RegionType::Trace)
+      RegionTrace::compact(RegionContext::get_entry_point());
+  }
+
+  /**
+   * Do up to about `budget` objects' worth of an incremental collection of
+   * the current region, see `RegionTrace::gc_step`.  Returns true if this
+   * finished a collection.  Regions other than trace regions are collected
+   * in one go.
+   **/
+  inline bool region_collect_step(size_t budget)
+  {
+    switch (Region::get_type(RegionContext::get_region()))
+    {
+      case RegionType::Trace:
+        return RegionTrace::gc_step(RegionContext::get_entry_point(), budget);
+      default:
+        region_collect();
+        return true;
+    }
+  }
+
+  /**
+   * Must be called after storing `target` into a field of an object in the
+   * current region, while it may be collected incrementally.
+   **/
+  inline void region_write_barrier(Object* target)
+  {
+    if (Region::get_type(RegionContext::get_region()) == RegionType::Trace)
+      RegionTrace::write_barrier(RegionContext::get_entry_point(), target);
+  }
+
+  /**
+   * As above, while the current region may have a nursery: `target` has
+   * been stored into a field of `src`, see `RegionTrace::set_nursery`.
+   **/
+  inline void region_write_barrier(Object* src, Object* target)
+  {
+    if (Region::get_type(RegionContext::get_region()) == RegionType::Trace)
+      RegionTrace::write_barrier(
+        RegionContext::get_entry_point(), src, target);
+  }
+
+  /**
+   * Run a minor collection of the current region, if it is a trace region,
+   * see `RegionTrace::gc_young`.
+   **/
+  inline void region_collect_young()
+  {
+    if (Region::get_type(RegionContext::get_region()) == RegionType::Trace)
+      RegionTrace::gc_young(RegionContext::get_entry_point());
+  }
+
   template<typename T = Object>
   inline void region_release(Object* r)
   {
     Region::release(r);
   }
 
+  /**
+   * Empty the arena region `r` for reuse, keeping only its entry point, see
+   * `Region::reset`.
+   **/
+  inline void region_reset(Object* r)
+  {
+    Region::reset(r);
+  }
+
+  /**
+   * Return the entry point of a copy of the region whose entry point is `r`,
+   * or nullptr if it cannot be copied, see `Region::clone`.
+   **/
+  inline Object* region_clone(Object* r)
+  {
+    return Region::clone(r);
+  }
+
+  /**
+   * Return the bytes of objects in the region whose entry point is `r`.  The
+   * usage of a cown is that of the regions it holds.
+   **/
+  inline size_t region_memory_used(Object* r)
+  {
+    return Region::get(r)->get_memory_used();
+  }
+
+  /**
+   * Set the soft and hard memory quotas of the region whose entry point is
+   * `r`, see `RegionBase::set_memory_quota`.
+   **/
+  inline void region_set_memory_quota(Object* r, size_t soft, size_t hard)
+  {
+    Region::get(r)->set_memory_quota(soft, hard);
+  }
+
   /**
    * Return the size of the current region.
    *
@@ -321,4 +530,4 @@ namespace verona::rt::api
         abort();
     }
   }
-} // namespace verona::rt
\ No newline at end of file
+} // namespace verona::rt
@@ -3,14 +3,40 @@
 #pragma once
 
 #include "../object/object.h"
+#include "../pal/hugepage.h"
+#include "../pal/numa.h"
 #include "region_base.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <cstring>
+#include <vector>
 
 namespace verona::rt
 {
   using namespace snmalloc;
 
+  /**
+   * Where the arenas of an arena region come from, see `RegionArena::create`.
+   * `dealloc` is passed the size that was passed to `alloc`.
+   **/
+  struct ArenaSource
+  {
+    void* (*alloc)(size_t size);
+    void (*dealloc)(void* p, size_t size);
+  };
+
+  /**
+   * Where a buffer adopted by an arena region came from, such as a pool of
+   * I/O buffers, see `RegionArena::adopt`.  `recycle` is passed the buffer
+   * and its size when the region is reset or released, on whichever thread
+   * does so.
+   **/
+  struct BufferPool
+  {
+    void (*recycle)(BufferPool* pool, void* buf, size_t size);
+  };
+
   /**
    * Please see region.h for the full documentation.
    *
@@ -27,6 +53,18 @@ namespace verona::rt
    * then allocate the object within the new arena. Note that we do not do
    * first fit or best fit.
    *
+   * Arenas are 1 MiB by default, which wastes most of an arena for small
+   * regions.  The size of the arenas of a region can be chosen when it is
+   * created, or changed later, see `set_arena_size`.  Where the arenas come
+   * from is chosen when the region is created, see `ArenaSource`.
+   *
+   * A region can be emptied for reuse, see `reset_internal`.  It then keeps
+   * a few of its arenas, so that refilling it does not allocate them again.
+   *
+   * A region can also take ownership of memory allocated elsewhere, such as
+   * a received packet, without copying it, see `adopt`.  The memory is given
+   * back to its `BufferPool` when the region is reset or released.
+   *
    * Note that if the Iso is allocated within an arena, it will still point to
    * the arena region object.
    *
@@ -52,7 +90,8 @@ namespace verona::rt
     friend class RegionRc;
 
     /**
-     * An Arena is a large block of pre-allocated memory. It has an overhead of
+     * An Arena is a block of pre-allocated memory, by default 1 MiB, with the
+     * objects directly after the Arena header. It has an overhead of
      * four pointers: the next Arena in the linked list, and three pointers to
      * keep track of where objects are allocated. The next pointers of all
      * objects inside an arena are set to nullptr. An initialized arena is
@@ -110,14 +149,31 @@ namespace verona::rt
      *
      * We can calculate the remaining free space by taking the difference of
      * `non_trivial_begin` and `objects_end`.
+     *
+     * As the non-trivial objects are kept apart, releasing or resetting a
+     * region only visits those objects and the large object ring.  The
+     * trivial objects are freed with their arena without being touched, so
+     * tearing down a region of mostly trivial objects costs little more than
+     * freeing its arenas.
      **/
-    class Arena
+    class alignas(Object::ALIGNMENT) Arena
     {
+      friend class RegionArena;
       template<IteratorType type>
       friend class RegionArena::iterator;
 
     public:
-      static constexpr size_t SIZE = 1024 * 1024 - 4 * sizeof(uintptr_t);
+      /**
+       * Size of the allocation holding an arena, unless the region says
+       * otherwise, see `set_arena_size`.
+       **/
+      static constexpr size_t DEFAULT_SIZE = 1024 * 1024;
+
+      /**
+       * Space for objects in a default sized arena.  Larger objects are put in
+       * the large object ring, whatever the size of the arenas of the region.
+       **/
+      static constexpr size_t SIZE = DEFAULT_SIZE - 4 * sizeof(uintptr_t);
 
       /**
        * Pointer to next arena in the linked list.
@@ -137,25 +193,86 @@ namespace verona::rt
       std::byte* non_trivial_begin;
 
       /**
-       * Pointer to the byte after the Arena. We technically don't need to
-       * store this pointer, but we have some space because `objects_begin`
-       * needs to be aligned.
+       * Pointer to the byte after the Arena.  This also gives the size of the
+       * arena, which varies.
        **/
       std::byte* non_trivial_end;
 
+      explicit Arena(size_t capacity)
+      : next(nullptr),
+        objects_end(objects_begin()),
+        non_trivial_begin(objects_begin() + capacity),
+        non_trivial_end(non_trivial_begin)
+      {
+        assert(free_space() == capacity);
+      }
+
       /**
-       * Where objects will actually be allocated.
+       * Where objects will actually be allocated, directly after the Arena.
        **/
-      alignas(Object::ALIGNMENT) std::byte objects_begin[SIZE];
+      std::byte* objects_begin() const
+      {
+        return (std::byte*)(this + 1);
+      }
 
     public:
-      Arena()
-      : next(nullptr),
-        objects_end(objects_begin),
-        non_trivial_begin(objects_begin + SIZE),
-        non_trivial_end(non_trivial_begin)
+      /**
+       * Allocate an arena from `source` with space for `capacity` bytes of
+       * objects, which must be a multiple of `Object::ALIGNMENT`.
+       **/
+      static Arena* make(size_t capacity, const ArenaSource* source)
+      {
+        assert(capacity % Object::ALIGNMENT == 0);
+        void* p = source->alloc(sizeof(Arena) + capacity);
+        return new (p) Arena(capacity);
+      }
+
+      void dealloc(const ArenaSource* source)
       {
-        assert(free_space() == SIZE);
+        std::ptrdiff_t diff = non_trivial_end - (std::byte*)this;
+        source->dealloc(this, (size_t)diff);
+      }
+
+      inline size_t capacity() const
+      {
+        std::ptrdiff_t diff = non_trivial_end - objects_begin();
+        return (size_t)diff;
+      }
+
+      /**
+       * Empty the arena, so that it can be reused.
+       **/
+      void rewind()
+      {
+        next = nullptr;
+        objects_end = objects_begin();
+        non_trivial_begin = non_trivial_end;
+      }
+
+      /**
+       * Whether `o`, which takes up `sz` bytes, was the first object
+       * allocated in the arena of its kind.
+       **/
+      bool is_first(Object* o, size_t sz) const
+      {
+        if (o->is_trivial())
+          return o->real_start() == objects_begin();
+        return o->real_start() + sz == non_trivial_end;
+      }
+
+      /**
+       * Empty the arena, except for `o`, which takes up `sz` bytes and must be
+       * the first object allocated in the arena, see `is_first`.
+       **/
+      void rewind_to(Object* o, size_t sz)
+      {
+        assert(is_first(o, sz));
+        rewind();
+        if (o->is_trivial())
+          objects_end += sz;
+        else
+          non_trivial_begin -= sz;
+        assert(debug_invariant());
       }
 
       inline size_t free_space() const
@@ -204,10 +321,10 @@ namespace verona::rt
     private:
       bool debug_invariant() const
       {
-        bool objects_ptrs = objects_begin <= objects_end;
+        bool objects_ptrs = objects_begin() <= objects_end;
         bool non_trivial_ptrs = non_trivial_begin <= non_trivial_end;
         bool no_overlap = (non_trivial_begin - objects_end) >= 0;
-        auto alignment1 = Object::debug_is_aligned(objects_begin);
+        auto alignment1 = Object::debug_is_aligned(objects_begin());
         auto alignment2 = Object::debug_is_aligned(objects_end);
         auto alignment3 = Object::debug_is_aligned(non_trivial_begin);
         auto alignment4 = Object::debug_is_aligned(non_trivial_end);
@@ -215,7 +332,7 @@ namespace verona::rt
           alignment2 && alignment3 && alignment4;
       }
     };
-    static_assert(sizeof(Arena) == 1024 * 1024 * sizeof(std::byte));
+    static_assert(sizeof(Arena) == 4 * sizeof(uintptr_t));
 
     /**
      * Pointer to the linked list of arenas where objects are allocated in.
@@ -237,15 +354,69 @@ namespace verona::rt
      **/
     Object* last_large;
 
-    RegionArena()
-    : RegionBase(),
+    /**
+     * Space for objects in the arenas allocated from now on, see
+     * `set_arena_size`.
+     **/
+    size_t arena_capacity;
+
+    /**
+     * Where the arenas of the region come from.
+     **/
+    const ArenaSource* source;
+
+    /**
+     * NUMA node the arenas of the region are placed on, or `NO_NUMA_NODE`,
+     * see `set_numa_node`.
+     **/
+    size_t numa_node = NO_NUMA_NODE;
+
+    /**
+     * Empty arenas kept for reuse by `reset_internal`, linked through
+     * `Arena::next`.  There are at most `MAX_SPARE_ARENAS` of them.
+     **/
+    Arena* spare_arenas;
+    size_t spare_count;
+
+    /**
+     * A buffer owned by the region, see `adopt`.  Each is a trivial object in
+     * the region, so is freed with its arena, and the buffers are given back
+     * to their pools by walking this list, not by a finaliser.
+     **/
+    struct Adopted
+    {
+      Adopted* next;
+      void* buf;
+      size_t size;
+      BufferPool* pool;
+    };
+
+    /// Buffers adopted by the region, most recent first.
+    Adopted* adopted;
+    Adopted* last_adopted;
+
+    RegionArena(size_t arena_size, const ArenaSource* arena_source)
+    : RegionBase(RememberedSet::Kind::Logged),
       first_arena(nullptr),
       last_arena(nullptr),
-      last_large(nullptr)
+      last_large(nullptr),
+      arena_capacity(capacity_for(arena_size)),
+      source(arena_source),
+      spare_arenas(nullptr),
+      spare_count(0),
+      adopted(nullptr),
+      last_adopted(nullptr)
     {
       init_next(this);
     }
 
+    static size_t capacity_for(size_t arena_size)
+    {
+      arena_size = std::max(arena_size, MIN_ARENA_SIZE);
+      return snmalloc::bits::align_down(
+        arena_size - sizeof(Arena), Object::ALIGNMENT);
+    }
+
     static const Descriptor* desc()
     {
       static constexpr Descriptor desc = {
@@ -254,7 +425,49 @@ namespace verona::rt
       return &desc;
     }
 
+    static const Descriptor* adopted_desc()
+    {
+      static constexpr Descriptor desc = {
+        vsizeof<Adopted>, [](const Object*, ObjectStack&) {}, nullptr};
+
+      return &desc;
+    }
+
   public:
+    /// The smallest arena size that `set_arena_size` accepts.
+    static constexpr size_t MIN_ARENA_SIZE = 1024;
+
+    /// The most arenas that `reset_internal` keeps on a region for reuse.
+    static constexpr size_t MAX_SPARE_ARENAS = 4;
+
+    /// Arenas left wherever their source puts them, see `set_numa_node`.
+    static constexpr size_t NO_NUMA_NODE = SIZE_MAX;
+
+    /// Arenas from the heap.  This is the default.
+    static constexpr ArenaSource heap_source = {
+      [](size_t size) { return heap::alloc(size); },
+      [](void* p, size_t size) { heap::dealloc(p, size); }};
+
+    /**
+     * Arenas in 2 MiB or 1 GiB huge pages on the NUMA node of the core that
+     * allocates them, see `hugepage::alloc`.  These suit big, long lived
+     * regions that stay with one core, where they save TLB misses when
+     * iterating over and releasing the region.  Arenas are rounded up to a
+     * whole number of pages, so the arena size should be a multiple of the
+     * page size, see `set_arena_size`.
+     **/
+    static constexpr ArenaSource huge_page_source = {
+      [](size_t size) { return hugepage::alloc(size, hugepage::SIZE_2MIB); },
+      [](void* p, size_t size) {
+        hugepage::dealloc(p, size, hugepage::SIZE_2MIB);
+      }};
+
+    static constexpr ArenaSource gigantic_page_source = {
+      [](size_t size) { return hugepage::alloc(size, hugepage::SIZE_1GIB); },
+      [](void* p, size_t size) {
+        hugepage::dealloc(p, size, hugepage::SIZE_1GIB);
+      }};
+
     inline static RegionArena* get(Object* o)
     {
       assert(o->debug_is_iso());
@@ -272,16 +485,22 @@ namespace verona::rt
      * object is initialised as the Iso object for that region, and points to a
      * newly created Region metadata object. Returns a pointer to `o`.
      *
+     * The arenas of the region are `arena_size` bytes, see `set_arena_size`,
+     * and come from `source`.
+     *
      * The default template parameter `size = 0` is to avoid writing two
      * definitions which differ only in one line. This overload works because
      * every object must contain a descriptor, so 0 is not a valid size.
      **/
     template<size_t size = 0>
-    static Object* create(const Descriptor* desc)
+    static Object* create(
+      const Descriptor* desc,
+      size_t arena_size = Arena::DEFAULT_SIZE,
+      const ArenaSource* source = &heap_source)
     {
       void* p = Object::register_object(
         heap::alloc<vsizeof<RegionArena>>(), RegionArena::desc());
-      RegionArena* reg = new (p) RegionArena();
+      RegionArena* reg = new (p) RegionArena(arena_size, source);
 
       // o might be allocated in the arena or the large object ring.
       Object* o = reg->alloc_internal<size>(desc);
@@ -315,6 +534,65 @@ namespace verona::rt
       return o;
     }
 
+    /**
+     * Make the region represented by the Iso object `in` the owner of the
+     * `size` bytes at `buf`, which were allocated elsewhere, such as an I/O
+     * buffer that data has been received into.  The memory is not copied,
+     * and can be used for as long as the region is, but is not an object of
+     * the region, so must not hold references to its objects.  When the
+     * region is reset or released, `buf` is given back to `pool`.  It counts
+     * towards the memory used by the region.  Returns `buf`.
+     **/
+    static void* adopt(Object* in, void* buf, size_t size, BufferPool* pool)
+    {
+      RegionArena* reg = get(in);
+      auto a = new (reg->alloc_internal<vsizeof<Adopted>>(adopted_desc()))
+        Adopted{reg->adopted, buf, size, pool};
+      if (reg->adopted == nullptr)
+        reg->last_adopted = a;
+      reg->adopted = a;
+      reg->use_memory(size);
+      return buf;
+    }
+
+    /**
+     * Set the size of the arenas allocated from now on in the region
+     * represented by the Iso object `o`, including the arena header.  Small
+     * arenas suit small, short lived regions.  Large arenas make for fewer
+     * allocations in big regions, and snmalloc aligns large allocations to
+     * their size, so arenas of 2 MiB or more can be backed by transparent
+     * huge pages.  For big, long lived regions, see also `huge_page_source`.
+     *
+     * Objects that do not fit into an arena of this size, but are no larger
+     * than `Arena::SIZE`, get an arena of their own.  Larger objects are put
+     * in the large object ring.
+     **/
+    static void set_arena_size(Object* o, size_t arena_size)
+    {
+      get(o)->arena_capacity = capacity_for(arena_size);
+    }
+
+    /**
+     * Place the arenas of the region represented by the Iso object `o` on
+     * NUMA node `node`, such as the `Core::numa_node` of the home core of
+     * the cown that owns the region, see `numa::bind`.  The arenas the
+     * region has are moved there, and those it allocates from now on are
+     * placed there.  Objects in the large object ring are not moved.
+     * `NO_NUMA_NODE` leaves new arenas wherever their source puts them.
+     **/
+    static void set_numa_node(Object* o, size_t node)
+    {
+      RegionArena* reg = get(o);
+      reg->numa_node = node;
+      if (node == NO_NUMA_NODE)
+        return;
+
+      for (Arena* a = reg->first_arena; a != nullptr; a = a->next)
+        reg->place(a);
+      for (Arena* a = reg->spare_arenas; a != nullptr; a = a->next)
+        reg->place(a);
+    }
+
     /**
      * Insert the Object `o` into the RememberedSet of `into`'s region.
      *
@@ -339,7 +617,8 @@ namespace verona::rt
 
     /**
      * Merges `o`'s region into `into`'s region. Both regions must be separate
-     * and be the same kind of region, e.g. two trace regions.
+     * and be the same kind of region, e.g. two trace regions.  Arena regions
+     * must also have the same `ArenaSource`.
      *
      * TODO(region): how to handle merging different types of regions?
      **/
@@ -412,18 +691,32 @@ namespace verona::rt
      * and the object is added to the large object ring.
      *
      * Otherwise, we check if the last arena has space. If so, the object is
-     * allocated there. If not, we allocate a new arena.
+     * allocated there. If not, we allocate a new arena.  The first check is
+     * inlined, so for a static `size` allocating in the last arena is a
+     * compare and a pointer bump.
      *
      * TODO(region): For now, we guarantee constant-time allocation and accept
      * that we will have fragmentation. Later, we could try other strategies,
      * e.g. first fit or best fit.
      **/
     template<size_t size = 0>
-    Object* alloc_internal(const Descriptor* desc)
+    ALWAYSINLINE Object* alloc_internal(const Descriptor* desc)
     {
       assert((size == 0) || (desc->size == size));
 
       auto sz = size == 0 ? desc->size : size;
+      use_memory(sz);
+      if (SNMALLOC_LIKELY(
+            (sz <= Arena::SIZE) && (last_arena != nullptr) &&
+            (last_arena->free_space() >= sz)))
+        return last_arena->alloc_obj(desc, sz);
+
+      return alloc_slow<size>(desc, sz);
+    }
+
+    template<size_t size>
+    SNMALLOC_SLOW_PATH Object* alloc_slow(const Descriptor* desc, size_t sz)
+    {
       if (sz > Arena::SIZE)
       {
         // Allocate object.
@@ -441,25 +734,34 @@ namespace verona::rt
         return o;
       }
 
-      // If we don't have an arena, or the arena does not have enough space,
-      // allocate a new arena.
-      if (last_arena == nullptr || last_arena->free_space() < sz)
+      // We don't have an arena, or the arena does not have enough space, so
+      // reuse or allocate a new arena.  It is made bigger if the object would
+      // not fit.
+      size_t capacity = std::max(
+        arena_capacity, snmalloc::bits::align_up(sz, Object::ALIGNMENT));
+      Arena* a = spare_arenas;
+      if ((a != nullptr) && (a->capacity() >= capacity))
       {
-        void* p = heap::alloc<sizeof(Arena)>();
-        Arena* a = new (p) Arena();
+        spare_arenas = a->next;
+        spare_count--;
+        a->next = nullptr;
+      }
+      else
+      {
+        a = make_arena(capacity);
+      }
 
-        if (last_arena == nullptr)
-        {
-          first_arena = a;
-          last_arena = a;
-        }
-        else
-        {
-          last_arena->next = a;
-          last_arena = a;
-        }
-        assert(last_arena->next == nullptr);
+      if (last_arena == nullptr)
+      {
+        first_arena = a;
+        last_arena = a;
       }
+      else
+      {
+        last_arena->next = a;
+        last_arena = a;
+      }
+      assert(last_arena->next == nullptr);
 
       // Allocate object within that arena.
       return last_arena->alloc_obj(desc, sz);
@@ -467,6 +769,10 @@ namespace verona::rt
 
     void merge_internal(RegionArena* other)
     {
+      assert(source == other->source);
+      other->dealloc_spare_arenas();
+      current_memory_used += other->current_memory_used;
+
       // Merge arena linked lists.
       if (last_arena == nullptr)
       {
@@ -484,6 +790,15 @@ namespace verona::rt
         }
       }
 
+      // Merge adopted buffers.
+      if (other->adopted != nullptr)
+      {
+        other->last_adopted->next = adopted;
+        if (adopted == nullptr)
+          last_adopted = other->last_adopted;
+        adopted = other->adopted;
+      }
+
       // Merge large object ring.
       Object* head = other->get_next();
       if (head != other)
@@ -494,6 +809,20 @@ namespace verona::rt
         last_large != nullptr ? last_large->get_next_any_mark() == this : true);
     }
 
+    /// Allocate an arena from the region's source, on its NUMA node if set.
+    Arena* make_arena(size_t capacity)
+    {
+      Arena* a = Arena::make(capacity, source);
+      if (numa_node != NO_NUMA_NODE)
+        place(a);
+      return a;
+    }
+
+    void place(Arena* a)
+    {
+      numa::bind(a, sizeof(Arena) + a->capacity(), numa_node);
+    }
+
     void swap_root_internal(Object* oroot, Object* nroot)
     {
       assert(debug_is_in_region(nroot));
@@ -538,6 +867,145 @@ namespace verona::rt
         last_large != nullptr ? last_large->get_next_any_mark() == this : true);
     }
 
+    /**
+     * Copy the region represented by the Iso object `o` into a new region,
+     * and return the copy of `o`, or nullptr if the region cannot be copied,
+     * see `Region::clone`.
+     *
+     * Every object is copied, reachable or not, as the region is never
+     * collected.  The objects must all be clonable, so they are all in the
+     * trivial part of their arena, and each arena is copied with a single
+     * `memcpy`.  The pointers into the arenas are then moved by the distance
+     * between the arena and its copy, found by a binary search of the arenas
+     * by address, and the pointers to objects of the large object ring are
+     * looked up in a map from each to its copy.
+     **/
+    Object* clone_internal(Object* o)
+    {
+      assert(o->debug_is_iso());
+
+      // Adopted buffers are not objects, so cannot be copied.
+      if (adopted != nullptr)
+        return nullptr;
+
+      for (auto p : *this)
+      {
+        auto desc = p->get_descriptor();
+        if (!is_clonable(desc))
+          return nullptr;
+        for (size_t i = 0; i < desc->field_count; i++)
+        {
+          if (clone_target(field(p, desc, i)) == CloneTarget::Invalid)
+            return nullptr;
+        }
+      }
+
+      void* mem = Object::register_object(
+        heap::alloc<vsizeof<RegionArena>>(), RegionArena::desc());
+      RegionArena* reg = new (mem) RegionArena(MIN_ARENA_SIZE, source);
+      reg->arena_capacity = arena_capacity;
+      reg->numa_node = numa_node;
+      reg->use_memory(current_memory_used);
+
+      // Where the objects of each arena were, and how far they have moved.
+      struct Moved
+      {
+        std::byte* begin;
+        std::byte* end;
+        std::ptrdiff_t offset;
+      };
+      std::vector<Moved> moved;
+
+      for (Arena* a = first_arena; a != nullptr; a = a->next)
+      {
+        assert(a->non_trivial_begin == a->non_trivial_end);
+        Arena* b = reg->make_arena(a->capacity());
+        size_t used = (size_t)(a->objects_end - a->objects_begin());
+        memcpy(b->objects_begin(), a->objects_begin(), used);
+        b->objects_end += used;
+
+        if (reg->last_arena == nullptr)
+          reg->first_arena = b;
+        else
+          reg->last_arena->next = b;
+        reg->last_arena = b;
+
+        moved.push_back(
+          {a->objects_begin(),
+           a->objects_end,
+           b->objects_begin() - a->objects_begin()});
+      }
+      std::sort(moved.begin(), moved.end(), [](auto& x, auto& y) {
+        return x.begin < y.begin;
+      });
+
+      // Copy the large object ring in order, as the iso object must stay
+      // last if it is there.
+      ObjectMap<std::pair<Object*, Object*>> large;
+      Object* prev = reg;
+      for (Object* p = get_next(); p != this; p = p->get_next_any_mark())
+      {
+        Object* q = Object::object_start(heap::alloc(p->size()));
+        memcpy(q->real_start(), p->real_start(), p->size());
+        large.insert(std::make_pair(p, q));
+        prev->init_next(q);
+        prev = q;
+      }
+      prev->init_next(reg);
+      reg->last_large = (prev == reg) ? nullptr : prev;
+
+      auto copy_of = [&](Object* p) {
+        auto it = std::upper_bound(
+          moved.begin(), moved.end(), (std::byte*)p, [](auto b, auto& m) {
+            return b < m.begin;
+          });
+        if ((it != moved.begin()) && ((std::byte*)p < (--it)->end))
+          return (Object*)((std::byte*)p + it->offset);
+        return large.find(p).value();
+      };
+
+      // The iterator needs the iso object to point to the new region.
+      Object* root = copy_of(o);
+      root->init_iso();
+      root->set_region(reg);
+
+      for (auto p : *reg)
+      {
+        auto desc = p->get_descriptor();
+        p->clear_has_ext_ref();
+#ifdef USE_SYSTEMATIC_TESTING
+        p->get_header().sys_id =
+          Object::id_source.fetch_add(1, std::memory_order_relaxed);
+#endif
+        for (size_t i = 0; i < desc->field_count; i++)
+        {
+          auto& f = field(p, desc, i);
+          switch (clone_target(f))
+          {
+            case CloneTarget::Internal:
+              f = copy_of(f);
+              break;
+
+            case CloneTarget::External:
+            {
+              // Inserting transfers the count, so that an object held
+              // already is not counted twice.
+              Object::RegionMD c;
+              Object* t = f->root_and_class(c);
+              t->incref();
+              insert<YesTransfer>(root, t);
+              break;
+            }
+
+            default:
+              break;
+          }
+        }
+      }
+
+      return root;
+    }
+
     /**
      * Release and deallocate all objects within the region represented by the
      * Iso Object `o`.
@@ -550,7 +1018,7 @@ namespace verona::rt
       // Don't trace or finalise o, we'll do it when looping over the large
       // object ring or the arena list.
 
-      Logging::cout() << "Region release: arena region: " << o << Logging::endl;
+      VERONA_LOG << "Region release: arena region: " << o << Logging::endl;
 
       // Clean up all the non-trivial objects, by running the finaliser and
       // destructor, and collecting iso regions.
@@ -571,6 +1039,8 @@ namespace verona::rt
         (*it)->destructor();
       }
 
+      recycle_adopted();
+
       // Now we can deallocate large object ring.
       Object* p = get_next();
       while (p != this)
@@ -585,18 +1055,134 @@ namespace verona::rt
       while (arena != nullptr)
       {
         Arena* q = arena->next;
-        heap::dealloc<sizeof(Arena)>(arena);
+        arena->dealloc(source);
         arena = q;
       }
+      dealloc_spare_arenas();
 
-      // Sweep the RememberedSet, to ensure destructors are called.
-      RememberedSet::sweep();
+      // Release the RememberedSet, to ensure destructors are called.
+      RememberedSet::discard();
+      free_memory(current_memory_used);
 
       // Deallocate RegionArena
       // Don't need to deallocate `o`, since it was part of the arena or ring.
       dealloc();
     }
 
+    /**
+     * Empty the region represented by the Iso Object `o`, so that it holds
+     * only `o`, and can be reused without allocating a new region.  The other
+     * objects are finalised and destroyed as if the region was released, and
+     * their arenas are kept for reuse, up to `MAX_SPARE_ARENAS` of them.
+     *
+     * `o` itself is kept as it is, but the objects it refers to are gone, and
+     * the objects outside the region it refers to are released, so all its
+     * fields must be reset before it is used again.  `o` must be where
+     * `create` put it, so a region whose root has been swapped cannot be
+     * reset.
+     *
+     * Note: this does not release subregions. Use Region::reset instead.
+     **/
+    void reset_internal(Object* o, ObjectStack& collect)
+    {
+      assert(o->debug_is_iso());
+      size_t o_size = snmalloc::bits::align_up(o->size(), Object::ALIGNMENT);
+      bool in_arena = o_size <= Arena::SIZE;
+      if (in_arena ? !first_arena->is_first(o, o_size) : (o != last_large))
+        abort();
+
+      VERONA_LOG << "Region reset: arena region: " << o << Logging::endl;
+
+      // As in `release_internal`, all finalisers run before any destructor.
+      for (auto it = begin<NonTrivial>(); it != end<NonTrivial>(); ++it)
+      {
+        if (*it != o)
+          (*it)->finalise(o, collect);
+      }
+
+      ExternalReferenceTable::erase_all_except(o);
+
+      for (auto it = begin<NonTrivial>(); it != end<NonTrivial>(); ++it)
+      {
+        if (*it != o)
+          (*it)->destructor();
+      }
+
+      recycle_adopted();
+
+      // Deallocate the large object ring, except `o`.
+      Object* p = get_next();
+      while (p != this)
+      {
+        Object* q = p->get_next_any_mark();
+        if (p != o)
+          p->dealloc();
+        p = q;
+      }
+
+      // Keep `o` in the first arena, and the other arenas for reuse.
+      Arena* arena = first_arena;
+      if (in_arena)
+      {
+        init_next(this);
+        last_large = nullptr;
+
+        arena = first_arena->next;
+        first_arena->rewind_to(o, o_size);
+        last_arena = first_arena;
+      }
+      else
+      {
+        set_next(o);
+        last_large = o;
+        first_arena = nullptr;
+        last_arena = nullptr;
+      }
+
+      while (arena != nullptr)
+      {
+        Arena* q = arena->next;
+        if (spare_count < MAX_SPARE_ARENAS)
+        {
+          arena->rewind();
+          arena->next = spare_arenas;
+          spare_arenas = arena;
+          spare_count++;
+        }
+        else
+        {
+          arena->dealloc(source);
+        }
+        arena = q;
+      }
+
+      RememberedSet::discard();
+      free_memory(current_memory_used - o->size());
+    }
+
+    /**
+     * Give the adopted buffers back to their pools.  Their records are freed
+     * with the arenas.
+     **/
+    void recycle_adopted()
+    {
+      for (auto a = adopted; a != nullptr; a = a->next)
+        a->pool->recycle(a->pool, a->buf, a->size);
+      adopted = nullptr;
+      last_adopted = nullptr;
+    }
+
+    void dealloc_spare_arenas()
+    {
+      while (spare_arenas != nullptr)
+      {
+        Arena* q = spare_arenas->next;
+        spare_arenas->dealloc(source);
+        spare_arenas = q;
+      }
+      spare_count = 0;
+    }
+
   public:
     template<IteratorType type = AllObjects>
     class iterator
@@ -667,7 +1253,7 @@ namespace verona::rt
         std::byte* q = ptr->real_start() + sz;
         if constexpr (type == Trivial)
         {
-          assert(q > arena->objects_begin && q <= arena->objects_end);
+          assert(q > arena->objects_begin() && q <= arena->objects_end);
 
           // We have not yet reached the end, so q is valid.
           if (q != arena->objects_end)
@@ -684,7 +1270,7 @@ namespace verona::rt
         else if constexpr (type == AllObjects)
         {
           assert(
-            (q > arena->objects_begin && q <= arena->objects_end) ||
+            (q > arena->objects_begin() && q <= arena->objects_end) ||
             (q > arena->non_trivial_begin && q <= arena->non_trivial_end));
 
           // We have not yet reached either end, so q is valid.
@@ -735,15 +1321,15 @@ namespace verona::rt
         while (arena != nullptr)
         {
           assert(
-            arena->objects_begin < arena->objects_end ||
+            arena->objects_begin() < arena->objects_end ||
             arena->non_trivial_begin < arena->non_trivial_end);
           assert(arena->debug_invariant());
           if constexpr (type == Trivial || type == AllObjects)
           {
-            if (arena->objects_begin != arena->objects_end)
+            if (arena->objects_begin() != arena->objects_end)
               // objects_begin points to header of first object.
               // we return the actually Object*.
-              return Object::object_start(arena->objects_begin);
+              return Object::object_start(arena->objects_begin());
           }
           if constexpr (type == NonTrivial || type == AllObjects)
           {
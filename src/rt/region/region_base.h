@@ -26,6 +26,23 @@ namespace verona::rt
     Rc,
   };
 
+  /**
+   * Bytes of region objects allocated and freed by the current thread, since
+   * the scheduler last took them for its statistics.  Only kept when the
+   * scheduler statistics are.
+   **/
+  struct RegionMemoryStats
+  {
+    size_t allocated = 0;
+    size_t freed = 0;
+
+    static RegionMemoryStats& local()
+    {
+      static thread_local RegionMemoryStats stats;
+      return stats;
+    }
+  };
+
   class RegionBase : public Object,
                      public ExternalReferenceTable,
                      public RememberedSet
@@ -43,9 +60,147 @@ namespace verona::rt
       AllObjects,
     };
 
-    RegionBase() : Object() {}
+    /**
+     * Called when a region grows past its hard quota, with the region, the
+     * bytes it uses, and the quota.  If it returns, the allocation goes ahead.
+     **/
+    using QuotaHandler = void (*)(RegionBase* region, size_t used, size_t quota);
+
+    RegionBase(RememberedSet::Kind kind = RememberedSet::Kind::Hashed)
+    : Object(), RememberedSet(kind)
+    {}
+
+    /// Bytes of objects in the region.
+    size_t get_memory_used() const
+    {
+      return current_memory_used;
+    }
+
+    /**
+     * Limit the bytes of objects in the region.  Past `soft`, the region is
+     * collected when it is next closed, as if it had outgrown its collection
+     * threshold.  Past `hard`, the allocation that crossed it calls the
+     * handler set by `set_quota_handler`, which by default aborts.
+     **/
+    void set_memory_quota(size_t soft, size_t hard)
+    {
+      assert(soft <= hard);
+      soft_quota = soft;
+      hard_quota = hard;
+    }
+
+    /// Whether the region uses more than its soft quota.
+    bool over_soft_quota() const
+    {
+      return current_memory_used > soft_quota;
+    }
+
+    /// Set the handler for regions that grow past their hard quota, or
+    /// restore the default with `nullptr`.
+    static void set_quota_handler(QuotaHandler handler)
+    {
+      quota_handler.store(handler, std::memory_order_relaxed);
+    }
+
+    /**
+     * Whether objects of type `desc` can be copied by `Region::clone`.  Their
+     * pointers must all be listed with `Fields` (or they have `no_pointers`),
+     * so that they can be redirected to the copies, and they must have no
+     * finaliser or destructor, so that a bytewise copy owns nothing that the
+     * original does.
+     **/
+    static bool is_clonable(const Descriptor* desc)
+    {
+      return (desc->fields != nullptr) && desc->has(Descriptor::IS_TRIVIAL);
+    }
+
+    /// The `i`th pointer field of `o`, whose type is `desc`.
+    static Object*& field(Object* o, const Descriptor* desc, size_t i)
+    {
+      return *(Object**)((uintptr_t)o + desc->fields[i]);
+    }
+
+    /// What a copy of a region does with a pointer, see `clone_target`.
+    enum class CloneTarget
+    {
+      Null,
+      /// An object of the region, so the copy points to its copy.
+      Internal,
+      /// An immutable object or cown, so the copy takes a reference to it.
+      External,
+      /// Anything else, such as a subregion, so the region cannot be copied.
+      Invalid,
+    };
+
+    /// What a copy of this region does with the pointer `p` from one of its
+    /// objects.
+    CloneTarget clone_target(Object* p)
+    {
+      if (p == nullptr)
+        return CloneTarget::Null;
+
+      switch (p->get_class())
+      {
+        case Object::UNMARKED:
+          return CloneTarget::Internal;
+
+        case Object::ISO:
+          return (p->get_region() == this) ? CloneTarget::Internal :
+                                             CloneTarget::Invalid;
+
+        case Object::SCC_PTR:
+        case Object::RC:
+        case Object::SHARED:
+          return CloneTarget::External;
+
+        default:
+          return CloneTarget::Invalid;
+      }
+    }
+
+  protected:
+    /// Bytes of objects in the region, see `use_memory`.
+    size_t current_memory_used = 0;
+
+    void use_memory(size_t size)
+    {
+      current_memory_used += size;
+#ifdef USE_SCHED_STATS
+      RegionMemoryStats::local().allocated += size;
+#endif
+      if (SNMALLOC_UNLIKELY(current_memory_used > hard_quota))
+        exceeded_hard_quota();
+    }
+
+    void free_memory(size_t size)
+    {
+      assert(current_memory_used >= size);
+      current_memory_used -= size;
+#ifdef USE_SCHED_STATS
+      RegionMemoryStats::local().freed += size;
+#endif
+    }
 
   private:
+    size_t soft_quota = SIZE_MAX;
+    size_t hard_quota = SIZE_MAX;
+
+    static inline std::atomic<QuotaHandler> quota_handler{nullptr};
+
+    SNMALLOC_SLOW_PATH void exceeded_hard_quota()
+    {
+      auto handler = quota_handler.load(std::memory_order_relaxed);
+      if (handler != nullptr)
+      {
+        handler(this, current_memory_used, hard_quota);
+        return;
+      }
+
+      VERONA_LOG << "Region " << this << " uses " << current_memory_used
+                 << " bytes, over its quota of " << hard_quota << Logging::endl;
+      abort();
+    }
+
     inline void dealloc()
     {
       ExternalReferenceTable::dealloc();
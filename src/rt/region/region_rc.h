@@ -26,6 +26,10 @@ namespace verona::rt
    * (`FINALIZER_MASK`) to quickly deduce whether an object is trivial or
    * non-trivial.
    *
+   * Candidate roots of cycles are buffered on the Lins stack, and coloured
+   * black while they are there, so each is buffered once.  The cycles are
+   * collected in batches, see `gc_cycles` and `set_cycle_threshold`.
+   *
    **/
   class RegionRc : public RegionBase
   {
@@ -33,6 +37,10 @@ namespace verona::rt
     friend class Region;
     friend class RegionTrace;
 
+  public:
+    /// Default for `set_cycle_threshold`.
+    static constexpr size_t CYCLE_THRESHOLD = 1 << 12;
+
   private:
     static constexpr uintptr_t FINALISER_MASK = 1 << 1;
 
@@ -42,8 +50,11 @@ namespace verona::rt
     // FIXME: Use two stacks to simulate per-block queue based behaviour.
     StackThin<Object> lins_stack;
 
-    // Memory usage in the region.
-    size_t current_memory_used = 0;
+    /// Number of objects on `lins_stack`.
+    size_t buffered = 0;
+
+    /// See `set_cycle_threshold`.
+    static inline std::atomic<size_t> cycle_threshold{CYCLE_THRESHOLD};
 
     size_t region_size = 0;
 
@@ -178,6 +189,7 @@ namespace verona::rt
       {
         o->set_rc_colour(RcColour::BLACK);
         reg->lins_stack.push(o);
+        reg->buffered++;
       }
       return false;
     }
@@ -205,8 +217,9 @@ namespace verona::rt
      * conversely, an object is removed from the Lins stack when it is increfed.
      *
      * The Lins algorithm is a three-phase sweep over the subgraph of an object
-     * with potential cyclic reachability. For each object o in the Lins stack,
-     * it does the following:
+     * with potential cyclic reachability. As suggested by Bacon and Rajan,
+     * each phase is run over the whole Lins stack before the next, so a
+     * subgraph shared by several candidates is only traced once per phase:
      *
      *  1. o's subgraph is traced and each object is marked red and decrefed.
      *  Marking an object red indicates that it is potentially garbage. Objects
@@ -225,17 +238,56 @@ namespace verona::rt
     {
       assert(o->get_class() == RegionMD::OPEN_ISO);
       UNUSED(o);
+      ObjectStack roots;
+      reg->take_candidates(roots);
+
       ObjectStack jump_stack;
-      while (!reg->lins_stack.empty())
+      ObjectStack traced;
+      while (!roots.empty())
       {
-        auto p = reg->lins_stack.pop();
+        auto p = roots.pop();
 
+        // A candidate reached from an earlier one is already red.
         if (p->get_rc_colour() == RcColour::BLACK)
         {
           mark_red(p, reg, jump_stack);
-          scan(p, reg, jump_stack);
+          traced.push(p);
         }
       }
+
+      ObjectStack reds;
+      scan(traced, reds, reg, jump_stack);
+      dealloc_reds(reds, reg);
+    }
+
+    /**
+     * Collect cycles automatically when an rc region is closed, see
+     * `api::close_region`, once `n` candidates are buffered.  0 turns this
+     * off.  The default is `CYCLE_THRESHOLD`.
+     **/
+    static void set_cycle_threshold(size_t n)
+    {
+      cycle_threshold.store(n, std::memory_order_relaxed);
+    }
+
+    /// Whether enough candidates are buffered to collect the cycles in
+    /// `reg`, see `set_cycle_threshold`, or any are and `reg` is over its soft
+    /// quota, see `RegionBase::set_memory_quota`.
+    static bool needs_gc_cycles(RegionRc* reg)
+    {
+      size_t n = cycle_threshold.load(std::memory_order_relaxed);
+      if ((n != 0) && (reg->buffered >= n))
+        return true;
+
+      // A region over its soft quota may be holding on to garbage cycles.
+      return (reg->buffered != 0) && reg->over_soft_quota();
+    }
+
+    /// As `gc_cycles`, if `needs_gc_cycles` says so.
+    static void auto_gc_cycles(Object* o, RegionRc* reg)
+    {
+      if (needs_gc_cycles(reg))
+        gc_cycles(o, reg);
     }
 
     /**
@@ -253,6 +305,11 @@ namespace verona::rt
         abort();
       }
 
+      // Taken first, as counts reaching zero below make the candidates that
+      // died while buffered look like those freed by this release.
+      ObjectStack roots;
+      take_candidates(roots);
+
       ObjectStack dfs;
       o->trace(dfs);
       LinkedObjectStack gc;
@@ -301,7 +358,7 @@ namespace verona::rt
       }
 
       // Clean up any cyclic garbage not reachable from the entry point.
-      release_cycles(o, gc, collect);
+      release_cycles(o, roots, gc, collect);
 
       while (!gc.empty())
       {
@@ -314,16 +371,48 @@ namespace verona::rt
       close(o);
       o->destructor();
       o->dealloc();
+      free_memory(current_memory_used);
       dealloc();
     }
 
   private:
-    void release_cycles(Object* o, LinkedObjectStack& gc, ObjectStack& collect)
+    /**
+     * Move the candidates from the Lins stack to `roots`.  Those whose count
+     * reached zero while they were buffered have already been finalised and
+     * traced by `dealloc_object`, and are deallocated here.
+     **/
+    void take_candidates(ObjectStack& roots)
     {
-      ObjectStack dfs;
       while (!lins_stack.empty())
       {
-        dfs.push(lins_stack.pop());
+        auto p = lins_stack.pop();
+        if (
+          (p->get_class() == RegionMD::UNMARKED) && (get_ref_count(p) == 0))
+        {
+          region_size -= 1;
+          free_memory(p->size());
+          p->destructor();
+          p->dealloc();
+          continue;
+        }
+        roots.push(p);
+      }
+      buffered = 0;
+    }
+
+    void release_cycles(
+      Object* o,
+      ObjectStack& roots,
+      LinkedObjectStack& gc,
+      ObjectStack& collect)
+    {
+      ObjectStack dfs;
+      while (!roots.empty())
+      {
+        // Those that reached zero have been freed by `release_internal`.
+        auto p = roots.pop();
+        if (get_ref_count(p) != 0)
+          dfs.push(p);
       }
       while (!dfs.empty())
       {
@@ -440,16 +529,33 @@ namespace verona::rt
       }
     }
 
-    static void scan(Object* o, RegionRc* reg, ObjectStack& jump_stack)
+    /// Restore the live objects reached from `roots`, and move the roots
+    /// that may be garbage to `reds`.
+    static void scan(
+      ObjectStack& roots,
+      ObjectStack& reds,
+      RegionRc* reg,
+      ObjectStack& jump_stack)
     {
       // If the RC is positive after all interior pointers in this subgraph
-      // have been decrefed, then |o| is rooted by *at least one* live
+      // have been decrefed, then a root is rooted by *at least one* live
       // reference. Hence, it must be made green and have its interior
-      // refcounts restored.
-      if (o->is_rc_candidate() && get_ref_count(o) > 0)
+      // refcounts restored.  It may already be green, if it was reached from
+      // another root.
+      while (!roots.empty())
       {
-        restore_green(o, reg);
-        return;
+        Object* o = roots.pop();
+        if (o->get_rc_colour() == RcColour::BLACK)
+        {
+          // Not an rc candidate, so it was not traced.
+          o->set_rc_colour(RcColour::GREEN);
+          continue;
+        }
+
+        if (o->get_rc_colour() == RcColour::RED && get_ref_count(o) > 0)
+          restore_green(o, reg);
+        else
+          reds.push(o);
       }
 
       while (!jump_stack.empty())
@@ -460,8 +566,6 @@ namespace verona::rt
           restore_green(p, reg);
         }
       }
-
-      dealloc_reds(o, reg);
     }
 
     /**
@@ -498,24 +602,27 @@ namespace verona::rt
     }
 
     /**
-     * Deallocate o if it is red. This is recursive over o's fields
+     * Deallocate the roots that are red. This is recursive over their fields
      * where the field is also red and an rc candidate.
      *
      * This is the final phase of the cylic reference count scan. This must only
      * be called after all potential live objects which were eagerly marked red
-     * are restored to green via the jump stack.
+     * are restored to green via the jump stack.  The objects are only
+     * deallocated once all the roots have been traced, as one root may reach
+     * the garbage of another.
      **/
-    static void dealloc_reds(Object* o, RegionRc* reg)
+    static void dealloc_reds(ObjectStack& roots, RegionRc* reg)
     {
-      if (o->get_rc_colour() != RcColour::RED)
-      {
-        return;
-      }
-
       ObjectStack dfs;
       LinkedObjectStack gc;
       ObjectStack sub_regions;
-      o->trace(dfs);
+      while (!roots.empty())
+      {
+        Object* o = roots.pop();
+        if (o->get_rc_colour() == RcColour::RED)
+          dfs.push(o);
+      }
+
       while (!dfs.empty())
       {
         Object* f = dfs.pop();
@@ -565,6 +672,7 @@ namespace verona::rt
       {
         Object* o = gc.pop();
         reg->region_size -= 1;
+        reg->free_memory(o->size());
         o->destructor();
         o->dealloc();
       }
@@ -585,7 +693,10 @@ namespace verona::rt
       o->trace(dfs);
       LinkedObjectStack gc;
 
-      gc.push(o);
+      // A buffered object stays allocated until it is taken off the Lins
+      // stack, see `take_candidates`.
+      if (o->get_rc_colour() != RcColour::BLACK)
+        gc.push(o);
 
       while (!dfs.empty())
       {
@@ -607,7 +718,8 @@ namespace verona::rt
               p->trace(dfs);
               // The ISO tag has been removed from the entry point.
               p->finalise(nullptr, sub_regions);
-              gc.push(p);
+              if (p->get_rc_colour() != RcColour::BLACK)
+                gc.push(p);
             }
             break;
           case Object::SCC_PTR:
@@ -633,6 +745,7 @@ namespace verona::rt
       {
         Object* o = gc.pop();
         reg->region_size -= 1;
+        reg->free_memory(o->size());
         o->destructor();
         o->dealloc();
       }
@@ -646,8 +759,8 @@ namespace verona::rt
       {
         Object* o = sub_regions.pop();
         assert(o->debug_is_iso());
-        Logging::cout() << "Region RC: releasing unreachable subregion: " << o
-                        << Logging::endl;
+        VERONA_LOG << "Region RC: releasing unreachable subregion: " << o
+                   << Logging::endl;
 
         RegionBase* r = o->get_region();
         // Unfortunately, we can't use Region::release_internal because of a
@@ -662,12 +775,6 @@ namespace verona::rt
           abort();
       }
     }
-
-  private:
-    void use_memory(size_t size)
-    {
-      current_memory_used += size;
-    }
   };
 
 } // namespace verona::rt
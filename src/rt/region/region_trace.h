@@ -2,10 +2,17 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../debug/probes.h"
+#include "../debug/trace.h"
 #include "../object/object.h"
+#include "prefetch_queue.h"
 #include "region_arena.h"
 #include "region_base.h"
 
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
 namespace verona::rt
 {
   using namespace snmalloc;
@@ -50,6 +57,34 @@ namespace verona::rt
     friend class Freeze;
     friend class Region;
     friend class RegionRc;
+    friend class ParallelGC;
+
+  public:
+    /// Collections of one region, see `get_stats`.
+    struct GcStats
+    {
+      /// Full collections, including incremental and parallel ones.
+      size_t collections = 0;
+
+      /// Minor collections, see `gc_young`.
+      size_t minor_collections = 0;
+
+      /// Memory freed from the region, in bytes.
+      size_t bytes_freed = 0;
+
+      /// Time spent collecting, including releasing unreachable subregions.
+      std::chrono::nanoseconds time{0};
+
+      /// Compactions, see `compact`.
+      size_t compactions = 0;
+
+      /// Memory of the objects moved by compactions, in bytes.
+      size_t bytes_moved = 0;
+    };
+
+    /// Fewest bytes a region must use to be collected automatically, see
+    /// `set_gc_growth_factor`.
+    static constexpr size_t AUTO_GC_MIN = 1 << 16;
 
   private:
     enum RingKind
@@ -63,15 +98,96 @@ namespace verona::rt
     Object* next_not_root;
     Object* last_not_root;
 
-    // Memory usage in the region.
-    size_t current_memory_used = 0;
+    // Memory used after the last full collection.
+    size_t previous_memory_used = 0;
+
+    GcStats stats;
+
+    /// See `set_gc_growth_factor`.
+    static inline std::atomic<size_t> growth_factor{0};
 
-    // Compact representation of previous memory used as a sizeclass.
-    snmalloc::sizeclass_t previous_memory_used;
+    /// `stats.bytes_freed` when the region was last compacted, see
+    /// `fragmentation`.
+    size_t freed_at_compaction = 0;
+
+    /// See `set_compaction_threshold`.
+    static inline std::atomic<size_t> compaction_threshold{0};
+
+    /**
+     * Adds the time until it is destroyed, and the memory freed meanwhile,
+     * to the statistics of a region.
+     **/
+    class Measure
+    {
+      RegionTrace* reg;
+      size_t memory;
+      std::chrono::steady_clock::time_point start;
+
+    public:
+      Measure(RegionTrace* reg_)
+      : reg(reg_),
+        memory(reg_->current_memory_used),
+        start(std::chrono::steady_clock::now())
+      {
+        Trace::record(TraceKind::GCStart, reg);
+        VERONA_PROBE1(gc_start, reg);
+      }
+
+      ~Measure()
+      {
+        Trace::record(TraceKind::GCEnd, reg);
+        VERONA_PROBE1(gc_end, reg);
+        reg->stats.time += std::chrono::steady_clock::now() - start;
+        if (memory > reg->current_memory_used)
+          reg->stats.bytes_freed += memory - reg->current_memory_used;
+      }
+    };
 
     // Stack of stack based entry points into the region.
     StackThin<Object> additional_entry_points{};
 
+    enum class Phase
+    {
+      Marking,
+      SweepNonTrivial,
+      SweepTrivial,
+    };
+
+    /// State of an incremental collection that has started, see `gc_step`.
+    struct Incremental
+    {
+      Phase phase = Phase::Marking;
+
+      /// Objects found, but not yet classified, while marking.
+      ObjectStack grey;
+
+      /// Iso objects of unreachable subregions, released at the end.
+      ObjectStack unreachable;
+
+      /// Finalised objects in the non-trivial ring, waiting for destruction.
+      LinkedObjectStack finalised;
+
+      /// The last object kept by the sweep of the current ring, or the region
+      /// metadata object if the sweep of the ring has not kept one yet.
+      Object* sweep_prev = nullptr;
+    };
+
+    Incremental* incremental = nullptr;
+
+    /// Whether new objects go in the nursery, see `set_nursery`.
+    bool nursery = false;
+
+    /// The nursery: objects allocated since the last minor collection, in a
+    /// list for each kind of ring, indexed by `RingKind`.  The lists are
+    /// linked through `next` and end in nullptr.
+    Object* young[2] = {nullptr, nullptr};
+    Object* last_young[2] = {nullptr, nullptr};
+
+    /// Objects outside the nursery that a pointer into the nursery has been
+    /// stored in, see `write_barrier`.  These are roots for the next minor
+    /// collection.
+    StackThin<Object> old_to_young{};
+
     explicit RegionTrace()
     : RegionBase(), next_not_root(this), last_not_root(this)
     {}
@@ -154,8 +270,17 @@ namespace verona::rt
       auto o = (Object*)Object::register_object(p, desc);
       assert(Object::debug_is_aligned(o));
 
-      // Add to the ring.
-      reg->append(o);
+      // Add to the nursery or the ring.
+      if (reg->nursery && (reg->incremental == nullptr))
+      {
+        reg->append_young(o);
+      }
+      else
+      {
+        reg->append(o);
+        if (reg->incremental != nullptr)
+          reg->shade_new(o);
+      }
 
       // GC heuristics.
       reg->use_memory(desc->size);
@@ -177,6 +302,10 @@ namespace verona::rt
       Object::RegionMD c;
       o = o->root_and_class(c);
       reg->RememberedSet::insert<transfer>(o);
+
+      // An incremental collection may have marked the set already.
+      if (reg->incremental != nullptr)
+        reg->RememberedSet::mark(o);
     }
 
     /**
@@ -195,6 +324,8 @@ namespace verona::rt
       if (is_trace_region(other))
       {
         RegionTrace* other_trace = (RegionTrace*)other;
+        reg->settle(into);
+        other_trace->settle(o);
 
         // o is not allowed to have additional roots, as it is about
         // to be collapsed `into`.
@@ -224,10 +355,12 @@ namespace verona::rt
     {
       assert(prev != next);
       assert(prev->debug_is_iso());
-      assert(next->debug_is_mutable());
-      assert(prev->get_region() != next);
 
       RegionTrace* reg = get(prev);
+      reg->settle(prev);
+
+      assert(next->debug_is_mutable());
+      assert(prev->get_region() != next);
       reg->swap_root_internal(prev, next);
     }
 
@@ -238,46 +371,307 @@ namespace verona::rt
      **/
     static void gc(Object* o)
     {
-      Logging::cout() << "Region GC called for: " << o << Logging::endl;
+      VERONA_LOG << "Region GC called for: " << o << Logging::endl;
       assert(o->debug_is_iso());
       assert(is_trace_region(o->get_region()));
 
       RegionTrace* reg = get(o);
+      reg->settle(o);
+      Measure m(reg);
       ObjectStack f;
       ObjectStack collect;
 
       // Copy additional roots into f.
       reg->additional_entry_points.forall([&f](Object* o) {
-        Logging::cout() << "Additional root: " << o << Logging::endl;
+        VERONA_LOG << "Additional root: " << o << Logging::endl;
         f.push(o);
       });
 
       reg->mark(o, f);
       reg->sweep(o, collect);
+      reg->stats.collections++;
+      reg->release_unreachable(collect);
+    }
 
-      // `collect` contains all the iso objects to unreachable subregions.
-      // Since they are unreachable, we can just release them.
-      while (!collect.empty())
+    /**
+     * Collect every trace region automatically when it is closed, see
+     * `api::close_region`, once it uses more than `factor` times the memory
+     * it used after its last full collection, and at least `AUTO_GC_MIN`.
+     * A region with a nursery gets a minor collection first, and a full one
+     * only if that did not free enough.  0, the default, turns this off.
+     *
+     * When enabled, no pointers into a region may be held across closing it,
+     * other than from its iso object and additional roots.
+     **/
+    static void set_gc_growth_factor(size_t factor)
+    {
+      growth_factor.store(factor, std::memory_order_relaxed);
+    }
+
+    /// Whether the region of `o` has grown enough to be collected, see
+    /// `set_gc_growth_factor`, or past its soft quota, see
+    /// `RegionBase::set_memory_quota`.
+    static bool needs_gc(Object* o)
+    {
+      RegionTrace* reg = get(o);
+      if (reg->over_soft_quota())
+        return true;
+
+      size_t factor = growth_factor.load(std::memory_order_relaxed);
+      if (factor == 0)
+        return false;
+
+      size_t limit = std::max(AUTO_GC_MIN, reg->previous_memory_used * factor);
+      return reg->current_memory_used > limit;
+    }
+
+    /// Collect the region of `o` if `needs_gc` says so.
+    static void auto_gc(Object* o)
+    {
+      if (!needs_gc(o))
+        return;
+
+      RegionTrace* reg = get(o);
+      if (reg->nursery)
       {
-        o = collect.pop();
-        assert(o->debug_is_iso());
-        Logging::cout() << "Region GC: releasing unreachable subregion: " << o
-                        << Logging::endl;
+        gc_young(o);
+        if (!needs_gc(o))
+          return;
+      }
+      gc(o);
+
+      size_t threshold = compaction_threshold.load(std::memory_order_relaxed);
+      if (
+        (threshold != 0) && (reg->current_memory_used >= AUTO_GC_MIN) &&
+        (fragmentation(o) >= threshold))
+        compact(o);
+
+      VERONA_LOG << "Region auto GC: " << o << " collections "
+                 << reg->stats.collections << " minor "
+                 << reg->stats.minor_collections << " freed "
+                 << reg->stats.bytes_freed << " time "
+                 << reg->stats.time.count() << "ns" << Logging::endl;
+    }
 
-        // Note that we need to dispatch because `r` is a different region
-        // metadata object.
-        RegionBase* r = o->get_region();
-        assert(r != reg);
+    /// The statistics of the collections of the region of `o`.
+    static GcStats get_stats(Object* o)
+    {
+      return get(o)->stats;
+    }
 
-        // Unfortunately, we can't use Region::release_internal because of a
-        // circular dependency between header files.
-        if (RegionTrace::is_trace_region(r))
-          ((RegionTrace*)r)->release_internal(o, collect);
-        else if (RegionArena::is_arena_region(r))
-          ((RegionArena*)r)->release_internal(o, collect);
-        else
-          abort();
+    /**
+     * Estimate, as a percentage, how scattered the objects of the region of
+     * `o` are: the memory its collections have freed since it was last
+     * compacted, out of that and the memory it uses now.  Each object freed
+     * leaves a hole among the ones that survived, which the allocator may
+     * not fill with objects of this region.
+     **/
+    static size_t fragmentation(Object* o)
+    {
+      RegionTrace* reg = get(o);
+      size_t freed = reg->stats.bytes_freed - reg->freed_at_compaction;
+      size_t total = freed + reg->current_memory_used;
+      return (total == 0) ? 0 : ((freed * 100) / total);
+    }
+
+    /**
+     * Compact every trace region that `auto_gc` collects, once its
+     * `fragmentation` reaches `percent`, and it uses at least `AUTO_GC_MIN`.
+     * 0, the default, turns this off.
+     **/
+    static void set_compaction_threshold(size_t percent)
+    {
+      compaction_threshold.store(percent, std::memory_order_relaxed);
+    }
+
+    /**
+     * Collect the region represented by the Object `o`, and then move the
+     * objects that survive into fresh allocations, in depth first order from
+     * `o`, so that objects used together are close together, and the
+     * partly empty memory they leave can be returned.
+     *
+     * Only the pointers listed with `Fields` can be redirected, so an object
+     * stays where it is if it is `o`, an additional root, has an external
+     * reference, or is reachable from an object that lists no fields and so
+     * is traced with its `trace` function.  An object must also be clonable,
+     * see `RegionBase::is_clonable`, to be copied bytewise.
+     *
+     * No pointers into the region may be held across this, other than from
+     * `o` and the additional roots.
+     **/
+    static void compact(Object* o)
+    {
+      assert(o->debug_is_iso());
+      assert(is_trace_region(o->get_region()));
+
+      gc(o);
+
+      RegionTrace* reg = get(o);
+      Measure m(reg);
+      reg->evacuate(o);
+      reg->stats.compactions++;
+      reg->freed_at_compaction = reg->stats.bytes_freed;
+    }
+
+    /**
+     * Do up to about `budget` objects' worth of an incremental collection of
+     * the region represented by the Object `o`, and return true if this
+     * finished a collection.  The first call starts a collection, and later
+     * calls continue it, so a large region can be collected a slice at a time,
+     * for instance across successive behaviours on the cown that owns it.
+     *
+     * The state of the collection is kept in the region between calls.
+     * While it is marking, every store of a pointer into a field of an object
+     * in the region, other than the iso object, must be followed by a call
+     * to `write_barrier`.  Objects allocated during the collection survive
+     * it.  Merging, swapping the root, freezing, releasing and `gc` finish
+     * the collection first.
+     **/
+    static bool gc_step(Object* o, size_t budget)
+    {
+      assert(o->debug_is_iso());
+      assert(is_trace_region(o->get_region()));
+
+      RegionTrace* reg = get(o);
+      Measure m(reg);
+      auto inc = reg->incremental;
+      if (inc == nullptr)
+      {
+        VERONA_LOG << "Region incremental GC started for: " << o
+                   << Logging::endl;
+        // The collection works on the rings, and new objects go in the rings
+        // until it finishes.
+        reg->promote_young();
+        inc = new (heap::alloc(sizeof(Incremental))) Incremental;
+        reg->incremental = inc;
+        reg->shade_roots(o);
       }
+
+      if (inc->phase == Phase::Marking)
+      {
+        if (!reg->mark_step(budget))
+          return false;
+
+        // Stores into the iso object and changes to the additional roots are
+        // not behind the barrier, so trace from them again before sweeping.
+        // This must finish, whatever the budget.
+        size_t rest = SIZE_MAX;
+        reg->shade_roots(o);
+        reg->mark_step(rest);
+        inc->phase = Phase::SweepNonTrivial;
+        inc->sweep_prev = reg;
+      }
+
+      if (inc->phase == Phase::SweepNonTrivial)
+      {
+        if (!reg->sweep_step<NonTrivialRing>(o, budget))
+          return false;
+
+        while (!inc->finalised.empty())
+        {
+          Object* q = inc->finalised.pop();
+          q->destructor();
+          q->dealloc();
+        }
+        inc->phase = Phase::SweepTrivial;
+        inc->sweep_prev = reg;
+      }
+
+      if (!reg->sweep_step<TrivialRing>(o, budget))
+        return false;
+
+      reg->RememberedSet::sweep();
+      reg->previous_memory_used = reg->current_memory_used;
+      reg->stats.collections++;
+      reg->incremental = nullptr;
+
+      VERONA_LOG << "Region incremental GC finished for: " << o
+                 << Logging::endl;
+      reg->release_unreachable(inc->unreachable);
+      inc->~Incremental();
+      heap::dealloc(inc, sizeof(Incremental));
+      return true;
+    }
+
+    /**
+     * Must be called after storing `target` into a field of an object in the
+     * region represented by `in`, see `gc_step`.  This does nothing unless an
+     * incremental collection of the region is marking.
+     **/
+    static void write_barrier(Object* in, Object* target)
+    {
+      RegionTrace* reg = get(in);
+      auto inc = reg->incremental;
+      if (
+        (inc != nullptr) && (inc->phase == Phase::Marking) &&
+        (target != nullptr))
+        inc->grey.push(target);
+    }
+
+    /**
+     * As above, and must be used instead while the region of `in` has a
+     * nursery: `target` has been stored into a field of `src`.  This records
+     * `src` for the next minor collection if it is outside the nursery and
+     * `target` is inside it.  Stores into the iso object need no barrier.
+     **/
+    static void write_barrier(Object* in, Object* src, Object* target)
+    {
+      write_barrier(in, target);
+
+      if (
+        (target != nullptr) && (target->get_class() == Object::UNMARKED) &&
+        target->is_young() && (src->get_class() == Object::UNMARKED) &&
+        !src->is_young())
+        get(in)->old_to_young.push(src);
+    }
+
+    /**
+     * Choose whether objects allocated in the region of `o` go in a nursery.
+     * Most objects die young, and a minor collection, `gc_young`, only traces
+     * and sweeps the nursery, so its cost scales with the live young objects
+     * rather than the size of the region.  Objects are not moved: survivors
+     * are promoted by moving them onto the rings.
+     *
+     * While the nursery is used, stores into objects in the region must be
+     * followed by the three argument `write_barrier`.  Turning it off
+     * promotes the nursery.  Anything that collects or restructures the whole
+     * region promotes the nursery first.
+     **/
+    static void set_nursery(Object* o, bool on)
+    {
+      RegionTrace* reg = get(o);
+      if (!on)
+        reg->promote_young();
+      reg->nursery = on;
+    }
+
+    /**
+     * Run a minor collection on the region represented by the Object `o`.
+     * Objects outside the nursery are assumed to be live.  Objects in the
+     * nursery are collected if they cannot be reached from the iso object,
+     * the additional roots, or older objects recorded by `write_barrier`,
+     * and the rest are promoted.  Does nothing while an incremental
+     * collection of the region is running, as that collects every object.
+     **/
+    static void gc_young(Object* o)
+    {
+      VERONA_LOG << "Region minor GC called for: " << o << Logging::endl;
+      assert(o->debug_is_iso());
+      assert(is_trace_region(o->get_region()));
+
+      RegionTrace* reg = get(o);
+      if (reg->incremental != nullptr)
+        return;
+
+      Measure m(reg);
+      ObjectStack collect;
+      reg->mark_young(o);
+
+      // As in `sweep`, the non-trivial objects go first.
+      reg->sweep_young<NonTrivialRing>(o, collect);
+      reg->sweep_young<TrivialRing>(o, collect);
+      reg->stats.minor_collections++;
+      reg->release_unreachable(collect);
     }
 
     /// Add object `o` to the additional root stack of the region referenced to
@@ -287,6 +681,10 @@ namespace verona::rt
     {
       RegionTrace* reg = get(entry);
       reg->additional_entry_points.push(o);
+
+      auto inc = reg->incremental;
+      if ((inc != nullptr) && (inc->phase == Phase::Marking))
+        inc->grey.push(o);
     }
 
     /// Remove object `o` from the additional root stack of the region
@@ -302,6 +700,147 @@ namespace verona::rt
     }
 
   private:
+    /**
+     * Move the movable objects of the region represented by `o`, see
+     * `compact`.  Every object in the rings must be reachable, as after `gc`.
+     *
+     * The objects are found first, keeping a map from each to its copy, or
+     * to nullptr if it stays, as in `Region::clone_reachable`.  The map hashes
+     * the objects, so the originals are only freed once every pointer has
+     * been redirected.
+     **/
+    void evacuate(Object* o)
+    {
+      ObjectMap<std::pair<Object*, Object*>> forward;
+      ObjectMap<Object*> pinned;
+      std::vector<Object*> order;
+      ObjectStack dfs;
+      ObjectStack traced;
+
+      auto visit = [&](Object* p) {
+        if (forward.insert(std::make_pair(p, (Object*)nullptr)).first)
+          dfs.push(p);
+      };
+
+      pinned.insert(o);
+      visit(o);
+      additional_entry_points.forall([&](Object* p) {
+        if (clone_target(p) != CloneTarget::Internal)
+          return;
+        pinned.insert(p);
+        visit(p);
+      });
+
+      while (!dfs.empty())
+      {
+        Object* p = dfs.pop();
+        order.push_back(p);
+
+        auto desc = p->get_descriptor();
+        if (desc->fields != nullptr)
+        {
+          for (size_t i = 0; i < desc->field_count; i++)
+          {
+            Object* f = field(p, desc, i);
+            if (clone_target(f) == CloneTarget::Internal)
+              visit(f);
+          }
+          continue;
+        }
+
+        // The pointers `trace` finds cannot be changed.
+        p->trace(traced);
+        while (!traced.empty())
+        {
+          Object* f = traced.pop();
+          if (clone_target(f) == CloneTarget::Internal)
+          {
+            pinned.insert(f);
+            visit(f);
+          }
+        }
+      }
+
+      size_t moved = 0;
+      for (auto p : order)
+      {
+        if (
+          !is_clonable(p->get_descriptor()) || p->has_ext_ref() ||
+          (pinned.find(p) != pinned.end()))
+          continue;
+
+        Object* q = Object::object_start(heap::alloc(p->size()));
+        memcpy(q->real_start(), p->real_start(), p->size());
+        forward.find(p).value() = q;
+        moved += p->size();
+      }
+
+      if (moved == 0)
+        return;
+
+      auto copy_of = [&](Object* p) {
+        auto it = forward.find(p);
+        if ((it == forward.end()) || (it.value() == nullptr))
+          return p;
+        return it.value();
+      };
+
+      for (auto p : order)
+      {
+        Object* q = copy_of(p);
+        auto desc = q->get_descriptor();
+        if (desc->fields == nullptr)
+          continue;
+
+        for (size_t i = 0; i < desc->field_count; i++)
+        {
+          auto& f = field(q, desc, i);
+          if (clone_target(f) == CloneTarget::Internal)
+            f = copy_of(f);
+        }
+      }
+
+      // Link the copies into the rings in place of the originals.  The iso
+      // object stays, and ends the primary ring.
+      Object* prev = this;
+      for (Object* p = get_next(); (p != this) && (p != o);)
+      {
+        Object* q = copy_of(p);
+        Object* next = p->get_next();
+        if (prev == this)
+          set_next(q);
+        else
+          prev->set_next(q);
+        prev = q;
+        p = next;
+      }
+
+      prev = this;
+      for (Object* p = next_not_root; p != this;)
+      {
+        Object* q = copy_of(p);
+        Object* next = p->get_next();
+        if (prev == this)
+          next_not_root = q;
+        else
+          prev->set_next(q);
+        if (last_not_root == p)
+          last_not_root = q;
+        prev = q;
+        p = next;
+      }
+
+      for (auto p : order)
+      {
+        if (copy_of(p) != p)
+        {
+          VERONA_LOG << "Compact " << p << Logging::endl;
+          p->dealloc();
+        }
+      }
+      stats.bytes_moved += moved;
+    }
+
     inline void append(Object* hd)
     {
       append(hd, hd);
@@ -349,9 +888,7 @@ namespace verona::rt
       // Update memory usage.
       current_memory_used += other->current_memory_used;
 
-      previous_memory_used = size_to_sizeclass_full(
-        sizeclass_full_to_size(other->previous_memory_used) +
-        sizeclass_full_to_size(other->previous_memory_used));
+      previous_memory_used += other->previous_memory_used;
     }
 
     void swap_root_internal(Object* oroot, Object* nroot)
@@ -401,9 +938,10 @@ namespace verona::rt
     void mark(Object* o, ObjectStack& dfs)
     {
       o->trace(dfs);
-      while (!dfs.empty())
+      PrefetchQueue<> queue(dfs);
+      while (!queue.empty())
       {
-        Object* p = dfs.pop();
+        Object* p = queue.pop();
         switch (p->get_class())
         {
           case Object::ISO:
@@ -411,7 +949,7 @@ namespace verona::rt
             break;
 
           case Object::UNMARKED:
-            Logging::cout() << "Mark" << p << Logging::endl;
+            VERONA_LOG << "Mark" << p << Logging::endl;
             p->mark();
             p->trace(dfs);
             break;
@@ -432,6 +970,290 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Push the roots of the region represented by the iso object `o` for
+     * the incremental mark.
+     **/
+    void shade_roots(Object* o)
+    {
+      auto& grey = incremental->grey;
+      o->trace(grey);
+      additional_entry_points.forall([&grey](Object* p) {
+        VERONA_LOG << "Additional root: " << p << Logging::endl;
+        grey.push(p);
+      });
+    }
+
+    /**
+     * Colour an object just allocated during an incremental collection.
+     * While marking, it is pushed to be traced, as its fields were stored
+     * without the barrier.  While sweeping, it is marked only if the sweep has
+     * yet to reach it, so that the sweep unmarks it again.  New objects go at
+     * the start of their ring.
+     **/
+    void shade_new(Object* p)
+    {
+      auto inc = incremental;
+      switch (inc->phase)
+      {
+        case Phase::Marking:
+          inc->grey.push(p);
+          break;
+
+        case Phase::SweepNonTrivial:
+          if (p->is_trivial() || (inc->sweep_prev == this))
+            p->mark();
+          break;
+
+        case Phase::SweepTrivial:
+          if (p->is_trivial() && (inc->sweep_prev == this))
+            p->mark();
+          break;
+      }
+    }
+
+    /**
+     * As `mark`, for the objects pushed for the incremental collection.
+     * Classifies up to `budget` objects, and returns true if it ran out of
+     * objects first.
+     **/
+    bool mark_step(size_t& budget)
+    {
+      auto& grey = incremental->grey;
+      PrefetchQueue<> queue(grey);
+      while (!queue.empty())
+      {
+        if (budget == 0)
+          return false;
+        budget--;
+
+        Object* p = queue.pop();
+        switch (p->get_class())
+        {
+          case Object::ISO:
+          case Object::MARKED:
+            break;
+
+          case Object::UNMARKED:
+            VERONA_LOG << "Mark" << p << Logging::endl;
+            p->mark();
+            p->trace(grey);
+            break;
+
+          case Object::SCC_PTR:
+            p = p->immutable();
+            RememberedSet::mark(p);
+            break;
+
+          case Object::RC:
+          case Object::SHARED:
+            RememberedSet::mark(p);
+            break;
+
+          default:
+            assert(0);
+        }
+      }
+      return true;
+    }
+
+    /**
+     * As `sweep_ring`, for up to `budget` objects of one ring, continuing from
+     * where the last call stopped.  Returns true if the ring is finished.
+     *
+     * Memory use is tracked by subtracting the unreachable objects, as objects
+     * allocated since the start of the sweep are not visited.
+     **/
+    template<RingKind ring>
+    bool sweep_step(Object* o, size_t& budget)
+    {
+      auto inc = incremental;
+      RingKind primary_ring = o->is_trivial() ? TrivialRing : NonTrivialRing;
+      Object* prev = inc->sweep_prev;
+
+      while (true)
+      {
+        Object* p;
+        if (prev != this)
+          p = prev->get_next();
+        else if (ring == primary_ring)
+          p = get_next();
+        else
+          p = next_not_root;
+
+        if (p == this)
+          return true;
+
+        if (p->get_class() == Object::ISO)
+        {
+          // An iso is always the root, and the last thing in the ring.
+          assert(p->get_next_any_mark() == this);
+          assert(p->get_region() == this);
+          return true;
+        }
+
+        if (budget == 0)
+        {
+          inc->sweep_prev = prev;
+          return false;
+        }
+        budget--;
+
+        if (p->get_class() == Object::MARKED)
+        {
+          p->unmark();
+          prev = p;
+          continue;
+        }
+
+        assert(p->get_class() == Object::UNMARKED);
+        Object* q = p->get_next();
+        VERONA_LOG << "Sweep " << p << Logging::endl;
+        free_memory(p->size());
+        sweep_object<ring>(
+          p, o, &inc->finalised, inc->unreachable, nullptr);
+
+        if (ring != primary_ring && prev == this)
+          next_not_root = q;
+        else
+          prev->set_next(q);
+
+        if (ring != primary_ring && last_not_root == p)
+          last_not_root = prev;
+      }
+    }
+
+    /// Run any incremental collection of the region of `o` to the end.
+    void finish_incremental(Object* o)
+    {
+      if (incremental != nullptr)
+        gc_step(o, SIZE_MAX);
+    }
+
+    /**
+     * Finish any incremental collection of the region of `o`, and promote
+     * the nursery, so that every object is on the rings and unmarked.
+     **/
+    void settle(Object* o)
+    {
+      finish_incremental(o);
+      promote_young();
+    }
+
+    void append_young(Object* o)
+    {
+      RingKind k = o->is_trivial() ? TrivialRing : NonTrivialRing;
+      o->set_young();
+      o->init_next(young[k]);
+      young[k] = o;
+      if (last_young[k] == nullptr)
+        last_young[k] = o;
+    }
+
+    /// Move every object in the nursery onto the rings.
+    void promote_young()
+    {
+      while (!old_to_young.empty())
+        old_to_young.pop();
+
+      for (RingKind k : {TrivialRing, NonTrivialRing})
+      {
+        Object* hd = young[k];
+        if (hd == nullptr)
+          continue;
+
+        for (Object* p = hd; p != nullptr; p = p->get_next())
+          p->clear_young();
+
+        append(hd, last_young[k]);
+        young[k] = nullptr;
+        last_young[k] = nullptr;
+      }
+    }
+
+    /**
+     * As `mark`, but only marks and traces objects in the nursery.  The
+     * roots are traced whatever their age.
+     **/
+    void mark_young(Object* o)
+    {
+      ObjectStack dfs;
+      o->trace(dfs);
+
+      additional_entry_points.forall([&dfs](Object* p) {
+        VERONA_LOG << "Additional root: " << p << Logging::endl;
+        if ((p->get_class() == Object::UNMARKED) && p->is_young())
+          p->mark();
+        p->trace(dfs);
+      });
+
+      while (!old_to_young.empty())
+        old_to_young.pop()->trace(dfs);
+
+      while (!dfs.empty())
+      {
+        Object* p = dfs.pop();
+        if ((p->get_class() == Object::UNMARKED) && p->is_young())
+        {
+          VERONA_LOG << "Mark young " << p << Logging::endl;
+          p->mark();
+          p->trace(dfs);
+        }
+      }
+    }
+
+    /**
+     * Sweep one list of the nursery, and move the survivors onto their
+     * ring.  Memory use is tracked by subtracting the unreachable objects.
+     **/
+    template<RingKind ring>
+    void sweep_young(Object* o, ObjectStack& collect)
+    {
+      Object* p = young[ring];
+      young[ring] = nullptr;
+      last_young[ring] = nullptr;
+
+      Object* hd = nullptr;
+      Object* tl = nullptr;
+      LinkedObjectStack gc;
+
+      while (p != nullptr)
+      {
+        Object* q = p->get_next_any_mark();
+        p->clear_young();
+
+        if (p->get_class() == Object::MARKED)
+        {
+          p->unmark();
+          p->init_next(hd);
+          hd = p;
+          if (tl == nullptr)
+            tl = p;
+        }
+        else
+        {
+          VERONA_LOG << "Sweep young " << p << Logging::endl;
+          free_memory(p->size());
+          sweep_object<ring>(p, o, &gc, collect, nullptr);
+        }
+
+        p = q;
+      }
+
+      if (hd != nullptr)
+        append(hd, tl);
+
+      if constexpr (ring == NonTrivialRing)
+      {
+        while (!gc.empty())
+        {
+          Object* r = gc.pop();
+          r->destructor();
+          r->dealloc();
+        }
+      }
+    }
+
     enum class SweepAll
     {
       Yes,
@@ -449,6 +1271,8 @@ namespace verona::rt
     template<SweepAll sweep_all = SweepAll::No>
     void sweep(Object* o, ObjectStack& collect)
     {
+      // The rings count the objects they keep afresh.
+      size_t before = current_memory_used;
       current_memory_used = 0;
 
       RingKind primary_ring = o->is_trivial() ? TrivialRing : NonTrivialRing;
@@ -460,7 +1284,19 @@ namespace verona::rt
       sweep_ring<TrivialRing, sweep_all>(o, primary_ring, collect);
 
       RememberedSet::sweep();
-      previous_memory_used = size_to_sizeclass_full(current_memory_used);
+      end_recount(before);
+      previous_memory_used = current_memory_used;
+    }
+
+    /**
+     * Finish a sweep that recounted `current_memory_used` from zero, where
+     * it was `before`, so that the objects freed are accounted for.
+     **/
+    void end_recount(size_t before)
+    {
+      size_t kept = current_memory_used;
+      current_memory_used = before;
+      free_memory(before - kept);
     }
 
     /**
@@ -472,7 +1308,8 @@ namespace verona::rt
       Object* p,
       Object* region,
       LinkedObjectStack* gc,
-      ObjectStack& sub_regions)
+      ObjectStack& sub_regions,
+      ObjectStack* deferred)
     {
       assert(
         p->get_class() == Object::ISO || p->get_class() == Object::UNMARKED);
@@ -489,10 +1326,14 @@ namespace verona::rt
         if (p->has_ext_ref())
           ExternalReferenceTable::erase(p);
 
-        p->dealloc();
+        if (deferred != nullptr)
+          deferred->push(p);
+        else
+          p->dealloc();
       }
       else
       {
+        UNUSED(deferred);
         assert(!p->is_trivial());
         p->finalise(region, sub_regions);
 
@@ -503,8 +1344,17 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Sweep one ring.  If `deferred` is set, unreachable trivial objects are
+     * pushed onto it, for the caller to deallocate, rather than being
+     * deallocated straight away.
+     */
     template<RingKind ring, SweepAll sweep_all>
-    void sweep_ring(Object* o, RingKind primary_ring, ObjectStack& collect)
+    void sweep_ring(
+      Object* o,
+      RingKind primary_ring,
+      ObjectStack& collect,
+      ObjectStack* deferred = nullptr)
     {
       Object* prev = this;
       Object* p = ring == primary_ring ? get_next() : next_not_root;
@@ -526,11 +1376,11 @@ namespace verona::rt
             // entire region anyway.
             if constexpr (sweep_all == SweepAll::Yes)
             {
-              sweep_object<ring>(p, o, &gc, collect);
+              sweep_object<ring>(p, o, &gc, collect, deferred);
             }
             else
             {
-              use_memory(p->size());
+              current_memory_used += p->size();
             }
 
             p = this;
@@ -540,7 +1390,7 @@ namespace verona::rt
           case Object::MARKED:
           {
             assert(sweep_all == SweepAll::No);
-            use_memory(p->size());
+            current_memory_used += p->size();
             p->unmark();
             prev = p;
             p = p->get_next();
@@ -550,8 +1400,8 @@ namespace verona::rt
           case Object::UNMARKED:
           {
             Object* q = p->get_next();
-            Logging::cout() << "Sweep " << p << Logging::endl;
-            sweep_object<ring>(p, o, &gc, collect);
+            VERONA_LOG << "Sweep " << p << Logging::endl;
+            sweep_object<ring>(p, o, &gc, collect, deferred);
 
             if (ring != primary_ring && prev == this)
               next_not_root = q;
@@ -587,6 +1437,37 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Release the subregions in `collect`, which a sweep of this region found
+     * to be unreachable.
+     */
+    void release_unreachable(ObjectStack& collect)
+    {
+      // `collect` contains all the iso objects to unreachable subregions.
+      // Since they are unreachable, we can just release them.
+      while (!collect.empty())
+      {
+        Object* o = collect.pop();
+        assert(o->debug_is_iso());
+        VERONA_LOG << "Region GC: releasing unreachable subregion: " << o
+                   << Logging::endl;
+
+        // Note that we need to dispatch because `r` is a different region
+        // metadata object.
+        RegionBase* r = o->get_region();
+        assert(r != this);
+
+        // Unfortunately, we can't use Region::release_internal because of a
+        // circular dependency between header files.
+        if (RegionTrace::is_trace_region(r))
+          ((RegionTrace*)r)->release_internal(o, collect);
+        else if (RegionArena::is_arena_region(r))
+          ((RegionArena*)r)->release_internal(o, collect);
+        else
+          abort();
+      }
+    }
+
     /**
      * Release and deallocate all objects within the region represented by the
      * Iso Object `o`.
@@ -596,18 +1477,19 @@ namespace verona::rt
     void release_internal(Object* o, ObjectStack& collect)
     {
       assert(o->debug_is_iso());
+      settle(o);
 
       // It is an error if this region has additional roots.
       if (!additional_entry_points.empty())
       {
-        Logging::cout() << "Region release failed due to additional roots"
-                        << Logging::endl;
+        VERONA_LOG << "Region release failed due to additional roots"
+                   << Logging::endl;
         additional_entry_points.forall(
-          [](Object* o) { Logging::cout() << " root" << o << Logging::endl; });
+          [](Object* o) { VERONA_LOG << " root" << o << Logging::endl; });
         abort();
       }
 
-      Logging::cout() << "Region release: trace region: " << o << Logging::endl;
+      VERONA_LOG << "Region release: trace region: " << o << Logging::endl;
 
       // Sweep everything, including the entrypoint.
       sweep<SweepAll::Yes>(o, collect);
@@ -615,11 +1497,6 @@ namespace verona::rt
       dealloc();
     }
 
-    void use_memory(size_t size)
-    {
-      current_memory_used += size;
-    }
-
   public:
     template<IteratorType type = AllObjects>
     class iterator
@@ -640,17 +1517,51 @@ namespace verona::rt
           ptr = q;
 
         // If the next object is the region metadata object, then there was
-        // nothing to iterate over.
+        // nothing on the rings, so continue with the nursery.
         if (ptr == r)
-          ptr = nullptr;
+          ptr = young_from(0);
       }
 
       iterator(RegionTrace* r, Object* p) : reg(r), ptr(p) {}
 
+      /**
+       * The first object in the nursery lists from `index` on, that this
+       * iterator visits, or nullptr if there is none.
+       **/
+      Object* young_from(size_t index)
+      {
+        for (; index < 2; index++)
+        {
+          if constexpr (type == Trivial)
+          {
+            if (index != TrivialRing)
+              continue;
+          }
+          else if constexpr (type == NonTrivial)
+          {
+            if (index != NonTrivialRing)
+              continue;
+          }
+
+          if (reg->young[index] != nullptr)
+          {
+            young_index = index;
+            return reg->young[index];
+          }
+        }
+        return nullptr;
+      }
+
     public:
       iterator operator++()
       {
         Object* q = ptr->get_next_any_mark();
+        if (young_index < 2)
+        {
+          ptr = (q != nullptr) ? q : young_from(young_index + 1);
+          return *this;
+        }
+
         if (q != reg)
         {
           ptr = q;
@@ -668,14 +1579,14 @@ namespace verona::rt
           }
           else
           {
-            // We finished the secondary ring, so we're done.
-            ptr = nullptr;
+            // We finished the secondary ring, so continue with the nursery.
+            ptr = young_from(0);
           }
         }
         else
         {
           // We finished a ring and don't care about the other ring.
-          ptr = nullptr;
+          ptr = young_from(0);
         }
         return *this;
       }
@@ -694,6 +1605,9 @@ namespace verona::rt
     private:
       RegionTrace* reg;
       Object* ptr;
+
+      /// The nursery list being visited, or 2 while visiting the rings.
+      size_t young_index = 2;
     };
 
     template<IteratorType type = AllObjects>
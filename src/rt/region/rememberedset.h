@@ -8,35 +8,129 @@
 #include "immutable.h"
 
 #include <snmalloc/snmalloc.h>
+#include <utility>
 
 namespace verona::rt
 {
   using namespace snmalloc;
 
+  /**
+   * The immutable objects and cowns that a region holds, each with a reference
+   * count owned by the region.
+   *
+   * A set is either hashed or logged, chosen by the kind of region:
+   *  - A hashed set holds each object once, and can be marked and swept, as a
+   *    tracing collector needs.
+   *  - A logged set appends objects to a stack, and only releases them all at
+   *    once.  An object may be held more than once, each time with its own
+   *    reference count, but inserting never hashes or probes.  A small filter
+   *    of recent insertions keeps repeated insertions of the same object from
+   *    growing the log.  This suits regions that are never traced.
+   *
+   * A hashed set only allocates its map on the first insertion, so creating
+   * and releasing a region that holds no such objects costs no allocation.
+   */
   class RememberedSet
   {
     friend class RegionTrace;
     friend class RegionArena;
 
+  public:
+    enum class Kind
+    {
+      Hashed,
+      Logged,
+    };
+
   private:
     using HashSet = ObjectMap<Object*>;
-    HashSet* hash_set;
+
+    /// The set of a hashed set, or `nullptr` if nothing has been inserted.
+    HashSet* hash_set = nullptr;
+
+    bool logged;
+
+    /// The objects of a logged set.
+    StackThin<Object> log;
+
+    /**
+     * Objects recently inserted into a logged set, indexed by address.  An
+     * object found here is already in the log.
+     */
+    static constexpr size_t FILTER_SIZE = 8;
+    Object* filter[FILTER_SIZE] = {};
+
+    static size_t filter_index(Object* o)
+    {
+      return (((uintptr_t)o) >> MIN_ALLOC_BITS) & (FILTER_SIZE - 1);
+    }
+
+    bool is_logged() const
+    {
+      return logged;
+    }
+
+    static size_t size_of(const HashSet* set)
+    {
+      return (set == nullptr) ? 0 : set->size();
+    }
+
+    /**
+     * The set of a hashed set, allocated if this is the first insertion.  It
+     * grows incrementally, so a write barrier that happens to fill it does not
+     * pause to move every entry.
+     */
+    HashSet* get_set()
+    {
+      assert(!is_logged());
+      if (SNMALLOC_UNLIKELY(hash_set == nullptr))
+      {
+        hash_set = HashSet::create();
+        hash_set->set_incremental(true);
+      }
+      return hash_set;
+    }
 
   public:
-    RememberedSet() : hash_set(HashSet::create()) {}
+    RememberedSet(Kind kind = Kind::Hashed) : logged(kind == Kind::Logged) {}
 
     inline void dealloc()
     {
       discard(false);
+      if (is_logged())
+      {
+        log.dealloc();
+        return;
+      }
+      if (hash_set == nullptr)
+        return;
       hash_set->dealloc();
       heap::dealloc<sizeof(HashSet)>(hash_set);
+      hash_set = nullptr;
     }
 
     /**
-     * Add the objects from another set to this set.
+     * Add the objects from another set to this set.  The smaller set is
+     * inserted into the larger one, so merging a small region into a big one
+     * only hashes the entries of the small one.  `that` must be deallocated
+     * afterwards, without releasing its entries.
      */
     void merge(RememberedSet* that)
     {
+      assert(is_logged() == that->is_logged());
+      if (is_logged())
+      {
+        while (!that->log.empty())
+          log.push(that->log.pop());
+        return;
+      }
+
+      if (size_of(that->hash_set) > size_of(hash_set))
+        std::swap(hash_set, that->hash_set);
+      if (size_of(that->hash_set) == 0)
+        return;
+      hash_set->reserve(hash_set->size() + that->hash_set->size());
+
       for (auto* e : *that->hash_set)
       {
         // If q is already present in this, decref, otherwise insert.
@@ -63,7 +157,13 @@ namespace verona::rt
       if constexpr (transfer == NoTransfer)
         o->incref();
 
-      if (!hash_set->insert(o).first)
+      if (is_logged())
+      {
+        insert_logged(o);
+        return;
+      }
+
+      if (!get_set()->insert(o).first)
       {
         // If the caller is transfering ownership of a refcount, i.e., the
         // object is being moved from somewhere to this region, but the object
@@ -73,6 +173,25 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Call `f` on each object in the set, once for each reference count that
+     * the set holds on it.
+     */
+    template<typename F>
+    void for_each(F f)
+    {
+      if (is_logged())
+      {
+        log.for_each(f);
+        return;
+      }
+
+      if (hash_set == nullptr)
+        return;
+      for (auto* e : *hash_set)
+        f(e);
+    }
+
     /**
      * Mark the given object. If the object is not in the set, incref and add it
      * to the set.
@@ -80,8 +199,9 @@ namespace verona::rt
     void mark(Object* o)
     {
       assert(o->debug_is_rc() || o->debug_is_shared());
+      assert(!is_logged());
 
-      auto r = hash_set->insert(o);
+      auto r = get_set()->insert(o);
       if (r.first)
         o->incref();
 
@@ -93,6 +213,10 @@ namespace verona::rt
      */
     void sweep()
     {
+      assert(!is_logged());
+      if (hash_set == nullptr)
+        return;
+
       for (auto it = hash_set->begin(); it != hash_set->end(); ++it)
       {
         if (!it.is_marked())
@@ -113,6 +237,22 @@ namespace verona::rt
      */
     void discard(bool release = true)
     {
+      if (is_logged())
+      {
+        while (!log.empty())
+        {
+          Object* o = log.pop();
+          if (release)
+            RememberedSet::release_internal(o);
+        }
+        for (auto& f : filter)
+          f = nullptr;
+        return;
+      }
+
+      if (hash_set == nullptr)
+        return;
+
       for (auto it = hash_set->begin(); it != hash_set->end(); ++it)
       {
         if (release)
@@ -124,6 +264,21 @@ namespace verona::rt
     }
 
   private:
+    void insert_logged(Object* o)
+    {
+      auto& f = filter[filter_index(o)];
+      if (f == o)
+      {
+        // Already held, so drop the reference count taken for this insertion.
+        // No need to call release, as the rc will not drop to zero.
+        o->decref();
+        return;
+      }
+
+      f = o;
+      log.push(o);
+    }
+
     static void release_internal(Object* o)
     {
       switch (o->get_class())
@@ -131,14 +286,14 @@ namespace verona::rt
         case Object::RC:
         {
           assert(o->debug_is_immutable());
-          Logging::cout() << "RS releasing: immutable: " << o << Logging::endl;
+          VERONA_LOG << "RS releasing: immutable: " << o << Logging::endl;
           Immutable::release(o);
           break;
         }
 
         case Object::SHARED:
         {
-          Logging::cout() << "RS releasing: cown: " << o << Logging::endl;
+          VERONA_LOG << "RS releasing: cown: " << o << Logging::endl;
           shared::release(o);
           break;
         }
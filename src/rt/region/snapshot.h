@@ -0,0 +1,340 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../object/object.h"
+#include "immutable.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace verona::rt
+{
+  /**
+   * A frozen immutable graph saved to a file, so that it can be loaded
+   * without being built and frozen again.
+   *
+   * The file holds the objects one after another, as they are laid out in
+   * memory, header first.  The descriptor of each object is replaced by the
+   * stable id its type was registered with, see `register_type`, and each
+   * pointer field by the offset of its target in the file.
+   *
+   * `load` maps the file copy-on-write, and fixes up the descriptors and
+   * pointers in a single pass, without allocating.  The objects are loaded
+   * as one SCC, whose root is the root of the saved graph, and which has a
+   * single reference owned by the `Snapshot`.  Other references may be taken
+   * and dropped with `Immutable::acquire` and `release` as usual, but must
+   * all be dropped before the `Snapshot` is destroyed, which unmaps the
+   * objects without running any code on them.
+   *
+   * Only types whose pointers are all listed with `Fields` (or that have
+   * `no_pointers`), and that have no finaliser or destructor, can be saved.
+   */
+  class Snapshot
+  {
+    static constexpr uint64_t MAGIC = 0x31305041'4e535256; // "VRSNAP01"
+    static constexpr uint64_t VERSION = 1;
+
+    struct alignas(Object::ALIGNMENT) FileHeader
+    {
+      uint64_t magic;
+      uint64_t version;
+      /// Bytes of objects after this header.
+      uint64_t size;
+      /// Offset of the root object, after its header.
+      uint64_t root;
+      uint64_t count;
+    };
+
+    struct Registry
+    {
+      std::unordered_map<uint32_t, const Descriptor*> by_id;
+      std::unordered_map<const Descriptor*, uint32_t> by_descriptor;
+    };
+
+    static Registry& registry()
+    {
+      static Registry r;
+      return r;
+    }
+
+    /// Start of the mapping or buffer, and its size.
+    void* base;
+    size_t length;
+    Object* root;
+
+    Snapshot(void* base_, size_t length_, Object* root_)
+    : base(base_), length(length_), root(root_)
+    {}
+
+    static bool savable(const Descriptor* desc)
+    {
+      return (desc->fields != nullptr) && desc->has(Descriptor::IS_TRIVIAL);
+    }
+
+    static Object*& field(Object* o, const Descriptor* desc, size_t i)
+    {
+      return *(Object**)((uintptr_t)o + desc->fields[i]);
+    }
+
+  public:
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    /**
+     * Record that objects with `desc` are saved as `id`.  The same id must
+     * be used for the type whenever a snapshot of it is written or loaded.
+     * This is not thread safe, so types should be registered at startup.
+     * Returns false if the type cannot be saved, or either is already used.
+     */
+    static bool register_type(uint32_t id, const Descriptor* desc)
+    {
+      auto& r = registry();
+      if (!savable(desc) || r.by_id.count(id) || r.by_descriptor.count(desc))
+        return false;
+      r.by_id[id] = desc;
+      r.by_descriptor[desc] = id;
+      return true;
+    }
+
+    /**
+     * Save the immutable graph reachable from `o` to `path`.  Returns false
+     * if the graph reaches an object that is not immutable, or whose type is
+     * not registered, or if the file cannot be written.
+     */
+    static bool write(Object* o, const char* path)
+    {
+      auto& r = registry();
+
+      // Give each object its offset, in the order they will be written.
+      std::unordered_map<Object*, uint64_t> offsets;
+      std::vector<Object*> order;
+      std::vector<Object*> dfs{o};
+      uint64_t size = 0;
+      while (!dfs.empty())
+      {
+        Object* p = dfs.back();
+        dfs.pop_back();
+        if (offsets.count(p))
+          continue;
+
+        auto desc = p->get_descriptor();
+        if (!p->debug_is_immutable() || !r.by_descriptor.count(desc))
+          return false;
+
+        offsets[p] = size + sizeof(Object::Header);
+        order.push_back(p);
+        size += desc->size;
+
+        for (size_t i = 0; i < desc->field_count; i++)
+        {
+          auto* f = field(p, desc, i);
+          if (f != nullptr)
+            dfs.push_back(f);
+        }
+      }
+
+      FILE* file = fopen(path, "wb");
+      if (file == nullptr)
+        return false;
+
+      FileHeader header{MAGIC, VERSION, size, offsets[o], order.size()};
+      bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+      std::vector<std::byte> buffer;
+      for (auto* p : order)
+      {
+        auto desc = p->get_descriptor();
+        auto* start = p->real_start();
+        buffer.assign(start, start + desc->size);
+
+        auto* h = (Object::Header*)buffer.data();
+        h->bits = 0;
+        h->descriptor_bits = r.by_descriptor[desc];
+#ifdef USE_SYSTEMATIC_TESTING
+        h->sys_id = 0;
+#endif
+
+        auto* copy = Object::object_start(buffer.data());
+        for (size_t i = 0; i < desc->field_count; i++)
+        {
+          auto& f = field(copy, desc, i);
+          if (f != nullptr)
+            f = (Object*)(uintptr_t)offsets[f];
+        }
+
+        ok = ok && (fwrite(buffer.data(), buffer.size(), 1, file) == 1);
+      }
+
+      return (fclose(file) == 0) && ok;
+    }
+
+    /**
+     * Load the graph saved in `path`.  Returns nullptr if the file cannot be
+     * read, is not a snapshot, or uses a type id that is not registered.
+     */
+    static Snapshot* load(const char* path)
+    {
+      size_t length;
+      void* base = map(path, length);
+      if (base == nullptr)
+        return nullptr;
+
+      Object* root = relocate(base, length);
+      if (root == nullptr)
+      {
+        unmap(base, length);
+        return nullptr;
+      }
+
+      return new (heap::alloc<sizeof(Snapshot)>()) Snapshot(base, length, root);
+    }
+
+    ~Snapshot()
+    {
+      // Nothing may refer to the objects once they are unmapped.
+      assert(root->debug_test_rc(1));
+      unmap(base, length);
+    }
+
+    static void destroy(Snapshot* s)
+    {
+      s->~Snapshot();
+      heap::dealloc<sizeof(Snapshot)>(s);
+    }
+
+    /// The root of the loaded graph.
+    Object* get_root() const
+    {
+      return root;
+    }
+
+  private:
+    /**
+     * Fix up the objects in the file image at `base`, and return the root,
+     * or nullptr if the image is not valid.
+     */
+    static Object* relocate(void* base, size_t length)
+    {
+      auto& r = registry();
+      if (length < sizeof(FileHeader))
+        return nullptr;
+
+      auto* header = (FileHeader*)base;
+      if (
+        (header->magic != MAGIC) || (header->version != VERSION) ||
+        (header->size != length - sizeof(FileHeader)) ||
+        (header->root >= header->size))
+        return nullptr;
+
+      auto* objects = (std::byte*)(header + 1);
+      Object* root = (Object*)(objects + header->root);
+
+      bool found_root = false;
+      uint64_t offset = 0;
+      for (size_t n = 0; n < header->count; n++)
+      {
+        if (header->size - offset < sizeof(Object::Header))
+          return nullptr;
+
+        auto* h = (Object::Header*)(objects + offset);
+        auto it = r.by_id.find((uint32_t)h->descriptor_bits);
+        if (it == r.by_id.end())
+          return nullptr;
+
+        auto desc = it->second;
+        if (header->size - offset < desc->size)
+          return nullptr;
+
+        h->descriptor = desc;
+#ifdef USE_SYSTEMATIC_TESTING
+        h->sys_id = Object::id_source.fetch_add(1, std::memory_order_relaxed);
+#endif
+        auto* o = Object::object_start(h);
+        for (size_t i = 0; i < desc->field_count; i++)
+        {
+          auto& f = field(o, desc, i);
+          if (f == nullptr)
+            continue;
+          auto target = (uintptr_t)f;
+          if (
+            (target >= header->size) || (target < sizeof(Object::Header)) ||
+            !Object::debug_is_aligned(f))
+            return nullptr;
+          f = (Object*)(objects + (uintptr_t)f);
+        }
+
+        if (o == root)
+        {
+          o->make_scc();
+          found_root = true;
+        }
+        else
+          o->set_scc(root);
+
+        offset += desc->size;
+      }
+
+      return (found_root && (offset == header->size)) ? root : nullptr;
+    }
+
+    static void* map(const char* path, size_t& length)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+      int fd = open(path, O_RDONLY);
+      if (fd < 0)
+        return nullptr;
+
+      // Private, so that the fix ups are not written back to the file.
+      struct stat st;
+      void* base = MAP_FAILED;
+      if ((fstat(fd, &st) == 0) && (st.st_size > 0))
+      {
+        length = (size_t)st.st_size;
+        base =
+          mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      }
+      close(fd);
+      return (base == MAP_FAILED) ? nullptr : base;
+#else
+      FILE* file = fopen(path, "rb");
+      if (file == nullptr)
+        return nullptr;
+
+      void* base = nullptr;
+      long end = -1;
+      if (fseek(file, 0, SEEK_END) == 0)
+        end = ftell(file);
+      if ((end > 0) && (fseek(file, 0, SEEK_SET) == 0))
+      {
+        length = (size_t)end;
+        base = heap::alloc(length);
+        if (fread(base, length, 1, file) != 1)
+        {
+          heap::dealloc(base, length);
+          base = nullptr;
+        }
+      }
+      fclose(file);
+      return base;
+#endif
+    }
+
+    static void unmap(void* base, size_t length)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+      munmap(base, length);
+#else
+      heap::dealloc(base, length);
+#endif
+    }
+  };
+} // namespace verona::rt
@@ -14,6 +14,8 @@ namespace verona::rt
 {
   using Scheduler = ThreadPool<SchedulerThread>;
 
+  class Notification;
+
   class BaseNoticeboard
   {
     using CT = std::conditional_t<
@@ -25,10 +27,29 @@ namespace verona::rt
     // The content of a noticeboard; only accessible via `put` and `get`.
     unsigned char content[sizeof(CT)];
 
+    /// Incremented each time a new value becomes visible to `peek`.
+    std::atomic<uint64_t> current_version{0};
+
+    /// Notified each time a new value becomes visible, if set.
+    Notification* on_update = nullptr;
+
   protected:
     // Indicate if the content of the noticeboard is std::is_fundamental
     bool is_fundamental;
 
+    BaseNoticeboard() = default;
+
+    BaseNoticeboard(const BaseNoticeboard&) = delete;
+
+    // Defined with `Noticeboard`, as this header cannot see `Notification`.
+    ~BaseNoticeboard();
+
+    /**
+     * Called after a new value has been `put`, to advance the version by the
+     * number of updates it covers and notify `on_update`.
+     */
+    void published(uint64_t updates = 1);
+
     template<typename T>
     void put(T v)
     {
@@ -81,6 +102,7 @@ namespace verona::rt
         assert(prev);
         put(prev);
       }
+      published(n);
     }
 
   public:
@@ -90,8 +112,7 @@ namespace verona::rt
       {
         return;
       }
-      Logging::cout() << "Flushing values on noticeboard: " << this
-                      << Logging::endl;
+      VERONA_LOG << "Flushing values on noticeboard: " << this << Logging::endl;
       flush_n(update_buffer.size());
     }
 
@@ -111,5 +132,30 @@ namespace verona::rt
       flush_n(pick);
     }
 #endif
+
+  public:
+    /**
+     * Returns the number of updates that have become visible to `peek`.
+     * This is a single load and does not enter an `Epoch`, so it is cheap
+     * enough to check on every request, and only `peek` when it changes.
+     *
+     * A peek after observing version `v` returns a value at least as new as
+     * the update that produced `v`.
+     */
+    uint64_t version() const
+    {
+      return current_version.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Notify `n` after each update, see `Notification::notify`.  Updates
+     * that arrive before it runs are coalesced, so the notification should
+     * compare `version` with the last one it handled.  Pass nullptr to stop
+     * notifying.  The noticeboard holds a reference to `n`.
+     *
+     * This must not race with `update`, so should be called from the
+     * behaviours that update the noticeboard, or before it is shared.
+     */
+    void set_notification(Notification* n);
   };
 } // namespace verona::rt
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "behaviourcore.h"
+#include "deferredrelease.h"
 
 namespace verona::rt
 {
@@ -12,47 +13,219 @@ namespace verona::rt
    */
   class Behaviour : public BehaviourCore
   {
+    friend class CycleCollector;
+
+    /// The behaviour running on this thread, for `release_early`.
+    static BehaviourCore*& current()
+    {
+      static thread_local BehaviourCore* behaviour = nullptr;
+      return behaviour;
+    }
+
+    /// Time the running behaviour started, if there is a rerun quantum.
+    static uint64_t& quantum_start()
+    {
+      static thread_local uint64_t start = 0;
+      return start;
+    }
+
     template<typename Be>
     static void invoke(Work* work)
     {
       // Dispatch to the body of the behaviour.
       BehaviourCore* behaviour = BehaviourCore::from_work(work);
+#ifdef USE_SCHED_STATS
+      uint64_t start_tsc = Clock::fast();
+      Scheduler::stats().queue_latency(
+        static_cast<size_t>(behaviour->priority),
+        start_tsc - behaviour->runnable_tsc);
+      if (behaviour->deadline != 0)
+        Scheduler::stats().deadline(
+          DeadlineQueue::now() > behaviour->deadline);
+      bool timed =
+        SchedulerStats::sample(Scheduler::get_latency_sample_period());
+#endif
+#ifdef USE_COWN_PROFILE
+      behaviour->profile_tsc = CownProfile::sample() ? Clock::fast() : 0;
+#endif
       Be* body = behaviour->get_body<Be>();
-      (*body)();
+      if (Scheduler::get_rerun_quantum() != 0)
+        quantum_start() = DeadlineQueue::now();
+      // Once the body has started, for instance before a rerun, it can no
+      // longer be cancelled.
+      bool cancelled = false;
+      if (auto c = std::exchange(behaviour->cancellation, nullptr))
+      {
+        cancelled = c->is_cancelled();
+        c->release();
+        if (cancelled)
+          Scheduler::stats().cancelled();
+      }
+
+      current() = behaviour;
+      DeferredRelease::begin();
+      Trace::record(TraceKind::BehaviourStart, behaviour);
+#ifdef USE_SYSTEMATIC_TESTING
+      CostModel::start(behaviour->cost_stamp);
+#endif
+      VERONA_PROBE1(behaviour_start, behaviour);
+      {
+        FinishScope::Enter in_scope(behaviour->scope);
+        if (!cancelled)
+          (*body)();
+        Trace::record(TraceKind::BehaviourEnd, behaviour);
+        VERONA_PROBE1(behaviour_end, behaviour);
+        current() = nullptr;
+        Scheduler::stats().executed();
+#ifdef USE_SCHED_STATS
+        if (timed)
+          Scheduler::stats().latency(
+            SchedulerStats::Phase::Execute, Clock::fast() - start_tsc);
+#endif
+
+        // Work buffered by the body is spawned in its scope.
+        if (flush_hook() != nullptr)
+          std::exchange(flush_hook(), nullptr)();
+      }
 
       if (behaviour_rerun())
       {
+        // Keep the cowns, and run the body again later on this core.
         behaviour_rerun() = false;
-        Scheduler::schedule(work);
+#ifdef USE_SCHED_STATS
+        behaviour->runnable_tsc = Clock::fast();
+#endif
+        DeferredRelease::end();
+        Scheduler::schedule_rerun(work);
         return;
       }
 
-      behaviour->release_all();
+      behaviour->leave_queues();
+      behaviour->release_all(true);
+
+      auto scope = behaviour->scope;
 
-      // Dealloc behaviour
+      // Dealloc behaviour, unless a thread completing a deferred release
+      // still needs it.
       body->~Be();
-      work->dealloc();
+      DeferredRelease::end();
+      if (behaviour->drop_hold())
+        BehaviourCore::dealloc(work);
+
+      // Only once the captures are destroyed, so the continuation of the
+      // scope does not race with their destructors.
+      if (scope != nullptr)
+        scope->leave();
     }
 
   public:
+    /**
+     * If set, called once when the running behaviour's body returns, to
+     * schedule work it has buffered, see `verona::cpp::Fusion`.
+     */
+    static void (*&flush_hook())()
+    {
+      static thread_local void (*hook)() = nullptr;
+      return hook;
+    }
+
     static bool& behaviour_rerun()
     {
       static thread_local bool rerun = false;
       return rerun;
     }
 
+    /// Returns true if called from the body of a behaviour.
+    static bool in_behaviour()
+    {
+      return current() != nullptr;
+    }
+
+    /**
+     * Ask for the running behaviour to be run again once its body returns,
+     * still holding its cowns.  The body keeps its state, so a long loop can
+     * record its progress, return, and continue where it left off.  The rerun
+     * is queued behind other work on the same core.
+     */
+    static void rerun()
+    {
+      behaviour_rerun() = true;
+    }
+
+    /**
+     * Release `cown`, which the running behaviour has acquired, before the
+     * body returns, so that the next behaviour on it can start.  The body
+     * must not access the cown afterwards.
+     */
+    static void release_early(Cown* cown)
+    {
+      auto* behaviour = current();
+      assert(behaviour != nullptr);
+
+      auto* slots = behaviour->get_slots();
+      for (size_t i = 0; i < behaviour->count; i++)
+      {
+        if (slots[i].cown() != cown)
+          continue;
+
+        VERONA_LOG << "Early release " << slots[i] << Logging::endl;
+
+        // Not deferred, so nothing refers to the slot once this returns, and
+        // it can be marked like a duplicate for `release_all` to skip.
+        behaviour->leave_queue(cown);
+        slots[i].release();
+        slots[i].set_cown_null();
+        return;
+      }
+
+      // Not acquired by this behaviour, or already released.
+      assert(false);
+    }
+
+    /**
+     * Convert the running behaviour's write access to `cown` into read
+     * access, so that behaviours waiting to read it can start.  The body
+     * must only read the cown afterwards.
+     */
+    static void downgrade(Cown* cown)
+    {
+      auto* behaviour = current();
+      assert(behaviour != nullptr);
+
+      auto* slots = behaviour->get_slots();
+      for (size_t i = 0; i < behaviour->count; i++)
+      {
+        if (slots[i].cown() == cown)
+        {
+          slots[i].downgrade();
+          return;
+        }
+      }
+
+      // Not acquired by this behaviour, or already released.
+      assert(false);
+    }
+
+    /**
+     * Returns true if the running behaviour has used up the quantum set with
+     * `Scheduler::set_rerun_quantum`, and so should call `rerun` and return.
+     */
+    static bool should_yield()
+    {
+      auto quantum = Scheduler::get_rerun_quantum();
+      return (quantum != 0) &&
+        (DeadlineQueue::now() - quantum_start() >= quantum);
+    }
+
     template<typename Be>
     static Behaviour* make(size_t count, Be&& f)
     {
-      auto behaviour_core = BehaviourCore::make(count, invoke<Be>, sizeof(Be));
-
-      new (behaviour_core->get_body()) Be(std::forward<Be>(f));
+      auto behaviour_core = BehaviourCore::make(
+        count, invoke<Be>, sizeof(Be), true, alignof(Be));
+      BehaviourProfile::name<Be>(invoke<Be>);
+      behaviour_core->scope = FinishScope::join();
 
-      // These assertions are basically checking that we won't break any
-      // alignment assumptions on Be.  If we add some actual alignment, then
-      // this can be improved.
-      static_assert(
-        alignof(Be) <= sizeof(void*), "Alignment not supported, yet!");
+      new (behaviour_core->get_body<Be>()) Be(std::forward<Be>(f));
 
       return (Behaviour*)behaviour_core;
     }
@@ -64,24 +237,33 @@ namespace verona::rt
     }
 
     template<TransferOwnership transfer = NoTransfer, class Be>
-    static void schedule(size_t count, Cown** cowns, Be&& f)
+    static void schedule(
+      size_t count,
+      Cown** cowns,
+      Be&& f,
+      Priority priority = Priority::Normal)
     {
-      // TODO Remove vector allocation here.  This is a temporary fix to
-      // as we transition to using Request through the code base.
-      Request* requests = (Request*)heap::alloc(count * sizeof(Request));
+      VERONA_LOG << "Schedule behaviour of type: " << typeid(Be).name()
+                 << Logging::endl;
 
-      for (size_t i = 0; i < count; ++i)
+      // Write requests for each cown straight into the slots.
+      auto body = Behaviour::make<Be>(count, std::forward<Be>(f));
+
+      auto* slots = body->get_slots();
+      for (size_t i = 0; i < count; i++)
       {
-        requests[i] = Request::write(cowns[i]);
+        auto* s = new (&slots[i]) Slot(cowns[i], i);
         if constexpr (transfer == YesTransfer)
         {
-          requests[i].mark_move();
+          s->set_move();
         }
       }
+      body->priority = priority;
+      body->enter_queues();
 
-      schedule<Be>(count, requests, std::forward<Be>(f));
+      BehaviourCore* arr[] = {body};
 
-      heap::dealloc(requests);
+      BehaviourCore::schedule_many(arr, 1);
     }
 
     /**
@@ -97,24 +279,30 @@ namespace verona::rt
       auto* slots = body->get_slots();
       for (size_t i = 0; i < count; i++)
       {
-        auto* s = new (&slots[i]) Slot(requests[i].cown());
+        auto* s = new (&slots[i]) Slot(requests[i].cown(), i);
         if (requests[i].is_move())
           s->set_move();
         if (requests[i].is_read())
           s->set_read_only();
       }
+      body->enter_queues();
 
       return body;
     }
 
     template<class Be>
-    static void schedule(size_t count, Request* requests, Be&& f)
+    static void schedule(
+      size_t count,
+      Request* requests,
+      Be&& f,
+      Priority priority = Priority::Normal)
     {
-      Logging::cout() << "Schedule behaviour of type: " << typeid(Be).name()
-                      << Logging::endl;
+      VERONA_LOG << "Schedule behaviour of type: " << typeid(Be).name()
+                 << Logging::endl;
 
       auto* body =
         prepare_to_schedule<Be>(count, requests, std::forward<Be>(f));
+      body->priority = priority;
 
       BehaviourCore* arr[] = {body};
 
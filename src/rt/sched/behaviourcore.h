@@ -2,10 +2,19 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../debug/costmodel.h"
+#include "../debug/probes.h"
+#include "../debug/trace.h"
+#include "../ds/radixsort.h"
 #include "../ds/stackarray.h"
 #include "../object/object.h"
+#include "behaviourpool.h"
+#include "cancellation.h"
 #include "cown.h"
+#include "cownprofile.h"
+#include "finishscope.h"
 
+#include <algorithm>
 #include <snmalloc/snmalloc.h>
 
 namespace verona::rt
@@ -59,7 +68,28 @@ namespace verona::rt
 
   inline Logging::SysLog& operator<<(Logging::SysLog&, BehaviourCore&);
 
-  struct Slot
+  /**
+   * Whether the index of a slot in its behaviour is kept in the top 16 bits
+   * of its cown pointer, which needs addresses of at most 48 bits.  On
+   * targets with a larger address space, it has a word of its own, see
+   * `SlotIndexWord`.
+   */
+  static constexpr bool SLOT_INDEX_IN_POINTER = Aal::address_bits <= 48;
+
+  /**
+   * Where the index of a slot is kept if it does not fit in its cown pointer.
+   */
+  template<bool separate>
+  struct SlotIndexWord
+  {};
+
+  template<>
+  struct SlotIndexWord<true>
+  {
+    uintptr_t index_word = 0;
+  };
+
+  struct Slot : SlotIndexWord<!SLOT_INDEX_IN_POINTER>
   {
   private:
     /**
@@ -73,17 +103,30 @@ namespace verona::rt
      *          0 - Current slot Writer
      *          1 - Current slot Reader
      *
+     * Bits 48-63 - Index of this slot in its behaviour, saturated at
+     *          `COWN_INDEX_MAX`, see `get_behaviour`.  Only if
+     *          `SLOT_INDEX_IN_POINTER`, and otherwise part of the pointer.
+     *
      * Remaining bits - Cown pointer
      *
      * Assumption - Cowns are allocated at 4 byte boundary. Last 2 bits are
-     * zero.
+     * zero, and the top 16 bits of their address are zero if the index is
+     * kept there.  This is checked in release builds too, as tagged or
+     * 57-bit addresses would otherwise find the wrong behaviour.
      */
     std::atomic<uintptr_t> _cown;
 
     static constexpr uintptr_t COWN_2PL_READY_FLAG = 0x1;
     static constexpr uintptr_t COWN_READER_FLAG = 0x2;
+    static constexpr size_t COWN_INDEX_SHIFT = 48;
+    static constexpr uintptr_t COWN_INDEX_MAX = 0xFFFF;
+    static constexpr uintptr_t COWN_INDEX_MASK =
+      SLOT_INDEX_IN_POINTER ? (COWN_INDEX_MAX << COWN_INDEX_SHIFT) : 0;
     static constexpr uintptr_t COWN_POINTER_MASK =
-      ~(COWN_2PL_READY_FLAG | COWN_READER_FLAG);
+      ~(COWN_2PL_READY_FLAG | COWN_READER_FLAG | COWN_INDEX_MASK);
+
+    static_assert(
+      sizeof(uintptr_t) == 8, "Slot packs its index into a 64-bit word.");
 
     /**
      * Next slot in the MCS Queue
@@ -96,12 +139,15 @@ namespace verona::rt
      *          0 - Next slot Writer
      *          1 - Next slot Reader
      *
+     * Bit 2 - Set if the slot was released while its successor was still
+     *         being linked, see `defer_release`.
+     *
      * Remaining bits  - Next slot pointer
      *
      * Before scheduling: Bit 0 => Whether move or not
      *
-     * Assumption - Slots are allocated at 4 byte boundary. Last 2 bits are
-     * zero.
+     * Assumption - Slots and behaviours are allocated at 8 byte boundary.
+     * Last 3 bits are zero.
      *
      * The read available status allows that a newly added reader can
      * immediately be scheduled if the slot it is following has this
@@ -111,25 +157,47 @@ namespace verona::rt
 
     static constexpr uintptr_t STATUS_SLOT_READ_AVAILABLE_FLAG = 0x1;
     static constexpr uintptr_t STATUS_NEXT_SLOT_READER_FLAG = 0x2;
+    static constexpr uintptr_t STATUS_RELEASED_FLAG = 0x4;
     static constexpr uintptr_t STATUS_NEXT_SLOT_MASK =
-      ~(STATUS_SLOT_READ_AVAILABLE_FLAG | STATUS_NEXT_SLOT_READER_FLAG);
+      ~(STATUS_SLOT_READ_AVAILABLE_FLAG | STATUS_NEXT_SLOT_READER_FLAG |
+        STATUS_RELEASED_FLAG);
 
     /**
-     * Points to the behaviour associated with this slot.
-     * This pointer is set only for reader slots.
-     * TODO: Change this to get behaviour address from start of allocation if
-     * snmalloc is used otherwise use this pointer.
+     * Index of this slot in its behaviour, as stored in `_cown`, or in its
+     * own word.
      */
-    std::atomic<BehaviourCore*> behaviour;
+    uintptr_t stored_index()
+    {
+      if constexpr (SLOT_INDEX_IN_POINTER)
+        return _cown.load(std::memory_order_relaxed) >> COWN_INDEX_SHIFT;
+      else
+        return this->index_word;
+    }
 
   public:
-    Slot(Cown* __cown)
+    /**
+     * `index` is the position of this slot in its behaviour, which must not
+     * change afterwards: it is how `get_behaviour` finds the behaviour.
+     */
+    Slot(Cown* __cown, size_t index = 0)
     {
       // Check that the last two bits are zero
-      assert(((uintptr_t)__cown & ~COWN_POINTER_MASK) == 0);
-      _cown.store((uintptr_t)__cown, std::memory_order_release);
+      assert(
+        ((uintptr_t)__cown & (COWN_2PL_READY_FLAG | COWN_READER_FLAG)) == 0);
+      uintptr_t stored = index < COWN_INDEX_MAX ? index : COWN_INDEX_MAX;
+      if constexpr (SLOT_INDEX_IN_POINTER)
+      {
+        SNMALLOC_CHECK(((uintptr_t)__cown & COWN_INDEX_MASK) == 0);
+        _cown.store(
+          (uintptr_t)__cown | (stored << COWN_INDEX_SHIFT),
+          std::memory_order_release);
+      }
+      else
+      {
+        this->index_word = stored;
+        _cown.store((uintptr_t)__cown, std::memory_order_release);
+      }
       status.store(0, std::memory_order_release);
-      behaviour.store(nullptr, std::memory_order_release);
     }
 
     /**
@@ -208,23 +276,11 @@ namespace verona::rt
     }
 
     /**
-     * Get the behaviour associated with the read-only slot
-     */
-    BehaviourCore* get_behaviour()
-    {
-      assert(is_read_only());
-      assert(behaviour.load(std::memory_order_acquire) != nullptr);
-      return behaviour.load(std::memory_order_acquire);
-    }
-
-    /**
-     * Set the behaviour associated with the read-only slot
+     * Get the behaviour associated with the slot.  The slots follow their
+     * behaviour in the same allocation, so it is found by stepping back over
+     * the earlier slots.
      */
-    void set_behaviour(BehaviourCore* b)
-    {
-      assert(is_read_only());
-      behaviour.store(b, std::memory_order_release);
-    }
+    BehaviourCore* get_behaviour();
 
     /**
      * Return the next slot
@@ -247,6 +303,8 @@ namespace verona::rt
     /**
      * Returns true if current slot is a writer or a blocked reader,
      * otherwise returns false
+     *
+     * If this slot has already been released, the release is completed here.
      */
     bool set_next_slot_reader(Slot* n)
     {
@@ -258,25 +316,25 @@ namespace verona::rt
       uintptr_t new_status_val =
         ((uintptr_t)n) | (STATUS_NEXT_SLOT_READER_FLAG);
 
-      if (!is_read_only())
-      {
-        status.store(new_status_val, std::memory_order_seq_cst);
-        return true;
-      }
-
       // This is effectively a fetch_or, but as there is only a single thread
       // that can set the bits. This means we can use fetch_add instead, which
       // is supported on more architectures.
       uintptr_t old_status_val =
         status.fetch_add(new_status_val, std::memory_order_seq_cst);
-      Logging::cout() << "prev slot is_reader" << is_read_only()
-                      << " curr reader " << this
-                      << "old_status_val: " << old_status_val
-                      << " new_status_val: " << new_status_val << Logging::endl;
+      VERONA_LOG << "prev slot " << this << "old_status_val: " << old_status_val
+                 << " new_status_val: " << new_status_val << Logging::endl;
 
-      return (
-        (old_status_val & STATUS_SLOT_READ_AVAILABLE_FLAG) !=
-        STATUS_SLOT_READ_AVAILABLE_FLAG);
+      // Only the status word is read, as this slot may be released and
+      // deallocated once linked.  A writer is never read available, so this
+      // also covers a writer that is downgraded to a reader concurrently, see
+      // `downgrade`.
+      bool blocked = (old_status_val & STATUS_SLOT_READ_AVAILABLE_FLAG) !=
+        STATUS_SLOT_READ_AVAILABLE_FLAG;
+
+      if ((old_status_val & STATUS_RELEASED_FLAG) != 0)
+        complete_deferred_release();
+
+      return blocked;
     }
 
     /**
@@ -293,14 +351,21 @@ namespace verona::rt
 
     /**
      * Set the next behaviour
+     *
+     * If this slot has already been released, the release is completed here.
      */
     void set_next_slot_writer(BehaviourCore* b)
     {
       // Requires that neither the READONLY or read-available bits are set.
       assert(((uintptr_t)b & ~STATUS_NEXT_SLOT_MASK) == 0);
-      status.store(
-        status.load(std::memory_order_acquire) | ((uintptr_t)b),
-        std::memory_order_release);
+      assert(no_successor());
+
+      // As in `set_next_slot_reader`, this is effectively a fetch_or.
+      uintptr_t old_status_val =
+        status.fetch_add((uintptr_t)b, std::memory_order_acq_rel);
+
+      if ((old_status_val & STATUS_RELEASED_FLAG) != 0)
+        complete_deferred_release();
     }
 
     /**
@@ -317,14 +382,63 @@ namespace verona::rt
      */
     void set_cown_null()
     {
-      _cown.store(0UL, std::memory_order_release);
+      _cown.store(
+        _cown.load(std::memory_order_acquire) & COWN_INDEX_MASK,
+        std::memory_order_release);
     }
 
     void wakeup_next_writer();
 
     void drop_read();
 
-    void release();
+    Core* successor_home();
+
+    /**
+     * Convert the slot of a running writer into a reader, so that the readers
+     * queued behind it can run alongside the rest of its behaviour.
+     */
+    void downgrade();
+
+    /**
+     * Make the run of readers starting at `first_slot` read available, and
+     * schedule them.  If `first_added` is set, the first of them has already
+     * been added to the read count.
+     */
+    static void wake_readers(Slot* first_slot, bool first_added);
+
+    /**
+     * Record, for `Trace`, that `cown` passes to `successor` from the
+     * behaviour of the last `TraceKind::Release` on this thread.
+     */
+    static void trace_handoff(Cown* cown, BehaviourCore* successor)
+    {
+      if constexpr (Trace::enabled)
+      {
+        Trace::record(TraceKind::Handoff, cown);
+        Trace::record(TraceKind::HandoffTo, successor);
+      }
+      else
+      {
+        snmalloc::UNUSED(cown, successor);
+      }
+    }
+
+    /**
+     * Release the cown to the next slot in the queue.  If `may_defer` is set
+     * and the next slot is still being linked, the linking thread is left to
+     * finish the release, see `defer_release`.  This may only be used by
+     * behaviours that are freed with `BehaviourCore::drop_hold`.
+     */
+    void release(bool may_defer = false);
+
+    /**
+     * The part of `release` that runs once the next slot is linked.
+     */
+    void release_linked(Core* home);
+
+    bool defer_release();
+
+    void complete_deferred_release();
 
     /**
      * Returns true if the slot is acquired with std::move
@@ -368,7 +482,7 @@ namespace verona::rt
       return os
         << " Slot: " << &s << " Cown ptr: "
         << (s._cown.load(std::memory_order_relaxed) & COWN_POINTER_MASK)
-        << " 2PL ready bit: "
+        << " Index: " << s.stored_index() << " 2PL ready bit: "
         << ((s._cown.load(std::memory_order_relaxed) & COWN_2PL_READY_FLAG) !=
             0)
         << " Is_reader bit: "
@@ -411,6 +525,72 @@ namespace verona::rt
     std::atomic<size_t> exec_count_down;
     size_t count;
 
+    /**
+     * If set, the behaviour is scheduled onto this core's queue once it is
+     * ready to run, rather than onto the queue of the thread that resolved
+     * its last dependency.
+     */
+    Core* affinity = nullptr;
+
+    /// Scheduling class of the behaviour once it is ready to run.
+    Priority priority = Priority::Normal;
+
+    /// Scheduling group of the behaviour, found from its cowns once it is
+    /// ready to run, see `scheduling_group`.
+    uint8_t group = 0;
+
+    /// If non-zero, the time by which the behaviour should start, as given by
+    /// `DeadlineQueue::now`.  This takes precedence over `priority`.
+    uint64_t deadline = 0;
+
+    /**
+     * Set if the slots are already in `cown_less` order with no duplicate
+     * cowns, so `schedule_many` can skip sorting them.
+     */
+    bool presorted = false;
+
+    /**
+     * If set, the body is skipped if this has been cancelled by the time the
+     * behaviour first runs.  The behaviour holds a reference to it until
+     * then.
+     */
+    Cancellation* cancellation = nullptr;
+
+    /**
+     * The scope that was current when the behaviour was created, which it
+     * leaves once it has finished.  The scope is current while the body runs,
+     * so that the work it spawns joins it too.
+     */
+    FinishScope* scope = nullptr;
+
+#ifdef USE_QUEUE_DEPTH
+    /// Set if the behaviour is counted in the depth of its cowns, see
+    /// `Cown::queue_depth`.
+    bool counts_depth = false;
+#endif
+
+    /**
+     * Number of parties that need the behaviour's memory: the thread running
+     * it, plus one for each slot whose release is left to the thread linking
+     * its successor.
+     */
+    std::atomic<size_t> holds{1};
+
+#ifdef USE_SCHED_STATS
+    /// Time at which the behaviour became runnable.
+    uint64_t runnable_tsc = 0;
+#endif
+
+#ifdef USE_COWN_PROFILE
+    /// Time at which the body started, if it is sampled by `CownProfile`.
+    uint64_t profile_tsc = 0;
+#endif
+
+#ifdef USE_SYSTEMATIC_TESTING
+    /// When, in the `CostModel`, the behaviour became runnable.
+    CostModel::Stamp cost_stamp;
+#endif
+
     /**
      * @brief Construct a new Behaviour object
      *
@@ -432,6 +612,51 @@ namespace verona::rt
                 << b.exec_count_down.load(std::memory_order_acquire) << " ";
     }
 
+    void hold()
+    {
+      holds.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Drop a hold on the behaviour's memory.  Returns true if this was the
+     * last hold, in which case the caller must free the behaviour.
+     */
+    bool drop_hold()
+    {
+      // Fast path: no release was deferred, or all have completed.
+      if (holds.load(std::memory_order_acquire) == 1)
+        return true;
+
+      return holds.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    /**
+     * Record `w` as the writer waiting for the readers of `cown` to finish,
+     * after `try_write` has failed.  Returns true if the last reader has
+     * already left, in which case `w` now holds the cown, and the caller must
+     * account for that.
+     */
+    static bool set_next_writer(Cown* cown, BehaviourCore* w)
+    {
+      auto old =
+        cown->readers().next_writer.exchange(w, std::memory_order_acq_rel);
+      if (old == nullptr)
+        return false;
+
+      assert(old == readers_done());
+      cown->readers().next_writer.store(nullptr, std::memory_order_relaxed);
+      return true;
+    }
+
+    /**
+     * Marker left in `CownReaders::next_writer` by the last reader when the waiting
+     * writer has not recorded itself yet.
+     */
+    static BehaviourCore* readers_done()
+    {
+      return reinterpret_cast<BehaviourCore*>(uintptr_t(1));
+    }
+
     Work* as_work()
     {
       return pointer_offset_signed<Work>(
@@ -452,105 +677,689 @@ namespace verona::rt
 
     /**
      * Remove `n` from the exec_count_down.
+     *
+     * If this makes the behaviour runnable, it is scheduled onto its
+     * `affinity` core if set, otherwise onto `home` if set, otherwise onto
+     * the current thread's queue.  Behaviours with a deadline, or with high
+     * priority, go onto the deadline or high priority queue of that core, and
+     * critical behaviours onto a reserved core, see
+     * `ThreadPool::schedule_critical`.
+     *
+     * If `continuation` is set and there is no other placement, the
+     * behaviour may run on this thread straight after the current one, see
+     * `ThreadPool::schedule_continuation`.
+     */
+    void resolve(
+      size_t n = 1,
+      bool fifo = true,
+      Core* home = nullptr,
+      bool continuation = false)
+    {
+      VERONA_LOG << "Behaviour::resolve " << n << " for behaviour " << *this
+                 << Logging::endl;
+      if (ready(n))
+        schedule_ready(fifo, home, continuation);
+    }
+
+    /**
+     * As `resolve`, at the end of `schedule_many`.  A behaviour that is
+     * runnable here acquired all of its cowns without waiting, so it can
+     * run eagerly, see `ThreadPool::set_eager_depth`.
+     */
+    void resolve_scheduled(size_t n)
+    {
+      if (ready(n))
+        schedule_ready(true, nullptr, false, true);
+    }
+
+    /**
+     * Remove `n` from the dependencies of this behaviour.  Returns true if
+     * the behaviour is now runnable, in which case the caller must schedule
+     * it.
      */
-    void resolve(size_t n = 1, bool fifo = true)
+    bool ready(size_t n)
     {
-      Logging::cout() << "Behaviour::resolve " << n << " for behaviour "
-                      << *this << Logging::endl;
       // Note that we don't actually perform the last decrement as it is not
       // required.
       if (
-        (exec_count_down.load(std::memory_order_acquire) == n) ||
-        (exec_count_down.fetch_sub(n) == n))
+        (exec_count_down.load(std::memory_order_acquire) != n) &&
+        (exec_count_down.fetch_sub(n) != n))
+        return false;
+
+#ifdef USE_SCHED_STATS
+      runnable_tsc = Clock::fast();
+#endif
+      if (SNMALLOC_UNLIKELY(Scheduler::has_scheduling_groups()))
+        group = scheduling_group();
+      Trace::record(TraceKind::Runnable, this);
+#ifdef USE_SYSTEMATIC_TESTING
+      cost_stamp = CostModel::runnable();
+#endif
+      VERONA_PROBE1(behaviour_runnable, this);
+      return true;
+    }
+
+    /**
+     * True if the behaviour has no scheduling constraints, so once runnable
+     * it can be enqueued together with other work.
+     */
+    bool is_unconstrained()
+    {
+      return (affinity == nullptr) && (priority == Priority::Normal) &&
+        (deadline == 0) && (group == 0);
+    }
+
+    /**
+     * Schedule a runnable behaviour, see `resolve` for the parameters.
+     */
+    void schedule_ready(
+      bool fifo = true,
+      Core* home = nullptr,
+      bool continuation = false,
+      bool eager = false)
+    {
+      VERONA_LOG << "Scheduling Behaviour " << *this << Logging::endl;
+      if (Scheduler::get_share_nothing())
+      {
+        auto bound = bound_core();
+        if (bound != nullptr)
+          home = bound;
+      }
+      // Only critical work follows its cowns onto a reserved core.
+      if (
+        (home != nullptr) && home->reserved &&
+        (priority != Priority::Critical))
+        home = nullptr;
+      Core* target = affinity != nullptr ? affinity : home;
+      if (deadline != 0)
+        Scheduler::schedule_deadline(as_work(), deadline, target);
+      else if (priority == Priority::Critical)
+        Scheduler::schedule_critical(as_work(), target);
+      else if (priority == Priority::High)
+        Scheduler::schedule_high(as_work(), target);
+      else if (group != 0)
+        Scheduler::schedule_grouped(as_work(), group, target);
+      else if (target != nullptr)
+        Scheduler::schedule_on(target, as_work());
+      else if (continuation)
+      {
+        prefetch();
+        Scheduler::schedule_continuation(as_work());
+      }
+      else if (eager)
+        Scheduler::schedule_eager(as_work());
+      else
+      {
+        // This becomes the current thread's `next_work`, so is likely to
+        // run straight after the behaviour running now.
+        if (fifo && (Scheduler::local_core() != nullptr))
+          prefetch();
+        Scheduler::schedule(as_work(), fifo);
+      }
+    }
+
+    /// Largest number of cowns whose state `prefetch` fetches.
+    static constexpr size_t PREFETCH_COWNS = 8;
+
+    /**
+     * Start loading what this behaviour touches first when it runs, the
+     * start of its body and of its cowns, so that it is in the cache by the
+     * time the running behaviour finishes.  Only the first `PREFETCH_COWNS`
+     * cowns are fetched, so that a behaviour on many cowns does not evict
+     * the running behaviour's data.  See `Cown::set_prefetch_lines`.
+     */
+    void prefetch()
+    {
+      auto slots = get_slots();
+      auto n = std::min(count, PREFETCH_COWNS);
+      for (size_t i = 0; i < n; i++)
+      {
+        auto cown = slots[i].cown();
+        // Duplicate cowns have no cown in their slot.
+        if (cown != nullptr)
+          cown->prefetch();
+      }
+      Aal::prefetch(get_body());
+    }
+
+    /**
+     * In share-nothing mode, the core all the cowns of this behaviour are
+     * bound to, or nullptr if they are not all bound to the same core, see
+     * `ThreadPool::set_share_nothing`.
+     */
+    Core* bound_core()
+    {
+      Core* core = nullptr;
+      auto slots = get_slots();
+      for (size_t i = 0; i < count; i++)
+      {
+        auto cown = slots[i].cown();
+        // Duplicate cowns have no cown in their slot.
+        if (cown == nullptr)
+          continue;
+        if (cown->home_core == nullptr)
+          return nullptr;
+        if ((core != nullptr) && (core != cown->home_core))
+          return nullptr;
+        core = cown->home_core;
+      }
+      return core;
+    }
+
+    /**
+     * The scheduling group of the first of the cowns of this behaviour that
+     * is not in the default group, or 0 if none is, see `Cown::set_group`.
+     */
+    uint8_t scheduling_group()
+    {
+      auto slots = get_slots();
+      for (size_t i = 0; i < count; i++)
+      {
+        auto cown = slots[i].cown();
+        // Duplicate cowns have no cown in their slot.
+        if ((cown != nullptr) && (cown->group != 0))
+          return cown->group;
+      }
+      return 0;
+    }
+
+    // TODO: When C++ 20 move to span.
+    Slot* get_slots()
+    {
+      return pointer_offset<Slot>(this, sizeof(BehaviourCore));
+    }
+
+    /**
+     * The body follows the slots, at the next address aligned for `T`.  The
+     * same `T` must be used for every call on a behaviour.
+     */
+    template<typename T = void>
+    T* get_body()
+    {
+      Slot* slots = pointer_offset<Slot>(this, sizeof(BehaviourCore));
+      void* body = pointer_offset(slots, sizeof(Slot) * count);
+      if constexpr (!std::is_void_v<T>)
+      {
+        if constexpr (alignof(T) > alignof(void*))
+          body = pointer_align_up<alignof(T)>(body);
+      }
+      return static_cast<T*>(body);
+    }
+
+    /**
+     * This function is used to acquire enough references to the cown.
+     *
+     *  - cown is the cown to acquire references to.
+     *  - transfer is how many references we already have, i.e. how many have
+     *    been transferred from the context.
+     *  - required is how many references we now need.
+     *
+     * This can result in either increasing the reference count, or releasing
+     * references.
+     */
+    static void
+    acquire_with_transfer(Cown* cown, size_t transfer, size_t required)
+    {
+      if (transfer == required)
+        return;
+
+      if (transfer > required)
+      {
+        VERONA_LOG << "Releasing references as more transferred than "
+                      "required: transfer: "
+                   << transfer << " required: " << required << " on cown "
+                   << cown << Logging::endl;
+        // Release transfer - required times, we needed one as we woke up
+        // the cown, but the rest were not required.
+        for (int j = 0; j < transfer - required; j++)
+          Cown::release(cown);
+        return;
+      }
+
+      VERONA_LOG << "Acquiring addition reference count: transfer: " << transfer
+                 << " required: " << required << " on cown " << cown
+                 << Logging::endl;
+      // We didn't have enough RCs passed in, so we need to acquire the rest.
+      for (int j = 0; j < required - transfer; j++)
+        Cown::acquire(cown);
+    }
+
+    static std::tuple<size_t, size_t>
+    handle_read_only_enqueue(Slot* prev_slot, Slot* new_slot, Cown* cown)
+    {
+      size_t ref_count = 0, ex_count = 0;
+      bool first_reader;
+
+      if (prev_slot && (prev_slot->set_next_slot_reader(new_slot)))
+      {
+        VERONA_LOG << " Previous slot is a writer or blocked reader cown "
+                   << *new_slot << Logging::endl;
+        yield();
+        goto fn_out;
+      }
+
+      yield();
+      first_reader = cown->readers().read_ref_count.add_read(1, new_slot);
+      VERONA_LOG << " Reader got the cown " << *new_slot << Logging::endl;
+      yield();
+
+      // TODO: This will not be correct in the multi-schedule cases.
+      // There needs to be a check that ensures the chain contains only
+      // reads. This will be calculated in the prepare phase.
+      new_slot->set_read_available();
+
+      ex_count = 1;
+      if (first_reader)
+      {
+        ref_count = 1;
+      }
+
+    fn_out:
+      return {ref_count, ex_count};
+    }
+
+    /**
+     * The global order in which cowns are acquired.  All paths through
+     * `schedule_many` must agree on this order to avoid deadlock.
+     *
+     * Cowns are ordered by their order key, which does not depend on where
+     * they were allocated, and then by identity.
+     */
+    static bool cown_less(Cown* a, Cown* b)
+    {
+      if (a->order_key != b->order_key)
+        return a->order_key < b->order_key;
+
+      return cown_identity(a) < cown_identity(b);
+    }
+
+    /// The tie break of `cown_less` between cowns with the same order key.
+    static uintptr_t cown_identity(Cown* c)
+    {
+#ifdef USE_SYSTEMATIC_TESTING
+      return c->id();
+#else
+      return (uintptr_t)c;
+#endif
+    }
+
+    /// Above this many slots, they are put in order by `radix_sort_cowns`.
+    static constexpr size_t RADIX_COUNT = 256;
+
+    /**
+     * Stable sort of `count` entries of `data` into `cown_less` order of
+     * `cown_of(entry)`, by radix rather than by comparison.  Entries for the
+     * same cown stay in the order they were in.
+     */
+    template<typename T, typename CownOf>
+    static void radix_sort_cowns(T* data, size_t count, CownOf cown_of)
+    {
+      StackArray<T> scratch(count, StackArray<T>::uninitialised);
+      radix_sort(data, scratch.get(), count, [&cown_of](const T& e) {
+        return (uint64_t)cown_identity(cown_of(e));
+      });
+      radix_sort(data, scratch.get(), count, [&cown_of](const T& e) {
+        return cown_of(e)->order_key;
+      });
+    }
+
+    /**
+     * Record in the `CownProfile`, if enabled, that `slot` has joined the
+     * queue of `cown` behind `prev`, which may be nullptr.  Must be called
+     * before `prev` can complete.
+     */
+    static void profile_enqueue(Cown* cown, Slot* prev, Slot* slot)
+    {
+#ifdef USE_COWN_PROFILE
+      if (!CownProfile::sample())
+        return;
+
+      bool writer = !slot->is_read_only();
+      bool changed = (prev != nullptr) && (prev->is_read_only() == writer);
+      CownProfile::enqueued(cown, cown->queue_depth(), writer, changed);
+#else
+      snmalloc::UNUSED(cown, prev, slot);
+#endif
+    }
+
+    /// Per cown state of `schedule_distinct`.
+    struct DistinctState
+    {
+      size_t transfer_count;
+      size_t ref_count;
+      size_t ex_count;
+      bool had_no_predecessor;
+    };
+
+    /**
+     * Runs the 2PL for a single behaviour with `count` distinct cowns, where
+     * `slot_at(i)` is the i-th slot in `cown_less` order.  As each cown has a
+     * chain of exactly one slot, the chain building and duplicate handling of
+     * the general path are not needed.  `state` must have room for `count`
+     * entries.
+     */
+    template<typename SlotAt>
+    static void schedule_distinct(
+      BehaviourCore* body, size_t count, SlotAt slot_at, DistinctState* state)
+    {
+      // Prepare phase.  The number of RCs provided by the when is read before
+      // the slots are made visible to other threads.
+      for (size_t i = 0; i < count; i++)
+      {
+        state[i].transfer_count = slot_at(i)->is_move();
+        slot_at(i)->reset_status();
+      }
+
+      // Acquire phase.
+      for (size_t i = 0; i < count; i++)
+      {
+        auto* new_slot = slot_at(i);
+        auto* cown = new_slot->cown();
+        state[i].had_no_predecessor = false;
+        state[i].ref_count = 0;
+        state[i].ex_count = 0;
+
+        auto prev_slot =
+          cown->last_slot.exchange(new_slot, std::memory_order_acq_rel);
+        profile_enqueue(cown, prev_slot, new_slot);
+
+        yield();
+
+        if (prev_slot == nullptr)
+        {
+          state[i].had_no_predecessor = true;
+        }
+        else
+        {
+          while (prev_slot->is_wait_2pl())
+          {
+            Systematic::yield_until(
+              [prev_slot]() { return !prev_slot->is_wait_2pl(); });
+            Aal::pause();
+          }
+        }
+
+        if (new_slot->is_read_only())
+        {
+          std::tie(state[i].ref_count, state[i].ex_count) =
+            handle_read_only_enqueue(prev_slot, new_slot, cown);
+          continue;
+        }
+
+        if (prev_slot != nullptr)
+        {
+          VERONA_LOG
+            << " Writer waiting for cown. Set next of previous slot cown "
+            << *new_slot << " previous " << *prev_slot << Logging::endl;
+          prev_slot->set_next_slot_writer(body);
+          yield();
+        }
+      }
+
+      // Release phase.
+      for (size_t i = 0; i < count; i++)
+      {
+        yield();
+        slot_at(i)->set_ready();
+      }
+
+      // Process & Resolve phase.
+      size_t ec = 1;
+      for (size_t i = 0; i < count; i++)
+      {
+        auto* slot = slot_at(i);
+        auto* cown = slot->cown();
+
+        if (state[i].had_no_predecessor)
+          state[i].ref_count++;
+        acquire_with_transfer(
+          cown, state[i].transfer_count, state[i].ref_count);
+
+        if (state[i].had_no_predecessor && !slot->is_read_only())
+        {
+          if (cown->try_write())
+          {
+            VERONA_LOG << " Writer at head of queue and got the cown " << *slot
+                       << Logging::endl;
+            state[i].ex_count++;
+            yield();
+          }
+          else
+          {
+            VERONA_LOG << " Writer waiting for previous readers cown " << *slot
+                       << Logging::endl;
+            yield();
+            if (set_next_writer(cown, body))
+              state[i].ex_count++;
+          }
+        }
+
+        ec += state[i].ex_count;
+      }
+
+      yield();
+      body->resolve_scheduled(ec);
+    }
+
+    /// Largest cown count handled by `schedule_small`.
+    static constexpr size_t SMALL_COUNT = 8;
+
+    /**
+     * Sort a small array of slots by `cown_less`, using a sorting network for
+     * up to four slots, and an insertion sort otherwise.
+     */
+    static void sort_small(Slot** slots, size_t count)
+    {
+      assert(count <= SMALL_COUNT);
+      auto cas = [slots](size_t i, size_t j) {
+        if (cown_less(slots[j]->cown(), slots[i]->cown()))
+          std::swap(slots[i], slots[j]);
+      };
+
+      switch (count)
+      {
+        case 0:
+        case 1:
+          return;
+        case 2:
+          cas(0, 1);
+          return;
+        case 3:
+          cas(0, 1);
+          cas(0, 2);
+          cas(1, 2);
+          return;
+        case 4:
+          cas(0, 1);
+          cas(2, 3);
+          cas(0, 2);
+          cas(1, 3);
+          cas(1, 2);
+          return;
+        default:
+          for (size_t i = 1; i < count; i++)
+          {
+            for (size_t j = i; (j > 0) &&
+                 cown_less(slots[j]->cown(), slots[j - 1]->cown());
+                 j--)
+              std::swap(slots[j], slots[j - 1]);
+          }
+          return;
+      }
+    }
+
+    /**
+     * Fast path of `schedule_many` for a single behaviour with at most
+     * `SMALL_COUNT` distinct cowns.  As each cown has a chain of exactly one
+     * slot, the chain building and duplicate handling of the general path
+     * are not needed, and all state is kept in fixed size arrays.
+     *
+     * Returns false, having done nothing, if the behaviour has duplicate
+     * cowns, in which case the general path must be used.
+     */
+    static bool schedule_small(BehaviourCore* body)
+    {
+      size_t count = body->count;
+      assert(count <= SMALL_COUNT);
+
+      Slot* sorted[SMALL_COUNT];
+      auto slots = body->get_slots();
+      for (size_t i = 0; i < count; i++)
+        sorted[i] = &slots[i];
+
+      sort_small(sorted, count);
+
+      for (size_t i = 1; i < count; i++)
+      {
+        if (sorted[i - 1]->cown() == sorted[i]->cown())
+          return false;
+      }
+
+      VERONA_LOG << "BehaviourCore::schedule_small " << count << Logging::endl;
+
+      DistinctState state[SMALL_COUNT];
+      schedule_distinct(
+        body, count, [&sorted](size_t i) { return sorted[i]; }, state);
+      return true;
+    }
+
+    /**
+     * Path of `schedule_many` for a single behaviour that only reads its
+     * cowns, e.g. a broadcast read over a `cown_array<const T>`.  With no
+     * writers there is no tie-breaking between modes, so the slots are
+     * sorted by cown alone, and each cown's chain is its one slot.
+     *
+     * Returns false, having done nothing, if the behaviour writes to any cown
+     * or has duplicate cowns, in which case the general path must be used.
+     */
+    static bool schedule_read_only(BehaviourCore* body)
+    {
+      size_t count = body->count;
+      auto slots = body->get_slots();
+
+      StackArray<Slot*> sorted(count, StackArray<Slot*>::uninitialised);
+      for (size_t i = 0; i < count; i++)
+      {
+        if (!slots[i].is_read_only())
+          return false;
+        sorted[i] = &slots[i];
+      }
+
+      if (count > RADIX_COUNT)
+      {
+        radix_sort_cowns(
+          sorted.get(), count, [](Slot* s) { return s->cown(); });
+      }
+      else
+      {
+        std::sort(sorted.get(), sorted.get() + count, [](Slot* a, Slot* b) {
+          return cown_less(a->cown(), b->cown());
+        });
+      }
+
+      for (size_t i = 1; i < count; i++)
       {
-        Logging::cout() << "Scheduling Behaviour " << *this << Logging::endl;
-        Scheduler::schedule(as_work(), fifo);
+        if (sorted[i - 1]->cown() == sorted[i]->cown())
+          return false;
       }
-    }
 
-    // TODO: When C++ 20 move to span.
-    Slot* get_slots()
-    {
-      return pointer_offset<Slot>(this, sizeof(BehaviourCore));
-    }
+      VERONA_LOG << "BehaviourCore::schedule_read_only " << count
+                 << Logging::endl;
 
-    template<typename T = void>
-    T* get_body()
-    {
-      Slot* slots = pointer_offset<Slot>(this, sizeof(BehaviourCore));
-      return pointer_offset<T>(slots, sizeof(Slot) * count);
+      StackArray<DistinctState> state(
+        count, StackArray<DistinctState>::uninitialised);
+      schedule_distinct(
+        body, count, [&sorted](size_t i) { return sorted[i]; }, state.get());
+      return true;
     }
 
     /**
-     * This function is used to acquire enough references to the cown.
-     *
-     *  - cown is the cown to acquire references to.
-     *  - transfer is how many references we already have, i.e. how many have
-     *    been transferred from the context.
-     *  - required is how many references we now need.
-     *
-     * This can result in either increasing the reference count, or releasing
-     * references.
+     * Path of `schedule_many` for a single behaviour whose slots were built
+     * already in `cown_less` order with no duplicates, e.g. from a
+     * `cown_set`.  No sorting or duplicate detection is performed.
      */
-    static void
-    acquire_with_transfer(Cown* cown, size_t transfer, size_t required)
+    static void schedule_presorted(BehaviourCore* body)
     {
-      if (transfer == required)
-        return;
+      size_t count = body->count;
+      auto slots = body->get_slots();
 
-      if (transfer > required)
+#ifndef NDEBUG
+      for (size_t i = 1; i < count; i++)
+        assert(cown_less(slots[i - 1].cown(), slots[i].cown()));
+#endif
+
+      VERONA_LOG << "BehaviourCore::schedule_presorted " << count
+                 << Logging::endl;
+
+      auto slot_at = [slots](size_t i) { return &slots[i]; };
+      if (count <= SMALL_COUNT)
       {
-        Logging::cout() << "Releasing references as more transferred than "
-                           "required: transfer: "
-                        << transfer << " required: " << required << " on cown "
-                        << cown << Logging::endl;
-        // Release transfer - required times, we needed one as we woke up
-        // the cown, but the rest were not required.
-        for (int j = 0; j < transfer - required; j++)
-          Cown::release(cown);
+        DistinctState state[SMALL_COUNT];
+        schedule_distinct(body, count, slot_at, state);
         return;
       }
 
-      Logging::cout() << "Acquiring addition reference count: transfer: "
-                      << transfer << " required: " << required << " on cown "
-                      << cown << Logging::endl;
-      // We didn't have enough RCs passed in, so we need to acquire the rest.
-      for (int j = 0; j < required - transfer; j++)
-        Cown::acquire(cown);
+      size_t size = count * sizeof(DistinctState);
+      auto state = static_cast<DistinctState*>(heap::alloc(size));
+      schedule_distinct(body, count, slot_at, state);
+      heap::dealloc(state, size);
     }
 
-    static std::tuple<size_t, size_t>
-    handle_read_only_enqueue(Slot* prev_slot, Slot* new_slot, Cown* cown)
+    /**
+     * Count the behaviour in the queue depth of each of its cowns, see
+     * `Cown::queue_depth`.  Called once the slots are built, before the
+     * behaviour is scheduled.  Does nothing unless built with
+     * `USE_QUEUE_DEPTH`.
+     */
+    void enter_queues()
     {
-      size_t ref_count = 0, ex_count = 0;
-      bool first_reader;
-
-      if (prev_slot && (prev_slot->set_next_slot_reader(new_slot)))
-      {
-        Logging::cout() << " Previous slot is a writer or blocked reader cown "
-                        << *new_slot << Logging::endl;
-        yield();
-        goto fn_out;
-      }
+#ifdef USE_QUEUE_DEPTH
+      auto* slots = get_slots();
+      for (size_t i = 0; i < count; i++)
+        slots[i].cown()->depth.fetch_add(1, std::memory_order_relaxed);
+      counts_depth = true;
+#endif
+    }
 
-      yield();
-      first_reader = cown->read_ref_count.add_read();
-      Logging::cout() << " Reader got the cown " << *new_slot << Logging::endl;
-      yield();
+    /// Undo `enter_queues` for the cowns the behaviour still holds.
+    void leave_queues()
+    {
+#ifdef USE_QUEUE_DEPTH
+      if (!counts_depth)
+        return;
 
-      // TODO: This will not be correct in the multi-schedule cases.
-      // There needs to be a check that ensures the chain contains only
-      // reads. This will be calculated in the prepare phase.
-      new_slot->set_read_available();
+      auto* slots = get_slots();
+      for (size_t i = 0; i < count; i++)
+        leave_queue(slots[i].cown());
+#endif
+    }
 
-      ex_count = 1;
-      if (first_reader)
-      {
-        ref_count = 1;
-      }
+    /// Undo `enter_queues` for a slot that is about to be marked as having no
+    /// cown.
+    void leave_queue(Cown* cown)
+    {
+#ifdef USE_QUEUE_DEPTH
+      if (counts_depth && (cown != nullptr))
+        cown->depth.fetch_sub(1, std::memory_order_relaxed);
+#else
+      snmalloc::UNUSED(cown);
+#endif
+    }
 
-    fn_out:
-      return {ref_count, ex_count};
+    /**
+     * Size of the allocation `make` uses for `count` slots and `payload`,
+     * which is aligned to `align`.
+     */
+    static constexpr size_t
+    alloc_size(size_t count, size_t payload, size_t align = alignof(void*))
+    {
+      // Manual memory layout of the behaviour structure.
+      //   | Work | Behaviour | Slot ... Slot | Padding | Body |
+      // The allocation is only pointer aligned, so the padding may need to be
+      // up to `align - alignof(void*)` bytes.
+      size_t padding = align > alignof(void*) ? align - alignof(void*) : 0;
+      return sizeof(Work) + sizeof(BehaviourCore) + (sizeof(Slot) * count) +
+        padding + payload;
     }
 
     /**
@@ -561,23 +1370,34 @@ namespace verona::rt
      * @param f - The function to execute once all the behaviours dependencies
      * are ready.
      * @param payload - The size of the payload to allocate.
+     * @param pooled - If set, the memory may come from the scheduler thread's
+     * `BehaviourPool`, and must be freed with `dealloc`.
+     * @param align - The alignment of the payload, which `get_body` must be
+     * called with.
      * @return BehaviourCore* - the pointer to the behaviour object.
      */
-    static BehaviourCore* make(size_t count, void (*f)(Work*), size_t payload)
+    static BehaviourCore* make(
+      size_t count,
+      void (*f)(Work*),
+      size_t payload,
+      bool pooled = false,
+      size_t align = alignof(void*))
     {
-      // Manual memory layout of the behaviour structure.
-      //   | Work | Behaviour | Slot ... Slot | Body |
-      size_t size =
-        sizeof(Work) + sizeof(BehaviourCore) + (sizeof(Slot) * count) + payload;
+      assert(bits::is_pow2(align));
+      size_t size = alloc_size(count, payload, align);
+#ifdef USE_BEHAVIOUR_POOL
+      void* base = pooled ? BehaviourPool::alloc(size) : heap::alloc(size);
+#else
+      snmalloc::UNUSED(pooled);
       void* base = heap::alloc(size);
+#endif
 
       Work* work = new (base) Work(f);
       void* base_behaviour = from_work(work);
       BehaviourCore* behaviour = new (base_behaviour) BehaviourCore(count);
 
-      // These assertions are basically checking that we won't break any
-      // alignment assumptions on Be.  If we add some actual alignment, then
-      // this can be improved.
+      // The end of the slots is pointer aligned, so only bodies that need
+      // more have to be padded, see `get_body`.
       static_assert(
         sizeof(Slot) % sizeof(void*) == 0,
         "Slot size must be a multiple of pointer size");
@@ -588,9 +1408,22 @@ namespace verona::rt
         sizeof(Work) % sizeof(void*) == 0,
         "Work size must be a multiple of pointer size");
 
+      VERONA_PROBE2(behaviour_create, behaviour, count);
       return behaviour;
     }
 
+    /**
+     * Free a behaviour created by `make` with `pooled` set.
+     */
+    static void dealloc(Work* work)
+    {
+#ifdef USE_BEHAVIOUR_POOL
+      BehaviourPool::dealloc(work);
+#else
+      work->dealloc();
+#endif
+    }
+
     /**
      * @brief Schedule a behaviour for execution.
      *
@@ -695,8 +1528,41 @@ namespace verona::rt
      */
     static void schedule_many(BehaviourCore** bodies, size_t body_count)
     {
-      Logging::cout() << "BehaviourCore::schedule_many" << body_count
-                      << Logging::endl;
+#ifdef USE_SCHED_STATS
+      if (SchedulerStats::sample(Scheduler::get_latency_sample_period()))
+      {
+        uint64_t start = Clock::fast();
+        schedule_many_inner(bodies, body_count);
+        Scheduler::stats().latency(
+          SchedulerStats::Phase::Acquire, Clock::fast() - start);
+        return;
+      }
+#endif
+      schedule_many_inner(bodies, body_count);
+    }
+
+  private:
+    static void schedule_many_inner(BehaviourCore** bodies, size_t body_count)
+    {
+      VERONA_LOG << "BehaviourCore::schedule_many" << body_count
+                 << Logging::endl;
+
+      if (body_count == 1)
+      {
+        if (bodies[0]->presorted)
+        {
+          schedule_presorted(bodies[0]);
+          return;
+        }
+
+        if (bodies[0]->count <= SMALL_COUNT)
+        {
+          if (schedule_small(bodies[0]))
+            return;
+        }
+        else if (schedule_read_only(bodies[0]))
+          return;
+      }
 
       // non-unique cowns count
       size_t cown_count = 0;
@@ -718,8 +1584,13 @@ namespace verona::rt
       // cowns We first construct an array that represents pairs of behaviour
       // number and slot pointer. Note: Really want a dynamically sized stack
       // allocation here.
-      StackArray<std::tuple<size_t, Slot*>> cown_to_behaviour_slot_map(
-        cown_count);
+      struct BodySlot
+      {
+        size_t body;
+        Slot* slot;
+      };
+      StackArray<BodySlot> cown_to_behaviour_slot_map(
+        cown_count, StackArray<BodySlot>::uninitialised);
       size_t idx = 0;
       for (size_t i = 0; i < body_count; i++)
       {
@@ -756,34 +1627,45 @@ namespace verona::rt
       // be prioritised over the read, but between behaviours, we should keep
       // the order the same. This means we can always ignore anything but the
       // first slot for each behaviour when building the dependency chain.
-      auto compare = [](
-                       const std::tuple<size_t, Slot*> i,
-                       const std::tuple<size_t, Slot*> j) {
-#ifdef USE_SYSTEMATIC_TESTING
-        if (std::get<1>(i)->cown()->id() == std::get<1>(j)->cown()->id())
-          if (std::get<0>(i) == std::get<0>(j))
-            return (!std::get<1>(i)->is_read_only()) &&
-              std::get<1>(j)->is_read_only();
-          else
-            return std::get<0>(i) < std::get<0>(j);
-        else
-          return std::get<1>(i)->cown()->id() < std::get<1>(j)->cown()->id();
-#else
-        if (std::get<1>(i)->cown() == std::get<1>(j)->cown())
-          if (std::get<0>(i) == std::get<0>(j))
-            return (!std::get<1>(i)->is_read_only()) &&
-              std::get<1>(j)->is_read_only();
+      auto compare = [](const BodySlot i, const BodySlot j) {
+        if (i.slot->cown() == j.slot->cown())
+          if (i.body == j.body)
+            return (!i.slot->is_read_only()) && j.slot->is_read_only();
           else
-            return std::get<0>(i) < std::get<0>(j);
+            return i.body < j.body;
         else
-          return std::get<1>(i)->cown() < std::get<1>(j)->cown();
-#endif
+          return cown_less(i.slot->cown(), j.slot->cown());
+      };
+      auto insertion_sort = [&compare](BodySlot* map, size_t count) {
+        for (size_t i = 1; i < count; i++)
+        {
+          for (size_t j = i; (j > 0) && compare(map[j], map[j - 1]); j--)
+            std::swap(map[j], map[j - 1]);
+        }
       };
-      if (cown_count > 1)
+      if (cown_count <= SMALL_COUNT)
+      {
+        // Insertion sort is cheaper than std::sort for a handful of entries.
+        insertion_sort(cown_to_behaviour_slot_map.get(), cown_count);
+      }
+      else if (cown_count > RADIX_COUNT)
+      {
+        // The entries were built in behaviour order, which the radix sort
+        // keeps for each cown, so only a writer after a reader of the same
+        // cown in the same behaviour is left out of order.  Insertion sort
+        // fixes those with a single pass otherwise.
+        auto map = cown_to_behaviour_slot_map.get();
+        radix_sort_cowns(
+          map, cown_count, [](const BodySlot& e) { return e.slot->cown(); });
+        insertion_sort(map, cown_count);
+      }
+      else
+      {
         std::sort(
           cown_to_behaviour_slot_map.get(),
           cown_to_behaviour_slot_map.get() + cown_count,
           compare);
+      }
 
       // Helper struct to be used after building the chains in the next phases
       struct ChainInfo
@@ -799,50 +1681,52 @@ namespace verona::rt
       };
       size_t i = 0;
       size_t chain_count = 0;
-      StackArray<ChainInfo> chain_info(cown_count);
+      StackArray<ChainInfo> chain_info(
+        cown_count, StackArray<ChainInfo>::uninitialised);
 
       while (i < cown_count)
       {
-        auto cown = std::get<1>(cown_to_behaviour_slot_map[i])->cown();
-        auto body = bodies[std::get<0>(cown_to_behaviour_slot_map[i])];
-        auto last_slot = std::get<1>(cown_to_behaviour_slot_map[i]);
-        size_t first_body_index = std::get<0>(cown_to_behaviour_slot_map[i]);
+        auto cown = cown_to_behaviour_slot_map[i].slot->cown();
+        auto body = bodies[cown_to_behaviour_slot_map[i].body];
+        auto last_slot = cown_to_behaviour_slot_map[i].slot;
+        size_t first_body_index = cown_to_behaviour_slot_map[i].body;
 
         // The number of RCs provided for the current cown by the when.
         // I.e. how many moves of cown_refs there were.
         size_t transfer_count = last_slot->is_move();
 
-        Logging::cout() << "Processing " << cown << " " << body << " "
-                        << last_slot << " Index " << i << Logging::endl;
+        VERONA_LOG << "Processing " << cown << " " << body << " " << last_slot
+                   << " Index " << i << Logging::endl;
 
         // Detect duplicates for this cown.
         // This is required in two cases:
         //  * overlaps within a single behaviour.
         while (((++i) < cown_count) &&
-               (cown == std::get<1>(cown_to_behaviour_slot_map[i])->cown()))
+               (cown == cown_to_behaviour_slot_map[i].slot->cown()))
         {
           // If the body is the same, then we have an overlap within a single
           // behaviour.
-          auto body_next = bodies[std::get<0>(cown_to_behaviour_slot_map[i])];
+          auto body_next = bodies[cown_to_behaviour_slot_map[i].body];
           if (body_next == body)
           {
             // Check if the caller passed an RC and add to the total.
             transfer_count +=
-              std::get<1>(cown_to_behaviour_slot_map[i])->is_move();
+              cown_to_behaviour_slot_map[i].slot->is_move();
 
-            Logging::cout() << "Duplicate " << cown << " for " << body
-                            << " Index " << i << Logging::endl;
+            VERONA_LOG << "Duplicate " << cown << " for " << body << " Index "
+                       << i << Logging::endl;
             // We need to reduce the execution count by one, as we can't wait
             // for ourselves.
-            ec[std::get<0>(cown_to_behaviour_slot_map[i])]++;
+            ec[cown_to_behaviour_slot_map[i].body]++;
 
             // We need to mark the slot as not having a cown associated to it.
-            std::get<1>(cown_to_behaviour_slot_map[i])->set_cown_null();
+            body->leave_queue(cown);
+            cown_to_behaviour_slot_map[i].slot->set_cown_null();
             continue;
           }
 
           // For writers, create a chain of behaviours
-          if (!std::get<1>(cown_to_behaviour_slot_map[i])->is_read_only())
+          if (!cown_to_behaviour_slot_map[i].slot->is_read_only())
           {
             body = body_next;
 
@@ -850,7 +1734,7 @@ namespace verona::rt
             last_slot->set_next_slot_writer(body);
             last_slot->set_ready();
 
-            last_slot = std::get<1>(cown_to_behaviour_slot_map[i]);
+            last_slot = cown_to_behaviour_slot_map[i].slot;
             continue;
           }
 
@@ -865,9 +1749,6 @@ namespace verona::rt
 
         // Mark the slot as ready for scheduling
         last_slot->reset_status();
-        yield();
-        if (last_slot->is_read_only())
-          last_slot->set_behaviour(body);
       }
 
       // Second phase - Acquire phase
@@ -880,6 +1761,7 @@ namespace verona::rt
 
         auto prev_slot =
           cown->last_slot.exchange(new_slot, std::memory_order_acq_rel);
+        profile_enqueue(cown, prev_slot, new_slot);
 
         yield();
 
@@ -910,7 +1792,7 @@ namespace verona::rt
           continue;
         }
 
-        Logging::cout()
+        VERONA_LOG
           << " Writer waiting for cown. Set next of previous slot cown "
           << *new_slot << " previous " << *prev_slot << Logging::endl;
         prev_slot->set_next_slot_writer(first_body);
@@ -920,16 +1802,15 @@ namespace verona::rt
       // Third phase - Release phase.
       for (size_t i = 0; i < body_count; i++)
       {
-        Logging::cout() << "Release phase for behaviour " << bodies[i]
-                        << Logging::endl;
+        VERONA_LOG << "Release phase for behaviour " << bodies[i]
+                   << Logging::endl;
       }
 
       for (size_t i = 0; i < chain_count; i++)
       {
         yield();
         auto slot = chain_info[i].last_slot;
-        Logging::cout() << "Setting slot " << slot << " to ready"
-                        << Logging::endl;
+        VERONA_LOG << "Setting slot " << slot << " to ready" << Logging::endl;
         slot->set_ready();
 
         // TODO: We chould also set the READ_AVAILABLE here
@@ -958,19 +1839,20 @@ namespace verona::rt
         // Process writes without predecessor
         if ((chain_had_no_predecessor) && (!curr_slot->is_read_only()))
         {
-          if (cown->read_ref_count.try_write())
+          if (cown->try_write())
           {
-            Logging::cout() << " Writer at head of queue and got the cown "
-                            << *curr_slot << Logging::endl;
+            VERONA_LOG << " Writer at head of queue and got the cown "
+                       << *curr_slot << Logging::endl;
             ex_count++;
             yield();
           }
           else
           {
-            Logging::cout() << " Writer waiting for previous readers cown "
-                            << *curr_slot << Logging::endl;
+            VERONA_LOG << " Writer waiting for previous readers cown "
+                       << *curr_slot << Logging::endl;
             yield();
-            cown->next_writer = first_body;
+            if (set_next_writer(cown, first_body))
+              ex_count++;
           }
         }
 
@@ -981,26 +1863,177 @@ namespace verona::rt
       for (size_t i = 0; i < body_count; i++)
       {
         yield();
-        bodies[i]->resolve(ec[i]);
+        bodies[i]->resolve_scheduled(ec[i]);
+      }
+    }
+
+  public:
+    /**
+     * Schedule `count` behaviours that each require exclusive access to a
+     * single cown.  The behaviours for each cown run in the order they appear
+     * in `bodies`, but unlike `schedule_many` they are not an atomic batch.
+     *
+     * The behaviours for each cown are linked into one chain, which joins the
+     * cown's queue with a single exchange.  Those that can run straight away
+     * are published in segments, one per active core, rather than one at a
+     * time.
+     *
+     * `bodies` is reordered by this call.
+     */
+    static void schedule_bulk(BehaviourCore** bodies, size_t count)
+    {
+      VERONA_LOG << "Schedule bulk " << count << Logging::endl;
+
+      std::stable_sort(
+        bodies, bodies + count, [](BehaviourCore* a, BehaviourCore* b) {
+          return cown_less(a->get_slots()->cown(), b->get_slots()->cown());
+        });
+
+      size_t chain_count = 0;
+      for (size_t i = 0; i < count; i++)
+      {
+        if ((i == 0) || (bodies[i]->get_slots()->cown() !=
+                         bodies[i - 1]->get_slots()->cown()))
+          chain_count++;
+      }
+
+      // At most one behaviour per chain can run straight away.
+      size_t cores = Scheduler::get_active_core_count();
+      size_t segment_size = (chain_count + cores - 1) / cores;
+
+      Work* first_work = nullptr;
+      Work* last_work = nullptr;
+      size_t runnable = 0;
+      auto publish = [&]() {
+        if (runnable == 1)
+          Scheduler::schedule(first_work);
+        else if (runnable > 1)
+          Scheduler::schedule_segment(first_work, last_work, runnable);
+        first_work = nullptr;
+        last_work = nullptr;
+        runnable = 0;
+      };
+
+      size_t i = 0;
+      while (i < count)
+      {
+        size_t start = i;
+        auto* first_body = bodies[i];
+        auto* cown = first_body->get_slots()->cown();
+        size_t transfer_count = 0;
+
+        // Link the chain, leaving `slot` at its end.
+        Slot* slot;
+        while (true)
+        {
+          auto* body = bodies[i];
+          assert(body->count == 1);
+          slot = body->get_slots();
+          assert(!slot->is_read_only());
+
+          transfer_count += slot->is_move();
+          slot->reset_status();
+
+          if ((++i == count) || (bodies[i]->get_slots()->cown() != cown))
+            break;
+
+          slot->set_next_slot_writer(bodies[i]);
+          slot->set_ready();
+        }
+
+        yield();
+        auto* prev_slot =
+          cown->last_slot.exchange(slot, std::memory_order_acq_rel);
+        profile_enqueue(cown, prev_slot, slot);
+        yield();
+
+        size_t ex_count = 0;
+        if (prev_slot != nullptr)
+        {
+          while (prev_slot->is_wait_2pl())
+          {
+            Systematic::yield_until(
+              [prev_slot]() { return !prev_slot->is_wait_2pl(); });
+            Aal::pause();
+          }
+
+          prev_slot->set_next_slot_writer(first_body);
+          yield();
+        }
+
+        slot->set_ready();
+
+        if (prev_slot == nullptr)
+        {
+          acquire_with_transfer(cown, transfer_count, 1);
+          if (
+            cown->try_write() ||
+            set_next_writer(cown, first_body))
+            ex_count++;
+        }
+        else
+        {
+          acquire_with_transfer(cown, transfer_count, 0);
+        }
+
+        // Each behaviour holds a count for the end of scheduling, and the
+        // first of the chain holds another for the cown if it was acquired.
+        for (size_t j = start; j < i; j++)
+        {
+          auto* body = bodies[j];
+          if (!body->ready(j == start ? 1 + ex_count : 1))
+            continue;
+
+          if (!body->is_unconstrained())
+          {
+            body->schedule_ready();
+            continue;
+          }
+
+          Work* w = body->as_work();
+          if (last_work == nullptr)
+            first_work = w;
+          else
+            last_work->next_in_queue.store(w, std::memory_order_relaxed);
+          last_work = w;
+
+          if (++runnable == segment_size)
+            publish();
+        }
       }
+
+      publish();
     }
 
     /**
      * @brief Release all slots in the behaviour.
      *
-     * This is should be called when the behaviour has executed.
+     * This is should be called when the behaviour has executed.  If
+     * `may_defer` is set, see `Slot::release`, the behaviour must then be
+     * freed with `drop_hold`.
      */
-    void release_all()
+    void release_all(bool may_defer = false)
     {
-      Logging::cout() << "Finished Behaviour " << *this << Logging::endl;
+      VERONA_LOG << "Finished Behaviour " << *this << Logging::endl;
       auto slots = get_slots();
+#ifdef USE_COWN_PROFILE
+      if (profile_tsc != 0)
+      {
+        auto ticks = Clock::fast() - profile_tsc;
+        for (size_t i = 0; i < count; i++)
+        {
+          if ((slots[i].cown() != nullptr) && !slots[i].is_read_only())
+            CownProfile::held(slots[i].cown(), ticks);
+        }
+      }
+#endif
       // Behaviour is done, we can resolve successors.
+      Trace::record(TraceKind::Release, this);
       for (size_t i = 0; i < count; i++)
       {
-        slots[i].release();
+        slots[i].release(may_defer);
       }
-      Logging::cout() << "Finished Resolving successors " << *this
-                      << Logging::endl;
+      VERONA_LOG << "Finished Resolving successors " << *this << Logging::endl;
     }
 
     /**
@@ -1020,25 +2053,23 @@ namespace verona::rt
 
   inline void Slot::wakeup_next_writer()
   {
-    auto w = cown()->next_writer.load();
-
-    if (w == nullptr)
+    // The writer may not have recorded itself yet.  If so, leave a marker so
+    // that it finds the readers gone, see `BehaviourCore::set_next_writer`.
+    BehaviourCore* w = nullptr;
+    if (cown()->readers().next_writer.compare_exchange_strong(
+          w, BehaviourCore::readers_done(), std::memory_order_acq_rel))
     {
-      while (cown()->next_writer.load() == nullptr)
-      {
-        Systematic::yield_until(
-          [this]() { return cown()->next_writer.load() != nullptr; });
-        Aal::pause();
-      }
-
-      w = cown()->next_writer.load();
+      VERONA_LOG << *this << " Last Reader leaving next writer to wake"
+                 << Logging::endl;
+      return;
     }
 
-    Logging::cout() << *this << " Last Reader waking up next writer " << *w
-                    << Logging::endl;
+    VERONA_LOG << *this << " Last Reader waking up next writer " << *w
+               << Logging::endl;
 
     yield();
-    cown()->next_writer = nullptr;
+    cown()->readers().next_writer = nullptr;
+    trace_handoff(cown(), w);
     w->resolve();
   }
 
@@ -1046,14 +2077,14 @@ namespace verona::rt
   {
     assert(is_read_only());
 
-    auto status = cown()->read_ref_count.release_read();
+    auto status = cown()->readers().read_ref_count.release_read(this);
     if (status != ReadRefCount::NOT_LAST)
     {
       if (status == ReadRefCount::LAST_READER_WAITING_WRITER)
       {
-        Logging::cout() << *this
-                        << "Last Reader releasing the cown with writer waiting"
-                        << Logging::endl;
+        VERONA_LOG << *this
+                   << "Last Reader releasing the cown with writer waiting"
+                   << Logging::endl;
 
         // Last reader
         yield();
@@ -1062,26 +2093,54 @@ namespace verona::rt
 
       // Release cown as this will be set by the new thread joining the
       // queue.
-      Logging::cout() << *this
-                      << " Last Reader releasing the cown no writer waiting"
-                      << Logging::endl;
+      VERONA_LOG << *this << " Last Reader releasing the cown no writer waiting"
+                 << Logging::endl;
       shared::release(cown());
     }
   }
 
-  inline void Slot::release()
+  /**
+   * Called by a writer before it releases the cown.  Records the current core
+   * as the cown's home, subject to hysteresis, and returns the core the
+   * successor should be sent to.  Returns nullptr if the successor should be
+   * scheduled locally, either because this is the home core, or because the
+   * home core already has queued work and should not be sent more.
+   */
+  inline Core* Slot::successor_home()
+  {
+    // In share-nothing mode, the home core does not move, and the successor
+    // is placed by `BehaviourCore::schedule_ready`.
+    if (
+      !Scheduler::get_cown_home_affinity() || Scheduler::get_share_nothing())
+      return nullptr;
+
+    Core* current = Scheduler::local_core();
+    if (current == nullptr)
+      return nullptr;
+
+    Core* home = cown()->note_run_on(current);
+    if ((home == current) || !home->q.is_empty())
+      return nullptr;
+
+    return home;
+  }
+
+  inline void Slot::release(bool may_defer)
   {
-    Logging::cout() << "Release slot " << *this << Logging::endl;
+    VERONA_LOG << "Release slot " << *this << Logging::endl;
 
     // This slot represents a duplicate cown, so we can ignore releasing it.
     if (cown() == nullptr)
     {
-      Logging::cout() << "Duplicate cown slot " << *this << Logging::endl;
+      VERONA_LOG << "Duplicate cown slot " << *this << Logging::endl;
       return;
     }
 
     assert(!is_wait_2pl());
 
+    // Must be done before the cown can be acquired by another writer.
+    Core* home = is_read_only() ? nullptr : successor_home();
+
     if (no_successor())
     {
       auto slot_addr = this;
@@ -1098,13 +2157,16 @@ namespace verona::rt
         yield();
         // Release cown as this will be set by the new thread joining the
         // queue.
-        Logging::cout() << *this << " CAS Success No more work for cown "
-                        << Logging::endl;
+        VERONA_LOG << *this << " CAS Success No more work for cown "
+                   << Logging::endl;
         shared::release(cown());
         return;
       }
 
       // If we failed, then the another thread is extending the chain
+      if (may_defer && defer_release())
+        return;
+
       while (no_successor())
       {
         Systematic::yield_until([this]() { return !no_successor(); });
@@ -1112,6 +2174,62 @@ namespace verona::rt
       }
     }
 
+    release_linked(home);
+  }
+
+  inline BehaviourCore* Slot::get_behaviour()
+  {
+    // Saturated indices are followed back to a slot whose index fits.
+    Slot* first = this;
+    uintptr_t index;
+    while ((index = first->stored_index()) == COWN_INDEX_MAX)
+      first -= COWN_INDEX_MAX;
+    first -= index;
+    return pointer_offset_signed<BehaviourCore>(
+      first, -static_cast<ptrdiff_t>(sizeof(BehaviourCore)));
+  }
+
+  /**
+   * Called when the next slot is still being linked.  Marks the slot as
+   * released, so that the linking thread calls `complete_deferred_release`,
+   * and returns true.  Returns false if the next slot became visible first.
+   */
+  inline bool Slot::defer_release()
+  {
+    auto* b = get_behaviour();
+    // The linking thread may free the behaviour if it finishes first.
+    b->hold();
+
+    uintptr_t s = status.load(std::memory_order_acquire);
+    while ((s & STATUS_NEXT_SLOT_MASK) == 0)
+    {
+      if (status.compare_exchange_weak(
+            s, s | STATUS_RELEASED_FLAG, std::memory_order_acq_rel))
+      {
+        VERONA_LOG << *this << " Release left to next slot" << Logging::endl;
+        return true;
+      }
+    }
+
+    // Cannot be the last hold, as the calling thread still has its own.
+    b->holds.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  inline void Slot::complete_deferred_release()
+  {
+    auto* b = get_behaviour();
+    VERONA_LOG << *this << " Completing deferred release" << Logging::endl;
+
+    Trace::record(TraceKind::Release, b);
+    release_linked(nullptr);
+
+    if (b->drop_hold())
+      BehaviourCore::dealloc(b->as_work());
+  }
+
+  inline void Slot::release_linked(Core* home)
+  {
     if (is_read_only())
     {
       yield();
@@ -1120,27 +2238,25 @@ namespace verona::rt
       {
         yield();
 
-        Logging::cout() << *this << "Reader setting next writer variable "
-                        << next_behaviour() << Logging::endl;
+        VERONA_LOG << *this << "Reader setting next writer variable "
+                   << next_behaviour() << Logging::endl;
         /*
         For a chain of readers, only the last reader in the chain
         will find the next slot as the writer and will set the next_writer
         variable. Hence, this store is not atomic.
         */
-        if (cown()->read_ref_count.try_write())
+        if (
+          cown()->try_write() ||
+          BehaviourCore::set_next_writer(cown(), next_behaviour()))
         {
+          trace_handoff(cown(), next_behaviour());
           next_behaviour()->resolve();
         }
-        else
-        {
-          cown()->next_writer = next_behaviour();
-        }
 
         yield();
       }
 
-      Logging::cout() << *this << " Reader releasing the cown "
-                      << Logging::endl;
+      VERONA_LOG << *this << " Reader releasing the cown " << Logging::endl;
 
       drop_read();
       return;
@@ -1148,45 +2264,131 @@ namespace verona::rt
 
     if (!is_next_slot_read_only())
     {
-      Logging::cout() << *this
-                      << " Writer waking up next writer cown next slot "
-                      << *next_behaviour() << Logging::endl;
-      next_behaviour()->resolve();
+      VERONA_LOG << *this << " Writer waking up next writer cown next slot "
+                 << *next_behaviour() << Logging::endl;
+      trace_handoff(cown(), next_behaviour());
+      next_behaviour()->resolve(1, true, home, true);
       return;
     }
 
-    std::vector<Slot*> reader_queue;
-    bool first_reader = cown()->read_ref_count.add_read();
+    auto& read_ref_count = cown()->readers().read_ref_count;
+    bool first_reader = read_ref_count.add_read(1, next_slot());
 
     yield();
 
-    Logging::cout() << *this
-                    << " Writer waking up next reader and acquiring "
+    VERONA_LOG << *this
+               << " Writer waking up next reader and acquiring "
                        "reference count for first reader. next slot "
-                    << *next_slot() << Logging::endl;
+               << *next_slot() << Logging::endl;
+    assert(first_reader);
+    Cown::acquire(cown());
+    yield();
+
+    wake_readers(next_slot(), true);
+  }
+
+  inline void Slot::downgrade()
+  {
+    assert(!is_read_only());
+    VERONA_LOG << *this << " Downgrading to reader" << Logging::endl;
+
+    // As the writer, this has exclusive access to the read count, so this is
+    // the first reader, and holds a reference count like one.
+    auto& read_ref_count = cown()->readers().read_ref_count;
+    bool first_reader = read_ref_count.add_read(1, this);
     assert(first_reader);
+    snmalloc::UNUSED(first_reader);
     Cown::acquire(cown());
+
+    set_read_only();
     yield();
 
-    Slot* curr_slot = next_slot();
-    while (true)
+    // A reader that links after this is not blocked.  Readers that linked
+    // before are woken here.
+    if (set_read_available_is_next_reader())
+    {
+      Trace::record(TraceKind::Release, get_behaviour());
+      wake_readers(next_slot(), false);
+    }
+  }
+
+  inline void Slot::wake_readers(Slot* first_slot, bool first_added)
+  {
+    auto& read_ref_count = first_slot->cown()->readers().read_ref_count;
+
+    // Mark the run of readers as read available.  None of them can run
+    // until resolved below, so their slots remain valid.
+    size_t readers = 1;
+    for (Slot* curr_slot = first_slot;
+         curr_slot->set_read_available_is_next_reader();
+         readers++)
     {
-      reader_queue.push_back(curr_slot);
-      if (!curr_slot->set_read_available_is_next_reader())
-        break;
       yield();
       curr_slot = curr_slot->next_slot();
     }
 
-    // Add read count for readers. First reader is already added in rcount
-    cown()->read_ref_count.add_read(reader_queue.size() - 1);
+    // Add read count for readers, other than the first if it is already
+    // added.
+    size_t skip = first_added ? 1 : 0;
+    if (!read_ref_count.is_scalable())
+    {
+      if (readers > skip)
+        read_ref_count.add_read(static_cast<int>(readers - skip));
+    }
+    else
+    {
+      // Each reader must be added under its own identity.  All are added
+      // before any is resolved, so the count cannot drop to zero meanwhile.
+      Slot* curr_slot = first_slot;
+      for (size_t i = 0; i < readers; i++)
+      {
+        if (i >= skip)
+          read_ref_count.add_read(1, curr_slot);
+        if (i + 1 < readers)
+          curr_slot = curr_slot->next_slot();
+      }
+    }
 
     yield();
 
-    for (auto reader : reader_queue)
+    // Resolve the readers, and enqueue those that become runnable as a
+    // single segment.
+    Work* first_work = nullptr;
+    Work* last_work = nullptr;
+    size_t runnable = 0;
+    Slot* curr_slot = first_slot;
+    for (size_t i = 0; i < readers; i++)
     {
-      reader->get_behaviour()->resolve(1, false);
+      // Read the next slot before this reader can run and be deallocated.
+      Slot* next = (i + 1 < readers) ? curr_slot->next_slot() : nullptr;
+      auto* reader = curr_slot->get_behaviour();
+      trace_handoff(curr_slot->cown(), reader);
+
+      if (reader->ready(1))
+      {
+        if (!reader->is_unconstrained())
+        {
+          reader->schedule_ready(false);
+        }
+        else
+        {
+          Work* w = reader->as_work();
+          if (last_work == nullptr)
+            first_work = w;
+          else
+            last_work->next_in_queue.store(w, std::memory_order_relaxed);
+          last_work = w;
+          runnable++;
+        }
+      }
+
       yield();
+      curr_slot = next;
     }
+
+    if (runnable == 1)
+      Scheduler::schedule(first_work, false);
+    else if (runnable > 1)
+      Scheduler::schedule_segment(first_work, last_work, runnable);
   }
 } // namespace verona::rt
@@ -0,0 +1,302 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../ds/heap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <snmalloc/snmalloc.h>
+#include <utility>
+
+namespace verona::rt
+{
+  /**
+   * A per scheduler thread cache of behaviour memory, enabled by building
+   * with `USE_BEHAVIOUR_POOL`.
+   *
+   * Blocks are kept on free lists by size class.  Each block records the pool
+   * it came from.  A block freed on another scheduler thread is staged there,
+   * and staged blocks are handed back to their pool in batches, through a
+   * lock-free list that the owner drains when its own free list runs out.
+   * The scheduler thread also hands back everything it has staged at the end
+   * of each batch of work, see `flush_staged`, so that blocks return to the
+   * thread that creates behaviours, rather than to the heap as remote frees.
+   * Allocations from threads without a pool, and large allocations, go
+   * straight to the heap.
+   *
+   * A pool must only be destroyed once no other thread can free into it,
+   * which for scheduler threads is after they have all stopped.
+   */
+  class BehaviourPool
+  {
+    /**
+     * Header of each allocation.  It is padded so that the memory after it
+     * is as aligned as `operator new` must return, as coroutine frames are
+     * allocated here too, see `coroutine.h`.
+     */
+    struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Block
+    {
+      /// Pool that owns this block, or nullptr if it is not pooled.
+      BehaviourPool* owner;
+      /// Next block on a free list or remote list.
+      Block* next;
+      size_t size_class;
+    };
+
+    /// Size classes are multiples of this, including the block header.
+    static constexpr size_t GRANULE = 64;
+    static constexpr size_t SIZE_CLASSES = 8;
+
+    /// Number of free blocks kept per size class.
+    static constexpr size_t CACHE_LIMIT = 64;
+
+    /// Number of other pools with staged blocks at once.
+    static constexpr size_t REMOTE_TARGETS = 4;
+
+    /// Number of staged blocks that are handed back to their pool at once.
+    static constexpr size_t REMOTE_BATCH = 32;
+
+    struct RemoteBatch
+    {
+      BehaviourPool* owner;
+      Block* first;
+      Block* last;
+      size_t count;
+    };
+
+    Block* free_list[SIZE_CLASSES] = {};
+    size_t free_count[SIZE_CLASSES] = {};
+
+    /// Blocks handed back by other threads.
+    std::atomic<Block*> remote{nullptr};
+
+    RemoteBatch staged[REMOTE_TARGETS];
+    size_t staged_targets = 0;
+
+    static constexpr size_t block_size(size_t size_class)
+    {
+      return (size_class + 1) * GRANULE;
+    }
+
+    void put(Block* b)
+    {
+      auto sc = b->size_class;
+      if (free_count[sc] == CACHE_LIMIT)
+      {
+        heap::dealloc(b, block_size(sc));
+        return;
+      }
+
+      b->next = free_list[sc];
+      free_list[sc] = b;
+      free_count[sc]++;
+    }
+
+    Block* take(size_t sc)
+    {
+      if (free_list[sc] == nullptr)
+      {
+        // Reclaim the blocks other threads have handed back.
+        auto b = remote.exchange(nullptr, std::memory_order_acquire);
+        while (b != nullptr)
+        {
+          auto next = b->next;
+          put(b);
+          b = next;
+        }
+      }
+
+      auto b = free_list[sc];
+      if (b != nullptr)
+      {
+        free_list[sc] = b->next;
+        free_count[sc]--;
+      }
+      return b;
+    }
+
+    /// Hand a chain of blocks back to this pool.  Called by other threads.
+    void push_remote(Block* first, Block* last)
+    {
+      auto head = remote.load(std::memory_order_relaxed);
+      do
+      {
+        last->next = head;
+      } while (!remote.compare_exchange_weak(
+        head, first, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    void flush(RemoteBatch& s)
+    {
+      s.owner->push_remote(s.first, s.last);
+    }
+
+    void stage(Block* b)
+    {
+      size_t i = 0;
+      while ((i < staged_targets) && (staged[i].owner != b->owner))
+        i++;
+
+      if (i == REMOTE_TARGETS)
+      {
+        // No free entry, so hand back the oldest batch to make room.
+        flush(staged[0]);
+        staged[0] = staged[--staged_targets];
+        i = staged_targets;
+      }
+
+      auto& s = staged[i];
+      if (i == staged_targets)
+      {
+        staged_targets++;
+        s = {b->owner, b, b, 0};
+      }
+      else
+      {
+        b->next = s.first;
+        s.first = b;
+      }
+
+      if (++s.count == REMOTE_BATCH)
+      {
+        flush(s);
+        s = staged[--staged_targets];
+      }
+    }
+
+    static void release_chain(Block* b)
+    {
+      while (b != nullptr)
+      {
+        auto next = b->next;
+        heap::dealloc(b, block_size(b->size_class));
+        b = next;
+      }
+    }
+
+  public:
+    /// Largest allocation that is served from a pool.
+    static constexpr size_t MAX_POOLED =
+      (SIZE_CLASSES * GRANULE) - sizeof(Block);
+
+    BehaviourPool() = default;
+
+    BehaviourPool(const BehaviourPool&) = delete;
+
+    ~BehaviourPool()
+    {
+      for (size_t i = 0; i < SIZE_CLASSES; i++)
+        release_chain(free_list[i]);
+
+      release_chain(remote.exchange(nullptr, std::memory_order_acquire));
+
+      // Other pools may already have been destroyed, so blocks staged for
+      // them are returned to the heap directly.
+      for (size_t i = 0; i < staged_targets; i++)
+      {
+        staged[i].last->next = nullptr;
+        release_chain(staged[i].first);
+      }
+    }
+
+    /**
+     * Hand back all staged blocks to their pools.  Called by the owning
+     * scheduler thread between batches, so that a pool whose behaviours run
+     * elsewhere does not fall back to the heap while its blocks sit staged.
+     */
+    void flush_staged()
+    {
+      for (size_t i = 0; i < staged_targets; i++)
+        flush(staged[i]);
+      staged_targets = 0;
+    }
+
+    /**
+     * Return the free blocks, including those handed back by other threads,
+     * to the heap.  Called by the owning scheduler thread under memory
+     * pressure, see `MemoryPressure`.
+     */
+    void trim()
+    {
+      flush_staged();
+      for (size_t i = 0; i < SIZE_CLASSES; i++)
+      {
+        release_chain(std::exchange(free_list[i], nullptr));
+        free_count[i] = 0;
+      }
+      release_chain(remote.exchange(nullptr, std::memory_order_acquire));
+    }
+
+    /**
+     * Fill the free list of each size class with up to `count` blocks from
+     * the heap, so that the first behaviours made on this thread do not take
+     * the allocator's slow path.  Called by the owning scheduler thread, see
+     * `ThreadPool::set_low_jitter`.
+     */
+    void prefill(size_t count)
+    {
+      count = std::min(count, CACHE_LIMIT);
+      for (size_t sc = 0; sc < SIZE_CLASSES; sc++)
+      {
+        while (free_count[sc] < count)
+        {
+          auto b = static_cast<Block*>(heap::alloc(block_size(sc)));
+          b->owner = this;
+          b->size_class = sc;
+          put(b);
+        }
+      }
+    }
+
+    /// The pool of the current scheduler thread, if any.
+    static BehaviourPool*& local()
+    {
+      static thread_local BehaviourPool* pool = nullptr;
+      return pool;
+    }
+
+    static void* alloc(size_t size)
+    {
+      size_t sc = (size + sizeof(Block) - 1) / GRANULE;
+      auto pool = local();
+
+      Block* b;
+      if ((pool == nullptr) || (sc >= SIZE_CLASSES))
+      {
+        b = static_cast<Block*>(heap::alloc(size + sizeof(Block)));
+        b->owner = nullptr;
+      }
+      else
+      {
+        b = pool->take(sc);
+        if (b == nullptr)
+          b = static_cast<Block*>(heap::alloc(block_size(sc)));
+        b->owner = pool;
+        b->size_class = sc;
+      }
+
+      return b + 1;
+    }
+
+    static void dealloc(void* p)
+    {
+      auto b = static_cast<Block*>(p) - 1;
+      auto owner = b->owner;
+
+      if (owner == nullptr)
+      {
+        heap::dealloc(b);
+        return;
+      }
+
+      auto pool = local();
+      if (pool == owner)
+        pool->put(b);
+      else if (pool != nullptr)
+        pool->stage(b);
+      else
+        owner->push_remote(b, b);
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,252 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../pal/threading.h"
+#include "schedulerstats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <snmalloc/snmalloc.h>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+#if defined(__GNUC__)
+#  include <cxxabi.h>
+#endif
+
+namespace verona::rt
+{
+  struct Work;
+
+  /**
+   * Sampling profile of where the scheduler threads spend their time, by the
+   * type of the behaviour or closure that is running, to find the lambdas
+   * that are worth optimising without an external profiler or symbols.
+   *
+   * Each scheduler thread publishes the entry point, `Work::f`, of the work
+   * item it is running with a relaxed store before and after running it,
+   * which is all this costs while no profile is being taken.  `start` runs a
+   * thread that reads what every scheduler thread is running once each
+   * period and counts it, so a type's share of the samples is its share of
+   * the time.  Entry points are mapped to the closure types they were made
+   * from by `Behaviour::make` and `Closure::make`, which name each type the
+   * first time it is used.
+   *
+   * The published entry points are held in pooled objects that are never
+   * freed, so the sampler can read them while threads come and go.
+   */
+  class BehaviourProfile : public snmalloc::Pooled<BehaviourProfile>
+  {
+  public:
+    using EntryPoint = void (*)(Work*);
+
+  private:
+    /// The entry point of the work item this thread is running, or nullptr.
+    std::atomic<EntryPoint> running{nullptr};
+
+    /// Set while a scheduler thread is using this.
+    std::atomic<bool> active{false};
+
+    struct Sampler
+    {
+      std::mutex m;
+      std::condition_variable cv;
+      bool exit = false;
+      std::optional<PlatformThread> thread;
+
+      /// Samples of each entry point, and of threads running nothing.
+      std::unordered_map<EntryPoint, size_t> counts;
+      size_t idle = 0;
+    };
+
+    static Sampler& sampler()
+    {
+      static Sampler s;
+      return s;
+    }
+
+    static snmalloc::FlagWord& names_lock()
+    {
+      static snmalloc::FlagWord lock;
+      return lock;
+    }
+
+    static std::unordered_map<EntryPoint, const char*>& names()
+    {
+      static std::unordered_map<EntryPoint, const char*> names;
+      return names;
+    }
+
+    static void sample_all(Sampler& s);
+
+    static std::string demangle(const char* name)
+    {
+#if defined(__GNUC__)
+      int err = 0;
+      char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &err);
+      if (err == 0)
+      {
+        std::string result(demangled);
+        free(demangled);
+        return result;
+      }
+#endif
+      return name;
+    }
+
+  public:
+    /**
+     * The profile slot of the calling thread, which a scheduler thread keeps
+     * for as long as it runs, see `SchedulerThread::run_inner`.
+     */
+    static BehaviourProfile* acquire()
+    {
+      auto p = snmalloc::Pool<BehaviourProfile, snmalloc::Alloc::Config>::
+        acquire();
+      p->active.store(true, std::memory_order_relaxed);
+      return p;
+    }
+
+    static void release(BehaviourProfile* p)
+    {
+      p->running.store(nullptr, std::memory_order_relaxed);
+      p->active.store(false, std::memory_order_relaxed);
+      snmalloc::Pool<BehaviourProfile, snmalloc::Alloc::Config>::release(p);
+    }
+
+    /// Record that the thread is now running `f`, or nothing if nullptr.
+    void set_running(EntryPoint f)
+    {
+      running.store(f, std::memory_order_relaxed);
+    }
+
+    /**
+     * Name `f` after the closure type `T` it runs, once per type.  Called
+     * where work items are made, so that each type is named before it can
+     * be sampled.
+     */
+    template<typename T>
+    static void name(EntryPoint f)
+    {
+      static const bool named = [f]() {
+        snmalloc::FlagLock l(names_lock());
+        names().emplace(f, typeid(T).name());
+        return true;
+      }();
+      snmalloc::UNUSED(named);
+    }
+
+    /**
+     * Start sampling every `period`, adding to the counts of any earlier
+     * profile that has not been dumped.  Does nothing if already started.
+     */
+    static void start(
+      std::chrono::microseconds period = std::chrono::microseconds(1000))
+    {
+      auto& s = sampler();
+      std::unique_lock<std::mutex> l(s.m);
+      if (s.thread.has_value())
+        return;
+
+      s.exit = false;
+      s.thread.emplace([&s, period]() {
+        std::unique_lock<std::mutex> l(s.m);
+        while (!s.cv.wait_for(l, period, [&s]() { return s.exit; }))
+          sample_all(s);
+      });
+    }
+
+    /// Stop sampling, and wait for the sampling thread to finish.
+    static void stop()
+    {
+      auto& s = sampler();
+      std::optional<PlatformThread> thread;
+      {
+        std::unique_lock<std::mutex> l(s.m);
+        if (!s.thread.has_value())
+          return;
+        s.exit = true;
+        thread.swap(s.thread);
+      }
+      s.cv.notify_all();
+      thread->join();
+    }
+
+    /**
+     * Write the samples of each type as CSV, most sampled first, with the
+     * percentage of the samples of busy threads, and clear them.  Can be
+     * called while sampling.
+     */
+    static void dump(std::ostream& o);
+  };
+
+  using BehaviourProfilePool =
+    snmalloc::Pool<BehaviourProfile, snmalloc::Alloc::Config>;
+
+  inline void BehaviourProfile::sample_all(Sampler& s)
+  {
+    for (auto p = BehaviourProfilePool::iterate(); p != nullptr;
+         p = BehaviourProfilePool::iterate(p))
+    {
+      if (!p->active.load(std::memory_order_relaxed))
+        continue;
+
+      auto f = p->running.load(std::memory_order_relaxed);
+      if (f == nullptr)
+        s.idle++;
+      else
+        s.counts[f]++;
+    }
+  }
+
+  inline void BehaviourProfile::dump(std::ostream& o)
+  {
+    std::vector<std::pair<EntryPoint, size_t>> sorted;
+    size_t idle;
+    {
+      auto& s = sampler();
+      std::unique_lock<std::mutex> l(s.m);
+      sorted.assign(s.counts.begin(), s.counts.end());
+      idle = s.idle;
+      s.counts.clear();
+      s.idle = 0;
+    }
+
+    size_t busy = 0;
+    for (auto& [f, count] : sorted)
+      busy += count;
+    std::sort(sorted.begin(), sorted.end(), [](auto& a, auto& b) {
+      return a.second > b.second;
+    });
+
+    CSVStream csv(o);
+    csv << "BehaviourProfile"
+        << "Type"
+        << "Samples"
+        << "Percent" << std::endl;
+
+    for (auto& [f, count] : sorted)
+    {
+      std::string type = "Unnamed";
+      {
+        snmalloc::FlagLock l(names_lock());
+        auto it = names().find(f);
+        if (it != names().end())
+          type = demangle(it->second);
+      }
+      csv << "BehaviourProfile" << type << count
+          << ((count * 100) / std::max(busy, (size_t)1)) << std::endl;
+    }
+
+    csv << "BehaviourProfile"
+        << "Idle" << idle << "" << std::endl;
+  }
+} // namespace verona::rt
@@ -0,0 +1,62 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../ds/heap.h"
+
+#include <atomic>
+#include <new>
+
+namespace verona::rt
+{
+  /**
+   * A flag shared by the behaviours it is attached to, see
+   * `BehaviourCore::cancellation`.  Once it is set, a behaviour that has not
+   * started runs no body: it acquires its cowns in the usual order, and
+   * releases them straight away.  A behaviour that has already started is
+   * not affected.
+   *
+   * This is reference counted, with one count for the creator and one for
+   * each behaviour it is attached to.
+   */
+  class Cancellation
+  {
+    std::atomic<size_t> rc{1};
+    std::atomic<bool> cancelled{false};
+
+    Cancellation() = default;
+
+  public:
+    Cancellation(const Cancellation&) = delete;
+
+    /// A new cancellation, with a single reference.
+    static Cancellation* make()
+    {
+      return new (heap::alloc(sizeof(Cancellation))) Cancellation();
+    }
+
+    void acquire()
+    {
+      rc.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release()
+    {
+      if (rc.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      {
+        this->~Cancellation();
+        heap::dealloc(this, sizeof(Cancellation));
+      }
+    }
+
+    void cancel()
+    {
+      cancelled.store(true, std::memory_order_release);
+    }
+
+    bool is_cancelled() const
+    {
+      return cancelled.load(std::memory_order_acquire);
+    }
+  };
+} // namespace verona::rt
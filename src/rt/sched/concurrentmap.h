@@ -0,0 +1,382 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../ds/heap.h"
+#include "epoch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * A hash map that can be shared between threads, for instance as a lookup
+   * table read by behaviours on many cowns.
+   *
+   * Reads do not take locks, they enter an `Epoch` and walk the chain of the
+   * key's bucket.  Writes lock the key's bucket, so writes to different
+   * buckets run in parallel.  Removed entries are freed through the epoch,
+   * so a read never sees freed memory.
+   *
+   * The table doubles when it holds twice as many entries as buckets.  The
+   * writer that notices allocates the new table, and then every writer moves
+   * a few buckets to it until all have moved, so no single write pays for the
+   * whole resize.  A moved bucket is marked, so reads and writes that find it
+   * continue in the new table.
+   *
+   * Keys and values are copied, so should be small and trivially copyable.
+   * The map does not manage the lifetime of what they point to; a value that
+   * is a reference counted object should be released with
+   * `Epoch::dec_in_epoch` after it is removed or replaced.
+   */
+  template<typename K, typename V, typename Hash = std::hash<K>>
+  class ConcurrentMap
+  {
+    static_assert(std::is_trivially_copyable_v<K>);
+    static_assert(std::is_trivially_copyable_v<V>);
+
+    struct Node
+    {
+      /// Overwritten when the node is passed to `Epoch::delete_in_epoch`,
+      /// while reads may still walk through it.
+      unsigned char reserved[Epoch::DELETE_HEADER];
+      std::atomic<Node*> next;
+      const K key;
+      std::atomic<V> value;
+
+      Node(Node* next_, K key_, V value_)
+      : next(next_), key(key_), value(value_)
+      {}
+    };
+
+    struct Bucket
+    {
+      snmalloc::FlagWord lock;
+      std::atomic<Node*> head{nullptr};
+    };
+
+    /// Marks a bucket whose entries have moved to the next table.
+    static inline Node* const MOVED = (Node*)1;
+
+    /// Buckets a writer moves each time it helps a resize.
+    static constexpr size_t MIGRATE_STEP = 4;
+
+    struct Table
+    {
+      /// As for `Node`, as reads may still be in a table that is retired.
+      unsigned char reserved[Epoch::DELETE_HEADER];
+      const size_t shift;
+      /// The table being resized into, if any.
+      std::atomic<Table*> next{nullptr};
+      /// The next bucket to be moved to `next`.
+      std::atomic<size_t> migrate_index{0};
+      /// The number of buckets that have been moved to `next`.
+      std::atomic<size_t> migrated{0};
+
+      explicit Table(size_t shift_) : shift(shift_) {}
+
+      size_t capacity() const
+      {
+        return (size_t)1 << shift;
+      }
+
+      Bucket* buckets()
+      {
+        return (Bucket*)(this + 1);
+      }
+
+      Bucket& bucket(size_t hash)
+      {
+        // Fibonacci hashing, as keys such as pointers are rarely uniform in
+        // their low bits.
+        constexpr size_t bits = sizeof(size_t) * 8;
+        auto index = (hash * (size_t)0x9E3779B97F4A7C15) >> (bits - shift);
+        return buckets()[index];
+      }
+
+      static size_t alloc_size(size_t shift)
+      {
+        return sizeof(Table) + (sizeof(Bucket) << shift);
+      }
+
+      static Table* create(size_t shift)
+      {
+        auto t = new (heap::alloc(alloc_size(shift))) Table(shift);
+        for (size_t i = 0; i < t->capacity(); i++)
+          new (&t->buckets()[i]) Bucket();
+        return t;
+      }
+
+      static void destroy(Table* t)
+      {
+        for (size_t i = 0; i < t->capacity(); i++)
+        {
+          auto n = t->buckets()[i].head.load(std::memory_order_relaxed);
+          if (n == MOVED)
+            continue;
+
+          while (n != nullptr)
+          {
+            auto next = n->next.load(std::memory_order_relaxed);
+            heap::dealloc<sizeof(Node)>(n);
+            n = next;
+          }
+        }
+        heap::dealloc(t, alloc_size(t->shift));
+      }
+    };
+
+    static_assert(alignof(Table) >= alignof(Bucket));
+
+    std::atomic<Table*> root;
+    std::atomic<size_t> count{0};
+
+    static Node* find_in(Bucket& b, const K& key)
+    {
+      auto n = b.head.load(std::memory_order_acquire);
+      while (n != nullptr)
+      {
+        if (n->key == key)
+          return n;
+        n = n->next.load(std::memory_order_acquire);
+      }
+      return nullptr;
+    }
+
+    /**
+     * Lock the bucket for `hash`, in the newest table it has moved to, and
+     * return it.  Must be called in an epoch.
+     */
+    Bucket& lock_bucket(size_t hash)
+    {
+      auto t = root.load(std::memory_order_acquire);
+      while (true)
+      {
+        auto& b = t->bucket(hash);
+        b.lock.lock();
+        if (b.head.load(std::memory_order_relaxed) != MOVED)
+          return b;
+        b.lock.unlock();
+        t = t->next.load(std::memory_order_acquire);
+      }
+    }
+
+    /**
+     * Move one bucket of `t` to its next table.  The nodes are copied, so
+     * that reads walking the old chain are not disturbed, and the old nodes
+     * are freed through the epoch.
+     */
+    static void migrate_bucket(Epoch& e, Table* t, size_t index)
+    {
+      auto next = t->next.load(std::memory_order_acquire);
+      auto& b = t->buckets()[index];
+      b.lock.lock();
+
+      auto n = b.head.load(std::memory_order_relaxed);
+      while (n != nullptr)
+      {
+        auto& to = next->bucket(Hash{}(n->key));
+        to.lock.lock();
+        auto value = n->value.load(std::memory_order_relaxed);
+        auto head = to.head.load(std::memory_order_relaxed);
+        auto mem = heap::alloc<sizeof(Node)>();
+        auto copy = new (mem) Node(head, n->key, value);
+        to.head.store(copy, std::memory_order_release);
+        to.lock.unlock();
+
+        auto old = n;
+        n = n->next.load(std::memory_order_relaxed);
+        e.delete_in_epoch(old, sizeof(Node));
+      }
+
+      b.head.store(MOVED, std::memory_order_release);
+      b.lock.unlock();
+    }
+
+    /**
+     * If a resize is in progress, move some buckets to the new table, and
+     * once all have moved, make it the root.  Otherwise start a resize if the
+     * table is too full.
+     */
+    void help_resize(Epoch& e)
+    {
+      auto t = root.load(std::memory_order_acquire);
+      auto next = t->next.load(std::memory_order_acquire);
+
+      if (next == nullptr)
+      {
+        if (count.load(std::memory_order_relaxed) <= (t->capacity() * 2))
+          return;
+
+        auto fresh = Table::create(t->shift + 1);
+        if (!t->next.compare_exchange_strong(
+              next, fresh, std::memory_order_acq_rel))
+        {
+          Table::destroy(fresh);
+          return;
+        }
+        VERONA_LOG << "ConcurrentMap " << this << " resizing to "
+                   << fresh->capacity() << Logging::endl;
+      }
+
+      for (size_t i = 0; i < MIGRATE_STEP; i++)
+      {
+        auto index = t->migrate_index.fetch_add(1, std::memory_order_relaxed);
+        if (index >= t->capacity())
+          return;
+
+        migrate_bucket(e, t, index);
+
+        if (
+          t->migrated.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+          t->capacity())
+        {
+          // Every bucket has moved, so only reads and writes that started
+          // before this can still be in the old table.
+          root.store(
+            t->next.load(std::memory_order_relaxed), std::memory_order_release);
+          e.delete_in_epoch(t, Table::alloc_size(t->shift));
+          return;
+        }
+      }
+    }
+
+  public:
+    /**
+     * Create a map with at least `initial_capacity` buckets.
+     */
+    explicit ConcurrentMap(size_t initial_capacity = 16)
+    {
+      size_t shift = snmalloc::bits::next_pow2_bits(
+        std::max(initial_capacity, (size_t)2));
+      root.store(Table::create(shift), std::memory_order_relaxed);
+    }
+
+    ConcurrentMap(const ConcurrentMap&) = delete;
+    ConcurrentMap& operator=(const ConcurrentMap&) = delete;
+
+    /**
+     * Must not be called concurrently with any other operation.
+     */
+    ~ConcurrentMap()
+    {
+      auto t = root.load(std::memory_order_acquire);
+      while (t != nullptr)
+      {
+        auto next = t->next.load(std::memory_order_relaxed);
+        Table::destroy(t);
+        t = next;
+      }
+    }
+
+    /**
+     * Look up `key`, and if present copy its value to `value` and return
+     * true.
+     */
+    bool find(const K& key, V& value)
+    {
+      Epoch e;
+      auto hash = Hash{}(key);
+      auto t = root.load(std::memory_order_acquire);
+      while (true)
+      {
+        auto& b = t->bucket(hash);
+        if (b.head.load(std::memory_order_acquire) != MOVED)
+        {
+          auto n = find_in(b, key);
+          if (n == nullptr)
+            return false;
+          value = n->value.load(std::memory_order_acquire);
+          return true;
+        }
+        t = t->next.load(std::memory_order_acquire);
+      }
+    }
+
+    bool contains(const K& key)
+    {
+      V value;
+      return find(key, value);
+    }
+
+    /**
+     * Set the value of `key`.  Returns true if the key was added, and false
+     * if it was present and its value was replaced.
+     */
+    bool insert(const K& key, const V& value)
+    {
+      Epoch e;
+      bool added = false;
+      {
+        auto& b = lock_bucket(Hash{}(key));
+        auto n = find_in(b, key);
+        if (n != nullptr)
+        {
+          n->value.store(value, std::memory_order_release);
+        }
+        else
+        {
+          auto head = b.head.load(std::memory_order_relaxed);
+          auto mem = heap::alloc<sizeof(Node)>();
+          auto fresh = new (mem) Node(head, key, value);
+          b.head.store(fresh, std::memory_order_release);
+          added = true;
+        }
+        b.lock.unlock();
+      }
+
+      if (added)
+        count.fetch_add(1, std::memory_order_relaxed);
+      help_resize(e);
+      return added;
+    }
+
+    /**
+     * Remove `key`.  Returns true if it was present.
+     */
+    bool erase(const K& key)
+    {
+      Epoch e;
+      Node* removed = nullptr;
+      {
+        auto& b = lock_bucket(Hash{}(key));
+        std::atomic<Node*>* prev = &b.head;
+        auto n = prev->load(std::memory_order_relaxed);
+        while (n != nullptr)
+        {
+          if (n->key == key)
+          {
+            // Reads walking through `n` still see the rest of the chain.
+            prev->store(
+              n->next.load(std::memory_order_relaxed),
+              std::memory_order_release);
+            removed = n;
+            break;
+          }
+          prev = &n->next;
+          n = prev->load(std::memory_order_relaxed);
+        }
+        b.lock.unlock();
+      }
+
+      if (removed == nullptr)
+        return false;
+
+      count.fetch_sub(1, std::memory_order_relaxed);
+      e.delete_in_epoch(removed, sizeof(Node));
+      help_resize(e);
+      return true;
+    }
+
+    /**
+     * The number of entries.  This is only exact if no writes are running.
+     */
+    size_t size() const
+    {
+      return count.load(std::memory_order_relaxed);
+    }
+  };
+} // namespace verona::rt
@@ -2,25 +2,172 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../ds/ring.h"
+#include "deadlinequeue.h"
+#include "ioqueue.h"
 #include "mpmcq.h"
 #include "schedulerstats.h"
+#include "schedulinggroups.h"
 #include "work.h"
+#include "workdeque.h"
 #include "workstealingqueue.h"
 
 #include <atomic>
 #include <snmalloc/snmalloc.h>
 
+/**
+ * Number of sub-queues in each core's work stealing queue.  More sub-queues
+ * reduce contention from remote enqueues, fewer make `dequeue` and `is_empty`
+ * cheaper.  Set with the CMake option VERONA_CORE_QUEUE_COUNT.
+ */
+#ifndef VERONA_CORE_QUEUE_COUNT
+#  define VERONA_CORE_QUEUE_COUNT 4
+#endif
+
 namespace verona::rt
 {
+  static constexpr size_t CORE_QUEUE_COUNT = VERONA_CORE_QUEUE_COUNT;
+  static_assert(CORE_QUEUE_COUNT > 0, "A core requires at least one queue.");
+
+  /**
+   * Scheduling class of a behaviour.  High priority work is taken before
+   * normal work, but cannot starve it, see `SchedulerThread::get_work`.
+   * Critical work is high priority work that runs on the reserved cores,
+   * see `ThreadPool::set_reserved_core_count`, or is just high priority if
+   * there are none.
+   */
+  enum class Priority : uint8_t
+  {
+    Normal,
+    High,
+    Critical,
+  };
+
+  static constexpr size_t PRIORITY_COUNT = 3;
+
+  /**
+   * When a scheduler thread steals from another core even though it has work
+   * of its own, so that work on busy cores is not left behind, see
+   * `ThreadPool::set_fairness`.
+   */
+  enum class FairnessPolicy : uint8_t
+  {
+    /// Steal once each time the token has cycled through the queue, so the
+    /// period grows with the length of the queue.
+    Token,
+    /// Steal only when the victim's queue appears longer than this core's,
+    /// and more often the longer it is, see `Core::cycle_length`.
+    Adaptive,
+    /// Only steal when out of work.
+    Off,
+  };
+
+  /// Most work a scheduler thread keeps in `Core::local_q` before using
+  /// `Core::q`.
+  static constexpr size_t LOCAL_QUEUE_CAPACITY = 256;
+
+  /// Work sent from one core to another in share-nothing mode, see
+  /// `Core::inboxes`.
+  using Inbox = SPSCRing<Work*, 256>;
+
   class Core
   {
   public:
     size_t affinity = 0;
-    WorkStealingQueue<4> q;
+    /// Position of this core in the ring, from 0 to the number of cores.
+    size_t index = 0;
+    WorkStealingQueue<CORE_QUEUE_COUNT> q;
+    /**
+     * Work that the thread running this core has queued for itself, which
+     * it pushes and pops without read-modify-write operations.  Other cores
+     * steal from it, and it is moved to `q` at the end of each batch, see
+     * `SchedulerThread::get_work`.
+     */
+    WorkDeque<LOCAL_QUEUE_CAPACITY> local_q;
+    /// Queue for `Priority::High` work.  This is drained before `q`.
+    MPMCQ<Work> high_priority_q;
+    /// Work with a deadline, earliest first.  This is drained before
+    /// `high_priority_q`.
+    DeadlineQueue deadline_q;
+    /// Work of the scheduling groups other than the default, see
+    /// `ThreadPool::set_group_weight`.
+    SchedulingGroups groups;
+    /// I/O submitted by behaviours running on this core, see `IOQueue`.
+    IOQueue io;
     std::atomic<Core*> next{nullptr};
 
+    /// Topology information for the cpu this core is pinned to.
+    size_t numa_node = 0;
+    size_t physical_core = 0;
+    /// Set if the cpu is an efficiency core of a hybrid part, which runs
+    /// work more slowly than the others, see `Topology::capacity`.
+    bool efficiency = false;
+
+    /// Position of this core in the scheduler's barrier, see
+    /// `ThreadPool::init_barrier`.
+    size_t barrier_slot = 0;
+
+    /**
+     * Cores to steal from, ordered by distance from this core.  The first
+     * `local_victim_count` entries are this core, its SMT siblings, then
+     * the other cores on the same NUMA node.  The remaining entries are on
+     * remote NUMA nodes.
+     *
+     * This core is included as the first local victim, as stealing from
+     * ourselves is used to rotate the sub-queue that is stolen from.
+     */
+    Core** victims = nullptr;
+    size_t victim_count = 0;
+    size_t local_victim_count = 0;
+
     std::atomic<bool> should_steal_for_fairness{true};
 
+    /**
+     * Work taken from `q` in the last cycle of the token, as an estimate of
+     * the length of the queue for `FairnessPolicy::Adaptive`, or zero once
+     * the queue has run empty.
+     */
+    std::atomic<size_t> cycle_length{0};
+
+    /**
+     * Set if this core is not currently running work, see
+     * `ThreadPool::set_active_core_count`.  A parked core remains in the ring
+     * and can be stolen from, but is skipped when picking a core for new
+     * work.
+     */
+    std::atomic<bool> parked{false};
+
+    /**
+     * Set while the thread running this core is inside
+     * `ThreadPool::blocking_section`.  Like a parked core, a blocked core is
+     * skipped when picking a core for new work.
+     */
+    std::atomic<bool> blocked{false};
+
+    /**
+     * Set if this core only runs `Priority::Critical` work, see
+     * `ThreadPool::set_reserved_core_count`.  A reserved core is skipped
+     * when picking a core for other work, and only steals from, and is only
+     * stolen from by, other reserved cores.
+     */
+    bool reserved = false;
+
+    /**
+     * In share-nothing mode, one inbox for each core in the ring, indexed by
+     * the sending core's `index`, through which that core's thread sends
+     * work to this core, see `ThreadPool::set_share_nothing`.  Only this
+     * core's thread takes work from them.  Otherwise there are none.
+     */
+    Inbox* inboxes = nullptr;
+    size_t inbox_count = 0;
+
+    /**
+     * Set while the thread running this core is pausing in share-nothing
+     * mode, as only that thread can run work queued on this core, see
+     * `ThreadPool::wake_core`.
+     */
+    std::atomic<bool> pausing{false};
+
     /**
      * @brief Create a token work object.  It is affinitised to the `this`
      * core, and marks that stealing is required, for fairness.
@@ -45,11 +192,67 @@ namespace verona::rt
   public:
     Core() : q{} {}
 
+    /// Returns true if this core can currently run new work that is not
+    /// critical.
+    bool is_available()
+    {
+      return !reserved && !parked.load(std::memory_order_relaxed) &&
+        !blocked.load(std::memory_order_relaxed);
+    }
+
+    bool is_empty()
+    {
+      return q.is_empty() && local_q.is_empty() && high_priority_q.is_empty() &&
+        deadline_q.is_empty() && groups.is_empty() && inboxes_empty();
+    }
+
+    bool inboxes_empty()
+    {
+      for (size_t i = 0; i < inbox_count; i++)
+      {
+        if (!inboxes[i].is_empty())
+          return false;
+      }
+      return true;
+    }
+
+    /// Allocate an inbox for each of `count` sending cores, which must be
+    /// zero or the number of cores.  The inboxes must be empty.
+    void init_inboxes(size_t count)
+    {
+      assert(inboxes_empty());
+      if (count == inbox_count)
+        return;
+
+      delete[] inboxes;
+      inboxes = (count == 0) ? nullptr : new Inbox[count];
+      inbox_count = count;
+    }
+
     ~Core()
     {
       auto tw = token_work;
       token_work = nullptr;
       tw->run();
+
+      delete[] victims;
+      delete[] inboxes;
+    }
+
+    Core* local_victim(size_t index)
+    {
+      return victims[index % local_victim_count];
+    }
+
+    size_t remote_victim_count()
+    {
+      return victim_count - local_victim_count;
+    }
+
+    Core* remote_victim(size_t index)
+    {
+      assert(remote_victim_count() != 0);
+      return victims[local_victim_count + (index % remote_victim_count())];
     }
   };
 }
@@ -5,12 +5,127 @@
 #include "core.h"
 #include "pal/threading.h"
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
 #ifdef USE_SYSTEM_MONITOR
 #  include "sysmonitor.h"
 #endif
 
 namespace verona::rt
 {
+  /**
+   * How scheduler threads are pinned to cpus, see
+   * `ThreadPool::set_affinity_policy`.
+   */
+  enum class AffinityPolicy : uint8_t
+  {
+    /// Physical cores first, filling each NUMA node and package before the
+    /// next, so that threads share caches.
+    Compact,
+    /// Physical cores first, taking one from each NUMA node and package in
+    /// turn, to spread memory bandwidth and cache capacity.
+    Scatter,
+    /// The cpus in the list passed to `ThreadPool::set_affinity_cpus`, in
+    /// order.
+    Explicit,
+    /// No pinning, for when threads share cpus with other processes.
+    None,
+  };
+
+  /**
+   * Parse a list of cpu ids, in the format of `taskset` and sysfs, such as
+   * "0-3,8,10-11", into `out`.  Returns false if `list` is empty or
+   * malformed.
+   */
+  inline bool parse_cpu_list(const char* list, std::vector<size_t>& out)
+  {
+    // Longer ranges are taken to be mistakes.
+    static constexpr size_t MAX_CPU_RANGE = 1 << 16;
+    std::vector<size_t> cpus;
+    const char* p = list;
+    while (true)
+    {
+      char* end;
+      if ((*p < '0') || (*p > '9'))
+        return false;
+      size_t first = strtoul(p, &end, 10);
+      size_t last = first;
+      p = end;
+      if (*p == '-')
+      {
+        p++;
+        if ((*p < '0') || (*p > '9'))
+          return false;
+        last = strtoul(p, &end, 10);
+        p = end;
+        if ((last < first) || (last - first >= MAX_CPU_RANGE))
+          return false;
+      }
+
+      for (size_t cpu = first; cpu <= last; cpu++)
+        cpus.push_back(cpu);
+
+      if (*p == '\0')
+        break;
+      if (*p != ',')
+        return false;
+      p++;
+    }
+
+    out = std::move(cpus);
+    return true;
+  }
+
+  /**
+   * Parse an affinity policy, as "compact", "scatter", "none", or a list of
+   * cpus for `AffinityPolicy::Explicit`, see `parse_cpu_list`.  Returns
+   * false, changing neither, if `text` is none of these.
+   */
+  inline bool parse_affinity_policy(
+    const char* text, AffinityPolicy& policy, std::vector<size_t>& cpus)
+  {
+    if (strcmp(text, "compact") == 0)
+      policy = AffinityPolicy::Compact;
+    else if (strcmp(text, "scatter") == 0)
+      policy = AffinityPolicy::Scatter;
+    else if (strcmp(text, "none") == 0)
+      policy = AffinityPolicy::None;
+    else if (parse_cpu_list(text, cpus))
+      policy = AffinityPolicy::Explicit;
+    else
+      return false;
+    return true;
+  }
+
+  /**
+   * The cpus isolated from the kernel's scheduler, with the `isolcpus` boot
+   * parameter, into `out`.  Returns false if there are none, or on
+   * platforms other than Linux.
+   */
+  inline bool isolated_cpus(std::vector<size_t>& out)
+  {
+#if defined(__linux__)
+    FILE* f = fopen("/sys/devices/system/cpu/isolated", "r");
+    if (f == nullptr)
+      return false;
+
+    char list[4096];
+    bool read = fgets(list, sizeof(list), f) != nullptr;
+    fclose(f);
+    if (!read)
+      return false;
+
+    list[strcspn(list, "\n")] = '\0';
+    return parse_cpu_list(list, out);
+#else
+    snmalloc::UNUSED(out);
+    return false;
+#endif
+  }
+
   template<class P>
   class CorePool
   {
@@ -24,25 +139,89 @@ namespace verona::rt
     inline static Singleton<Topology, &Topology::init> topology;
     Core* first_core = nullptr;
     size_t core_count = 0;
+    /// The last `reserved_count` cores in the ring, from `first_reserved`,
+    /// are reserved, see `Core::reserved`.
+    size_t reserved_count = 0;
+    Core* first_reserved = nullptr;
 
   public:
     constexpr CorePool() = default;
 
-    void init(size_t count)
+    /**
+     * Returns the number of cpus available to this process, taking into
+     * account its affinity mask and any CPU quota.
+     */
+    static size_t available_cpus()
+    {
+      return topology.get().available();
+    }
+
+    /**
+     * Create a ring of `count` cores, placed on cpus by `policy`, the last
+     * `reserved` of which are reserved for critical work.  For
+     * `AffinityPolicy::Explicit`, `cpus` lists the cpus, and is reused from
+     * the start if there are more cores than cpus.
+     */
+    void init(
+      size_t count,
+      AffinityPolicy policy = AffinityPolicy::Compact,
+      const std::vector<size_t>& cpus = {},
+      size_t reserved = 0)
     {
+      assert(reserved < count);
       core_count = count;
+      reserved_count = reserved;
+      std::vector<size_t> order;
+      if (policy == AffinityPolicy::Scatter)
+        order = topology.get().scatter_order();
+      if ((policy == AffinityPolicy::Explicit) && cpus.empty())
+        policy = AffinityPolicy::Compact;
+
       // TODO mjp: review allocation.
       first_core = new Core;
       Core* t = first_core;
 
+      // The topology is sorted so that physical cores come before
+      // hyperthreads, and cores are grouped by NUMA node and package.  The
+      // compact policy walks it in order, so that neighbouring cores in the
+      // ring are close in the machine.
+      size_t index = 0;
       while (true)
       {
-        t->affinity = topology.get().get(count);
-        if (count > 1)
+        size_t cpu = index;
+        if (policy == AffinityPolicy::Scatter)
+          cpu = order[index % order.size()];
+        else if (policy == AffinityPolicy::Explicit)
+          cpu = topology.get().index_of(cpus[index % cpus.size()]);
+
+        if (cpu < topology.get().size())
+        {
+          t->affinity = topology.get().get(cpu);
+          t->numa_node = topology.get().numa_node(cpu);
+          t->physical_core = topology.get().physical_core(cpu);
+          t->efficiency =
+            topology.get().capacity(cpu) < Topology::EFFICIENCY_CAPACITY;
+        }
+        else
+        {
+          // An explicit cpu outside this process's affinity mask, which the
+          // topology knows nothing about.
+          t->affinity = cpus[index % cpus.size()];
+          t->numa_node = 0;
+          t->physical_core = t->affinity;
+          t->efficiency = false;
+        }
+        if (policy == AffinityPolicy::None)
+          t->affinity = (size_t)-1;
+        t->index = index;
+        t->reserved = index >= count - reserved;
+        if (index == count - reserved)
+          first_reserved = t;
+        index++;
+        if (index < count)
         {
           t->next = new Core;
           t = t->next;
-          count--;
         }
         else
         {
@@ -50,8 +229,63 @@ namespace verona::rt
           break;
         }
       }
+
+      init_victims();
+    }
+
+  private:
+    /**
+     * Build the tiered victim list of each core.  Each tier is in ring order
+     * starting after the core, so that neighbouring cores do not all pick the
+     * same first victim.  Reserved cores and the others only steal from
+     * their own kind.
+     */
+    void init_victims()
+    {
+      Core* c = first_core;
+      do
+      {
+        c->victims = new Core*[core_count];
+        size_t index = 0;
+        c->victims[index++] = c;
+
+        // SMT siblings.
+        for (Core* v = c->next; v != c; v = v->next)
+        {
+          if (
+            v->reserved == c->reserved && v->numa_node == c->numa_node &&
+            v->physical_core == c->physical_core)
+            c->victims[index++] = v;
+        }
+
+        // Rest of the NUMA node.
+        for (Core* v = c->next; v != c; v = v->next)
+        {
+          if (
+            v->reserved == c->reserved && v->numa_node == c->numa_node &&
+            v->physical_core != c->physical_core)
+            c->victims[index++] = v;
+        }
+
+        c->local_victim_count = index;
+
+        // Remote NUMA nodes.
+        for (Core* v = c->next; v != c; v = v->next)
+        {
+          if (v->reserved == c->reserved && v->numa_node != c->numa_node)
+            c->victims[index++] = v;
+        }
+
+        assert(
+          index ==
+          (c->reserved ? reserved_count : core_count - reserved_count));
+        c->victim_count = index;
+        c = c->next;
+      } while (c != first_core);
     }
 
+  public:
+
     void clear()
     {
       if (first_core == nullptr)
@@ -70,6 +304,8 @@ namespace verona::rt
       first_core = nullptr;
       assert(count == core_count);
       core_count = 0;
+      reserved_count = 0;
+      first_reserved = nullptr;
     }
 
 #ifndef NDEBUG
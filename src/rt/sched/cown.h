@@ -54,27 +54,99 @@ namespace verona::rt
       NOT_LAST
     };
 
+    /// Number of stripes used by a scalable count.
+    static constexpr size_t STRIPE_COUNT = 16;
+
   private:
     /**
      * Even numbers 2n, signify n readers are reading the cown.
      * Odd numbers 2n+1, signify n readers are reading the cown, and there is a
      * writer waiting.
+     *
+     * For a scalable count, n is instead the number of stripes with readers.
      */
     std::atomic<size_t> count{0};
 
+    struct alignas(64) Stripe
+    {
+      std::atomic<size_t> readers{0};
+    };
+
+    /**
+     * If set, this is a scalable count in the style of a scalable non-zero
+     * indicator.  Readers are counted in a stripe picked from their identity,
+     * and only a stripe becoming non-empty or empty updates `count`.  Readers
+     * on different stripes do not contend, and the `try_write` and last
+     * reader handshake on `count` is unchanged.
+     */
+    Stripe* stripes = nullptr;
+
+    static Stripe& stripe(Stripe* stripes, const void* reader)
+    {
+      auto h = reinterpret_cast<uintptr_t>(reader) >> 4;
+      return stripes[(h ^ (h >> 7)) % STRIPE_COUNT];
+    }
+
   public:
+    ReadRefCount() = default;
+
+    ReadRefCount(const ReadRefCount&) = delete;
+
+    ~ReadRefCount()
+    {
+      if (stripes != nullptr)
+        heap::dealloc(stripes, STRIPE_COUNT * sizeof(Stripe));
+    }
+
+    /**
+     * Switch to a scalable count.  Must be called before the first reader is
+     * added.
+     */
+    void make_scalable()
+    {
+      assert(count.load() == 0);
+      assert(stripes == nullptr);
+      auto p = static_cast<Stripe*>(heap::alloc(STRIPE_COUNT * sizeof(Stripe)));
+      for (size_t i = 0; i < STRIPE_COUNT; i++)
+        new (&p[i]) Stripe();
+      stripes = p;
+    }
+
+    bool is_scalable()
+    {
+      return stripes != nullptr;
+    }
+
     // true means first reader is added, false otherwise
-    bool add_read(int readers = 1)
+    //
+    // For a scalable count, `reader` identifies the readers being added, and
+    // the same value must be passed to `release_read` for each of them.
+    bool add_read(int readers = 1, const void* reader = nullptr)
     {
       // Once a writer is waiting, no new readers can be added.
       assert(count % 2 == 0);
-      return count.fetch_add(readers * 2, std::memory_order_release) == 0;
+      size_t add = readers * 2;
+      if (stripes != nullptr)
+      {
+        if (
+          stripe(stripes, reader)
+            .readers.fetch_add(readers, std::memory_order_acq_rel) != 0)
+          return false;
+        add = 2;
+      }
+      return count.fetch_add(add, std::memory_order_release) == 0;
     }
 
     // Returns whether this is the last reader, and if there is a writer
     // waiting.
-    STATUS release_read()
+    STATUS release_read(const void* reader = nullptr)
     {
+      if (
+        (stripes != nullptr) &&
+        (stripe(stripes, reader)
+           .readers.fetch_sub(1, std::memory_order_acq_rel) != 1))
+        return NOT_LAST;
+
       auto old = count.fetch_sub(2, std::memory_order_acquire);
       if (old > 3)
         return NOT_LAST;
@@ -123,17 +195,46 @@ namespace verona::rt
   struct Slot;
   struct BehaviourCore;
 
+  /**
+   * The state of a cown that only behaviours reading it use, see
+   * `ReadableCown`.
+   */
+  struct CownReaders
+  {
+    /**
+     * Next writer in the queue
+     */
+    std::atomic<BehaviourCore*> next_writer{nullptr};
+
+    /*
+     * Cown's read ref count.
+     * Bottom bit is used to signal a waiting write.
+     * Remaining bits are the count.
+     */
+    ReadRefCount read_ref_count;
+  };
+
+  /**
+   * A cown that is only ever written.  Behaviours must not acquire it for
+   * reading, so it has no `CownReaders`, and is three words smaller than a
+   * `ReadableCown`.  `VCown` chooses between the two, see `write_only_cown`
+   * for cowns made with `make_cown`.
+   */
   class Cown : public Shared
   {
   public:
     Cown() {}
 
+  protected:
+    Cown(bool readable) : readable(readable) {}
+
   private:
     friend Core;
     friend Slot;
     template<typename T>
     friend class Promise;
     friend struct BehaviourCore;
+    friend class CycleCollector;
 
     template<typename T>
     friend class Noticeboard;
@@ -143,26 +244,295 @@ namespace verona::rt
      */
     std::atomic<Slot*> last_slot{nullptr};
 
+#ifdef USE_QUEUE_DEPTH
     /**
-     * Next writer in the queue
+     * Number of behaviours queued on, or running on, this cown, see
+     * `queue_depth`.
      */
-    std::atomic<BehaviourCore*> next_writer{nullptr};
+    std::atomic<size_t> depth{0};
+#endif
 
-    /*
-     * Cown's read ref count.
-     * Bottom bit is used to signal a waiting write.
-     * Remaining bits are the count.
+    static constexpr size_t CACHE_LINE = 64;
+
+    /**
+     * Number of consecutive writes on a core other than `home_core` before
+     * the cown migrates to that core.
      */
-    ReadRefCount read_ref_count;
+    static constexpr size_t HOME_CORE_HYSTERESIS = 4;
+
+    /**
+     * Core this cown has recently been written on.  Only used if
+     * `Scheduler::set_cown_home_affinity` is enabled.  These fields are only
+     * accessed by the writer that holds the cown, so are not atomic.
+     *
+     * In share-nothing mode, this is instead the core the cown is bound to,
+     * which does not change, see `ThreadPool::set_share_nothing`.
+     */
+    Core* home_core = Scheduler::home_for_new_cown();
+    uint32_t away_count = 0;
+
+    /**
+     * Whether this is a `ReadableCown`.  Kept in the same word as
+     * `away_count`, so that a `Cown` is no larger for it.
+     */
+    bool readable = false;
+
+    /**
+     * Set while this cown is in `cycle_candidates`, or once `CycleCollector`
+     * has found it unreachable.  Also kept in the same word as `away_count`.
+     */
+    std::atomic<bool> cycle_candidate{false};
+
+    /**
+     * Number of cache lines, from the start of the allocation, that are
+     * prefetched before a behaviour on this cown runs, see `prefetch`.
+     * Also kept in the same word as `away_count`.
+     */
+    uint8_t prefetch_lines = DEFAULT_PREFETCH_LINES;
+
+    /**
+     * Scheduling group of the behaviours on this cown, see `set_group`.
+     * Also kept in the same word as `away_count`.
+     */
+    uint8_t group = 0;
+
+    /// Set while `CycleCollector` is enabled.
+    static inline std::atomic<bool> track_cycles{false};
+
+    /**
+     * Cowns that have been released and still had other references, so may
+     * be in an unreachable cycle.  Each holds a weak reference.
+     */
+    static inline snmalloc::FlagWord cycle_candidates_lock;
+    static inline std::vector<Cown*> cycle_candidates;
+
+    /**
+     * Record `o`, which is being released, as a candidate for
+     * `CycleCollector`, unless it is already one, or this is its last
+     * reference.
+     */
+    static void suspect(Cown* o)
+    {
+      auto rc = o->get_header().rc.load(std::memory_order_relaxed) >> SHIFT;
+      if (
+        (rc <= 1) ||
+        o->cycle_candidate.exchange(true, std::memory_order_acq_rel))
+        return;
+
+      o->weak_acquire();
+      snmalloc::FlagLock l(cycle_candidates_lock);
+      cycle_candidates.push_back(o);
+    }
+
+    /**
+     * Number of order keys a thread takes from the global counter at once.
+     */
+    static constexpr uint64_t ORDER_KEY_BLOCK = 1 << 12;
+
+    /**
+     * Key giving the order in which behaviours acquire this cown relative to
+     * others, see `BehaviourCore::cown_less`.
+     */
+    uint64_t order_key = next_order_key();
+
+    /**
+     * Allocate an order key.  Threads take blocks of keys so that creating a
+     * cown does not contend on a global counter, and cowns created together
+     * on a thread are adjacent in the acquire order.
+     */
+    static uint64_t next_order_key()
+    {
+      static std::atomic<uint64_t> next_block{0};
+      static thread_local uint64_t next = 0;
+      static thread_local uint64_t end = 0;
+
+      if (next == end)
+      {
+        next = next_block.fetch_add(ORDER_KEY_BLOCK, std::memory_order_relaxed);
+        end = next + ORDER_KEY_BLOCK;
+      }
+
+      return next++;
+    }
+
+    /**
+     * Record that a writer has run on `current`, and return the cown's home
+     * core.  The home core only moves after `HOME_CORE_HYSTERESIS`
+     * consecutive writes elsewhere, so that occasional steals do not drag the
+     * cown's data around the machine.
+     */
+    Core* note_run_on(Core* current)
+    {
+      if (
+        (home_core == nullptr) || (home_core == current) ||
+        (++away_count >= HOME_CORE_HYSTERESIS))
+      {
+        home_core = current;
+        away_count = 0;
+      }
+
+      return home_core;
+    }
+
+    /**
+     * The reader state of a `ReadableCown`.
+     */
+    inline CownReaders& readers();
+
+    /**
+     * Check that a writer with no predecessor in the queue can proceed, see
+     * `ReadRefCount::try_write`.  A write-only cown never has readers.
+     */
+    bool try_write()
+    {
+      return !readable || readers().read_ref_count.try_write();
+    }
 
   public:
+    /**
+     * Release a strong reference to `o`, see `Shared::release`.  While
+     * `CycleCollector` is enabled, this also records `o` as a candidate for
+     * it, if other references remain.
+     */
+    static void release(Cown* o)
+    {
+      if (SNMALLOC_UNLIKELY(track_cycles.load(std::memory_order_relaxed)))
+        suspect(o);
+      Shared::release(o);
+    }
+
+    uint64_t get_order_key() const
+    {
+      return order_key;
+    }
+
+    /**
+     * Override the key that orders this cown in multi-cown acquires, for
+     * instance so that the shards of a structure are acquired in shard order.
+     * Cowns with equal keys are ordered by identity.
+     *
+     * This must only be called before the cown is first used in a behaviour
+     * or a cown_set, as all threads must agree on the order to avoid
+     * deadlock.
+     */
+    void set_order_key(uint64_t key)
+    {
+      order_key = key;
+    }
+
+    /**
+     * In share-nothing mode, bind this cown to `core`, so that behaviours
+     * that only use cowns bound to `core` run there, see
+     * `ThreadPool::set_share_nothing`.  By default a cown is bound to the
+     * core it was created on.
+     *
+     * This must only be called before the cown is first used in a
+     * behaviour.
+     */
+    void set_home_core(Core* core)
+    {
+      home_core = core;
+    }
+
+    /**
+     * Count the readers of this cown in striped counters, so that readers on
+     * many cores do not all contend on one cache line.  This costs a
+     * kilobyte per cown, so is intended for read-mostly cowns shared by
+     * many cores.  Must be called before the cown is first used, and only
+     * on a `ReadableCown`.
+     */
+    void enable_scalable_readers()
+    {
+      readers().read_ref_count.make_scalable();
+    }
+
+    /**
+     * Put this cown in scheduling group `group`, so that behaviours on it
+     * share the cores with those of the other groups by the groups'
+     * weights, see `ThreadPool::set_group_weight`.  Cowns start in group 0,
+     * the default.  A behaviour on cowns of several groups is in the group
+     * of the first of them in its slots.
+     *
+     * This must only be called before the cown is first used in a
+     * behaviour.
+     */
+    void set_group(size_t g)
+    {
+      assert(g < SCHEDULING_GROUPS);
+      group = (uint8_t)g;
+      if (g != 0)
+        Scheduler::enable_scheduling_groups();
+    }
+
+    size_t get_group() const
+    {
+      return group;
+    }
+
+    /// Cache lines prefetched by default, the header and the line after it.
+    static constexpr uint8_t DEFAULT_PREFETCH_LINES = 2;
+
+    /**
+     * Set how many cache lines of this cown, from the start of its
+     * allocation, `prefetch` fetches, so that a large payload whose hot
+     * fields are further in is loaded too.  At most 255.
+     */
+    void set_prefetch_lines(size_t lines)
+    {
+      assert(lines <= UINT8_MAX);
+      prefetch_lines = (uint8_t)lines;
+    }
+
+    /**
+     * Start loading this cown into the cache, ahead of a behaviour on it
+     * running, see `BehaviourCore::prefetch`.
+     */
+    void prefetch() const
+    {
+      auto start = real_start();
+      for (size_t i = 0; i < prefetch_lines; i++)
+        Aal::prefetch(start + (i * CACHE_LINE));
+    }
+
+    bool is_readable() const
+    {
+      return readable;
+    }
+
+#ifdef USE_QUEUE_DEPTH
+    /**
+     * Approximate number of behaviours queued on, or running on, this cown.
+     * Behaviours are counted from when they are scheduled until they finish,
+     * or release the cown early.  Notifications are not counted.
+     *
+     * Counting costs two atomic updates of each cown per behaviour, and a
+     * word per cown, so it is only built with `USE_QUEUE_DEPTH`.
+     */
+    size_t queue_depth()
+    {
+      return depth.load(std::memory_order_relaxed);
+    }
+#endif
+
+    /**
+     * Returns true if no behaviour is queued on, or running on, this cown.
+     * Behaviours may be scheduled concurrently, so this is only a snapshot.
+     */
+    bool is_idle()
+    {
+      return last_slot.load(std::memory_order_acquire) == nullptr;
+    }
+
     inline friend Logging::SysLog& operator<<(Logging::SysLog& os, Cown& c)
     {
-      return os << " Cown: " << &c
-                << " Last slot: " << c.last_slot.load(std::memory_order_relaxed)
-                << " Next writer: "
-                << c.next_writer.load(std::memory_order_relaxed)
-                << " Reader count: " << c.read_ref_count.get_count() << " ";
+      os << " Cown: " << &c
+         << " Last slot: " << c.last_slot.load(std::memory_order_relaxed);
+      if (!c.readable)
+        return os << " Write only ";
+      return os << " Next writer: "
+                << c.readers().next_writer.load(std::memory_order_relaxed)
+                << " Reader count: "
+                << c.readers().read_ref_count.get_count() << " ";
     }
 
 #ifdef USE_SYSTEMATIC_TESTING_WEAK_NOTICEBOARDS
@@ -191,4 +561,23 @@ namespace verona::rt
 
 #endif
   };
+
+  /**
+   * A cown that behaviours may acquire for reading as well as writing.
+   */
+  class ReadableCown : public Cown
+  {
+    friend Cown;
+
+    CownReaders reader_state;
+
+  public:
+    ReadableCown() : Cown(true) {}
+  };
+
+  inline CownReaders& Cown::readers()
+  {
+    assert(readable);
+    return static_cast<ReadableCown*>(this)->reader_state;
+  }
 } // namespace verona::rt
@@ -0,0 +1,270 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "concurrentmap.h"
+#include "schedulerstats.h"
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(USE_COWN_PROFILE) && !defined(USE_QUEUE_DEPTH)
+#  error "USE_COWN_PROFILE samples queue depths, so needs USE_QUEUE_DEPTH"
+#endif
+#include <iostream>
+#include <snmalloc/snmalloc.h>
+#include <unordered_map>
+#include <vector>
+
+namespace verona::rt
+{
+  class Cown;
+
+  /**
+   * Contention profile of cowns, enabled by building with `USE_COWN_PROFILE`,
+   * to find the cowns that are worth sharding.
+   *
+   * One in every `SAMPLE_PERIOD` enqueues on a thread records, for the cown,
+   * the number of behaviours queued on it, see `Cown::queue_depth`, and
+   * whether the queue changes between readers and writers.  One in every
+   * `SAMPLE_PERIOD` behaviours records how long it held each cown it writes.
+   *
+   * Each thread records into its own fixed size table, so recording takes no
+   * locks and does not contend.  A cown that does not fit in the table is
+   * counted as dropped.  `dump` merges the tables of all threads, and should
+   * be called once they have stopped, for instance at teardown, where the
+   * runtime calls it.  Cowns are identified by address, and by a name if one
+   * is given with `set_name`, so a cown that is freed and whose memory is
+   * reused will merge with its successor.
+   */
+  class CownProfile : public snmalloc::Pooled<CownProfile>
+  {
+  public:
+    static constexpr size_t SAMPLE_PERIOD = 16;
+
+  private:
+    static constexpr size_t TABLE_SIZE = 256;
+    static constexpr size_t MAX_PROBE = 8;
+
+    /**
+     * The counts for a cown.  Only the owning thread writes an entry, but
+     * `dump` may read it, so the fields are updated with relaxed loads and
+     * stores.
+     */
+    struct Entry
+    {
+      std::atomic<Cown*> cown{nullptr};
+      /// Sampled enqueues, and the behaviours queued at each, in total and
+      /// at most.
+      std::atomic<size_t> enqueues{0};
+      std::atomic<size_t> waiters{0};
+      std::atomic<size_t> max_waiters{0};
+      /// Enqueues of a writer behind a reader, and of a reader behind a
+      /// writer.
+      std::atomic<size_t> to_writer{0};
+      std::atomic<size_t> to_reader{0};
+      /// Sampled behaviours that wrote the cown, and the ticks they held it.
+      std::atomic<size_t> writes{0};
+      std::atomic<uint64_t> write_ticks{0};
+    };
+
+    /// The merged counts for a cown in `dump`.
+    struct Totals
+    {
+      Cown* cown;
+      size_t enqueues;
+      size_t waiters;
+      size_t max_waiters;
+      size_t to_writer;
+      size_t to_reader;
+      size_t writes;
+      uint64_t write_ticks;
+    };
+
+    Entry table[TABLE_SIZE];
+    std::atomic<size_t> dropped{0};
+
+    template<typename T>
+    static void add(std::atomic<T>& field, T n)
+    {
+      field.store(
+        field.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    Entry* find(Cown* cown)
+    {
+      auto start = std::hash<Cown*>{}(cown);
+      for (size_t i = 0; i < MAX_PROBE; i++)
+      {
+        auto& e = table[(start + i) % TABLE_SIZE];
+        auto c = e.cown.load(std::memory_order_relaxed);
+        if (c == cown)
+          return &e;
+        if (c == nullptr)
+        {
+          e.cown.store(cown, std::memory_order_relaxed);
+          return &e;
+        }
+      }
+
+      add<size_t>(dropped, 1);
+      return nullptr;
+    }
+
+    static CownProfile* local();
+
+    static ConcurrentMap<Cown*, const char*>& names()
+    {
+      static ConcurrentMap<Cown*, const char*> names;
+      return names;
+    }
+
+  public:
+    /**
+     * Returns true once every `SAMPLE_PERIOD` calls on this thread.
+     */
+    static bool sample()
+    {
+      return SchedulerStats::sample(SAMPLE_PERIOD);
+    }
+
+    /**
+     * Record that a behaviour was enqueued on `cown` with `waiters`
+     * behaviours queued on it.  `writer` is set if the behaviour writes the
+     * cown, and `changed` if the behaviour before it in the queue did not.
+     */
+    static void enqueued(Cown* cown, size_t waiters, bool writer, bool changed)
+    {
+      auto e = local()->find(cown);
+      if (e == nullptr)
+        return;
+
+      add<size_t>(e->enqueues, 1);
+      add<size_t>(e->waiters, waiters);
+      if (waiters > e->max_waiters.load(std::memory_order_relaxed))
+        e->max_waiters.store(waiters, std::memory_order_relaxed);
+      if (changed)
+        add<size_t>(writer ? e->to_writer : e->to_reader, 1);
+    }
+
+    /**
+     * Record that a behaviour held `cown` for writing for `ticks`.
+     */
+    static void held(Cown* cown, uint64_t ticks)
+    {
+      auto e = local()->find(cown);
+      if (e == nullptr)
+        return;
+
+      add<size_t>(e->writes, 1);
+      add<uint64_t>(e->write_ticks, ticks);
+    }
+
+    /**
+     * Name `cown` in the output of `dump`.  `name` must outlive the profile.
+     */
+    static void set_name(Cown* cown, const char* name)
+    {
+      names().insert(cown, name);
+    }
+
+    /**
+     * Write the merged profile of all threads as CSV, most contended cowns
+     * first, and clear it.
+     */
+    static void dump(std::ostream& o);
+  };
+
+  using CownProfilePool = snmalloc::Pool<CownProfile, snmalloc::Alloc::Config>;
+
+  inline void CownProfile::dump(std::ostream& o)
+  {
+    std::unordered_map<Cown*, Totals> merged;
+    size_t dropped_total = 0;
+
+    for (auto p = CownProfilePool::iterate(); p != nullptr;
+         p = CownProfilePool::iterate(p))
+    {
+      dropped_total += p->dropped.exchange(0, std::memory_order_relaxed);
+
+      for (auto& e : p->table)
+      {
+        auto cown = e.cown.exchange(nullptr, std::memory_order_relaxed);
+        if (cown == nullptr)
+          continue;
+
+        auto& t =
+          merged.try_emplace(cown, Totals{cown, 0, 0, 0, 0, 0, 0, 0})
+            .first->second;
+        t.enqueues += e.enqueues.exchange(0, std::memory_order_relaxed);
+        t.waiters += e.waiters.exchange(0, std::memory_order_relaxed);
+        auto max_waiters = e.max_waiters.exchange(0, std::memory_order_relaxed);
+        t.max_waiters = std::max(t.max_waiters, max_waiters);
+        t.to_writer += e.to_writer.exchange(0, std::memory_order_relaxed);
+        t.to_reader += e.to_reader.exchange(0, std::memory_order_relaxed);
+        t.writes += e.writes.exchange(0, std::memory_order_relaxed);
+        t.write_ticks += e.write_ticks.exchange(0, std::memory_order_relaxed);
+      }
+    }
+
+    std::vector<Totals> sorted;
+    for (auto& [cown, t] : merged)
+      sorted.push_back(t);
+    std::sort(sorted.begin(), sorted.end(), [](auto& a, auto& b) {
+      return a.waiters > b.waiters;
+    });
+
+    CSVStream csv(o);
+    csv << "CownProfile"
+        << "Cown"
+        << "Name"
+        << "Enqueues"
+        << "Waiters"
+        << "Max waiters"
+        << "To writer"
+        << "To reader"
+        << "Writes"
+        << "Write ticks" << std::endl;
+
+    for (auto& t : sorted)
+    {
+      const char* name = "";
+      names().find(t.cown, name);
+      csv << "CownProfile" << t.cown << name << t.enqueues << t.waiters
+          << t.max_waiters << t.to_writer << t.to_reader << t.writes
+          << t.write_ticks << std::endl;
+    }
+
+    if (dropped_total != 0)
+      csv << "CownProfile"
+          << "Dropped" << dropped_total << std::endl;
+  }
+
+  /**
+   * Handles lifetime management of the profile table of a thread.
+   */
+  class ThreadLocalCownProfile
+  {
+  private:
+    friend class CownProfile;
+    CownProfile* ptr;
+
+    ThreadLocalCownProfile()
+    {
+      ptr = CownProfilePool::acquire();
+    }
+
+    ~ThreadLocalCownProfile()
+    {
+      // The counts stay in the table, for `dump` or the next thread to use
+      // it.
+      CownProfilePool::release(ptr);
+    }
+  };
+
+  inline CownProfile* CownProfile::local()
+  {
+    static thread_local ThreadLocalCownProfile thread_local_profile;
+    return thread_local_profile.ptr;
+  }
+} // namespace verona::rt
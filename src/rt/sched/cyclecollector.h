@@ -0,0 +1,491 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../region/region.h"
+#include "behaviour.h"
+#include "cown.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace verona::rt
+{
+  /**
+   * Collects cowns that refer to each other in cycles that nothing else
+   * refers to, which reference counting alone never frees.
+   *
+   * While enabled, a cown released by `Cown::release` that still has other
+   * references is recorded as a candidate.  `collect` then checks each
+   * candidate by trial deletion: it finds the cowns reachable from the
+   * candidate, and counts the references that the data of those cowns holds
+   * on each other.  A cown with any other reference, strong or weak, or a
+   * behaviour queued on it, is live, and so is every cown it reaches.  The
+   * rest are unreachable, and their data is released.
+   *
+   * The data of a cown is traced as `Shared::release_data` releases it: the
+   * cowns it refers to directly, and those held by the regions it owns.  A
+   * trace or arena region holds a cown through its remembered set, and an
+   * rc region through each pointer to it.  Immutable objects are not traced,
+   * so a cown that is reachable through one is never collected.  Each shared
+   * object reached must be a cown.
+   *
+   * The checks run in behaviours on the cowns being checked, so that their
+   * data does not change while it is traced.  Each behaviour is a round that
+   * follows the references one step further from the candidate, up to
+   * `MAX_COWNS` cowns, and the rest of the work is background work, see
+   * `Scheduler::schedule_background`.  Nothing else is stopped.
+   *
+   * The finalisers of collected cowns run as usual, and must not publish the
+   * cowns that the data refers to.
+   */
+  class CycleCollector
+  {
+    /// Most cowns checked together.
+    static constexpr size_t MAX_COWNS = 1024;
+
+    /// Set while a `collect` is in progress, see `in_progress`.
+    static inline std::atomic<bool> collecting{false};
+
+    /// Checks started by the last `collect`, see `debug_checks`.
+    static inline std::atomic<size_t> checks{0};
+
+    /// The candidates that a `collect` has yet to check, each with a weak
+    /// reference.
+    struct Pass
+    {
+      std::vector<Cown*> candidates;
+    };
+
+    /// The cowns found so far by the check of one candidate.
+    struct Check
+    {
+      Pass* pass;
+      std::vector<Cown*> cowns;
+      std::unordered_map<Object*, size_t> index;
+
+      void add(Cown* c)
+      {
+        index.emplace(c, cowns.size());
+        cowns.push_back(c);
+      }
+    };
+
+    static size_t strong_count(Cown* c)
+    {
+      return c->get_header().rc.load(std::memory_order_acquire) >>
+        Object::SHIFT;
+    }
+
+    /// The header bits of a cown with `count` strong references.
+    static size_t count_bits(size_t count)
+    {
+      return (size_t)Object::SHARED + (count * Object::ONE_RC);
+    }
+
+    /**
+     * Call `f` on each cown that the data of `c` holds a reference count on,
+     * once for each count.
+     */
+    template<typename F>
+    static void trace_data(Cown* c, F f)
+    {
+      ObjectStack fields;
+      c->trace(fields);
+
+      ObjectStack isos;
+      while (!fields.empty())
+      {
+        Object* o = fields.pop();
+        if (o->get_class() == Object::SHARED)
+          f(o);
+        else if (o->get_class() == Object::ISO)
+          isos.push(o);
+      }
+
+      std::unordered_set<Object*> seen;
+      while (!isos.empty())
+      {
+        Object* iso = isos.pop();
+        RegionBase* r = iso->get_region();
+        bool rc = Region::get_type(r) == RegionType::Rc;
+        if (!rc)
+        {
+          r->RememberedSet::for_each([&f](Object* o) {
+            if (o->get_class() == Object::SHARED)
+              f(o);
+          });
+        }
+
+        // Find the regions that this one owns, and in an rc region, the
+        // pointers to cowns.
+        ObjectStack dfs;
+        dfs.push(iso);
+        seen.insert(iso);
+        while (!dfs.empty())
+        {
+          ObjectStack targets;
+          dfs.pop()->trace(targets);
+          while (!targets.empty())
+          {
+            Object* p = targets.pop();
+            switch (p->get_class())
+            {
+              case Object::SHARED:
+                if (rc)
+                  f(p);
+                break;
+
+              case Object::ISO:
+                if (seen.insert(p).second)
+                  isos.push(p);
+                break;
+
+              case Object::UNMARKED:
+              case Object::MARKED:
+                if (seen.insert(p).second)
+                  dfs.push(p);
+                break;
+
+              default:
+                break;
+            }
+          }
+        }
+      }
+    }
+
+    static void schedule_step(Pass* pass)
+    {
+      Scheduler::schedule_background(Closure::make([pass](Work*) {
+        step(pass);
+        return true;
+      }));
+    }
+
+    /**
+     * Start the check of the next candidate of `pass` that is still alive,
+     * or end the pass.
+     */
+    static void step(Pass* pass)
+    {
+      while (!pass->candidates.empty())
+      {
+        Cown* c = pass->candidates.back();
+        pass->candidates.pop_back();
+
+        // The cown stays marked while it is checked, see `join`.
+        bool alive = c->acquire_strong_from_weak();
+        if (!alive)
+          c->cycle_candidate.store(false, std::memory_order_release);
+        c->weak_release();
+        if (!alive)
+          continue;
+
+        checks.fetch_add(1, std::memory_order_relaxed);
+        auto* check = new Check{pass, {}, {}};
+        check->add(c);
+        schedule_round(check);
+        return;
+      }
+
+      delete pass;
+      collecting.store(false, std::memory_order_release);
+    }
+
+    /// Remove one entry for `c` from `candidates`, if it has one.
+    static bool take_candidate(std::vector<Cown*>& candidates, Cown* c)
+    {
+      auto it = std::find(candidates.begin(), candidates.end(), c);
+      if (it == candidates.end())
+        return false;
+
+      *it = candidates.back();
+      candidates.pop_back();
+      return true;
+    }
+
+    /**
+     * Add `c`, on which `check` holds a strong reference, to `check`.  If it
+     * is a candidate, it is taken out of the candidates, and its weak
+     * reference dropped, as that would make it look reachable, and so fail
+     * the check.  It stays marked as a candidate until the check ends, so
+     * that it is not recorded again meanwhile.
+     *
+     * A cown that is being recorded concurrently may not be found yet, in
+     * which case its weak reference remains, and a later check collects it.
+     */
+    static void join(Check* check, Cown* c)
+    {
+      check->add(c);
+      if (!c->cycle_candidate.exchange(true, std::memory_order_acq_rel))
+        return;
+
+      if (!take_candidate(check->pass->candidates, c))
+      {
+        snmalloc::FlagLock l(Cown::cycle_candidates_lock);
+        if (!take_candidate(Cown::cycle_candidates, c))
+          return;
+      }
+      c->weak_release();
+    }
+
+    /// Schedule the next round of `check`, which takes over a strong
+    /// reference to each of its cowns.
+    static void schedule_round(Check* check)
+    {
+      Behaviour::schedule<YesTransfer>(
+        check->cowns.size(), check->cowns.data(), [check]() { round(check); });
+    }
+
+    /**
+     * Trace the data of the cowns of `check`, which this behaviour holds.
+     * If this finds more cowns, then check again with them, otherwise decide
+     * which cowns are unreachable.
+     */
+    static void round(Check* check)
+    {
+      size_t count = check->cowns.size();
+
+      // For each cown, the indices of the cowns its data holds references
+      // on, once for each reference.
+      std::vector<std::vector<size_t>> edges(count);
+      bool grown = false;
+      for (size_t i = 0; i < count; i++)
+      {
+        trace_data(check->cowns[i], [&](Object* o) {
+          auto it = check->index.find(o);
+          if (it != check->index.end())
+          {
+            if (it->second < count)
+              edges[i].push_back(it->second);
+            return;
+          }
+
+          if (check->cowns.size() == MAX_COWNS)
+            return;
+
+          // Held by the data of a cown that this behaviour holds.
+          Cown::acquire(o);
+          join(check, (Cown*)o);
+          grown = true;
+        });
+      }
+
+      if (grown)
+      {
+        for (size_t i = 0; i < count; i++)
+          Cown::acquire(check->cowns[i]);
+        schedule_round(check);
+        return;
+      }
+
+      sweep(check, edges);
+      schedule_step(check->pass);
+      delete check;
+    }
+
+    /**
+     * Collect the cowns of `check` that are only reachable from each other,
+     * given the references between them in `edges`.
+     */
+    static void
+    sweep(Check* check, const std::vector<std::vector<size_t>>& edges)
+    {
+      size_t count = check->cowns.size();
+
+      std::vector<size_t> internal(count, 0);
+      for (auto& targets : edges)
+      {
+        for (auto t : targets)
+          internal[t]++;
+      }
+
+      // Besides the references from the data of the others, this behaviour
+      // holds one reference to each cown, for its place in the queue.
+      std::vector<bool> live(count, false);
+      std::vector<size_t> work;
+      for (size_t i = 0; i < count; i++)
+      {
+        if (strong_count(check->cowns[i]) != internal[i] + 1)
+        {
+          live[i] = true;
+          work.push_back(i);
+        }
+      }
+
+      while (!work.empty())
+      {
+        size_t i = work.back();
+        work.pop_back();
+        for (auto t : edges[i])
+        {
+          if (!live[t])
+          {
+            live[t] = true;
+            work.push_back(t);
+          }
+        }
+      }
+
+      std::vector<Cown*> garbage;
+      std::vector<size_t> expected;
+      for (size_t i = 0; i < count; i++)
+      {
+        if (!live[i])
+        {
+          garbage.push_back(check->cowns[i]);
+          expected.push_back(internal[i] + 1);
+        }
+      }
+
+      bool collected = !garbage.empty() && release(garbage, expected);
+
+      // The cowns that remain can be recorded as candidates again.
+      for (size_t i = 0; i < count; i++)
+      {
+        if (live[i] || !collected)
+          check->cowns[i]->cycle_candidate.store(
+            false, std::memory_order_release);
+      }
+    }
+
+    /// The slot of the running behaviour on `c`.
+    static Slot* slot_of(Cown* c)
+    {
+      auto* b = Behaviour::current();
+      auto* slots = b->get_slots();
+      for (size_t i = 0; i < b->count; i++)
+      {
+        if (slots[i].cown() == c)
+          return &slots[i];
+      }
+      abort();
+    }
+
+    /**
+     * Release the data of the cowns in `garbage`, which should each have
+     * the strong reference count in `expected`.  Nothing is released if any
+     * is found to be reachable after all.  Returns true if they were
+     * released.
+     */
+    static bool release(
+      const std::vector<Cown*>& garbage, const std::vector<size_t>& expected)
+    {
+      // Once the count is replaced, no weak reference can be promoted, and
+      // the only strong references are held by data that this behaviour
+      // holds, so no new references can be made.  A behaviour queued, or a
+      // weak reference taken, before then is still visible afterwards.
+      size_t closed = 0;
+      bool unreachable = true;
+      while (unreachable && (closed < garbage.size()))
+      {
+        Cown* c = garbage[closed];
+        size_t rc = count_bits(expected[closed]);
+        if (!c->get_header().rc.compare_exchange_strong(
+              rc, Object::FINISHED_RC, std::memory_order_acq_rel))
+          break;
+        closed++;
+
+        unreachable =
+          (c->last_slot.load(std::memory_order_acquire) == slot_of(c)) &&
+          (c->weak_count.load(std::memory_order_acquire) == 1);
+      }
+      unreachable = unreachable && (closed == garbage.size());
+
+      for (size_t i = 0; i < closed; i++)
+      {
+        Cown* c = garbage[i];
+        c->get_header().rc.store(
+          count_bits(expected[i]), std::memory_order_release);
+        if (unreachable)
+        {
+          // Keep the cown out of the candidates, and leave only the
+          // destructor for the last release.
+          c->cycle_candidate.store(true, std::memory_order_relaxed);
+          c->weak_count.store(
+            Shared::CYCLE_COLLECTED, std::memory_order_relaxed);
+        }
+      }
+
+      if (!unreachable)
+        return false;
+
+      VERONA_LOG << "Collecting " << garbage.size() << " cowns in cycles"
+                 << Logging::endl;
+
+      // Each is released by the others down to the reference for this
+      // behaviour, which is the last.
+      for (auto* c : garbage)
+        c->release_data();
+      return true;
+    }
+
+  public:
+    /**
+     * Start recording the cowns that `collect` checks.
+     */
+    static void enable()
+    {
+      Cown::track_cycles.store(true, std::memory_order_relaxed);
+    }
+
+    /**
+     * Stop recording cowns, and drop those recorded that `collect` has not
+     * yet taken.  This must be called before the runtime stops, if it was
+     * enabled, so that the candidates are not leaked.
+     */
+    static void disable()
+    {
+      Cown::track_cycles.store(false, std::memory_order_relaxed);
+
+      std::vector<Cown*> dropped;
+      {
+        snmalloc::FlagLock l(Cown::cycle_candidates_lock);
+        dropped.swap(Cown::cycle_candidates);
+      }
+
+      for (auto* c : dropped)
+      {
+        c->cycle_candidate.store(false, std::memory_order_release);
+        c->weak_release();
+      }
+    }
+
+    /**
+     * Check the cowns recorded since the last call, and collect those that
+     * are unreachable, without waiting for the work to finish.  This does
+     * nothing if the previous call has not finished, and must be called from
+     * inside the runtime, e.g. from a behaviour, such as one scheduled
+     * periodically with `TimerWheel`.
+     */
+    static void collect()
+    {
+      if (collecting.exchange(true, std::memory_order_acq_rel))
+        return;
+
+      checks.store(0, std::memory_order_relaxed);
+      auto* pass = new Pass;
+      {
+        snmalloc::FlagLock l(Cown::cycle_candidates_lock);
+        pass->candidates.swap(Cown::cycle_candidates);
+      }
+      schedule_step(pass);
+    }
+
+    /// Returns true if the work of the last `collect` has not finished.
+    static bool in_progress()
+    {
+      return collecting.load(std::memory_order_acquire);
+    }
+
+    /// Number of candidates the last `collect` checked, each of which finds
+    /// and checks the cowns it reaches.
+    static size_t debug_checks()
+    {
+      return checks.load(std::memory_order_relaxed);
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,148 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../ds/heap.h"
+#include "work.h"
+
+#include <atomic>
+#include <chrono>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * A queue of work ordered by deadline, earliest first.
+   *
+   * This is a binary min-heap protected by a spin lock.  Work with a deadline
+   * is expected to be a small fraction of all work, so the lock is rarely
+   * contended.  The element count is kept outside the lock so that checking
+   * for emptiness, which happens on every call to `get_work`, is a single
+   * load.
+   *
+   * Deadlines are in nanoseconds of `std::chrono::steady_clock`, see `now`.
+   */
+  class DeadlineQueue
+  {
+    struct Entry
+    {
+      uint64_t deadline;
+      Work* work;
+    };
+
+    static constexpr size_t INITIAL_CAPACITY = 16;
+
+    snmalloc::FlagWord lock;
+    Entry* entries = nullptr;
+    size_t capacity = 0;
+    std::atomic<size_t> count{0};
+
+    void grow()
+    {
+      size_t new_capacity =
+        capacity == 0 ? INITIAL_CAPACITY : capacity * 2;
+      auto new_entries =
+        static_cast<Entry*>(heap::alloc(new_capacity * sizeof(Entry)));
+
+      for (size_t i = 0; i < capacity; i++)
+        new_entries[i] = entries[i];
+
+      if (entries != nullptr)
+        heap::dealloc(entries, capacity * sizeof(Entry));
+
+      entries = new_entries;
+      capacity = new_capacity;
+    }
+
+  public:
+    DeadlineQueue() = default;
+
+    DeadlineQueue(const DeadlineQueue&) = delete;
+
+    ~DeadlineQueue()
+    {
+      assert(is_empty());
+      if (entries != nullptr)
+        heap::dealloc(entries, capacity * sizeof(Entry));
+    }
+
+    /**
+     * Current time in the units used for deadlines.
+     */
+    static uint64_t now()
+    {
+      return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+    }
+
+    bool is_empty()
+    {
+      return count.load(std::memory_order_acquire) == 0;
+    }
+
+    void enqueue(Work* work, uint64_t deadline)
+    {
+      snmalloc::FlagLock l(lock);
+
+      size_t i = count.load(std::memory_order_relaxed);
+      if (i == capacity)
+        grow();
+
+      // Sift up.
+      while (i > 0)
+      {
+        size_t parent = (i - 1) / 2;
+        if (entries[parent].deadline <= deadline)
+          break;
+        entries[i] = entries[parent];
+        i = parent;
+      }
+      entries[i] = {deadline, work};
+
+      count.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * Remove the work with the earliest deadline, or return nullptr if the
+     * queue is empty.
+     */
+    Work* dequeue()
+    {
+      if (is_empty())
+        return nullptr;
+
+      snmalloc::FlagLock l(lock);
+
+      size_t n = count.load(std::memory_order_relaxed);
+      if (n == 0)
+        return nullptr;
+
+      Work* result = entries[0].work;
+      Entry last = entries[--n];
+
+      // Sift the last entry down from the root.
+      size_t i = 0;
+      while (true)
+      {
+        size_t child = (2 * i) + 1;
+        if (child >= n)
+          break;
+        if (
+          (child + 1 < n) &&
+          (entries[child + 1].deadline < entries[child].deadline))
+          child++;
+        if (last.deadline <= entries[child].deadline)
+          break;
+        entries[i] = entries[child];
+        i = child;
+      }
+      if (n > 0)
+        entries[i] = last;
+
+      count.store(n, std::memory_order_release);
+      return result;
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,113 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "cown.h"
+
+#include <utility>
+
+namespace verona::rt
+{
+  /**
+   * Strong releases of cowns deferred to the end of the running behaviour.
+   *
+   * While a behaviour runs, releasing a cown records the release in a small
+   * per thread table instead of decrementing the count.  Acquiring the same
+   * cown later in the behaviour cancels a recorded release, so copying and
+   * dropping handles to a cown, as captures of nested `when`s do, costs no
+   * atomic operations after the first release.  The remaining releases are
+   * applied when the behaviour returns, see `Behaviour::invoke`.
+   *
+   * A recorded release is a strong reference held by the thread, so this
+   * only delays collection, see docs/internal/cown_rc_wait_free.md.
+   * Acquires are never deferred, as the reference may be handed to another
+   * thread before the behaviour returns.
+   */
+  class DeferredRelease
+  {
+    static constexpr size_t SLOTS = 16;
+
+    struct Entry
+    {
+      Cown* cown;
+      size_t count;
+    };
+
+    Entry entries[SLOTS] = {};
+
+    /// Set while a behaviour body runs on this thread.
+    bool active = false;
+
+    static DeferredRelease& local()
+    {
+      static thread_local DeferredRelease d;
+      return d;
+    }
+
+    Entry& entry(Cown* c)
+    {
+      return entries[(reinterpret_cast<uintptr_t>(c) >> 6) % SLOTS];
+    }
+
+  public:
+    /**
+     * Equivalent to `Cown::acquire(c)`, which may cancel a release
+     * deferred on this thread.
+     */
+    static void acquire(Cown* c)
+    {
+      auto& d = local();
+      auto& e = d.entry(c);
+      if (d.active && (e.cown == c))
+      {
+        if (--e.count == 0)
+          e.cown = nullptr;
+        return;
+      }
+      Cown::acquire(c);
+    }
+
+    /**
+     * Equivalent to `Cown::release(c)`, but deferred while a behaviour is
+     * running, if the cown's table entry is free.
+     */
+    static void release(Cown* c)
+    {
+      auto& d = local();
+      auto& e = d.entry(c);
+      if (d.active && ((e.cown == c) || (e.cown == nullptr)))
+      {
+        e.cown = c;
+        e.count++;
+        return;
+      }
+      Cown::release(c);
+    }
+
+    /// Start deferring releases, on entry to a behaviour body.
+    static void begin()
+    {
+      local().active = true;
+    }
+
+    /**
+     * Apply the deferred releases.  Collecting a cown can release others,
+     * so this stops deferring first.
+     */
+    static void end()
+    {
+      auto& d = local();
+      d.active = false;
+      for (auto& e : d.entries)
+      {
+        if (e.cown == nullptr)
+          continue;
+
+        auto c = std::exchange(e.cown, nullptr);
+        auto n = std::exchange(e.count, 0);
+        while (n-- > 0)
+          Cown::release(c);
+      }
+    }
+  };
+} // namespace verona::rt
@@ -29,7 +29,9 @@
 #include "../debug/systematic.h"
 #include "../ds/asymlock.h"
 #include "../ds/queue.h"
+#include "memorypressure.h"
 
+#include <algorithm>
 #include <snmalloc/snmalloc.h>
 
 using namespace snmalloc;
@@ -71,7 +73,7 @@ namespace verona::rt
 
     static void set(uint64_t e)
     {
-      Logging::cout() << "Global epoch set to " << e << std::endl;
+      VERONA_LOG << "Global epoch set to " << e << std::endl;
       global_epoch().store(e, std::memory_order_release);
     }
 
@@ -112,11 +114,14 @@ namespace verona::rt
     /**
      * Used to represent objects that are being delayed deallocations.
      * The object itself is used to represent this. The object to be deallocated
-     * is used itself by casting to an InnerNode.
+     * is used itself by casting to an InnerNode.  The size, if known, is kept
+     * so the deallocation does not need to look it up; every allocation is at
+     * least this large.
      */
     struct InnerNode
     {
       InnerNode* next;
+      size_t size;
     };
 
     /**
@@ -148,12 +153,52 @@ namespace verona::rt
     /// Represents how many objects in each epoch of dec_list
     size_t to_dec[4] = {0, 0, 0, 0};
 
-    // Providing heuristic for advancing the epoch. Currently, we only look at
-    // one slot to determine if we should advance the epoch (see
-    // advance_is_sensible()), but we keep the history here so that better
-    // heuristic could be applied later.
+    /// The most delayed operations performed each time the epoch advances.
+    static constexpr size_t FLUSH_BUDGET = 256;
+
+    /// How many objects at the front of delete_list are from epochs that have
+    /// expired, and can be deallocated.
+    size_t expired_deletes = 0;
+
+    /// How many objects at the front of dec_list are from epochs that have
+    /// expired, and can be decremented.
+    size_t expired_decs = 0;
+
+    // Providing heuristic for advancing the epoch, see advance_is_sensible()
+    // and advance_is_urgent().
     size_t pressure[4] = {0, 0, 0, 0};
 
+    /// Represents how many bytes are waiting on each epoch.  Decrements are
+    /// counted as `DEFAULT_BYTES`, as the graph they may free is not known.
+    size_t pending[4] = {0, 0, 0, 0};
+
+    /// Bytes assumed for a delayed operation whose size is not known.
+    static constexpr size_t DEFAULT_BYTES = 64;
+
+    /// Bytes waiting on the current epoch that make advancing it sensible.
+    static constexpr size_t SENSIBLE_BYTES = 64 * 1024;
+
+    /// Bytes waiting on all epochs that make advancing urgent, so that
+    /// threads holding the epoch back are ejected.
+    static constexpr size_t URGENT_BYTES = 64 * 1024 * 1024;
+
+    /// Bounds on the number of delayed operations between attempts to advance
+    /// the epoch.
+    static constexpr size_t MIN_PERIOD = 128;
+    static constexpr size_t MAX_PERIOD = 16 * 1024;
+
+    /// Current number of delayed operations between attempts to advance the
+    /// epoch.  This backs off while advancing requires ejecting other
+    /// threads, which takes their asymmetric locks.
+    size_t period = MIN_PERIOD;
+
+    /// Number of threads ejected by any thread advancing the epoch.
+    static std::atomic<size_t>& ejections()
+    {
+      static std::atomic<size_t> ejections{0};
+      return ejections;
+    }
+
     /// The current epoch for this structure.  Initially set to EJECTED_BIT
     /// so we hit a slow path initially.
     std::atomic<uint64_t> epoch = EJECTED_BIT;
@@ -163,6 +208,7 @@ namespace verona::rt
 
     /// Used to stop advance_is_sensible always firing.
     size_t sensible_threshold = 0;
+    size_t sensible_bytes = SENSIBLE_BYTES;
 
     /// Used to check that all threads are in a particular state.
     /// Forward reference due to requiring the LocalEpochPool to
@@ -170,11 +216,14 @@ namespace verona::rt
     template<typename T, bool predicate(LocalEpoch* p, T t)>
     static bool forall(T t);
 
-    void add_to_delete_list(void* p)
+    void add_to_delete_list(void* p, size_t size)
     {
-      delete_list.enqueue((InnerNode*)p);
+      auto node = (InnerNode*)p;
+      node->size = size;
+      delete_list.enqueue(node);
       (*get_unusable(2))++;
       (*get_pressure(2))++;
+      (*get_pending(2)) += (size != 0) ? size : DEFAULT_BYTES;
       debug_check_count();
     }
 
@@ -185,6 +234,7 @@ namespace verona::rt
       dec_list.enqueue(node);
       (*get_to_dec(2))++;
       (*get_pressure(2))++;
+      (*get_pending(2)) += DEFAULT_BYTES;
       debug_check_count();
     }
 
@@ -213,6 +263,11 @@ namespace verona::rt
       return &pressure[(index + i) & 3];
     }
 
+    size_t* get_pending(uint8_t i)
+    {
+      return &pending[(index + i) & 3];
+    }
+
     size_t* get_unusable(uint8_t i)
     {
       return &unusable[(index + i) & 3];
@@ -225,76 +280,143 @@ namespace verona::rt
 
     /**
      * Deals with the old epoch's delayed operations for this thread.
+     *
+     * The operations are moved to the expired backlog at the front of the
+     * queues, and at most `FLUSH_BUDGET` of the backlog is performed here, so
+     * that the thread advancing the epoch is not held up by a large backlog.
+     * The rest is performed by later flushes, or by `reclaim` when the thread
+     * is idle.
      */
-    void flush_old_epoch()
+    void flush_old_epoch(size_t budget = FLUSH_BUDGET)
     {
       debug_check_count();
 
-      {
-        auto cell = get_unusable(0);
-        auto usable = *cell;
+      expired_deletes += *get_unusable(0);
+      *get_unusable(0) = 0;
+      expired_decs += *get_to_dec(0);
+      *get_to_dec(0) = 0;
+      *get_pending(0) = 0;
 
-        for (size_t n = 0; n < usable; n++)
-        {
-          auto d = delete_list.dequeue();
-          Logging::cout() << "Delayed delete on " << d << Logging::endl;
-          heap::dealloc(d);
-        }
-        *cell = 0;
+      debug_check_count();
 
-        *get_pressure(0) = 0;
-      }
+      index = (index + 1) & 3;
 
-      {
-        auto cell = get_to_dec(0);
-        auto usable = *cell;
+      // Clear the slot the next epoch will use.  The slots of the previous
+      // two epochs keep their pressure, as those operations are still
+      // waiting.
+      *get_pressure(2) = 0;
 
-        for (size_t n = 0; n < usable; n++)
-        {
-          auto dn = (DecNode*)dec_list.dequeue();
-          // Reestablish invariant.  The Immutable::release below
-          // can re-enter the Epoch structure so we need to ensure the
-          // invariant is re-established.
-          (*cell)--;
-          auto o = dn->o;
-          heap::dealloc<sizeof(DecNode)>(dn);
-          Logging::cout() << "Delayed decref on " << o << Logging::endl;
-          immutable::release(o);
-        }
+      sensible_threshold = 0;
+      sensible_bytes = SENSIBLE_BYTES;
+
+      reclaim(budget);
+    }
+
+    /**
+     * Performs at most `budget` of the expired delayed operations.  Returns
+     * true if there are still some left.
+     */
+    bool reclaim(size_t budget)
+    {
+      while ((expired_deletes > 0) && (budget > 0))
+      {
+        auto d = delete_list.dequeue();
+        expired_deletes--;
+        budget--;
+        VERONA_LOG << "Delayed delete on " << d << Logging::endl;
+        if (d->size != 0)
+          heap::dealloc(d, d->size);
+        else
+          heap::dealloc(d);
       }
-      debug_check_count();
 
-      index = (index + 1) & 3;
+      while ((expired_decs > 0) && (budget > 0))
+      {
+        auto dn = (DecNode*)dec_list.dequeue();
+        // Reestablish invariant.  The Immutable::release below
+        // can re-enter the Epoch structure so we need to ensure the
+        // invariant is re-established.
+        expired_decs--;
+        budget--;
+        auto o = dn->o;
+        heap::dealloc<sizeof(DecNode)>(dn);
+        VERONA_LOG << "Delayed decref on " << o << Logging::endl;
+        immutable::release(o);
+      }
 
       debug_check_count();
+      return has_backlog();
+    }
 
-      sensible_threshold = 0;
+    bool has_backlog()
+    {
+      return (expired_deletes + expired_decs) > 0;
     }
 
-    // TODO: Add a proper heuristic here
+    /**
+     * Bytes waiting on the epochs that have not yet expired.
+     */
+    size_t pending_bytes()
+    {
+      return *get_pending(0) + *get_pending(1) + *get_pending(2);
+    }
+
+    /**
+     * Advancing is sensible on the first delayed operation of an epoch, and
+     * then every `period` operations or `SENSIBLE_BYTES` bytes after it, or
+     * always while there is memory pressure, see `MemoryPressure`.
+     */
     bool advance_is_sensible()
     {
 #ifdef USE_SYSTEMATIC_TESTING
       return Systematic::coin(2);
 #else
-      constexpr size_t PERIOD = 128;
-      auto result = *get_pressure(2) > sensible_threshold;
+      if (SNMALLOC_UNLIKELY(MemoryPressure::level() != PressureLevel::None))
+        return true;
+
+      auto result = (*get_pressure(2) > sensible_threshold) ||
+        (*get_pending(2) >= sensible_bytes);
       if (result)
-        sensible_threshold += PERIOD;
+      {
+        sensible_threshold = *get_pressure(2) + period;
+        sensible_bytes = *get_pending(2) + SENSIBLE_BYTES;
+      }
       return result;
 #endif
     }
 
-    // TODO: Add a proper heuristic here
+    /**
+     * Advancing is urgent, and may eject threads holding it back, when a lot
+     * of memory or operations are waiting across the epochs, or memory
+     * pressure is critical.
+     */
     bool advance_is_urgent()
     {
 #ifdef USE_SYSTEMATIC_TESTING
       return Systematic::coin(2);
 #else
-      return *get_pressure(2) > 1024000;
+      if (SNMALLOC_UNLIKELY(MemoryPressure::level() == PressureLevel::Critical))
+        return true;
+
+      auto waiting = *get_pressure(0) + *get_pressure(1) + *get_pressure(2);
+      return (pending_bytes() > URGENT_BYTES) || (waiting > 1024000);
 #endif
     }
 
+    /**
+     * Adapts `period` after an attempt to advance the epoch.  Attempts that
+     * fail, or that had to eject other threads, back off, so that a busy
+     * thread does not repeatedly take the locks of threads still in the
+     * previous epoch.  Attempts that succeed cheaply return to the minimum.
+     */
+    void adapt_period(bool advanced, bool ejected)
+    {
+      if (!advanced || ejected)
+        period = std::min(period * 2, MAX_PERIOD);
+      else
+        period = MIN_PERIOD;
+    }
+
     uint64_t get_epoch()
     {
       return epoch.load(std::memory_order_acquire);
@@ -328,7 +450,7 @@ namespace verona::rt
 
       // Clear the ejected bit
       old_epoch = old_epoch & ~EJECTED_BIT;
-      Logging::cout() << "Rejoining epoch " << old_epoch << Logging::endl;
+      VERONA_LOG << "Rejoining epoch " << old_epoch << Logging::endl;
 
       // Read the global epoch
       auto new_epoch = GlobalEpoch::get();
@@ -412,9 +534,10 @@ namespace verona::rt
       {
         if (!in_epoch(o, e))
         {
-          Logging::cout() << "Ejecting other thread: found" << o->get_epoch()
-                          << " requires " << e << Logging::endl;
+          VERONA_LOG << "Ejecting other thread: found" << o->get_epoch()
+                     << " requires " << e << Logging::endl;
           o->eject();
+          ejections().fetch_add(1, std::memory_order_relaxed);
         }
 
         o->lock.external_release();
@@ -474,7 +597,12 @@ namespace verona::rt
     {
       refresh();
 
-      if (try_advance_global_epoch(advance_is_urgent()))
+      auto ejected = ejections().load(std::memory_order_relaxed);
+      bool advanced = try_advance_global_epoch(advance_is_urgent());
+      adapt_period(
+        advanced, ejected != ejections().load(std::memory_order_relaxed));
+
+      if (advanced)
         refresh();
     }
 
@@ -482,20 +610,20 @@ namespace verona::rt
     {
 #ifndef NDEBUG
       {
-        size_t sum = 0;
+        size_t sum = expired_deletes;
 
         for (auto i : unusable)
           sum += i;
 
         auto len = delete_list.length();
         if (sum != len)
-          Logging::cout() << "debug_check_cout: Unusable: " << sum
-                          << " list.length " << len << Logging::endl;
+          VERONA_LOG << "debug_check_cout: Unusable: " << sum << " list.length "
+                     << len << Logging::endl;
 
         assert(sum == len);
       }
       {
-        size_t sum = 0;
+        size_t sum = expired_decs;
 
         for (auto i : to_dec)
           sum += i;
@@ -503,8 +631,8 @@ namespace verona::rt
         auto len = dec_list.length();
 
         if (sum != len)
-          Logging::cout() << "debug_check_cout: to_dec: " << sum
-                          << " list.length " << len << Logging::endl;
+          VERONA_LOG << "debug_check_cout: to_dec: " << sum << " list.length "
+                     << len << Logging::endl;
 
         assert(sum == dec_list.length());
       }
@@ -559,15 +687,20 @@ namespace verona::rt
   private:
     LocalEpoch* local_epoch;
 
+    static LocalEpoch* local()
+    {
+      static thread_local ThreadLocalEpoch thread_local_epoch;
+      return thread_local_epoch.ptr;
+    }
+
   public:
     Epoch(const Epoch&) = delete;
     Epoch& operator=(const Epoch&) = delete;
 
     Epoch()
     {
-      static thread_local ThreadLocalEpoch thread_local_epoch;
       yield();
-      local_epoch = thread_local_epoch.ptr;
+      local_epoch = local();
       local_epoch->use_epoch();
     }
 
@@ -581,14 +714,36 @@ namespace verona::rt
       yield();
     }
 
+    /**
+     * Returns the pointer produced by `read`.  Holding the epoch is enough to
+     * protect it; this is for code that is generic over `Epoch` and `Hazard`.
+     */
+    template<typename F>
+    auto protect(F read)
+    {
+      return read();
+    }
+
     uint64_t get_local_epoch_epoch()
     {
       return local_epoch->epoch;
     }
 
-    void delete_in_epoch(void* object)
+    /**
+     * Bytes at the start of an object passed to `delete_in_epoch` that are
+     * overwritten straight away.  An object that other threads may still
+     * read until it is deallocated must not keep anything they read there.
+     */
+    static constexpr size_t DELETE_HEADER = sizeof(LocalEpoch::InnerNode);
+
+    /**
+     * Deallocate `object` once no thread can still be using it.  `size` is
+     * the size it was allocated with, or 0 if that is not known, in which
+     * case the allocator looks it up.
+     */
+    void delete_in_epoch(void* object, size_t size = 0)
     {
-      local_epoch->add_to_delete_list(object);
+      local_epoch->add_to_delete_list(object, size);
     }
 
     void dec_in_epoch(Object* object)
@@ -596,6 +751,36 @@ namespace verona::rt
       local_epoch->add_to_dec_list(object);
     }
 
+    /**
+     * Bytes waiting on this thread's epochs that have not yet expired.
+     */
+    static size_t pending_bytes()
+    {
+      return local()->pending_bytes();
+    }
+
+    /**
+     * Number of threads ejected from the epoch by threads advancing it.
+     */
+    static size_t ejections()
+    {
+      return LocalEpoch::ejections().load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Performs some of this thread's delayed operations from expired epochs,
+     * if there are any.  This is for threads that are otherwise idle.
+     * Returns true if there are still some left.
+     */
+    static bool reclaim()
+    {
+      if (!local()->has_backlog())
+        return false;
+
+      Epoch e;
+      return e.local_epoch->reclaim(LocalEpoch::FLUSH_BUDGET);
+    }
+
     /**
      * Empties all the delayed operations. This does not wait until the epoch
      * has been advanced, and should only be called when this is safe due to
@@ -609,7 +794,7 @@ namespace verona::rt
       {
         // There are four epoch that can be cleared.
         for (int i = 0; i < 4; i++)
-          curr->flush_old_epoch();
+          curr->flush_old_epoch(SIZE_MAX);
 
         curr->eject();
 
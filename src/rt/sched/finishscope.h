@@ -0,0 +1,145 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../ds/heap.h"
+#include "schedulerthread.h"
+#include "work.h"
+
+#include <atomic>
+#include <new>
+#include <utility>
+
+namespace verona::rt
+{
+  /**
+   * Counts the work spawned within it, directly or transitively, and runs a
+   * continuation once all of it has finished, see `verona::cpp::finish_scope`.
+   *
+   * A scope is current on a thread while code runs inside it, see `Enter`.
+   * Each behaviour, and each closure scheduled with `schedule_lambda`, that
+   * is created while a scope is current joins it, see `join`, and the scope
+   * is current again while that work runs, so the work it spawns joins as
+   * well.  The work leaves the scope once it has finished, see `leave`.
+   *
+   * A scope created while another is current is itself part of the outer
+   * scope until its continuation has run.
+   *
+   * This is reference counted, with one count for the creator, and one for
+   * each piece of work that has joined it.
+   */
+  class FinishScope
+  {
+    std::atomic<size_t> rc{1};
+    /// One for each unfinished piece of work, and one until `close`.
+    std::atomic<size_t> pending{1};
+    Work* continuation = nullptr;
+    /// The scope that was current when this was created.
+    FinishScope* parent;
+
+    FinishScope(FinishScope* parent_) : parent(parent_) {}
+
+    static FinishScope*& current()
+    {
+      static thread_local FinishScope* scope = nullptr;
+      return scope;
+    }
+
+    void finish()
+    {
+      if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        Scheduler::schedule(continuation);
+    }
+
+  public:
+    FinishScope(const FinishScope&) = delete;
+
+    /// A new scope, with a single reference, inside the current scope.
+    static FinishScope* make()
+    {
+      return new (heap::alloc(sizeof(FinishScope))) FinishScope(join());
+    }
+
+    void acquire()
+    {
+      rc.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release()
+    {
+      if (rc.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      {
+        this->~FinishScope();
+        heap::dealloc(this, sizeof(FinishScope));
+      }
+    }
+
+    /**
+     * Count new work in the current scope, if there is one, and return it.
+     * The work must call `leave` on the result once it has finished.
+     */
+    static FinishScope* join()
+    {
+      auto s = current();
+      if (s != nullptr)
+      {
+        s->pending.fetch_add(1, std::memory_order_relaxed);
+        s->acquire();
+      }
+      return s;
+    }
+
+    /// Work that joined this scope has finished.
+    void leave()
+    {
+      finish();
+      release();
+    }
+
+    /**
+     * Makes a scope current, which may be nullptr, until this is destroyed.
+     */
+    class Enter
+    {
+      FinishScope* outer;
+
+    public:
+      Enter(FinishScope* s) : outer(std::exchange(current(), s)) {}
+
+      Enter(const Enter&) = delete;
+
+      ~Enter()
+      {
+        current() = outer;
+      }
+    };
+
+    /**
+     * Schedule `w` once all the work that has joined this scope has
+     * finished.  No more work may join the scope from outside it after this
+     * is called.  This must be called exactly once.
+     */
+    void close(Work* w)
+    {
+      assert(continuation == nullptr);
+      continuation = w;
+      finish();
+    }
+
+    /// The scope that this is part of, which the continuation runs in.
+    FinishScope* get_parent() const
+    {
+      return parent;
+    }
+
+    /**
+     * Called by the continuation once it has run, so that an enclosing scope
+     * can finish.
+     */
+    void leave_parent()
+    {
+      if (auto p = std::exchange(parent, nullptr))
+        p->leave();
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,257 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+/**
+ * This file provides hazard pointers, an alternative to `Epoch` for
+ * protecting reads of shared pointers.
+ *
+ * Each thread has a hazard slot.  A reader publishes the pointer it is about
+ * to use in its slot, and then checks the pointer is still current, after
+ * which the object cannot be reclaimed until the slot is cleared.  Retired
+ * objects are kept on a per-thread list, and once the list is long enough it
+ * is scanned, and every object that is not in any slot is reclaimed.
+ *
+ * Unlike epochs, a reader only holds back the object it has protected, so a
+ * slow reader does not stop other memory being reclaimed.  Retiring costs a
+ * scan of all slots every `SCAN_THRESHOLD` objects.
+ */
+
+#include "../debug/logging.h"
+#include "../ds/heap.h"
+
+#include <atomic>
+#include <snmalloc/snmalloc.h>
+#include <utility>
+
+namespace verona::rt
+{
+  class Object;
+  // Forward declaration
+  namespace immutable
+  {
+    void release(Object*);
+  }
+
+  /**
+   * The hazard slot and retired objects of a thread.
+   */
+  class HazardRecord : public snmalloc::Pooled<HazardRecord>
+  {
+  private:
+    friend class ThreadLocalHazard;
+    friend class Hazard;
+
+    /**
+     * An object waiting until no slot holds it.  If `size` is `DEC`, the
+     * object has its reference count decremented, otherwise it is
+     * deallocated with `size`, or without a size if `size` is 0.
+     */
+    struct Retired
+    {
+      Retired* next;
+      void* p;
+      size_t size;
+    };
+
+    static constexpr size_t DEC = SIZE_MAX;
+
+    /// Retired objects between scans of the slots.
+    static constexpr size_t SCAN_THRESHOLD = 64;
+
+    /// The pointer this thread is reading, if any.
+    std::atomic<void*> slot{nullptr};
+
+    Retired* retired = nullptr;
+    size_t retired_count = 0;
+
+    void retire(void* p, size_t size)
+    {
+      auto r = (Retired*)heap::alloc<sizeof(Retired)>();
+      r->p = p;
+      r->size = size;
+      r->next = retired;
+      retired = r;
+
+      if (++retired_count >= SCAN_THRESHOLD)
+        scan(false);
+    }
+
+    static void reclaim(Retired* r)
+    {
+      auto p = r->p;
+      auto size = r->size;
+      heap::dealloc<sizeof(Retired)>(r);
+
+      if (size == DEC)
+      {
+        VERONA_LOG << "Hazard decref on " << p << Logging::endl;
+        immutable::release((Object*)p);
+      }
+      else if (size != 0)
+      {
+        VERONA_LOG << "Hazard delete on " << p << Logging::endl;
+        heap::dealloc(p, size);
+      }
+      else
+      {
+        VERONA_LOG << "Hazard delete on " << p << Logging::endl;
+        heap::dealloc(p);
+      }
+    }
+
+    /**
+     * Reclaim the retired objects that are not in any slot, or all of them
+     * if `all` is set.
+     */
+    void scan(bool all);
+  };
+
+  using HazardRecordPool =
+    snmalloc::Pool<HazardRecord, snmalloc::Alloc::Config>;
+
+  inline void HazardRecord::scan(bool all)
+  {
+    // Take the list first, as reclaiming can retire more objects.
+    auto curr = std::exchange(retired, nullptr);
+    retired_count = 0;
+
+    while (curr != nullptr)
+    {
+      auto next = curr->next;
+
+      bool hazard = false;
+      if (!all)
+      {
+        for (auto h = HazardRecordPool::iterate(); h != nullptr;
+             h = HazardRecordPool::iterate(h))
+        {
+          if (h->slot.load(std::memory_order_seq_cst) == curr->p)
+          {
+            hazard = true;
+            break;
+          }
+        }
+      }
+
+      if (hazard)
+      {
+        curr->next = retired;
+        retired = curr;
+        retired_count++;
+      }
+      else
+      {
+        reclaim(curr);
+      }
+
+      curr = next;
+    }
+  }
+
+  /**
+   * Handles lifetime management of the HazardRecord structure.
+   */
+  class ThreadLocalHazard
+  {
+  private:
+    friend class Hazard;
+    HazardRecord* ptr;
+
+    ThreadLocalHazard()
+    {
+      ptr = HazardRecordPool::acquire();
+    }
+
+    ~ThreadLocalHazard()
+    {
+      ptr->slot.store(nullptr, std::memory_order_release);
+      HazardRecordPool::release(ptr);
+    }
+  };
+
+  /**
+   * RAII wrapper for the hazard slot of this thread, with the same interface
+   * as `Epoch`, so that it can be used to protect a `Noticeboard`.
+   *
+   * Only one pointer is protected at a time: `protect` replaces the previous
+   * one, which must already have been made safe, for instance by taking a
+   * reference to it.  A nested `Hazard` restores the outer pointer when it is
+   * destroyed.
+   */
+  class Hazard
+  {
+  private:
+    HazardRecord* record;
+    void* outer;
+
+    static HazardRecord* local()
+    {
+      static thread_local ThreadLocalHazard thread_local_hazard;
+      return thread_local_hazard.ptr;
+    }
+
+  public:
+    Hazard(const Hazard&) = delete;
+    Hazard& operator=(const Hazard&) = delete;
+
+    Hazard()
+    : record(local()), outer(record->slot.load(std::memory_order_relaxed))
+    {}
+
+    ~Hazard()
+    {
+      record->slot.store(outer, std::memory_order_release);
+    }
+
+    /**
+     * Returns the pointer produced by `read`, once it is protected.  `read`
+     * is called until it gives the same pointer before and after it is
+     * published in the slot.
+     */
+    template<typename F>
+    auto protect(F read)
+    {
+      auto p = read();
+      while (true)
+      {
+        record->slot.store((void*)p, std::memory_order_seq_cst);
+        // The second read must not be satisfied before the slot is visible.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto q = read();
+        if (q == p)
+          return p;
+        p = q;
+      }
+    }
+
+    void delete_in_epoch(void* object, size_t size = 0)
+    {
+      record->retire(object, size);
+    }
+
+    void dec_in_epoch(Object* object)
+    {
+      record->retire(object, HazardRecord::DEC);
+    }
+
+    /**
+     * Reclaims all retired objects.  This does not check the slots, and
+     * should only be called when this is safe due to other synchronization,
+     * such as during teardown.
+     */
+    static void flush()
+    {
+      auto curr = HazardRecordPool::iterate();
+
+      while (curr != nullptr)
+      {
+        // Reclaiming can retire more objects.
+        while (curr->retired != nullptr)
+          curr->scan(true);
+
+        curr = HazardRecordPool::iterate(curr);
+      }
+    }
+  };
+} // namespace verona::rt
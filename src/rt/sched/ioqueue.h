@@ -0,0 +1,340 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../pal/iouring.h"
+#include "work.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#if defined(__unix__) || defined(__APPLE__)
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+namespace verona::rt
+{
+  enum class IOOpcode : uint8_t
+  {
+    Nop,
+    Read,
+    Write,
+    /// Read into, or write from, a buffer registered with
+    /// `IOQueue::register_buffers` on the same core.
+    ReadFixed,
+    WriteFixed,
+    Recv,
+    Send,
+    Accept,
+  };
+
+  /**
+   * An I/O operation, as a subset of the fields of an io_uring submission.
+   * `offset` is ignored by sockets, and is `CURRENT_POSITION` for the
+   * current file position.
+   */
+  struct IOOp
+  {
+    static constexpr uint64_t CURRENT_POSITION = (uint64_t)-1;
+
+    IOOpcode opcode = IOOpcode::Nop;
+    int fd = -1;
+    void* buf = nullptr;
+    uint32_t len = 0;
+    uint64_t offset = 0;
+    /// Flags for `Recv`, `Send` and `Accept`.
+    int flags = 0;
+    /// Index of the registered buffer for `ReadFixed` and `WriteFixed`.
+    uint16_t buf_index = 0;
+  };
+
+  /**
+   * An operation in flight.  When it completes, `result` is set to what the
+   * system call would have returned, or a negative errno, and `work` is run
+   * on the core that submitted it.
+   */
+  struct IORequest
+  {
+    Work* work = nullptr;
+    int32_t result = 0;
+  };
+
+  /**
+   * The I/O of one core.  Operations are submitted by the behaviours running
+   * on the core, and the core's own scheduler thread passes them to the
+   * kernel and collects their completions between batches, and when it has
+   * no other work, so no extra thread is needed, and completed work starts
+   * on the core that asked for it.  See `SchedulerThread::poll_io`.
+   *
+   * On Linux this uses an io_uring per core, created on first use.  Where
+   * io_uring is not available, such as on an old kernel or under a seccomp
+   * profile that blocks it, operations are left to the caller to run
+   * synchronously, see `run_synchronously`.  Only the core's thread uses
+   * this, so there is no synchronisation.
+   */
+  class IOQueue
+  {
+    enum class Backend : uint8_t
+    {
+      Uninitialised,
+      Ring,
+      Synchronous,
+    };
+
+    Backend backend = Backend::Uninitialised;
+
+    /// See `set_ring_enabled`.
+    static inline std::atomic<bool> ring_enabled{true};
+
+    /// Operations submitted and not yet completed.
+    size_t in_flight = 0;
+
+#ifdef VERONA_IO_URING
+    pal::IOUring ring;
+
+    /// Timeout for `wait`, which must outlive the submission.
+    __kernel_timespec wait_time{};
+
+    static constexpr uint64_t WAIT_USER_DATA = 0;
+#endif
+
+    void init()
+    {
+      backend = Backend::Synchronous;
+#ifdef VERONA_IO_URING
+      if (ring_enabled.load(std::memory_order_relaxed) && ring.init(ENTRIES))
+        backend = Backend::Ring;
+#endif
+    }
+
+    static int32_t result(long r)
+    {
+      return r < 0 ? -errno : (int32_t)r;
+    }
+
+#ifdef VERONA_IO_URING
+    static uint8_t ring_opcode(IOOpcode opcode)
+    {
+      switch (opcode)
+      {
+        case IOOpcode::Nop:
+          return IORING_OP_NOP;
+        case IOOpcode::Read:
+          return IORING_OP_READ;
+        case IOOpcode::Write:
+          return IORING_OP_WRITE;
+        case IOOpcode::ReadFixed:
+          return IORING_OP_READ_FIXED;
+        case IOOpcode::WriteFixed:
+          return IORING_OP_WRITE_FIXED;
+        case IOOpcode::Recv:
+          return IORING_OP_RECV;
+        case IOOpcode::Send:
+          return IORING_OP_SEND;
+        case IOOpcode::Accept:
+          return IORING_OP_ACCEPT;
+      }
+      return IORING_OP_NOP;
+    }
+
+    io_uring_sqe* get_sqe()
+    {
+      auto* sqe = ring.get_sqe();
+      if (sqe == nullptr)
+      {
+        // Full, so pass what is queued to the kernel to make room.
+        ring.submit();
+        sqe = ring.get_sqe();
+      }
+      return sqe;
+    }
+#endif
+
+  public:
+    /// Submission queue entries of each core's ring.
+    static constexpr uint32_t ENTRIES = 256;
+
+    /// Longest an idle core with I/O in flight sleeps in the kernel before
+    /// it looks for other work again.
+    static constexpr int64_t WAIT_NS = 100'000;
+
+    IOQueue() = default;
+
+    IOQueue(const IOQueue&) = delete;
+
+    /**
+     * Enable or disable io_uring for the queues created from now on.  With
+     * it disabled, every operation runs synchronously, as where io_uring is
+     * not available.
+     */
+    static void set_ring_enabled(bool enable)
+    {
+      ring_enabled.store(enable, std::memory_order_relaxed);
+    }
+
+    /**
+     * Run `op` with the equivalent blocking system call, where `submit` could
+     * not queue it.  This may block, for instance on a socket, so scheduler
+     * threads run it in a `ThreadPool::blocking_section`.  Fixed buffers are
+     * only meaningful to io_uring, so are not supported.
+     */
+    static int32_t run_synchronously(const IOOp& op)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+      auto off = (off_t)op.offset;
+      bool positioned = op.offset != IOOp::CURRENT_POSITION;
+      switch (op.opcode)
+      {
+        case IOOpcode::Nop:
+          return 0;
+        case IOOpcode::Read:
+          return result(
+            positioned ? pread(op.fd, op.buf, op.len, off) :
+                         read(op.fd, op.buf, op.len));
+        case IOOpcode::Write:
+          return result(
+            positioned ? pwrite(op.fd, op.buf, op.len, off) :
+                         write(op.fd, op.buf, op.len));
+        case IOOpcode::Recv:
+          return result(recv(op.fd, op.buf, op.len, op.flags));
+        case IOOpcode::Send:
+          return result(send(op.fd, op.buf, op.len, op.flags));
+        case IOOpcode::Accept:
+          return result(accept(op.fd, nullptr, nullptr));
+        default:
+          return -EINVAL;
+      }
+#else
+      return op.opcode == IOOpcode::Nop ? 0 : -ENOSYS;
+#endif
+    }
+
+    bool is_active() const
+    {
+      return in_flight != 0;
+    }
+
+    /**
+     * Whether `submit` would have to run an operation synchronously for
+     * lack of room in the ring, so the caller should `poll` first.
+     */
+    bool is_full() const
+    {
+#ifdef VERONA_IO_URING
+      return (backend == Backend::Ring) && (in_flight >= ring.sq_entries);
+#else
+      return false;
+#endif
+    }
+
+    /**
+     * Start `op`, which completes `req`, after which `poll` schedules
+     * `req->work`.  Returns false if it could not be queued, in which case
+     * the caller must run it with `run_synchronously`, and schedule
+     * `req->work` itself.
+     */
+    bool submit(const IOOp& op, IORequest* req)
+    {
+      if (backend == Backend::Uninitialised)
+        init();
+
+#ifdef VERONA_IO_URING
+      // The completion queue is twice the size of the submission queue.
+      // Keeping to the submission queue's size leaves room for the
+      // completions of the timeouts of `poll`, so none are lost.
+      if ((backend == Backend::Ring) && (in_flight < ring.sq_entries))
+      {
+        auto* sqe = get_sqe();
+        if (sqe != nullptr)
+        {
+          sqe->opcode = ring_opcode(op.opcode);
+          sqe->fd = op.fd;
+          sqe->addr = (uint64_t)(uintptr_t)op.buf;
+          sqe->len = op.len;
+          sqe->off = op.offset;
+          sqe->msg_flags = (uint32_t)op.flags;
+          sqe->buf_index = op.buf_index;
+          sqe->user_data = (uint64_t)(uintptr_t)req;
+          in_flight++;
+          return true;
+        }
+      }
+#endif
+
+      UNUSED(op);
+      UNUSED(req);
+      return false;
+    }
+
+    /**
+     * Pass submitted operations to the kernel, and call `f` with the
+     * request of each that has completed.  If `wait`, first sleep in the
+     * kernel until something completes, for at most `WAIT_NS`.  Returns the
+     * number completed.
+     */
+    template<typename F>
+    size_t poll(F&& f, bool wait = false)
+    {
+      if (in_flight == 0)
+        return 0;
+
+#ifdef VERONA_IO_URING
+      if (wait)
+      {
+        // A timeout that completes once anything else does.
+        auto* sqe = get_sqe();
+        if (sqe != nullptr)
+        {
+          wait_time.tv_sec = 0;
+          wait_time.tv_nsec = WAIT_NS;
+          sqe->opcode = IORING_OP_TIMEOUT;
+          sqe->addr = (uint64_t)(uintptr_t)&wait_time;
+          sqe->len = 1;
+          sqe->off = 1;
+          sqe->user_data = WAIT_USER_DATA;
+        }
+      }
+      ring.submit(wait ? 1 : 0);
+
+      size_t completed = 0;
+      ring.reap([this, &f, &completed](uint64_t user_data, int32_t res) {
+        if (user_data == WAIT_USER_DATA)
+          return;
+        auto* req = (IORequest*)(uintptr_t)user_data;
+        req->result = res;
+        in_flight--;
+        completed++;
+        f(req);
+      });
+      return completed;
+#else
+      UNUSED(f);
+      UNUSED(wait);
+      return 0;
+#endif
+    }
+
+    /**
+     * Register `count` buffers, an array of `iovec`, for `ReadFixed` and
+     * `WriteFixed` on this core, so that the kernel maps them once rather
+     * than for each operation.
+     * Returns 0, or a negative errno, which is `-ENOTSUP` where there is no
+     * io_uring.
+     */
+    int register_buffers(const void* buffers, unsigned count)
+    {
+      if (backend == Backend::Uninitialised)
+        init();
+
+#ifdef VERONA_IO_URING
+      if (backend == Backend::Ring)
+        return ring.register_buffers(
+          static_cast<const iovec*>(buffers), count);
+#endif
+      UNUSED(buffers);
+      UNUSED(count);
+      return -ENOTSUP;
+    }
+  };
+} // namespace verona::rt
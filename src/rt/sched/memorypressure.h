@@ -0,0 +1,165 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../debug/logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <snmalloc/snmalloc.h>
+#include <utility>
+#include <vector>
+
+namespace verona::rt
+{
+  /// How close the process is to its memory limit, see `MemoryPressure`.
+  enum class PressureLevel : uint8_t
+  {
+    None,
+    /// Memory held for later reuse should be given back.
+    Moderate,
+    /// Allocation may fail soon, so work that allocates should be held off.
+    Critical,
+  };
+
+  /**
+   * The memory pressure the runtime is under, as last reported with
+   * `ThreadPool::memory_pressure`, and the parts of the runtime that respond
+   * to it.
+   *
+   * The runtime holds memory in several places to reuse it later, or to free
+   * it once that is safe.  While there is pressure:
+   *
+   *  - Leaving an `Epoch` always tries to advance it, and at `Critical`
+   *    ejects the threads holding it back, so that delayed frees expire.
+   *  - Each scheduler thread, at the end of its next batch or when it is
+   *    idle, performs all the delayed operations of expired epochs, and
+   *    empties its `BehaviourPool`.
+   *  - `when_bounded` admits fewer behaviours, see `admission_limit`.
+   *  - The handlers added with `add_handler` are run, for instance to
+   *    schedule a collection of the regions of idle cowns, which only the
+   *    program can find.
+   *
+   * The level is a hint, so a change is only published with relaxed stores,
+   * and each thread responds the next time it checks.
+   */
+  class MemoryPressure
+  {
+    using Handler = std::function<void(PressureLevel)>;
+
+    struct State
+    {
+      std::atomic<PressureLevel> level{PressureLevel::None};
+      /// Incremented by each `set`, so threads can tell they have not yet
+      /// responded to a change.
+      std::atomic<uint64_t> generation{0};
+
+      snmalloc::FlagWord handlers_lock;
+      std::vector<std::pair<size_t, Handler>> handlers;
+      size_t next_handler = 0;
+    };
+
+    static State& state()
+    {
+      static State s;
+      return s;
+    }
+
+  public:
+    static PressureLevel level()
+    {
+      return state().level.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t generation()
+    {
+      return state().generation.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Set the level and run the handlers with it, on the calling thread.
+     * Called by `ThreadPool::memory_pressure`.
+     */
+    static void set(PressureLevel l)
+    {
+      auto& s = state();
+      VERONA_LOG << "Memory pressure " << (int)l << Logging::endl;
+      s.level.store(l, std::memory_order_relaxed);
+      s.generation.fetch_add(1, std::memory_order_relaxed);
+
+      std::vector<Handler> handlers;
+      {
+        snmalloc::FlagLock lock(s.handlers_lock);
+        for (auto& [id, h] : s.handlers)
+          handlers.push_back(h);
+      }
+      for (auto& h : handlers)
+        h(l);
+    }
+
+    /**
+     * Run `h(level)` each time the level is set.  Returns an id for
+     * `remove_handler`.
+     */
+    static size_t add_handler(Handler h)
+    {
+      auto& s = state();
+      snmalloc::FlagLock lock(s.handlers_lock);
+      auto id = s.next_handler++;
+      s.handlers.emplace_back(id, std::move(h));
+      return id;
+    }
+
+    static void remove_handler(size_t id)
+    {
+      auto& s = state();
+      snmalloc::FlagLock lock(s.handlers_lock);
+      for (auto it = s.handlers.begin(); it != s.handlers.end(); it++)
+      {
+        if (it->first == id)
+        {
+          s.handlers.erase(it);
+          return;
+        }
+      }
+    }
+
+    /**
+     * The level for `current` bytes in use of a `limit`: `Moderate` from
+     * `moderate` percent of the limit, and `Critical` from `critical`
+     * percent, for instance for a monitor that reads
+     * `memorylimit::cgroup_usage` periodically.
+     */
+    static PressureLevel level_for(
+      size_t current, size_t limit, size_t moderate = 80, size_t critical = 95)
+    {
+      auto percent = (limit == 0) ? 100 : ((current * 100) / limit);
+      if (percent >= critical)
+        return PressureLevel::Critical;
+      if (percent >= moderate)
+        return PressureLevel::Moderate;
+      return PressureLevel::None;
+    }
+
+    /**
+     * The number of behaviours queued on a cown that `when_bounded` admits,
+     * for a `limit` that applies without pressure: half of it under
+     * `Moderate` pressure, and an eighth under `Critical`, but at least one.
+     */
+    static size_t admission_limit(size_t limit)
+    {
+      switch (level())
+      {
+        case PressureLevel::None:
+          return limit;
+        case PressureLevel::Moderate:
+          return std::max<size_t>(limit / 2, 1);
+        case PressureLevel::Critical:
+          return std::max<size_t>(limit / 8, 1);
+      }
+      return limit;
+    }
+  };
+} // namespace verona::rt
@@ -6,6 +6,20 @@
 
 namespace verona::rt
 {
+  /**
+   * Why a removal from an `MPMCQ` returned nothing, or that it did not.
+   */
+  enum class QueueStatus
+  {
+    /// An element was removed.
+    Taken,
+    /// The queue was empty.
+    Empty,
+    /// The queue has elements, but another removal or an enqueue was in
+    /// progress, so trying again, or elsewhere, may succeed.
+    Contended
+  };
+
   /**
    * Multiple Producer Multiple Consumer Queue with steal all
    *
@@ -39,14 +53,19 @@ namespace verona::rt
     NextPtr front{nullptr};
 
     // Common function that is used to make the queue appear empty to any other
-    // dequeue or dequeue_all operations.
-    T* acquire_front()
+    // dequeue or dequeue_all operations.  On failure, `status` says whether
+    // the queue was empty or in use.
+    T* acquire_front(QueueStatus& status)
     {
       Systematic::yield();
 
-      // Nothing in the queue
+      // Nothing at the front.  Either the queue is empty, or another removal
+      // holds the front, or the first enqueue has not linked in yet.  Only
+      // these plain loads are made, so thieves probing a busy queue do not
+      // take the line exclusively.
       if (front.load(std::memory_order_relaxed) == nullptr)
       {
+        status = is_empty() ? QueueStatus::Empty : QueueStatus::Contended;
         return nullptr;
       }
 
@@ -54,7 +73,10 @@ namespace verona::rt
 
       // Remove head element.  This is like locking the queue for other
       // removals.
-      return front.exchange(nullptr, std::memory_order_acquire);
+      auto old_front = front.exchange(nullptr, std::memory_order_acquire);
+      status = (old_front == nullptr) ? QueueStatus::Contended :
+                                        QueueStatus::Taken;
+      return old_front;
     }
 
   public:
@@ -90,6 +112,28 @@ namespace verona::rt
         start = next;
         return n;
       }
+
+      /**
+       * Counts the elements of the segment up to the first link that has not
+       * yet been completed.  This is a lower bound on the length of the
+       * segment.
+       */
+      size_t length_hint()
+      {
+        if (start == nullptr)
+          return 0;
+
+        size_t length = 1;
+        auto n = start;
+        while (&n->next_in_queue != end)
+        {
+          n = n->next_in_queue.load(std::memory_order_acquire);
+          if (n == nullptr)
+            break;
+          length++;
+        }
+        return length;
+      }
     };
 
     explicit MPMCQ() {}
@@ -126,17 +170,26 @@ namespace verona::rt
 
     void enqueue_front(T* node)
     {
-      auto old_front = acquire_front();
+      enqueue_front_segment({node, &node->next_in_queue});
+    }
+
+    /**
+     * Enqueue a fully linked segment at the front, with a single exchange.
+     */
+    void enqueue_front_segment(Segment ls)
+    {
+      QueueStatus status;
+      auto old_front = acquire_front(status);
       if (old_front == nullptr)
       {
         // Post to back.
-        enqueue(node);
+        enqueue_segment(ls);
         return;
       }
 
       // Link into the front.
-      node->next_in_queue.store(old_front, std::memory_order_relaxed);
-      front.store(node, std::memory_order_release);
+      ls.end->store(old_front, std::memory_order_relaxed);
+      front.store(ls.start, std::memory_order_release);
     }
 
     /**
@@ -145,7 +198,17 @@ namespace verona::rt
      */
     T* dequeue()
     {
-      auto old_front = acquire_front();
+      QueueStatus status;
+      return dequeue(status);
+    }
+
+    /**
+     * As `dequeue`, and set `status` to say whether the queue was empty or
+     * contended if nothing is returned.
+     */
+    T* dequeue(QueueStatus& status)
+    {
+      auto old_front = acquire_front(status);
 
       Systematic::yield();
 
@@ -181,6 +244,7 @@ namespace verona::rt
 
       // Failed to close the queue, something is being added, try again later.
       front.store(old_front, std::memory_order_release);
+      status = QueueStatus::Contended;
       return nullptr;
     }
 
@@ -190,7 +254,17 @@ namespace verona::rt
      */
     Segment dequeue_all()
     {
-      auto old_front = acquire_front();
+      QueueStatus status;
+      return dequeue_all(status);
+    }
+
+    /**
+     * As `dequeue_all`, and set `status` to say whether the queue was empty
+     * or contended if nothing is returned.
+     */
+    Segment dequeue_all(QueueStatus& status)
+    {
+      auto old_front = acquire_front(status);
 
       // Queue is empty or someone else is popping, so just return.
       if (old_front == nullptr)
@@ -4,15 +4,54 @@
 
 #include "../debug/logging.h"
 #include "../ds/forward_list.h"
+#include "../region/immutable.h"
 #include "../region/region.h"
 #include "../sched/epoch.h"
+#include "../sched/hazard.h"
+#include "../sched/notification.h"
 #include "../sched/schedulerthread.h"
 
+#include <cstring>
+#include <new>
+#include <optional>
 #include <queue>
+#include <type_traits>
 
 namespace verona::rt
 {
-  template<typename T>
+  inline BaseNoticeboard::~BaseNoticeboard()
+  {
+    if (on_update != nullptr)
+      Shared::release(on_update);
+  }
+
+  inline void BaseNoticeboard::published(uint64_t updates)
+  {
+    current_version.fetch_add(updates, std::memory_order_release);
+    if (on_update != nullptr)
+      on_update->notify();
+  }
+
+  inline void BaseNoticeboard::set_notification(Notification* n)
+  {
+    if (n != nullptr)
+      Shared::acquire(n);
+    if (on_update != nullptr)
+      Shared::release(on_update);
+    on_update = n;
+  }
+
+  /**
+   * A noticeboard holding a fundamental value, or a pointer to an immutable
+   * object, that is read by `peek` without ownership of its cown.
+   *
+   * `Reclaim` protects the object a `peek` reads until it has taken a
+   * reference, and delays releasing the objects replaced by `update`.  It is
+   * `Epoch` by default.  `Hazard` bounds the memory held back by peekers that
+   * hold an epoch for a long time, at the cost of a scan of all threads'
+   * hazard slots every few updates.
+   */
+  template<typename T, typename Reclaim = Epoch>
   class Noticeboard : public BaseNoticeboard
   {
   public:
@@ -57,20 +96,21 @@ namespace verona::rt
       if constexpr (!std::is_fundamental_v<T>)
       {
         auto local_content = get<T>();
-        Logging::cout() << "Updating noticeboard " << this << " old value "
-                        << local_content << " new value " << new_o
-                        << Logging::endl;
+        VERONA_LOG << "Updating noticeboard " << this << " old value "
+                   << local_content << " new value " << new_o << Logging::endl;
 
         put(new_o);
+        published();
         yield();
-        Epoch e;
+        Reclaim e;
         e.dec_in_epoch(local_content);
-        Logging::cout() << "Dec ref from noticeboard update" << local_content
-                        << Logging::endl;
+        VERONA_LOG << "Dec ref from noticeboard update" << local_content
+                   << Logging::endl;
       }
       else
       {
         put(new_o);
+        published();
       }
       yield();
 #endif
@@ -84,18 +124,337 @@ namespace verona::rt
       }
       else
       {
-        T local_content;
+        // only protect incref with epoch
+        Reclaim e;
+        return peek(e);
+      }
+    }
+
+    /**
+     * As `peek`, but protected by an epoch, or hazard slot, the caller has
+     * already entered, so that several noticeboards can be peeked while
+     * entering it once:
+     *
+     *   Epoch e;
+     *   auto a = board_a.peek(e);
+     *   auto b = board_b.peek(e);
+     */
+    T peek(Reclaim& e)
+    {
+      if constexpr (std::is_fundamental_v<T>)
+      {
+        UNUSED(e);
+        return get<T>();
+      }
+      else
+      {
+#ifdef USE_SYSTEMATIC_TESTING_WEAK_NOTICEBOARDS
+        // Buffered updates are released under an epoch, see `flush_n`.
+        Epoch weak;
+#endif
+        T local_content = e.protect([this]() { return get<T>(); });
+        yield();
+        VERONA_LOG << "Inc ref from noticeboard peek" << local_content
+                   << Logging::endl;
+        local_content->incref();
+        return local_content;
+      }
+    }
+  };
+
+  /**
+   * A noticeboard for values that are read far more often than they are
+   * updated, such as configuration read by every behaviour.
+   *
+   * The value is replicated per `Core`.  Each replica holds its own reference
+   * to a snapshot, and is refreshed lazily, by the next `peek` on that core
+   * after an `update`.  A `peek` that finds its replica current only touches
+   * memory local to its core, and does not enter an `Epoch`; only refreshes
+   * read the shared value, under an `Epoch` as in `Noticeboard::peek`.
+   * Snapshots dropped by an update or a refresh are released through
+   * `Epoch::dec_in_epoch`.
+   *
+   * Peeks from threads that are not running a core read the shared value
+   * directly.  Only immutable objects can be published, as replicating a
+   * fundamental value gains nothing over `Noticeboard`.
+   */
+  template<typename T>
+  class ReplicatedNoticeboard : public BaseNoticeboard
+  {
+    static_assert(
+      std::is_pointer_v<T>, "Use Noticeboard for fundamental values");
+
+    static constexpr uint64_t EMPTY = UINT64_MAX;
+
+    struct alignas(64) Replica
+    {
+      /// Taken by refreshes and peeks.  Only contended if several threads
+      /// service one core, see `Core::servicing_threads`.
+      snmalloc::FlagWord lock;
+      /// Version of `value`, or `EMPTY`.
+      uint64_t version = EMPTY;
+      T value = nullptr;
+    };
+
+    /// One replica per core, allocated by the first peek on a core.
+    std::atomic<Replica*> replicas{nullptr};
+    /// Set after `replicas`, so peeks may briefly see no replicas.
+    std::atomic<size_t> replica_count{0};
+
+    Replica* get_replica()
+    {
+      auto core = Scheduler::local_core();
+      if (core == nullptr)
+        return nullptr;
+
+      auto r = replicas.load(std::memory_order_acquire);
+      if (r == nullptr)
+      {
+        auto count = Scheduler::get_core_count();
+        auto fresh = static_cast<Replica*>(heap::alloc(
+          snmalloc::aligned_size(alignof(Replica), count * sizeof(Replica))));
+        for (size_t i = 0; i < count; i++)
+          new (&fresh[i]) Replica();
+
+        if (replicas.compare_exchange_strong(
+              r, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
         {
-          // only protect incref with epoch
-          Epoch e;
-          local_content = get<T>();
-          yield();
-          Logging::cout() << "Inc ref from noticeboard peek" << local_content
-                          << Logging::endl;
-          local_content->incref();
+          replica_count.store(count, std::memory_order_release);
+          r = fresh;
         }
-        return local_content;
+        else
+        {
+          heap::dealloc(
+            fresh,
+            snmalloc::aligned_size(alignof(Replica), count * sizeof(Replica)));
+        }
+      }
+
+      // A noticeboard from a previous run of the runtime may see more cores.
+      if (core->index >= replica_count.load(std::memory_order_acquire))
+        return nullptr;
+      return &r[core->index];
+    }
+
+    T peek_shared(Epoch& e)
+    {
+      UNUSED(e);
+      auto local_content = get<T>();
+      yield();
+      Immutable::acquire(local_content);
+      return local_content;
+    }
+
+    /**
+     * Implements `peek`, using the epoch `outer` if the caller has entered
+     * one, and otherwise entering one only if the replica is stale.
+     */
+    T peek_inner(Epoch* outer)
+    {
+      auto r = get_replica();
+      if (r == nullptr)
+      {
+        if (outer != nullptr)
+          return peek_shared(*outer);
+        Epoch e;
+        return peek_shared(e);
+      }
+
+      snmalloc::FlagLock l(r->lock);
+      auto v = version();
+      if (r->version != v)
+      {
+        std::optional<Epoch> local;
+        if (outer == nullptr)
+          outer = &local.emplace();
+
+        // The value read is at least as new as `v`, as updates publish the
+        // value before the version.  If it is newer, the next peek refreshes
+        // again.
+        auto fresh = peek_shared(*outer);
+        auto old = r->value;
+        r->value = fresh;
+        r->version = v;
+        VERONA_LOG << "Refreshed replica of " << this << " on core "
+                   << Scheduler::local_core()->index << " to " << fresh
+                   << Logging::endl;
+
+        if (old != nullptr)
+          outer->dec_in_epoch(old);
+      }
+
+      // The replica holds a reference, so no epoch is needed.
+      Immutable::acquire(r->value);
+      return r->value;
+    }
+
+  public:
+    ReplicatedNoticeboard(T content_)
+    {
+      is_fundamental = false;
+      put(content_);
+    }
+
+    ReplicatedNoticeboard(const ReplicatedNoticeboard&) = delete;
+
+    ~ReplicatedNoticeboard()
+    {
+      auto r = replicas.load(std::memory_order_acquire);
+      if (r == nullptr)
+        return;
+
+      auto count = replica_count.load(std::memory_order_relaxed);
+      Epoch e;
+      for (size_t i = 0; i < count; i++)
+      {
+        if (r[i].value != nullptr)
+          e.dec_in_epoch(r[i].value);
+      }
+      heap::dealloc(
+        r,
+        snmalloc::aligned_size(alignof(Replica), count * sizeof(Replica)));
+    }
+
+    /**
+     * The references held by replicas are not traced, they are released when
+     * the noticeboard is destroyed.
+     */
+    void trace(ObjectStack& st) const
+    {
+      auto p = get<T>();
+      if (p)
+        st.push(p);
+    }
+
+    // NOTE: the rc of new_o is not incremented
+    void update(T new_o)
+    {
+      assert(new_o->debug_is_immutable());
+      auto local_content = get<T>();
+      VERONA_LOG << "Updating replicated noticeboard " << this << " old value "
+                 << local_content << " new value " << new_o << Logging::endl;
+
+      put(new_o);
+      published();
+      yield();
+      Epoch e;
+      e.dec_in_epoch(local_content);
+    }
+
+    /**
+     * Returns the current value, with its reference count incremented, as
+     * `Noticeboard::peek`.  The value may lag behind an update made on
+     * another core by the time for this core to observe the new version.
+     */
+    T peek()
+    {
+      return peek_inner(nullptr);
+    }
+
+    /**
+     * As `peek`, but uses an epoch the caller has already entered if the
+     * replica must be refreshed, see `Noticeboard::peek(Epoch&)`.
+     */
+    T peek(Epoch& e)
+    {
+      return peek_inner(&e);
+    }
+  };
+
+  /**
+   * A noticeboard holding a small trivially copyable value, such as a
+   * configuration struct, that is read by `peek` without ownership of its
+   * cown.
+   *
+   * The value is copied into the noticeboard by `update`, and out of it by
+   * `peek`, under a sequence lock: an update makes the sequence odd, writes
+   * the value and makes it even again, and a peek retries if the sequence
+   * was odd, or changed while it copied.  So neither allocates, counts
+   * references or enters an `Epoch`, unlike publishing an immutable object
+   * with `Noticeboard`.  A peek spins while an update is in progress, which
+   * is only a few stores, so this suits values of a few cache lines at
+   * most, and updates must not race each other, so should be made by the
+   * behaviours that own the noticeboard.
+   */
+  template<typename T>
+  class SeqlockNoticeboard : public BaseNoticeboard
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    /// Largest value supported, so that a peek is a short copy.
+    static constexpr size_t MAX_SIZE = 256;
+    static_assert(sizeof(T) <= MAX_SIZE, "Use Noticeboard for large values");
+
+    /// The value is held in words, so that racing copies are atomic loads
+    /// and stores rather than data races.
+    static constexpr size_t WORDS =
+      (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    /// Odd while an update is in progress.
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<uint64_t> words[WORDS];
+
+    void store(const T& v)
+    {
+      uint64_t copy[WORDS] = {};
+      std::memcpy(copy, &v, sizeof(T));
+
+      auto s = sequence.load(std::memory_order_relaxed);
+      sequence.store(s + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      for (size_t i = 0; i < WORDS; i++)
+      {
+        words[i].store(copy[i], std::memory_order_relaxed);
+        yield();
+      }
+      sequence.store(s + 2, std::memory_order_release);
+    }
+
+  public:
+    SeqlockNoticeboard(const T& content_)
+    {
+      is_fundamental = true;
+      store(content_);
+    }
+
+    SeqlockNoticeboard(const SeqlockNoticeboard&) = delete;
+
+    /// Nothing to trace, the value holds no references.
+    void trace(ObjectStack&) const {}
+
+    void update(const T& new_value)
+    {
+      VERONA_LOG << "Updating seqlock noticeboard " << this << Logging::endl;
+      store(new_value);
+      published();
+      yield();
+    }
+
+    /**
+     * Returns a copy of the current value.  This may spin briefly while an
+     * update is in progress on another thread.
+     */
+    T peek() const
+    {
+      uint64_t copy[WORDS];
+      while (true)
+      {
+        auto s = sequence.load(std::memory_order_acquire);
+        if ((s & 1) == 0)
+        {
+          for (size_t i = 0; i < WORDS; i++)
+            copy[i] = words[i].load(std::memory_order_relaxed);
+          std::atomic_thread_fence(std::memory_order_acquire);
+          if (sequence.load(std::memory_order_relaxed) == s)
+            break;
+        }
+        yield();
+        Aal::pause();
       }
+
+      alignas(T) unsigned char result[sizeof(T)];
+      std::memcpy(result, copy, sizeof(T));
+      return *std::launder(reinterpret_cast<T*>(result));
     }
   };
 } // namespace verona::rt
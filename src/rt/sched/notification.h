@@ -60,14 +60,13 @@ namespace verona::rt
         behaviour->template get_body<BehaviourWrapper<Be>>();
       Be& body = wrapper->body;
       auto notification = wrapper->notification;
-      Logging::cout() << "Notification: Invoked: " << notification << std::endl;
+      VERONA_LOG << "Notification: Invoked: " << notification << std::endl;
       notification->set_running();
 
       (body)();
 
       behaviour->release_all();
-      Logging::cout() << "Notification: Released all: " << notification
-                      << std::endl;
+      VERONA_LOG << "Notification: Released all: " << notification << std::endl;
 
       behaviour->reset();
 
@@ -82,7 +81,7 @@ namespace verona::rt
     template<typename Be>
     static void destruct(Object* self)
     {
-      Logging::cout() << "Notification: Destruct: " << self << std::endl;
+      VERONA_LOG << "Notification: Destruct: " << self << std::endl;
       auto notification = static_cast<Notification*>(self);
       assert(notification->status == Status::Waiting);
 
@@ -110,8 +109,8 @@ namespace verona::rt
       Systematic::yield();
       status = Status::Running;
       Systematic::yield();
-      Logging::cout() << "Notification: Set running: " << (int)status.load()
-                      << std::endl;
+      VERONA_LOG << "Notification: Set running: " << (int)status.load()
+                 << std::endl;
     }
 
     void finished_running()
@@ -122,22 +121,22 @@ namespace verona::rt
       if (status.compare_exchange_strong(expected, Status::Waiting))
       {
         Systematic::yield();
-        Logging::cout() << "Notification: Finished running: "
-                        << (int)status.load() << std::endl;
+        VERONA_LOG << "Notification: Finished running: " << (int)status.load()
+                   << std::endl;
         Shared::release(this);
         return;
       }
 
       Systematic::yield();
-      Logging::cout() << "Notification: Rescheduling notification: "
-                      << (int)status.load() << std::endl;
+      VERONA_LOG << "Notification: Rescheduling notification: "
+                 << (int)status.load() << std::endl;
       schedule();
     }
 
     void schedule()
     {
       assert(status == Status::Requested);
-      Logging::cout() << "Notification: Scheduling: " << std::endl;
+      VERONA_LOG << "Notification: Scheduling: " << std::endl;
       BehaviourCore::schedule_many(&behaviour, 1);
     }
 
@@ -154,16 +153,16 @@ namespace verona::rt
       if (status.exchange(Status::Requested) == Status::Waiting)
       {
         Systematic::yield();
-        Logging::cout() << "Notification: Notifying: scheduled "
-                        << (int)status.load() << std::endl;
+        VERONA_LOG << "Notification: Notifying: scheduled "
+                   << (int)status.load() << std::endl;
         Shared::acquire(this);
         schedule();
       }
       else
       {
         Systematic::yield();
-        Logging::cout() << "Notification: Notifying: already running"
-                        << (int)status.load() << std::endl;
+        VERONA_LOG << "Notification: Notifying: already running"
+                   << (int)status.load() << std::endl;
       }
     }
 
@@ -173,7 +172,9 @@ namespace verona::rt
      * @tparam Be - The type of the closure that is run
      * @tparam Args - The types of the arguments to construct the closure
      * @param count - The number of cowns required
-     * @param requests - the array of requested cowns to be used
+     * @param requests - the array of requested cowns to be used, each in read
+     * or write mode.  The notification holds its own reference to each cown,
+     * so the requests must not transfer ownership.
      * @param args - The arguments to construct the closure
      * @return Notification* - a shared object that can be repeatedly notified
      * to run the closure on the requested cowns.
@@ -181,15 +182,13 @@ namespace verona::rt
     template<typename Be, typename... Args>
     static Notification* make(size_t count, Request* requests, Args... args)
     {
-      // These assertions are basically checking that we won't break any
-      // alignment assumptions on Be.  If we add some actual alignment, then
-      // this can be improved.
-      static_assert(
-        alignof(Be) <= sizeof(void*), "Alignment not supported, yet!");
-
       // Allocate the behaviour object.
-      auto behaviour_core =
-        BehaviourCore::make(count, invoke<Be>, sizeof(BehaviourWrapper<Be>));
+      auto behaviour_core = BehaviourCore::make(
+        count,
+        invoke<Be>,
+        sizeof(BehaviourWrapper<Be>),
+        false,
+        alignof(BehaviourWrapper<Be>));
       auto wrapper = behaviour_core->template get_body<BehaviourWrapper<Be>>();
       new (&(wrapper->body)) Be(std::forward<Args>(args)...);
 
@@ -206,8 +205,11 @@ namespace verona::rt
       auto* slots = behaviour_core->get_slots();
       for (size_t i = 0; i < count; i++)
       {
+        assert(!requests[i].is_move());
         Shared::acquire(requests[i].cown());
-        new (&slots[i]) Slot(requests[i].cown());
+        auto* s = new (&slots[i]) Slot(requests[i].cown(), i);
+        if (requests[i].is_read())
+          s->set_read_only();
       }
 
       return notification;
@@ -0,0 +1,174 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../region/freeze.h"
+#include "schedulerthread.h"
+#include "work.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace verona::rt
+{
+  /**
+   * A freeze that shares the regions of the graph with idle scheduler
+   * threads.  It computes the same SCCs and reference counts as
+   * `Freeze::apply`.
+   *
+   * A subregion is only reachable from its iso object, so the regions of a
+   * graph can be frozen independently, see `Freeze::apply_region`.  The
+   * calling thread freezes the root region, and if it has subregions,
+   * schedules helpers.  Threads then take regions from a shared stack, and
+   * push the subregions they find.  The SCC computation within a region is
+   * still sequential, so this helps graphs spread over many regions.
+   *
+   * As with `ParallelGC`, the caller never waits for a helper that has not
+   * started, and the shared state is reference counted, so a helper that
+   * starts late finds the work done and returns.
+   */
+  class ParallelFreeze
+  {
+    static constexpr size_t MAX_HELPERS = 15;
+
+    /// State shared by the threads freezing one graph.
+    struct Job
+    {
+      snmalloc::FlagWord lock;
+
+      /// Iso objects of the regions left to freeze, protected by `lock`.
+      ObjectStack isos;
+
+      /// Threads freezing a region, including the owner, protected by `lock`.
+      size_t busy = 1;
+
+      /// Set once every region is frozen, protected by `lock`.
+      bool done = false;
+
+      /// Helpers that have joined and not yet finished.
+      std::atomic<size_t> running{0};
+
+      /// One count for the owner, and one for each scheduled helper.
+      std::atomic<size_t> rc{1};
+    };
+
+    static void release(Job* j)
+    {
+      if (j->rc.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      {
+        j->~Job();
+        heap::dealloc(j, sizeof(Job));
+      }
+    }
+
+    /**
+     * Freeze regions until there are none left.  `busy` says whether the
+     * caller is counted in `Job::busy`, and `found` holds iso objects to
+     * share.
+     */
+    static void work(Job* j, bool busy, ObjectStack& found)
+    {
+      while (true)
+      {
+        Object* p = nullptr;
+        {
+          snmalloc::FlagLock l(j->lock);
+          while (!found.empty())
+            j->isos.push(found.pop());
+
+          if (!j->isos.empty())
+          {
+            p = j->isos.pop();
+            if (!busy)
+            {
+              busy = true;
+              j->busy++;
+            }
+          }
+          else if (busy)
+          {
+            busy = false;
+            if (--j->busy == 0)
+              j->done = true;
+          }
+
+          if (j->done)
+            return;
+        }
+
+        if (p == nullptr)
+        {
+          Systematic::yield();
+          Aal::pause();
+          continue;
+        }
+
+        VERONA_LOG << "Parallel freeze of region: " << p << Logging::endl;
+        Freeze::apply_region(p, found);
+      }
+    }
+
+    /// Runs on a scheduler thread that picks up a helper.
+    static void help(Job* j)
+    {
+      {
+        snmalloc::FlagLock l(j->lock);
+        if (j->done)
+          return;
+        j->running++;
+      }
+
+      ObjectStack found;
+      work(j, false, found);
+      j->running.fetch_sub(1, std::memory_order_release);
+    }
+
+  public:
+    /**
+     * Freeze the graph of the iso object `o`, with the help of up to
+     * `helpers` other scheduler threads.  Falls back to `Freeze::apply` when
+     * not called on a scheduler thread, or without helpers.
+     */
+    static void apply(Object* o, size_t helpers)
+    {
+      assert(o->debug_is_iso());
+      if ((helpers == 0) || (Scheduler::local_core() == nullptr))
+      {
+        Freeze::apply(o);
+        return;
+      }
+
+      ObjectStack found;
+      Freeze::apply_region(o, found);
+      if (found.empty())
+        return;
+
+      auto j = new (heap::alloc(sizeof(Job))) Job;
+      for (size_t i = 0; i < helpers; i++)
+      {
+        j->rc.fetch_add(1, std::memory_order_relaxed);
+        Scheduler::schedule(Closure::make([j](Work*) {
+          help(j);
+          release(j);
+          return true;
+        }));
+      }
+
+      work(j, true, found);
+
+      while (j->running.load(std::memory_order_acquire) != 0)
+      {
+        Systematic::yield();
+        Aal::pause();
+      }
+      release(j);
+    }
+
+    /// As above, with a helper for each of the other cores, up to a limit.
+    static void apply(Object* o)
+    {
+      size_t cores = Scheduler::get_core_count();
+      apply(o, cores > 0 ? std::min(cores - 1, MAX_HELPERS) : 0);
+    }
+  };
+} // namespace verona::rt
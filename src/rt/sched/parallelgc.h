@@ -0,0 +1,447 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../region/region_trace.h"
+#include "schedulerthread.h"
+#include "work.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace verona::rt
+{
+  /**
+   * A collection of a trace region that shares the work with idle scheduler
+   * threads.  It collects the same objects as `RegionTrace::gc`.
+   *
+   * The calling thread owns the region.  It marks from the roots, and
+   * schedules helpers.  Helpers that start before the mark has finished take
+   * packets of objects to trace that other threads have shared, and share
+   * their own while others are waiting.  Objects are marked with an atomic
+   * operation, so each is traced once.  Pointers out of the region found by
+   * helpers are handed back to the owner for the remembered set.
+   *
+   * The owner then sweeps the rings, and runs all finalisers and destructors
+   * itself.  The unreachable trivial objects are deallocated in packets by
+   * the owner and any helpers that start in time.
+   *
+   * The owner never waits for a helper that has not started, so this makes
+   * progress even if every other thread is busy.  The state shared with the
+   * helpers is reference counted, so a helper that starts late finds the
+   * work done and returns.
+   */
+  class ParallelGC
+  {
+    static constexpr size_t PACKET_SIZE = 254;
+
+    /// Fewest objects a thread keeps when it shares its work.
+    static constexpr size_t SHARE_MIN = 16;
+
+    static constexpr size_t MAX_HELPERS = 15;
+
+    struct Packet
+    {
+      Packet* next;
+      size_t count;
+      Object* items[PACKET_SIZE];
+    };
+
+    /// State shared by the threads taking part in a mark or a free.
+    struct Phase
+    {
+      snmalloc::FlagWord lock;
+
+      /// Shared packets of work, protected by `lock`.
+      Packet* work = nullptr;
+
+      /// Packets of objects outside the region, protected by `lock`.
+      Packet* remembered = nullptr;
+
+      /// Threads with work, including the owner, protected by `lock`.
+      size_t busy = 1;
+
+      /// Set once every thread has run out of work, protected by `lock`.
+      bool done = false;
+
+      /// Threads looking for work, read without the lock to decide whether
+      /// to share.
+      std::atomic<size_t> waiting{0};
+
+      /// Helpers that have joined and not yet finished.
+      std::atomic<size_t> running{0};
+
+      /// One count for the owner, and one for each scheduled helper.
+      std::atomic<size_t> rc{1};
+
+      /// Set for the mark, otherwise the work is freeing objects.
+      bool marking;
+
+      Phase(bool marking_) : marking(marking_) {}
+    };
+
+    /// Work held by one thread.
+    struct Local
+    {
+      ObjectStack stack;
+      size_t count = 0;
+
+      /// Objects outside the region, for the remembered set.
+      Packet* remembered = nullptr;
+
+      void push(Object* p)
+      {
+        stack.push(p);
+        count++;
+      }
+
+      Object* pop()
+      {
+        count--;
+        return stack.pop();
+      }
+    };
+
+    static Packet* make_packet()
+    {
+      auto p = static_cast<Packet*>(heap::alloc(sizeof(Packet)));
+      p->next = nullptr;
+      p->count = 0;
+      return p;
+    }
+
+    static void dealloc_packet(Packet* p)
+    {
+      heap::dealloc(p, sizeof(Packet));
+    }
+
+    static Phase* make_phase(bool marking)
+    {
+      return new (heap::alloc(sizeof(Phase))) Phase(marking);
+    }
+
+    static void release(Phase* s)
+    {
+      if (s->rc.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      {
+        s->~Phase();
+        heap::dealloc(s, sizeof(Phase));
+      }
+    }
+
+    static void remember(Local& local, Object* p)
+    {
+      auto r = local.remembered;
+      if ((r == nullptr) || (r->count == PACKET_SIZE))
+      {
+        auto pk = make_packet();
+        pk->next = local.remembered;
+        local.remembered = pk;
+      }
+      local.remembered->items[local.remembered->count++] = p;
+    }
+
+    /// As the loop body of `RegionTrace::mark`, for an object just found.
+    static void visit(Local& local, Object* p)
+    {
+      switch (p->get_class())
+      {
+        case Object::ISO:
+        case Object::MARKED:
+          break;
+
+        case Object::UNMARKED:
+          if (p->try_mark_atomic())
+            local.push(p);
+          break;
+
+        case Object::SCC_PTR:
+          remember(local, p->immutable());
+          break;
+
+        case Object::RC:
+        case Object::SHARED:
+          remember(local, p);
+          break;
+
+        default:
+          assert(0);
+      }
+    }
+
+    /// Move some of this thread's work to the shared packets.
+    static void share(Phase* s, Local& local)
+    {
+      auto pk = make_packet();
+      size_t n = std::min((local.count - SHARE_MIN) / 2, PACKET_SIZE);
+      for (size_t i = 0; i < n; i++)
+        pk->items[pk->count++] = local.pop();
+
+      snmalloc::FlagLock l(s->lock);
+      pk->next = s->work;
+      s->work = pk;
+    }
+
+    /// Take a shared packet, if there is one.  Called with the lock held.
+    static bool take(Phase* s, Local& local)
+    {
+      auto pk = s->work;
+      if (pk == nullptr)
+        return false;
+
+      s->work = pk->next;
+      for (size_t i = 0; i < pk->count; i++)
+        local.push(pk->items[i]);
+      dealloc_packet(pk);
+      return true;
+    }
+
+    /**
+     * Wait for a packet, or for every thread to run out of work.  The caller
+     * is counted in `waiting`.  Returns false once the phase is done.
+     */
+    static bool wait_for_work(Phase* s, Local& local)
+    {
+      while (true)
+      {
+        {
+          snmalloc::FlagLock l(s->lock);
+          if (take(s, local))
+          {
+            s->busy++;
+            s->waiting--;
+            return true;
+          }
+
+          if (s->done)
+          {
+            s->waiting--;
+            return false;
+          }
+        }
+
+        Systematic::yield();
+        Aal::pause();
+      }
+    }
+
+    /// Called by a busy thread that has run out of work.
+    static bool next_work(Phase* s, Local& local)
+    {
+      {
+        snmalloc::FlagLock l(s->lock);
+        if (take(s, local))
+          return true;
+
+        if (--s->busy == 0)
+        {
+          s->done = true;
+          return false;
+        }
+        s->waiting++;
+      }
+
+      return wait_for_work(s, local);
+    }
+
+    /// Process work until the phase is done.  The caller must be busy.
+    static void work(Phase* s, Local& local)
+    {
+      ObjectStack found;
+      do
+      {
+        while (local.count > 0)
+        {
+          if (
+            (local.count > 2 * SHARE_MIN) &&
+            (s->waiting.load(std::memory_order_relaxed) > 0))
+            share(s, local);
+
+          Object* p = local.pop();
+          if (s->marking)
+          {
+            VERONA_LOG << "Parallel mark " << p << Logging::endl;
+            p->trace(found);
+            while (!found.empty())
+              visit(local, found.pop());
+          }
+          else
+          {
+            p->dealloc();
+          }
+        }
+      } while (next_work(s, local));
+    }
+
+    /// Runs on a scheduler thread that picks up a helper.
+    static void help(Phase* s)
+    {
+      {
+        snmalloc::FlagLock l(s->lock);
+        if (s->done)
+          return;
+        s->running++;
+        s->waiting++;
+      }
+
+      Local local;
+      if (wait_for_work(s, local))
+        work(s, local);
+
+      if (local.remembered != nullptr)
+      {
+        auto last = local.remembered;
+        while (last->next != nullptr)
+          last = last->next;
+
+        snmalloc::FlagLock l(s->lock);
+        last->next = s->remembered;
+        s->remembered = local.remembered;
+      }
+
+      s->running.fetch_sub(1, std::memory_order_release);
+    }
+
+    /**
+     * Run the phase on this thread, with up to `helpers` other threads.
+     * Returns once every helper that joined has finished.
+     */
+    static void run(Phase* s, Local& local, size_t helpers)
+    {
+      for (size_t i = 0; i < helpers; i++)
+      {
+        s->rc.fetch_add(1, std::memory_order_relaxed);
+        Scheduler::schedule(Closure::make([s](Work*) {
+          help(s);
+          release(s);
+          return true;
+        }));
+      }
+
+      work(s, local);
+
+      while (s->running.load(std::memory_order_acquire) != 0)
+      {
+        Systematic::yield();
+        Aal::pause();
+      }
+    }
+
+    static void apply_remembered(RegionTrace* reg, Packet* pk)
+    {
+      while (pk != nullptr)
+      {
+        for (size_t i = 0; i < pk->count; i++)
+          reg->RememberedSet::mark(pk->items[i]);
+
+        auto next = pk->next;
+        dealloc_packet(pk);
+        pk = next;
+      }
+    }
+
+    static void mark(RegionTrace* reg, Object* o, size_t helpers)
+    {
+      auto s = make_phase(true);
+      Local local;
+
+      ObjectStack found;
+      o->trace(found);
+      reg->additional_entry_points.forall([&found](Object* p) {
+        VERONA_LOG << "Additional root: " << p << Logging::endl;
+        found.push(p);
+      });
+      while (!found.empty())
+        visit(local, found.pop());
+
+      run(s, local, helpers);
+
+      apply_remembered(reg, local.remembered);
+      apply_remembered(reg, s->remembered);
+      s->remembered = nullptr;
+      release(s);
+    }
+
+    static void free_all(ObjectStack& deferred, size_t helpers)
+    {
+      auto s = make_phase(false);
+      Local local;
+
+      // Hand out all the objects as packets.
+      size_t packets = 0;
+      while (!deferred.empty())
+      {
+        auto pk = make_packet();
+        while ((pk->count < PACKET_SIZE) && !deferred.empty())
+          pk->items[pk->count++] = deferred.pop();
+        pk->next = s->work;
+        s->work = pk;
+        packets++;
+      }
+
+      // The owner takes the first packet.
+      run(s, local, std::min(helpers, packets > 0 ? packets - 1 : 0));
+      release(s);
+    }
+
+  public:
+    /// Regions using less memory than this are collected by
+    /// `RegionTrace::gc`, as helpers would cost more than they save.
+    static constexpr size_t MIN_MEMORY = 1 << 20;
+
+    /**
+     * Run a garbage collection on the trace region of `o`, with the help of
+     * up to `helpers` other scheduler threads.  This must be called on a
+     * scheduler thread, by the owner of the region.  It falls back to
+     * `RegionTrace::gc` for small regions, or without helpers.
+     */
+    static void gc(Object* o, size_t helpers)
+    {
+      assert(o->debug_is_iso());
+      assert(RegionTrace::is_trace_region(o->get_region()));
+      RegionTrace* reg = RegionTrace::get(o);
+      reg->settle(o);
+
+      if (
+        (helpers == 0) || (reg->current_memory_used < MIN_MEMORY) ||
+        (Scheduler::local_core() == nullptr))
+      {
+        RegionTrace::gc(o);
+        return;
+      }
+
+      VERONA_LOG << "Parallel region GC called for: " << o << Logging::endl;
+
+      RegionTrace::Measure m(reg);
+      mark(reg, o, helpers);
+
+      // As `RegionTrace::sweep`, except that trivial objects are deallocated
+      // afterwards, in parallel.
+      ObjectStack collect;
+      ObjectStack deferred;
+      size_t before = reg->current_memory_used;
+      reg->current_memory_used = 0;
+      auto primary_ring = o->is_trivial() ? RegionTrace::TrivialRing :
+                                            RegionTrace::NonTrivialRing;
+      reg->sweep_ring<RegionTrace::NonTrivialRing, RegionTrace::SweepAll::No>(
+        o, primary_ring, collect);
+      reg->sweep_ring<RegionTrace::TrivialRing, RegionTrace::SweepAll::No>(
+        o, primary_ring, collect, &deferred);
+      reg->RememberedSet::sweep();
+      reg->end_recount(before);
+      reg->previous_memory_used = reg->current_memory_used;
+      reg->stats.collections++;
+
+      free_all(deferred, helpers);
+
+      reg->release_unreachable(collect);
+    }
+
+    /// As above, with a helper for each of the other cores, up to a limit.
+    static void gc(Object* o)
+    {
+      size_t cores = Scheduler::get_core_count();
+      gc(o, cores > 0 ? std::min(cores - 1, MAX_HELPERS) : 0);
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,82 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../region/immutable.h"
+#include "schedulerthread.h"
+#include "work.h"
+
+namespace verona::rt
+{
+  /**
+   * Frees immutable graphs in work items of their own, when
+   * `Immutable::set_background_free` is on.  The thread that releases the
+   * last reference only schedules the root, behind the work already queued
+   * on its core.
+   *
+   * The SCC roots found while freeing a graph are independent, so a work item
+   * that has freed a batch of SCCs and has more roots waiting hands all but
+   * one of them to a new work item on another core, where idle threads can
+   * steal it.
+   */
+  class Reclaimer
+  {
+    /// SCCs a work item frees between offers to split its roots.
+    static constexpr size_t SPLIT_EVERY = 64;
+
+    static void schedule(LinkedObjectStack roots, bool fifo)
+    {
+      Scheduler::schedule(
+        Closure::make([roots](Work*) mutable {
+          run(roots);
+          return true;
+        }),
+        fifo);
+    }
+
+    static void run(LinkedObjectStack& roots)
+    {
+      size_t sccs = 0;
+      Immutable::free_all(roots, [&sccs](LinkedObjectStack& dfs) {
+        if (((++sccs % SPLIT_EVERY) != 0) || dfs.empty())
+          return;
+
+        Object* top = dfs.pop();
+        if (!dfs.empty())
+        {
+          VERONA_LOG << "Reclaimer splitting work" << Logging::endl;
+          schedule(dfs, false);
+        }
+
+        dfs = LinkedObjectStack();
+        dfs.push(top);
+      });
+    }
+
+  public:
+    /**
+     * Schedule the graph of the SCC root `root`, whose count has reached
+     * zero, to be freed.  Returns false, and does nothing, if this is not a
+     * scheduler thread.
+     */
+    static bool defer(Object* root)
+    {
+      if (Scheduler::local_core() == nullptr)
+        return false;
+
+      VERONA_LOG << "Reclaimer deferring: " << root << Logging::endl;
+      LinkedObjectStack roots;
+      roots.push(root);
+      schedule(roots, true);
+      return true;
+    }
+  };
+
+  namespace reclaimer
+  {
+    inline bool defer(Object* o)
+    {
+      return Reclaimer::defer(o);
+    }
+  } // namespace reclaimer
+} // namespace verona::rt
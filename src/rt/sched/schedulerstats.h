@@ -2,8 +2,13 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <iostream>
+#include <iterator>
 #include <snmalloc/snmalloc.h>
+#include <string>
 
 namespace verona::rt
 {
@@ -35,20 +40,130 @@ namespace verona::rt
     }
   };
 
-  class SchedulerStats
+  /**
+   * Scheduler counters.  Each core has a set, and adds it to a global set
+   * when it is destroyed, which also counts work done off scheduler threads.
+   *
+   * The counters are always compiled in.  A counter is updated with a relaxed
+   * load and store, rather than an atomic read-modify-write, as it is almost
+   * always only updated by the threads servicing its core, so an update costs
+   * about the same as a plain increment.  An update from another thread, such
+   * as unpausing another core, may occasionally be lost, and reads from other
+   * threads are approximate, which is enough for monitoring.  Each set is on
+   * its own cache lines, so updates on different cores do not contend.
+   *
+   * `ThreadPool::stats_snapshot` totals the counters at any point while the
+   * runtime is running, for instance to export them.  Building with
+   * `USE_SCHED_STATS` also measures the values that cost more to gather,
+   * behaviour latencies and region memory, and dumps the global counters at
+   * teardown.
+   */
+  class alignas(64) SchedulerStats
   {
+  public:
+    static constexpr size_t BEHAVIOUR_BUCKETS = 16;
+    static constexpr size_t BATCH_BUCKETS = 16;
+    static constexpr size_t PRIORITIES = 3;
+    /// Scheduling groups, see `SchedulingGroups`.
+    static constexpr size_t GROUPS = 8;
+    /// Latencies are bucketed by ceil(log2(ticks)), the last bucket for any
+    /// longer.
+    static constexpr size_t LATENCY_BUCKETS = 32;
+
+    /**
+     * Phases of a behaviour that have a latency histogram.
+     */
+    enum class Phase : size_t
+    {
+      /// Time in `schedule_many` acquiring the behaviour's slots, from
+      /// `when`.
+      Acquire,
+      /// Time from the last cown resolving until the body starts.
+      Queue,
+      /// Time running the body.
+      Execute,
+      /// Time a work item waited in a core's queue, if it is age aware, see
+      /// `WorkStealingQueue::set_age_aware`.  Only built with
+      /// `USE_AGE_STATS`.
+      Age,
+    };
+    static constexpr size_t PHASES = 4;
+
+    /// Default for `ThreadPool::set_latency_sample_period`.
+    static constexpr size_t DEFAULT_SAMPLE_PERIOD = 64;
+
+    /**
+     * Index of each counter, in the order they are dumped.
+     */
+    enum Counter : size_t
+    {
+      Steal,
+      /// Steals that found the victim's queue empty, or in use.
+      StealEmpty,
+      StealContended,
+      /// Attempts to steal, whether they succeeded or not.
+      StealAttempt,
+      /// Successful steals that took a single item.
+      StealSingle,
+      /// Items moved to this core's queue by steals, besides the one run.
+      StealMoved,
+      /// Successful steals prompted by the fairness token, rather than by
+      /// this core running out of work.
+      StealFairness,
+      /// Successful steals from a core on another NUMA node.
+      StealRemote,
+      Lifo,
+      Pause,
+      Unpause,
+      Blocking,
+      Continuation,
+      Rerun,
+      /// Behaviours whose body was skipped, as they were cancelled.
+      Cancelled,
+      /// Behaviours run, including those cancelled and each rerun.
+      Executed,
+      CownCount,
+      /// Behaviours with a deadline that started before, or after, it.
+      DeadlineMet,
+      DeadlineMissed,
+      /// Bytes of region objects allocated and freed.
+      RegionAllocated,
+      RegionFreed,
+      /// Threads started for this core after the runtime started, and the
+      /// total ticks from the start until then, see
+      /// `ThreadPool::set_lazy_start`.
+      Spawn,
+      SpawnTicks,
+      /// Behaviours created, by number of cowns, the last bucket for any more.
+      Behaviour,
+      /// Histogram of next_work batch sizes, bucketed by ceil(log2(size)).
+      BatchSize = Behaviour + BEHAVIOUR_BUCKETS,
+      /// Behaviours run, and total ticks spent queued, for each priority
+      /// class, interleaved.
+      Queued = BatchSize + BATCH_BUCKETS,
+      /// Latency histogram of each `Phase`, one after the other.
+      Latency = Queued + (2 * PRIORITIES),
+      /// Work run, and total ticks spent running it, for each scheduling
+      /// group, interleaved.  Only counted while scheduling groups are
+      /// enabled, see `ThreadPool::set_group_weight`.
+      Group = Latency + (PHASES * LATENCY_BUCKETS),
+      COUNTERS = Group + (2 * GROUPS)
+    };
+
+    /// The values of all counters, indexed by `Counter`.
+    using Snapshot = std::array<size_t, COUNTERS>;
+
   private:
-#ifdef USE_SCHED_STATS
-    std::atomic<size_t> steal_count{0};
-    std::atomic<size_t> pause_count{0};
-    std::atomic<size_t> unpause_count{0};
-    std::atomic<size_t> lifo_count{0};
-    std::array<std::atomic<size_t>, 16> behaviour_count{};
-    std::atomic<size_t> cown_count{0};
-#endif
+    std::array<std::atomic<size_t>, COUNTERS> counters{};
+
+    void bump(size_t index, size_t n = 1)
+    {
+      auto& c = counters[index];
+      c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
   public:
     ~SchedulerStats()
-#ifdef USE_SCHED_STATS
     {
       static snmalloc::FlagWord lock;
       auto& global = get_global();
@@ -59,119 +174,338 @@ namespace verona::rt
         global.add(*this);
       }
     }
-#else
-      = default;
-#endif
 
-    void steal()
+    /**
+     * Record a successful steal, that also moved `moved` items to this
+     * core's queue.  `fairness` is set if the steal was prompted by the
+     * fairness token, and `remote` if the victim is on another NUMA node.
+     */
+    void steal(size_t moved, bool fairness, bool remote)
     {
-#ifdef USE_SCHED_STATS
-      steal_count++;
-#endif
+      bump(StealAttempt);
+      bump(Steal);
+      if (moved == 0)
+        bump(StealSingle);
+      else
+        bump(StealMoved, moved);
+      if (fairness)
+        bump(StealFairness);
+      if (remote)
+        bump(StealRemote);
+    }
+
+    void steal_failed(bool contended)
+    {
+      bump(StealAttempt);
+      bump(contended ? StealContended : StealEmpty);
     }
 
     void pause()
     {
-#ifdef USE_SCHED_STATS
-      pause_count++;
-#endif
+      bump(Pause);
     }
 
     void unpause()
     {
-#ifdef USE_SCHED_STATS
-      unpause_count++;
-#endif
+      bump(Unpause);
     }
 
     void lifo()
     {
-#ifdef USE_SCHED_STATS
-      lifo_count++;
-#endif
+      bump(Lifo);
+    }
+
+    void blocking()
+    {
+      bump(Blocking);
+    }
+
+    void continuation()
+    {
+      bump(Continuation);
+    }
+
+    void rerun()
+    {
+      bump(Rerun);
+    }
+
+    void cancelled()
+    {
+      bump(Cancelled);
+    }
+
+    void executed()
+    {
+      bump(Executed);
     }
 
     void behaviour(size_t cowns)
     {
-      UNUSED(cowns);
-#ifdef USE_SCHED_STATS
-      if (cowns < behaviour_count.size())
-        behaviour_count[cowns]++;
-      else
-        behaviour_count.back()++;
-#endif
+      bump(Behaviour + std::min(cowns, BEHAVIOUR_BUCKETS - 1));
+    }
+
+    void batch_size(size_t size)
+    {
+      size_t bucket = bits::next_pow2_bits(size);
+      bump(BatchSize + std::min(bucket, BATCH_BUCKETS - 1));
+    }
+
+    /**
+     * Record that a behaviour of priority class `priority` waited `ticks`
+     * between becoming runnable and starting to run.
+     */
+    void queue_latency(size_t priority, uint64_t ticks)
+    {
+      if (priority < PRIORITIES)
+      {
+        bump(Queued + (2 * priority));
+        bump(Queued + (2 * priority) + 1, ticks);
+      }
+      latency(Phase::Queue, ticks);
+    }
+
+    /**
+     * Record that `phase` of a behaviour took `ticks`.
+     */
+    void latency(Phase phase, uint64_t ticks)
+    {
+      size_t bucket = 0;
+      if (ticks > 1)
+        bucket = std::min(
+          (size_t)bits::next_pow2_bits((size_t)ticks), LATENCY_BUCKETS - 1);
+      bump(Latency + ((size_t)phase * LATENCY_BUCKETS) + bucket);
+    }
+
+    /**
+     * An upper bound on the `percent` percentile of the latency of `phase`
+     * in `snapshot`, from its histogram, so within a factor of two of the
+     * true value, or zero if nothing has been recorded.  For instance, the
+     * 99th percentile of `Phase::Age` of each core, see
+     * `ThreadPool::core_stats_snapshots`, shows whether stealing keeps up
+     * under skew.
+     */
+    static uint64_t
+    latency_percentile(const Snapshot& snapshot, Phase phase, size_t percent)
+    {
+      size_t first = Latency + ((size_t)phase * LATENCY_BUCKETS);
+      size_t total = 0;
+      for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+        total += snapshot[first + i];
+      if (total == 0)
+        return 0;
+
+      // The rank of the percentile, rounded up, and at least the first.
+      size_t rank = std::max<size_t>(((total * percent) + 99) / 100, 1);
+      size_t seen = 0;
+      for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+      {
+        seen += snapshot[first + i];
+        if (seen >= rank)
+          return uint64_t(1) << i;
+      }
+      return uint64_t(1) << (LATENCY_BUCKETS - 1);
+    }
+
+    /**
+     * Returns true once every `period` calls on this thread, and never if
+     * `period` is 0.  Used to time only some behaviours, so that timing
+     * costs little.
+     */
+    static bool sample(size_t period)
+    {
+      static thread_local size_t countdown = 0;
+      if (period == 0)
+        return false;
+      if (countdown != 0)
+      {
+        countdown--;
+        return false;
+      }
+      countdown = period - 1;
+      return true;
+    }
+
+    /**
+     * Record that work of scheduling group `group` ran for `ticks`.
+     */
+    void group_run(size_t group, uint64_t ticks)
+    {
+      bump(Group + (2 * group));
+      bump(Group + (2 * group) + 1, ticks);
+    }
+
+    void deadline(bool missed)
+    {
+      bump(missed ? DeadlineMissed : DeadlineMet);
+    }
+
+    /**
+     * Record `allocated` and `freed` bytes of region objects, see
+     * `RegionMemoryStats`.
+     */
+    void region_memory(size_t allocated, size_t freed)
+    {
+      bump(RegionAllocated, allocated);
+      bump(RegionFreed, freed);
+    }
+
+    /**
+     * Record that a thread was started for this core `ticks` after the
+     * runtime started.
+     */
+    void spawn(uint64_t ticks)
+    {
+      bump(Spawn);
+      bump(SpawnTicks, ticks);
     }
 
     void cown()
     {
-#ifdef USE_SCHED_STATS
-      cown_count++;
-#endif
+      bump(CownCount);
     }
 
     void add(SchedulerStats& that)
     {
-      UNUSED(that);
+      // The global counters can also be updated by threads outside the
+      // scheduler, so this is a real read-modify-write.
+      for (size_t i = 0; i < COUNTERS; i++)
+        counters[i].fetch_add(
+          that.counters[i].load(std::memory_order_relaxed),
+          std::memory_order_relaxed);
+    }
 
-#ifdef USE_SCHED_STATS
-      steal_count += that.steal_count;
-      pause_count += that.pause_count;
-      unpause_count += that.unpause_count;
-      lifo_count += that.lifo_count;
-      cown_count += that.cown_count;
-
-      for (size_t i = 0; i < behaviour_count.size(); i++)
-        behaviour_count[i] += that.behaviour_count[i];
-#endif
+    /**
+     * The current value of the counter at `index`.
+     */
+    size_t get(size_t index) const
+    {
+      return counters[index].load(std::memory_order_relaxed);
     }
 
-    void dump(std::ostream& o, uint64_t dumpid = 0)
+    /**
+     * Add the current value of each counter to `snapshot`.
+     */
+    void add_to(Snapshot& snapshot) const
     {
-      UNUSED(o);
-      UNUSED(dumpid);
+      for (size_t i = 0; i < COUNTERS; i++)
+        snapshot[i] += counters[i].load(std::memory_order_relaxed);
+    }
 
-#ifdef USE_SCHED_STATS
+    /**
+     * The name of the counter at `index`, as used for the headers of `dump`.
+     */
+    static std::string name(size_t index)
+    {
+      static constexpr const char* names[] = {
+        "Steal",
+        "Steal empty",
+        "Steal contended",
+        "Steal attempt",
+        "Steal single",
+        "Steal moved",
+        "Steal fairness",
+        "Steal remote",
+        "LIFO",
+        "Pause",
+        "Unpause",
+        "Blocking",
+        "Continuation",
+        "Rerun",
+        "Cancelled",
+        "Executed",
+        "Cown count",
+        "Deadline met",
+        "Deadline missed",
+        "Region allocated",
+        "Region freed",
+        "Spawn",
+        "Spawn ticks"};
+      static_assert(std::size(names) == Behaviour);
+
+      if (index < Behaviour)
+        return names[index];
+      if (index < BatchSize)
+        return std::to_string(index - Behaviour);
+      if (index < Queued)
+        return "Batch 2^" + std::to_string(index - BatchSize);
+      if (index >= Group)
+      {
+        auto group = std::to_string((index - Group) / 2);
+        if (((index - Group) % 2) == 0)
+          return "Group " + group + " run";
+        return "Group " + group + " ticks";
+      }
+      if (index >= Latency)
+      {
+        static constexpr const char* phases[] = {
+          "Acquire", "Queue", "Execute", "Age"};
+        static_assert(std::size(phases) == PHASES);
+        auto i = index - Latency;
+        return std::string(phases[i / LATENCY_BUCKETS]) + " 2^" +
+          std::to_string(i % LATENCY_BUCKETS);
+      }
+
+      auto priority = std::to_string((index - Queued) / 2);
+      if (((index - Queued) % 2) == 0)
+        return "Priority " + priority + " run";
+      return "Priority " + priority + " queued ticks";
+    }
+
+    /**
+     * Write the counters as a row of CSV, preceded by the headers if `dumpid`
+     * is 0, and reset them.
+     */
+    void dump(std::ostream& o, uint64_t dumpid = 0)
+    {
       CSVStream csv(o);
 
       if (dumpid == 0)
       {
-        // Output headers for initial dump
-        // Keep in sync with data dump
         csv << "SchedulerStats"
             << "Tag"
-            << "DumpID"
-            << "Steal"
-            << "LIFO"
-            << "Pause"
-            << "Unpause"
-            << "Cown count";
-
-        for (size_t i = 0; i < behaviour_count.size(); i++)
-          csv << i;
-
+            << "DumpID";
+        for (size_t i = 0; i < COUNTERS; i++)
+          csv << name(i);
         csv << std::endl;
       }
 
-      csv << "SchedulerStats" << get_tag() << dumpid << steal_count
-          << lifo_count << pause_count << unpause_count << cown_count;
-
-      for (size_t i = 0; i < behaviour_count.size(); i++)
-        csv << behaviour_count[i];
+      csv << "SchedulerStats" << get_tag() << dumpid;
+      for (size_t i = 0; i < COUNTERS; i++)
+        csv << counters[i].exchange(0, std::memory_order_relaxed);
       csv << std::endl;
+    }
 
-      steal_count = 0;
-      pause_count = 0;
-      unpause_count = 0;
-      lifo_count = 0;
-      cown_count = 0;
+    /**
+     * Write the counters of the core with index `core` as a row of CSV,
+     * preceded by the headers if `core` is 0.  Unlike `dump`, this does not
+     * reset them, as they are still to be added to the global counters.
+     */
+    void dump_core(std::ostream& o, uint64_t dumpid, size_t core)
+    {
+      CSVStream csv(o);
 
-      for (size_t i = 0; i < behaviour_count.size(); i++)
-        behaviour_count[i] = 0;
-#endif
+      if (core == 0)
+      {
+        csv << "SchedulerStatsCore"
+            << "Tag"
+            << "DumpID"
+            << "Core";
+        for (size_t i = 0; i < COUNTERS; i++)
+          csv << name(i);
+        csv << std::endl;
+      }
+
+      csv << "SchedulerStatsCore" << get_tag() << dumpid << core;
+      for (size_t i = 0; i < COUNTERS; i++)
+        csv << get(i);
+      csv << std::endl;
     }
 
     static void dump_global(std::ostream& o, uint64_t dumpid)
     {
+      UNUSED(o);
+      UNUSED(dumpid);
 #ifdef USE_SCHED_STATS
       get_global().dump(o, dumpid);
 #endif
@@ -2,7 +2,14 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../debug/costmodel.h"
+#include "../debug/probes.h"
 #include "../debug/systematic.h"
+#include "../debug/trace.h"
+#include "../pal/prefault.h"
+#include "../region/region_base.h"
+#include "behaviourpool.h"
+#include "behaviourprofile.h"
 #include "core.h"
 #include "ds/dllist.h"
 #include "ds/hashmap.h"
@@ -12,7 +19,11 @@
 #include "schedulerstats.h"
 #include "threadpool.h"
 
+#include <algorithm>
+#include <array>
+#include <optional>
 #include <snmalloc/snmalloc.h>
+#include <utility>
 
 namespace verona::rt
 {
@@ -27,7 +38,9 @@ namespace verona::rt
    * occurs at a rate inversely proportional to the amount of cowns pending work
    * on that thread. A scheduler thread will enqueue a new token, if its
    * previous one has been dequeued or stolen, once more work is scheduled on
-   * the scheduler thread.
+   * the scheduler thread.  With `FairnessPolicy::Adaptive`, the number of
+   * steals each time the token is dequeued instead depends on how much longer
+   * the victim's queue is than this one, see `fair_steals`.
    */
   class SchedulerThread
   {
@@ -44,7 +57,10 @@ namespace verona::rt
     template<typename Owner>
     friend class Noticeboard;
 
-    static constexpr uint64_t TSC_QUIESCENCE_TIMEOUT = 1'000'000;
+    /// How many ticks to spin looking for work before trying to pause.  This
+    /// adapts to how long we typically wait for work to arrive, see
+    /// `ThreadPool::set_spin_timeout`.
+    uint64_t quiescence_timeout = 0;
 
     Core* core = nullptr;
 #ifdef USE_SYSTEMATIC_TESTING
@@ -57,12 +73,105 @@ namespace verona::rt
 
     Core* victim = nullptr;
 
+    /// Positions in the current core's local and remote victim lists.
+    size_t local_victim_index = 0;
+    size_t remote_victim_index = 0;
+
+    /// Consecutive failed local steals since the last remote steal attempt.
+    size_t local_steal_failures = 0;
+
+    /// Set if the current victim is on a remote NUMA node.
+    bool victim_is_remote = false;
+
+    /// Work taken from the core's queue since the token was last dequeued.
+    size_t since_token = 0;
+
+    /// Steals for fairness still to be made, one in each batch.
+    size_t pending_fair_steals = 0;
+
+    /// Most steals for fairness in one cycle of the token.
+    static constexpr size_t MAX_FAIR_STEALS = 8;
+
+    /// Most times to wait for I/O to complete, before parking or when the
+    /// ring is full, before giving up, see `IOQueue::WAIT_NS`.
+    static constexpr size_t IO_DRAIN_POLLS = 16;
+
     /// Local work item to avoid overhead of synchronisation
     /// on scheduler queue.
     Work* next_work = nullptr;
 
+    /// Scheduling group of the work about to run, see `take_grouped`.
+    size_t running_group = 0;
+
+    /**
+     * Work destined for another core, linked in FIFO order, that has not yet
+     * been published to that core's queue.
+     */
+    struct StagedWork
+    {
+      Core* target = nullptr;
+      Work* first = nullptr;
+      Work* last = nullptr;
+      size_t count = 0;
+    };
+
+    static constexpr size_t STAGED_TARGETS = 4;
+    static constexpr size_t STAGED_LIMIT = 32;
+
+    /// Blocks of each size class put in the behaviour pool by `warm_up`.
+    static constexpr size_t PREFILL_BLOCKS = 32;
+
+    std::array<StagedWork, STAGED_TARGETS> staged{};
+    size_t staged_targets = 0;
+
+    /// Successor to run as soon as the current work item finishes, see
+    /// `ThreadPool::set_continuation_depth`.
+    Work* continuation = nullptr;
+
+    /// Number of continuations run since the last call to `get_work`.
+    size_t continuations_run = 0;
+
+    /// New behaviour to run as soon as the current work item finishes, see
+    /// `ThreadPool::set_eager_depth`.
+    Work* eager = nullptr;
+
+    /// Number of behaviours run eagerly since the last call to `get_work`.
+    size_t eager_run = 0;
+
+    /// Set while a work item runs, which is when `eager` will be run next.
+    bool in_work = false;
+
+    /// Behaviours that have yielded, oldest first, linked through
+    /// `next_in_queue`.  These are kept off `core->q` so that they are not
+    /// stolen, see `schedule_rerun`.
+    Work* rerun_head = nullptr;
+    Work* rerun_tail = nullptr;
+
+#ifdef USE_BEHAVIOUR_POOL
+    /// Cache of behaviour memory for behaviours created on this thread.
+    BehaviourPool behaviour_pool;
+#endif
+
+    /// The `MemoryPressure::generation` this thread last responded to.
+    uint64_t pressure_seen = 0;
+
+    /// Where this thread publishes the work it is running, see
+    /// `BehaviourProfile`.  Held while `run_inner` runs.
+    BehaviourProfile* profile = nullptr;
+
+    /// Epoch held for the current batch, see `ThreadPool::set_batch_epoch`.
+    std::optional<Epoch> batch_epoch;
+
     bool running = true;
 
+#ifndef USE_SYSTEMATIC_TESTING
+    /// Used to sleep while this thread's core is parked.  `park_sleeping` is
+    /// set while the thread may be sleeping, and a waker that clears it is
+    /// responsible for the matching wake.
+    pal::SleepHandle park_handle;
+    std::atomic<bool> park_sleeping{false};
+#endif
+
     /// SchedulerList pointers.
     SchedulerThread* prev = nullptr;
     SchedulerThread* next = nullptr;
@@ -71,7 +180,7 @@ namespace verona::rt
 
     SchedulerThread()
     {
-      Logging::cout() << "Scheduler Thread created" << Logging::endl;
+      VERONA_LOG << "Scheduler Thread created" << Logging::endl;
     }
 
     ~SchedulerThread() {}
@@ -84,11 +193,197 @@ namespace verona::rt
     inline void stop()
     {
       running = false;
+      unpark();
+    }
+
+    /**
+     * Wake this thread if it is parked and its core is active again, or the
+     * runtime is stopping.
+     */
+    void unpark()
+    {
+#ifndef USE_SYSTEMATIC_TESTING
+      if (park_sleeping.exchange(false, std::memory_order_seq_cst))
+        park_handle.wake();
+#endif
+    }
+
+    bool should_stay_parked()
+    {
+      return running && core->parked.load(std::memory_order_seq_cst);
+    }
+
+    /**
+     * Move the work queued on this core to cores that are available, and
+     * wake threads to run it.  Used when this thread is about to stop
+     * running work for a while.
+     */
+    void hand_off_work()
+    {
+      return_next_work();
+      // The local deque is only popped by this thread, so would otherwise
+      // wait for thieves to take its work one item at a time.
+      spill_local();
+      drain_inboxes();
+
+      Work* work;
+      while ((work = core->q.dequeue()) != nullptr)
+        schedule_fifo_on(Scheduler::round_robin(), work);
+      while ((work = take_rerun()) != nullptr)
+        schedule_fifo_on(Scheduler::round_robin(), work);
+      for (size_t group = 1; group < SCHEDULING_GROUPS; group++)
+      {
+        while ((work = core->groups.dequeue(group)) != nullptr)
+          schedule_grouped(Scheduler::round_robin(), work, group);
+      }
+
+      // Urgent work is left for thieves, as it cannot be moved without
+      // losing its deadline, so make sure someone is awake to take it.
+      if (!core->high_priority_q.is_empty() || !core->deadline_q.is_empty())
+        Scheduler::get().unpause();
+    }
+
+    /**
+     * Enter an epoch for the rest of the batch, if enabled, so that epochs
+     * entered by the work in it, such as by noticeboard peeks, are nested and
+     * cheap.
+     */
+    void enter_batch_epoch()
+    {
+      if (!batch_epoch.has_value() && Scheduler::get().batch_epoch)
+        batch_epoch.emplace();
+    }
+
+    /**
+     * Leave the epoch held for the batch, so that this thread does not hold
+     * the epoch back while it looks for work, parks or blocks.
+     */
+    void exit_batch_epoch()
+    {
+      batch_epoch.reset();
+    }
+
+    void enter_blocking_section()
+    {
+      VERONA_LOG << "Entering blocking section on core " << core->affinity
+                 << Logging::endl;
+      exit_batch_epoch();
+      core->stats.blocking();
+      core->blocked.store(true, std::memory_order_seq_cst);
+      flush_staged();
+      hand_off_work();
+    }
+
+    void exit_blocking_section()
+    {
+      core->blocked.store(false, std::memory_order_release);
+      VERONA_LOG << "Leaving blocking section on core " << core->affinity
+                 << Logging::endl;
+      enter_batch_epoch();
+    }
+
+    /**
+     * Called when this thread's core has been parked.  Hands the core's work
+     * to the active cores, and then sleeps until the core is active again.
+     *
+     * While parked, the thread does not count as active, so the runtime can
+     * still reach quiescence.  Work that arrives on a parked core later is
+     * picked up by thieves, as parked cores stay in every victim list.
+     */
+    SNMALLOC_SLOW_PATH void park()
+    {
+      VERONA_LOG << "Parking core " << core->affinity << Logging::endl;
+
+      // Only this thread collects the core's I/O, so finish it first.  I/O
+      // such as a receive on a socket may never complete, so rather than
+      // wait for it, stay active for now, and try again later.
+      for (size_t i = 0; (i < IO_DRAIN_POLLS) && core->io.is_active(); i++)
+        poll_io(true);
+      if (core->io.is_active())
+        return;
+
+      auto& pool = Scheduler::get();
+      hand_off_work();
+
+      {
+        auto h = pool.sync.handle(this);
+        pool.state.dec_active_threads();
+      }
+
+#ifdef USE_SYSTEMATIC_TESTING
+      Systematic::yield_until([this]() { return !should_stay_parked(); });
+#else
+      while (true)
+      {
+        park_sleeping.store(true, std::memory_order_seq_cst);
+        if (!should_stay_parked())
+        {
+          // If a waker has already cleared the flag, consume its wake.
+          if (!park_sleeping.exchange(false, std::memory_order_seq_cst))
+            park_handle.sleep();
+          break;
+        }
+        park_handle.sleep();
+      }
+#endif
+
+      {
+        auto h = pool.sync.handle(this);
+        pool.state.inc_active_threads();
+      }
+
+      VERONA_LOG << "Unparking core " << core->affinity << Logging::endl;
+    }
+
+    /**
+     * Pass this core's submitted I/O to the kernel, and queue the work of
+     * any that has completed on this core, see `IOQueue`.  If `wait`, sleep
+     * in the kernel for a while if nothing has completed yet.
+     *
+     * While a core has I/O in flight it counts as an external event source,
+     * so that the runtime does not stop before the I/O completes.
+     */
+    void poll_io(bool wait = false)
+    {
+      if (SNMALLOC_LIKELY(!core->io.is_active()))
+        return;
+
+      auto completed = core->io.poll(
+        [this](IORequest* req) { core->q.enqueue(req->work); }, wait);
+
+      if ((completed != 0) && !core->io.is_active())
+        Scheduler::remove_external_event_source();
+    }
+
+    /**
+     * Start `op` on this core's I/O queue.  If it cannot be queued, as there
+     * is no io_uring, or the ring stays full, run it synchronously in a
+     * blocking section, as it may block, for instance on a socket.
+     */
+    void submit_io(const IOOp& op, IORequest* req)
+    {
+      for (size_t i = 0; (i < IO_DRAIN_POLLS) && core->io.is_full(); i++)
+        poll_io(true);
+
+      bool was_active = core->io.is_active();
+      if (core->io.is_full() || !core->io.submit(op, req))
+      {
+        if (op.opcode == IOOpcode::Nop)
+          req->result = 0;
+        else
+          Scheduler::blocking_section(
+            [&op, req]() { req->result = IOQueue::run_synchronously(op); });
+        schedule_fifo(req->work);
+        return;
+      }
+
+      if (!was_active)
+        Scheduler::add_external_event_source();
     }
 
     inline void schedule_fifo(Work* w)
     {
-      Logging::cout() << "Enqueue work " << w << Logging::endl;
+      VERONA_LOG << "Enqueue work " << w << Logging::endl;
 
       // If we already have a work item then we need to enqueue it.
       return_next_work();
@@ -97,20 +392,321 @@ namespace verona::rt
       next_work = w;
     }
 
+    inline void schedule_rerun(Work* w)
+    {
+      VERONA_LOG << "Enqueue rerun " << w << Logging::endl;
+
+      w->next_in_queue.store(nullptr, std::memory_order_relaxed);
+      if (rerun_tail == nullptr)
+        rerun_head = w;
+      else
+        rerun_tail->next_in_queue.store(w, std::memory_order_relaxed);
+      rerun_tail = w;
+    }
+
+    Work* take_rerun()
+    {
+      auto w = rerun_head;
+      if (w != nullptr)
+      {
+        rerun_head = w->next_in_queue.load(std::memory_order_relaxed);
+        if (rerun_head == nullptr)
+          rerun_tail = nullptr;
+      }
+      return w;
+    }
+
+    /// Charge the cost model for an enqueue onto `c` from another core.
+    static void cost_remote_enqueue(Core* c)
+    {
+      if constexpr (CostModel::enabled)
+      {
+        auto t = Scheduler::local();
+        if ((t != nullptr) && (t->core != c))
+          CostModel::remote_enqueue();
+      }
+    }
+
+    /**
+     * Wake threads for `count` items of work just queued on `c`.  In
+     * share-nothing mode, only the thread of `c` can run them, so make sure
+     * that it is awake.
+     */
+    static void unpause_for(Core* c, size_t count = 1)
+    {
+      auto& pool = Scheduler::get();
+      if (pool.unpause(count, c))
+      {
+        c->stats.unpause();
+        Trace::record(TraceKind::Unpause, c->index);
+      }
+
+      if (pool.share_nothing)
+        pool.wake_core(c);
+    }
+
     static inline void schedule_lifo(Core* c, Work* w)
     {
       // A lifo scheduled cown is coming from an external source, such as
       // asynchronous I/O.
-      Logging::cout() << "LIFO scheduling work " << w << " onto " << c->affinity
-                      << Logging::endl;
+      VERONA_LOG << "LIFO scheduling work " << w << " onto " << c->affinity
+                 << Logging::endl;
       c->q.enqueue_front(w);
-      Logging::cout() << "LIFO scheduled work " << w << " onto " << c->affinity
-                      << Logging::endl;
+      cost_remote_enqueue(c);
+      VERONA_LOG << "LIFO scheduled work " << w << " onto " << c->affinity
+                 << Logging::endl;
 
       c->stats.lifo();
 
-      if (Scheduler::get().unpause())
-        c->stats.unpause();
+      unpause_for(c);
+    }
+
+    /**
+     * Queue `count` work items from an external source, linked from `first`
+     * to `last`, at the front of the queue of `c` with a single operation.
+     * Unlike `schedule_lifo`, this only wakes the thread of `c` in
+     * share-nothing mode; the caller wakes threads for the whole batch.
+     */
+    static inline void
+    inject_lifo_segment(Core* c, Work* first, Work* last, size_t count)
+    {
+      VERONA_LOG << "LIFO scheduling " << count << " work items from " << first
+                 << " onto " << c->affinity << Logging::endl;
+      c->q.enqueue_front_segment({first, &last->next_in_queue}, count);
+      cost_remote_enqueue(c);
+      c->stats.lifo();
+
+      auto& pool = Scheduler::get();
+      if (pool.share_nothing)
+        pool.wake_core(c);
+    }
+
+    bool try_continuation(Work* w)
+    {
+      if (
+        (continuation != nullptr) || core->blocked ||
+        (continuations_run >= Scheduler::get().continuation_depth))
+        return false;
+
+      VERONA_LOG << "Continuation " << w << Logging::endl;
+      continuation = w;
+      return true;
+    }
+
+    bool try_eager(Work* w)
+    {
+      if (
+        !in_work || (eager != nullptr) || core->blocked ||
+        (eager_run >= Scheduler::get().eager_depth))
+        return false;
+
+      VERONA_LOG << "Eager " << w << Logging::endl;
+      eager = w;
+      return true;
+    }
+
+    void run_work(Work* work)
+    {
+      VERONA_LOG << "Schedule work " << work << Logging::endl;
+
+      // The time work runs for is only measured with scheduling groups.
+      bool grouped = Scheduler::has_scheduling_groups();
+      uint64_t start = 0;
+      if (SNMALLOC_UNLIKELY(grouped))
+        start = Clock::fast();
+
+      in_work = true;
+      profile->set_running(work->f);
+      work->run();
+      profile->set_running(nullptr);
+      in_work = false;
+
+      if (SNMALLOC_UNLIKELY(grouped))
+        charge_group(Clock::fast() - start);
+
+      if (staged_targets != 0)
+        flush_staged();
+    }
+
+    /**
+     * Charge `ticks` to the scheduling group of the work that just ran, for
+     * picking the next group to run, see `SchedulingGroups`.
+     */
+    void charge_group(uint64_t ticks)
+    {
+      auto group = std::exchange(running_group, 0);
+      core->groups.charge(group, ticks, Scheduler::get_group_weight(group));
+      core->stats.group_run(group, ticks);
+    }
+
+    /**
+     * Take work of a scheduling group other than the default from the
+     * queues of `from`, this core or a victim, if its group has the
+     * smallest pass on this core, where `default_ready` is set if this core
+     * has work of the default group.
+     */
+    Work* take_grouped(Core* from, bool default_ready = false)
+    {
+      if (from->groups.is_empty())
+        return nullptr;
+
+      auto group = core->groups.pick(from->groups, default_ready);
+      if (group == 0)
+        return nullptr;
+
+      auto work = from->groups.dequeue(group);
+      if (work != nullptr)
+        running_group = group;
+      return work;
+    }
+
+    /**
+     * Stage `w` to be enqueued on the core `c`.  The staged work for each
+     * core is published as a single segment by `flush_staged`, after the
+     * current work item, or once `STAGED_LIMIT` items are waiting.
+     */
+    void stage_remote(Core* c, Work* w)
+    {
+      VERONA_LOG << "Stage work " << w << " for " << c->affinity
+                 << Logging::endl;
+      cost_remote_enqueue(c);
+
+      size_t i = 0;
+      while ((i < staged_targets) && (staged[i].target != c))
+        i++;
+
+      if (i == STAGED_TARGETS)
+      {
+        // No free entry, so publish the oldest target to make room.
+        flush_staged(staged[0]);
+        staged[0] = staged[--staged_targets];
+        i = staged_targets;
+      }
+
+      auto& s = staged[i];
+      if (i == staged_targets)
+      {
+        staged_targets++;
+        s = {c, w, nullptr, 0};
+      }
+      else
+      {
+        s.last->next_in_queue.store(w, std::memory_order_relaxed);
+      }
+      s.last = w;
+
+      if (++s.count == STAGED_LIMIT)
+      {
+        flush_staged(s);
+        s = staged[--staged_targets];
+      }
+    }
+
+    /**
+     * Send `w` to the core `c` through the inbox `c` keeps for this core,
+     * see `ThreadPool::set_share_nothing`.  Returns false if the inbox is
+     * full, or `c` is in a blocking section, and `w` must be queued as
+     * usual.
+     */
+    bool deliver(Core* c, Work* w)
+    {
+      if (
+        (core->index >= c->inbox_count) ||
+        c->blocked.load(std::memory_order_relaxed) ||
+        !c->inboxes[core->index].try_enqueue(w))
+        return false;
+
+      VERONA_LOG << "Delivered work " << w << " to " << c->affinity
+                 << Logging::endl;
+      cost_remote_enqueue(c);
+      unpause_for(c);
+      return true;
+    }
+
+    /// Move the work other cores have sent to this core's inboxes onto its
+    /// queue, as a single segment.
+    void drain_inboxes()
+    {
+      Work* first = nullptr;
+      Work* last = nullptr;
+      size_t count = 0;
+      for (size_t i = 0; i < core->inbox_count; i++)
+      {
+        count += core->inboxes[i].dequeue_some(
+          Inbox::capacity(), [&first, &last](Work* w) {
+            if (last == nullptr)
+              first = w;
+            else
+              last->next_in_queue.store(w, std::memory_order_relaxed);
+            last = w;
+          });
+      }
+
+      if (count != 0)
+        core->q.enqueue_segment({first, &last->next_in_queue}, count);
+    }
+
+    void flush_staged(StagedWork& s)
+    {
+      s.target->q.enqueue_segment({s.first, &s.last->next_in_queue}, s.count);
+      VERONA_LOG << "Published " << s.count << " staged work items to "
+                 << s.target->affinity << Logging::endl;
+
+      unpause_for(s.target, s.count);
+    }
+
+    /// Publish all staged work to the target cores.
+    void flush_staged()
+    {
+      for (size_t i = 0; i < staged_targets; i++)
+        flush_staged(staged[i]);
+      staged_targets = 0;
+    }
+
+    static inline void schedule_fifo_on(Core* c, Work* w)
+    {
+      VERONA_LOG << "Enqueue work " << w << " onto " << c->affinity
+                 << Logging::endl;
+      c->q.enqueue(w);
+      cost_remote_enqueue(c);
+      unpause_for(c);
+    }
+
+    static inline void
+    schedule_segment(Core* c, Work* first, Work* last, size_t count)
+    {
+      VERONA_LOG << "Enqueue " << count << " work items from " << first
+                 << " onto " << c->affinity << Logging::endl;
+      c->q.enqueue_segment({first, &last->next_in_queue}, count);
+      cost_remote_enqueue(c);
+      unpause_for(c, count);
+    }
+
+    static inline void schedule_high(Core* c, Work* w)
+    {
+      VERONA_LOG << "Enqueue high priority work " << w << " onto "
+                 << c->affinity << Logging::endl;
+      c->high_priority_q.enqueue(w);
+      cost_remote_enqueue(c);
+      unpause_for(c);
+    }
+
+    static inline void schedule_grouped(Core* c, Work* w, size_t group)
+    {
+      VERONA_LOG << "Enqueue work " << w << " of group " << group << " onto "
+                 << c->affinity << Logging::endl;
+      c->groups.enqueue(w, group);
+      cost_remote_enqueue(c);
+      unpause_for(c);
+    }
+
+    static inline void schedule_deadline(Core* c, Work* w, uint64_t deadline)
+    {
+      VERONA_LOG << "Enqueue work " << w << " with deadline " << deadline
+                 << " onto " << c->affinity << Logging::endl;
+      c->deadline_q.enqueue(w, deadline);
+      cost_remote_enqueue(c);
+      unpause_for(c);
     }
 
     template<typename... Args>
@@ -123,55 +719,299 @@ namespace verona::rt
     {
       if (next_work != nullptr)
       {
-        core->q.enqueue(next_work);
+        if (!core->local_q.push(next_work))
+          core->q.enqueue(next_work);
         next_work = nullptr;
         if (Scheduler::get().unpause())
+        {
           core->stats.unpause();
+          Trace::record(TraceKind::Unpause, core->index);
+        }
+      }
+    }
+
+    /**
+     * Give back the memory this thread holds on to, after the level reported
+     * to `ThreadPool::memory_pressure` has changed.  Called between batches,
+     * outside of any epoch.
+     */
+    SNMALLOC_SLOW_PATH void respond_to_pressure()
+    {
+      pressure_seen = MemoryPressure::generation();
+      if (MemoryPressure::level() == PressureLevel::None)
+        return;
+
+      VERONA_LOG << "Responding to memory pressure" << Logging::endl;
+#ifdef USE_BEHAVIOUR_POOL
+      behaviour_pool.trim();
+#endif
+      // While there is pressure, leaving an epoch tries to advance it.  A
+      // delayed operation expires once the epoch has advanced twice past it.
+      for (size_t i = 0; i < 2; i++)
+      {
+        {
+          Epoch e;
+        }
+        while (Epoch::reclaim())
+          yield();
+      }
+    }
+
+    /**
+     * Fault in and fill the state this thread would otherwise set up while
+     * running its first work: its stack, its behaviour pool, its epoch and
+     * its log.  Called before the first work if the runtime is in low
+     * jitter mode, see `ThreadPool::set_low_jitter`.
+     */
+    SNMALLOC_SLOW_PATH void warm_up()
+    {
+      VERONA_LOG << "Warming up scheduler thread" << Logging::endl;
+      prefault::stack();
+#ifdef USE_BEHAVIOUR_POOL
+      behaviour_pool.prefill(PREFILL_BLOCKS);
+#endif
+      {
+        Epoch e;
       }
+      Logging::ThreadLocalLog::get();
+    }
+
+    /// Move the work in `core->local_q` to the back of `core->q`, oldest
+    /// first.
+    void spill_local()
+    {
+      auto [segment, count] = core->local_q.take_all();
+      if (count != 0)
+        core->q.enqueue_segment(segment, count);
     }
 
     static constexpr size_t BATCH_SIZE = 100;
+    static constexpr size_t MIN_BATCH_SIZE = 4;
+    static constexpr size_t MAX_BATCH_SIZE = 3200;
+
+    /// Current limit on the next_work fast path.  Only varies from BATCH_SIZE
+    /// if adaptive batching is enabled.
+    size_t batch_size = BATCH_SIZE;
+
+    /**
+     * Calculate the next batch size.
+     *
+     * With adaptive batching, the batch grows while no thread is trying to
+     * pause, as avoiding the queue is cheaper for ping-pong workloads.  It
+     * shrinks when threads are waiting for work, so that work we would
+     * otherwise keep to ourselves becomes available to steal.
+     */
+    size_t next_batch_size()
+    {
+      auto& pool = Scheduler::get();
+      if (pool.adaptive_batching)
+      {
+        if (pool.has_waiting_threads())
+          batch_size = std::max(batch_size / 2, MIN_BATCH_SIZE);
+        else
+          batch_size = std::min(batch_size * 2, MAX_BATCH_SIZE);
+      }
+      else
+      {
+        batch_size = BATCH_SIZE;
+      }
+
+      core->stats.batch_size(batch_size);
+#ifdef USE_SCHED_STATS
+      auto& memory = RegionMemoryStats::local();
+      core->stats.region_memory(memory.allocated, memory.freed);
+      memory = {};
+#endif
+      return batch_size;
+    }
+
+    /**
+     * Take work from the deadline queue of `c`, earliest deadline first, or
+     * failing that from its high priority queue.
+     */
+    static Work* dequeue_urgent(Core* c)
+    {
+      auto work = c->deadline_q.dequeue();
+      if (work != nullptr)
+        return work;
+
+      if (c->high_priority_q.is_empty())
+        return nullptr;
+
+      return c->high_priority_q.dequeue();
+    }
+
+    /**
+     * Record how long `work`, taken from the queue of a core, waited there,
+     * if it was stamped, see `WorkStealingQueue::set_age_aware`.
+     */
+    void record_age(Work* work)
+    {
+#ifdef USE_AGE_STATS
+      if ((work == nullptr) || (work->enqueued_tsc == 0))
+        return;
+
+      auto ticks = Clock::fast() - std::exchange(work->enqueued_tsc, 0);
+      core->stats.latency(SchedulerStats::Phase::Age, ticks);
+#else
+      UNUSED(work);
+#endif
+    }
+
     Work* get_work(size_t& batch)
     {
+      // Work with a deadline, and then high priority work, is taken ahead of
+      // everything else, but counts against the same batch as `next_work`.
+      // When the batch runs out, we fall through to `q`, so normal work,
+      // including the fairness token, is still serviced at least once per
+      // batch.
+      if (batch != 0)
+      {
+        auto work = dequeue_urgent(core);
+        if (work != nullptr)
+        {
+          batch--;
+          return work;
+        }
+      }
+
+      // Work of the other scheduling groups takes turns with the work of the
+      // default group, below, by their passes.
+      if (SNMALLOC_UNLIKELY(Scheduler::has_scheduling_groups()) && batch != 0)
+      {
+        bool default_ready = (next_work != nullptr) ||
+          !core->local_q.is_empty() || !core->q.is_empty();
+        auto work = take_grouped(core, default_ready);
+        if (work != nullptr)
+        {
+          batch--;
+          return work;
+        }
+      }
+
       // Check if we have a thread-local work item to use that is not subject
       // to work stealing.  This is batched, and should not happen more than
-      // BATCH_SIZE times in a row.
+      // batch_size times in a row.
       if (next_work != nullptr && batch != 0)
       {
         batch--;
         return std::exchange(next_work, nullptr);
       }
 
-      batch = BATCH_SIZE;
+      // Then the older work that this thread queued for itself, newest
+      // first, which counts against the same batch.
+      if (batch != 0)
+      {
+        auto work = core->local_q.pop();
+        if (work != nullptr)
+        {
+          batch--;
+          return work;
+        }
+      }
+
+      batch = next_batch_size();
+      // What is left takes its turn in `q`, behind the work of other cores
+      // and the fairness token.
+      spill_local();
+      exit_batch_epoch();
+#ifdef USE_BEHAVIOUR_POOL
+      behaviour_pool.flush_staged();
+#endif
+      poll_io();
+      drain_inboxes();
+
+      if (SNMALLOC_UNLIKELY(MemoryPressure::generation() != pressure_seen))
+        respond_to_pressure();
+
+      if (SNMALLOC_UNLIKELY(core->parked.load(std::memory_order_relaxed)))
+        park();
+
+      // Work queued at the end of a batch, with no thread waiting for any,
+      // is more than the threads started so far can keep up with.
+      auto& pool = Scheduler::get();
+      if (SNMALLOC_UNLIKELY(pool.spawnable.load(std::memory_order_relaxed)))
+      {
+        if (!core->q.is_empty() && !pool.has_waiting_threads())
+          pool.spawn_thread();
+      }
+
+      // A behaviour that has yielded runs once per batch, so a busy core
+      // does not starve it, and otherwise only when the core has nothing
+      // else to run, see below.
+      auto rerun = take_rerun();
+      if (rerun != nullptr)
+      {
+        return_next_work();
+        return rerun;
+      }
 
-      if (core->should_steal_for_fairness)
+      if (
+        core->should_steal_for_fairness && !pool.share_nothing &&
+        (pool.fairness != FairnessPolicy::Off))
       {
         // Check if we have some work. We should only reschedule the token
         // if we do have some work.  Otherwise, the token will be rescheduled
         // and we will fail to reach quicescence.
         if (!core->q.is_empty())
         {
-          auto work = try_steal();
+          pending_fair_steals = (pool.fairness == FairnessPolicy::Adaptive) ?
+            fair_steals() :
+            1;
+          // Efficiency cores take more of the normal work, leaving the
+          // performance cores free for latency-critical work.
+          if (core->efficiency)
+            pending_fair_steals =
+              std::min(pending_fair_steals * 2, MAX_FAIR_STEALS);
           // Set the flag before rescheduling the token so that we don't have
           // a race.
           core->should_steal_for_fairness = false;
           // Reschedule the token.
           core->q.enqueue(core->token_work);
-          if (work != nullptr)
-          {
-            return_next_work();
-            return work;
-          }
+        }
+      }
+
+      if (pending_fair_steals != 0)
+      {
+        pending_fair_steals--;
+        auto work = try_steal(true);
+        if (work != nullptr)
+        {
+          return_next_work();
+          return work;
         }
       }
 
       auto work = core->q.dequeue();
       if (work != nullptr)
+      {
+        record_age(work);
+        since_token++;
+        return_next_work();
+        return work;
+      }
+
+      // Other cores should not steal for fairness from an empty queue.
+      if (core->cycle_length.load(std::memory_order_relaxed) != 0)
+        core->cycle_length.store(0, std::memory_order_relaxed);
+
+      work = take_rerun();
+      if (work != nullptr)
       {
         return_next_work();
         return work;
       }
 
+      if (SNMALLOC_UNLIKELY(Scheduler::has_scheduling_groups()))
+      {
+        work = take_grouped(core, next_work != nullptr);
+        if (work != nullptr)
+        {
+          return_next_work();
+          return work;
+        }
+      }
+
       // Our queue is effectively empty, so this is like receiving a token,
       // try a steal.
       work = try_steal();
@@ -189,6 +1029,28 @@ namespace verona::rt
       return steal();
     }
 
+    /**
+     * Record the length of the last cycle of the token, and return how many
+     * times to steal for fairness before the next.
+     *
+     * The cycle length is the work taken from the queue between two
+     * dequeues of the token, which approximates the length of the queue.
+     * Under balanced load, stealing only moves work from one queue to
+     * another of the same length, so this steals only when the victim's last
+     * cycle was more than twice as long as this one, and then once for each
+     * multiple, up to `MAX_FAIR_STEALS`.
+     */
+    size_t fair_steals()
+    {
+      size_t own = std::exchange(since_token, 0);
+      core->cycle_length.store(own, std::memory_order_relaxed);
+
+      size_t theirs = victim->cycle_length.load(std::memory_order_relaxed);
+      if (theirs <= 2 * own)
+        return 0;
+      return std::min(theirs / (own + 1), MAX_FAIR_STEALS);
+    }
+
     /**
      * Startup is supplied to initialise thread local state before the runtime
      * starts.
@@ -201,31 +1063,57 @@ namespace verona::rt
       startup(args...);
 
       Scheduler::local() = this;
+#ifdef USE_BEHAVIOUR_POOL
+      BehaviourPool::local() = &behaviour_pool;
+#endif
+      profile = BehaviourProfile::acquire();
       assert(core != nullptr);
-      victim = core->next;
+      victim = core->local_victim(++local_victim_index);
       core->servicing_threads++;
+      quiescence_timeout = Scheduler::get().spin_max_ticks;
+      if (Scheduler::get_low_jitter())
+        warm_up();
 
 #ifdef USE_SYSTEMATIC_TESTING
       Systematic::attach_systematic_thread(local_systematic);
 #endif
-      size_t batch = BATCH_SIZE;
+      size_t batch = batch_size;
       Work* work;
       while ((work = get_work(batch)))
       {
-        Logging::cout() << "Schedule work " << work << Logging::endl;
+        enter_batch_epoch();
+        run_work(work);
+
+        // Run any successor handed over as a continuation straight away,
+        // and then any new behaviour whose cowns were all idle.  These are
+        // bounded by `try_continuation` and `try_eager`.
+        while ((continuation != nullptr) || (eager != nullptr))
+        {
+          if (continuation != nullptr)
+          {
+            continuations_run++;
+            core->stats.continuation();
+            run_work(std::exchange(continuation, nullptr));
+            continue;
+          }
 
-        work->run();
+          eager_run++;
+          run_work(std::exchange(eager, nullptr));
+        }
+        continuations_run = 0;
+        eager_run = 0;
 
         yield();
       }
 
+      exit_batch_epoch();
+
       if (core != nullptr)
       {
         auto val = core->servicing_threads.fetch_sub(1);
         if (val == 1)
         {
-          Logging::cout() << "Destroying core " << core->affinity
-                          << Logging::endl;
+          VERONA_LOG << "Destroying core " << core->affinity << Logging::endl;
         }
       }
 
@@ -236,55 +1124,218 @@ namespace verona::rt
       // Reset the local thread pointer as this physical thread could be reused
       // for a different SchedulerThread later.
       Scheduler::local() = nullptr;
+#ifdef USE_BEHAVIOUR_POOL
+      BehaviourPool::local() = nullptr;
+#endif
+      BehaviourProfile::release(std::exchange(profile, nullptr));
     }
 
-    Work* try_steal()
+    /**
+     * Try to steal from the victim thread, urgent work first.  If nothing is
+     * stolen, `status` says whether the victim's queue was empty or only
+     * contended.  `fairness` is set if the steal was prompted by the fairness
+     * token, for the counters.
+     */
+    Work* steal_from_victim(QueueStatus& status, bool fairness = false)
     {
+      // In share-nothing mode, work is only taken from cores that cannot
+      // run it for a while.
+      if (
+        Scheduler::get().share_nothing &&
+        !victim->blocked.load(std::memory_order_relaxed))
+      {
+        status = QueueStatus::Empty;
+        return nullptr;
+      }
+
+      size_t moved = 0;
       Work* work = nullptr;
-      // Try to steal from the victim thread.
-      work = core->q.steal(victim->q);
+      // Latency-critical work is left to performance cores that are awake
+      // to run it.
+      if (!core->efficiency || victim->efficiency || !victim->is_available())
+        work = dequeue_urgent(victim);
+      if (work != nullptr)
+      {
+        status = QueueStatus::Taken;
+      }
+      else
+      {
+        work = core->q.steal(victim->q, status, moved);
+        record_age(work);
+        if (work == nullptr)
+        {
+          // Then the oldest of the work the victim queued for itself.
+          QueueStatus local_status;
+          work = victim->local_q.steal(local_status);
+          if (local_status != QueueStatus::Empty)
+            status = local_status;
+        }
+
+        if (work == nullptr)
+        {
+          bool contended = status == QueueStatus::Contended;
+          core->stats.steal_failed(contended);
+          VERONA_PROBE3(steal_failed, core->index, victim->index, contended);
+        }
+      }
 
       if (work != nullptr)
       {
-        core->stats.steal();
-        Logging::cout() << "Fast-steal work " << work << " from "
-                        << victim->affinity << Logging::endl;
+        core->stats.steal(
+          moved, fairness, victim->numa_node != core->numa_node);
+        Trace::record(TraceKind::Steal, victim->index);
+        CostModel::steal();
+        VERONA_PROBE2(steal, core->index, victim->index);
+      }
+      return work;
+    }
+
+    Work* try_steal(bool fairness = false)
+    {
+      QueueStatus status;
+      Work* work = steal_from_victim(status, fairness);
+
+      if (work != nullptr)
+      {
+        VERONA_LOG << "Fast-steal work " << work << " from " << victim->affinity
+                   << Logging::endl;
       }
 
       // Move to the next victim thread.
-      victim = victim->next;
+      next_victim(work != nullptr, status == QueueStatus::Contended);
 
       return work;
     }
 
+    /**
+     * Move to the next victim to steal from.
+     *
+     * Victims are visited in tiers: SMT siblings, then the rest of the NUMA
+     * node.  A remote node is only tried once `remote_steal_threshold`
+     * consecutive steals have failed, as remote steals drag the working set
+     * of the stolen cowns across the interconnect.  A steal that failed only
+     * because the victim's queue was `contended` does not count, as the
+     * victim has work.
+     */
+    void next_victim(bool stolen, bool contended = false)
+    {
+      bool was_remote = std::exchange(victim_is_remote, false);
+
+      if (stolen)
+        local_steal_failures = 0;
+      else if (!was_remote && !contended)
+        local_steal_failures++;
+
+      if (
+        !was_remote && (core->remote_victim_count() != 0) &&
+        (local_steal_failures > Scheduler::get().remote_steal_threshold))
+      {
+        local_steal_failures = 0;
+        victim_is_remote = true;
+        victim = core->remote_victim(remote_victim_index++);
+        return;
+      }
+
+      victim = core->local_victim(++local_victim_index);
+    }
+
+    /**
+     * Adapt the spin budget based on how long we spun before finding work.
+     *
+     * The budget tracks twice the recent waiting time, so that work that
+     * arrives at a steady rate is found by spinning, but sporadic work does
+     * not keep an idle thread spinning for the full timeout.
+     */
+    void spin_found_work(uint64_t tsc, bool paused)
+    {
+      // Time spent paused says nothing about the arrival rate.
+      if (paused)
+        return;
+
+      auto& pool = Scheduler::get();
+      if (!pool.adaptive_spin)
+        return;
+
+      uint64_t waited = Clock::fast() - tsc;
+      quiescence_timeout = std::clamp(
+        (quiescence_timeout + (2 * waited)) / 2,
+        pool.spin_min_ticks,
+        pool.spin_max_ticks);
+    }
+
+    void spin_timed_out()
+    {
+      auto& pool = Scheduler::get();
+      if (!pool.adaptive_spin)
+        return;
+
+      quiescence_timeout =
+        std::max(quiescence_timeout / 2, pool.spin_min_ticks);
+    }
+
     Work* steal()
     {
-      uint64_t tsc = Aal::tick();
+      uint64_t tsc = Clock::fast();
+      bool paused = false;
       Work* work;
 
       while (running)
       {
         yield();
 
-        // Check if some other thread has pushed work on our queue.
-        work = core->q.dequeue();
+        if (SNMALLOC_UNLIKELY(core->parked.load(std::memory_order_relaxed)))
+          park();
+
+        poll_io();
+        drain_inboxes();
+
+        // Check if some other thread has pushed work on our queues.
+        work = dequeue_urgent(core);
+        if (work == nullptr)
+        {
+          work = core->q.dequeue();
+          record_age(work);
+        }
+        if (work == nullptr)
+          work = core->local_q.pop();
+        if (work == nullptr)
+          work = take_grouped(core);
 
         if (work != nullptr)
+        {
+          spin_found_work(tsc, paused);
           return work;
+        }
 
         // Try to steal from the victim thread.
-        work = core->q.steal(victim->q);
+        QueueStatus status;
+        work = steal_from_victim(status);
+        if ((work == nullptr) && !Scheduler::get().share_nothing)
+          work = take_grouped(victim);
 
         if (work != nullptr)
         {
-          core->stats.steal();
-          Logging::cout() << "Stole work " << work << " from "
-                          << victim->affinity << Logging::endl;
+          spin_found_work(tsc, paused);
+          VERONA_LOG << "Stole work " << work << " from " << victim->affinity
+                     << Logging::endl;
           return work;
         }
 
         // We were unable to steal, move to the next victim thread.
-        victim = victim->next;
+        next_victim(false, status == QueueStatus::Contended);
+
+        // The victim has work that was in use, so try the next victim
+        // straight away rather than counting towards pausing.
+        if (status == QueueStatus::Contended)
+          continue;
+
+        if (SNMALLOC_UNLIKELY(MemoryPressure::generation() != pressure_seen))
+          respond_to_pressure();
+
+        // Use the idle time to perform delayed operations from expired
+        // epochs, which flushing leaves behind when there are many.
+        if (Epoch::reclaim())
+          continue;
 
 #ifdef USE_SYSTEMATIC_TESTING
         // Only try to pause with 1/(2^5) probability
@@ -296,18 +1347,38 @@ namespace verona::rt
         }
 #else
         // Wait until a minimum timeout has passed.
-        uint64_t tsc2 = Aal::tick();
-        if ((tsc2 - tsc) < TSC_QUIESCENCE_TIMEOUT)
+        uint64_t tsc2 = Clock::fast();
+        if ((tsc2 - tsc) < quiescence_timeout)
         {
           Aal::pause();
           continue;
         }
+
+        if (!paused)
+          spin_timed_out();
 #endif
 
+        // Only this thread collects the core's I/O, so rather than pause,
+        // sleep in the kernel until some of it completes.
+        if (core->io.is_active())
+        {
+          poll_io(true);
+          continue;
+        }
+
+        // Likewise for events from outside the runtime, if this thread is
+        // the one to wait for them, see `ThreadPool::set_io_poller`.
+        if (Scheduler::get().poll_external_io())
+          continue;
+
         // We've been spinning looking for work for some time. While paused,
         // our running flag may be set to false, in which case we terminate.
         if (Scheduler::get().pause())
+        {
           core->stats.pause();
+          Trace::record(TraceKind::Pause, core->index);
+          paused = true;
+        }
       }
 
       return nullptr;
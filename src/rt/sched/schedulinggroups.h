@@ -0,0 +1,104 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "mpmcq.h"
+#include "schedulerstats.h"
+#include "work.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace verona::rt
+{
+  /// Number of scheduling groups, see `Cown::set_group`.
+  static constexpr size_t SCHEDULING_GROUPS = SchedulerStats::GROUPS;
+  static_assert(SCHEDULING_GROUPS > 1, "Groups start from the default one.");
+
+  /**
+   * Run queues of one core for the work of the scheduling groups other than
+   * the default, group 0, whose work stays in the core's usual queues.  Each
+   * tenant of a service can put its cowns in its own group, so that one that
+   * floods the runtime with behaviours does not starve the others, see
+   * `ThreadPool::set_group_weight`.
+   *
+   * The groups share the core by stride scheduling on CPU time.  Each group
+   * has a pass, advanced by the ticks its work ran for, scaled down by its
+   * weight, and the scheduler thread runs the work of the group with the
+   * smallest pass that has some.  A group that had no work resumes at the
+   * pass of the group that ran last, so it cannot bank the time it was idle
+   * and then starve the others.
+   *
+   * Any thread can queue work here, but only the thread servicing the core
+   * takes it, or charges the time it ran, so the passes are not atomic.
+   */
+  class SchedulingGroups
+  {
+    std::array<MPMCQ<Work>, SCHEDULING_GROUPS - 1> queues;
+
+    /// Pass of each group, including the default one.
+    std::array<uint64_t, SCHEDULING_GROUPS> pass{};
+
+    /// Pass of the group that ran last.
+    uint64_t floor = 0;
+
+    /// Fixed point scale of the passes, so that small weights still divide
+    /// short runs finely.
+    static constexpr size_t PASS_SHIFT = 16;
+
+  public:
+    void enqueue(Work* work, size_t group)
+    {
+      assert((group != 0) && (group < SCHEDULING_GROUPS));
+      queues[group - 1].enqueue(work);
+    }
+
+    Work* dequeue(size_t group)
+    {
+      assert((group != 0) && (group < SCHEDULING_GROUPS));
+      return queues[group - 1].dequeue();
+    }
+
+    bool is_empty()
+    {
+      for (auto& q : queues)
+      {
+        if (!q.is_empty())
+          return false;
+      }
+      return true;
+    }
+
+    /**
+     * The group to run next from the queues of `from`, which are this core's
+     * or those of a core being stolen from: the one with the smallest pass
+     * here of those with queued work, where `default_ready` is set if the
+     * default group has some.  Returns 0, the default group, if none has.
+     */
+    size_t pick(SchedulingGroups& from, bool default_ready)
+    {
+      size_t best = 0;
+      uint64_t best_pass = default_ready ? pass[0] : UINT64_MAX;
+      for (size_t group = 1; group < SCHEDULING_GROUPS; group++)
+      {
+        if ((pass[group] < best_pass) && !from.queues[group - 1].is_empty())
+        {
+          best = group;
+          best_pass = pass[group];
+        }
+      }
+      return best;
+    }
+
+    /**
+     * Charge `ticks` of running work of `group`, whose weight is `weight`.
+     */
+    void charge(size_t group, uint64_t ticks, size_t weight)
+    {
+      auto start = std::max(pass[group], floor);
+      floor = start;
+      pass[group] = start + ((ticks << PASS_SHIFT) / weight);
+    }
+  };
+} // namespace verona::rt
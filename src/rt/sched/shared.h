@@ -5,11 +5,14 @@
 #include "../debug/logging.h"
 #include "../debug/systematic.h"
 #include "../ds/forward_list.h"
+#include "../pal/clock.h"
 #include "../region/region.h"
 #include "base_noticeboard.h"
 #include "core.h"
 #include "schedulerthread.h"
 
+#include <chrono>
+
 namespace verona::rt
 {
   /**
@@ -21,6 +24,8 @@ namespace verona::rt
 
   class Shared : public Object
   {
+    friend class CycleCollector;
+
   public:
     Shared()
     {
@@ -35,17 +40,28 @@ namespace verona::rt
      **/
     std::atomic<size_t> weak_count{1};
 
+    /**
+     * Stored in `weak_count` by `CycleCollector` once it has released the
+     * data of an unreachable cown, which no weak reference can then refer
+     * to.  The last strong release then only runs the destructor.
+     */
+    static constexpr size_t CYCLE_COLLECTED = ~(size_t)0;
+
+    /// Ticks a background collection step runs for, or zero to collect
+    /// inline, see `set_background_collect`.
+    static inline std::atomic<uint64_t> collect_budget{0};
+
   public:
     static void acquire(Object* o)
     {
-      Logging::cout() << "Shared " << o << " acquire" << Logging::endl;
+      VERONA_LOG << "Shared " << o << " acquire" << Logging::endl;
       assert(o->debug_is_shared());
       o->incref();
     }
 
     static void release(Shared* o)
     {
-      Logging::cout() << "Shared " << o << " release" << Logging::endl;
+      VERONA_LOG << "Shared " << o << " release" << Logging::endl;
       assert(o->debug_is_shared());
 
       // Perform decref
@@ -66,7 +82,7 @@ namespace verona::rt
       // All paths from this point must release the weak count owned by the
       // strong count.
 
-      Logging::cout() << "Cown " << o << " dealloc" << Logging::endl;
+      VERONA_LOG << "Cown " << o << " dealloc" << Logging::endl;
 
       // If last, then collect the cown body.
       o->queue_collect();
@@ -77,20 +93,39 @@ namespace verona::rt
      **/
     void weak_release()
     {
-      Logging::cout() << "Cown " << this << " weak release" << Logging::endl;
+      VERONA_LOG << "Cown " << this << " weak release" << Logging::endl;
       if (weak_count.fetch_sub(1) == 1)
       {
         yield();
 
-        Logging::cout() << "Cown " << this << " no references left."
-                        << Logging::endl;
+        VERONA_LOG << "Cown " << this << " no references left."
+                   << Logging::endl;
         dealloc();
       }
     }
 
+    /**
+     * Collect cowns whose last strong reference is released on a scheduler
+     * thread in work items of their own, rather than inline in the releasing
+     * behaviour.  The work items run behind the other work on the core, as a
+     * behaviour that has yielded does, see `Scheduler::schedule_background`.
+     *
+     * Each work item collects cowns until `budget` has passed, and then
+     * schedules the rest in a new work item.  The budget is checked between
+     * cowns, so one cown with a large region can still exceed it.  A budget
+     * of zero, the default, collects inline.
+     */
+    static void set_background_collect(std::chrono::nanoseconds budget)
+    {
+      uint64_t ticks = 0;
+      if (budget.count() > 0)
+        ticks = std::max<uint64_t>(Clock::from_ns(budget.count()), 1);
+      collect_budget.store(ticks, std::memory_order_relaxed);
+    }
+
     void weak_acquire()
     {
-      Logging::cout() << "Cown " << this << " weak acquire" << Logging::endl;
+      VERONA_LOG << "Cown " << this << " weak acquire" << Logging::endl;
       assert(weak_count > 0);
       weak_count++;
     }
@@ -120,6 +155,14 @@ namespace verona::rt
       yield();
     }
 
+    /// The cowns waiting to be collected by the collection running on this
+    /// thread, if there is one.
+    static ObjectStack*& collect_work_list()
+    {
+      thread_local ObjectStack* work_list = nullptr;
+      return work_list;
+    }
+
     /**
      * Called when strong reference count reaches one.
      * Uses thread_local state to deal with deep deallocation
@@ -127,7 +170,7 @@ namespace verona::rt
      **/
     void queue_collect()
     {
-      thread_local ObjectStack* work_list = nullptr;
+      auto& work_list = collect_work_list();
 
       // If there is a already a queue, use it
       if (work_list != nullptr)
@@ -138,6 +181,17 @@ namespace verona::rt
         return;
       }
 
+      if (
+        (collect_budget.load(std::memory_order_relaxed) != 0) &&
+        (Scheduler::local_core() != nullptr) &&
+        !Scheduler::is_teardown_in_progress())
+      {
+        auto pending = new ObjectStack;
+        pending->push(this);
+        schedule_collect(pending);
+        return;
+      }
+
       // Make queue for recursive deallocations.
       ObjectStack current;
       work_list = &current;
@@ -158,6 +212,47 @@ namespace verona::rt
       work_list = nullptr;
     }
 
+    static void schedule_collect(ObjectStack* pending)
+    {
+      Scheduler::schedule_background(Closure::make([pending](Work*) {
+        collect_step(pending);
+        return true;
+      }));
+    }
+
+    /**
+     * Collect the cowns in `pending`, and those they release, until the
+     * budget runs out, and then schedule the rest.
+     */
+    static void collect_step(ObjectStack* pending)
+    {
+      auto& work_list = collect_work_list();
+      work_list = pending;
+
+      auto start = Clock::fast();
+      while (!pending->empty())
+      {
+        auto a = (Shared*)pending->pop();
+        a->collect();
+        yield();
+        a->weak_release();
+
+        auto budget = collect_budget.load(std::memory_order_relaxed);
+        if (
+          !pending->empty() && (budget != 0) &&
+          ((Clock::fast() - start) >= budget))
+        {
+          VERONA_LOG << "Collection out of budget" << Logging::endl;
+          work_list = nullptr;
+          schedule_collect(pending);
+          return;
+        }
+      }
+
+      work_list = nullptr;
+      delete pending;
+    }
+
     void collect()
     {
 #ifdef USE_SYSTEMATIC_TESTING_WEAK_NOTICEBOARDS
@@ -165,8 +260,28 @@ namespace verona::rt
 //      Move to finalisers for noticeboards.
 //      flush_all(alloc);
 #endif
-      Logging::cout() << "Collecting cown " << this << Logging::endl;
+      VERONA_LOG << "Collecting cown " << this << Logging::endl;
+
+      if (weak_count.load(std::memory_order_relaxed) == CYCLE_COLLECTED)
+      {
+        weak_count.store(1, std::memory_order_relaxed);
+        destructor();
+        return;
+      }
 
+      release_data();
+      yield();
+
+      // Now we may run our destructor.
+      destructor();
+    }
+
+    /**
+     * Run the finaliser, and release the regions, immutables and cowns that
+     * the data of this object refers to.
+     */
+    void release_data()
+    {
       ObjectStack dummy;
       // Run finaliser before releasing our data.
       // Sub-regions handled by code below.
@@ -192,8 +307,8 @@ namespace verona::rt
             break;
 
           case RegionMD::SHARED:
-            Logging::cout()
-              << "DecRef from " << this << " to " << o << Logging::endl;
+            VERONA_LOG << "DecRef from " << this << " to " << o
+                       << Logging::endl;
             Shared::release((Shared*)o);
             break;
 
@@ -201,11 +316,6 @@ namespace verona::rt
             abort();
         }
       }
-
-      yield();
-
-      // Now we may run our destructor.
-      destructor();
     }
   };
 
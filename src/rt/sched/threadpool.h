@@ -3,8 +3,15 @@
 #pragma once
 
 #include "../pal/threadpoolbuilder.h"
+#include "../pal/clock.h"
+#include "../pal/prefault.h"
+#include "cownprofile.h"
 #include "debug/logging.h"
+#include "debug/probes.h"
+#include "hazard.h"
+#include "memorypressure.h"
 #include "threadstate.h"
+#include "treebarrier.h"
 #ifdef USE_SYSTEMATIC_TESTING
 #  include "threadsyncsystematic.h"
 #else
@@ -14,18 +21,76 @@
 #include "corepool.h"
 #include "schedulerlist.h"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <list>
 #include <mutex>
+#include <optional>
 #include <snmalloc/snmalloc.h>
+#include <tuple>
+#include <vector>
 
 namespace verona::rt
 {
   /// Used for default prerun for a thread.
   inline void nop() {}
 
+  /**
+   * The load on the scheduler at a point in time, see
+   * `ThreadPool::introspect`.  The values are read without synchronising with
+   * the scheduler threads, so each is approximate, and they may not be
+   * consistent with each other.
+   */
+  struct SchedulerSnapshot
+  {
+    struct CoreSnapshot
+    {
+      size_t index;
+      /// Estimate of the work queued on the core, see
+      /// `WorkStealingQueue::length_estimate`.
+      size_t queued;
+      /// Set if the core has high priority or deadline work queued, which
+      /// `queued` does not count.
+      bool urgent;
+      bool parked;
+      bool blocked;
+      bool reserved;
+      size_t servicing_threads;
+      /// Behaviours run by the threads of this core so far.
+      size_t executed;
+    };
+
+    std::chrono::steady_clock::time_point time;
+    /// In ring order, so `cores[i].index == i`.
+    std::vector<CoreSnapshot> cores;
+    size_t thread_count;
+    size_t paused_threads;
+    size_t active_core_count;
+    size_t external_event_sources;
+    /// Behaviours run so far, including by cores no longer in the ring.
+    size_t executed;
+
+    /**
+     * Behaviours run per second between `earlier` and this snapshot.
+     */
+    double executed_per_second(const SchedulerSnapshot& earlier) const
+    {
+      auto seconds = std::chrono::duration<double>(time - earlier.time).count();
+      if ((seconds <= 0) || (executed < earlier.executed))
+        return 0;
+      return (double)(executed - earlier.executed) / seconds;
+    }
+  };
+
   using namespace snmalloc;
 
+  /// Waits for events from outside the runtime, see
+  /// `ThreadPool::set_io_poller`.
+  using IOPoller = void (*)(void* context, uint64_t timeout_ns);
+
   // Threadpool instantiated with <SchedulerThread<Cown>, Cown>
   template<class T>
   class ThreadPool
@@ -34,9 +99,6 @@ namespace verona::rt
     friend T;
     friend bool verona::rt::yield();
 
-    static constexpr uint64_t TSC_PAUSE_SLOP = 1'000'000;
-    static constexpr uint64_t TSC_UNPAUSE_SLOP = TSC_PAUSE_SLOP / 2;
-
     bool detect_leaks{true};
     size_t incarnation{1};
 
@@ -61,7 +123,8 @@ namespace verona::rt
     ThreadSync<T> sync;
 #endif
 
-    uint64_t barrier_incarnation = 0;
+    /// See `enter_barrier`.
+    TreeBarrier barrier;
 
     /// List of instantiated scheduler threads.
     /// Contains both free and active threads; protects accesses with a lock.
@@ -71,18 +134,146 @@ namespace verona::rt
     size_t thread_count = 0;
 
     /// Count of external event sources, such as I/O, that will prevent
-    /// quiescence.
-    size_t external_event_sources = 0;
+    /// quiescence.  Only modified holding the `sync` lock, but atomic so
+    /// that `introspect` can read it.
+    std::atomic<size_t> external_event_sources{0};
+
+    /// Waits for events from outside the runtime, see `set_io_poller`.
+    IOPoller io_poller = nullptr;
+    void* io_poller_context = nullptr;
+    uint64_t io_poll_timeout_ns = 0;
+
+    /// Set while a scheduler thread is waiting in `io_poller`.
+    std::atomic<bool> io_polling{false};
+
+    /// Number of threads asleep in `pause`, for `introspect`.
+    std::atomic<size_t> paused_threads{0};
 
     bool teardown_in_progress = false;
 
-    bool fair = false;
+    /// See `set_fairness`.
+    FairnessPolicy fairness = FairnessPolicy::Token;
+
+    /// If true, scheduler threads adapt how many times in a row they take the
+    /// thread-local `next_work` before checking their queue.
+    bool adaptive_batching = false;
+
+    /// How the cores are placed on cpus, see `set_affinity_policy`.
+    AffinityPolicy affinity_policy = AffinityPolicy::Compact;
+
+    /// Cores set aside for critical work, see `set_reserved_core_count`.
+    size_t reserved_cores = 0;
+
+    /// Steal mode applied to every core when the pool is initialised.
+    StealMode steal_mode = StealMode::All;
+    size_t steal_bound = 0;
+    bool age_aware = false;
+
+    /// Number of consecutive failed steals from cores on the same NUMA node
+    /// before a scheduler thread tries to steal from a remote node.
+    size_t remote_steal_threshold = 4;
+
+    /// If true, work a scheduler thread sends to other cores is staged and
+    /// published once per target core when the current work item finishes.
+    bool stage_remote_work = true;
+
+    /// Maximum number of successors a scheduler thread runs in a row as
+    /// continuations.  0 disables continuations.
+    size_t continuation_depth = 0;
+
+    /// Maximum number of new behaviours, whose cowns were all idle, that a
+    /// scheduler thread runs in a row straight after the behaviour that
+    /// created them.  0 disables eager execution.
+    size_t eager_depth = 0;
+
+    /// If true, the successor of a writer on a cown is scheduled onto the
+    /// cown's home core, rather than the releasing thread's core.
+    bool cown_home_affinity = false;
+
+    /// If true, cowns are bound to cores, and cores do not steal work from
+    /// each other, see `set_share_nothing`.
+    bool share_nothing = false;
+
+    /// Set once a cown is put in a scheduling group other than the default,
+    /// or a group is given a weight, see `set_group_weight`.
+    std::atomic<bool> scheduling_groups{false};
+
+    /// Weight of each scheduling group, where 0 is the default weight of 1.
+    std::array<std::atomic<uint32_t>, SCHEDULING_GROUPS> group_weights{};
+
+    /// Nanoseconds a behaviour may run before `Behaviour::should_yield`
+    /// returns true.  0 means no limit.
+    uint64_t rerun_quantum = 0;
+
+    /// If true, scheduler threads hold an epoch for each batch of work.
+    bool batch_epoch = false;
+
+    /// See `set_low_jitter`.
+    bool low_jitter = false;
+    bool lock_memory = false;
+
+    /// Bounds on how long an idle scheduler thread spins looking for work
+    /// before it pauses, see `set_spin_timeout`.  Set in nanoseconds, and
+    /// converted to ticks by `init`.
+    uint64_t spin_max_ns = 400'000;
+    uint64_t spin_min_ns = 4'000;
+    uint64_t spin_max_ticks = 0;
+    uint64_t spin_min_ticks = 0;
+    bool adaptive_spin = true;
+
+    /// One in this many behaviours is timed, see
+    /// `set_latency_sample_period`.
+    size_t latency_sample_period = SchedulerStats::DEFAULT_SAMPLE_PERIOD;
 
     ThreadState state;
 
     /// Pool of cores shared by the scheduler threads.
     CorePool<ThreadPool<T>> core_pool;
 
+    /// Number of cores that are not parked.
+    size_t active_core_count = 0;
+
+    /// If true, `run` starts a single scheduler thread, and more as work
+    /// builds up, see `set_lazy_start`.
+    bool lazy_start = false;
+    size_t spawn_budget = SIZE_MAX;
+
+    /// Cores with a thread, the first in the ring.  The others are parked
+    /// until a thread is started for them.  Only changed holding `sync`.
+    std::atomic<size_t> started_cores{0};
+    /// Threads that may still be started in this run.
+    std::atomic<size_t> spawnable{0};
+    /// Body of the threads started during the run, and the threads, which
+    /// are on the stack of `run_with_startup`, as the pool must be constant
+    /// initialised.
+    void (*spawn_body)(ThreadPool* pool, T* t) = nullptr;
+    void* spawn_args = nullptr;
+    std::list<PlatformThread>* spawned_threads = nullptr;
+    snmalloc::FlagWord spawned_lock;
+    uint64_t start_tick = 0;
+
+    /**
+     * Scheduler threads kept between runs, see `set_retain_threads`.  Each
+     * waits for `generation` to change, then runs the scheduler thread in
+     * its slot.  Allocated on first use, as the pool must be constant
+     * initialised.
+     */
+    struct Retained
+    {
+      std::vector<PlatformThread> threads;
+      std::vector<T*> slots;
+      std::mutex m;
+      std::condition_variable start;
+      std::condition_variable done;
+      uint64_t generation = 0;
+      /// Threads still running the current run.
+      size_t running = 0;
+      bool exit = false;
+    };
+
+    bool retain_threads = false;
+    Retained* retained = nullptr;
+
     /// Systematic ids.
     std::atomic<size_t> systematic_ids = 0;
 
@@ -119,98 +310,1055 @@ namespace verona::rt
       auto h = s.sync.handle(local());
       assert(local() != nullptr);
       auto prev_count = s.external_event_sources++;
-      Logging::cout() << "Add external event source (now " << (prev_count + 1)
-                      << ")" << Logging::endl;
+      VERONA_LOG << "Add external event source (now " << (prev_count + 1) << ")"
+                 << Logging::endl;
+    }
+
+    /// Decrement the external event source count. This will allow runtime
+    /// teardown if the count drops to zero.
+    static void remove_external_event_source()
+    {
+      // Must be called from inside a scheduler thread,
+      // A message can be LIFO scheduled to call this.
+      // Note, if this is not called from a scheduler thread, then the following
+      // can happen
+      //   1. All scheduler threads decide to pause the runtime but stop just
+      //      before waiting on the condition variable.
+      //   2. This code runs and calls notify, but no threads see this.
+      //   3. All the scheduler threads go call wait on condition variables.
+      // This leads to the system becoming inactive, and will never wake up.
+      // Forcing this code to be injected onto a scheduler thread by a message
+      // means the runtime cannot be attempting to pause while this code is
+      // running.
+      assert(local() != nullptr);
+
+      auto& s = get();
+      auto h = s.sync.handle(local());
+      auto prev_count = s.external_event_sources--;
+      assert(prev_count != 0);
+      VERONA_LOG << "Remove external event source (now " << (prev_count - 1)
+                 << ")" << Logging::endl;
+    }
+
+    /**
+     * Set a function for idle scheduler threads to wait for events from
+     * outside the runtime in, such as `epoll_wait` or `io_uring_enter` on
+     * the application's own descriptors, rather than pausing.
+     *
+     * `poller(context, timeout_ns)` should wait for at most `timeout_ns`, and
+     * schedule the work of the events that arrive.  It is only called while
+     * there are external event sources, so a source should be added for as
+     * long as events are expected, and by one thread at a time, which pauses
+     * no longer.  The other idle threads pause as usual, and are woken by the
+     * work the poller schedules, so no dedicated poller thread is needed.
+     * A null `poller` removes it.  Must not be changed while the runtime is
+     * running.
+     */
+    static void set_io_poller(
+      IOPoller poller,
+      void* context = nullptr,
+      std::chrono::nanoseconds timeout = std::chrono::milliseconds(1))
+    {
+      VERONA_LOG << "Set I/O poller: " << (poller != nullptr)
+                 << Logging::endl;
+      auto& s = get();
+      s.io_poller = poller;
+      s.io_poller_context = context;
+      s.io_poll_timeout_ns = static_cast<uint64_t>(timeout.count());
+    }
+
+    /**
+     * Start the runtime with a single scheduler thread, and start a thread
+     * for the next core only when a thread finds work queued on its core at
+     * the end of a batch while no thread is waiting for work.  At most
+     * `budget` threads are started this way, and none for cores parked by
+     * `set_active_core_count`.  This suits short lived programs, that would
+     * otherwise spend much of their run starting threads they do not need.
+     * The threads started, and when, are counted in `SchedulerStats`.
+     *
+     * Applies from the next call to `run`.  Threads are always all started
+     * with systematic testing, which needs them from the start.
+     */
+    static void set_lazy_start(bool lazy, size_t budget = SIZE_MAX)
+    {
+      VERONA_LOG << "Set lazy start: " << lazy << " budget: " << budget
+                 << Logging::endl;
+      auto& s = get();
+      s.lazy_start = lazy;
+      s.spawn_budget = budget;
+    }
+
+    /**
+     * Keep the scheduler threads, and the cores with their queues, when
+     * `run` returns, so that the next `init` and `run` with the same number
+     * of threads reuse them, rather than starting and stopping every thread.
+     * Between runs the threads wait on a condition variable.  This suits
+     * drivers that run many short jobs back to back.  Takes precedence over
+     * `set_lazy_start`.
+     *
+     * Disabling it stops the retained threads and frees the cores, and must
+     * be done between runs, before the program exits, and before checking
+     * for leaks, as the cores hold memory from the runtime's heap.  Ignored
+     * with systematic testing, which needs fresh threads for each seed.
+     */
+    static void set_retain_threads(bool retain)
+    {
+      VERONA_LOG << "Set retain threads: " << retain << Logging::endl;
+      auto& s = get();
+      s.retain_threads = retain;
+      if (!retain)
+        s.release_retained();
+    }
+
+    /**
+     * Set how scheduler threads are pinned to cpus, from the next call to
+     * `init`.  The best policy depends on the machine and the workload:
+     * compact, the default, keeps threads close to share caches, scatter
+     * spreads them across NUMA nodes and packages for memory bandwidth, and
+     * none suits containers whose cpus are shared with other processes.
+     * See `AffinityPolicy`.
+     *
+     * The `VERONA_AFFINITY` environment variable, if set when `init` is
+     * called, takes precedence, so deployments can choose without a
+     * rebuild.  It is one of "compact", "scatter" or "none", or a list of
+     * cpus such as "0-3,8", see `set_affinity_cpus`.
+     */
+    static void set_affinity_policy(AffinityPolicy policy)
+    {
+      VERONA_LOG << "Set affinity policy: " << (int)policy << Logging::endl;
+      get().affinity_policy = policy;
+    }
+
+    /**
+     * Pin the scheduler threads to `cpus`, in order, from the next call to
+     * `init`.  If there are more threads than cpus, the list is reused from
+     * the start.  An empty list restores the compact policy.
+     */
+    static void set_affinity_cpus(std::vector<size_t> cpus)
+    {
+      VERONA_LOG << "Set affinity cpus: " << cpus.size() << Logging::endl;
+      get().affinity_policy =
+        cpus.empty() ? AffinityPolicy::Compact : AffinityPolicy::Explicit;
+      affinity_cpus() = std::move(cpus);
+    }
+
+    /**
+     * Set aside the last `count` cores in the ring, from the next call to
+     * `init`, to run only `Priority::Critical` work, and wait for external
+     * events in the I/O poller, see `set_io_poller`.  Other work is not
+     * scheduled onto them, and they neither steal it nor have their work
+     * stolen, so critical work, such as handling market data, is isolated
+     * from background work in the same process.  Without reserved cores,
+     * critical work is just high priority.
+     *
+     * At least one core is always left for other work.  Reserved cores are
+     * never parked by `set_active_core_count`, and all threads are started
+     * at once, as with `set_lazy_start(false)`, while there are any.
+     */
+    static void set_reserved_core_count(size_t count)
+    {
+      VERONA_LOG << "Set reserved core count: " << count << Logging::endl;
+      get().reserved_cores = count;
+    }
+
+    static size_t get_reserved_core_count()
+    {
+      return get().core_pool.reserved_count;
+    }
+
+    /**
+     * Choose when scheduler threads steal work for fairness, see
+     * `FairnessPolicy`.
+     */
+    static void set_fairness(FairnessPolicy policy)
+    {
+      VERONA_LOG << "Set fairness: " << (int)policy << Logging::endl;
+      get().fairness = policy;
+    }
+
+    static void set_fair(bool fair)
+    {
+      set_fairness(fair ? FairnessPolicy::Token : FairnessPolicy::Off);
+    }
+
+    /**
+     * Enable or disable the adaptive batch size for the thread-local
+     * `next_work` fast path.  When disabled, a fixed batch size is used.
+     */
+    static void set_adaptive_batching(bool adaptive)
+    {
+      VERONA_LOG << "Set adaptive batching: " << adaptive << Logging::endl;
+      get().adaptive_batching = adaptive;
+    }
+
+    /**
+     * Set how much work is taken by a single steal on every core.  This
+     * applies from the next call to `init`.  Individual cores can be altered
+     * with `Core::q.set_steal_mode`.
+     */
+    static void set_steal_mode(StealMode mode, size_t bound = 0)
+    {
+      VERONA_LOG << "Set steal mode: " << (int)mode << " bound: " << bound
+                 << Logging::endl;
+      auto& s = get();
+      s.steal_mode = mode;
+      s.steal_bound = bound;
+    }
+
+    /**
+     * Stamp the work queued on every core, so that thieves take the oldest
+     * work of their victim, and the time work waits is recorded in the
+     * `SchedulerStats::Phase::Age` histogram of the core that takes it, see
+     * `WorkStealingQueue::set_age_aware`.  For tail latency under skewed
+     * load.  This applies from the next call to `init`, and only when built
+     * with `USE_AGE_STATS`.
+     */
+    static void set_age_aware_stealing(bool enable)
+    {
+      VERONA_LOG << "Set age aware stealing: " << enable << Logging::endl;
+      get().age_aware = enable;
+    }
+
+    /**
+     * Set how many consecutive failed steals from cores on the same NUMA node
+     * are required before a scheduler thread will try to steal from a core on
+     * a remote node.  A threshold of 0 alternates between local and remote
+     * victims.
+     */
+    static void set_remote_steal_threshold(size_t threshold)
+    {
+      VERONA_LOG << "Set remote steal threshold: " << threshold
+                 << Logging::endl;
+      get().remote_steal_threshold = threshold;
+    }
+
+    /**
+     * Enable or disable scheduling the successor of a writer onto the core
+     * the cown has recently been running on.  See `Cown::note_run_on`.
+     */
+    static void set_cown_home_affinity(bool home_affinity)
+    {
+      VERONA_LOG << "Set cown home affinity: " << home_affinity
+                 << Logging::endl;
+      get().cown_home_affinity = home_affinity;
+    }
+
+    static bool get_cown_home_affinity()
+    {
+      return get().cown_home_affinity;
+    }
+
+    /**
+     * Enable or disable share-nothing mode, in which each core runs the
+     * behaviours on the cowns bound to it, and cores do not steal work from
+     * each other.  This suits services that partition their cowns by key,
+     * where stealing only drags the cowns' data between cores.
+     *
+     * A cown is bound to the core it is created on, or to a core picked
+     * round robin if it is created outside the runtime, or to the core given
+     * to `Cown::set_home_core`.  A behaviour whose cowns are all bound to one
+     * core runs on that core, and other behaviours are scheduled as usual.
+     * A scheduler thread sends work to another core through the single
+     * producer inbox that core keeps for it, see `Core::inboxes`, rather
+     * than through the core's queue.
+     *
+     * Work is only stolen from cores in a `blocking_section`.  Cores are not
+     * parked by `set_active_core_count`, and `set_lazy_start` is ignored, as
+     * work bound to a core without a running thread would wait forever.
+     * This must be set before `init`.
+     */
+    static void set_share_nothing(bool enable)
+    {
+      VERONA_LOG << "Set share nothing: " << enable << Logging::endl;
+      get().share_nothing = enable;
+    }
+
+    static bool get_share_nothing()
+    {
+      return get().share_nothing;
+    }
+
+    /**
+     * In share-nothing mode, the core to bind a new cown to, and otherwise
+     * nullptr.
+     */
+    static Core* home_for_new_cown()
+    {
+      auto& s = get();
+      if (!s.share_nothing || (s.core_pool.first_core == nullptr))
+        return nullptr;
+
+      auto* core = available_local_core();
+      return core != nullptr ? core : round_robin();
+    }
+
+    /**
+     * Set the weight of scheduling group `group`, which is 1 by default.
+     * Where the cowns of several tenants share the runtime, each tenant can
+     * put its cowns in its own group, see `Cown::set_group`, so that one
+     * that floods the runtime with behaviours does not starve the others.
+     * Each core then shares its time between the groups with work queued
+     * on it in proportion to their weights, see `SchedulingGroups`, and the
+     * time each group ran for is counted in `SchedulerStats`.
+     *
+     * Behaviours with a deadline or a priority other than
+     * `Priority::Normal` still run ahead of all normal work.  Until a group
+     * is used, none of this costs more than checking a flag.
+     */
+    static void set_group_weight(size_t group, size_t weight)
+    {
+      assert(group < SCHEDULING_GROUPS);
+      assert((weight != 0) && (weight <= UINT32_MAX));
+      VERONA_LOG << "Set group " << group << " weight: " << weight
+                 << Logging::endl;
+      get().group_weights[group].store(
+        (uint32_t)weight, std::memory_order_relaxed);
+      enable_scheduling_groups();
+    }
+
+    static size_t get_group_weight(size_t group)
+    {
+      auto weight = get().group_weights[group].load(std::memory_order_relaxed);
+      return weight == 0 ? 1 : weight;
+    }
+
+    /// Start serving scheduling groups, see `set_group_weight`.
+    static void enable_scheduling_groups()
+    {
+      get().scheduling_groups.store(true, std::memory_order_relaxed);
+    }
+
+    static bool has_scheduling_groups()
+    {
+      return get().scheduling_groups.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Set how long a behaviour may run before it is asked to yield, see
+     * `Behaviour::should_yield`.  Zero, the default, means never.
+     */
+    static void set_rerun_quantum(std::chrono::nanoseconds quantum)
+    {
+      VERONA_LOG << "Set rerun quantum: " << quantum.count() << Logging::endl;
+      get().rerun_quantum = static_cast<uint64_t>(quantum.count());
+    }
+
+    static uint64_t get_rerun_quantum()
+    {
+      return get().rerun_quantum;
+    }
+
+    /**
+     * When built with `USE_SCHED_STATS`, time acquiring and running one in
+     * every `period` behaviours on each thread, for the latency histograms
+     * of `SchedulerStats`.  Zero disables timing these phases.
+     */
+    static void set_latency_sample_period(size_t period)
+    {
+      VERONA_LOG << "Set latency sample period: " << period << Logging::endl;
+      get().latency_sample_period = period;
+    }
+
+    static size_t get_latency_sample_period()
+    {
+      return get().latency_sample_period;
+    }
+
+    /**
+     * Enable or disable staging of work sent to other cores.  With staging,
+     * a scheduler thread links work for each target core into a segment, and
+     * publishes it with a single exchange on the target's queue when the
+     * current work item finishes, or the segment fills up.
+     */
+    static void set_stage_remote_work(bool stage)
+    {
+      VERONA_LOG << "Set stage remote work: " << stage << Logging::endl;
+      get().stage_remote_work = stage;
+    }
+
+    /**
+     * Enable or disable holding an epoch for each batch of work on scheduler
+     * threads.  Epochs entered by behaviours, for instance by
+     * `Noticeboard::peek`, are then nested and only cost a counter update.
+     * The epoch is left at batch boundaries, and while a thread looks for
+     * work or is in a blocking section, but a behaviour that runs for a long
+     * time holds back reclamation on every thread.
+     */
+    static void set_batch_epoch(bool enable)
+    {
+      VERONA_LOG << "Set batch epoch: " << enable << Logging::endl;
+      get().batch_epoch = enable;
+    }
+
+    /**
+     * Enable or disable low jitter mode, from the next call to `init`, for
+     * deployments where page faults and allocator slow paths in the first
+     * work after start cause latency outliers.  In this mode:
+     *
+     *  - Unless the affinity is set explicitly, the scheduler threads are
+     *    pinned to the cpus isolated with the `isolcpus` boot parameter, if
+     *    there are any, see `isolated_cpus`.
+     *  - If `lock` is set, every page of the process is locked in memory by
+     *    `init`, including those mapped later, see `prefault::lock_all`.
+     *    This needs a large enough `RLIMIT_MEMLOCK`, and is skipped, with a
+     *    log message, otherwise.
+     *  - Each scheduler thread faults in its stack, fills its behaviour
+     *    pool, and sets up its epoch and log after the `startup` function
+     *    passed to `run_with_startup`, and before it runs any work.
+     */
+    static void set_low_jitter(bool enable, bool lock = false)
+    {
+      VERONA_LOG << "Set low jitter: " << enable << " lock: " << lock
+                 << Logging::endl;
+      get().low_jitter = enable;
+      get().lock_memory = lock;
+    }
+
+    static bool get_low_jitter()
+    {
+      return get().low_jitter;
+    }
+
+    /**
+     * Set how long an idle scheduler thread spins looking for work before
+     * it pauses, from the next call to `init`.  Spinning for longer finds
+     * work that arrives at a low rate sooner, as waking a paused thread
+     * takes a system call, but burns power and cpu time on an idle runtime.
+     *
+     * With adaptive spinning, the default, each scheduler thread learns the
+     * time between arrivals of work on its core, and spins for twice that,
+     * between `min` and `max`.  Otherwise, it always spins for `max`.  The
+     * defaults are 400us and 4us.  The times are converted to ticks of the
+     * fast clock at `init`, using its measured rate, see `Clock`.
+     */
+    static void set_spin_timeout(
+      std::chrono::nanoseconds max,
+      std::chrono::nanoseconds min,
+      bool adaptive = true)
+    {
+      VERONA_LOG << "Set spin timeout: " << max.count() << "ns min "
+                 << min.count() << "ns adaptive " << adaptive
+                 << Logging::endl;
+      auto& s = get();
+      s.spin_max_ns = static_cast<uint64_t>(max.count());
+      s.spin_min_ns =
+        std::min(static_cast<uint64_t>(min.count()), s.spin_max_ns);
+      s.adaptive_spin = adaptive;
+    }
+
+    /**
+     * Set how many successive writers on a cown a scheduler thread can run
+     * inline, as continuations of the behaviour that released the cown.  A
+     * continuation runs straight after its predecessor without passing
+     * through `next_work` or any queue, which keeps the cown's data in the
+     * cache.  Larger depths delay other work on the core for longer.  0, the
+     * default, disables continuations.
+     */
+    static void set_continuation_depth(size_t depth)
+    {
+      VERONA_LOG << "Set continuation depth: " << depth << Logging::endl;
+      get().continuation_depth = depth;
+    }
+
+    /**
+     * Schedule `w` to run on the current thread as soon as the current work
+     * item finishes, if continuations are enabled and the depth limit has not
+     * been reached.  Otherwise, this is the same as `schedule`.
+     */
+    static void schedule_continuation(Work* w)
+    {
+      auto* t = local();
+
+      if (t != nullptr && !t->core->reserved && t->try_continuation(w))
+        return;
+
+      schedule(w);
+    }
+
+    /**
+     * Set how many new behaviours a scheduler thread can run eagerly.  A
+     * behaviour created by `when` on a scheduler thread, whose cowns were
+     * all idle so that it was runnable as soon as it was scheduled, runs
+     * straight after the behaviour that created it, without passing through
+     * `next_work` or any queue.  This is separate from, and follows, the
+     * continuations of `set_continuation_depth`, which hand over a cown to
+     * its next waiting behaviour.  Larger depths delay other work on the
+     * core for longer.  0, the default, disables eager execution.
+     */
+    static void set_eager_depth(size_t depth)
+    {
+      VERONA_LOG << "Set eager depth: " << depth << Logging::endl;
+      get().eager_depth = depth;
+    }
+
+    /**
+     * Schedule `w` to run on the current thread as soon as the current work
+     * item finishes, if eager execution is enabled and the depth limit has
+     * not been reached.  Otherwise, this is the same as `schedule`.
+     */
+    static void schedule_eager(Work* w)
+    {
+      auto* t = local();
+
+      if (t != nullptr && !t->core->reserved && t->try_eager(w))
+        return;
+
+      schedule(w);
+    }
+
+    /**
+     * Report how close the process is to its memory limit, for instance
+     * from a monitor of the cgroup's `memory.events` or of pressure stall
+     * information, see `memorylimit::cgroup_usage`.  While the level is above
+     * `PressureLevel::None`, the runtime gives back the memory it holds for
+     * later, frees delayed memory as soon as it can, and admits fewer
+     * behaviours through `when_bounded`, see `MemoryPressure`.  The handlers
+     * added with `MemoryPressure::add_handler` run on the calling thread.
+     * Report `PressureLevel::None` once the pressure has passed.
+     */
+    static void memory_pressure(PressureLevel level)
+    {
+      MemoryPressure::set(level);
+    }
+
+    static bool is_teardown_in_progress()
+    {
+      return get().teardown_in_progress;
+    }
+
+    static T*& local()
+    {
+      static thread_local T* local;
+      return local;
+    }
+
+    /**
+     * Returns the core of the current scheduler thread, or nullptr if called
+     * from an external thread.
+     */
+    static Core* local_core()
+    {
+      auto* t = local();
+      return t == nullptr ? nullptr : t->core;
+    }
+
+    /**
+     * As `local_core`, but nullptr for a reserved core, which other work
+     * should not be scheduled on.
+     */
+    static Core* available_local_core()
+    {
+      auto* core = local_core();
+      return (core == nullptr) || core->reserved ? nullptr : core;
+    }
+
+    /**
+     * Returns the current thread's core if it is reserved, and otherwise the
+     * next reserved core round robin, or nullptr if there are none.  See
+     * `set_reserved_core_count`.
+     */
+    static Core* reserved_round_robin()
+    {
+      auto& s = get();
+      if (s.core_pool.reserved_count == 0)
+        return nullptr;
+
+      auto* core = local_core();
+      if ((core != nullptr) && core->reserved)
+        return core;
+
+      static thread_local size_t incarnation;
+      static thread_local Core* nonlocal;
+
+      // The reserved cores are at the end of the ring.
+      if ((incarnation != s.incarnation) || (nonlocal->next == first_core()))
+      {
+        incarnation = s.incarnation;
+        nonlocal = s.core_pool.first_reserved;
+      }
+      else
+      {
+        nonlocal = nonlocal->next;
+      }
+
+      return nonlocal;
+    }
+
+    /**
+     * Returns the next available core that is not an efficiency core, see
+     * `Core::efficiency`, round robin, or `core` if there is none.
+     */
+    static Core* performance_round_robin(Core* core)
+    {
+      for (size_t i = 0; i < get_core_count(); i++)
+      {
+        auto c = round_robin();
+        if (!c->efficiency && c->is_available())
+          return c;
+      }
+      return core;
+    }
+
+    static Core* round_robin()
+    {
+      static thread_local size_t incarnation;
+      static thread_local Core* nonlocal;
+
+      if (incarnation != get().incarnation)
+      {
+        incarnation = get().incarnation;
+        nonlocal = get().first_core();
+      }
+      else
+      {
+        // Skip parked and blocked cores, unless there are no others.
+        Core* start = nonlocal;
+        do
+        {
+          nonlocal = nonlocal->next;
+        } while (!nonlocal->is_available() && (nonlocal != start));
+      }
+
+      return nonlocal;
+    }
+
+    /**
+     * Set how many cores run work, between one and the count passed to
+     * `init`.  The first `count` cores in the ring stay active, and the rest
+     * are parked.  A thread on a parked core moves its queued work to an
+     * active core and sleeps until its core is made active again, so a
+     * shrinking CPU quota does not leave threads competing for CPUs.
+     *
+     * Only valid between `init` and the end of `run`.  The number of cores
+     * cannot grow beyond the count passed to `init`.
+     */
+    static void set_active_core_count(size_t count)
+    {
+      auto& s = get();
+      count = std::clamp<size_t>(count, 1, s.core_pool.core_count);
+      VERONA_LOG << "Set active core count: " << count << Logging::endl;
+
+      {
+        // Cores without a thread stay parked until one is started for them.
+        auto h = s.sync.handle(local());
+        s.active_core_count = count;
+        auto started = s.started_cores.load(std::memory_order_relaxed);
+        Core* c = s.first_core();
+        for (size_t i = 0; i < s.core_pool.core_count; i++)
+        {
+          c->parked.store(
+            !c->reserved && !s.share_nothing &&
+              ((i >= count) || (i >= started)),
+            std::memory_order_seq_cst);
+          c = c->next;
+        }
+      }
+
+      // Wake the threads of any cores that are no longer parked.
+      s.threads.forall([](T* t) { t->unpark(); });
+    }
+
+    static size_t get_active_core_count()
+    {
+      return get().active_core_count;
+    }
+
+    /**
+     * Returns the number of cores, including parked ones.  Each core's
+     * `index` is below this.
+     */
+    static size_t get_core_count()
+    {
+      return get().core_pool.core_count;
+    }
+
+    /**
+     * Run `f`, which may block, for instance in a system call, without
+     * stalling the work queued on the current core.
+     *
+     * The core's queued work is handed to other cores, and threads are woken
+     * to run it.  While `f` runs, the core is not picked for new work, and
+     * work scheduled by `f` goes to other cores, as it would from an external
+     * thread.  Work that still arrives on the core is picked up by thieves.
+     *
+     * Outside a scheduler thread, this just runs `f`.
+     */
+    template<typename F>
+    static void blocking_section(F&& f)
+    {
+      auto* t = local();
+      if ((t == nullptr) || t->core->blocked.load(std::memory_order_relaxed))
+      {
+        f();
+        return;
+      }
+
+      t->enter_blocking_section();
+      f();
+      t->exit_blocking_section();
+    }
+
+    /**
+     * Start an I/O operation on the current core.  `req->work` is run on
+     * this core once it has completed, see `IOQueue`.  Must be called on a
+     * scheduler thread.
+     */
+    static void submit_io(const IOOp& op, IORequest* req)
+    {
+      auto* t = local();
+      assert(t != nullptr);
+      t->submit_io(op, req);
+    }
+
+    /**
+     * Register buffers for fixed reads and writes on the current core, see
+     * `IOQueue::register_buffers`.  Must be called on a scheduler thread.
+     */
+    static int register_io_buffers(const void* buffers, unsigned count)
+    {
+      auto* t = local();
+      assert(t != nullptr);
+      return t->core->io.register_buffers(buffers, count);
+    }
+
+    static void schedule(Work* w, bool fifo = true)
+    {
+      auto* t = local();
+
+      if (t != nullptr && fifo && !t->core->blocked && !t->core->reserved)
+      {
+        t->schedule_fifo(w);
+        return;
+      }
+
+      auto* core = round_robin();
+      T::schedule_lifo(core, w);
+    }
+
+    /**
+     * Schedule a behaviour that has yielded to run again on the current core.
+     * It is not stolen by other cores, and runs behind the core's other work,
+     * see `SchedulerThread::get_work`.  Outside a scheduler thread, or in a
+     * blocking section, this is the same as `schedule`.
+     */
+    static void schedule_rerun(Work* w)
+    {
+      stats().rerun();
+      schedule_background(w);
+    }
+
+    /**
+     * Schedule housekeeping work to run on the current core without delaying
+     * its other work, in the same way as a behaviour that has yielded, see
+     * `schedule_rerun`.
+     */
+    static void schedule_background(Work* w)
+    {
+      auto* t = local();
+
+      if (t != nullptr && !t->core->blocked)
+      {
+        t->schedule_rerun(w);
+        return;
+      }
+
+      schedule(w);
+    }
+
+    /**
+     * Schedule `count` work items, linked from `first` to `last` through
+     * `next_in_queue`, as a single segment onto a core picked round robin.
+     * This wakes a run of readers with one queue operation.
+     */
+    static void schedule_segment(Work* first, Work* last, size_t count)
+    {
+      auto* core = round_robin();
+      T::schedule_segment(core, first, last, count);
+    }
+
+    /// Smallest run of a batch that `schedule_batch` gives to one core.
+    static constexpr size_t BATCH_CHUNK = 16;
+
+    /**
+     * Schedule `count` work items from an external source, such as a burst
+     * of I/O completions, as `schedule` does for each of them from a thread
+     * outside the runtime.  The items are split into at most one run per
+     * core, each of at least `BATCH_CHUNK` items, and each run is linked
+     * through `next_in_queue` and put at the front of the queue of a core
+     * picked round robin with a single operation.  Threads are then woken
+     * once for the whole batch, rather than once per item.
+     *
+     * `items` is only read; it can be reused once this returns.
+     */
+    static void schedule_batch(Work** items, size_t count)
+    {
+      if (count == 0)
+        return;
+
+      auto runs =
+        std::min(get_core_count(), (count + BATCH_CHUNK - 1) / BATCH_CHUNK);
+      auto run = (count + runs - 1) / runs;
+
+      Core* first_core = nullptr;
+      for (size_t start = 0; start < count; start += run)
+      {
+        auto n = std::min(run, count - start);
+        auto* core = round_robin();
+        schedule_batch_on(core, items + start, n, false);
+        if (first_core == nullptr)
+          first_core = core;
+      }
+
+      T::unpause_for(first_core, count);
+    }
+
+    /**
+     * Schedule `count` work items from an external source onto the front of
+     * the queue of `core`, with a single operation, for instance when the
+     * whole batch is for the core that owns the relevant cache lines.
+     */
+    static void
+    schedule_batch_on(Core* core, Work** items, size_t count, bool wake = true)
+    {
+      assert(core != nullptr);
+      if (count == 0)
+        return;
+
+      for (size_t i = 0; i + 1 < count; i++)
+        items[i]->next_in_queue.store(items[i + 1], std::memory_order_relaxed);
+
+      T::inject_lifo_segment(core, items[0], items[count - 1], count);
+      if (wake)
+        T::unpause_for(core, count);
+    }
+
+    /**
+     * Schedule work onto the queue of a specific core.  This can be called
+     * from external threads, for instance to route I/O completions to the
+     * core that owns the relevant cache lines.
+     */
+    static void schedule_on(Core* core, Work* w)
+    {
+      assert(core != nullptr);
+      auto* t = local();
+
+      if (t != nullptr && !t->core->blocked)
+      {
+        if (t->core == core)
+        {
+          t->schedule_fifo(w);
+          return;
+        }
+
+        if (get().share_nothing && t->deliver(core, w))
+          return;
+
+        if (get().stage_remote_work)
+        {
+          t->stage_remote(core, w);
+          return;
+        }
+      }
+
+      T::schedule_fifo_on(core, w);
+    }
+
+    /**
+     * Schedule work of scheduling group `group`, other than the default,
+     * onto the queue for that group of `core`, or of the current thread's
+     * core if `core` is nullptr, see `set_group_weight`.  From an external
+     * thread with no core given, a core is picked round robin.
+     */
+    static void schedule_grouped(Work* w, size_t group, Core* core = nullptr)
+    {
+      if (core == nullptr)
+      {
+        core = available_local_core();
+        if (core == nullptr)
+          core = round_robin();
+      }
+
+      T::schedule_grouped(core, w, group);
     }
 
-    /// Decrement the external event source count. This will allow runtime
-    /// teardown if the count drops to zero.
-    static void remove_external_event_source()
+    /**
+     * Schedule work onto the high priority queue of `core`, or of the current
+     * thread's core if `core` is nullptr.  From an external thread with no
+     * core given, a core is picked round robin.  With no core given, work
+     * is moved from an efficiency core to a performance core, see
+     * `Core::efficiency`.
+     */
+    static void schedule_high(Work* w, Core* core = nullptr)
     {
-      // Must be called from inside a scheduler thread,
-      // A message can be LIFO scheduled to call this.
-      // Note, if this is not called from a scheduler thread, then the following
-      // can happen
-      //   1. All scheduler threads decide to pause the runtime but stop just
-      //      before waiting on the condition variable.
-      //   2. This code runs and calls notify, but no threads see this.
-      //   3. All the scheduler threads go call wait on condition variables.
-      // This leads to the system becoming inactive, and will never wake up.
-      // Forcing this code to be injected onto a scheduler thread by a message
-      // means the runtime cannot be attempting to pause while this code is
-      // running.
-      assert(local() != nullptr);
+      if (core == nullptr)
+      {
+        core = available_local_core();
+        if (core == nullptr)
+          core = round_robin();
+        if (core->efficiency)
+          core = performance_round_robin(core);
+      }
 
-      auto& s = get();
-      auto h = s.sync.handle(local());
-      auto prev_count = s.external_event_sources--;
-      assert(prev_count != 0);
-      Logging::cout() << "Remove external event source (now "
-                      << (prev_count - 1) << ")" << Logging::endl;
+      T::schedule_high(core, w);
     }
 
-    static void set_fair(bool fair)
+    /**
+     * Schedule work onto the high priority queue of `core` if it is
+     * reserved, and otherwise of a reserved core, see
+     * `set_reserved_core_count`.  If there are no reserved cores, this is
+     * the same as `schedule_high`.
+     */
+    static void schedule_critical(Work* w, Core* core = nullptr)
     {
-      Logging::cout() << "Set fair: " << fair << Logging::endl;
+      if ((core == nullptr) || !core->reserved)
+      {
+        auto reserved = reserved_round_robin();
+        if (reserved == nullptr)
+        {
+          schedule_high(w, core);
+          return;
+        }
+        core = reserved;
+      }
+
+      T::schedule_high(core, w);
+
+      // No other thread can take the work, and the thread woken above may
+      // not be this core's, if it lost a race with another wake up, so make
+      // sure it is awake.
       auto& s = get();
-      s.fair = fair;
+      if (s.has_waiting_threads())
+        s.sync.unpause_some(local(), 1, core);
     }
 
-    static bool is_teardown_in_progress()
+    /**
+     * Schedule work with a deadline, as given by `DeadlineQueue::now`, onto
+     * the deadline queue of `core`, or of the current thread's core if `core`
+     * is nullptr.  Scheduler threads run work in earliest deadline first
+     * order ahead of their other queues.
+     */
+    static void
+    schedule_deadline(Work* w, uint64_t deadline, Core* core = nullptr)
     {
-      return get().teardown_in_progress;
+      if (core == nullptr)
+        core = available_local_core();
+
+      if (core == nullptr)
+        core = round_robin();
+
+      T::schedule_deadline(core, w, deadline);
     }
 
-    static T*& local()
+    /**
+     * Returns the core at `index` in the ring of cores, wrapping around.
+     *
+     * Only valid between `init` and the end of `run`.
+     */
+    static Core* get_core(size_t index)
     {
-      static thread_local T* local;
-      return local;
+      auto& s = get();
+      Core* c = s.first_core();
+      for (index %= s.core_pool.core_count; index > 0; index--)
+        c = c->next;
+      return c;
     }
 
-    static Core* round_robin()
+    /**
+     * Returns a core on the NUMA node `node`.  Successive calls on the same
+     * thread cycle through the cores on that node.  If there are no cores on
+     * the node, an arbitrary core is returned.
+     *
+     * Only valid between `init` and the end of `run`.
+     */
+    static Core* get_core_on_numa_node(size_t node)
     {
-      static thread_local size_t incarnation;
-      static thread_local Core* nonlocal;
-
-      if (incarnation != get().incarnation)
-      {
-        incarnation = get().incarnation;
-        nonlocal = get().first_core();
-      }
-      else
+      Core* start = round_robin();
+      Core* c = start;
+      do
       {
-        nonlocal = nonlocal->next;
-      }
+        if (c->numa_node == node)
+          return c;
+        c = round_robin();
+      } while (c != start);
 
-      return nonlocal;
+      return start;
     }
 
-    static void schedule(Work* w, bool fifo = true)
+    /**
+     * The number of threads used if `init` is passed a count of 0.  This is
+     * the number of cpus this process can run on, limited by the cgroup CPU
+     * quota, so that a container with a small quota on a large machine does
+     * not start a thread per host cpu.
+     */
+    static size_t default_thread_count()
     {
-      auto* t = local();
-
-      if (t != nullptr && fifo)
-      {
-        t->schedule_fifo(w);
-        return;
-      }
-
-      auto* core = round_robin();
-      T::schedule_lifo(core, w);
+      return CorePool<ThreadPool<T>>::available_cpus();
     }
 
+    /**
+     * Initialise the runtime with `count` scheduler threads.  If `count` is
+     * 0, `default_thread_count()` is used instead.
+     */
     void init(size_t count, void (*run_at_termination)(void) = nullptr)
     {
-      Logging::cout() << "Init runtime" << Logging::endl;
+      VERONA_LOG << "Init runtime" << Logging::endl;
 
-      if ((thread_count != 0) || (count == 0))
+      if (thread_count != 0)
         abort();
 
+      if (count == 0)
+      {
+        count = default_thread_count();
+        VERONA_LOG << "Using default thread count " << count
+                   << " (cpus available after affinity and quota)"
+                   << Logging::endl;
+      }
+      else
+      {
+        VERONA_LOG << "Using explicit thread count " << count
+                   << " (default would be " << default_thread_count() << ")"
+                   << Logging::endl;
+      }
+
+      // Cores kept from the last run are reused if they are the same.
+      auto reserved = std::min(reserved_cores, count - 1);
+      if (
+        (core_pool.core_count != count) ||
+        (core_pool.reserved_count != reserved))
+        release_retained();
+
       thread_count = count;
+      active_core_count = count;
+      started_cores = count;
       teardown_in_progress = false;
+      spin_max_ticks = Clock::from_ns(spin_max_ns);
+      spin_min_ticks = Clock::from_ns(spin_min_ns);
 
       // Initialize the corepool.
-      core_pool.init(count);
+      if (core_pool.first_core == nullptr)
+      {
+        auto policy = affinity_policy;
+        auto cpus = affinity_cpus();
+        auto env = getenv("VERONA_AFFINITY");
+        if ((env != nullptr) && !parse_affinity_policy(env, policy, cpus))
+          VERONA_LOG << "Ignoring VERONA_AFFINITY: " << env << Logging::endl;
+        if (
+          (env == nullptr) && low_jitter &&
+          (policy != AffinityPolicy::Explicit) && isolated_cpus(cpus))
+          policy = AffinityPolicy::Explicit;
+        core_pool.init(count, policy, cpus, reserved);
+      }
+
+      Core* c = first_core();
+      do
+      {
+        c->q.set_steal_mode(steal_mode, steal_bound);
+        c->q.set_age_aware(age_aware);
+        c->parked.store(false, std::memory_order_relaxed);
+        c->blocked.store(false, std::memory_order_relaxed);
+        c->init_inboxes(share_nothing ? count : 0);
+        c = c->next;
+      } while (c != first_core());
 
       // For future ids.
       systematic_ids = count + 1;
@@ -226,8 +1374,11 @@ namespace verona::rt
 #endif
         threads.add_free(t);
       }
-      Logging::cout() << "Runtime initialised" << Logging::endl;
-      init_barrier();
+      if (low_jitter && lock_memory && !prefault::lock_all())
+        VERONA_LOG << "Unable to lock memory for low jitter" << Logging::endl;
+
+      VERONA_LOG << "Runtime initialised" << Logging::endl;
+      init_barrier(thread_count);
     }
 
     void run()
@@ -238,13 +1389,53 @@ namespace verona::rt
     template<typename... Args>
     void run_with_startup(void (*startup)(Args...), Args... args)
     {
+#ifdef USE_SYSTEMATIC_TESTING
+      bool retain = false;
+      size_t start_count = thread_count;
+#else
+      bool retain = retain_threads;
+      bool lazy = lazy_start && !retain && !share_nothing &&
+        (core_pool.reserved_count == 0);
+      size_t start_count = lazy ? 1 : thread_count;
+#endif
+      std::tuple<void (*)(Args...), Args...> spawn_with{startup, args...};
+      std::list<PlatformThread> spawned;
+      spawned_threads = &spawned;
+      start_tick = Clock::fast();
+      started_cores = start_count;
+      spawnable = std::min(thread_count - start_count, spawn_budget);
+      spawn_args = &spawn_with;
+      spawn_body = [](ThreadPool* pool, T* t) {
+        cpu::set_affinity(t->core->affinity);
+        std::apply(
+          [t](auto s, auto... a) { T::run(t, s, a...); },
+          *static_cast<decltype(spawn_with)*>(pool->spawn_args));
+      };
+      if (start_count != thread_count)
+      {
+        init_barrier(start_count);
+        Core* c = first_core();
+        for (size_t i = 0; i < thread_count; i++)
+        {
+          if (i >= start_count)
+            c->parked.store(true, std::memory_order_relaxed);
+          c = c->next;
+        }
+      }
+
+      if (retain)
+      {
+        run_retained();
+      }
+      else
       {
-        ThreadPoolBuilder builder(thread_count);
+        ThreadPoolBuilder builder(start_count);
 
-        Logging::cout() << "Starting all threads" << Logging::endl;
+        VERONA_LOG << "Starting " << start_count << " threads"
+                   << Logging::endl;
         auto first_core = core_pool.first_core;
         auto curr_core = first_core;
-        for (size_t i = 0; i < thread_count; i++)
+        for (size_t i = 0; i < start_count; i++)
         {
           T* t = threads.pop_free();
           if (t == nullptr)
@@ -255,9 +1446,13 @@ namespace verona::rt
           curr_core = curr_core->next;
         }
       }
-      Logging::cout() << "All threads stopped" << Logging::endl;
+      join_spawned_threads();
+      spawnable = 0;
+      spawned_threads = nullptr;
+      VERONA_LOG << "All threads stopped" << Logging::endl;
       threads.dealloc_lists();
-      Logging::cout() << "All threads deallocated" << Logging::endl;
+      barrier.clear();
+      VERONA_LOG << "All threads deallocated" << Logging::endl;
 
       incarnation++;
 #ifdef USE_SYSTEMATIC_TESTING
@@ -268,10 +1463,23 @@ namespace verona::rt
       // ABA issues on the queue.  The runtime is in a consistent
       // state so no ABAs can exist anymore.
       Epoch::flush();
+      Hazard::flush();
 
-      core_pool.clear();
+#ifdef USE_SCHED_STATS
+      Core* c = core_pool.first_core;
+      for (size_t i = 0; i < core_pool.core_count; i++)
+      {
+        c->stats.dump_core(std::cout, incarnation - 2, c->index);
+        c = c->next;
+      }
+#endif
+      if (!retain)
+        core_pool.clear();
 
       SchedulerStats::dump_global(std::cout, incarnation - 2);
+#ifdef USE_COWN_PROFILE
+      CownProfile::dump(std::cout);
+#endif
     }
 
     static bool debug_not_running()
@@ -280,23 +1488,209 @@ namespace verona::rt
     }
 
   private:
+    /// Cpus for `AffinityPolicy::Explicit`.  Not a member, as the pool must
+    /// be constant initialised.
+    static std::vector<size_t>& affinity_cpus()
+    {
+      static std::vector<size_t> cpus;
+      return cpus;
+    }
+
+    /**
+     * Start a thread for the next core without one, if the budget allows.
+     * Called by scheduler threads when work is building up, see
+     * `set_lazy_start`.
+     */
+    SNMALLOC_SLOW_PATH void spawn_thread()
+    {
+      T* t;
+      {
+        auto h = sync.handle(local());
+        auto started = started_cores.load(std::memory_order_relaxed);
+        if (
+          teardown_in_progress || (started >= active_core_count) ||
+          (spawnable.load(std::memory_order_relaxed) == 0))
+          return;
+
+        Core* c = first_core();
+        for (size_t i = 0; i < started; i++)
+          c = c->next;
+
+        t = threads.pop_free();
+        if (t == nullptr)
+          abort();
+        t->set_core(c);
+        threads.add_active(t);
+
+        // Counted as active from now, so the runtime cannot stop before the
+        // thread has started and looked for work.
+        state.inc_active_threads();
+        started_cores.store(started + 1, std::memory_order_relaxed);
+        spawnable.fetch_sub(1, std::memory_order_relaxed);
+        c->parked.store(false, std::memory_order_seq_cst);
+        c->stats.spawn(Clock::fast() - start_tick);
+      }
+
+      VERONA_LOG << "Starting thread for core " << t->core->affinity
+                 << Logging::endl;
+      snmalloc::FlagLock l{spawned_lock};
+      spawned_threads->emplace_back(spawn_body, this, t);
+    }
+
+    /**
+     * Run the scheduler threads on the retained threads, starting them on
+     * the first run, and wait for them all to finish.
+     */
+    void run_retained()
+    {
+      if (retained == nullptr)
+        retained = new Retained;
+      auto& r = *retained;
+
+      VERONA_LOG << "Resuming " << thread_count << " retained threads"
+                 << Logging::endl;
+      {
+        std::unique_lock<std::mutex> l(r.m);
+        r.slots.clear();
+        Core* c = first_core();
+        for (size_t i = 0; i < thread_count; i++)
+        {
+          T* t = threads.pop_free();
+          if (t == nullptr)
+            abort();
+          t->set_core(c);
+          threads.add_active(t);
+          r.slots.push_back(t);
+          c = c->next;
+        }
+        r.running = thread_count;
+        r.generation++;
+      }
+
+      if (r.threads.empty())
+      {
+        r.threads.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; i++)
+          r.threads.emplace_back(&retained_main, this, i);
+      }
+      else
+      {
+        assert(r.threads.size() == thread_count);
+        r.start.notify_all();
+      }
+
+      std::unique_lock<std::mutex> l(r.m);
+      r.done.wait(l, [&r]() { return r.running == 0; });
+    }
+
+    static void retained_main(ThreadPool* pool, size_t index)
+    {
+      auto& r = *pool->retained;
+      uint64_t seen = 0;
+      while (true)
+      {
+        T* t;
+        {
+          std::unique_lock<std::mutex> l(r.m);
+          r.start.wait(
+            l, [&r, seen]() { return r.exit || (r.generation != seen); });
+          if (r.exit)
+            return;
+          seen = r.generation;
+          t = r.slots[index];
+        }
+
+        pool->spawn_body(pool, t);
+
+        std::unique_lock<std::mutex> l(r.m);
+        if (--r.running == 0)
+          r.done.notify_all();
+      }
+    }
+
+    /**
+     * Stop and join the retained threads, and free the cores kept between
+     * runs.  Must not be called while the runtime is running.
+     */
+    void release_retained()
+    {
+      if (retained != nullptr)
+      {
+        {
+          std::unique_lock<std::mutex> l(retained->m);
+          retained->exit = true;
+        }
+        retained->start.notify_all();
+        for (auto& t : retained->threads)
+          t.join();
+        delete retained;
+        retained = nullptr;
+      }
+
+      // Between `init` and `run` the cores are in use.
+      if (thread_count == 0)
+        core_pool.clear();
+    }
+
+    void join_spawned_threads()
+    {
+      // A thread being joined may start another, so look again after each.
+      while (true)
+      {
+        std::optional<PlatformThread> thread;
+        {
+          snmalloc::FlagLock l{spawned_lock};
+          if (spawned_threads->empty())
+            return;
+          thread.emplace(std::move(spawned_threads->front()));
+          spawned_threads->pop_front();
+        }
+        thread->join();
+      }
+    }
+
+    /**
+     * Wait in the I/O poller instead of pausing, if one is set, events are
+     * expected, and no other thread is already waiting in it.  Returns
+     * whether it waited.
+     */
+    bool poll_external_io()
+    {
+      if (
+        (io_poller == nullptr) ||
+        (external_event_sources.load(std::memory_order_relaxed) == 0))
+        return false;
+
+      // Events are handled on the reserved cores, if there are any.
+      if ((core_pool.reserved_count != 0) && !local()->core->reserved)
+        return false;
+
+      if (io_polling.exchange(true, std::memory_order_acquire))
+        return false;
+
+      io_poller(io_poller_context, io_poll_timeout_ns);
+      io_polling.store(false, std::memory_order_release);
+      return true;
+    }
+
     bool check_for_work()
     {
-      // TODO: check for pending async IO
+      // Pending I/O is collected before pausing by the threads that wait
+      // for it, see `SchedulerThread::steal`.
       Core* c = first_core();
       do
       {
-        Logging::cout() << "Checking for pending work on thread " << c->affinity
-                        << Logging::endl;
-        if (!c->q.is_empty())
+        VERONA_LOG << "Checking for pending work on thread " << c->affinity
+                   << Logging::endl;
+        if (!c->is_empty())
         {
-          Logging::cout() << "Found pending work!" << Logging::endl;
+          VERONA_LOG << "Found pending work!" << Logging::endl;
           return true;
         }
         c = c->next;
       } while (c != first_core());
 
-      Logging::cout() << "No pending work!" << Logging::endl;
+      VERONA_LOG << "No pending work!" << Logging::endl;
       return false;
     }
 
@@ -314,8 +1708,10 @@ namespace verona::rt
 
       yield();
 
-      // Work has become available, we shouldn't pause.
-      if (check_for_work())
+      // Work has become available, we shouldn't pause.  In share-nothing
+      // mode, only work on this thread's core can be taken.
+      auto* core = local()->core;
+      if (share_nothing ? !core->is_empty() : check_for_work())
         return false;
 
       yield();
@@ -328,14 +1724,31 @@ namespace verona::rt
           local_unpause_epoch != unpause_epoch.load(std::memory_order_relaxed))
           return false;
 
+        if (share_nothing)
+        {
+          // Either this sees work queued on the core since the check above,
+          // or the thread that queued it sees the flag, see `wake_core`.
+          core->pausing.store(true, std::memory_order_relaxed);
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+          if (!core->is_empty())
+          {
+            core->pausing.store(false, std::memory_order_relaxed);
+            return false;
+          }
+        }
+
         // Check if we should wait for other threads to generate more work.
         auto value = state.get_active_threads();
         if (value > 1)
         {
           state.dec_active_threads();
-          Logging::cout() << "Pausing" << Logging::endl;
+          VERONA_LOG << "Pausing" << Logging::endl;
+          paused_threads++;
+          VERONA_PROBE1(pause, paused_threads.load());
           h.pause(); // Spurious wake-ups are safe.
-          Logging::cout() << "Unpausing" << Logging::endl;
+          paused_threads--;
+          core->pausing.store(false, std::memory_order_relaxed);
+          VERONA_LOG << "Unpausing" << Logging::endl;
           state.inc_active_threads();
           return true;
         }
@@ -343,30 +1756,65 @@ namespace verona::rt
         // There are external sources should wait for external wake ups.
         if (external_event_sources != 0)
         {
-          Logging::cout() << "Pausing last thread" << Logging::endl;
+          VERONA_LOG << "Pausing last thread" << Logging::endl;
+          paused_threads++;
+          VERONA_PROBE1(pause, paused_threads.load());
           h.pause(); // Spurious wake-ups are safe.
-          Logging::cout() << "Unpausing last thread" << Logging::endl;
+          paused_threads--;
+          core->pausing.store(false, std::memory_order_relaxed);
+          VERONA_LOG << "Unpausing last thread" << Logging::endl;
           return true;
         }
 
-        Logging::cout() << "Teardown beginning" << Logging::endl;
+        core->pausing.store(false, std::memory_order_relaxed);
+
+        // Only this core was checked for work above.
+        if (share_nothing && check_for_work())
+        {
+          h.unpause_all();
+          return false;
+        }
+
+        VERONA_LOG << "Teardown beginning" << Logging::endl;
         // Used to handle deallocating all the state of the threads.
         teardown_in_progress = true;
 
         // Tell all threads to stop looking for work.
         threads.forall([](T* thread) { thread->stop(); });
-        Logging::cout() << "Teardown: all threads stopped" << Logging::endl;
+        VERONA_LOG << "Teardown: all threads stopped" << Logging::endl;
 
         h.unpause_all();
-        Logging::cout() << "cv_notify_all() for teardown" << Logging::endl;
+        VERONA_LOG << "cv_notify_all() for teardown" << Logging::endl;
       }
-      Logging::cout() << "Teardown: all threads beginning teardown"
-                      << Logging::endl;
+      VERONA_LOG << "Teardown: all threads beginning teardown" << Logging::endl;
       return true;
     }
 
+    /**
+     * Returns true if some thread is pausing or paused, and has not yet been
+     * unpaused.  This is racy, and should only be used as a heuristic.
+     */
+    bool has_waiting_threads()
+    {
+      return pause_epoch.load(std::memory_order_relaxed) !=
+        unpause_epoch.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Make sure the thread of `c` is awake, after work has been queued on
+     * `c` in share-nothing mode, where no other thread can take it.
+     * `unpause` may wake a different thread, if it loses a race with another
+     * wake up.
+     */
+    void wake_core(Core* c)
+    {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (c->pausing.load(std::memory_order_relaxed))
+        sync.unpause_core(local(), c);
+    }
+
     SNMALLOC_SLOW_PATH
-    bool unpause_slow()
+    bool unpause_slow(size_t count, Core* target)
     {
       auto local_unpause_epoch = unpause_epoch.load(std::memory_order_acquire);
 
@@ -379,9 +1827,15 @@ namespace verona::rt
 
       yield();
 
-      // Attempt to catch up epoch.
+      // Attempt to move the epoch forward by the number of threads we are
+      // going to wake, catching up at most to pause_epoch.  Each sleeping
+      // thread accounts for at least one step of pause_epoch, so if threads
+      // remain asleep, pause_epoch remains ahead, and a later unpause will
+      // wake them.
+      auto new_unpause_epoch =
+        std::min<uint64_t>(local_pause_epoch, local_unpause_epoch + count);
       bool success = unpause_epoch.compare_exchange_strong(
-        local_unpause_epoch, local_pause_epoch);
+        local_unpause_epoch, new_unpause_epoch);
 
       yield();
 
@@ -389,18 +1843,26 @@ namespace verona::rt
       {
         // This grabs the scheduler lock to ensure threads have seen CAS before
         // we notify.
-        Logging::cout() << "Wake all threads" << Logging::endl;
-        sync.unpause_all(local());
+        VERONA_LOG << "Wake " << count << " threads" << Logging::endl;
+        VERONA_PROBE1(unpause, count);
+        sync.unpause_some(local(), count, target);
         return true;
       }
       // Another thread won the CAS race, and is responsible for waking up.
       return false;
     }
 
+    /**
+     * Called after work has been made available.  Wakes up to `count` paused
+     * threads, proportional to the amount of work made available, preferring
+     * a thread on the `target` core.
+     *
+     * Returns true if this call was responsible for waking threads.
+     */
     SNMALLOC_FAST_PATH
-    bool unpause()
+    bool unpause(size_t count = 1, Core* target = nullptr)
     {
-      Logging::cout() << "unpause()" << Logging::endl;
+      VERONA_LOG << "unpause()" << Logging::endl;
       // Adding work using seq_cst so will be visible
       // to other modifying the epochs.
 
@@ -415,32 +1877,37 @@ namespace verona::rt
       if (SNMALLOC_LIKELY(local_unpause_epoch == local_pause_epoch))
         return false;
 
-      return unpause_slow();
+      return unpause_slow(count, target);
     }
 
-    void init_barrier()
+    /**
+     * Set up the barrier for the first `count` cores of the ring, which are
+     * the ones started.  The cores of each NUMA node get consecutive slots,
+     * so that they share the lower counters of the tree, see `TreeBarrier`.
+     */
+    void init_barrier(size_t count)
     {
-      state.set_barrier(thread_count);
+      state.set_active_threads(count);
+
+      std::vector<Core*> cores;
+      Core* c = first_core();
+      for (size_t i = 0; i < count; i++, c = c->next)
+        cores.push_back(c);
+      std::stable_sort(cores.begin(), cores.end(), [](Core* a, Core* b) {
+        return a->numa_node < b->numa_node;
+      });
+      for (size_t i = 0; i < count; i++)
+        cores[i]->barrier_slot = i;
+
+      barrier.init(count);
     }
 
+    /**
+     * Wait until every started scheduler thread has entered the barrier.
+     */
     void enter_barrier()
     {
-      auto inc = barrier_incarnation;
-      {
-        auto h = sync.handle(local());
-        auto barrier_count = state.exit_thread();
-        if (barrier_count != 0)
-        {
-          while (inc == barrier_incarnation)
-          {
-            h.pause();
-          }
-          return;
-        }
-        init_barrier();
-        barrier_incarnation++;
-        h.unpause_all();
-      }
+      barrier.arrive(local()->core->barrier_slot);
     }
 
   public:
@@ -451,5 +1918,95 @@ namespace verona::rt
         return l->get_stats();
       return SchedulerStats::get_global();
     }
+
+    /**
+     * Approximate totals of the scheduler counters, over every core and work
+     * off scheduler threads, see `SchedulerStats`.  May be called from any
+     * thread, but not while the runtime is starting or being torn down.
+     *
+     * The counters are not reset between runs, unless they are dumped when
+     * built with `USE_SCHED_STATS`, so they only grow.
+     */
+    static SchedulerStats::Snapshot stats_snapshot()
+    {
+      SchedulerStats::Snapshot snapshot{};
+      SchedulerStats::get_global().add_to(snapshot);
+
+      Core* first = get().core_pool.first_core;
+      if (first != nullptr)
+      {
+        Core* c = first;
+        do
+        {
+          c->stats.add_to(snapshot);
+          c = c->next;
+        } while (c != first);
+      }
+      return snapshot;
+    }
+
+    /**
+     * As `stats_snapshot`, but for each core separately, in ring order, and
+     * without the counters of work off scheduler threads.
+     */
+    static std::vector<SchedulerStats::Snapshot> core_stats_snapshots()
+    {
+      std::vector<SchedulerStats::Snapshot> snapshots;
+
+      Core* first = get().core_pool.first_core;
+      if (first != nullptr)
+      {
+        Core* c = first;
+        do
+        {
+          c->stats.add_to(snapshots.emplace_back());
+          c = c->next;
+        } while (c != first);
+      }
+      return snapshots;
+    }
+
+    /**
+     * A snapshot of the load on the scheduler, for autoscaling or feedback
+     * to a load balancer.  May be called from any thread, with the same
+     * restrictions as `stats_snapshot`.  It takes no locks and reads a few
+     * words per core, so it is cheap enough to poll frequently; rates, such
+     * as `SchedulerSnapshot::executed_per_second`, come from comparing two
+     * snapshots.
+     */
+    static SchedulerSnapshot introspect()
+    {
+      auto& s = get();
+      SchedulerSnapshot snapshot;
+      snapshot.time = std::chrono::steady_clock::now();
+      snapshot.thread_count = s.thread_count;
+      snapshot.paused_threads =
+        s.paused_threads.load(std::memory_order_relaxed);
+      snapshot.active_core_count = s.active_core_count;
+      snapshot.external_event_sources =
+        s.external_event_sources.load(std::memory_order_relaxed);
+      snapshot.executed = stats_snapshot()[SchedulerStats::Executed];
+
+      Core* first = s.core_pool.first_core;
+      if (first != nullptr)
+      {
+        snapshot.cores.reserve(s.core_pool.core_count);
+        Core* c = first;
+        do
+        {
+          snapshot.cores.push_back(
+            {c->index,
+             c->q.length_estimate(),
+             !c->high_priority_q.is_empty() || !c->deadline_q.is_empty(),
+             c->parked.load(std::memory_order_relaxed),
+             c->blocked.load(std::memory_order_relaxed),
+             c->reserved,
+             c->servicing_threads.load(std::memory_order_relaxed),
+             c->stats.get(SchedulerStats::Executed)});
+          c = c->next;
+        } while (c != first);
+      }
+      return snapshot;
+    }
   };
 } // namespace verona::rt
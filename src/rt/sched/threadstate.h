@@ -14,7 +14,6 @@ namespace verona::rt
     struct StateCounters
     {
       size_t active_threads{0};
-      std::atomic<size_t> barrier_count{0};
 
       constexpr StateCounters() = default;
     };
@@ -25,18 +24,11 @@ namespace verona::rt
   public:
     constexpr ThreadState() = default;
 
-    void set_barrier(size_t thread_count)
+    void set_active_threads(size_t thread_count)
     {
-      internal_state.barrier_count = thread_count;
       internal_state.active_threads = thread_count;
     }
 
-    /// @warn Should be holding the threadpool lock.
-    size_t exit_thread()
-    {
-      return internal_state.barrier_count.fetch_sub(1) - 1;
-    }
-
     size_t get_active_threads()
     {
       return internal_state.active_threads;
@@ -26,6 +26,13 @@ namespace verona::rt
    *    has attempted to lock for unpause. Rather than waiting for the lock to
    *    become available, the thread currently holding the lock takes
    *    responsibility for unpausing the other threads.
+   *
+   * Threads waiting in `lock` form an MCS queue, each spinning on a flag in
+   * its own node, and only the head of the queue spins on the state.  When
+   * many threads pause at once they then take the lock in turn, rather than
+   * all retrying the same cache line, and a thread unpausing them is not
+   * held up behind that traffic.  `try_lock` and `lock_for_unpause` never
+   * wait, so they bypass the queue.
    */
   class SchedulerLock
   {
@@ -36,8 +43,17 @@ namespace verona::rt
       LockedUnpauseNeeded
     };
 
+    struct alignas(64) QueueNode
+    {
+      std::atomic<QueueNode*> next{nullptr};
+      std::atomic<bool> waiting{true};
+    };
+
     std::atomic<State> state{Unlocked};
 
+    /// The last thread waiting in `lock`, if any.
+    alignas(64) std::atomic<QueueNode*> tail{nullptr};
+
   public:
     constexpr SchedulerLock() = default;
 
@@ -46,7 +62,21 @@ namespace verona::rt
      */
     void lock()
     {
-      Logging::cout() << "Locking Scheduler." << Logging::endl;
+      VERONA_LOG << "Locking Scheduler." << Logging::endl;
+
+      // The node is only used until the lock is acquired, so it can live on
+      // the stack.
+      QueueNode node;
+      auto prev = tail.exchange(&node, std::memory_order_acq_rel);
+      if (prev != nullptr)
+      {
+        prev->next.store(&node, std::memory_order_release);
+        while (node.waiting.load(std::memory_order_acquire))
+        {
+          snmalloc::Aal::pause();
+        }
+      }
+
       auto u = Unlocked;
       while (!state.compare_exchange_strong(u, Locked))
       {
@@ -57,7 +87,37 @@ namespace verona::rt
           snmalloc::Aal::pause();
         }
       }
-      Logging::cout() << "Locking Scheduler done" << Logging::endl;
+
+      // Hand the head of the queue on to the next waiter.
+      auto next = node.next.load(std::memory_order_acquire);
+      if (next == nullptr)
+      {
+        auto last = &node;
+        if (tail.compare_exchange_strong(
+              last, nullptr, std::memory_order_acq_rel))
+        {
+          VERONA_LOG << "Locking Scheduler done" << Logging::endl;
+          return;
+        }
+
+        // A waiter has joined, but not yet linked itself to this node.
+        while ((next = node.next.load(std::memory_order_acquire)) == nullptr)
+        {
+          snmalloc::Aal::pause();
+        }
+      }
+      next->waiting.store(false, std::memory_order_release);
+      VERONA_LOG << "Locking Scheduler done" << Logging::endl;
+    }
+
+    /**
+     * Attempts to acquire the lock without spinning.  Returns true if the lock
+     * was acquired.
+     */
+    bool try_lock()
+    {
+      auto u = Unlocked;
+      return state.compare_exchange_strong(u, Locked);
     }
 
     /**
@@ -92,10 +152,14 @@ namespace verona::rt
     }
   };
 
+  class Core;
+
   struct LocalSync
   {
     pal::SleepHandle sem;
     LocalSync* next{nullptr};
+    /// The core the waiting thread is running on, used to target wake ups.
+    Core* core{nullptr};
   };
 
   template<class T>
@@ -106,12 +170,12 @@ namespace verona::rt
 
     void unlock()
     {
-      Logging::cout() << "Unlock Scheduler lock" << Logging::endl;
+      VERONA_LOG << "Unlock Scheduler lock" << Logging::endl;
 
       // Releasing the lock can pickup an unpause request
       if (!lock.unlock())
       {
-        Logging::cout() << "Pending unpause" << Logging::endl;
+        VERONA_LOG << "Pending unpause" << Logging::endl;
 
         auto* curr = waiters;
         waiters = nullptr;
@@ -133,10 +197,96 @@ namespace verona::rt
 
     void unpause_all(T*)
     {
-      Logging::cout() << "Unpause all" << Logging::endl;
+      VERONA_LOG << "Unpause all" << Logging::endl;
       if (lock.lock_for_unpause())
         unlock();
-      Logging::cout() << "Unpause all done" << Logging::endl;
+      VERONA_LOG << "Unpause all done" << Logging::endl;
+    }
+
+    /**
+     * Wake up to `count` paused threads, preferring a thread running on the
+     * `target` core, if there is one.
+     *
+     * If the lock is contended, this falls back to `unpause_all`, as the
+     * holder cannot be told how many threads to wake.  Waking more threads
+     * than required is always safe.
+     */
+    void unpause_some(T* t, size_t count, Core* target)
+    {
+      assert(count != 0);
+      if (!lock.try_lock())
+      {
+        unpause_all(t);
+        return;
+      }
+
+      VERONA_LOG << "Unpause " << count << Logging::endl;
+
+      LocalSync* woken = nullptr;
+      auto take = [&woken, &count](LocalSync** prev) {
+        auto curr = *prev;
+        *prev = curr->next;
+        curr->next = woken;
+        woken = curr;
+        count--;
+      };
+
+      if (target != nullptr)
+      {
+        for (LocalSync** prev = &waiters; *prev != nullptr;
+             prev = &(*prev)->next)
+        {
+          if ((*prev)->core == target)
+          {
+            take(prev);
+            break;
+          }
+        }
+      }
+
+      while ((count != 0) && (waiters != nullptr))
+        take(&waiters);
+
+      // Releasing the lock may pick up an unpause_all request, which will
+      // wake the remaining waiters.
+      unlock();
+
+      while (woken != nullptr)
+      {
+        auto next = woken->next;
+        woken->sem.wake();
+        woken = next;
+      }
+      VERONA_LOG << "Unpause done" << Logging::endl;
+    }
+
+    /**
+     * Wake the paused thread running on the `target` core, if there is one.
+     * As for `unpause_some`, a contended lock wakes all threads.
+     */
+    void unpause_core(T* t, Core* target)
+    {
+      if (!lock.try_lock())
+      {
+        unpause_all(t);
+        return;
+      }
+
+      LocalSync* woken = nullptr;
+      for (LocalSync** prev = &waiters; *prev != nullptr; prev = &(*prev)->next)
+      {
+        if ((*prev)->core == target)
+        {
+          woken = *prev;
+          *prev = woken->next;
+          break;
+        }
+      }
+
+      unlock();
+
+      if (woken != nullptr)
+        woken->sem.wake();
     }
 
     class ThreadSyncHandle
@@ -164,14 +314,15 @@ namespace verona::rt
        */
       void pause()
       {
-        Logging::cout() << "Add to list of waiters" << Logging::endl;
+        VERONA_LOG << "Add to list of waiters" << Logging::endl;
+        thread->local_sync.core = thread->core;
         thread->local_sync.next = sync.waiters;
         sync.waiters = &(thread->local_sync);
         sync.unlock();
 
-        Logging::cout() << "Sleep" << Logging::endl;
+        VERONA_LOG << "Sleep" << Logging::endl;
         thread->local_sync.sem.sleep();
-        Logging::cout() << "Awake!" << Logging::endl;
+        VERONA_LOG << "Awake!" << Logging::endl;
 
         sync.lock.lock();
       }
@@ -109,5 +109,24 @@ namespace verona::rt
     {
       handle(me).unpause_all();
     }
+
+    /**
+     * Systematic testing does not model which threads are woken, so this
+     * wakes all threads.  Waking more threads than required is always safe.
+     */
+    template<typename C>
+    void unpause_some(T* me, size_t count, C* target)
+    {
+      UNUSED(count);
+      UNUSED(target);
+      unpause_all(me);
+    }
+
+    template<typename C>
+    void unpause_core(T* me, C* target)
+    {
+      UNUSED(target);
+      unpause_all(me);
+    }
   };
 }
@@ -0,0 +1,383 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../ds/heap.h"
+#include "deadlinequeue.h"
+#include "notification.h"
+#include "schedulerthread.h"
+#include "work.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace verona::rt
+{
+  /**
+   * Timers owned by the runtime, which schedule work or notify
+   * `Notification`s once a delay has passed.
+   *
+   * Timers are kept in a hashed wheel of `SLOTS` buckets, one per tick of
+   * `resolution`, and are driven by a single thread that sleeps until the
+   * next tick with a timer due.  The work for all the timers that expire
+   * together is published as one segment, so a burst of timeouts wakes the
+   * scheduler once.  Scheduler threads can park while timers are pending,
+   * but the runtime does not stop: the wheel is an external event source
+   * while it has timers.
+   *
+   * Timers may fire late, by up to a tick plus the time for the timer thread
+   * to wake, but never early.  They must be added from inside the runtime,
+   * i.e. from a behaviour, so that the runtime cannot be stopping.
+   */
+  class TimerWheel
+  {
+  public:
+    /**
+     * A timer that has been added.  Only periodic timers are returned, as
+     * other timers may be freed as soon as they fire.
+     */
+    struct Timer
+    {
+      Timer* next;
+      /// Tick at which the timer is due.
+      uint64_t expiry;
+      /// Ticks between repeats, or 0 if the timer fires once.
+      uint64_t period;
+      /// Exactly one of these is set.
+      Work* work;
+      Notification* notification;
+      bool cancelled;
+    };
+
+  private:
+    static constexpr size_t SLOTS = 256;
+
+    std::mutex m;
+    std::condition_variable cv;
+
+    Timer* slots[SLOTS] = {};
+
+    /// Number of timers in the wheel, including cancelled ones.
+    size_t pending = 0;
+
+    /// The next tick to process.
+    uint64_t current;
+
+    /// The tick the timer thread is sleeping until, if it is sleeping.
+    uint64_t wake_tick = UINT64_MAX;
+
+    /// Nanoseconds per tick.
+    uint64_t resolution = 1000000;
+
+    std::thread thread;
+    bool stopping = false;
+
+    TimerWheel()
+    {
+      current = DeadlineQueue::now() / resolution;
+    }
+
+    ~TimerWheel()
+    {
+      {
+        std::unique_lock<std::mutex> lock(m);
+        stopping = true;
+      }
+      cv.notify_one();
+      if (thread.joinable())
+        thread.join();
+    }
+
+    static TimerWheel& get()
+    {
+      static TimerWheel wheel;
+      return wheel;
+    }
+
+    void insert(Timer* t)
+    {
+      auto& slot = slots[t->expiry % SLOTS];
+      t->next = slot;
+      slot = t;
+    }
+
+    /// Tick at which the timer thread should next wake.
+    uint64_t next_due()
+    {
+      for (uint64_t tick = current; tick < current + SLOTS; tick++)
+      {
+        for (auto t = slots[tick % SLOTS]; t != nullptr; t = t->next)
+        {
+          if (t->expiry == tick)
+            return tick;
+        }
+      }
+      // Everything is at least a full turn of the wheel away.
+      return current + SLOTS;
+    }
+
+    template<typename Rep, typename Period>
+    Timer* add(
+      std::chrono::duration<Rep, Period> delay,
+      std::chrono::duration<Rep, Period> period,
+      Work* work,
+      Notification* notification)
+    {
+      auto d = std::chrono::duration_cast<std::chrono::nanoseconds>(delay);
+      auto p = std::chrono::duration_cast<std::chrono::nanoseconds>(period);
+
+      auto t = static_cast<Timer*>(heap::alloc(sizeof(Timer)));
+      t->period = 0;
+      t->work = work;
+      t->notification = notification;
+      t->cancelled = false;
+
+      bool first;
+      bool wake;
+      {
+        std::unique_lock<std::mutex> lock(m);
+
+        // Round up, so that the timer never fires early.
+        auto due = DeadlineQueue::now() + static_cast<uint64_t>(d.count());
+        t->expiry = std::max((due + resolution - 1) / resolution, current);
+        if (p.count() > 0)
+          t->period = std::max<uint64_t>(
+            static_cast<uint64_t>(p.count()) / resolution, 1);
+        insert(t);
+
+        first = (pending++ == 0);
+        if (first)
+          Scheduler::add_external_event_source();
+
+        if (!thread.joinable())
+          thread = std::thread([this]() { run(); });
+
+        wake = t->expiry < wake_tick;
+      }
+
+      VERONA_LOG << "Timer: added " << t << " due at tick " << t->expiry
+                 << Logging::endl;
+      if (wake)
+        cv.notify_one();
+      return t;
+    }
+
+    /**
+     * Take the timers that are due by `now_tick` out of the wheel.  Periodic
+     * timers are put back, and notified straight away.  Returns the work to
+     * schedule through `first`, `last` and `count`, and the timers to free
+     * through `done`.
+     */
+    void expire(
+      uint64_t now_tick,
+      Work*& first,
+      Work*& last,
+      size_t& count,
+      Timer*& done)
+    {
+      Timer* repeat = nullptr;
+      auto end = std::min(now_tick + 1, current + SLOTS);
+      for (uint64_t tick = current; tick < end; tick++)
+      {
+        auto* prev = &slots[tick % SLOTS];
+        while (*prev != nullptr)
+        {
+          auto t = *prev;
+          if (t->expiry > now_tick)
+          {
+            prev = &t->next;
+            continue;
+          }
+          *prev = t->next;
+
+          if ((t->period != 0) && !t->cancelled)
+          {
+            // Notify now and skip any missed periods, as notifications
+            // coalesce anyway.
+            t->notification->notify();
+            while (t->expiry <= now_tick)
+              t->expiry += t->period;
+            t->next = repeat;
+            repeat = t;
+            continue;
+          }
+
+          pending--;
+          if ((t->work != nullptr) && !t->cancelled)
+          {
+            t->work->next_in_queue.store(nullptr, std::memory_order_relaxed);
+            if (first == nullptr)
+              first = t->work;
+            else
+              last->next_in_queue.store(t->work, std::memory_order_relaxed);
+            last = t->work;
+            count++;
+          }
+          t->next = done;
+          done = t;
+        }
+      }
+      current = now_tick + 1;
+
+      // Reinsert after the scan, so a short period is not processed twice.
+      while (repeat != nullptr)
+      {
+        auto t = repeat;
+        repeat = t->next;
+        insert(t);
+      }
+    }
+
+    void run()
+    {
+      std::unique_lock<std::mutex> lock(m);
+      while (!stopping)
+      {
+        if (pending == 0)
+        {
+          wake_tick = UINT64_MAX;
+          cv.wait(lock);
+          continue;
+        }
+
+        auto now_tick = DeadlineQueue::now() / resolution;
+        if (now_tick < current)
+        {
+          // Nothing can be due yet.
+          wake_tick = next_due();
+          cv.wait_until(
+            lock,
+            std::chrono::steady_clock::time_point(
+              std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::nanoseconds(wake_tick * resolution))));
+          continue;
+        }
+
+        wake_tick = UINT64_MAX;
+        Work* first = nullptr;
+        Work* last = nullptr;
+        size_t count = 0;
+        Timer* done = nullptr;
+        expire(now_tick, first, last, count, done);
+        bool idle = (pending == 0);
+
+        // Publishing the work and releasing notifications can run arbitrary
+        // code, which may add timers.
+        lock.unlock();
+
+        if (count != 0)
+        {
+          VERONA_LOG << "Timer: firing " << count << " timers" << Logging::endl;
+          Scheduler::schedule_segment(first, last, count);
+        }
+
+        while (done != nullptr)
+        {
+          auto t = done;
+          done = t->next;
+          if (t->notification != nullptr)
+          {
+            if (!t->cancelled)
+              t->notification->notify();
+            Shared::release(t->notification);
+          }
+          heap::dealloc(t, sizeof(Timer));
+        }
+
+        if (idle)
+        {
+          // The last timer has fired.  The count of external event sources
+          // must be changed on a scheduler thread, see
+          // `ThreadPool::remove_external_event_source`.
+          Scheduler::schedule(Closure::make([](Work*) {
+            Scheduler::remove_external_event_source();
+            return true;
+          }));
+        }
+
+        lock.lock();
+      }
+    }
+
+  public:
+    TimerWheel(const TimerWheel&) = delete;
+
+    /**
+     * Set the length of a tick.  This must be called before any timer is
+     * added.
+     */
+    static void set_resolution(std::chrono::nanoseconds r)
+    {
+      auto& w = get();
+      std::unique_lock<std::mutex> lock(w.m);
+      assert(w.pending == 0);
+      w.resolution = std::max<uint64_t>(static_cast<uint64_t>(r.count()), 1);
+      w.current = DeadlineQueue::now() / w.resolution;
+    }
+
+    /**
+     * Schedule `work` once `delay` has passed.  This takes ownership of
+     * `work`.
+     */
+    template<typename Rep, typename Period>
+    static void after(std::chrono::duration<Rep, Period> delay, Work* work)
+    {
+      get().add(delay, decltype(delay)::zero(), work, nullptr);
+    }
+
+    /**
+     * Notify `n` once `delay` has passed.  The timer holds a reference to
+     * `n` until then.
+     */
+    template<typename Rep, typename Period>
+    static void
+    after(std::chrono::duration<Rep, Period> delay, Notification* n)
+    {
+      Shared::acquire(n);
+      get().add(delay, decltype(delay)::zero(), nullptr, n);
+    }
+
+    /**
+     * Notify `n` every `period`, until the returned timer is passed to
+     * `cancel`.  The timer holds a reference to `n` until it is cancelled.
+     * While it is running the runtime does not stop.
+     */
+    template<typename Rep, typename Period>
+    static Timer*
+    every(std::chrono::duration<Rep, Period> period, Notification* n)
+    {
+      Shared::acquire(n);
+      return get().add(period, period, nullptr, n);
+    }
+
+    /**
+     * Stop a timer returned by `every`.  `t` must not be used afterwards.
+     * The notification may still run once if it is already due.  The timer
+     * is only removed, and stops holding the runtime open, when it next
+     * falls due.
+     */
+    static void cancel(Timer* t)
+    {
+      auto& w = get();
+      std::unique_lock<std::mutex> lock(w.m);
+      t->cancelled = true;
+    }
+  };
+
+  /**
+   * Schedule a lambda that does not require any cowns to run once `delay`
+   * has passed, see `TimerWheel`.
+   */
+  template<typename Rep, typename Period, typename Be>
+  static void
+  schedule_lambda_after(std::chrono::duration<Rep, Period> delay, Be&& f)
+  {
+    auto w = Closure::make([f = std::forward<Be>(f)](Work* w) mutable {
+      f();
+      return true;
+    });
+    TimerWheel::after(delay, w);
+  }
+} // namespace verona::rt
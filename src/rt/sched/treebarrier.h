@@ -0,0 +1,137 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../debug/systematic.h"
+#include "../ds/heap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * A barrier for a fixed number of threads, each of which arrives with its
+   * own slot, from 0 to the number of threads.
+   *
+   * The threads arrive at a tree of counters, each shared by `FAN_IN`
+   * threads or subtrees, so no counter is contended by more than `FAN_IN`
+   * threads.  The last to arrive at a counter carries on to its parent, and
+   * the last to arrive at the root releases the others, which wait for the
+   * generation to change.  The threads of consecutive slots share a counter,
+   * so giving the threads of a NUMA node consecutive slots keeps all but the
+   * top of the tree within nodes.
+   *
+   * The latency is then logarithmic in the number of threads, where a single
+   * counter would serialise all of them on one cache line.
+   */
+  class TreeBarrier
+  {
+  public:
+    static constexpr size_t FAN_IN = 4;
+
+  private:
+    struct alignas(64) Node
+    {
+      std::atomic<size_t> arrived{0};
+      size_t expected = 0;
+      Node* parent = nullptr;
+    };
+
+    Node* nodes = nullptr;
+    size_t node_count = 0;
+
+    /// Changed by the last thread to arrive, to release the others.
+    alignas(64) std::atomic<size_t> generation{0};
+
+    static size_t groups(size_t n)
+    {
+      return (n + FAN_IN - 1) / FAN_IN;
+    }
+
+  public:
+    constexpr TreeBarrier() = default;
+
+    TreeBarrier(const TreeBarrier&) = delete;
+    TreeBarrier& operator=(const TreeBarrier&) = delete;
+
+    ~TreeBarrier()
+    {
+      clear();
+    }
+
+    /**
+     * Set up the barrier for `threads` threads.  Must not be called while
+     * any thread is waiting at the barrier.
+     */
+    void init(size_t threads)
+    {
+      clear();
+      assert(threads > 0);
+
+      for (size_t n = threads; n > 1; n = groups(n))
+        node_count += groups(n);
+      node_count = std::max<size_t>(node_count, 1);
+      nodes = (Node*)heap::alloc(node_count * sizeof(Node));
+
+      // Each level of the tree follows the one below it.
+      size_t level = 0;
+      size_t below = threads;
+      do
+      {
+        size_t count = groups(below);
+        for (size_t i = 0; i < count; i++)
+        {
+          auto* n = new (&nodes[level + i]) Node();
+          n->expected = std::min(FAN_IN, below - (i * FAN_IN));
+          if (count > 1)
+            n->parent = &nodes[level + count + (i / FAN_IN)];
+        }
+        level += count;
+        below = count;
+      } while (below > 1);
+      assert(level == node_count);
+    }
+
+    /// Free the tree.  Must not be called while any thread is waiting.
+    void clear()
+    {
+      if (nodes == nullptr)
+        return;
+      heap::dealloc(nodes, node_count * sizeof(Node));
+      nodes = nullptr;
+      node_count = 0;
+    }
+
+    /**
+     * Wait until every thread has arrived, where this thread has `slot`.
+     * The barrier can then be used again straight away.
+     */
+    void arrive(size_t slot)
+    {
+      assert(nodes != nullptr);
+      size_t gen = generation.load(std::memory_order_acquire);
+
+      Node* n = &nodes[slot / FAN_IN];
+      while (n->arrived.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+             n->expected)
+      {
+        // Nobody arrives here again until the generation changes.
+        n->arrived.store(0, std::memory_order_relaxed);
+        if (n->parent == nullptr)
+        {
+          generation.store(gen + 1, std::memory_order_release);
+          return;
+        }
+        n = n->parent;
+      }
+
+      while (generation.load(std::memory_order_acquire) == gen)
+      {
+        Systematic::yield();
+        snmalloc::Aal::pause();
+      }
+    }
+  };
+} // namespace verona::rt
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "behaviourprofile.h"
 #include "epoch.h"
 
 #include <atomic>
@@ -26,6 +27,12 @@ namespace verona::rt
     // pointer and is responsible for all casting and memory management.
     void (*f)(Work*);
 
+#ifdef USE_AGE_STATS
+    /// When this was queued on a core, if its queue is age aware, see
+    /// `WorkStealingQueue::set_age_aware`.
+    uint64_t enqueued_tsc = 0;
+#endif
+
     constexpr Work(void (*f)(Work*)) : f(f) {}
 
     // Helper to run the item.
@@ -85,6 +92,7 @@ namespace verona::rt
       void* base = heap::alloc<sizeof(Work) + sizeof(T)>();
       T* t_base = snmalloc::pointer_offset<T>(base, sizeof(Work));
       new (t_base) T(std::forward<T>(t_param));
+      BehaviourProfile::name<T>(&invoke<T>);
       return new (base) Work(&invoke<T>);
     }
   };
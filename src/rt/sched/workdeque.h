@@ -0,0 +1,156 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../debug/systematic.h"
+#include "mpmcq.h"
+#include "work.h"
+
+#include <atomic>
+#include <cstdint>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * Bounded Chase-Lev work stealing deque, for the work a scheduler thread
+   * queues for its own core, see `Core::local_q`.
+   *
+   * Only the owning thread pushes and pops, at the bottom, which needs no
+   * read-modify-write unless it races a thief for the last element.  Other
+   * threads steal from the top, the oldest element, with a compare and swap.
+   * The owner can also take everything at once, oldest first, with a single
+   * compare and swap, to hand it over to a shared queue.
+   *
+   * The elements are held in a fixed ring, so `push` fails once `Capacity`
+   * elements are queued.
+   */
+  template<size_t Capacity>
+  class WorkDeque
+  {
+    static_assert(
+      snmalloc::bits::is_pow2(Capacity), "Capacity must be a power of two");
+
+    static constexpr size_t MASK = Capacity - 1;
+    static constexpr size_t CACHELINE = 64;
+
+    /// Next position to steal from, written by thieves and the owner.
+    alignas(CACHELINE) std::atomic<intptr_t> top{0};
+    /// Next position to push to, only written by the owner.
+    alignas(CACHELINE) std::atomic<intptr_t> bottom{0};
+    alignas(CACHELINE) std::atomic<Work*> slots[Capacity]{};
+
+  public:
+    constexpr WorkDeque() = default;
+
+    WorkDeque(const WorkDeque&) = delete;
+    WorkDeque& operator=(const WorkDeque&) = delete;
+
+    /// Add `w` at the bottom.  Owner only.  Returns false if full.
+    bool push(Work* w)
+    {
+      auto b = bottom.load(std::memory_order_relaxed);
+      auto t = top.load(std::memory_order_acquire);
+      if ((b - t) >= (intptr_t)Capacity)
+        return false;
+
+      slots[(size_t)b & MASK].store(w, std::memory_order_relaxed);
+      bottom.store(b + 1, std::memory_order_release);
+      return true;
+    }
+
+    /// Take the newest element.  Owner only.  Returns nullptr if empty.
+    Work* pop()
+    {
+      auto b = bottom.load(std::memory_order_relaxed) - 1;
+      bottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      Systematic::yield();
+      auto t = top.load(std::memory_order_relaxed);
+
+      if (t > b)
+      {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+      }
+
+      auto w = slots[(size_t)b & MASK].load(std::memory_order_relaxed);
+      if (t == b)
+      {
+        // The last element, which a thief may be taking as well.
+        if (!top.compare_exchange_strong(
+              t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+          w = nullptr;
+        bottom.store(b + 1, std::memory_order_relaxed);
+      }
+      return w;
+    }
+
+    /**
+     * Take the oldest element.  Any thread.  Returns nullptr, and sets
+     * `status` to why, if it could not.
+     */
+    Work* steal(QueueStatus& status)
+    {
+      auto t = top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto b = bottom.load(std::memory_order_acquire);
+      if (t >= b)
+      {
+        status = QueueStatus::Empty;
+        return nullptr;
+      }
+
+      auto w = slots[(size_t)t & MASK].load(std::memory_order_relaxed);
+      Systematic::yield();
+      if (!top.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      {
+        status = QueueStatus::Contended;
+        return nullptr;
+      }
+
+      status = QueueStatus::Taken;
+      return w;
+    }
+
+    /**
+     * Take every element, linked oldest first through `next_in_queue`, and
+     * return the segment and how many are in it.  Owner only.
+     */
+    std::pair<MPMCQ<Work>::Segment, size_t> take_all()
+    {
+      auto b = bottom.load(std::memory_order_relaxed);
+      auto t = top.load(std::memory_order_acquire);
+      while (true)
+      {
+        if (t >= b)
+          return {{nullptr, nullptr}, 0};
+
+        // Thieves only move `top` one at a time, so claiming the whole range
+        // fails, and is retried, if any of it has been stolen.
+        if (top.compare_exchange_weak(
+              t, b, std::memory_order_seq_cst, std::memory_order_acquire))
+          break;
+        Systematic::yield();
+      }
+
+      auto first = slots[(size_t)t & MASK].load(std::memory_order_relaxed);
+      auto last = first;
+      for (auto i = t + 1; i < b; i++)
+      {
+        auto w = slots[(size_t)i & MASK].load(std::memory_order_relaxed);
+        last->next_in_queue.store(w, std::memory_order_relaxed);
+        last = w;
+      }
+      return {{first, &last->next_in_queue}, (size_t)(b - t)};
+    }
+
+    /// True if nothing is queued.  Exact for the owner, a hint for others.
+    bool is_empty() const
+    {
+      return bottom.load(std::memory_order_acquire) <=
+        top.load(std::memory_order_acquire);
+    }
+  };
+} // namespace verona::rt
@@ -1,11 +1,25 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
 #include "../ds/wrapindex.h"
+#include "../pal/clock.h"
 #include "mpmcq.h"
 #include "work.h"
 
 namespace verona::rt
 {
+  /**
+   * How much work a single steal takes from a victim's sub-queue.
+   */
+  enum class StealMode
+  {
+    /// Take the whole sub-queue.
+    All,
+    /// Take roughly half of the sub-queue, and return the rest to the victim.
+    Half,
+    /// Take at most `steal_bound` items, and return the rest to the victim.
+    Bounded
+  };
+
   template<size_t N>
   class WorkStealingQueue
   {
@@ -15,39 +29,271 @@ namespace verona::rt
 
     MPMCQ<Work> queues[N];
 
+    StealMode steal_mode = StealMode::All;
+    size_t steal_bound = 0;
+
+    /// Estimate of the number of items queued, see `length_estimate`.
+    std::atomic<size_t> length{0};
+
+#ifdef USE_AGE_STATS
+    /// Stamp queued work, and steal the oldest, see `set_age_aware`.
+    bool age_aware = false;
+
+    /**
+     * Estimate of when the work at the front of each sub-queue was queued,
+     * or zero if it is thought to be empty.  The front itself cannot be
+     * read, as another thread may take and free it, so once an item is
+     * taken, this is its stamp until the sub-queue is emptied.
+     */
+    std::atomic<uint64_t> oldest[N]{};
+
+    static void set_stamp(Work* work, uint64_t now)
+    {
+      work->enqueued_tsc = now;
+    }
+
+    static uint64_t get_stamp(Work* work)
+    {
+      return work->enqueued_tsc;
+    }
+
+    void set_oldest(size_t index, uint64_t stamp)
+    {
+      oldest[index].store(stamp, std::memory_order_relaxed);
+    }
+
+    void note_oldest(size_t index, uint64_t stamp)
+    {
+      auto& o = oldest[index];
+      auto current = o.load(std::memory_order_relaxed);
+      if ((stamp != 0) && ((current == 0) || (stamp < current)))
+        o.store(stamp, std::memory_order_relaxed);
+    }
+
+    /**
+     * The victim sub-queue with the oldest front, or `steal_index` if none
+     * is thought to have work.
+     */
+    size_t oldest_index(WorkStealingQueue& victim)
+    {
+      size_t index = steal_index;
+      uint64_t best = 0;
+      for (size_t i = 0; i < N; i++)
+      {
+        auto stamp = victim.oldest[i].load(std::memory_order_relaxed);
+        if ((stamp != 0) && ((best == 0) || (stamp < best)))
+        {
+          best = stamp;
+          index = i;
+        }
+      }
+      return index;
+    }
+#else
+    /// Work is only stamped when built with `USE_AGE_STATS`.
+    static constexpr bool age_aware = false;
+
+    static void set_stamp(Work*, uint64_t) {}
+
+    static uint64_t get_stamp(Work*)
+    {
+      return 0;
+    }
+
+    void set_oldest(size_t, uint64_t) {}
+
+    void note_oldest(size_t, uint64_t) {}
+
+    size_t oldest_index(WorkStealingQueue&)
+    {
+      return (size_t)steal_index;
+    }
+#endif
+
+    void add_length(size_t n)
+    {
+      length.store(
+        length.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void sub_length(size_t n)
+    {
+      auto l = length.load(std::memory_order_relaxed);
+      length.store((l > n) ? (l - n) : 0, std::memory_order_relaxed);
+    }
+
     // Enqueue an entire segment onto the next enqueue queue.
     // Works in a round robin fashion.
     void enqueue(MPMCQ<Work>::Segment ls)
     {
-      queues[++enqueue_index].enqueue_segment(ls);
+      auto index = ++enqueue_index;
+      if (age_aware && (ls.start != nullptr))
+        note_oldest(index, get_stamp(ls.start));
+      queues[index].enqueue_segment(ls);
+    }
+
+    // Enqueue a single stolen node, keeping the time it was first queued.
+    void enqueue_stolen(Work* work)
+    {
+      enqueue({work, &work->next_in_queue});
+      add_length(1);
     }
 
     // Take a segment and spread it across the queues
-    // using a round robin strategy.
-    void enqueue_spread(MPMCQ<Work>::Segment ls)
+    // using a round robin strategy.  Returns roughly how many items were
+    // added to our queues.
+    size_t enqueue_spread(MPMCQ<Work>::Segment ls)
     {
+      size_t moved = 0;
       while (true)
       {
         auto n = ls.take_one();
         if (n == nullptr)
           break;
-        enqueue(n);
+        enqueue_stolen(n);
+        moved++;
       }
+      moved += ls.length_hint();
       enqueue(ls);
+      return moved;
+    }
+
+    // Having already taken `r` from the segment, take up to `limit` items in
+    // total, spreading all but `r` across our queues.  The remainder of the
+    // segment is put back onto the queue it was stolen from.  Returns roughly
+    // how many items were added to our queues.
+    size_t take_bounded(
+      WorkStealingQueue& victim,
+      size_t index,
+      MPMCQ<Work>::Segment ls,
+      size_t limit)
+    {
+      size_t moved = 0;
+      for (size_t taken = 1; taken < limit; taken++)
+      {
+        auto n = ls.take_one();
+        if (n == nullptr)
+        {
+          // Either a single element remains, or the next link has not become
+          // visible.  In both cases keep the rest.
+          moved += ls.length_hint();
+          enqueue(ls);
+          return moved;
+        }
+        enqueue_stolen(n);
+        moved++;
+      }
+
+      if (age_aware)
+        victim.note_oldest(index, get_stamp(ls.start));
+      victim.queues[index].enqueue_segment(ls);
+      return moved;
+    }
+
+    // Account for `moved` items, and the one returned to run if `taken`,
+    // having been stolen from `victim`.
+    void stolen(WorkStealingQueue& victim, size_t moved, bool taken)
+    {
+      add_length(moved);
+      victim.sub_length(moved + (taken ? 1 : 0));
     }
 
   public:
     constexpr WorkStealingQueue() {}
 
+    /**
+     * Set how much work a steal from a victim will take.  For
+     * `StealMode::Bounded`, `bound` is the most items taken by one steal.
+     */
+    void set_steal_mode(StealMode mode, size_t bound = 0)
+    {
+      assert((mode != StealMode::Bounded) || (bound != 0));
+      steal_mode = mode;
+      steal_bound = bound;
+    }
+
+    /**
+     * Stamp work with the time it is queued, so that its age can be
+     * measured when it is taken, and have thieves take the sub-queue of
+     * their victim with the oldest front, rather than the next in turn.
+     * Without this, old work can sit in a busy core's queue while thieves
+     * take fresher work.  Stamping costs a read of `Clock::fast` for each
+     * item queued.
+     *
+     * The stamp is a field of every `Work`, so it is only there when built
+     * with `USE_AGE_STATS`, and otherwise this is ignored.
+     */
+    void set_age_aware(bool enable)
+    {
+#ifdef USE_AGE_STATS
+      age_aware = enable;
+      if (!enable)
+      {
+        for (size_t i = 0; i < N; i++)
+          set_oldest(i, 0);
+      }
+#else
+      UNUSED(enable);
+#endif
+    }
+
+    bool is_age_aware() const
+    {
+      return age_aware;
+    }
+
     // Enqueue a single node onto the next enqueue queue.
     void enqueue(Work* work)
     {
+      if (age_aware)
+        set_stamp(work, Clock::fast());
       enqueue({work, &work->next_in_queue});
+      add_length(1);
     }
 
     void enqueue_front(Work* work)
     {
-      queues[dequeue_index--].enqueue_front(work);
+      enqueue_front_segment({work, &work->next_in_queue}, 1);
+    }
+
+    // Enqueue a fully linked segment of `count` items onto the front of the
+    // next dequeue queue, with a single exchange.
+    void enqueue_front_segment(MPMCQ<Work>::Segment ls, size_t count)
+    {
+      auto index = dequeue_index--;
+      if (age_aware)
+      {
+        auto now = Clock::fast();
+        auto w = ls.start;
+        for (size_t i = 0; i < count; i++)
+        {
+          set_stamp(w, now);
+          if (i + 1 < count)
+            w = w->next_in_queue.load(std::memory_order_relaxed);
+        }
+        note_oldest(index, now);
+      }
+      queues[index].enqueue_front_segment(ls);
+      add_length(count);
+    }
+
+    // Enqueue a fully linked segment of `count` items onto the next enqueue
+    // queue, with a single exchange.
+    void enqueue_segment(MPMCQ<Work>::Segment ls, size_t count)
+    {
+      if (age_aware)
+      {
+        auto now = Clock::fast();
+        auto w = ls.start;
+        for (size_t i = 0; i < count; i++)
+        {
+          set_stamp(w, now);
+          if (i + 1 < count)
+            w = w->next_in_queue.load(std::memory_order_relaxed);
+        }
+      }
+      enqueue(ls);
+      add_length(count);
     }
 
     // Dequeue a single node from any of the queues.
@@ -57,35 +303,79 @@ namespace verona::rt
       // Try each queue once.
       for (size_t i = 0; i < N; ++i)
       {
-        auto n = queues[++dequeue_index].dequeue();
+        auto index = ++dequeue_index;
+        auto n = queues[index].dequeue();
         if (n != nullptr)
         {
+          sub_length(1);
+          if (age_aware)
+            set_oldest(index, queues[index].is_empty() ? 0 : get_stamp(n));
           return n;
         }
       }
 
+      // Correct any drift in the estimate while the queues look empty.
+      length.store(0, std::memory_order_relaxed);
       return nullptr;
     }
 
+    /**
+     * An estimate of the number of items queued, for monitoring.  It is
+     * updated with relaxed loads and stores, like `SchedulerStats`, so an
+     * update from a remote enqueue or a steal may occasionally be lost, and
+     * items moved by a steal before their links are visible are not
+     * counted.  It is reset when `dequeue` finds nothing, so errors do not
+     * accumulate.
+     */
+    size_t length_estimate() const
+    {
+      return length.load(std::memory_order_relaxed);
+    }
+
     /**
      * Steal work from the victim.
      * Stealing has the side effect of placing work from the victim onto all the
      * queues. Returns nullptr if no work could be stolen. This may spuriously
      * return nullptr in the case where the first link in the segment has not
      * been created, and there are more than two elements.
+     *
+     * Depending on the steal mode, only part of the victim's sub-queue is
+     * taken, and the remainder is returned to the victim.  This prevents a
+     * whole backlog migrating on each steal.
      */
     Work* steal(WorkStealingQueue& victim)
     {
+      QueueStatus status;
+      size_t moved;
+      return steal(victim, status, moved);
+    }
+
+    /**
+     * As `steal`, and set `status` to say whether the victim's sub-queue was
+     * empty or contended if nothing is stolen, and `moved` to roughly how
+     * many items were moved to our queues besides the one returned.  After a
+     * contended attempt, the next steal tries another sub-queue, rather than
+     * probing the same one while it is in use.
+     */
+    Work* steal(WorkStealingQueue& victim, QueueStatus& status, size_t& moved)
+    {
+      moved = 0;
       if (&victim == this)
       {
         // Don't steal from yourself.
         // As scheduler loops around all the queues, use this to change the
         // index.
         ++steal_index;
+        status = QueueStatus::Empty;
         return nullptr;
       }
 
-      auto ls = victim.queues[steal_index].dequeue_all();
+      size_t index = age_aware ? oldest_index(victim) : (size_t)steal_index;
+      auto ls = victim.queues[index].dequeue_all(status);
+      if (status == QueueStatus::Contended)
+        ++steal_index;
+      else if (age_aware)
+        victim.set_oldest(index, 0);
 
       auto r = ls.take_one();
       if (r == nullptr)
@@ -104,11 +394,31 @@ namespace verona::rt
         if (ls.start != nullptr && ls.end == &ls.start->next_in_queue)
         {
           // Single element queue.
+          stolen(victim, 0, true);
           return ls.start;
         }
       }
 
-      enqueue_spread(ls);
+      if ((r == nullptr) || (steal_mode == StealMode::All))
+      {
+        moved = enqueue_spread(ls);
+        stolen(victim, moved, r != nullptr);
+        // Without the first link, the work was moved to our queues, but none
+        // could be returned.
+        if (r == nullptr)
+          status = QueueStatus::Contended;
+        return r;
+      }
+
+      size_t limit = steal_bound;
+      if (steal_mode == StealMode::Half)
+      {
+        // Include the element that was taken above.
+        limit = (ls.length_hint() + 2) / 2;
+      }
+
+      moved = take_bounded(victim, index, ls, limit);
+      stolen(victim, moved, true);
       return r;
     }
 
@@ -18,11 +18,19 @@
 #include "region/immutable.h"
 #include "region/region.h"
 #include "region/region_api.h"
+#include "region/snapshot.h"
+#include "sched/concurrentmap.h"
 #include "sched/cown.h"
+#include "sched/cyclecollector.h"
+#include "sched/deferredrelease.h"
 #include "sched/epoch.h"
 #include "sched/mpmcq.h"
 #include "sched/noticeboard.h"
 #include "sched/notification.h"
+#include "sched/parallelfreeze.h"
+#include "sched/parallelgc.h"
+#include "sched/reclaimer.h"
 #include "sched/schedulerthread.h"
+#include "sched/timerwheel.h"
 
 #include <snmalloc/snmalloc.h>
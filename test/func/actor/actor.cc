@@ -0,0 +1,92 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+/**
+ * Several producers send messages to an actor.  Each producer's messages
+ * must be handled in order, and all of them before the actor is collected.
+ */
+
+using namespace verona::cpp;
+
+static constexpr size_t PRODUCERS = 4;
+static constexpr size_t MESSAGES = 200;
+
+struct Msg
+{
+  std::atomic<Msg*> next_in_queue{nullptr};
+  size_t producer;
+  size_t seq;
+
+  Msg(size_t producer_, size_t seq_) : producer(producer_), seq(seq_) {}
+};
+
+struct State
+{
+  size_t next[PRODUCERS] = {};
+  size_t handled = 0;
+
+  ~State()
+  {
+    check(handled == PRODUCERS * MESSAGES);
+    for (size_t p = 0; p < PRODUCERS; p++)
+      check(next[p] == MESSAGES);
+  }
+};
+
+void test_actor()
+{
+  auto actor = make_actor<State, Msg>([](State& s, Msg* m) {
+    check(m->seq == s.next[m->producer]);
+    s.next[m->producer]++;
+    s.handled++;
+    delete m;
+  });
+
+  for (size_t p = 0; p < PRODUCERS; p++)
+  {
+    schedule_lambda([actor, p]() mutable {
+      for (size_t i = 0; i < MESSAGES; i++)
+        actor.send(new Msg(p, i));
+    });
+  }
+}
+
+/**
+ * The handler can send to its own actor, here to count down.
+ */
+struct Countdown
+{
+  size_t handled = 0;
+
+  ~Countdown()
+  {
+    check(handled == MESSAGES);
+  }
+};
+
+void test_self_send()
+{
+  auto actor = new ActorCown<Countdown, Msg>();
+  *actor = make_actor<Countdown, Msg>([actor](Countdown& s, Msg* m) {
+    s.handled++;
+    if (m->seq + 1 < MESSAGES)
+      actor->send(new Msg(0, m->seq + 1));
+    else
+      delete actor;
+    delete m;
+  });
+  actor->send(new Msg(0, 0));
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_actor);
+  harness.run(test_self_send);
+
+  return 0;
+}
@@ -0,0 +1,54 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that behaviours with a core affinity hint are all run, whether the
+ * hint is a specific core or a NUMA node, and whether the behaviour is
+ * scheduled from inside or outside the runtime.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+static constexpr size_t ROUNDS = 20;
+
+void test_affinity(size_t cores)
+{
+  auto counter = make_cown<Counter>();
+
+  // Scheduled from outside the runtime.
+  for (size_t i = 0; i < cores; i++)
+  {
+    when(counter).on(Scheduler::get_core(i)) << [](auto c) { c->count++; };
+  }
+
+  when().on(Scheduler::get_core(0)) << [counter]() {
+    // Scheduled from inside the runtime.
+    for (size_t i = 0; i < ROUNDS; i++)
+    {
+      when(counter).on(Scheduler::get_core(i)) << [](auto c) { c->count++; };
+      when(counter).on_numa_node(0) << [](auto c) { c->count++; };
+    }
+  };
+
+  when(counter).on_numa_node(0) << [cores](auto c) {
+    // This can overtake the nested behaviours, so only check the ones
+    // scheduled before it.
+    check(c->count >= cores);
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_affinity, harness.cores);
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks age aware stealing: with a backlog of work queued on one core,
+ * every item still runs, the time items waited is recorded for the cores
+ * that took them, and the percentiles read from the histogram are ordered.
+ * The times are only recorded when built with `USE_AGE_STATS`.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t ITEMS = 1000;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+static size_t aged(const SchedulerStats::Snapshot& s)
+{
+  size_t total = 0;
+  size_t first = SchedulerStats::Latency +
+    ((size_t)SchedulerStats::Phase::Age * SchedulerStats::LATENCY_BUCKETS);
+  for (size_t i = 0; i < SchedulerStats::LATENCY_BUCKETS; i++)
+    total += s[first + i];
+  return total;
+}
+
+static void check_ages()
+{
+  size_t total = 0;
+  for (auto& s : Scheduler::core_stats_snapshots())
+  {
+    total += aged(s);
+    auto median =
+      SchedulerStats::latency_percentile(s, SchedulerStats::Phase::Age, 50);
+    auto tail =
+      SchedulerStats::latency_percentile(s, SchedulerStats::Phase::Age, 99);
+    check(median <= tail);
+  }
+#ifdef USE_AGE_STATS
+  check(total > 0);
+#else
+  // Work is not stamped, so nothing is recorded.
+  check(total == 0);
+#endif
+}
+
+void test_backlog()
+{
+  auto done = make_cown<Counter>();
+
+  // Queue a backlog on this core, for the other cores to steal from.
+  when() << [done]() {
+    for (size_t i = 0; i < ITEMS; i++)
+    {
+      when() << [done]() {
+        when(done) << [](acquired_cown<Counter> c) {
+          if (++c->count == ITEMS)
+            check_ages();
+        };
+      };
+    }
+  };
+}
+
+void test_percentile()
+{
+  SchedulerStats::Snapshot s{};
+  auto phase = SchedulerStats::Phase::Age;
+  check(SchedulerStats::latency_percentile(s, phase, 99) == 0);
+
+  size_t first = SchedulerStats::Latency +
+    ((size_t)phase * SchedulerStats::LATENCY_BUCKETS);
+  s[first + 2] = 90;
+  s[first + 10] = 10;
+  check(SchedulerStats::latency_percentile(s, phase, 50) == 4);
+  check(SchedulerStats::latency_percentile(s, phase, 90) == 4);
+  check(SchedulerStats::latency_percentile(s, phase, 99) == 1024);
+  check(SchedulerStats::name(first + 3) == "Age 2^3");
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  test_percentile();
+
+  Scheduler::set_age_aware_stealing(true);
+  harness.run(test_backlog);
+  Scheduler::set_age_aware_stealing(false);
+
+  return 0;
+}
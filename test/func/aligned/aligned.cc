@@ -0,0 +1,91 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that cown contents and captured state that need more than pointer
+ * alignment are aligned, for behaviours over different numbers of cowns, and
+ * for notifications.
+ */
+#include <cpp/notification.h>
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t ROUNDS = 10;
+
+template<size_t Align>
+struct alignas(Align) Vec
+{
+  float lanes[Align / sizeof(float)] = {};
+};
+
+template<typename T>
+static bool is_aligned(const T& t)
+{
+  return ((uintptr_t)&t % alignof(T)) == 0;
+}
+
+static std::atomic<size_t> checked = 0;
+
+template<size_t Align>
+void test_cown()
+{
+  auto a = make_cown<Vec<Align>>();
+  auto b = make_cown<Vec<Align>>();
+
+  for (size_t i = 0; i < ROUNDS; i++)
+  {
+    Vec<Align> captured;
+    captured.lanes[0] = (float)i;
+
+    when(a) << [captured](acquired_cown<Vec<Align>> a) {
+      check(is_aligned(*a));
+      check(is_aligned(captured));
+      a->lanes[0] += captured.lanes[0];
+      checked++;
+    };
+
+    when(a, b) << [captured](auto a, auto b) {
+      check(is_aligned(*a) && is_aligned(*b));
+      check(is_aligned(captured));
+      checked++;
+    };
+
+    when(read(b)) << [captured](auto b) {
+      check(is_aligned(*b));
+      check(is_aligned(captured));
+      checked++;
+    };
+  }
+}
+
+void test_notification()
+{
+  auto a = make_cown<Vec<64>>();
+  Vec<64> captured;
+  auto n = make_notification(
+    [captured](acquired_cown<Vec<64>> a) {
+      check(is_aligned(*a));
+      check(is_aligned(captured));
+      checked++;
+    },
+    a);
+  n.notify();
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_cown<32>);
+  harness.run(test_cown<64>);
+  harness.run(test_cown<256>);
+  check(checked == 3 * 3 * ROUNDS);
+
+  checked = 0;
+  harness.run(test_notification);
+  check(checked == 1);
+
+  return 0;
+}
@@ -0,0 +1,119 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <string>
+#include <vector>
+
+/**
+ * A cown whose state, including a vector and a list of region objects, is
+ * allocated in its own arena region, and one that takes ownership of
+ * buffers from an `io::buffer_pool`, which get them back when it is
+ * collected.
+ */
+
+using namespace verona::cpp;
+
+struct Node : public V<Node>
+{
+  size_t value;
+  Node* next;
+
+  Node(size_t value_, Node* next_) : value(value_), next(next_) {}
+};
+
+struct Book
+{
+  std::vector<size_t, arena_allocator<size_t>> orders;
+  Node* list = nullptr;
+
+  Book(size_t reserve)
+  {
+    orders.reserve(reserve);
+  }
+};
+
+static constexpr size_t UPDATES = 100;
+
+void test_arena_cown()
+{
+  auto book = make_cown<arena<Book>>(size_t{4});
+
+  for (size_t i = 0; i < UPDATES; i++)
+  {
+    when(book) << [i](acquired_cown<arena<Book>> b) {
+      b->use([i](Book& s) {
+        s.orders.push_back(i);
+        s.list = new Node(i, s.list);
+      });
+    };
+  }
+
+  when(book) << [](acquired_cown<arena<Book>> b) {
+    auto& s = b->get();
+    check(s.orders.size() == UPDATES);
+
+    size_t n = 0;
+    for (auto l = s.list; l != nullptr; l = l->next)
+    {
+      check(l->value == s.orders[UPDATES - 1 - n]);
+      n++;
+    }
+    check(n == UPDATES);
+  };
+}
+
+struct Stream
+{
+  std::vector<char*, arena_allocator<char*>> packets;
+};
+
+static constexpr size_t PACKETS = 8;
+static io::buffer_pool pool(PACKETS, 64);
+
+void test_adopt()
+{
+  auto stream = make_cown<arena<Stream>>();
+
+  for (size_t i = 0; i < PACKETS; i++)
+  {
+    when(stream) << [i](acquired_cown<arena<Stream>> s) {
+      // As if data had been received into it.
+      auto buf = static_cast<char*>(pool.acquire());
+      check(buf != nullptr);
+      snprintf(buf, pool.size(), "packet %zu", i);
+
+      s->use([&s, buf](Stream& st) {
+        st.packets.push_back(s->adopt(buf, pool.size(), &pool));
+      });
+    };
+  }
+
+  when(stream) << [](acquired_cown<arena<Stream>> s) {
+    auto& st = s->get();
+    check(st.packets.size() == PACKETS);
+    for (size_t i = 0; i < PACKETS; i++)
+      check(std::string(st.packets[i]) == "packet " + std::to_string(i));
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_arena_cown);
+
+  harness.run(test_adopt);
+  // All the buffers are back in the pool.
+  std::vector<void*> bufs;
+  for (size_t i = 0; i < PACKETS; i++)
+  {
+    bufs.push_back(pool.acquire());
+    check(bufs.back() != nullptr);
+  }
+  for (auto buf : bufs)
+    pool.release(buf);
+
+  return 0;
+}
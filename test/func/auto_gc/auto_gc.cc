@@ -0,0 +1,88 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+struct C : public V<C>
+{
+  C* f1 = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (f1 != nullptr)
+      st.push(f1);
+  }
+};
+
+struct Big : public V<Big>
+{
+  uint8_t data[1024];
+};
+
+/// Enough garbage to pass `RegionTrace::AUTO_GC_MIN`.
+static constexpr size_t GARBAGE = 2 * RegionTrace::AUTO_GC_MIN / sizeof(Big);
+
+void test_auto_gc()
+{
+  RegionTrace::set_gc_growth_factor(2);
+
+  auto* o = new (RegionType::Trace) C;
+  {
+    UsingRegion rr(o);
+    o->f1 = new C;
+
+    // Nested opens do not collect.
+    {
+      UsingRegion rr2(o);
+      for (size_t i = 0; i < GARBAGE; i++)
+        new Big;
+    }
+    check(RegionTrace::get_stats(o).collections == 0);
+    check(debug_size() == 2 + GARBAGE);
+  }
+
+  auto stats = RegionTrace::get_stats(o);
+  check(stats.collections == 1);
+  check(stats.bytes_freed >= GARBAGE * sizeof(Big));
+
+  {
+    UsingRegion rr(o);
+    check(debug_size() == 2);
+
+    // Below the threshold, nothing is collected.
+    new Big;
+  }
+  check(RegionTrace::get_stats(o).collections == 1);
+
+  // With a nursery, a minor collection is enough.
+  RegionTrace::set_nursery(o, true);
+  {
+    UsingRegion rr(o);
+    for (size_t i = 0; i < GARBAGE; i++)
+      new Big;
+  }
+  stats = RegionTrace::get_stats(o);
+  check(stats.collections == 1);
+  check(stats.minor_collections == 1);
+
+  {
+    UsingRegion rr(o);
+    check(debug_size() == 3);
+  }
+
+  RegionTrace::set_gc_growth_factor(0);
+  region_release(o);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_auto_gc);
+
+  return 0;
+}
@@ -0,0 +1,77 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks collecting cowns in the background, see
+ * `Shared::set_background_collect`.
+ *
+ * A tree of cowns is dropped on a scheduler thread.  In the background, the
+ * release only schedules the collection, so every node is still alive
+ * straight afterwards, and all of them are collected by the time the runtime
+ * stops.  A tiny budget splits the collection into a step per cown.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+using namespace std::chrono_literals;
+
+static constexpr size_t DEPTH = 10;
+static constexpr size_t TREE_SIZE = (size_t{1} << (DEPTH + 1)) - 1;
+
+static std::atomic<size_t> live_count = 0;
+
+struct Node
+{
+  cown_ptr<Node> left;
+  cown_ptr<Node> right;
+
+  Node(cown_ptr<Node> left, cown_ptr<Node> right)
+  : left(std::move(left)), right(std::move(right))
+  {
+    live_count++;
+  }
+
+  ~Node()
+  {
+    live_count--;
+  }
+};
+
+static cown_ptr<Node> build(size_t depth)
+{
+  if (depth == 0)
+    return make_cown<Node>(cown_ptr<Node>(), cown_ptr<Node>());
+  return make_cown<Node>(build(depth - 1), build(depth - 1));
+}
+
+void test_background_collect(bool background)
+{
+  // A work item rather than a behaviour, as behaviours defer releases until
+  // they return.
+  Scheduler::schedule(Closure::make([background](Work*) {
+    auto root = build(DEPTH);
+    check(live_count == TREE_SIZE);
+
+    root = nullptr;
+    check(live_count == (background ? TREE_SIZE : 0));
+    return true;
+  }));
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  for (auto budget : {0ns, 1ns, 1ms})
+  {
+    Shared::set_background_collect(budget);
+    harness.run(test_background_collect, budget != 0ns);
+
+    // Every cown has been collected by the time the runtime stops.
+    check(live_count == 0);
+  }
+
+  Shared::set_background_collect(0ns);
+  return 0;
+}
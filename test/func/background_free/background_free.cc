@@ -0,0 +1,78 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+static std::atomic<size_t> live_count;
+
+struct Node : public V<Node>
+{
+  Node* left = nullptr;
+  Node* right = nullptr;
+
+  Node()
+  {
+    live_count++;
+  }
+
+  ~Node()
+  {
+    live_count--;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (left != nullptr)
+      st.push(left);
+
+    if (right != nullptr)
+      st.push(right);
+  }
+};
+
+/// A tree, so each node is an SCC of its own once frozen.
+Node* build(size_t depth)
+{
+  auto n = new Node;
+  if (depth > 0)
+  {
+    n->left = build(depth - 1);
+    n->right = build(depth - 1);
+  }
+  return n;
+}
+
+void test_background_free()
+{
+  Immutable::set_background_free(true);
+
+  schedule_lambda([]() {
+    auto root = new (RegionType::Trace) Node;
+    {
+      UsingRegion rr(root);
+      root->left = build(9);
+      root->right = build(9);
+    }
+    freeze(root);
+
+    // The last release only schedules the free.
+    check(Immutable::release(root) == 0);
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_background_free);
+
+  // Every graph has been freed by the time the runtime stops.
+  check(live_count == 0);
+  Immutable::set_background_free(false);
+
+  return 0;
+}
@@ -0,0 +1,65 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `schedule_batch`: a burst of work injected at once, split across
+ * the cores or all given to one of them, runs every item exactly once,
+ * including batches smaller than a single run and empty ones.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+#include <vector>
+
+using namespace verona::cpp;
+
+static constexpr size_t BATCHES[] = {0, 1, 5, 16, 17, 1000};
+
+std::atomic<size_t> ran{0};
+std::atomic<size_t> expected{0};
+
+static std::vector<Work*> make_batch(size_t count)
+{
+  std::vector<Work*> items;
+  for (size_t i = 0; i < count; i++)
+  {
+    items.push_back(Closure::make([](Work*) {
+      ran++;
+      return true;
+    }));
+  }
+  expected += count;
+  return items;
+}
+
+void test_batch()
+{
+  for (auto count : BATCHES)
+  {
+    auto items = make_batch(count);
+    Scheduler::schedule_batch(items.data(), items.size());
+  }
+}
+
+void test_batch_on()
+{
+  for (auto count : BATCHES)
+  {
+    auto items = make_batch(count);
+    Scheduler::schedule_batch_on(
+      Scheduler::first_core(), items.data(), items.size());
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_batch);
+  check(ran == expected);
+
+  harness.run(test_batch_on);
+  check(ran == expected);
+
+  return 0;
+}
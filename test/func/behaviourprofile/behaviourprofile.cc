@@ -0,0 +1,60 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Samples behaviours that spin for a while with `BehaviourProfile`, and
+ * checks that the profile attributes samples to their type by name.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <sstream>
+
+using namespace verona::cpp;
+
+static constexpr size_t BEHAVIOURS = 4;
+
+static void spin(std::chrono::milliseconds duration)
+{
+  auto end = std::chrono::steady_clock::now() + duration;
+  while (std::chrono::steady_clock::now() < end)
+    Aal::pause();
+}
+
+void test_profile()
+{
+  for (size_t i = 0; i < BEHAVIOURS; i++)
+  {
+    when(make_cown<size_t>(i)) << [](acquired_cown<size_t>) {
+      spin(std::chrono::milliseconds(20));
+    };
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  BehaviourProfile::start(std::chrono::microseconds(200));
+  harness.run(test_profile);
+  BehaviourProfile::stop();
+
+  std::stringstream out;
+  BehaviourProfile::dump(out);
+  std::cout << out.str();
+
+  // The header, then the spinning behaviour, which has the most samples.
+  std::string line;
+  check((bool)std::getline(out, line));
+  check((bool)std::getline(out, line));
+#if defined(__GNUC__)
+  check(line.find("test_profile") != std::string::npos);
+#endif
+  check(line.find("Unnamed") == std::string::npos);
+
+  // Nothing is left after a dump.
+  std::stringstream empty;
+  BehaviourProfile::dump(empty);
+  check(empty.str().find("Idle,0") != std::string::npos);
+
+  return 0;
+}
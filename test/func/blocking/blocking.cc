@@ -0,0 +1,67 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that work queued on a core whose thread enters a blocking section
+ * is still run, including work scheduled from inside the blocking section.
+ *
+ * With more than one core, the queued work must run on other threads while
+ * the blocking section waits for it.  The work is left in the core's local
+ * deque, which must be emptied as the section is entered, rather than left
+ * for thieves.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t QUEUED = 20;
+static std::atomic<size_t> run_count = 0;
+static size_t core_count = 0;
+
+struct Account
+{};
+
+void test_blocking()
+{
+  run_count = 0;
+
+  when() << []() {
+    for (size_t i = 0; i < QUEUED; i++)
+    {
+      when(make_cown<Account>()) << [](auto) { run_count++; };
+    }
+
+    Scheduler::blocking_section([]() {
+      check(Scheduler::local_core()->local_q.is_empty());
+
+      // Nested sections just run the body.
+      Scheduler::blocking_section([]() {});
+
+      if (core_count > 1)
+      {
+        // Every queued behaviour has been handed to another core, so this
+        // wait completes without this thread running any of them.
+        while (run_count < QUEUED)
+        {
+          Systematic::yield();
+          Aal::pause();
+        }
+      }
+
+      when(make_cown<Account>()) << [](auto) { run_count++; };
+    });
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  core_count = harness.cores;
+
+  harness.run(test_blocking);
+
+  check(run_count == QUEUED + 1);
+
+  return 0;
+}
@@ -0,0 +1,70 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that behaviours scheduled with `when_bulk` run in order per cown,
+ * including when the cowns already have queued behaviours, and when more
+ * behaviours are queued behind them.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+#include <utility>
+#include <vector>
+
+using namespace verona::cpp;
+
+static constexpr size_t COWNS = 7;
+static constexpr size_t PER_COWN = 30;
+
+struct Log
+{
+  size_t next = 0;
+
+  ~Log()
+  {
+    check(next == PER_COWN + 2);
+  }
+};
+
+struct Step
+{
+  size_t index;
+
+  void operator()(acquired_cown<Log> log)
+  {
+    check(log->next == index);
+    log->next++;
+  }
+};
+
+void test_bulk()
+{
+  std::vector<cown_ptr<Log>> cowns;
+  for (size_t i = 0; i < COWNS; i++)
+    cowns.push_back(make_cown<Log>());
+
+  // One behaviour already queued on each cown.
+  for (auto& c : cowns)
+    when(c) << Step{0};
+
+  // Interleave the cowns, so the bulk call has to group them.
+  std::vector<std::pair<cown_ptr<Log>, Step>> items;
+  for (size_t j = 0; j < PER_COWN; j++)
+    for (size_t i = 0; i < COWNS; i++)
+      items.emplace_back(cowns[(i + j) % COWNS], Step{j + 1});
+
+  when_bulk(items.begin(), items.end());
+
+  for (auto& c : cowns)
+    when(c) << Step{PER_COWN + 1};
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_bulk);
+
+  return 0;
+}
@@ -0,0 +1,109 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+/**
+ * Behaviours cancelled while they wait for their cowns must not run, but
+ * must still release their cowns, in order, and destroy their captures.
+ */
+
+using namespace verona::cpp;
+
+struct Log
+{
+  size_t runs = 0;
+};
+
+static std::atomic<size_t> live{0};
+
+struct Capture
+{
+  Capture()
+  {
+    live++;
+  }
+
+  Capture(const Capture&)
+  {
+    live++;
+  }
+
+  ~Capture()
+  {
+    live--;
+  }
+};
+
+void test_cancel_waiting()
+{
+  auto a = make_cown<Log>();
+  cancellation c;
+
+  // Holds `a` while the next behaviour waits for it.
+  when(a) << [c](acquired_cown<Log> l) mutable {
+    l->runs++;
+    c.cancel();
+  };
+
+  when(a).cancel_with(c) << [](acquired_cown<Log>) { check(false); };
+
+  when(read(a)) << [](acquired_cown<const Log> l) { check(l->runs == 1); };
+}
+
+void test_cancel_batch()
+{
+  auto a = make_cown<Log>();
+  auto b = make_cown<Log>();
+  cancellation c;
+
+  when(a, b) << [c](acquired_cown<Log>, acquired_cown<Log>) mutable {
+    c.cancel();
+  };
+
+  ((when(a) << [](acquired_cown<Log>) { check(false); }) +
+   (when(b) << [](acquired_cown<Log>) { check(false); }))
+    .cancel_with(c);
+
+  when(a, b) << [](acquired_cown<Log> x, acquired_cown<Log> y) {
+    check(x->runs == 0);
+    check(y->runs == 0);
+  };
+}
+
+void test_not_cancelled()
+{
+  auto a = make_cown<Log>();
+  cancellation c;
+
+  for (size_t i = 0; i < 10; i++)
+    when(a).cancel_with(c) << [](acquired_cown<Log> l) { l->runs++; };
+
+  when(a) << [](acquired_cown<Log> l) { check(l->runs == 10); };
+}
+
+void test_captures()
+{
+  cancellation c;
+  c.cancel();
+
+  auto a = make_cown<Log>();
+  Capture cap;
+  when(a).cancel_with(c) << [cap](acquired_cown<Log>) { check(false); };
+  when().cancel_with(c) << [cap]() { check(false); };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_cancel_waiting);
+  harness.run(test_cancel_batch);
+  harness.run(test_not_cancelled);
+
+  harness.run(test_captures);
+  check(live == 0);
+
+  return 0;
+}
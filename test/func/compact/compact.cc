@@ -0,0 +1,128 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `RegionTrace::compact`.  The objects of a region with a list, a
+ * cycle back to the entry point, and garbage between them are moved, and
+ * keep their shape and values, whereas objects that cannot be redirected
+ * stay where they are.
+ */
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+  Node* back = nullptr;
+  size_t value = 0;
+
+  using fields = Fields<&Node::next, &Node::back>;
+};
+
+/// Lists no fields, so what it points to cannot be moved.
+struct Opaque : public V<Opaque>
+{
+  Node* node = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (node != nullptr)
+      st.push(node);
+  }
+};
+
+struct Root : public V<Root>
+{
+  Node* list = nullptr;
+  Opaque* opaque = nullptr;
+
+  using fields = Fields<&Root::list, &Root::opaque>;
+};
+
+static constexpr size_t LENGTH = 100;
+
+void test_compact()
+{
+  auto* o = new (RegionType::Trace) Root;
+  ExternalRef* ext;
+  Node* held;
+  Node* referenced;
+  {
+    UsingRegion rr(o);
+    for (size_t i = LENGTH; i > 0; i--)
+    {
+      auto n = new Node;
+      n->value = i;
+      n->next = o->list;
+      o->list = n;
+      new Node;
+    }
+    o->list->back = o->list;
+
+    held = new Node;
+    held->value = LENGTH + 1;
+    o->opaque = new Opaque;
+    o->opaque->node = held;
+
+    referenced = o->list->next;
+    ext = create_external_reference(referenced);
+  }
+
+  check(RegionTrace::fragmentation(o) == 0);
+  Node* first = o->list;
+
+  {
+    UsingRegion rr(o);
+    region_compact();
+    check(debug_size() == 1 + LENGTH + 2);
+  }
+
+  auto stats = RegionTrace::get_stats(o);
+  check(stats.compactions == 1);
+  check(stats.bytes_moved > 0);
+  check(RegionTrace::fragmentation(o) == 0);
+
+  // Moved, with its pointer to itself redirected.
+  check(o->list != first);
+  check(o->list->back == o->list);
+
+  // Pinned, by the external reference and by the opaque object.
+  check(o->list->next == referenced);
+  check(o->opaque->node == held);
+  check(held->value == LENGTH + 1);
+  {
+    UsingRegion rr(o);
+    check(use_external_reference(ext) == referenced);
+  }
+
+  size_t i = 1;
+  for (Node* n = o->list; n != nullptr; n = n->next)
+    check(n->value == i++);
+  check(i == LENGTH + 1);
+
+  // Dropping half the list makes the region fragmented.
+  {
+    UsingRegion rr(o);
+    Node* n = o->list;
+    for (size_t j = 1; j < LENGTH / 2; j++)
+      n = n->next;
+    n->next = nullptr;
+    region_collect();
+  }
+  check(RegionTrace::fragmentation(o) > 0);
+
+  Immutable::release(ext);
+  region_release(o);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_compact);
+
+  return 0;
+}
@@ -0,0 +1,99 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks a ConcurrentMap shared by behaviours on several cowns.  Writers add
+ * and remove their own keys, growing the map through several resizes, while
+ * readers look up every key.  A key that is found must have its value.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <sched/concurrentmap.h>
+
+using namespace verona::cpp;
+
+using Map = ConcurrentMap<size_t, size_t>;
+
+static constexpr size_t WRITERS = 4;
+static constexpr size_t READERS = 4;
+static constexpr size_t KEYS = 200;
+
+/**
+ * Owns the map, which is destroyed once the last behaviour using it has
+ * dropped its reference.
+ */
+struct Owner
+{
+  Map* map;
+
+  Owner() : map(new (heap::alloc(sizeof(Map))) Map()) {}
+
+  ~Owner()
+  {
+    check(map->size() == WRITERS * KEYS / 2);
+    for (size_t key = 0; key < WRITERS * KEYS; key++)
+    {
+      size_t value = 0;
+      bool found = map->find(key, value);
+      check(found == ((key & 1) == 0));
+      check(!found || (value == key + 1));
+    }
+
+    map->~Map();
+    heap::dealloc(map, sizeof(Map));
+  }
+};
+
+struct Worker
+{};
+
+void test_concurrent_map()
+{
+  auto owner = make_cown<Owner>();
+
+  // The workers hold `owner`, without acquiring it, to keep the map alive.
+  when(owner) << [owner](auto o) {
+    Map* map = o->map;
+
+    for (size_t w = 0; w < WRITERS; w++)
+    {
+      when(make_cown<Worker>()) << [map, owner, w](auto) {
+        size_t first = w * KEYS;
+        for (size_t key = first; key < first + KEYS; key++)
+          check(map->insert(key, key + 1));
+
+        for (size_t key = first; key < first + KEYS; key++)
+        {
+          size_t value = 0;
+          check(map->find(key, value));
+          check(value == key + 1);
+        }
+
+        for (size_t key = first + 1; key < first + KEYS; key += 2)
+          check(map->erase(key));
+
+        check(!map->erase(first + 1));
+        check(!map->insert(first, first + 1));
+      };
+    }
+
+    for (size_t r = 0; r < READERS; r++)
+    {
+      when(make_cown<Worker>()) << [map, owner](auto) {
+        for (size_t key = 0; key < WRITERS * KEYS; key++)
+        {
+          size_t value = 0;
+          if (map->find(key, value))
+            check(value == key + 1);
+        }
+      };
+    }
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_concurrent_map);
+  return 0;
+}
@@ -0,0 +1,50 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that chains of writers on a cown run correctly, in order, when
+ * successors are run as continuations of the behaviour that released the
+ * cown.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t CHAIN_LENGTH = 100;
+static constexpr size_t CHAINS = 4;
+
+struct Counter
+{
+  size_t count = 0;
+
+  ~Counter()
+  {
+    check(count == CHAIN_LENGTH);
+  }
+};
+
+void test_continuation()
+{
+  for (size_t i = 0; i < CHAINS; i++)
+  {
+    auto counter = make_cown<Counter>();
+    for (size_t j = 0; j < CHAIN_LENGTH; j++)
+    {
+      when(counter) << [j](auto c) {
+        check(c->count == j);
+        c->count++;
+      };
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  Scheduler::set_continuation_depth(harness.opt.is<size_t>("--depth", 8));
+  harness.run(test_continuation);
+
+  return 0;
+}
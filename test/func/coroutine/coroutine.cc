@@ -0,0 +1,80 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `co_await when(...)` in a `task`.  Each `co_await` runs the rest of
+ * the coroutine as a behaviour on the cowns, and later steps see the effects
+ * of earlier ones.
+ *
+ * Only built with coroutine support, see test/CMakeLists.txt.
+ */
+#include <cpp/coroutine.h>
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+using namespace verona::cpp;
+
+static constexpr size_t STEPS = 10;
+
+struct Account
+{
+  int balance = 0;
+  size_t steps = 0;
+};
+
+task transfer(cown_ptr<Account> from, cown_ptr<Account> to)
+{
+  for (size_t i = 0; i < STEPS; i++)
+  {
+    auto [f, t] = co_await when(from, to);
+    f->balance--;
+    t->balance++;
+    f->steps++;
+  }
+
+  auto& f = co_await when(read(from));
+  check(f->steps >= STEPS);
+}
+
+task audit(cown_ptr<Account> a, cown_ptr<Account> b, int total)
+{
+  auto [x, y] = co_await when(read(a), read(b));
+  check(x->balance + y->balance == total);
+}
+
+void test_coroutine()
+{
+  auto a = make_cown<Account>();
+  auto b = make_cown<Account>();
+
+  when(a) << [](acquired_cown<Account> a) { a->balance = 100; };
+
+  transfer(a, b);
+  transfer(b, a);
+  transfer(a, b);
+  audit(a, b, 100);
+
+  when(a, b) << [](acquired_cown<Account> a, acquired_cown<Account> b) {
+    check(a->balance + b->balance == 100);
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_coroutine);
+
+  return 0;
+}
+
+#else
+
+int main()
+{
+  return 0;
+}
+
+#endif
@@ -0,0 +1,61 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks the critical path and work reported by the systematic testing cost
+ * model for workloads whose shape is known.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t BEHAVIOURS = 20;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+void test_chain()
+{
+  auto counter = make_cown<Counter>();
+  for (size_t i = 0; i < BEHAVIOURS; i++)
+    when(counter) << [](acquired_cown<Counter> c) { c->count++; };
+}
+
+void test_independent()
+{
+  for (size_t i = 0; i < BEHAVIOURS; i++)
+    when(make_cown<Counter>()) << [](acquired_cown<Counter> c) { c->count++; };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.cost_model = true;
+  auto cost = harness.costs.behaviour;
+
+  harness.run(test_chain);
+  if constexpr (CostModel::enabled)
+  {
+    auto r = CostModel::report();
+    check(r.behaviours == BEHAVIOURS);
+    check(r.work == BEHAVIOURS * cost);
+    // Each behaviour waits for the one before.
+    check(r.span == BEHAVIOURS * cost);
+    check(r.makespan >= r.span);
+  }
+
+  harness.run(test_independent);
+  if constexpr (CostModel::enabled)
+  {
+    auto r = CostModel::report();
+    check(r.work == BEHAVIOURS * cost);
+    check(r.span == cost);
+    check(r.makespan >= (BEHAVIOURS * cost) / harness.cores);
+    check(r.speedup() <= (double)harness.cores);
+  }
+
+  return 0;
+}
@@ -0,0 +1,164 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `CycleCollector`.
+ *
+ * Builds rings of cowns that refer to the next cown in the ring directly,
+ * through a trace region, and through an arena region, and drops every
+ * other reference to them, so that only the collector can reclaim them.
+ * Another ring is also kept alive by a reference from outside, and must
+ * survive the first collection.  Once that reference is dropped, a second
+ * collection must reclaim it as well.
+ *
+ * Every cown of a ring is a candidate, and the check of the first candidate
+ * of a ring takes the others out of the candidates, so each collection
+ * checks each ring once.
+ */
+#include <debug/harness.h>
+
+static constexpr size_t RING = 5;
+
+static std::atomic<size_t> live_nodes = 0;
+
+struct Node;
+
+struct Holder : public V<Holder>
+{
+  Node* cown = nullptr;
+
+  void trace(ObjectStack& st) const;
+};
+
+struct Node : public VCown<Node>
+{
+  Node* next = nullptr;
+  Holder* region = nullptr;
+
+  Node()
+  {
+    live_nodes++;
+  }
+
+  ~Node()
+  {
+    live_nodes--;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+    if (region != nullptr)
+      st.push(region);
+  }
+};
+
+void Holder::trace(ObjectStack& st) const
+{
+  if (cown != nullptr)
+    st.push(cown);
+}
+
+enum class Link
+{
+  Direct,
+  Trace,
+  Arena,
+};
+
+/**
+ * Build a ring linked with `link`, and return its first cown, with a
+ * reference owned by the caller.
+ */
+static Node* make_ring(Link link)
+{
+  Node* nodes[RING];
+  for (auto& n : nodes)
+    n = new Node;
+
+  for (size_t i = 0; i < RING; i++)
+  {
+    auto* n = nodes[i];
+    auto* next = nodes[(i + 1) % RING];
+    Cown::acquire(next);
+    switch (link)
+    {
+      case Link::Direct:
+        n->next = next;
+        break;
+
+      case Link::Trace:
+        n->region = new (RegionType::Trace) Holder;
+        n->region->cown = next;
+        RegionTrace::insert<YesTransfer>(n->region, next);
+        break;
+
+      case Link::Arena:
+        n->region = new (RegionType::Arena) Holder;
+        n->region->cown = next;
+        RegionArena::insert<YesTransfer>(n->region, next);
+        break;
+    }
+  }
+
+  // Records the cowns as candidates for the collector, as each is still
+  // referred to by the ring.
+  for (size_t i = 1; i < RING; i++)
+    Cown::release(nodes[i]);
+  return nodes[0];
+}
+
+static Node* kept = nullptr;
+
+/// Run `then` in a behaviour once `ready` returns true.
+template<typename Ready, typename Then>
+static void when_ready(Ready ready, Then then)
+{
+  schedule_lambda([ready, then]() {
+    if (ready())
+      then();
+    else
+      when_ready(ready, then);
+  });
+}
+
+void test_cycles()
+{
+  CycleCollector::enable();
+
+  for (auto link : {Link::Direct, Link::Trace, Link::Arena})
+    Cown::release(make_ring(link));
+  kept = make_ring(Link::Direct);
+
+  CycleCollector::collect();
+
+  // The last cowns may be destroyed just after the collection finishes.
+  when_ready(
+    []() { return !CycleCollector::in_progress() && (live_nodes <= RING); },
+    []() {
+      // Only the ring that is still referred to survives.
+      check(live_nodes == RING);
+      check(CycleCollector::debug_checks() == 4);
+
+      Cown::release(kept);
+      CycleCollector::collect();
+
+      when_ready(
+        []() { return !CycleCollector::in_progress() && (live_nodes == 0); },
+        []() {
+          check(CycleCollector::debug_checks() == 1);
+          CycleCollector::disable();
+        });
+    });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run([]() { schedule_lambda(test_cycles); });
+  check(live_nodes == 0);
+
+  return 0;
+}
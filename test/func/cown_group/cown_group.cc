@@ -0,0 +1,60 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `cown_group`: behaviours on the members and on the whole group run
+ * in the order they are scheduled, so each round of updates to the rows sees
+ * the count of the table-wide behaviours before it, and each table-wide
+ * behaviour sees every update of its round.
+ */
+#include <cpp/cown_group.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t ROWS = 16;
+static constexpr size_t ROUNDS = 8;
+
+struct Table
+{
+  size_t rounds = 0;
+};
+
+struct Row
+{
+  size_t value = 0;
+};
+
+void test_group()
+{
+  auto table = make_cown_group<Table, Row>(Table(), ROWS);
+  check(table.size() == ROWS);
+
+  for (size_t round = 0; round < ROUNDS; round++)
+  {
+    for (size_t i = 0; i < ROWS; i++)
+    {
+      when(table.intent(), table.member(i)) <<
+        [](acquired_cown<const Table> t, acquired_cown<Row> row) {
+          check(row->value == t->rounds);
+          row->value++;
+        };
+    }
+
+    when(table.whole()) << [table, round](acquired_cown<Table> t) {
+      check(t->rounds == round);
+      for (size_t i = 0; i < table.size(); i++)
+        check(table.held(t, i)->value == round + 1);
+      t->rounds++;
+    };
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_group);
+
+  return 0;
+}
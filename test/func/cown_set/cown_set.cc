@@ -0,0 +1,136 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks behaviours over a cown_set, which are scheduled without sorting,
+ * interleaved with behaviours over the same cowns that take the general
+ * path.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t REPEATS = 20;
+
+struct Counter
+{
+  size_t count = 0;
+  size_t expected;
+
+  Counter(size_t expected_) : expected(expected_) {}
+
+  ~Counter()
+  {
+    check(count == expected);
+  }
+};
+
+void test_dedup()
+{
+  auto a = make_cown<Counter>(REPEATS);
+  auto b = make_cown<Counter>(REPEATS);
+  auto c = make_cown<Counter>(REPEATS);
+
+  cown_ptr<Counter> carray[5] = {c, a, b, a, c};
+  cown_set<Counter> set{carray, 5};
+  check(set.length == 3);
+
+  for (size_t i = 0; i < REPEATS; i++)
+  {
+    when(set) << [](acquired_cown_span<Counter> s) {
+      check(s.length == 3);
+      for (size_t j = 0; j < s.length; j++)
+        s.array[j]->count++;
+    };
+  }
+}
+
+void test_large()
+{
+  static constexpr size_t COUNT = 12;
+
+  cown_ptr<Counter> carray[COUNT];
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    bool shared = (i == 0) || (i == COUNT - 1);
+    carray[i] = make_cown<Counter>(shared ? 2 * REPEATS : REPEATS);
+  }
+
+  cown_set<Counter> set{carray, COUNT};
+
+  for (size_t i = 0; i < REPEATS; i++)
+  {
+    when(set) << [](acquired_cown_span<Counter> s) {
+      for (size_t j = 0; j < s.length; j++)
+        s.array[j]->count++;
+    };
+
+    when(carray[COUNT - 1], carray[0]) << [](auto x, auto y) {
+      x->count++;
+      y->count++;
+    };
+  }
+}
+
+void test_read()
+{
+  auto a = make_cown<Counter>(1);
+  auto b = make_cown<Counter>(1);
+
+  cown_ptr<Counter> carray[2] = {b, a};
+  cown_set<Counter> set{carray, 2};
+
+  for (size_t i = 0; i < REPEATS; i++)
+  {
+    when(read(set)) << [](acquired_cown_span<const Counter> s) {
+      check(s.length == 2);
+      check(s.array[0]->count == 0);
+    };
+  }
+
+  when(set) << [](acquired_cown_span<Counter> s) {
+    for (size_t j = 0; j < s.length; j++)
+      s.array[j]->count++;
+  };
+}
+
+struct Shard
+{
+  size_t index;
+
+  Shard(size_t index_) : index(index_) {}
+};
+
+void test_order_key()
+{
+  static constexpr size_t COUNT = 10;
+
+  // Give the shards keys in the reverse of their allocation order.
+  cown_ptr<Shard> carray[COUNT];
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    carray[i] = make_cown<Shard>(i);
+    carray[i].set_order_key(COUNT - i);
+  }
+
+  cown_set<Shard> set{carray, COUNT};
+
+  when(set) << [](acquired_cown_span<Shard> s) {
+    check(s.length == COUNT);
+    for (size_t j = 0; j < s.length; j++)
+      check(s.array[j]->index == COUNT - 1 - j);
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_dedup);
+  harness.run(test_large);
+  harness.run(test_read);
+  harness.run(test_order_key);
+
+  return 0;
+}
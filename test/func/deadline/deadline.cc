@@ -0,0 +1,55 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that behaviours with deadlines run in earliest deadline first order.
+ *
+ * The behaviours are scheduled latest deadline first from a single
+ * behaviour.  With a single scheduler thread, they must then run in the
+ * reverse order to which they were scheduled.  With more threads, they can
+ * be stolen and run in parallel, so only completion is checked.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t DEADLINE_COUNT = 20;
+static size_t core_count = 0;
+static std::atomic<size_t> run_count = 0;
+
+struct Account
+{};
+
+void test_deadline()
+{
+  run_count = 0;
+
+  when() << []() {
+    for (size_t i = DEADLINE_COUNT; i > 0; i--)
+    {
+      // Deadlines far enough away that none are missed.
+      auto d = std::chrono::seconds(10) + std::chrono::milliseconds(i);
+      when(make_cown<Account>()).with_deadline(d) << [i](auto) {
+        auto order = run_count++;
+        if (core_count == 1)
+          check(order == i - 1);
+      };
+    }
+
+    // Cown-less work can also have a deadline.
+    when().with_deadline(std::chrono::seconds(10)) << []() {};
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  core_count = harness.cores;
+
+  harness.run(test_deadline);
+
+  check(run_count == DEADLINE_COUNT);
+
+  return 0;
+}
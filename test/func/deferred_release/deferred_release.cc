@@ -0,0 +1,66 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+/**
+ * Copies and drops cown_ptrs inside behaviours, so that deferred releases
+ * are cancelled by later copies and applied at the end of the behaviour.
+ * Each cown must still be collected exactly once.
+ */
+
+using namespace verona::cpp;
+
+static std::atomic<size_t> collected{0};
+
+struct Counter
+{
+  size_t n = 0;
+
+  ~Counter()
+  {
+    collected++;
+  }
+};
+
+static constexpr size_t COWNS = 20;
+static constexpr size_t COPIES = 50;
+
+void test_copies()
+{
+  collected = 0;
+  for (size_t i = 0; i < COWNS; i++)
+  {
+    auto c = make_cown<Counter>();
+    when() << [c]() {
+      for (size_t j = 0; j < COPIES; j++)
+      {
+        auto copy = c;
+        when(copy) << [](acquired_cown<Counter> a) { a->n++; };
+      }
+    };
+  }
+}
+
+void test_drop()
+{
+  // Every handle is dropped inside the behaviour that uses it.
+  auto c = make_cown<Counter>();
+  when(c) << [c = std::move(c)](acquired_cown<Counter> a) mutable {
+    a->n++;
+    c = nullptr;
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_copies);
+  check(collected == COWNS);
+
+  harness.run(test_drop);
+
+  return 0;
+}
@@ -0,0 +1,64 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `acquired_cown::downgrade`.  Readers queued behind the writer see
+ * its update, and may run before it finishes, and a writer queued behind the
+ * readers runs after all of them.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t READERS = 4;
+
+struct Table
+{
+  size_t version = 0;
+  mutable std::atomic<size_t> reads{0};
+  mutable std::atomic<bool> writer_done{false};
+};
+
+void test_downgrade()
+{
+  auto table = make_cown<Table>();
+
+  when(table) << [](acquired_cown<Table> t) {
+    t->version++;
+    auto r = t.downgrade();
+    yield();
+    check(r->version == 1);
+    if (r->reads.load() != 0)
+      Logging::cout() << "Downgrade: readers ran early" << Logging::endl;
+    r->writer_done = true;
+    r->reads++;
+  };
+
+  for (size_t i = 0; i < READERS; i++)
+  {
+    when(read(table)) << [](acquired_cown<const Table> t) {
+      check(t->version == 1);
+      t->reads++;
+    };
+  }
+
+  when(table) << [](acquired_cown<Table> t) {
+    check(t->writer_done);
+    check(t->reads == READERS + 1);
+    t->version++;
+  };
+
+  when(read(table)) << [](acquired_cown<const Table> t) {
+    check(t->version == 2);
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_downgrade);
+
+  return 0;
+}
@@ -266,6 +266,35 @@ void test_repeated_cown()
     << [=](auto) { Logging::cout() << "log" << Logging::endl; };
 }
 
+void test_wide_read()
+{
+  Logging::cout() << "test_wide_read()" << Logging::endl;
+
+  // More cowns than the small path handles, all read.
+  static constexpr size_t WIDE = 32;
+  cown_ptr<Body1> carray[WIDE];
+  for (size_t i = 0; i < WIDE; i++)
+    carray[i] = make_cown<Body1>(0);
+
+  cown_array<Body1> t1{carray, WIDE};
+
+  when(carray[WIDE / 2]) << [](acquired_cown<Body1> b) { b->val = 1; };
+
+  for (size_t r = 0; r < 4; r++)
+  {
+    when(read(t1)) << [](acquired_cown_span<const Body1> span) {
+      check(span.length == WIDE);
+      check(span.array[WIDE / 2]->val == 1);
+    };
+  }
+
+  when(carray[WIDE / 2]) << [](acquired_cown<Body1> b) { b->val = 2; };
+
+  when(read(t1)) << [](acquired_cown_span<const Body1> span) {
+    check(span.array[WIDE / 2]->val == 2);
+  };
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
@@ -290,5 +319,7 @@ int main(int argc, char** argv)
 
   harness.run(test_repeated_cown);
 
+  harness.run(test_wide_read);
+
   return 0;
 }
@@ -4,6 +4,7 @@
 #include <cpp/when.h>
 #include <debug/harness.h>
 #include <tuple>
+#include <vector>
 
 class Body1
 {
@@ -267,6 +268,81 @@ void test_repeated_cown()
     [=](auto) { Logging::cout() << "log" << Logging::endl; };
 }
 
+void test_borrow()
+{
+  Logging::cout() << "test_borrow()" << Logging::endl;
+
+  auto log1 = make_cown<Body1>(1);
+  auto log2 = make_cown<Body1>(2);
+
+  cown_ptr<Body1> carray[2];
+  carray[0] = log1;
+  carray[1] = log2;
+
+  // The array only needs to live until the behaviours are scheduled.
+  {
+    auto t1 = cown_array<Body1>::borrow(carray, 2);
+
+    when(t1) << [=](acquired_cown_span<Body1> span) {
+      check(span.length == 2);
+      span.array[0]->val += 10;
+      span.array[1]->val += 10;
+    };
+
+    when(read(t1)) << [=](acquired_cown_span<const Body1> span) {
+      check(span.array[0]->val == 11);
+      check(span.array[1]->val == 12);
+    };
+  }
+}
+
+void test_move_array()
+{
+  Logging::cout() << "test_move_array()" << Logging::endl;
+
+  auto log1 = make_cown<Body1>(1);
+
+  cown_array<Body1> t1{&log1, 1};
+  cown_array<Body1> t2{std::move(t1)};
+  check(t1.array == nullptr);
+
+  when(std::move(t2)) << [=](acquired_cown_span<Body1> span) {
+    check(span.length == 1);
+    check(span.array[0]->val == 1);
+  };
+}
+
+void test_large_span()
+{
+  Logging::cout() << "test_large_span()" << Logging::endl;
+
+  // Enough cowns that they are sorted by radix, with each cown twice in
+  // the array written to, so it takes the general path.
+  static constexpr size_t COUNT = 600;
+  std::vector<cown_ptr<Body1>> cowns;
+  std::vector<cown_ptr<Body1>> twice;
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    cowns.push_back(make_cown<Body1>(0));
+    twice.push_back(cowns.back());
+  }
+  for (size_t i = COUNT; i > 0; i--)
+    twice.push_back(cowns[i - 1]);
+
+  cown_array<Body1> t1{twice.data(), twice.size()};
+  when(t1) << [=](acquired_cown_span<Body1> span) {
+    check(span.length == 2 * COUNT);
+    for (size_t i = 0; i < span.length; i++)
+      span.array[i]->val++;
+  };
+
+  cown_array<Body1> t2{cowns.data(), cowns.size()};
+  when(read(t2)) << [=](acquired_cown_span<const Body1> span) {
+    for (size_t i = 0; i < span.length; i++)
+      check(span.array[i]->val == 2);
+  };
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
@@ -290,5 +366,10 @@ int main(int argc, char** argv)
 
   harness.run(test_repeated_cown);
 
+  harness.run(test_borrow);
+  harness.run(test_move_array);
+
+  harness.run(test_large_span);
+
   return 0;
 }
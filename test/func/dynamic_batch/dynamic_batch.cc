@@ -0,0 +1,90 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that the behaviours of a `dynamic_batch` are scheduled atomically:
+ * batches of different sizes are built concurrently, and every behaviour
+ * appends its batch to a shared log, in which each batch must then appear
+ * as one contiguous run of its full size.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t BATCHES = 16;
+
+static size_t batch_size(size_t batch)
+{
+  // Decided at runtime, and includes empty batches.
+  return batch < BATCHES ? batch % 5 : 1;
+}
+
+static std::atomic<bool> checked = false;
+
+struct Log
+{
+  std::vector<size_t> entries;
+
+  ~Log()
+  {
+    size_t expected = 0;
+    for (size_t batch = 0; batch <= BATCHES; batch++)
+      expected += batch_size(batch);
+    check(entries.size() == expected);
+
+    for (size_t i = 0; i < entries.size();)
+    {
+      size_t batch = entries[i];
+      for (size_t j = 0; j < batch_size(batch); j++)
+        check(entries[i + j] == batch);
+      i += batch_size(batch);
+    }
+    checked = true;
+  }
+};
+
+struct Piece
+{
+  size_t uses = 0;
+};
+
+void test_batches()
+{
+  auto log = make_cown<Log>();
+
+  for (size_t batch = 0; batch < BATCHES; batch++)
+  {
+    when() << [log, batch]() {
+      size_t size = batch_size(batch);
+      dynamic_batch b(size);
+      for (size_t i = 0; i < size; i++)
+      {
+        auto piece = make_cown<Piece>();
+        b += when(log, piece) << [batch](auto l, auto p) {
+          l->entries.push_back(batch);
+          p->uses++;
+        };
+      }
+      check(b.size() == size);
+      b.schedule();
+      check(b.size() == 0);
+    };
+  }
+
+  when() << [log]() {
+    // Scheduled at the end of its scope.
+    dynamic_batch b;
+    b += when(log) << [](auto l) { l->entries.push_back(BATCHES); };
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_batches);
+  check(checked);
+
+  return 0;
+}
@@ -0,0 +1,70 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks eager execution of new behaviours whose cowns are all idle: each
+ * behaviour of a chain creates the next on a new cown, which runs straight
+ * after it on the same core, until the depth limit sends one through the
+ * queues.  A behaviour on a cown that is busy is never run eagerly.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t CHAIN_LENGTH = 50;
+static constexpr size_t CHAINS = 4;
+
+static size_t depth;
+static std::atomic<size_t> finished = 0;
+
+static void chain(size_t i, Core* parent)
+{
+  when(make_cown<size_t>(i)) << [i, parent](acquired_cown<size_t> c) {
+    check(*c == i);
+
+    // Only the first of a chain is created outside a behaviour, and every
+    // `depth + 1`th is past the limit.
+    if ((i % (depth + 1)) != 0)
+      check(Scheduler::local_core() == parent);
+
+    if (i + 1 == CHAIN_LENGTH)
+      finished++;
+    else
+      chain(i + 1, Scheduler::local_core());
+  };
+}
+
+void test_chains()
+{
+  for (size_t i = 0; i < CHAINS; i++)
+    chain(0, nullptr);
+}
+
+void test_busy()
+{
+  auto c = make_cown<size_t>(0);
+  when(c) << [c](acquired_cown<size_t> n) {
+    // `c` is held, so this waits for the cown rather than running eagerly.
+    when(c) << [](acquired_cown<size_t> n) {
+      check(*n == 1);
+      finished++;
+    };
+    (*n)++;
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  depth = harness.opt.is<size_t>("--depth", 4);
+  Scheduler::set_eager_depth(depth);
+
+  harness.run(test_chains);
+  harness.run(test_busy);
+  check(
+    finished == (CHAINS + 1) * (harness.seed_upper - harness.seed_lower));
+
+  return 0;
+}
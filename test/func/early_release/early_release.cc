@@ -51,6 +51,7 @@
  *     3      Early release: finish
  * ---------------------------
  */
+#include <cpp/when.h>
 #include <debug/harness.h>
 
 struct A : public VCown<A>
@@ -96,11 +97,10 @@ void early_release_test(bool first, bool second)
   schedule_lambda(2, cowns, [=]() {
     start();
 
-    // TODO readd early release
-    // if (first)
-    //   a->release_early();
-    // if (second)
-    //   b->release_early();
+    if (first)
+      Behaviour::release_early(a);
+    if (second)
+      Behaviour::release_early(b);
     yield();
 
     finished();
@@ -121,6 +121,44 @@ void early_release_test(bool first, bool second)
     Cown::release(b);
 }
 
+struct Index
+{
+  size_t version = 0;
+};
+
+struct Table
+{
+  size_t rows = 0;
+};
+
+/**
+ * Checks `acquired_cown::release_early`: the index behaviour queued behind
+ * the transaction may run before it finishes, but after the index update.
+ */
+void acquired_release_early_test()
+{
+  using namespace verona::cpp;
+
+  auto index = make_cown<Index>();
+  auto table = make_cown<Table>();
+
+  when(index, table) << [](acquired_cown<Index> i, acquired_cown<Table> t) {
+    i->version++;
+    i.release_early();
+    start();
+    t->rows++;
+    yield();
+    finished();
+  };
+
+  when(index) << [](acquired_cown<Index> i) {
+    check(i->version == 1);
+    interleave();
+  };
+
+  when(table) << [](acquired_cown<Table> t) { check(t->rows == 1); };
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
@@ -128,6 +166,7 @@ int main(int argc, char** argv)
   harness.run(early_release_test, true, false);
   harness.run(early_release_test, false, true);
   harness.run(early_release_test, true, true);
+  harness.run(acquired_release_early_test);
 
   return 0;
 }
@@ -0,0 +1,50 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that all work completes while the number of active cores shrinks
+ * and grows, and that the runtime reaches quiescence with cores parked.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t ROUNDS = 10;
+static constexpr size_t WIDTH = 20;
+static std::atomic<size_t> run_count = 0;
+
+struct Counter
+{};
+
+void round(size_t cores, size_t remaining)
+{
+  // Alternate between a single active core and all of them, finishing with
+  // some cores still parked.
+  Scheduler::set_active_core_count(remaining % 2 == 1 ? cores : 1);
+
+  for (size_t i = 0; i < WIDTH; i++)
+  {
+    when(make_cown<Counter>()) << [](auto) { run_count++; };
+  }
+
+  if (remaining > 0)
+    when() << [cores, remaining]() { round(cores, remaining - 1); };
+}
+
+void test_elastic(size_t cores)
+{
+  run_count = 0;
+  when() << [cores]() { round(cores, ROUNDS - 1); };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_elastic, harness.cores);
+
+  check(run_count == ROUNDS * WIDTH);
+
+  return 0;
+}
@@ -167,11 +167,76 @@ namespace ext_ref_basic
     heap::debug_check_empty();
   }
 
+  struct Item : public V<Item>
+  {
+    Item* next = nullptr;
+
+    void trace(ObjectStack& st) const
+    {
+      if (next != nullptr)
+        st.push(next);
+    }
+  };
+
+  // Create and resolve external references to many objects at once, after
+  // some of the objects have been collected.
+  template<RegionType region_type>
+  void bulk_test()
+  {
+    static constexpr size_t count = 100;
+    auto r = new (region_type) Item;
+    {
+      UsingRegion ur(r);
+
+      Object* objects[count];
+      ExternalRef* refs[count];
+      Item* cur = r;
+      for (size_t i = 0; i < count; i++)
+      {
+        cur->next = new Item;
+        cur = cur->next;
+        objects[i] = cur;
+      }
+
+      create_external_references(objects, count, refs);
+
+      // A second reference to an object is the same external reference.
+      auto alias = create_external_reference(objects[0]);
+      check(alias == refs[0]);
+      Immutable::release(alias);
+
+      Object* resolved[count];
+      check(resolve_external_references(refs, count, resolved) == count);
+      for (size_t i = 0; i < count; i++)
+        check(resolved[i] == objects[i]);
+
+      if constexpr (region_type == RegionType::Trace)
+      {
+        // Drop the second half of the list.
+        ((Item*)objects[count / 2 - 1])->next = nullptr;
+        region_collect();
+
+        check(resolve_external_references(refs, count, resolved) == count / 2);
+        for (size_t i = 0; i < count; i++)
+          check(resolved[i] == ((i < count / 2) ? objects[i] : nullptr));
+      }
+
+      for (auto* ref : refs)
+        Immutable::release(ref);
+    }
+
+    region_release(r);
+
+    heap::debug_check_empty();
+  }
+
   void run_test()
   {
     basic_test();
     singleton_region_test<RegionType::Trace>();
     singleton_region_test<RegionType::Arena>();
+    bulk_test<RegionType::Trace>();
+    bulk_test<RegionType::Arena>();
     // TODO: RegionType::Rc
   }
 
@@ -0,0 +1,110 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `finish_scope`: the continuation runs once, after every behaviour
+ * and task spawned inside the scope, however indirectly, while work outside
+ * it is still running.  A nested scope, and its continuation, are part of
+ * the outer scope, and `done` can be waited for with `when`.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t WIDTH = 4;
+static constexpr size_t DEPTH = 4;
+
+/// Behaviours in a tree of `DEPTH` levels, each spawning `WIDTH` more.
+static constexpr size_t TREE = 1 + 4 + 16 + 64;
+
+static std::atomic<size_t> finished = 0;
+static std::atomic<size_t> continuations = 0;
+
+static void spawn_tree(cown_ptr<size_t> c, size_t depth)
+{
+  when(c) << [c, depth](acquired_cown<size_t> n) {
+    (*n)++;
+    finished++;
+    if (depth + 1 == DEPTH)
+      return;
+
+    for (size_t i = 0; i < WIDTH; i++)
+    {
+      if (i % 2 == 0)
+        spawn_tree(c, depth + 1);
+      else
+        // Through a closure with no cowns.
+        schedule_lambda([c, depth]() { spawn_tree(c, depth + 1); });
+    }
+  };
+}
+
+void test_tree()
+{
+  finished = 0;
+  auto counter = make_cown<size_t>(0);
+
+  // Work outside the scope, which it must not wait for.
+  auto outside = make_cown<size_t>(0);
+  when(outside) << [](acquired_cown<size_t>) {};
+
+  finish_scope job;
+  job.run([&]() { spawn_tree(counter, 0); });
+  job.then([counter]() {
+    check(finished == TREE);
+    when(counter) << [](acquired_cown<size_t> n) { check(*n == TREE); };
+
+    // The next job, back to back.
+    finish_scope next;
+    next.run([&]() { spawn_tree(counter, 0); });
+    next.then([]() {
+      check(finished == 2 * TREE);
+      continuations++;
+    });
+  });
+}
+
+void test_nested()
+{
+  auto order = make_cown<size_t>(0);
+
+  finish_scope outer;
+  outer.run([&]() {
+    when(order) << [order](acquired_cown<size_t>) {
+      finish_scope inner;
+      inner.run([&]() {
+        for (size_t i = 0; i < WIDTH; i++)
+          when(order) << [](acquired_cown<size_t> n) { (*n)++; };
+      });
+      inner.then([order]() {
+        when(order) << [](acquired_cown<size_t> n) {
+          check(*n == WIDTH);
+          *n = 100;
+        };
+      });
+    };
+  });
+
+  // The outer scope waits for the inner continuation, and what it spawns.
+  // Not on `order` as well, which would queue ahead of the inner scope.
+  when(outer.done()) <<
+    [order](std::variant<bool, Promise<bool>::PromiseErr> v) {
+      check(std::get<bool>(v));
+      when(order) << [](acquired_cown<size_t> n) {
+        check(*n == 100);
+        continuations++;
+      };
+    };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_tree);
+  harness.run(test_nested);
+  check(continuations == 2 * (harness.seed_upper - harness.seed_lower));
+
+  return 0;
+}
@@ -388,6 +388,113 @@ void test_contains_immutable1()
   heap::debug_check_empty();
 }
 
+void test_single_scc1()
+{
+  // Freeze a region that is not strongly connected as one scc.
+  //
+  // There are two regions, [1, 2, 3, 4] and [5].
+  //
+  // 1 -> 2, 3
+  // 2 -> 4
+  // 3 -> 4, 5
+  C1* o1 = new (RegionType::Trace) C1;
+  C1 *o2, *o3, *o4, *o5;
+  {
+    UsingRegion r(o1);
+    o2 = new C1;
+    o3 = new C1;
+    o4 = new C1;
+    o1->f1 = o2;
+    o1->f2 = o3;
+    o2->f1 = o4;
+    o3->f1 = o4;
+
+    o5 = new (RegionType::Trace) C1;
+    o3->f2 = o5;
+  }
+
+  freeze_as_single_scc(o1);
+
+  check(o1->debug_test_rc(1));
+  check(o2->debug_immutable_root() == o1);
+  check(o3->debug_immutable_root() == o1);
+  check(o4->debug_immutable_root() == o1);
+  check(o5->debug_test_rc(1));
+
+  // Free immutable graph.
+  Immutable::release(o1);
+
+  heap::debug_check_empty();
+}
+
+void test_single_scc2()
+{
+  // Freeze a region with a cycle, and a reference to an immutable graph.
+  //
+  // 1 -> 2, nested
+  // 2 -> 1
+  Symbolic* nested = new (RegionType::Trace) Symbolic;
+  freeze(nested);
+
+  Symbolic* o1 = new (RegionType::Trace) Symbolic;
+  Symbolic* o2;
+  {
+    UsingRegion r(o1);
+    o2 = new Symbolic;
+    o1->fields.push_back(o2);
+    o2->fields.push_back(o1);
+  }
+
+  // Add to the fields of the object, and update the remembered set.
+  o1->fields.push_back(nested);
+  RememberedSet* rs = o1->get_region();
+  rs->insert<YesTransfer>(nested);
+
+  freeze_as_single_scc(o1);
+
+  check(o1->debug_test_rc(1));
+  check(o2->debug_immutable_root() == o1);
+  check(nested->debug_test_rc(1));
+
+  // Free immutable graph.
+  Immutable::release(o1);
+
+  heap::debug_check_empty();
+}
+
+void test_single_scc_garbage()
+{
+  // Freeze a region with objects the root cannot reach, which must be
+  // collected, as the search that frees the SCC would not find them.
+  //
+  // There are two regions, [1, 2, 3, 4] and [5].
+  //
+  // 1 -> 2
+  // 3 -> 4, 5
+  // 4 -> 3
+  C1* o1 = new (RegionType::Trace) C1;
+  {
+    UsingRegion r(o1);
+    C1* o2 = new C1;
+    C1* o3 = new C1;
+    C1* o4 = new C1;
+    o1->f1 = o2;
+    o3->f1 = o4;
+    o4->f1 = o3;
+    o3->f2 = new (RegionType::Trace) C1;
+  }
+
+  freeze_as_single_scc(o1);
+
+  check(o1->debug_test_rc(1));
+  check(o1->f1->debug_immutable_root() == o1);
+
+  // Free immutable graph.
+  Immutable::release(o1);
+
+  heap::debug_check_empty();
+}
+
 void test_random(size_t seed = 1, size_t max_edges = 128)
 {
   heap::debug_check_empty();
@@ -542,6 +649,9 @@ int main(int, char**)
   test_two_rings_2();
   freeze_weird_ring();
   test_contains_immutable1();
+  test_single_scc1();
+  test_single_scc2();
+  test_single_scc_garbage();
 
   for (size_t i = 1; i < 10000; i++)
   {
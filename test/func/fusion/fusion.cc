@@ -0,0 +1,95 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `when_fused`.  Closures sent to a cown run in order, interleaved
+ * correctly with ordinary behaviours from the same thread, and closures
+ * sent from inside a behaviour are flushed when it returns.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t MESSAGES = 50;
+static constexpr size_t COWNS = 12;
+
+struct Log
+{
+  size_t next = 0;
+  size_t expected;
+
+  Log(size_t expected_) : expected(expected_) {}
+
+  ~Log()
+  {
+    check(next == expected);
+  }
+};
+
+void test_order()
+{
+  set_fusion_limit(8);
+
+  // More cowns than buffers, so buffers are flushed when one runs out.
+  cown_ptr<Log> logs[COWNS];
+  for (size_t i = 0; i < COWNS; i++)
+    logs[i] = make_cown<Log>(MESSAGES + 1);
+
+  for (size_t j = 0; j < MESSAGES; j++)
+  {
+    for (size_t i = 0; i < COWNS; i++)
+    {
+      when_fused(logs[i], [j](acquired_cown<Log> l) {
+        check(l->next == j);
+        l->next++;
+      });
+    }
+  }
+
+  // Must run after all the fused closures.
+  for (size_t i = 0; i < COWNS; i++)
+  {
+    when(logs[i]) << [](acquired_cown<Log> l) {
+      check(l->next == MESSAGES);
+      l->next++;
+    };
+  }
+}
+
+void test_from_behaviour()
+{
+  auto source = make_cown<Log>(1);
+  auto sink = make_cown<Log>(MESSAGES);
+
+  when(source) << [sink](acquired_cown<Log> s) {
+    s->next++;
+    for (size_t j = 0; j < MESSAGES; j++)
+    {
+      when_fused(sink, [j](acquired_cown<Log> l) {
+        check(l->next == j);
+        l->next++;
+      });
+    }
+  };
+}
+
+void test_flush()
+{
+  auto log = make_cown<Log>(2);
+
+  when_fused(log, [](acquired_cown<Log> l) { l->next++; });
+  when_fused(log, [](acquired_cown<Log> l) { l->next++; });
+  flush_fused();
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_order);
+  harness.run(test_from_behaviour);
+  harness.run(test_flush);
+
+  return 0;
+}
@@ -59,9 +59,10 @@ bool model_check(
 struct Key : public VCown<Key>
 {};
 
-bool test(size_t seed)
+bool test(size_t seed, bool incremental)
 {
   ObjectMap<std::pair<Key*, int32_t>> map;
+  map.set_incremental(incremental);
   std::unordered_map<Key*, int32_t> model;
 
   verona::rt::PRNG<> rng{seed};
@@ -141,6 +142,37 @@ bool test(size_t seed)
     }
   }
 
+  // Reserving room keeps the entries, and the map still works as it fills.
+  map.reserve(map.size() + entries);
+  err << "reserve " << map.size() + entries << "\n";
+  if (!model_check(map, model, err))
+  {
+    std::cout << err.str() << std::flush;
+    return false;
+  }
+
+  for (size_t i = 0; i < entries; i++)
+  {
+    auto* key = new Key();
+    auto entry = std::make_pair(key, (int32_t)i);
+    model.insert(entry);
+    map.insert(entry);
+  }
+  if (!model_check(map, model, err))
+  {
+    std::cout << err.str() << std::flush;
+    return false;
+  }
+
+  // Turning incremental growth off finishes moving the entries.
+  map.set_incremental(false);
+  err << "finish growing\n";
+  if (!model_check(map, model, err))
+  {
+    std::cout << err.str() << std::flush;
+    return false;
+  }
+
   map.clear();
   if (map.size() != 0)
   {
@@ -162,8 +194,11 @@ int main(int argc, char** argv)
   for (size_t seed = harness.seed_lower; seed <= harness.seed_upper; seed++)
   {
     std::cout << "seed: " << seed << std::endl;
-    if (!test(seed))
-      return 1;
+    for (bool incremental : {false, true})
+    {
+      if (!test(seed, incremental))
+        return 1;
+    }
 
     debug_check_empty<snmalloc::Alloc::Config>();
   }
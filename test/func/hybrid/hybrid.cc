@@ -0,0 +1,57 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks the capacity of each cpu found by `Topology`: every cpu has some,
+ * and the fastest has `CAPACITY_SCALE`.  Then checks that high priority
+ * work, which is placed away from efficiency cores, still runs in order.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t HIGH_COUNT = 20;
+
+void test_topology()
+{
+  Topology topology;
+  Topology::init(&topology);
+
+  size_t fastest = 0;
+  for (size_t i = 0; i < topology.size(); i++)
+  {
+    auto capacity = topology.capacity(i);
+    check(capacity > 0);
+    check(capacity <= Topology::CAPACITY_SCALE);
+    fastest = std::max(fastest, capacity);
+  }
+  check(fastest == Topology::CAPACITY_SCALE);
+}
+
+struct Count
+{
+  size_t count = 0;
+};
+
+void test_high()
+{
+  auto c = make_cown<Count>();
+  for (size_t i = 0; i < HIGH_COUNT; i++)
+  {
+    when(c).with_priority(Priority::High) << [](acquired_cown<Count> c) {
+      c->count++;
+    };
+  }
+  when(c) << [](acquired_cown<Count> c) { check(c->count == HIGH_COUNT); };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  test_topology();
+  harness.run(test_high);
+
+  return 0;
+}
@@ -0,0 +1,163 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+static std::atomic<size_t> live_count;
+
+struct C : public V<C>
+{
+  C* f1 = nullptr;
+  C* f2 = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (f1 != nullptr)
+      st.push(f1);
+
+    if (f2 != nullptr)
+      st.push(f2);
+  }
+};
+
+struct F : public V<F>
+{
+  F* f1 = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (f1 != nullptr)
+      st.push(f1);
+  }
+
+  F()
+  {
+    live_count++;
+  }
+
+  ~F()
+  {
+    live_count--;
+  }
+};
+
+/// Builds a list of `n` objects, and `n` garbage objects besides it.
+template<typename T>
+T* build_list(size_t n)
+{
+  T* head = nullptr;
+  for (size_t i = 0; i < n; i++)
+  {
+    auto t = new T;
+    t->f1 = head;
+    head = t;
+    new T;
+  }
+  return head;
+}
+
+/// Steps a collection to the end, and returns the number of steps.
+size_t collect_in_steps(size_t budget)
+{
+  size_t steps = 1;
+  while (!region_collect_step(budget))
+    steps++;
+  return steps;
+}
+
+void test_steps()
+{
+  auto* o = new (RegionType::Trace) C;
+  {
+    UsingRegion rr(o);
+
+    o->f1 = build_list<C>(100);
+    // Kept alive by a trivial object, so both rings are swept.
+    o->f2 = new C;
+    auto f = build_list<F>(20);
+    RegionTrace::push_additional_root(o, f);
+
+    check(debug_size() == 1 + 200 + 1 + 40);
+    check(live_count == 40);
+
+    check(collect_in_steps(10) > 1);
+    check(debug_size() == 1 + 100 + 1 + 20);
+    check(live_count == 20);
+
+    // Nothing left to collect, but the whole region is still traced.
+    check(collect_in_steps(1000) == 1);
+    check(debug_size() == 1 + 100 + 1 + 20);
+
+    RegionTrace::pop_additional_root(o, f);
+  }
+
+  region_release(o);
+  check(live_count == 0);
+}
+
+void test_mutation()
+{
+  auto* o = new (RegionType::Trace) C;
+  {
+    UsingRegion rr(o);
+
+    o->f1 = build_list<C>(50);
+    C* tail = o->f1;
+    for (size_t i = 0; i < 25; i++)
+      tail = tail->f1;
+
+    // Start marking, and move the tail of the list into the object that is
+    // marked first, C's f2, behind the barrier, while dropping it from the
+    // list.
+    check(!region_collect_step(3));
+    C* mid = o->f1;
+    for (size_t i = 0; i < 24; i++)
+      mid = mid->f1;
+    mid->f1 = nullptr;
+    o->f1->f2 = tail;
+    region_write_barrier(tail);
+
+    // Objects allocated during the collection survive it.
+    auto n = new C;
+    o->f2 = n;
+
+    collect_in_steps(5);
+    check(debug_size() == 1 + 50 + 1);
+
+    // Dropping the new object collects it next time.
+    o->f2 = nullptr;
+    collect_in_steps(5);
+    check(debug_size() == 1 + 50);
+
+    // Start again, allocate while sweeping, and finish with a full collection.
+    o->f1->f2 = nullptr;
+    while (!region_collect_step(1))
+    {
+      auto g = new C;
+      UNUSED(g);
+    }
+    region_collect();
+    check(debug_size() == 1 + 25);
+  }
+
+  region_release(o);
+}
+
+void test_incremental_gc()
+{
+  test_steps();
+  test_mutation();
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_incremental_gc);
+
+  return 0;
+}
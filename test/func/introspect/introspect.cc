@@ -0,0 +1,65 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that a snapshot of the load on the scheduler can be taken while the
+ * runtime is running.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t BEHAVIOURS = 100;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+void check_consistent(const SchedulerSnapshot& snapshot)
+{
+  check(snapshot.cores.size() == Scheduler::get_core_count());
+  for (size_t i = 0; i < snapshot.cores.size(); i++)
+    check(snapshot.cores[i].index == i);
+  check(snapshot.paused_threads < snapshot.thread_count);
+  check(snapshot.active_core_count <= snapshot.cores.size());
+}
+
+void test_introspect()
+{
+  auto counter = make_cown<Counter>();
+
+  when(counter) << [counter](acquired_cown<Counter>) {
+    auto before = Scheduler::introspect();
+    check_consistent(before);
+    check(before.external_event_sources == 0);
+
+    Scheduler::add_external_event_source();
+    check(Scheduler::introspect().external_event_sources == 1);
+    Scheduler::remove_external_event_source();
+
+    for (size_t i = 0; i < BEHAVIOURS; i++)
+      when(counter) << [](acquired_cown<Counter> c) { c->count++; };
+
+    // Runs after all of the above, which were created on this core.
+    when(counter) << [before](acquired_cown<Counter> c) {
+      check(c->count == BEHAVIOURS);
+
+      auto after = Scheduler::introspect();
+      check_consistent(after);
+      check(after.executed >= before.executed + BEHAVIOURS);
+      check(after.executed_per_second(before) >= 0);
+      check(before.executed_per_second(after) == 0);
+    };
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_introspect);
+
+  return 0;
+}
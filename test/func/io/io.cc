@@ -0,0 +1,184 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks I/O submitted from behaviours, see `cpp/io.h`.
+ *
+ * Each operation's continuation must run on the core that submitted it, with
+ * the operation's result, whether the core uses io_uring or runs operations
+ * synchronously.  More operations are submitted at once than fit in a ring,
+ * and a file is written and read back through a cown, with continuations
+ * and with promises.  Messages are sent and received over a socket pair,
+ * with io_uring and with it disabled, so that they run synchronously in a
+ * blocking section.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <string>
+#if defined(__unix__) || defined(__APPLE__)
+#  include <cstdlib>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+using namespace verona::cpp;
+
+static constexpr size_t NOP_COUNT = 2 * IOQueue::ENTRIES + 10;
+static std::atomic<size_t> completed = 0;
+
+void test_nops()
+{
+  completed = 0;
+
+  when() << []() {
+    auto core = Scheduler::local_core();
+    for (size_t i = 0; i < NOP_COUNT; i++)
+    {
+      io::submit(io::nop(), [core](int result) {
+        check(result == 0);
+        check(Scheduler::local_core() == core);
+        completed++;
+      });
+    }
+
+    io::submit(io::nop()).then(
+      [](std::variant<int, Promise<int>::PromiseErr> result) {
+        check(std::holds_alternative<int>(result));
+        check(std::get<int>(result) == 0);
+        completed++;
+      });
+  };
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+static const std::string text = "Behaviours, cowns and the kernel.";
+
+struct File
+{
+  int fd;
+  std::string path;
+  std::string in;
+
+  File()
+  {
+    char name[] = "/tmp/verona-io-XXXXXX";
+    fd = mkstemp(name);
+    check(fd >= 0);
+    path = name;
+    in.resize(text.size());
+  }
+
+  ~File()
+  {
+    close(fd);
+    unlink(path.c_str());
+  }
+};
+
+void test_file()
+{
+  completed = 0;
+
+  auto file = make_cown<File>();
+  when(file) << [file](acquired_cown<File> f) {
+    auto core = Scheduler::local_core();
+    io::submit(
+      io::write(f->fd, text.data(), (uint32_t)text.size(), 0),
+      [file, core](int result) {
+        check(result == (int)text.size());
+        check(Scheduler::local_core() == core);
+
+        // Read it back through the cown, this time with a promise.
+        when(file) << [](acquired_cown<File> f) {
+          auto len = (uint32_t)f->in.size();
+          io::submit(io::read(f->fd, f->in.data(), len, 0))
+            .then([f = f.cown()](
+                    std::variant<int, Promise<int>::PromiseErr> result) {
+              check(std::get<int>(result) == (int)text.size());
+              when(f) << [](acquired_cown<File> f) {
+                check(f->in == text);
+                completed++;
+              };
+            });
+        };
+      });
+  };
+}
+
+static const std::string message = "Over the socket.";
+
+struct Sockets
+{
+  int fds[2];
+  std::string in;
+
+  Sockets()
+  {
+    check(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    in.resize(message.size());
+  }
+
+  ~Sockets()
+  {
+    close(fds[0]);
+    close(fds[1]);
+  }
+};
+
+/**
+ * Send on one end of a socket pair, and then receive on the other, so that
+ * the receive does not block a systematic test.
+ */
+void test_socket()
+{
+  completed = 0;
+
+  auto sockets = make_cown<Sockets>();
+  when(sockets) << [sockets](acquired_cown<Sockets> s) {
+    auto core = Scheduler::local_core();
+    io::submit(
+      io::send(s->fds[0], message.data(), (uint32_t)message.size()),
+      [sockets, core](int result) {
+        check(result == (int)message.size());
+        check(Scheduler::local_core() == core);
+
+        when(sockets) << [sockets](acquired_cown<Sockets> s) {
+          auto len = (uint32_t)s->in.size();
+          io::submit(
+            io::recv(s->fds[1], s->in.data(), len), [sockets](int result) {
+              check(result == (int)message.size());
+              when(sockets) << [](acquired_cown<Sockets> s) {
+                check(s->in == message);
+                completed++;
+              };
+            });
+        };
+      });
+  };
+}
+#endif
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_nops);
+  check(completed == NOP_COUNT + 1);
+
+#if defined(__unix__) || defined(__APPLE__)
+  harness.run(test_file);
+  check(completed == 1);
+
+  harness.run(test_socket);
+  check(completed == 1);
+
+  IOQueue::set_ring_enabled(false);
+  harness.run(test_socket);
+  check(completed == 1);
+  harness.run(test_nops);
+  check(completed == NOP_COUNT + 1);
+  IOQueue::set_ring_enabled(true);
+#endif
+
+  return 0;
+}
@@ -0,0 +1,102 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that idle scheduler threads wait for events from outside the
+ * runtime in the I/O poller, see `ThreadPool::set_io_poller`.
+ *
+ * An external thread writes bytes to a pipe, and the poller waits on the
+ * pipe with `poll`, scheduling a behaviour for each byte, and removing the
+ * external event source once the pipe is closed.  Only the poller reads the
+ * pipe, so each byte must be handled for the runtime to finish.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+#if defined(__unix__) || defined(__APPLE__)
+#  include <poll.h>
+#  include <unistd.h>
+#endif
+
+using namespace verona::cpp;
+
+#if defined(__unix__) || defined(__APPLE__)
+static constexpr size_t BYTE_COUNT = 100;
+
+struct Pipe
+{
+  int read_fd = -1;
+  int write_fd = -1;
+  bool closed = false;
+};
+
+static Pipe pipe_fds;
+static std::atomic<size_t> received = 0;
+
+static void pipe_poller(void* context, uint64_t timeout_ns)
+{
+  auto p = static_cast<Pipe*>(context);
+  if (p->closed)
+    return;
+
+  pollfd fds{p->read_fd, POLLIN, 0};
+  if (poll(&fds, 1, (int)((timeout_ns + 999'999) / 1'000'000)) <= 0)
+    return;
+
+  char buf[16];
+  auto n = read(p->read_fd, buf, sizeof(buf));
+  if (n > 0)
+  {
+    for (ssize_t i = 0; i < n; i++)
+      when() << []() { received++; };
+    return;
+  }
+
+  p->closed = true;
+  when() << []() { Scheduler::remove_external_event_source(); };
+}
+
+static void close_pipe()
+{
+  if (pipe_fds.read_fd >= 0)
+    close(pipe_fds.read_fd);
+  pipe_fds = Pipe();
+}
+
+void test_poller(SystematicTestHarness* harness)
+{
+  close_pipe();
+  int fds[2];
+  check(pipe(fds) == 0);
+  pipe_fds.read_fd = fds[0];
+  pipe_fds.write_fd = fds[1];
+  received = 0;
+
+  when() << [harness]() {
+    Scheduler::add_external_event_source();
+    harness->external_thread([]() {
+      for (size_t i = 0; i < BYTE_COUNT; i++)
+      {
+        char c = (char)i;
+        check(write(pipe_fds.write_fd, &c, 1) == 1);
+        Systematic::yield();
+      }
+      close(pipe_fds.write_fd);
+    });
+  };
+}
+#endif
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+#if defined(__unix__) || defined(__APPLE__)
+  Scheduler::set_io_poller(&pipe_poller, &pipe_fds);
+  harness.run(test_poller, &harness);
+  check(received == BYTE_COUNT);
+  close_pipe();
+  Scheduler::set_io_poller(nullptr);
+#endif
+
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks starting the runtime with a single scheduler thread, and starting
+ * more as work builds up, see `ThreadPool::set_lazy_start`.
+ *
+ * Independent behaviours are queued before the runtime starts, so the first
+ * thread finds more work than it can run, and starts others, but no more
+ * than the budget.  With systematic testing, all threads start at once.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t BEHAVIOURS = 200;
+static constexpr size_t BUDGET = 2;
+static size_t core_count = 0;
+static std::atomic<size_t> run_count = 0;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+static size_t spawned()
+{
+  return Scheduler::stats_snapshot()[SchedulerStats::Spawn];
+}
+
+void test_lazy_start()
+{
+  run_count = 0;
+  auto before = spawned();
+
+  std::vector<cown_ptr<Counter>> counters;
+  for (size_t i = 0; i < BEHAVIOURS; i++)
+  {
+    counters.push_back(make_cown<Counter>());
+    when(counters.back()) << [](acquired_cown<Counter> c) {
+      busy_loop(10);
+      c->count++;
+      run_count++;
+    };
+  }
+
+  when(cown_array<Counter>::borrow(counters.data(), counters.size()))
+    << [before](acquired_cown_span<Counter> cs) {
+         for (size_t i = 0; i < cs.length; i++)
+           check(cs.array[i]->count == 1);
+
+         auto n = spawned() - before;
+         check(n <= std::min(BUDGET, core_count - 1));
+#ifndef USE_SYSTEMATIC_TESTING
+         if (core_count > 1)
+           check(n > 0);
+#endif
+       };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  core_count = harness.cores;
+
+  Scheduler::set_lazy_start(true, BUDGET);
+  harness.run(test_lazy_start);
+  Scheduler::set_lazy_start(false);
+
+  check(run_count == BEHAVIOURS);
+
+  return 0;
+}
@@ -0,0 +1,52 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that the runtime runs in low jitter mode, where each scheduler
+ * thread warms up before its first work, and that the isolated cpus, if the
+ * machine has any, are a valid list.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t COWNS = 16;
+static constexpr size_t ROUNDS = 10;
+
+void test_low_jitter()
+{
+  check(Scheduler::get_low_jitter());
+
+  for (size_t i = 0; i < COWNS; i++)
+  {
+    auto c = make_cown<size_t>(0);
+    for (size_t j = 0; j < ROUNDS; j++)
+    {
+      when(c) << [j](acquired_cown<size_t> n) {
+        check(*n == j);
+        (*n)++;
+      };
+    }
+  }
+}
+
+void test_isolated()
+{
+  std::vector<size_t> cpus;
+  if (isolated_cpus(cpus))
+    check(!cpus.empty());
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  test_isolated();
+
+  Scheduler::set_low_jitter(true);
+  harness.run(test_low_jitter);
+  Scheduler::set_low_jitter(false);
+
+  return 0;
+}
@@ -2,10 +2,13 @@
 // SPDX-License-Identifier: MIT
 #include "memory.h"
 
+#include "memory_adopt.h"
 #include "memory_alloc.h"
+#include "memory_clone.h"
 #include "memory_gc.h"
 #include "memory_iterator.h"
 #include "memory_merge.h"
+#include "memory_quota.h"
 #include "memory_rc.h"
 // #include "memory_subregion.h"
 #include "memory_swap_root.h"
@@ -57,6 +60,9 @@ int main(int argc, char** argv)
   memory_merge::run_test();
   memory_gc::run_test();
   memory_rc::run_test();
+  memory_quota::run_test();
+  memory_adopt::run_test();
+  memory_clone::run_test();
   // memory_subregion::run_test();
 
   test_dealloc();
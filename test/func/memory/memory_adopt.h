@@ -0,0 +1,100 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+
+namespace memory_adopt
+{
+  /**
+   * Counts the buffers given back to it.
+   **/
+  struct CountingPool : public BufferPool
+  {
+    size_t recycled = 0;
+    size_t bytes = 0;
+
+    CountingPool()
+    : BufferPool{[](BufferPool* p, void* buf, size_t size) {
+        auto self = static_cast<CountingPool*>(p);
+        self->recycled++;
+        self->bytes += size;
+        heap::dealloc(buf, size);
+      }}
+    {}
+  };
+
+  static constexpr size_t BUFFER_SIZE = 4096;
+
+  void* adopt_new(Object* r, CountingPool& pool)
+  {
+    UsingRegion rr(r);
+    auto buf = heap::alloc(BUFFER_SIZE);
+    check(adopt_buffer(buf, BUFFER_SIZE, &pool) == buf);
+    return buf;
+  }
+
+  /**
+   * Adopted buffers count towards the region's memory, and are given back
+   * when it is reset or released.
+   **/
+  void test_release()
+  {
+    CountingPool pool;
+    auto* r = new (RegionType::Arena) C1;
+    size_t base = region_memory_used(r);
+
+    adopt_new(r, pool);
+    adopt_new(r, pool);
+    check(region_memory_used(r) > base + (2 * BUFFER_SIZE));
+    check(pool.recycled == 0);
+
+    region_reset(r);
+    check(pool.recycled == 2);
+    check(region_memory_used(r) == base);
+
+    // The region can adopt again once reset.
+    auto buf = adopt_new(r, pool);
+    memset(buf, 1, BUFFER_SIZE);
+    region_release(r);
+    check(pool.recycled == 3);
+    check(pool.bytes == 3 * BUFFER_SIZE);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Merging keeps the buffers of both regions.
+   **/
+  void test_merge()
+  {
+    CountingPool pool;
+    auto* r1 = new (RegionType::Arena) C1;
+    auto* r2 = new (RegionType::Arena) C1;
+    auto* r3 = new (RegionType::Arena) C1;
+
+    adopt_new(r1, pool);
+    adopt_new(r2, pool);
+    adopt_new(r2, pool);
+
+    // Into a region without buffers, and then into one with them.
+    {
+      UsingRegion rr(r3);
+      r3->f1 = merge(r2);
+    }
+    {
+      UsingRegion rr(r1);
+      r1->f1 = merge(r3);
+    }
+    adopt_new(r1, pool);
+
+    region_release(r1);
+    check(pool.recycled == 4);
+    heap::debug_check_empty();
+  }
+
+  void run_test()
+  {
+    test_release();
+    test_merge();
+  }
+}
@@ -170,9 +170,92 @@ namespace memory_alloc
     }
   }
 
+  /**
+   * Allocates objects in an arena region with the smallest arenas, so that
+   * they are spread over many arenas, and medium objects get an arena each.
+   **/
+  void test_small_arenas()
+  {
+    auto* o = new (RegionType::Arena) C1;
+    RegionArena::set_arena_size(o, RegionArena::MIN_ARENA_SIZE);
+    {
+      UsingRegion rr(o);
+      for (size_t i = 0; i < 100; i++)
+      {
+        new C1;
+        new F1;
+      }
+      new MediumC2;
+      new MediumF2;
+      new C1;
+      new XLargeF2;
+    }
+    region_release(o);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
+  /**
+   * Allocates objects in an arena region whose arenas are in huge pages.
+   **/
+  void test_huge_page_arenas()
+  {
+    auto* o = ::new (RegionArena::create(
+      C1::desc(), hugepage::SIZE_2MIB, &RegionArena::huge_page_source)) C1;
+    {
+      UsingRegion rr(o);
+      for (size_t i = 0; i < 10; i++)
+      {
+        new MediumC2;
+        new F1;
+      }
+    }
+    region_release(o);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
+  /**
+   * Empties arena regions with `region_reset`, and refills them, with the
+   * iso object in each position that `create` may put it.
+   **/
+  template<class T>
+  void test_reset()
+  {
+    auto* o = new (RegionType::Arena) T;
+    int live = live_count;
+    for (size_t i = 0; i < 3; i++)
+    {
+      {
+        UsingRegion rr(o);
+        for (size_t j = 0; j < 10; j++)
+        {
+          new C1;
+          new F1;
+          new MediumF2;
+        }
+        new XLargeF2;
+      }
+
+      region_reset(o);
+      check(live_count == live);
+
+      UsingRegion rr(o);
+      check(debug_size() == 1);
+    }
+    region_release(o);
+    heap::debug_check_empty();
+    check(live_count == 0);
+  }
+
   void run_test()
   {
     test_alloc<RegionType::Trace>();
     test_alloc<RegionType::Arena>();
+    test_small_arenas();
+    test_huge_page_arenas();
+    test_reset<C1>();
+    test_reset<F1>();
+    test_reset<XLargeF2>();
   }
 }
\ No newline at end of file
@@ -0,0 +1,222 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+
+namespace memory_clone
+{
+  struct Big;
+
+  struct Node : public V<Node>
+  {
+    Node* left = nullptr;
+    Node* right = nullptr;
+    Node* imm = nullptr;
+    Big* big = nullptr;
+    size_t value = 0;
+
+    using fields = Fields<&Node::left, &Node::right, &Node::imm, &Node::big>;
+  };
+
+  /// Too large for an arena, so in the large object ring of arena regions.
+  struct Big : public V<Big>
+  {
+    size_t values[(1 << 20) / sizeof(size_t)];
+
+    static constexpr bool no_pointers = true;
+  };
+
+  /// Has a destructor, so cannot be copied.
+  struct Owner : public V<Owner>
+  {
+    Node* node = nullptr;
+
+    using fields = Fields<&Owner::node>;
+
+    ~Owner() {}
+  };
+
+  /// Give the region of `root` a reference to the immutable `imm`.
+  void hold(RegionType type, Node* root, Node* imm)
+  {
+    switch (type)
+    {
+      case RegionType::Trace:
+        RegionTrace::insert(root, imm);
+        break;
+      case RegionType::Arena:
+        RegionArena::insert(root, imm);
+        break;
+      case RegionType::Rc:
+        Immutable::acquire(imm);
+        break;
+    }
+  }
+
+  /**
+   * Copies a region holding a cycle, a pointer back to its entry point, and
+   * pointers to an immutable object, and checks that the copy has the same
+   * shape and values, and is independent of the original.
+   **/
+  void test_shape(RegionType type)
+  {
+    auto* imm = new (RegionType::Trace) Node;
+    imm->value = 42;
+    freeze(imm);
+
+    auto* root = new (type) Node;
+    {
+      UsingRegion rr(root);
+      auto* a = new Node;
+      auto* b = new Node;
+      root->value = 1;
+      a->value = 2;
+      b->value = 3;
+
+      root->left = a;
+      a->left = b;
+      b->left = a;
+      a->right = root;
+      a->imm = imm;
+      b->imm = imm;
+      if (type == RegionType::Rc)
+      {
+        incref(a);
+        incref(root);
+        // An rc region holds a reference for each pointer.
+        Immutable::acquire(imm);
+      }
+      hold(type, root, imm);
+    }
+
+    auto* copy = (Node*)region_clone(root);
+    check(copy != nullptr);
+    check(copy != root);
+    check(Region::get_type(copy->get_region()) == type);
+
+    {
+      UsingRegion rr(copy);
+      auto* a = copy->left;
+      auto* b = a->left;
+      check(a != root->left);
+      check(b != root->left->left);
+      check(copy->value == 1);
+      check(a->value == 2);
+      check(b->value == 3);
+      check(b->left == a);
+      check(a->right == copy);
+      check(a->imm == imm);
+      check(b->imm == imm);
+      check(debug_size() == 3);
+
+      if (type == RegionType::Rc)
+      {
+        check(debug_get_ref_count(a) == 2);
+        check(debug_get_ref_count(b) == 1);
+      }
+
+      a->value = 20;
+    }
+    check(root->left->value == 2);
+
+    region_release(copy);
+    region_release(root);
+    check(imm->debug_test_rc(1));
+    Immutable::release(imm);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Copies an arena region over many small arenas, with a large object and
+   * objects that are not reachable, which are copied too.
+   **/
+  void test_arenas()
+  {
+    static constexpr size_t COUNT = 1000;
+
+    auto* root = new (RegionType::Arena) Node;
+    RegionArena::set_arena_size(root, RegionArena::MIN_ARENA_SIZE);
+    {
+      UsingRegion rr(root);
+      Node* last = root;
+      for (size_t i = 1; i < COUNT; i++)
+      {
+        auto* n = new Node;
+        n->value = i;
+        last->left = n;
+        last = n;
+      }
+      root->big = new Big;
+      root->big->values[0] = COUNT;
+
+      new Node;
+    }
+
+    auto* copy = (Node*)region_clone(root);
+    check(copy != nullptr);
+    check(region_memory_used(copy) == region_memory_used(root));
+    {
+      UsingRegion rr(copy);
+      check(debug_size() == COUNT + 2);
+    }
+
+    size_t i = 0;
+    for (Node *p = root, *q = copy; p != nullptr; p = p->left, q = q->left)
+    {
+      check(q != p);
+      check(q->value == i++);
+    }
+    check(i == COUNT);
+    check(copy->big != root->big);
+    check(copy->big->values[0] == COUNT);
+
+    region_release(root);
+    region_release(copy);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * Regions holding objects that are not clonable, or other regions, are
+   * not copied.
+   **/
+  void test_refused(RegionType type)
+  {
+    auto* root = new (type) Node;
+    {
+      UsingRegion rr(root);
+      root->left = new Node;
+      root->left->right = (Node*)new (RegionType::Trace) Node;
+    }
+    check(region_clone(root) == nullptr);
+    {
+      UsingRegion rr(root);
+      Region::release(root->left->right);
+      root->left->right = nullptr;
+    }
+    auto* copy = region_clone(root);
+    check(copy != nullptr);
+    region_release(copy);
+    region_release(root);
+
+    auto* owner = new (type) Owner;
+    {
+      UsingRegion rr(owner);
+      owner->node = new Node;
+    }
+    check(region_clone(owner) == nullptr);
+    region_release(owner);
+
+    heap::debug_check_empty();
+  }
+
+  void run_test()
+  {
+    for (auto type : {RegionType::Trace, RegionType::Arena, RegionType::Rc})
+    {
+      test_shape(type);
+      test_refused(type);
+    }
+    test_arenas();
+  }
+} // namespace memory_clone
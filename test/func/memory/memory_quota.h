@@ -0,0 +1,111 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+
+namespace memory_quota
+{
+  /**
+   * The memory used by a region grows with the objects allocated in it, and
+   * shrinks as they are collected.
+   **/
+  template<RegionType region_type>
+  void test_accounting()
+  {
+    auto* r = new (region_type) C1;
+    size_t base = region_memory_used(r);
+    check(base == vsizeof<C1>);
+
+    {
+      UsingRegion rr(r);
+      r->f1 = new C1;
+      r->f1->f1 = new C1;
+    }
+    check(region_memory_used(r) == base + 2 * vsizeof<C1>);
+
+    if constexpr (region_type == RegionType::Trace)
+    {
+      {
+        UsingRegion rr(r);
+        r->f1 = nullptr;
+        region_collect();
+      }
+      check(region_memory_used(r) == base);
+    }
+
+    if constexpr (region_type == RegionType::Arena)
+    {
+      region_reset(r);
+      check(region_memory_used(r) == base);
+    }
+
+    region_release(r);
+    heap::debug_check_empty();
+  }
+
+  /**
+   * A trace region past its soft quota is collected when it is closed.
+   **/
+  void test_soft_quota()
+  {
+    auto* r = new (RegionType::Trace) C1;
+    size_t base = region_memory_used(r);
+    region_set_memory_quota(r, base * 4, SIZE_MAX);
+
+    {
+      UsingRegion rr(r);
+      for (int i = 0; i < 8; i++)
+        new C1;
+    }
+    check(region_memory_used(r) == base);
+    check(RegionTrace::get_stats(r).collections == 1);
+
+    region_release(r);
+    heap::debug_check_empty();
+  }
+
+  static size_t quota_exceeded = 0;
+
+  /**
+   * An allocation past the hard quota calls the handler.
+   **/
+  template<RegionType region_type>
+  void test_hard_quota()
+  {
+    quota_exceeded = 0;
+    RegionBase::set_quota_handler([](RegionBase*, size_t used, size_t quota) {
+      check(used > quota);
+      quota_exceeded++;
+    });
+
+    auto* r = new (region_type) C1;
+    size_t base = region_memory_used(r);
+    region_set_memory_quota(r, base * 2, base * 2);
+
+    {
+      UsingRegion rr(r);
+      r->f1 = new C1;
+      check(quota_exceeded == 0);
+      r->f1->f1 = new C1;
+      check(quota_exceeded == 1);
+    }
+
+    RegionBase::set_quota_handler(nullptr);
+    region_release(r);
+    heap::debug_check_empty();
+  }
+
+  void run_test()
+  {
+    test_accounting<RegionType::Trace>();
+    test_accounting<RegionType::Arena>();
+    test_accounting<RegionType::Rc>();
+
+    test_soft_quota();
+
+    test_hard_quota<RegionType::Trace>();
+    test_hard_quota<RegionType::Arena>();
+    test_hard_quota<RegionType::Rc>();
+  }
+}
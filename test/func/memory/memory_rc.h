@@ -294,9 +294,79 @@ namespace memory_rc
     heap::debug_check_empty();
   }
 
+  /**
+   * Candidates are buffered until the cycles are collected, including those
+   * that die while they are buffered.
+   **/
+  void test_batched_cycles()
+  {
+    {
+      auto* o = new (RegionType::Rc) C;
+      {
+        UsingRegion rc(o);
+
+        // cycle: (o1 -> o2 -> o3 -> o1), with every object buffered.
+        auto* o1 = new C;
+        auto* o2 = new C;
+        auto* o3 = new C;
+        o1->f1 = o2;
+        o2->f1 = o3;
+        o3->f1 = o1;
+        push_lins_stack(o1);
+        push_lins_stack(o2);
+        push_lins_stack(o3);
+
+        // o4 is freed while it is buffered.
+        auto* o4 = new C;
+        push_lins_stack(o4);
+        decref(o4);
+
+        check(debug_size() == 5);
+        region_collect();
+        check(debug_size() == 1);
+      }
+      region_release(o);
+      heap::debug_check_empty();
+    }
+
+    // Closing the region collects the cycles once enough are buffered.
+    {
+      RegionRc::set_cycle_threshold(2);
+      auto* o = new (RegionType::Rc) C;
+      {
+        UsingRegion rc(o);
+
+        // cycle: (o1 -> o2 -> o1)
+        auto* o1 = new C;
+        auto* o2 = new C;
+        o1->f1 = o2;
+        o2->f1 = o1;
+        push_lins_stack(o1);
+
+        check(debug_size() == 3);
+      }
+      {
+        UsingRegion rc(o);
+        check(debug_size() == 3);
+
+        auto* o3 = new C;
+        o->f1 = o3;
+        push_lins_stack(o3);
+      }
+      {
+        UsingRegion rc(o);
+        check(debug_size() == 2);
+      }
+      region_release(o);
+      heap::debug_check_empty();
+      RegionRc::set_cycle_threshold(RegionRc::CYCLE_THRESHOLD);
+    }
+  }
+
   void run_test()
   {
     test_basic();
     test_cycles();
+    test_batched_cycles();
   }
 }
@@ -0,0 +1,99 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks the response to `Scheduler::memory_pressure`: handlers see each
+ * level, `when_bounded` admits fewer behaviours as the pressure rises, and
+ * the scheduler threads give back memory while behaviours that free
+ * immutable objects through the epoch keep running.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <pal/memorylimit.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t LIMIT = 16;
+
+static size_t admitted(PressureLevel level)
+{
+  Scheduler::memory_pressure(level);
+
+  auto c = make_cown<size_t>(0);
+  size_t count = 0;
+  for (size_t i = 0; i < LIMIT * 2; i++)
+  {
+    auto ok = when_bounded(LIMIT, Overload::Reject, c) <<
+      [](acquired_cown<size_t>) {};
+    if (ok)
+      count++;
+  }
+  return count;
+}
+
+void test_admission()
+{
+  check(admitted(PressureLevel::None) == LIMIT);
+  check(admitted(PressureLevel::Moderate) == LIMIT / 2);
+  check(admitted(PressureLevel::Critical) == LIMIT / 8);
+  Scheduler::memory_pressure(PressureLevel::None);
+}
+
+struct C : public V<C>
+{};
+
+static constexpr size_t ROUNDS = 100;
+
+void test_release()
+{
+  auto c = make_cown<size_t>(0);
+  for (size_t i = 0; i < ROUNDS; i++)
+  {
+    when(c) << [i](acquired_cown<size_t> n) {
+      // Delayed frees for the epoch to hold back.
+      auto o = new (RegionType::Trace) C;
+      freeze(o);
+      Epoch e;
+      e.dec_in_epoch(o);
+
+      if (i == ROUNDS / 4)
+        Scheduler::memory_pressure(PressureLevel::Critical);
+      else if (i == ROUNDS / 2)
+        Scheduler::memory_pressure(PressureLevel::Moderate);
+      else if (i == ROUNDS - 1)
+        Scheduler::memory_pressure(PressureLevel::None);
+      (*n)++;
+    };
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  std::vector<PressureLevel> seen;
+  auto id = MemoryPressure::add_handler(
+    [&seen](PressureLevel l) { seen.push_back(l); });
+  Scheduler::memory_pressure(PressureLevel::Moderate);
+  Scheduler::memory_pressure(PressureLevel::None);
+  MemoryPressure::remove_handler(id);
+  Scheduler::memory_pressure(PressureLevel::Critical);
+  Scheduler::memory_pressure(PressureLevel::None);
+  check(seen.size() == 2);
+  check(seen[0] == PressureLevel::Moderate);
+  check(seen[1] == PressureLevel::None);
+
+  check(MemoryPressure::level_for(10, 100) == PressureLevel::None);
+  check(MemoryPressure::level_for(85, 100) == PressureLevel::Moderate);
+  check(MemoryPressure::level_for(99, 100) == PressureLevel::Critical);
+
+  // Only checks that the cgroup files, if there are any, can be read.
+  auto usage = memorylimit::cgroup_usage();
+  if (usage)
+    check(usage->limit > 0);
+
+  harness.run(test_admission);
+  harness.run(test_release);
+
+  return 0;
+}
@@ -2,7 +2,12 @@
 // SPDX-License-Identifier: MIT
 
 #include "./noticeboard_basic.h"
+#include "./noticeboard_hazard.h"
+#include "./noticeboard_multi.h"
 #include "./noticeboard_primitive_weak.h"
+#include "./noticeboard_replicated.h"
+#include "./noticeboard_seqlock.h"
+#include "./noticeboard_version.h"
 #include "./noticeboard_weak.h"
 
 #include <debug/harness.h>
@@ -13,5 +18,13 @@ int main(int argc, char** argv)
   harness.run(noticeboard_basic::run_test);
   harness.run(noticeboard_weak::run_test);
   harness.run(noticeboard_primitive_weak::run_test);
+  harness.run(noticeboard_replicated::run_test);
+  harness.run(noticeboard_seqlock::run_test);
+  harness.run(noticeboard_version::run_test);
+  harness.run(noticeboard_hazard::run_test);
+
+  Scheduler::set_batch_epoch(true);
+  harness.run(noticeboard_multi::run_test);
+  Scheduler::set_batch_epoch(false);
   return 0;
 }
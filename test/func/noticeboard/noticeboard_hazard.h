@@ -0,0 +1,102 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This test peeks a noticeboard protected by hazard pointers while it is
+ * updated often enough for the retired values to be scanned several times.
+ * Some peekers also hold an epoch while they peek, which must not stop the
+ * values they do not hold from being reclaimed.
+ */
+
+#include <debug/harness.h>
+
+namespace noticeboard_hazard
+{
+  struct C : public V<C>
+  {
+  public:
+    int x = 0;
+
+    C(int x_) : x(x_) {}
+  };
+
+  C* make(int x)
+  {
+    C* c = new (RegionType::Trace) C(x);
+    freeze(c);
+    return c;
+  }
+
+  struct DB : public VCown<DB>
+  {
+  public:
+    Noticeboard<Object*, Hazard> box;
+    int n = 0;
+
+    DB() : box{make(0)}
+    {
+#ifdef USE_SYSTEMATIC_TESTING_WEAK_NOTICEBOARDS
+      register_noticeboard(&box);
+#endif
+    }
+
+    void trace(ObjectStack& fields) const
+    {
+      box.trace(fields);
+    }
+  };
+
+  struct Peeker : public VCown<Peeker>
+  {
+  public:
+    DB* db;
+    int last = 0;
+
+    Peeker(DB* db_) : db(db_) {}
+
+    void trace(ObjectStack& fields) const
+    {
+      fields.push(db);
+    }
+  };
+
+  static constexpr int UPDATES = 200;
+  static constexpr int PEEKERS = 4;
+  static constexpr int PEEKS = 20;
+
+  void run_test()
+  {
+    DB* db = new DB;
+
+    for (int i = 0; i < UPDATES; i++)
+    {
+      schedule_lambda(db, [db]() { db->box.update(make(++db->n)); });
+    }
+
+#ifdef USE_SYSTEMATIC_TESTING_WEAK_NOTICEBOARDS
+    schedule_lambda(db, [db]() { db->flush_all(); });
+#endif
+
+    for (int p = 0; p < PEEKERS; p++)
+    {
+      Cown::acquire(db);
+      auto peeker = new Peeker(db);
+      for (int i = 0; i < PEEKS; i++)
+      {
+        schedule_lambda(peeker, [peeker, p]() {
+          std::optional<Epoch> e;
+          if ((p & 1) != 0)
+            e.emplace();
+
+          auto o = (C*)peeker->db->box.peek();
+          check(o->x >= peeker->last);
+          peeker->last = o->x;
+          Immutable::release(o);
+        });
+      }
+      Cown::release(peeker);
+    }
+
+    Cown::release(db);
+  }
+}
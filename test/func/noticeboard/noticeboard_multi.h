@@ -0,0 +1,115 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This test peeks two noticeboards, one plain and one replicated, under a
+ * single epoch while both are updated.  It is run with scheduler threads
+ * holding an epoch for each batch, so the epochs entered by peeks and
+ * updates are nested in it.  Neither value seen by a peeker may go
+ * backwards.
+ */
+
+#include <debug/harness.h>
+
+namespace noticeboard_multi
+{
+  struct C : public V<C>
+  {
+  public:
+    int x = 0;
+
+    C(int x_) : x(x_) {}
+  };
+
+  C* make(int x)
+  {
+    C* c = new (RegionType::Trace) C(x);
+    freeze(c);
+    return c;
+  }
+
+  struct DB : public VCown<DB>
+  {
+  public:
+    Noticeboard<Object*> plain;
+    ReplicatedNoticeboard<Object*> replicated;
+    int n = 0;
+
+    DB() : plain{make(0)}, replicated{make(0)}
+    {
+#ifdef USE_SYSTEMATIC_TESTING_WEAK_NOTICEBOARDS
+      register_noticeboard(&plain);
+#endif
+    }
+
+    void trace(ObjectStack& fields) const
+    {
+      plain.trace(fields);
+      replicated.trace(fields);
+    }
+  };
+
+  struct Peeker : public VCown<Peeker>
+  {
+  public:
+    DB* db;
+    int last_plain = 0;
+    int last_replicated = 0;
+
+    Peeker(DB* db_) : db(db_) {}
+
+    void trace(ObjectStack& fields) const
+    {
+      fields.push(db);
+    }
+  };
+
+  static constexpr int UPDATES = 10;
+  static constexpr int PEEKERS = 4;
+  static constexpr int PEEKS = 10;
+
+  void run_test()
+  {
+    DB* db = new DB;
+
+    for (int i = 0; i < UPDATES; i++)
+    {
+      schedule_lambda(db, [db]() {
+        ++db->n;
+        db->plain.update(make(db->n));
+        db->replicated.update(make(db->n));
+      });
+    }
+
+#ifdef USE_SYSTEMATIC_TESTING_WEAK_NOTICEBOARDS
+    schedule_lambda(db, [db]() { db->flush_all(); });
+#endif
+
+    for (int p = 0; p < PEEKERS; p++)
+    {
+      Cown::acquire(db);
+      auto peeker = new Peeker(db);
+      for (int i = 0; i < PEEKS; i++)
+      {
+        schedule_lambda(peeker, [peeker]() {
+          C* a;
+          C* b;
+          {
+            Epoch e;
+            a = (C*)peeker->db->plain.peek(e);
+            b = (C*)peeker->db->replicated.peek(e);
+          }
+          check(a->x >= peeker->last_plain);
+          check(b->x >= peeker->last_replicated);
+          peeker->last_plain = a->x;
+          peeker->last_replicated = b->x;
+          Immutable::release(a);
+          Immutable::release(b);
+        });
+      }
+      Cown::release(peeker);
+    }
+
+    Cown::release(db);
+  }
+}
@@ -0,0 +1,90 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This test peeks a replicated noticeboard from several cowns, so that
+ * replicas on different cores are refreshed, while the value is updated.
+ * Each peek must see a value at least as new as the last one this peeker
+ * saw, and no snapshot may be freed while a replica or peeker still holds
+ * it.
+ */
+
+#include <debug/harness.h>
+
+namespace noticeboard_replicated
+{
+  struct C : public V<C>
+  {
+  public:
+    int x = 0;
+
+    C(int x_) : x(x_) {}
+  };
+
+  struct DB : public VCown<DB>
+  {
+  public:
+    ReplicatedNoticeboard<Object*> box;
+    int n = 0;
+
+    DB(Object* c) : box{c} {}
+
+    void trace(ObjectStack& fields) const
+    {
+      box.trace(fields);
+    }
+  };
+
+  struct Peeker : public VCown<Peeker>
+  {
+  public:
+    DB* db;
+    int last = 0;
+
+    Peeker(DB* db_) : db(db_) {}
+
+    void trace(ObjectStack& fields) const
+    {
+      fields.push(db);
+    }
+  };
+
+  static constexpr int UPDATES = 10;
+  static constexpr int PEEKERS = 4;
+  static constexpr int PEEKS = 10;
+
+  void run_test()
+  {
+    C* c = new (RegionType::Trace) C(0);
+    freeze(c);
+
+    DB* db = new DB(c);
+
+    for (int i = 0; i < UPDATES; i++)
+    {
+      schedule_lambda(db, [db]() {
+        C* new_c = new (RegionType::Trace) C(++db->n);
+        freeze(new_c);
+        db->box.update(new_c);
+      });
+    }
+
+    for (int p = 0; p < PEEKERS; p++)
+    {
+      Cown::acquire(db);
+      auto peeker = new Peeker(db);
+      for (int i = 0; i < PEEKS; i++)
+      {
+        schedule_lambda(peeker, [peeker]() {
+          auto o = (C*)peeker->db->box.peek();
+          check(o->x >= peeker->last);
+          peeker->last = o->x;
+          Immutable::release(o);
+        });
+      }
+      Cown::release(peeker);
+    }
+
+    Cown::release(db);
+  }
+}
@@ -0,0 +1,82 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This test peeks a seqlock noticeboard holding a struct from several cowns
+ * while the struct is updated.  Every field of an update has the same
+ * value, so a peek that saw part of one update and part of another would
+ * find them different.  Each peek must also see a value at least as new as
+ * the last one this peeker saw.
+ */
+
+#include <debug/harness.h>
+
+namespace noticeboard_seqlock
+{
+  struct Config
+  {
+    uint64_t fields[6];
+  };
+
+  static Config make_config(uint64_t n)
+  {
+    Config c;
+    for (auto& f : c.fields)
+      f = n;
+    return c;
+  }
+
+  struct DB : public VCown<DB>
+  {
+  public:
+    SeqlockNoticeboard<Config> box{make_config(0)};
+    uint64_t n = 0;
+  };
+
+  struct Peeker : public VCown<Peeker>
+  {
+  public:
+    DB* db;
+    uint64_t last = 0;
+
+    Peeker(DB* db_) : db(db_) {}
+
+    void trace(ObjectStack& fields) const
+    {
+      fields.push(db);
+    }
+  };
+
+  static constexpr int UPDATES = 10;
+  static constexpr int PEEKERS = 4;
+  static constexpr int PEEKS = 10;
+
+  void run_test()
+  {
+    DB* db = new DB;
+
+    for (int i = 0; i < UPDATES; i++)
+    {
+      schedule_lambda(db, [db]() { db->box.update(make_config(++db->n)); });
+    }
+
+    for (int p = 0; p < PEEKERS; p++)
+    {
+      Cown::acquire(db);
+      auto peeker = new Peeker(db);
+      for (int i = 0; i < PEEKS; i++)
+      {
+        schedule_lambda(peeker, [peeker]() {
+          auto c = peeker->db->box.peek();
+          for (auto f : c.fields)
+            check(f == c.fields[0]);
+          check(c.fields[0] >= peeker->last);
+          peeker->last = c.fields[0];
+        });
+      }
+      Cown::release(peeker);
+    }
+
+    Cown::release(db);
+  }
+}
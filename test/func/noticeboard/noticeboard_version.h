@@ -0,0 +1,79 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This test updates a noticeboard that notifies a reader on each update.
+ * The version must count the updates, and the reader must run after the
+ * last update, and see its value, however the notifications coalesce.
+ */
+
+#include <debug/harness.h>
+
+namespace noticeboard_version
+{
+  static constexpr int UPDATES = 20;
+
+  struct DB : public VCown<DB>
+  {
+  public:
+    Noticeboard<int> box{0};
+    int n = 0;
+
+#ifdef USE_SYSTEMATIC_TESTING_WEAK_NOTICEBOARDS
+    DB()
+    {
+      register_noticeboard(&box);
+    }
+#endif
+  };
+
+  struct Reader : public VCown<Reader>
+  {
+  public:
+    uint64_t seen = 0;
+    int value = 0;
+
+    ~Reader()
+    {
+      check(seen == UPDATES);
+      check(value == UPDATES);
+    }
+  };
+
+  void run_test()
+  {
+    DB* db = new DB;
+    Reader* reader = new Reader;
+    check(db->box.version() == 0);
+
+    Request requests[] = {Request::write(reader), Request::read(db)};
+    auto n = make_notification(2, requests, [db, reader]() {
+      auto v = db->box.version();
+      if (v == reader->seen)
+        return;
+      check(v > reader->seen);
+      reader->seen = v;
+      reader->value = db->box.peek();
+    });
+
+    schedule_lambda(db, [db, n]() {
+      db->box.set_notification(n);
+      Shared::release(n);
+    });
+
+    for (int i = 0; i < UPDATES; i++)
+      schedule_lambda(db, [db]() { db->box.update(++db->n); });
+
+    // The notification holds the noticeboard's cown, so it must be removed
+    // for either to be collected.
+    schedule_lambda(db, [db]() {
+#ifdef USE_SYSTEMATIC_TESTING_WEAK_NOTICEBOARDS
+      db->flush_all();
+#endif
+      db->box.set_notification(nullptr);
+    });
+
+    Cown::release(db);
+    Cown::release(reader);
+  }
+}
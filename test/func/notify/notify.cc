@@ -1,10 +1,13 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
+#include <cpp/when.h>
 #include <debug/harness.h>
 // Harness must come before tests.
 #include "./notify_alternate.h"
 #include "./notify_basic.h"
 #include "./notify_interleave.h"
+#include "./notify_multi.h"
+#include "./notify_recurring.h"
 
 int main(int argc, char** argv)
 {
@@ -20,6 +23,10 @@ int main(int argc, char** argv)
 
   harness.run(notify_empty_queue::run_test);
 
+  harness.run(notify_multi::run_test);
+  harness.run(notify_multi::request_test);
+  harness.run(notify_recurring::run_test);
+
   // TODO: Notify coalesce is broken. We need to correctly design this
   // feature for the behaviour centric scheduling.
   // // Here we ensure single-core so that we can check the number of times
@@ -0,0 +1,94 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+namespace notify_multi
+{
+  using namespace verona::cpp;
+
+  struct Counter
+  {
+    size_t count = 0;
+  };
+
+  struct Flush
+  {
+    size_t runs = 0;
+    size_t flushed = 0;
+
+    ~Flush()
+    {
+      check(runs >= 1);
+      check(flushed == 30);
+    }
+  };
+
+  /**
+   * Checks notifications on several cowns in mixed modes.  The notification
+   * runs exclusively with the writer behaviours on its cowns, and runs at
+   * least once after the last notify.
+   */
+  void run_test()
+  {
+    auto source1 = make_cown<Counter>();
+    auto source2 = make_cown<Counter>();
+    auto sink = make_cown<Flush>();
+
+    auto n = make_notification(
+      [](
+        acquired_cown<const Counter> s1,
+        acquired_cown<const Counter> s2,
+        acquired_cown<Flush> f) {
+        f->runs++;
+        f->flushed = s1->count + s2->count;
+      },
+      read(source1),
+      read(source2),
+      sink);
+
+    for (size_t i = 0; i < 10; i++)
+    {
+      when(source1, source2)
+        << [n](acquired_cown<Counter> s1, acquired_cown<Counter> s2) mutable {
+             s1->count++;
+             s2->count += 2;
+             n.notify();
+           };
+    }
+
+    when(source1, source2, sink)
+      << [](
+           acquired_cown<Counter> s1,
+           acquired_cown<Counter> s2,
+           acquired_cown<Flush> f) {
+           check(s1->count == 10);
+           check(s2->count == 20);
+           check(f->runs <= 10);
+         };
+  }
+
+  struct A : public VCown<A>
+  {
+    size_t value = 0;
+  };
+
+  /**
+   * Checks the runtime interface with an array of requests.
+   */
+  void request_test()
+  {
+    auto a = new A;
+    auto b = new A;
+    Request requests[] = {Request::read(a), Request::write(b)};
+
+    auto n = make_notification(2, requests, [a, b]() { b->value = a->value; });
+    n->notify();
+
+    schedule_lambda(a, [a]() { a->value = 1; });
+    n->notify();
+
+    schedule_lambda(b, [b]() { check(b->value <= 1); });
+
+    Cown::release(a);
+    Cown::release(b);
+    Shared::release(n);
+  }
+}
@@ -0,0 +1,49 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+namespace notify_recurring
+{
+  using namespace verona::cpp;
+
+  struct Source
+  {
+    size_t count = 0;
+  };
+
+  struct Ticks
+  {
+    size_t runs = 0;
+    size_t seen = 0;
+
+    ~Ticks()
+    {
+      check(runs >= 1);
+      check(runs <= 10);
+      check(seen == 10);
+    }
+  };
+
+  /**
+   * Checks `recurring_when`: firings that overlap are coalesced, so the
+   * behaviour runs at most once for each firing, and at least once after
+   * the last.
+   */
+  void run_test()
+  {
+    auto source = make_cown<Source>();
+    auto ticks = make_cown<Ticks>();
+
+    auto tick = recurring_when(read(source), ticks) <<
+      [](acquired_cown<const Source> s, acquired_cown<Ticks> t) {
+        t->runs++;
+        t->seen = s->count;
+      };
+
+    for (size_t i = 0; i < 10; i++)
+    {
+      when(source) << [tick](acquired_cown<Source> s) mutable {
+        s->count++;
+        tick.fire();
+      };
+    }
+  }
+}
@@ -0,0 +1,113 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+static std::atomic<size_t> live_count;
+
+struct C : public V<C>
+{
+  C* f1 = nullptr;
+  C* f2 = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (f1 != nullptr)
+      st.push(f1);
+
+    if (f2 != nullptr)
+      st.push(f2);
+  }
+};
+
+struct F : public V<F>
+{
+  F()
+  {
+    live_count++;
+  }
+
+  ~F()
+  {
+    live_count--;
+  }
+};
+
+/// Builds a list of `n` objects, and `n` garbage objects besides it.
+C* build_list(size_t n)
+{
+  C* head = nullptr;
+  for (size_t i = 0; i < n; i++)
+  {
+    auto c = new C;
+    c->f1 = head;
+    head = c;
+    new C;
+  }
+  return head;
+}
+
+void test_nursery()
+{
+  auto* o = new (RegionType::Trace) C;
+  RegionTrace::set_nursery(o, true);
+  {
+    UsingRegion rr(o);
+
+    // Young garbage is collected, and the survivors are promoted.
+    o->f1 = build_list(10);
+    new F;
+    check(debug_size() == 1 + 20 + 1);
+    region_collect_young();
+    check(debug_size() == 1 + 10);
+    check(live_count == 0);
+
+    // A young object only reachable from an old one survives, through the
+    // barrier.
+    C* old = o->f1->f1;
+    old->f2 = new C;
+    region_write_barrier(old, old->f2);
+    new C;
+    region_collect_young();
+    check(debug_size() == 1 + 10 + 1);
+
+    // Old objects are not collected by a minor collection.
+    old->f2 = nullptr;
+    o->f1 = nullptr;
+    region_collect_young();
+    check(debug_size() == 1 + 10 + 1);
+    region_collect();
+    check(debug_size() == 1);
+
+    // Additional roots keep young objects alive.
+    auto f = new F;
+    RegionTrace::push_additional_root(o, f);
+    region_collect_young();
+    check(live_count == 1);
+    RegionTrace::pop_additional_root(o, f);
+    region_collect_young();
+    check(live_count == 1);
+    region_collect();
+    check(live_count == 0);
+
+    // Young objects are released with the region.
+    o->f1 = build_list(5);
+    new F;
+  }
+
+  region_release(o);
+  check(live_count == 0);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_nursery);
+
+  return 0;
+}
@@ -0,0 +1,88 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `when_optimistic`.  Writers keep two fields of a cown equal, and
+ * readers that race with them must only ever consume a consistent result.
+ * A read issued after a write observes that write.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+struct Pair
+{
+  // Atomic only so that a value torn by a racing writer is well defined.
+  std::atomic<size_t> first{0};
+  std::atomic<size_t> second{0};
+};
+
+template<>
+struct verona::cpp::optimistic_reads<Pair> : std::true_type
+{};
+
+struct Results
+{
+  size_t consumed = 0;
+  size_t expected;
+
+  Results(size_t expected_) : expected(expected_) {}
+
+  ~Results()
+  {
+    check(consumed == expected);
+  }
+};
+
+static constexpr size_t ROUNDS = 20;
+
+void test_optimistic()
+{
+  auto pair = make_cown<Pair>();
+  auto results = make_cown<Results>(ROUNDS);
+
+  for (size_t i = 0; i < ROUNDS; i++)
+  {
+    when(pair) << [](acquired_cown<Pair> p) {
+      p->first++;
+      yield();
+      p->second++;
+    };
+
+    // Issued after the write, so must see it.
+    when_optimistic(
+      pair,
+      [](const Pair& p) {
+        return std::make_pair(p.first.load(), p.second.load());
+      },
+      [results, i](std::pair<size_t, size_t> r) {
+        check(r.first == r.second);
+        check(r.first > i);
+        when(results) << [](acquired_cown<Results> rs) { rs->consumed++; };
+      });
+  }
+}
+
+void test_idle()
+{
+  auto pair = make_cown<Pair>();
+
+  // Nothing is queued on the cown, so the read has no reason to fail.
+  bool ran = false;
+  check(pair.try_read_optimistic([&](const Pair& p) {
+    ran = true;
+    check(p.first == 0);
+  }));
+  check(ran);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_optimistic);
+  harness.run(test_idle);
+
+  return 0;
+}
@@ -0,0 +1,124 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `parallel_for`, `parallel_reduce` and `parallel_sort`, with fixed
+ * and default grain sizes, on empty ranges, and called from a behaviour.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <random>
+
+using namespace verona::cpp;
+
+static constexpr size_t SIZE = 10000;
+
+static std::vector<size_t> data;
+static std::atomic<size_t> done = 0;
+
+struct Result
+{
+  size_t sum = 0;
+};
+
+void test_for(size_t grain)
+{
+  data.assign(SIZE, 0);
+  parallel_for(
+    0,
+    SIZE,
+    grain,
+    [](size_t lo, size_t hi) {
+      check(lo < hi);
+      for (size_t i = lo; i < hi; i++)
+        data[i]++;
+    },
+    []() {
+      for (auto d : data)
+        check(d == 1);
+      done++;
+    });
+}
+
+void test_reduce(size_t grain)
+{
+  auto result = make_cown<Result>();
+
+  // Started from a behaviour, which does not wait for it.
+  when(result) << [grain, result](acquired_cown<Result>) {
+    parallel_reduce(
+      0,
+      SIZE,
+      grain,
+      size_t(0),
+      [](size_t lo, size_t hi) {
+        size_t s = 0;
+        for (size_t i = lo; i < hi; i++)
+          s += i;
+        return s;
+      },
+      [](size_t a, size_t b) { return a + b; },
+      [result](size_t s) {
+        when(result) << [s](acquired_cown<Result> r) {
+          r->sum = s;
+          check(r->sum == SIZE * (SIZE - 1) / 2);
+          done++;
+        };
+      });
+  };
+}
+
+void test_sort(size_t grain)
+{
+  data.resize(SIZE);
+  std::minstd_rand rand(static_cast<unsigned>(grain + 1));
+  for (auto& d : data)
+    d = rand() % 1000;
+
+  parallel_sort(
+    data.begin(), data.end(), grain, std::greater<>(), []() {
+      check(std::is_sorted(data.begin(), data.end(), std::greater<>()));
+      done++;
+    });
+}
+
+void test_empty()
+{
+  parallel_for(5, 5, 0, [](size_t, size_t) { check(false); }, []() {
+    done++;
+  });
+  parallel_reduce(
+    5,
+    5,
+    0,
+    size_t(7),
+    [](size_t, size_t) {
+      check(false);
+      return size_t(0);
+    },
+    [](size_t a, size_t b) { return a + b; },
+    [](size_t s) {
+      check(s == 7);
+      done++;
+    });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  for (size_t grain : {size_t(0), size_t(1), size_t(100), SIZE})
+  {
+    done = 0;
+    harness.run(test_for, grain);
+    harness.run(test_reduce, grain);
+    harness.run(test_sort, grain);
+    check(done == 3);
+  }
+
+  done = 0;
+  harness.run(test_empty);
+  check(done == 2);
+
+  return 0;
+}
@@ -0,0 +1,100 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+static std::atomic<size_t> live_count;
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+  Node* prev = nullptr;
+  Node* sub = nullptr;
+
+  Node()
+  {
+    live_count++;
+  }
+
+  ~Node()
+  {
+    live_count--;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+
+    if (prev != nullptr)
+      st.push(prev);
+
+    if (sub != nullptr)
+      st.push(sub);
+  }
+};
+
+static constexpr size_t REGIONS = 8;
+static constexpr size_t LENGTH = 20;
+
+/// A region holding a doubly linked list, whose nodes own `depth` levels of
+/// subregions.
+Node* make_region(size_t depth)
+{
+  auto root = new (RegionType::Trace) Node;
+  {
+    UsingRegion rr(root);
+    Node* curr = root;
+    for (size_t i = 0; i < LENGTH; i++)
+    {
+      auto n = new Node;
+      n->prev = curr;
+      curr->next = n;
+      curr = n;
+
+      // Garbage, which the freeze deallocates.
+      new Node;
+    }
+  }
+
+  if (depth > 0)
+  {
+    Node* curr = root;
+    for (size_t i = 0; i < REGIONS; i++)
+    {
+      curr->sub = make_region(depth - 1);
+      curr = curr->next;
+    }
+  }
+  return root;
+}
+
+void test_parallel_freeze()
+{
+  schedule_lambda([]() {
+    auto root = make_region(2);
+    size_t regions = 1 + REGIONS + REGIONS * REGIONS;
+    check(live_count == regions * (1 + 2 * LENGTH));
+
+    ParallelFreeze::apply(root, 3);
+    check(root->debug_is_immutable());
+    check(live_count == regions * (1 + LENGTH));
+
+    // Every region is reachable from the root, so this frees them all.
+    Immutable::release(root);
+    check(live_count == 0);
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_parallel_freeze);
+
+  return 0;
+}
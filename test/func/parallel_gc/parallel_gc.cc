@@ -0,0 +1,109 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+static std::atomic<size_t> live_count;
+
+/// A non-trivial leaf, so both rings are swept.
+struct Leaf : public V<Leaf>
+{
+  Leaf()
+  {
+    live_count++;
+  }
+
+  ~Leaf()
+  {
+    live_count--;
+  }
+};
+
+/// Large enough that a few thousand nodes pass `ParallelGC::MIN_MEMORY`.
+struct Node : public V<Node>
+{
+  Node* left = nullptr;
+  Node* right = nullptr;
+  Leaf* leaf = nullptr;
+  uint8_t data[512];
+
+  void trace(ObjectStack& st) const
+  {
+    if (left != nullptr)
+      st.push(left);
+
+    if (right != nullptr)
+      st.push(right);
+
+    if (leaf != nullptr)
+      st.push(leaf);
+  }
+};
+
+static constexpr size_t DEPTH = 12;
+
+/// Builds a complete tree below `n`, with a garbage node for each node.
+Node* build(size_t depth)
+{
+  auto n = new Node;
+  new Node;
+  if (depth > 0)
+  {
+    n->left = build(depth - 1);
+    n->right = build(depth - 1);
+  }
+  else
+  {
+    n->leaf = new Leaf;
+    new Leaf;
+  }
+  return n;
+}
+
+void test_parallel_gc()
+{
+  schedule_lambda([]() {
+    auto o = new (RegionType::Trace) Node;
+    size_t before;
+    {
+      UsingRegion rr(o);
+      o->left = build(DEPTH);
+      o->right = build(DEPTH);
+      before = debug_size();
+    }
+
+    ParallelGC::gc(o, 3);
+
+    // Each tree has 2^(DEPTH+1) - 1 nodes and 2^DEPTH leaves, and everything
+    // else is garbage.
+    size_t tree = (size_t{1} << (DEPTH + 1)) - 1 + (size_t{1} << DEPTH);
+    {
+      UsingRegion rr(o);
+      check(before == 1 + 4 * tree);
+      check(debug_size() == 1 + 2 * tree);
+      check(live_count == 2 * (size_t{1} << DEPTH));
+
+      // Drop one tree, the sequential collection must agree.
+      o->right = nullptr;
+      region_collect();
+      check(debug_size() == 1 + tree);
+      check(live_count == (size_t{1} << DEPTH));
+    }
+
+    region_release(o);
+    check(live_count == 0);
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_parallel_gc);
+
+  return 0;
+}
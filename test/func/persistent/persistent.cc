@@ -0,0 +1,131 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `persistent_map` and `persistent_vector`: every version keeps its
+ * contents after later updates, keys with equal hashes are chained, and all
+ * nodes are freed once the last version is dropped.
+ */
+#include <cpp/persistent.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t COUNT = 1000;
+
+static std::atomic<int64_t> live = 0;
+
+/// A value that counts its live copies.
+struct Tracked
+{
+  size_t v = 0;
+
+  Tracked()
+  {
+    live++;
+  }
+
+  Tracked(size_t v_) : v(v_)
+  {
+    live++;
+  }
+
+  Tracked(const Tracked& other) : v(other.v)
+  {
+    live++;
+  }
+
+  Tracked& operator=(const Tracked&) = default;
+
+  ~Tracked()
+  {
+    live--;
+  }
+};
+
+/// Puts every key in one of four chains.
+struct BadHash
+{
+  size_t operator()(size_t k) const
+  {
+    return k % 4;
+  }
+};
+
+template<typename Hash>
+void test_map()
+{
+  persistent_map<size_t, Tracked, Hash> m;
+  std::vector<persistent_map<size_t, Tracked, Hash>> versions;
+
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    m = m.set(i, Tracked(i));
+    if (i % 100 == 0)
+      versions.push_back(m);
+  }
+  check(m.size() == COUNT);
+
+  // Overwrite and erase the even keys.
+  auto updated = m;
+  for (size_t i = 0; i < COUNT; i += 2)
+    updated = updated.set(i, Tracked(i + 1));
+  auto erased = updated;
+  for (size_t i = 0; i < COUNT; i += 2)
+    erased = erased.erase(i);
+  check(erased.erase(0).size() == COUNT / 2);
+
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    check(m.find(i)->v == i);
+    check(updated.find(i)->v == ((i % 2 == 0) ? i + 1 : i));
+    check(erased.contains(i) == (i % 2 == 1));
+  }
+  check(!m.contains(COUNT));
+  check(erased.size() == COUNT / 2);
+
+  for (size_t n = 0; n < versions.size(); n++)
+  {
+    check(versions[n].size() == n * 100 + 1);
+    check(versions[n].find(n * 100)->v == n * 100);
+    check(!versions[n].contains(n * 100 + 1));
+  }
+}
+
+void test_vector()
+{
+  persistent_vector<Tracked> v;
+  std::vector<persistent_vector<Tracked>> versions;
+
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    versions.push_back(v);
+    v = v.push_back(Tracked(i));
+  }
+  check(v.size() == COUNT);
+
+  auto doubled = v;
+  for (size_t i = 0; i < COUNT; i++)
+    doubled = doubled.set(i, Tracked(i * 2));
+
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    check(v[i].v == i);
+    check(doubled[i].v == i * 2);
+    check(versions[i].size() == i);
+  }
+  check(versions[COUNT / 2][COUNT / 2 - 1].v == COUNT / 2 - 1);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run([]() { schedule_lambda(test_map<std::hash<size_t>>); });
+  harness.run([]() { schedule_lambda(test_map<BadHash>); });
+  harness.run([]() { schedule_lambda(test_vector); });
+
+  check(live == 0);
+
+  return 0;
+}
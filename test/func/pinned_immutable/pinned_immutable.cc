@@ -0,0 +1,128 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+static std::atomic<size_t> live_count;
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+
+  Node()
+  {
+    live_count++;
+  }
+
+  ~Node()
+  {
+    live_count--;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+Node* make_graph()
+{
+  auto root = new (RegionType::Trace) Node;
+  {
+    UsingRegion rr(root);
+    root->next = new Node;
+    root->next->next = new Node;
+  }
+  freeze(root);
+  return root;
+}
+
+/// Checks that a pinned count is exact once it is retired.
+void test_retire_with_references()
+{
+  schedule_lambda([]() {
+    auto root = make_graph();
+    check(Immutable::pin(root));
+    check(!Immutable::pin(root));
+
+    // References taken and dropped while pinned, through interior objects.
+    for (size_t i = 0; i < 10; i++)
+      Immutable::acquire(root->next);
+    for (size_t i = 0; i < 9; i++)
+      Immutable::release(root->next->next);
+
+    check(Immutable::retire(root) == 0);
+    check(root->debug_test_rc(2));
+
+    Immutable::release(root);
+    check(Immutable::release(root) > 0);
+  });
+}
+
+static constexpr size_t WORKERS = 8;
+static constexpr size_t ROUNDS = 100;
+
+struct State
+{
+  Node* root;
+  std::atomic<size_t> remaining{WORKERS};
+};
+
+void finish(State* s)
+{
+  if (--s->remaining == 0)
+  {
+    // The last reference was released while pinned.
+    Immutable::release(s->root);
+    check(Immutable::retire(s->root) > 0);
+    delete s;
+  }
+}
+
+/**
+ * References are taken on one thread and released on another, and the graph
+ * is retired once they have all been released.
+ */
+void test_pinned_across_threads()
+{
+  schedule_lambda([]() {
+    auto s = new State;
+    s->root = make_graph();
+    check(Immutable::pin(s->root));
+
+    for (size_t w = 0; w < WORKERS; w++)
+    {
+      schedule_lambda([s]() {
+        for (size_t i = 0; i < ROUNDS; i++)
+        {
+          Immutable::acquire(s->root);
+          Immutable::release(s->root);
+        }
+
+        // Handed to another behaviour, which releases it.
+        Immutable::acquire(s->root->next);
+        schedule_lambda([s]() {
+          Immutable::release(s->root);
+          finish(s);
+        });
+      });
+    }
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_retire_with_references);
+  harness.run(test_pinned_across_threads);
+
+  check(live_count == 0);
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks the placement of cores on cpus by each `AffinityPolicy`, and the
+ * parsing of cpu lists for `VERONA_AFFINITY` and `--affinity`.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static std::vector<size_t> affinities()
+{
+  std::vector<size_t> result;
+  for (size_t i = 0; i < Scheduler::get_core_count(); i++)
+    result.push_back(Scheduler::get_core(i)->affinity);
+  return result;
+}
+
+static bool distinct(std::vector<size_t> v)
+{
+  std::sort(v.begin(), v.end());
+  return std::adjacent_find(v.begin(), v.end()) == v.end();
+}
+
+static void test_parse()
+{
+  std::vector<size_t> cpus;
+  check(parse_cpu_list("0-2,5", cpus));
+  check(cpus == std::vector<size_t>({0, 1, 2, 5}));
+  check(parse_cpu_list("7", cpus));
+  check(cpus == std::vector<size_t>({7}));
+
+  for (auto bad : {"", "1,", "-1", "3-1", "1-", "a", "1;2"})
+    check(!parse_cpu_list(bad, cpus));
+
+  AffinityPolicy policy;
+  check(parse_affinity_policy("scatter", policy, cpus));
+  check(policy == AffinityPolicy::Scatter);
+  check(parse_affinity_policy("none", policy, cpus));
+  check(policy == AffinityPolicy::None);
+  check(parse_affinity_policy("1-2", policy, cpus));
+  check(policy == AffinityPolicy::Explicit);
+  check(!parse_affinity_policy("sideways", policy, cpus));
+}
+
+struct Expected
+{
+  AffinityPolicy policy;
+  std::vector<size_t> cpus;
+};
+
+static void test_policy(Expected* expected, size_t available)
+{
+  auto placed = affinities();
+
+  switch (expected->policy)
+  {
+    case AffinityPolicy::Compact:
+    case AffinityPolicy::Scatter:
+      for (auto a : placed)
+        check(a != (size_t)-1);
+      if (placed.size() <= available)
+        check(distinct(placed));
+      if (expected->policy == AffinityPolicy::Compact)
+        expected->cpus = placed;
+      break;
+
+    case AffinityPolicy::Explicit:
+      for (size_t i = 0; i < placed.size(); i++)
+        check(placed[i] == expected->cpus[i % expected->cpus.size()]);
+      break;
+
+    case AffinityPolicy::None:
+      for (auto a : placed)
+        check(a == (size_t)-1);
+      break;
+  }
+
+  when() << []() {};
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  auto available = Scheduler::default_thread_count();
+
+  test_parse();
+
+  // The environment would override the policies under test.
+  if (getenv("VERONA_AFFINITY") != nullptr)
+    return 0;
+
+  Expected expected{AffinityPolicy::Compact, {}};
+  for (auto policy :
+       {AffinityPolicy::Compact, AffinityPolicy::Scatter, AffinityPolicy::None})
+  {
+    expected.policy = policy;
+    Scheduler::set_affinity_policy(policy);
+    harness.run(test_policy, &expected, available);
+  }
+
+  // The cpus the compact policy picked, in the opposite order.
+  std::reverse(expected.cpus.begin(), expected.cpus.end());
+  expected.policy = AffinityPolicy::Explicit;
+  Scheduler::set_affinity_cpus(expected.cpus);
+  harness.run(test_policy, &expected, available);
+
+  Scheduler::set_affinity_policy(AffinityPolicy::Compact);
+  return 0;
+}
@@ -0,0 +1,99 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks placing cowns and arenas on the NUMA node of a core.  Whether the
+ * memory moves depends on the machine, so this checks that placed cowns
+ * and regions keep their contents and go on working.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+using namespace verona::rt::api;
+
+/// Several pages, so that `numa::bind` has whole pages to move.
+struct Large
+{
+  size_t values[4 * 4096 / sizeof(size_t)];
+
+  Large(size_t v)
+  {
+    for (auto& x : values)
+      x = v;
+  }
+};
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+  size_t value = 0;
+
+  using fields = Fields<&Node::next>;
+};
+
+static constexpr size_t COWNS = 8;
+static constexpr size_t NODES = 1000;
+
+void test_cowns()
+{
+  when() << []() {
+    auto core = Scheduler::local_core();
+    for (size_t i = 0; i < COWNS; i++)
+    {
+      auto c = make_cown<Large>(Placement{core}, i);
+      when(c) << [i](acquired_cown<Large> l) {
+        for (auto& x : l->values)
+        {
+          check(x == i);
+          x++;
+        }
+      };
+      when(read(c)) << [i](acquired_cown<const Large> l) {
+        check(l->values[0] == i + 1);
+      };
+    }
+  };
+}
+
+void test_arena()
+{
+  auto* o = new (RegionType::Arena) Node;
+  {
+    UsingRegion rr(o);
+    for (size_t i = 0; i < NODES / 2; i++)
+    {
+      auto n = new Node;
+      n->value = i;
+      n->next = o->next;
+      o->next = n;
+    }
+
+    // Moves the arenas so far, and places the ones allocated after.
+    RegionArena::set_numa_node(o, 0);
+    for (size_t i = NODES / 2; i < NODES; i++)
+    {
+      auto n = new Node;
+      n->value = i;
+      n->next = o->next;
+      o->next = n;
+    }
+  }
+
+  size_t i = NODES;
+  for (Node* n = o->next; n != nullptr; n = n->next)
+    check(n->value == --i);
+  check(i == 0);
+
+  region_release(o);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_cowns);
+  harness.run(test_arena);
+
+  return 0;
+}
@@ -0,0 +1,76 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Runs behaviours on large cowns that prefetch more than the default, and
+ * on more cowns than `BehaviourCore::prefetch` fetches, with continuations
+ * on, so that both ways of prefetching a behaviour about to run are used.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+struct Large
+{
+  size_t hot = 0;
+  char cold[4096];
+  size_t tail = 0;
+};
+
+namespace verona::cpp
+{
+  template<>
+  struct prefetch_cown_lines<Large> : std::integral_constant<size_t, 66>
+  {};
+}
+
+static constexpr size_t COWNS = 10;
+static constexpr size_t ROUNDS = 20;
+
+static std::atomic<size_t> finished = 0;
+
+void test_prefetch()
+{
+  cown_ptr<Large> cowns[COWNS];
+  for (auto& c : cowns)
+    c = make_cown<Large>();
+
+  for (size_t r = 0; r < ROUNDS; r++)
+  {
+    for (auto& c : cowns)
+      when(c) << [](acquired_cown<Large> l) {
+        l->hot++;
+        l->tail++;
+      };
+
+    when(cowns[0], cowns[1], cowns[2]) <<
+      [](
+        acquired_cown<Large> a,
+        acquired_cown<Large> b,
+        acquired_cown<Large> c) {
+        check(a->hot == b->hot);
+        check(c->hot == c->tail);
+      };
+
+    when(cown_set<Large>{cowns, COWNS}) <<
+      [r](acquired_cown_span<Large> s) {
+        for (size_t i = 0; i < s.length; i++)
+          check(s.array[i]->hot == r + 1);
+        if (r + 1 == ROUNDS)
+          finished++;
+      };
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  Scheduler::set_continuation_depth(4);
+
+  harness.run(test_prefetch);
+  check(finished == harness.seed_upper - harness.seed_lower);
+
+  return 0;
+}
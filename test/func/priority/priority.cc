@@ -0,0 +1,71 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that high priority behaviours run ahead of normal behaviours that
+ * were already runnable.
+ *
+ * With a single scheduler thread, a high priority behaviour can be overtaken
+ * by at most one normal behaviour, when the thread's batch runs out and it
+ * services its normal queue for fairness.  With more threads, other threads
+ * may run the normal behaviours first, so only completion is checked.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t NORMAL_COUNT = 50;
+static size_t core_count = 0;
+
+struct Account
+{};
+
+struct Log
+{
+  size_t normal_run = 0;
+  size_t normal_before_high = 0;
+  bool high_run = false;
+
+  ~Log()
+  {
+    check(high_run);
+    check(normal_run == NORMAL_COUNT);
+    if (core_count == 1)
+      check(normal_before_high <= 1);
+  }
+};
+
+void test_priority()
+{
+  auto log = make_cown<Log>();
+
+  when() << [log]() {
+    for (size_t i = 0; i < NORMAL_COUNT; i++)
+    {
+      when(make_cown<Account>()) << [log](auto) {
+        when(log) << [](auto l) { l->normal_run++; };
+      };
+    }
+
+    when(make_cown<Account>()).with_priority(Priority::High) << [log](auto) {
+      when(log).with_priority(Priority::High) << [](auto l) {
+        l->normal_before_high = l->normal_run;
+        l->high_run = true;
+      };
+    };
+  };
+
+  // Cown-less high priority work is also run.
+  when().with_priority(Priority::High) << []() {};
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  core_count = harness.cores;
+
+  harness.run(test_priority);
+
+  return 0;
+}
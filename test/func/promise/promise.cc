@@ -1,6 +1,7 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
 
+#include <cpp/when.h>
 #include <debug/harness.h>
 
 using namespace std;
@@ -136,6 +137,177 @@ void promise_transfer2()
   auto rp2 = Promise<int>::PromiseR(p2, YesTransfer);
 }
 
+void oneshot_test()
+{
+  // Reader waits before the writer fulfills.
+  auto pp = OneShotPromise<int>::create_promise();
+  std::move(pp.first).then(
+    [](std::variant<int, OneShotPromise<int>::PromiseErr> val) {
+      check(std::holds_alternative<int>(val));
+      check(std::get<int>(val) == 42);
+    });
+  schedule_lambda([wp = std::move(pp.second)]() mutable {
+    OneShotPromise<int>::fulfill(std::move(wp), 42);
+  });
+
+  // Writer fulfills before the reader waits.
+  auto pp2 = OneShotPromise<unique_ptr<int>>::create_promise();
+  OneShotPromise<unique_ptr<int>>::fulfill(
+    std::move(pp2.second), make_unique<int>(7));
+  std::move(pp2.first).then(
+    [](std::variant<unique_ptr<int>, OneShotPromise<unique_ptr<int>>::PromiseErr>
+         val) {
+      check(std::holds_alternative<unique_ptr<int>>(val));
+      check(*std::get<unique_ptr<int>>(val) == 7);
+    });
+}
+
+void oneshot_no_reader()
+{
+  auto pp = OneShotPromise<unique_ptr<int>>::create_promise();
+  auto rp = std::move(pp.first);
+
+  schedule_lambda([wp = std::move(pp.second)]() mutable {
+    OneShotPromise<unique_ptr<int>>::fulfill(
+      std::move(wp), make_unique<int>(42));
+  });
+}
+
+void oneshot_no_writer()
+{
+  auto pp = OneShotPromise<int>::create_promise();
+
+  std::move(pp.first).then(
+    [](std::variant<int, OneShotPromise<int>::PromiseErr> val) {
+      check(std::holds_alternative<OneShotPromise<int>::PromiseErr>(val));
+    });
+
+  schedule_lambda([wp = std::move(pp.second)]() mutable {});
+}
+
+void promise_when_all()
+{
+  auto pa = Promise<int>::create_promise();
+  auto pb = Promise<unique_ptr<int>>::create_promise();
+  auto ra = std::move(pa.first);
+  auto rb = std::move(pb.first);
+
+  when_all(ra, rb).then(
+    [](std::variant<
+       std::tuple<int, unique_ptr<int>>,
+       Promise<std::tuple<int, unique_ptr<int>>>::PromiseErr> val) {
+      check(std::holds_alternative<std::tuple<int, unique_ptr<int>>>(val));
+      auto& t = std::get<std::tuple<int, unique_ptr<int>>>(val);
+      check(std::get<0>(t) == 1);
+      check(*std::get<1>(t) == 2);
+    });
+
+  schedule_lambda([wa = std::move(pa.second)]() mutable {
+    Promise<int>::fulfill(std::move(wa), 1);
+  });
+  schedule_lambda([wb = std::move(pb.second)]() mutable {
+    Promise<unique_ptr<int>>::fulfill(std::move(wb), make_unique<int>(2));
+  });
+}
+
+void promise_when_all_error()
+{
+  auto pa = Promise<int>::create_promise();
+  auto pb = Promise<int>::create_promise();
+  auto ra = std::move(pa.first);
+  auto rb = std::move(pb.first);
+
+  when_all(ra, rb).then(
+    [](std::variant<
+       std::tuple<int, int>,
+       Promise<std::tuple<int, int>>::PromiseErr> val) {
+      check(std::holds_alternative<Promise<std::tuple<int, int>>::PromiseErr>(
+        val));
+    });
+
+  schedule_lambda([wa = std::move(pa.second)]() mutable {
+    Promise<int>::fulfill(std::move(wa), 1);
+  });
+  schedule_lambda([wb = std::move(pb.second)]() mutable {});
+}
+
+void promise_when_any()
+{
+  auto pa = Promise<int>::create_promise();
+  auto pb = Promise<int>::create_promise();
+  auto ra = std::move(pa.first);
+  auto rb = std::move(pb.first);
+
+  // Only the second promise is fulfilled, so it must be the one chosen.
+  when_any(ra, rb).then(
+    [](std::variant<
+       std::variant<int, int>,
+       Promise<std::variant<int, int>>::PromiseErr> val) {
+      check(std::holds_alternative<std::variant<int, int>>(val));
+      auto& v = std::get<std::variant<int, int>>(val);
+      check(v.index() == 1);
+      check(std::get<1>(v) == 2);
+    });
+
+  schedule_lambda([wa = std::move(pa.second)]() mutable {});
+  schedule_lambda([wb = std::move(pb.second)]() mutable {
+    Promise<int>::fulfill(std::move(wb), 2);
+  });
+
+  // None fulfilled.
+  auto pc = Promise<int>::create_promise();
+  auto rc = std::move(pc.first);
+  when_any(rc).then(
+    [](std::variant<std::variant<int>, Promise<std::variant<int>>::PromiseErr>
+         val) {
+      check(std::holds_alternative<Promise<std::variant<int>>::PromiseErr>(val));
+    });
+}
+
+static std::atomic<size_t> promise_whens = 0;
+
+void promise_when()
+{
+  using namespace verona::cpp;
+
+  auto pp = Promise<int>::create_promise();
+  auto rp = std::move(pp.first);
+  auto counter = make_cown<int>(1);
+
+  // Waits for the promise and the cown in a single behaviour.
+  when(rp, counter) <<
+    [](std::variant<int, Promise<int>::PromiseErr> v, acquired_cown<int> c) {
+      check(std::holds_alternative<int>(v));
+      *c += std::get<int>(v);
+      promise_whens++;
+    };
+
+  // Ordered behind the behaviour above on the cown.
+  when(counter) << [](acquired_cown<int> c) {
+    check(*c == 43);
+    promise_whens++;
+  };
+
+  // Takes over the reader, and reads the promise alongside the first.
+  when(std::move(rp)) << [](std::variant<int, Promise<int>::PromiseErr> v) {
+    check(std::get<int>(v) == 42);
+    promise_whens++;
+  };
+
+  schedule_lambda([wp = std::move(pp.second)]() mutable {
+    Promise<int>::fulfill(std::move(wp), 42);
+  });
+
+  // A writer dropped without fulfilling the promise passes an error.
+  auto pp2 = Promise<int>::create_promise();
+  when(pp2.first, counter) <<
+    [](std::variant<int, Promise<int>::PromiseErr> v, acquired_cown<int>) {
+      check(std::holds_alternative<Promise<int>::PromiseErr>(v));
+      promise_whens++;
+    };
+  schedule_lambda([wp = std::move(pp2.second)]() mutable {});
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
@@ -145,6 +317,14 @@ int main(int argc, char** argv)
   harness.run(promise_no_writer);
   harness.run(promise_smart_pointer);
   harness.run(promise_transfer2);
+  harness.run(promise_when_all);
+  harness.run(promise_when_all_error);
+  harness.run(promise_when_any);
+  harness.run(promise_when);
+  check(promise_whens == 4 * (harness.seed_upper - harness.seed_lower));
+  harness.run(oneshot_test);
+  harness.run(oneshot_no_reader);
+  harness.run(oneshot_no_writer);
 
   return 0;
 }
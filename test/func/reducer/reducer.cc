@@ -0,0 +1,89 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that a read of a `reducer_cown` sees every update made on any core
+ * before it, with the default and a custom merge, and that further updates
+ * after a read are not lost.
+ */
+#include <array>
+#include <cpp/reducer.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t TASKS = 64;
+static constexpr size_t UPDATES = 100;
+static constexpr size_t BUCKETS = 8;
+
+using Histogram = std::array<size_t, BUCKETS>;
+
+struct MergeHistogram
+{
+  Histogram operator()(Histogram a, const Histogram& b) const
+  {
+    for (size_t i = 0; i < BUCKETS; i++)
+      a[i] += b[i];
+    return a;
+  }
+};
+
+static std::atomic<size_t> reads = 0;
+
+void test_counter()
+{
+  auto counter = make_reducer_cown<size_t>();
+
+  task_group g;
+  for (size_t t = 0; t < TASKS; t++)
+    g.spawn([counter]() {
+      for (size_t i = 0; i < UPDATES; i++)
+        counter.update([](size_t& n) { n++; });
+    });
+
+  g.then([counter]() {
+    when(read(counter)) << [](acquired_cown<const size_t> n) {
+      check(*n == TASKS * UPDATES);
+      reads++;
+    };
+
+    counter.update([](size_t& n) { n += 5; });
+    when(read(counter)) << [](acquired_cown<const size_t> n) {
+      check(*n == TASKS * UPDATES + 5);
+      reads++;
+    };
+  });
+}
+
+void test_histogram()
+{
+  auto histogram = make_reducer_cown<Histogram, MergeHistogram>();
+
+  task_group g;
+  for (size_t t = 0; t < TASKS; t++)
+    g.spawn([histogram, t]() {
+      histogram.update([t](Histogram& h) { h[t % BUCKETS]++; });
+    });
+
+  g.then([histogram]() {
+    when(read(histogram)) << [](acquired_cown<const Histogram> h) {
+      for (size_t i = 0; i < BUCKETS; i++)
+        check((*h)[i] == TASKS / BUCKETS);
+      reads++;
+    };
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_counter);
+  check(reads == 2);
+
+  reads = 0;
+  harness.run(test_histogram);
+  check(reads == 1);
+
+  return 0;
+}
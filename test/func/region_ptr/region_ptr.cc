@@ -0,0 +1,111 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `region_ptr`: a list built in a region by one stage is moved to
+ * the next stage in the closure of a `when`, where it is extended and
+ * summed, and a region detached from the list with `take` is given to
+ * another region with `release`.
+ */
+#include <cpp/region_ptr.h>
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t ITEMS = 32;
+
+struct Node : public V<Node>
+{
+  size_t value;
+  Node* next = nullptr;
+  /// Another region, held as a subregion of this one.
+  Node* sub = nullptr;
+
+  Node(size_t value_) : value(value_) {}
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+    if (sub != nullptr)
+      st.push(sub);
+  }
+
+  void finaliser(Object* region, ObjectStack& st)
+  {
+    if (sub != nullptr)
+      Object::add_sub_region(sub, region, st);
+  }
+};
+
+struct Stage
+{
+  region_ptr<Node> list;
+  size_t received = 0;
+};
+
+static size_t sum(Node* n)
+{
+  size_t total = 0;
+  for (; n != nullptr; n = n->next)
+    total += n->value;
+  return total;
+}
+
+void test_pipeline()
+{
+  auto first = make_cown<Stage>();
+  auto second = make_cown<Stage>();
+
+  when(first) << [second](acquired_cown<Stage>) {
+    auto list = make_region<Node>(RegionType::Trace, 0);
+    list.use([](Node& head) {
+      for (size_t i = 1; i < ITEMS; i++)
+      {
+        auto n = new Node(i);
+        n->next = head.next;
+        head.next = n;
+      }
+      head.sub = new (RegionType::Trace) Node(ITEMS);
+    });
+
+    Node* head = list.get();
+    when(second) << [list = std::move(list), head](
+                      acquired_cown<Stage> s) mutable {
+      check(list.get() == head);
+      check(sum(list.get()) == (ITEMS * (ITEMS - 1)) / 2);
+      s->list = std::move(list);
+      s->received++;
+    };
+    check(!list);
+  };
+
+  when(second) << [](acquired_cown<Stage> s) {
+    check(s->received == 1);
+
+    // Move the subregion out of the list, and back in behind a new node.
+    region_ptr<Node> sub = s->list.use(
+      [](Node& head) { return region_ptr<Node>::take(head.sub); });
+    check(sub->value == ITEMS);
+    check(s->list->sub == nullptr);
+
+    s->list.use([&sub](Node& head) {
+      auto n = new Node(0);
+      n->sub = sub.release();
+      n->next = head.next;
+      head.next = n;
+    });
+    check(!sub);
+    check(sum(s->list.get()) == (ITEMS * (ITEMS - 1)) / 2);
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_pipeline);
+
+  return 0;
+}
@@ -130,7 +130,11 @@ void merge_test()
     UsingRegion rr(r1);
     merge(r2);
   }
-  check(o1->debug_rc() == 1 && o2->debug_rc() == 1 && o3->debug_rc() == 2);
+  // A logged set keeps the reference counts of both sets.
+  if constexpr (region_type == RegionType::Arena)
+    check(o1->debug_rc() == 1 && o2->debug_rc() == 1 && o3->debug_rc() == 3);
+  else
+    check(o1->debug_rc() == 1 && o2->debug_rc() == 1 && o3->debug_rc() == 2);
 
   if constexpr (region_type == RegionType::Trace)
   {
@@ -147,6 +151,36 @@ void merge_test()
   heap::debug_check_empty();
 }
 
+/**
+ * Tests that inserting the same objects repeatedly into an arena region's
+ * logged set holds them once.
+ **/
+void repeat_test()
+{
+  auto r = new (RegionType::Arena) C1;
+
+  auto* o1 = new (RegionType::Trace) C1;
+  freeze(o1);
+  auto* o2 = new (RegionType::Trace) C1;
+  freeze(o2);
+
+  for (int i = 0; i < 10; i++)
+    RegionArena::insert(r, o1);
+  for (int i = 0; i < 10; i++)
+    RegionArena::insert(r, o2);
+  check(o1->debug_rc() == 2 && o2->debug_rc() == 2);
+
+  Immutable::acquire(o1);
+  RegionArena::insert<YesTransfer>(r, o1);
+  check(o1->debug_rc() == 2);
+
+  Immutable::release(o1);
+  Immutable::release(o2);
+  region_release(r);
+
+  heap::debug_check_empty();
+}
+
 int main(int argc, char** argv)
 {
   (void)argc;
@@ -158,5 +192,7 @@ int main(int argc, char** argv)
   merge_test<RegionType::Trace>();
   merge_test<RegionType::Arena>();
 
+  repeat_test();
+
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `remote_cown`: messages sent through the shared ring by several
+ * senders, each with its own mapping of it, are all delivered to the cown,
+ * in the order that each sender sent them, including those sent just
+ * before it is closed.
+ */
+#include <cpp/remote_cown.h>
+#include <debug/harness.h>
+#include <string>
+#include <unistd.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t SENDERS = 2;
+static constexpr size_t MESSAGES = 1000;
+
+struct Msg
+{
+  size_t sender;
+  size_t seq;
+};
+
+struct Received
+{
+  size_t next[SENDERS] = {};
+};
+
+static std::atomic<size_t> delivered = 0;
+
+using Inbox = remote_cown<Received, Msg, 64>;
+
+static void sender(Inbox inbox, std::string name, size_t id)
+{
+  static std::atomic<size_t> finished = 0;
+
+  auto out = remote_cown_ref<Msg, 64>::connect(name);
+  check((bool)out);
+  for (size_t i = 0; i < MESSAGES; i++)
+    out.send({id, i});
+
+  if (++finished % SENDERS == 0)
+    inbox.close();
+}
+
+void test_remote(SystematicTestHarness* harness)
+{
+  auto name = "/verona-remote-cown-" + std::to_string(getpid()) + "-" +
+    std::to_string(harness->current_seed());
+
+  Inbox inbox(name, make_cown<Received>(), [](Received& r, const Msg& m) {
+    check(m.sender < SENDERS);
+    check(r.next[m.sender] == m.seq);
+    r.next[m.sender]++;
+    delivered++;
+  });
+  check((bool)inbox);
+
+  // A name can only be used by one inbox at a time.
+  Inbox taken(name, inbox.cown(), [](Received&, const Msg&) {});
+  check(!taken);
+
+  inbox.listen();
+  for (size_t i = 0; i < SENDERS; i++)
+    harness->external_thread(sender, inbox, name, i);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_remote, &harness);
+  check(
+    delivered ==
+    SENDERS * MESSAGES * (harness.seed_upper - harness.seed_lower));
+
+  return 0;
+}
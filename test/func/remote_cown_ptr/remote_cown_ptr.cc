@@ -0,0 +1,101 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `remote_cown_ptr` and `cown_endpoint` over a socket pair: every
+ * message sent is delivered to the cown, in order, even though the sender
+ * is held back by a small queue limit and the messages are read in pieces
+ * that split them.  The endpoint sees the end of the stream once the
+ * sender closes.
+ */
+#include <cpp/remote_cown_ptr.h>
+#include <debug/harness.h>
+#if defined(__unix__) || defined(__APPLE__)
+#  include <fcntl.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+using namespace verona::cpp;
+
+#if defined(__unix__) || defined(__APPLE__)
+static constexpr size_t MESSAGES = 2000;
+
+struct Msg
+{
+  uint64_t seq;
+  uint32_t check;
+};
+
+struct Table
+{
+  uint64_t next = 0;
+  int fds[2];
+
+  ~Table()
+  {
+    close(fds[0]);
+    close(fds[1]);
+  }
+};
+
+static std::atomic<size_t> finished = 0;
+
+/// Sends from `seq` until the queue is full, then tries again later.
+static void produce(remote_cown_ptr<Msg> peer, uint64_t seq)
+{
+  while (seq < MESSAGES)
+  {
+    if (!peer.send({seq, (uint32_t)(seq * 7)}))
+    {
+      check(!peer.failed());
+      check(peer.queued() > 0);
+      schedule_lambda([peer, seq]() { produce(peer, seq); });
+      return;
+    }
+    seq++;
+  }
+  peer.close();
+}
+
+void test_stream()
+{
+  auto table = make_cown<Table>();
+  when(table) << [table](acquired_cown<Table> t) {
+    check(socketpair(AF_UNIX, SOCK_STREAM, 0, t->fds) == 0);
+    for (int fd : t->fds)
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    // A batch that does not hold a whole number of messages.
+    cown_endpoint<Table, Msg> ep(
+      t->fds[1],
+      table,
+      [](Table& t, const Msg& m) {
+        check(m.seq == t.next);
+        check(m.check == (uint32_t)(m.seq * 7));
+        t.next++;
+      },
+      3);
+    ep.on_close([](Table& t, int r) {
+      check(r == 0);
+      check(t.next == MESSAGES);
+      finished++;
+    });
+    ep.start();
+
+    produce(remote_cown_ptr<Msg>(t->fds[0], 16), 0);
+  };
+}
+#endif
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+#if defined(__unix__) || defined(__APPLE__)
+  harness.run(test_stream);
+  check(finished == harness.seed_upper - harness.seed_lower);
+#endif
+
+  return 0;
+}
@@ -0,0 +1,101 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that a behaviour that yields when its quantum runs out keeps its
+ * cown and its progress across reruns, and that other cowns make progress
+ * meanwhile.
+ *
+ * The scan sends a behaviour to another cown as it starts, which must run
+ * before the scan finishes, even on one core, where it can only run while
+ * the scan is yielding.  Each run of the scan that yields must have used up
+ * its quantum, so the scan cannot yield more often than its running time
+ * allows.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t STEPS = 200;
+static constexpr size_t STEP_USEC = 5;
+static constexpr uint64_t QUANTUM_NS = 100'000;
+
+/// Steps of the scan done so far, read by the other behaviour.
+static std::atomic<size_t> progress = 0;
+
+struct Scan
+{
+  size_t done = 0;
+  size_t reruns = 0;
+  uint64_t running_ns = 0;
+};
+
+struct Other
+{
+  bool ran = false;
+  size_t seen = 0;
+};
+
+void test_rerun()
+{
+  Scheduler::set_rerun_quantum(std::chrono::nanoseconds(QUANTUM_NS));
+  progress = 0;
+
+  auto scan = make_cown<Scan>();
+  auto other = make_cown<Other>();
+
+  when(scan) << [other](acquired_cown<Scan> s) {
+    auto start = DeadlineQueue::now();
+    if (s->done == 0)
+    {
+      when(other) << [](acquired_cown<Other> o) {
+        o->ran = true;
+        o->seen = progress.load();
+      };
+    }
+
+    while (s->done < STEPS)
+    {
+      busy_loop(STEP_USEC);
+      progress = ++s->done;
+      if (Behaviour::should_yield())
+      {
+        s->reruns++;
+        s->running_ns += DeadlineQueue::now() - start;
+        Behaviour::rerun();
+        return;
+      }
+    }
+    s->running_ns += DeadlineQueue::now() - start;
+  };
+
+  // Queued behind the scan, so only runs once it has finished.
+  when(scan) << [other](acquired_cown<Scan> s) {
+    check(s->done == STEPS);
+    check(s->reruns > 0);
+    // Each run that yielded ran for its quantum, less the time before it
+    // started timing itself, which is far shorter than a step.
+    check(s->reruns * (QUANTUM_NS - STEP_USEC * 1'000) <= s->running_ns);
+    Logging::cout() << "Scan finished after " << s->reruns << " reruns"
+                    << Logging::endl;
+
+    // Queued behind the behaviour that the scan sent to the other cown, which
+    // must not have been held up until the scan finished.
+    when(other) << [](acquired_cown<Other> o) {
+      check(o->ran);
+      check(o->seen < STEPS);
+    };
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_rerun);
+
+  Scheduler::set_rerun_quantum(std::chrono::nanoseconds(0));
+
+  return 0;
+}
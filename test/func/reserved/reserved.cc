@@ -0,0 +1,85 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that critical behaviours only run on the reserved cores, and other
+ * behaviours never do, see `ThreadPool::set_reserved_core_count`.
+ *
+ * Critical and normal behaviours share cowns, so each kind is made runnable
+ * by the other, and critical behaviours create normal ones, which must
+ * leave the reserved core.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t RESERVED = 1;
+static constexpr size_t ROUNDS = 50;
+static constexpr size_t COWNS = 4;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+static std::atomic<size_t> critical_run = 0;
+static std::atomic<size_t> normal_run = 0;
+
+static void check_core(bool critical)
+{
+  auto* core = Scheduler::local_core();
+  if (Scheduler::get_reserved_core_count() == 0)
+    check(!core->reserved);
+  else
+    check(core->reserved == critical);
+}
+
+void test_reserved()
+{
+  critical_run = 0;
+  normal_run = 0;
+
+  for (size_t i = 0; i < COWNS; i++)
+  {
+    auto c = make_cown<Counter>();
+    for (size_t r = 0; r < ROUNDS; r++)
+    {
+      when(c).with_priority(Priority::Critical)
+        << [](acquired_cown<Counter> c) {
+             check_core(true);
+             c->count++;
+             critical_run++;
+             when() << []() {
+               check_core(false);
+               normal_run++;
+             };
+           };
+
+      when(c) << [](acquired_cown<Counter> c) {
+        check_core(false);
+        c->count++;
+        normal_run++;
+      };
+    }
+  }
+
+  when().with_priority(Priority::Critical) << []() {
+    check_core(true);
+    critical_run++;
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  Scheduler::set_reserved_core_count(RESERVED);
+  harness.run(test_reserved);
+  Scheduler::set_reserved_core_count(0);
+
+  check(critical_run == (COWNS * ROUNDS) + 1);
+  check(normal_run == 2 * COWNS * ROUNDS);
+
+  return 0;
+}
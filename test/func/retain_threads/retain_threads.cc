@@ -0,0 +1,68 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks keeping the scheduler threads and cores between runs, see
+ * `ThreadPool::set_retain_threads`.
+ *
+ * Several runs are made back to back, each recording the threads its
+ * behaviours ran on.  With retention, no more threads are ever seen than
+ * there are cores.  The retained cores hold memory from the runtime's heap,
+ * so leaks are only checked once they have been released.  With systematic
+ * testing, threads are not retained.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <mutex>
+#include <set>
+#include <thread>
+
+using namespace verona::cpp;
+
+static constexpr size_t RUNS = 5;
+static constexpr size_t BEHAVIOURS = 50;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+static std::mutex seen_lock;
+static std::set<std::thread::id> seen;
+static std::atomic<size_t> run_count = 0;
+
+void test_retain_threads()
+{
+  for (size_t i = 0; i < BEHAVIOURS; i++)
+  {
+    when(make_cown<Counter>()) << [](acquired_cown<Counter> c) {
+      c->count++;
+      run_count++;
+      std::lock_guard<std::mutex> l(seen_lock);
+      seen.insert(std::this_thread::get_id());
+    };
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  bool detect_leaks = harness.detect_leaks;
+  harness.detect_leaks = false;
+
+  Scheduler::set_retain_threads(true);
+  for (size_t i = 0; i < RUNS; i++)
+    harness.run(test_retain_threads);
+  Scheduler::set_retain_threads(false);
+
+  auto seeds = harness.seed_upper - harness.seed_lower;
+  check(run_count == RUNS * BEHAVIOURS * seeds);
+#ifndef USE_SYSTEMATIC_TESTING
+  check(seen.size() <= harness.cores);
+#endif
+
+  if (detect_leaks)
+    heap::debug_check_empty();
+
+  return 0;
+}
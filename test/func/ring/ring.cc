@@ -0,0 +1,174 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks the bounded MPMC ring, first on one thread at its boundaries, and
+ * then with several producers and consumers, where every value must be
+ * dequeued exactly once and each producer's values in order.  The SPSC ring
+ * is checked the same way, with one producer and one consumer.
+ */
+#include <debug/harness.h>
+#include <ds/ring.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace verona::rt;
+
+void test_sequential()
+{
+  auto ring = std::make_unique<MPMCRing<size_t, 8>>();
+  size_t value = 0;
+
+  check(!ring->try_dequeue(value));
+
+  // Go round the ring several times.
+  for (size_t lap = 0; lap < 4; lap++)
+  {
+    for (size_t i = 0; i < 8; i++)
+      check(ring->try_enqueue(lap * 8 + i));
+    check(!ring->try_enqueue(99));
+    check(ring->size_estimate() == 8);
+
+    for (size_t i = 0; i < 8; i++)
+    {
+      check(ring->try_dequeue(value));
+      check(value == lap * 8 + i);
+    }
+    check(!ring->try_dequeue(value));
+  }
+
+  for (size_t i = 0; i < 5; i++)
+    check(ring->try_enqueue(i));
+  size_t sum = 0;
+  check(ring->dequeue_some(3, [&sum](size_t v) { sum += v; }) == 3);
+  check(sum == 0 + 1 + 2);
+  check(ring->dequeue_some(10, [&sum](size_t v) { sum += v; }) == 2);
+  check(sum == 0 + 1 + 2 + 3 + 4);
+}
+
+void test_concurrent()
+{
+  static constexpr size_t PRODUCERS = 4;
+  static constexpr size_t CONSUMERS = 4;
+  static constexpr size_t PER_PRODUCER = 100000;
+
+  using Ring = MPMCRing<size_t, 64>;
+  auto ring = std::make_unique<Ring>();
+  std::vector<std::atomic<size_t>> seen(PRODUCERS * PER_PRODUCER);
+  std::atomic<size_t> consumed{0};
+
+  std::vector<std::thread> threads;
+  for (size_t p = 0; p < PRODUCERS; p++)
+  {
+    threads.emplace_back([&ring, p]() {
+      for (size_t i = 0; i < PER_PRODUCER; i++)
+      {
+        while (!ring->try_enqueue(p * PER_PRODUCER + i))
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  for (size_t c = 0; c < CONSUMERS; c++)
+  {
+    threads.emplace_back([&]() {
+      size_t last[PRODUCERS];
+      for (auto& l : last)
+        l = SIZE_MAX;
+
+      while (consumed.load() < PRODUCERS * PER_PRODUCER)
+      {
+        size_t v;
+        if (!ring->try_dequeue(v))
+        {
+          std::this_thread::yield();
+          continue;
+        }
+
+        // Values from one producer are dequeued in the order they were
+        // enqueued, so each consumer sees them increasing.
+        size_t p = v / PER_PRODUCER;
+        check((last[p] == SIZE_MAX) || (last[p] < v));
+        last[p] = v;
+
+        check(seen[v].fetch_add(1) == 0);
+        consumed++;
+      }
+    });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  for (auto& s : seen)
+    check(s.load() == 1);
+}
+
+void test_spsc_sequential()
+{
+  auto ring = std::make_unique<SPSCRing<size_t, 8>>();
+  size_t value = 0;
+
+  check(!ring->try_dequeue(value));
+  check(ring->is_empty());
+
+  for (size_t lap = 0; lap < 4; lap++)
+  {
+    for (size_t i = 0; i < 8; i++)
+      check(ring->try_enqueue(lap * 8 + i));
+    check(!ring->try_enqueue(99));
+    check(!ring->is_empty());
+    check(ring->size_estimate() == 8);
+
+    for (size_t i = 0; i < 8; i++)
+    {
+      check(ring->try_dequeue(value));
+      check(value == lap * 8 + i);
+    }
+    check(!ring->try_dequeue(value));
+    check(ring->is_empty());
+  }
+
+  for (size_t i = 0; i < 5; i++)
+    check(ring->try_enqueue(i));
+  size_t sum = 0;
+  check(ring->dequeue_some(3, [&sum](size_t v) { sum += v; }) == 3);
+  check(ring->dequeue_some(10, [&sum](size_t v) { sum += v; }) == 2);
+  check(sum == 0 + 1 + 2 + 3 + 4);
+}
+
+void test_spsc_concurrent()
+{
+  static constexpr size_t COUNT = 400000;
+
+  auto ring = std::make_unique<SPSCRing<size_t, 64>>();
+
+  std::thread producer([&ring]() {
+    for (size_t i = 0; i < COUNT; i++)
+    {
+      while (!ring->try_enqueue(i))
+        std::this_thread::yield();
+    }
+  });
+
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    size_t v;
+    while (!ring->try_dequeue(v))
+      std::this_thread::yield();
+    check(v == i);
+  }
+
+  producer.join();
+  check(ring->is_empty());
+}
+
+int main(int, char**)
+{
+  test_sequential();
+  test_concurrent();
+  test_spsc_sequential();
+  test_spsc_concurrent();
+  return 0;
+}
@@ -0,0 +1,63 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that cowns with a scalable reader count still exclude writers from
+ * readers, both for readers woken by a writer and for readers that join a
+ * cown that is already being read.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t ROUNDS = 10;
+static constexpr size_t READERS = 40;
+
+struct Config
+{
+  size_t version = 0;
+  mutable std::atomic<size_t> active_readers{0};
+  std::atomic<bool> writing{false};
+
+  ~Config()
+  {
+    check(version == ROUNDS);
+    check(active_readers == 0);
+  }
+};
+
+void test_scalable_readers()
+{
+  auto s = make_cown<Config>(ScalableReaders{});
+
+  for (size_t round = 0; round < ROUNDS; round++)
+  {
+    for (size_t i = 0; i < READERS; i++)
+    {
+      when(read(s)) << [round](acquired_cown<const Config> c) {
+        c->active_readers++;
+        check(!c->writing);
+        check(c->version == round);
+        Systematic::yield();
+        c->active_readers--;
+      };
+    }
+
+    when(s) << [](acquired_cown<Config> c) {
+      c->writing = true;
+      check(c->active_readers == 0);
+      c->version++;
+      c->writing = false;
+    };
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_scalable_readers);
+
+  return 0;
+}
@@ -0,0 +1,83 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that the scheduler counters can be read while the runtime is
+ * running, without building with `USE_SCHED_STATS`.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t BEHAVIOURS = 100;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+size_t single_cown_behaviours()
+{
+  auto snapshot = Scheduler::stats_snapshot();
+  return snapshot[SchedulerStats::Behaviour + 1];
+}
+
+void test_snapshot()
+{
+  auto counter = make_cown<Counter>();
+  auto before = single_cown_behaviours();
+
+  when(counter) << [counter, before](acquired_cown<Counter>) {
+    for (size_t i = 0; i < BEHAVIOURS; i++)
+      when(counter) << [](acquired_cown<Counter> c) { c->count++; };
+
+    // Runs after all of the above, which were created on this core.
+    when(counter) << [before](acquired_cown<Counter> c) {
+      check(c->count == BEHAVIOURS);
+      check(single_cown_behaviours() > before);
+    };
+  };
+}
+
+void test_names()
+{
+  check(SchedulerStats::name(SchedulerStats::Steal) == "Steal");
+  check(SchedulerStats::name(SchedulerStats::Behaviour + 2) == "2");
+  check(SchedulerStats::name(SchedulerStats::BatchSize + 3) == "Batch 2^3");
+  check(
+    SchedulerStats::name(SchedulerStats::Queued + 3) ==
+    "Priority 1 queued ticks");
+  check(
+    SchedulerStats::name(
+      SchedulerStats::Latency + (2 * SchedulerStats::LATENCY_BUCKETS) + 4) ==
+    "Execute 2^4");
+  check(SchedulerStats::name(SchedulerStats::StealRemote) == "Steal remote");
+}
+
+void test_steals()
+{
+  when() << []() {
+    auto cores = Scheduler::core_stats_snapshots();
+    check(cores.size() == Scheduler::get_core_count());
+    // Other cores may be between counting an attempt and its outcome.
+    for (auto& c : cores)
+    {
+      check(
+        c[SchedulerStats::StealAttempt] >=
+        c[SchedulerStats::Steal] + c[SchedulerStats::StealEmpty] +
+          c[SchedulerStats::StealContended]);
+    }
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  test_names();
+  harness.run(test_snapshot);
+  harness.run(test_steals);
+
+  return 0;
+}
@@ -0,0 +1,170 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks scheduling groups.  `SchedulingGroups` alone shares time between
+ * groups that always have work by their weights, and lets a group that was
+ * idle resume without starving the others.  Then the behaviours of a tenant
+ * that floods the runtime, and of one that does not, all run in order on
+ * their cowns, and the time each group ran for is counted.  Finally, with
+ * two tenants backlogged on one core, each gets a share of it by weight.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t ROUNDS = 400;
+static constexpr uint64_t TICKS = 100;
+static constexpr size_t FLOOD = 1000;
+static constexpr size_t TRICKLE = 10;
+
+void test_stride()
+{
+  SchedulingGroups groups;
+  Work* work[SCHEDULING_GROUPS];
+  for (auto& w : work)
+    w = Closure::make([](Work*) { return true; });
+  auto weight = [](size_t group) -> size_t { return group == 2 ? 3 : 1; };
+
+  // Group 1 of weight 1 and group 2 of weight 3, both always busy.
+  size_t runs[SCHEDULING_GROUPS] = {};
+  auto round = [&]() {
+    auto group = groups.pick(groups, false);
+    check(group != 0);
+    check(groups.dequeue(group) == work[group]);
+    runs[group]++;
+    groups.charge(group, TICKS, weight(group));
+    groups.enqueue(work[group], group);
+  };
+
+  groups.enqueue(work[1], 1);
+  groups.enqueue(work[2], 2);
+  for (size_t i = 0; i < ROUNDS; i++)
+    round();
+  check(runs[1] + runs[2] == ROUNDS);
+  check(runs[2] >= 2 * runs[1]);
+  check(runs[2] <= 4 * runs[1]);
+
+  // Group 3 was idle, so it runs next, and then takes turns with the
+  // others, rather than running for all the time it missed.
+  groups.enqueue(work[3], 3);
+  check(groups.pick(groups, false) == 3);
+  for (size_t i = 0; i < 10; i++)
+    round();
+  check(runs[3] <= 4);
+
+  // The default group runs while it has the smallest pass.
+  check(groups.pick(groups, true) == 0);
+
+  for (size_t group = 1; group <= 3; group++)
+    check(groups.dequeue(group) == work[group]);
+  check(groups.is_empty());
+  for (auto w : work)
+    w->run();
+}
+
+struct Log
+{
+  size_t next = 0;
+};
+
+void test_tenants()
+{
+  Scheduler::set_group_weight(2, 4);
+
+  auto noisy = make_cown<Log>();
+  noisy.set_group(1);
+  auto quiet = make_cown<Log>();
+  quiet.set_group(2);
+  auto done = make_cown<Log>();
+
+  for (size_t i = 0; i < FLOOD; i++)
+  {
+    when(noisy) << [i](acquired_cown<Log> l) { check(l->next++ == i); };
+  }
+  for (size_t i = 0; i < TRICKLE; i++)
+  {
+    when(quiet) << [i](acquired_cown<Log> l) { check(l->next++ == i); };
+  }
+
+  when(noisy, quiet, done) <<
+    [](acquired_cown<Log> n, acquired_cown<Log> q, acquired_cown<Log>) {
+      check(n->next == FLOOD);
+      check(q->next == TRICKLE);
+    };
+}
+
+/// Behaviours of each tenant in `test_weights`, and how long each runs.
+static constexpr size_t BACKLOG = 200;
+static constexpr size_t BUSY_USEC = 10;
+
+std::atomic<size_t> light_done{0};
+std::atomic<size_t> heavy_done{0};
+std::atomic<size_t> light_when_heavy_done{0};
+
+/**
+ * Two tenants with a backlog of the same work, each behaviour on a cown of
+ * its own so all of it is queued at once, the second with four times the
+ * weight of the first.  On one core, the light tenant has run about a
+ * quarter of its backlog by the time the heavy one has run all of its own.
+ */
+void test_weights()
+{
+  Scheduler::set_group_weight(1, 1);
+  Scheduler::set_group_weight(2, 4);
+  light_done = 0;
+  heavy_done = 0;
+
+  for (size_t i = 0; i < BACKLOG; i++)
+  {
+    auto light = make_cown<Log>();
+    light.set_group(1);
+    when(light) << [](acquired_cown<Log>) {
+      busy_loop(BUSY_USEC);
+      light_done++;
+    };
+
+    auto heavy = make_cown<Log>();
+    heavy.set_group(2);
+    when(heavy) << [](acquired_cown<Log>) {
+      busy_loop(BUSY_USEC);
+      if (++heavy_done == BACKLOG)
+        light_when_heavy_done = light_done.load();
+    };
+  }
+}
+
+static size_t group_runs(const SchedulerStats::Snapshot& s, size_t group)
+{
+  return s[SchedulerStats::Group + (2 * group)];
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  test_stride();
+  check(SchedulerStats::name(SchedulerStats::Group + 3) == "Group 1 ticks");
+
+  auto before = Scheduler::stats_snapshot();
+  harness.run(test_tenants);
+#ifndef USE_SCHED_STATS
+  // Such builds dump and reset the counters when the runtime stops.
+  auto after = Scheduler::stats_snapshot();
+  check(group_runs(after, 1) - group_runs(before, 1) >= FLOOD);
+  check(group_runs(after, 2) - group_runs(before, 2) >= TRICKLE);
+  check(after[SchedulerStats::Group + 3] > before[SchedulerStats::Group + 3]);
+#else
+  UNUSED(before);
+#endif
+
+  // Measure the split on one core, where it does not depend on how the
+  // backlog is spread across the cores.
+  harness.cores = 1;
+  harness.run(test_weights);
+  check(light_when_heavy_done >= BACKLOG / 8);
+  check(light_when_heavy_done <= BACKLOG / 3);
+
+  return 0;
+}
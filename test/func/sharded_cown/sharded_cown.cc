@@ -0,0 +1,85 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `sharded_cown`: updates to keys routed to their shards are not
+ * lost when shards are split between them, and afterwards every key is held
+ * by exactly the shard it is routed to.
+ */
+#include <cpp/sharded_cown.h>
+#include <debug/harness.h>
+#include <map>
+
+using namespace verona::cpp;
+
+static constexpr size_t KEYS = 256;
+static constexpr size_t ROUNDS = 8;
+
+using Counts = std::map<size_t, size_t>;
+
+static void move_keys(Counts& from, Counts& to, std::function<bool(size_t)> m)
+{
+  for (auto it = from.begin(); it != from.end();)
+  {
+    if (m(it->first))
+    {
+      to.insert(*it);
+      it = from.erase(it);
+    }
+    else
+      ++it;
+  }
+}
+
+static auto make_counts = []() { return make_cown<Counts>(); };
+
+static std::atomic<size_t> checks = 0;
+
+void test_sharded()
+{
+  auto counts = make_sharded_cown<Counts>(4);
+
+  for (size_t round = 0; round < ROUNDS; round++)
+  {
+    {
+      auto r = counts.route();
+      for (size_t k = 0; k < KEYS; k++)
+        when(r.shard_for(k)) << [k](acquired_cown<Counts> c) { (*c)[k]++; };
+    }
+
+    if (round % 2 == 0)
+      check(counts.split(round % 3, make_counts, move_keys));
+    else
+      counts.rebalance(0, make_counts, move_keys);
+  }
+
+  auto r = counts.route();
+  check(r.shard_count() == 4 + ROUNDS);
+
+  for (size_t k = 0; k < KEYS; k++)
+  {
+    when(r.shard_for(k)) << [k](acquired_cown<Counts> c) {
+      check(c->count(k) == 1);
+      check(c->at(k) == ROUNDS);
+      checks++;
+    };
+  }
+
+  when(r.all_shards()) << [](acquired_cown_span<Counts> shards) {
+    size_t keys = 0;
+    for (size_t i = 0; i < shards.length; i++)
+      keys += shards.array[i]->size();
+    check(keys == KEYS);
+    checks++;
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_sharded);
+  check(checks == KEYS + 1);
+
+  return 0;
+}
@@ -0,0 +1,93 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that in share-nothing mode behaviours run on the core their cowns
+ * are bound to, see `ThreadPool::set_share_nothing`.
+ *
+ * Each core has a cown bound to it, and behaviours on each cown send more
+ * to the next core's cown, so work crosses between every pair of
+ * neighbouring cores.  Behaviours on cowns bound to different cores may run
+ * anywhere, but must still run.  A cown created inside a behaviour is bound
+ * to the core it was created on.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t ROUNDS = 20;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+static std::atomic<size_t> bound_run = 0;
+static std::atomic<size_t> spanning_run = 0;
+
+static void check_core(size_t index)
+{
+  check(Scheduler::local_core() == Scheduler::get_core(index));
+}
+
+void test_share_nothing(size_t cores)
+{
+  std::vector<cown_ptr<Counter>> cowns;
+  for (size_t i = 0; i < cores; i++)
+  {
+    cowns.push_back(make_cown<Counter>());
+    cowns.back().set_home_core(Scheduler::get_core(i));
+  }
+
+  for (size_t i = 0; i < cores; i++)
+  {
+    auto next = cowns[(i + 1) % cores];
+    for (size_t r = 0; r < ROUNDS; r++)
+    {
+      when(cowns[i]) << [i, cores, next](acquired_cown<Counter> c) {
+        check_core(i);
+        c->count++;
+        bound_run++;
+
+        when(next) << [i, cores](acquired_cown<Counter> c) {
+          check_core((i + 1) % cores);
+          c->count++;
+          bound_run++;
+        };
+      };
+    }
+
+    when(cowns[i], next) << [](acquired_cown<Counter> a, auto) {
+      a->count++;
+      spanning_run++;
+    };
+  }
+
+  for (size_t i = 0; i < cores; i++)
+  {
+    when().on(Scheduler::get_core(i)) << [i]() {
+      auto c = make_cown<Counter>();
+      when(c) << [i](acquired_cown<Counter> c) {
+        check_core(i);
+        c->count++;
+        bound_run++;
+      };
+    };
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  Scheduler::set_share_nothing(true);
+  harness.run(test_share_nothing, harness.cores);
+  Scheduler::set_share_nothing(false);
+
+  auto seeds = harness.seed_upper - harness.seed_lower;
+  check(bound_run == ((2 * ROUNDS) + 1) * harness.cores * seeds);
+  check(spanning_run == harness.cores * seeds);
+
+  return 0;
+}
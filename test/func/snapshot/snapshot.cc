@@ -0,0 +1,153 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <cstdio>
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace snmalloc;
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+/**
+ * Tests writing a frozen graph, with shared nodes and a cycle, to a snapshot
+ * and loading it back, and that graphs which cannot be saved are refused.
+ **/
+
+static const char* PATH = "snapshot_test.bin";
+
+struct Leaf : public V<Leaf>
+{
+  int value;
+
+  static constexpr bool no_pointers = true;
+
+  Leaf(int v = 0) : value(v) {}
+};
+
+struct Node : public V<Node>
+{
+  Node* left = nullptr;
+  int value = 0;
+  Node* right = nullptr;
+  Leaf* leaf = nullptr;
+
+  using fields = Fields<&Node::left, &Node::right, &Node::leaf>;
+
+  Node(int v = 0) : value(v) {}
+};
+
+/// Not registered, so cannot be saved.
+struct Other : public V<Other>
+{
+  static constexpr bool no_pointers = true;
+};
+
+Node* make_tree(int depth, int value)
+{
+  auto* n = new Node(value);
+  n->leaf = new Leaf(value * 10);
+  if (depth > 0)
+  {
+    n->left = make_tree(depth - 1, value * 2);
+    n->right = make_tree(depth - 1, value * 2 + 1);
+  }
+  return n;
+}
+
+void check_tree(Node* n, int depth, int value)
+{
+  check(n->value == value);
+  check(n->leaf->value == value * 10);
+  if (depth == 0)
+  {
+    check(n->left == nullptr);
+    check(n->right == nullptr);
+    return;
+  }
+  check_tree(n->left, depth - 1, value * 2);
+  check_tree(n->right, depth - 1, value * 2 + 1);
+}
+
+void test_register()
+{
+  check(Snapshot::register_type(1, Node::desc()));
+  check(Snapshot::register_type(2, Leaf::desc()));
+  check(!Snapshot::register_type(1, Other::desc()));
+  check(!Snapshot::register_type(3, Node::desc()));
+}
+
+void test_round_trip()
+{
+  // The root shares its right subtree with its left child, and the left
+  // child points back at the root.
+  auto* root = new (RegionType::Trace) Node(1);
+  {
+    UsingRegion rr(root);
+    root->left = new Node(2);
+    root->right = make_tree(3, 3);
+    root->left->left = root;
+    root->left->right = root->right;
+  }
+  freeze(root);
+  check(Snapshot::write(root, PATH));
+  Immutable::release(root);
+
+  auto* s = Snapshot::load(PATH);
+  check(s != nullptr);
+
+  auto* loaded = (Node*)s->get_root();
+  check(loaded->debug_is_immutable());
+  check(loaded->value == 1);
+  check(loaded->leaf == nullptr);
+  check(loaded->left->value == 2);
+  check(loaded->left->left == loaded);
+  check(loaded->left->right == loaded->right);
+  check_tree(loaded->right, 3, 3);
+
+  // The whole graph is a single SCC, owned by the snapshot.
+  check(loaded->right->leaf->debug_immutable_root() == loaded);
+  check(loaded->debug_test_rc(1));
+  Immutable::acquire(loaded->right);
+  check(loaded->debug_test_rc(2));
+  Immutable::release(loaded->right);
+
+  Snapshot::destroy(s);
+  std::remove(PATH);
+  heap::debug_check_empty();
+}
+
+void test_refused()
+{
+  // Mutable objects cannot be saved.
+  auto* mutable_root = new (RegionType::Trace) Node;
+  check(!Snapshot::write(mutable_root, PATH));
+  region_release(mutable_root);
+
+  // Nor can objects of unregistered types.
+  auto* other = new (RegionType::Trace) Other;
+  freeze(other);
+  check(!Snapshot::write(other, PATH));
+  Immutable::release(other);
+
+  // A file that is not a snapshot is not loaded.
+  FILE* f = fopen(PATH, "wb");
+  fputs("not a snapshot", f);
+  fclose(f);
+  check(Snapshot::load(PATH) == nullptr);
+  std::remove(PATH);
+  check(Snapshot::load(PATH) == nullptr);
+
+  heap::debug_check_empty();
+}
+
+int main(int argc, char** argv)
+{
+  (void)argc;
+  (void)argv;
+
+  test_register();
+  test_round_trip();
+  test_refused();
+
+  return 0;
+}
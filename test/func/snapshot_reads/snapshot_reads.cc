@@ -0,0 +1,83 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `cown_ptr::read_snapshot`.  Writers keep two fields of a cown
+ * equal, and readers that race with them must only ever see a consistent
+ * value, which never goes backwards.  Once no writer is running, the
+ * snapshot is the value the last writer left.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+struct Pair
+{
+  size_t first = 0;
+  size_t second = 0;
+};
+
+template<>
+struct verona::cpp::snapshot_reads<Pair> : std::true_type
+{};
+
+struct Reader
+{};
+
+static constexpr size_t ROUNDS = 20;
+
+void test_snapshot()
+{
+  auto pair = make_cown<Pair>();
+  auto reader = make_cown<Reader>();
+
+  auto initial = pair.read_snapshot();
+  check(initial->first == 0);
+  check(initial->second == 0);
+
+  for (size_t i = 0; i < ROUNDS; i++)
+  {
+    when(pair) << [](acquired_cown<Pair> p) {
+      p->first++;
+      yield();
+      p->second++;
+    };
+
+    // Runs alongside the writers, as it does not wait for `pair`.
+    when(reader) << [pair](acquired_cown<Reader>) {
+      size_t last = 0;
+      for (size_t j = 0; j < 4; j++)
+      {
+        auto s = pair.read_snapshot();
+        check(s->first == s->second);
+        check(s->first >= last);
+        check(s->first <= ROUNDS);
+        last = s->first;
+        yield();
+      }
+    };
+  }
+
+  // Ordered after every write, and nothing writes while it runs.
+  when(read(pair)) << [pair](acquired_cown<const Pair> p) {
+    auto s = pair.read_snapshot();
+    check(s->first == ROUNDS);
+    check(s->first == p->first);
+    check(s->second == p->second);
+  };
+
+  // The snapshot taken at the start is unchanged by the writes.
+  when(reader) << [initial](acquired_cown<Reader>) {
+    check(initial->first == 0);
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_snapshot);
+
+  return 0;
+}
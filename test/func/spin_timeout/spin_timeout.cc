@@ -0,0 +1,80 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks the conversion of nanoseconds to ticks, and that work trickling
+ * in from outside the runtime is all run whether idle threads spin for a
+ * long time, pause straight away, or adapt, see
+ * `ThreadPool::set_spin_timeout`.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <thread>
+
+using namespace verona::cpp;
+using namespace std::chrono_literals;
+
+static constexpr size_t EVENTS = 20;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+static std::atomic<size_t> handled = 0;
+
+static void test_tick_rate()
+{
+  check(Clock::ticks_per_ns() > 0);
+  auto ticks = Clock::from_ns(1'000'000);
+  auto ns = Clock::to_ns(ticks);
+  check((ns > 990'000) && (ns < 1'010'000));
+}
+
+void test_trickle(SystematicTestHarness* harness)
+{
+  handled = 0;
+  auto counter = make_cown<Counter>();
+
+  when() << [harness, counter]() {
+    Scheduler::add_external_event_source();
+    harness->external_thread([counter]() {
+      for (size_t i = 0; i < EVENTS; i++)
+      {
+        // Long enough for the threads to go idle.
+        std::this_thread::sleep_for(50us);
+        when(counter) << [](acquired_cown<Counter> c) {
+          c->count++;
+          handled++;
+        };
+      }
+
+      when(counter) << [](acquired_cown<Counter> c) {
+        check(c->count == EVENTS);
+        Scheduler::remove_external_event_source();
+      };
+    });
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  test_tick_rate();
+
+  // Spin for longer than the gaps, pause straight away, and adapt.
+  Scheduler::set_spin_timeout(1ms, 1ms, false);
+  harness.run(test_trickle, &harness);
+  check(handled == EVENTS);
+
+  Scheduler::set_spin_timeout(0ns, 0ns, false);
+  harness.run(test_trickle, &harness);
+  check(handled == EVENTS);
+
+  Scheduler::set_spin_timeout(400us, 4us);
+  harness.run(test_trickle, &harness);
+  check(handled == EVENTS);
+
+  return 0;
+}
@@ -83,17 +83,42 @@ void test_size_t(size_t i)
   std::cout << "." << std::flush;
 }
 
+// Test elements of non-trivial types are still constructed and destroyed,
+// when elements of trivial types are left uninitialised.
+void test_uninitialised(size_t i)
+{
+  {
+    StackArray<Both> a(i, StackArray<Both>::uninitialised);
+    if (c != i)
+      abort();
+    c = 0;
+  }
+  if (d != i)
+    abort();
+  d = 0;
+
+  StackArray<size_t> b(i, StackArray<size_t>::uninitialised);
+  for (size_t j = 0; j < i; j++)
+    b[j] = j;
+  for (size_t j = 0; j < i; j++)
+    if (b[j] != j)
+      abort();
+  std::cout << "." << std::flush;
+}
+
 int main()
 {
   test_c(10);
   test_d(10);
   test_both(10);
   test_size_t(10);
+  test_uninitialised(10);
 
   test_c(200);
   test_d(200);
   test_both(200);
   test_size_t(200);
+  test_uninitialised(200);
 
   std::cout << std::endl;
 }
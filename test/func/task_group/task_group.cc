@@ -0,0 +1,71 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that the continuation of a `task_group` runs once, after every
+ * task of the group, including tasks spawned by other tasks, and for a
+ * group with no tasks.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t SIZE = 1 << 12;
+static constexpr size_t LEAF = 64;
+
+static size_t data[SIZE];
+static std::atomic<size_t> total = 0;
+static std::atomic<size_t> continuations = 0;
+
+/// Sum `data[lo..hi)` into `total`, splitting the range into tasks.
+static void sum(task_group g, size_t lo, size_t hi)
+{
+  if (hi - lo <= LEAF)
+  {
+    size_t s = 0;
+    for (size_t i = lo; i < hi; i++)
+      s += data[i];
+    total += s;
+    return;
+  }
+
+  size_t mid = lo + (hi - lo) / 2;
+  g.spawn([g, lo, mid]() { sum(g, lo, mid); });
+  g.spawn([g, mid, hi]() { sum(g, mid, hi); });
+}
+
+void test_sum()
+{
+  total = 0;
+  continuations = 0;
+  for (size_t i = 0; i < SIZE; i++)
+    data[i] = i;
+
+  task_group g;
+  sum(g, 0, SIZE);
+  g.then([]() {
+    check(total == SIZE * (SIZE - 1) / 2);
+    continuations++;
+  });
+}
+
+void test_empty()
+{
+  continuations = 0;
+  task_group g;
+  g.then([]() { continuations++; });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_sum);
+  check(continuations == 1);
+
+  harness.run(test_empty);
+  check(continuations == 1);
+
+  return 0;
+}
@@ -0,0 +1,75 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `TimerWheel`.  One-shot timers never fire early, and a periodic
+ * notification keeps firing, while holding the runtime open, until it is
+ * cancelled.
+ */
+#include <debug/harness.h>
+
+static constexpr size_t TIMERS = 8;
+static constexpr size_t REPEATS = 5;
+
+std::atomic<size_t> fired{0};
+
+void test_after()
+{
+  fired = 0;
+  schedule_lambda([]() {
+    for (size_t i = 0; i < TIMERS; i++)
+    {
+      auto delay = std::chrono::milliseconds(i % 3);
+      auto due = DeadlineQueue::now() +
+        std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count();
+      schedule_lambda_after(delay, [due]() {
+        check(DeadlineQueue::now() >= due);
+        fired++;
+      });
+    }
+  });
+}
+
+struct Ticker : public VCown<Ticker>
+{
+  size_t ticks = 0;
+  TimerWheel::Timer* timer = nullptr;
+
+  ~Ticker()
+  {
+    check(ticks >= REPEATS);
+  }
+};
+
+void test_every()
+{
+  auto t = new Ticker;
+
+  schedule_lambda(t, [t]() {
+    auto n = make_notification(t, [t]() {
+      if (++t->ticks == REPEATS)
+        TimerWheel::cancel(t->timer);
+    });
+    t->timer = TimerWheel::every(std::chrono::milliseconds(1), n);
+    Shared::release(n);
+  });
+
+  schedule_lambda(t, [t]() {
+    // Runs before any tick, as the ticks queue behind it.
+    check(t->ticks == 0);
+  });
+
+  Cown::release(t);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_after);
+  check(fired == TIMERS);
+
+  harness.run(test_every);
+
+  return 0;
+}
@@ -0,0 +1,78 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks that the binary trace records behaviours, and the handoffs of
+ * cowns between them, and can be dumped and read back.
+ */
+#define USE_TRACE
+
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <fstream>
+#include <vector>
+
+using namespace verona::cpp;
+
+static constexpr size_t BEHAVIOURS = 10;
+static constexpr const char* PATH = "func-trace.bin";
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+void test_trace()
+{
+  auto counter = make_cown<Counter>();
+  for (size_t i = 0; i < BEHAVIOURS; i++)
+    when(counter) << [](acquired_cown<Counter> c) { c->count++; };
+}
+
+void check_dump()
+{
+  check(Trace::dump(PATH));
+
+  std::ifstream in(PATH, std::ios::binary);
+  TraceFileHeader header;
+  std::vector<TraceThread> threads;
+  check(read_trace(in, header, threads));
+  check(header.ticks_per_us > 0);
+
+  size_t starts = 0;
+  size_t ends = 0;
+  size_t handoffs = 0;
+  for (auto& t : threads)
+  {
+    for (size_t i = 0; i < t.events.size(); i++)
+    {
+      auto& e = t.events[i];
+      if (e.kind == TraceKind::BehaviourStart)
+        starts++;
+      else if (e.kind == TraceKind::BehaviourEnd)
+        ends++;
+      else if (e.kind == TraceKind::HandoffTo)
+      {
+        check(i > 0);
+        check(t.events[i - 1].kind == TraceKind::Handoff);
+        handoffs++;
+      }
+    }
+  }
+
+  // Only the most recent events are kept, but these runs are short.
+  check(starts >= BEHAVIOURS);
+  check(starts == ends);
+  // Each behaviour on the cown, but the first, waits for the one before.
+  check(handoffs >= BEHAVIOURS - 1);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_trace);
+  check_dump();
+
+  return 0;
+}
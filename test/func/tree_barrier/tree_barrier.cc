@@ -0,0 +1,48 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks `TreeBarrier` for numbers of threads that fill the tree to
+ * different depths, some not multiples of its fan in: no thread may leave a
+ * round before every thread has arrived at it.
+ */
+#include <debug/harness.h>
+#include <sched/treebarrier.h>
+#include <thread>
+
+using namespace verona::rt;
+
+static constexpr size_t ROUNDS = 100;
+
+void test_barrier(size_t threads)
+{
+  TreeBarrier barrier;
+  barrier.init(threads);
+  std::atomic<size_t> arrived{0};
+
+  std::vector<std::thread> workers;
+  for (size_t slot = 0; slot < threads; slot++)
+  {
+    workers.emplace_back([&, slot]() {
+      for (size_t round = 0; round < ROUNDS; round++)
+      {
+        arrived++;
+        barrier.arrive(slot);
+        check(arrived >= (round + 1) * threads);
+        barrier.arrive(slot);
+      }
+    });
+  }
+
+  for (auto& w : workers)
+    w.join();
+  check(arrived == ROUNDS * threads);
+}
+
+int main(int, char**)
+{
+  for (size_t threads : {1, 2, 3, 4, 5, 16, 17})
+    test_barrier(threads);
+
+  return 0;
+}
@@ -0,0 +1,130 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <debug/harness.h>
+#include <verona.h>
+
+using namespace snmalloc;
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+/**
+ * Tests objects traced through the field offsets of their descriptors rather
+ * than a trace method.
+ **/
+
+static int live = 0;
+
+struct Leaf : public V<Leaf>
+{
+  int value;
+
+  static constexpr bool no_pointers = true;
+
+  Leaf(int v = 0) : value(v)
+  {
+    live++;
+  }
+
+  ~Leaf()
+  {
+    live--;
+  }
+};
+
+struct Node : public V<Node>
+{
+  Node* left = nullptr;
+  int padding = 0;
+  Node* right = nullptr;
+  Leaf* leaf = nullptr;
+
+  using fields = Fields<&Node::left, &Node::right, &Node::leaf>;
+
+  Node()
+  {
+    live++;
+  }
+
+  ~Node()
+  {
+    live--;
+  }
+};
+
+Node* make_tree(size_t depth)
+{
+  auto* n = new Node;
+  n->leaf = new Leaf((int)depth);
+  if (depth > 0)
+  {
+    n->left = make_tree(depth - 1);
+    n->right = make_tree(depth - 1);
+  }
+  return n;
+}
+
+void test_descriptor()
+{
+  auto* desc = Node::desc();
+  check(desc->fields != nullptr);
+  check(desc->field_count == 3);
+
+  auto* leaf = Leaf::desc();
+  check(leaf->fields != nullptr);
+  check(leaf->field_count == 0);
+}
+
+void test_gc()
+{
+  auto* root = new (RegionType::Trace) Node;
+  {
+    UsingRegion rr(root);
+    root->left = make_tree(3);
+    root->right = make_tree(3);
+  }
+  // Each tree of depth 3 has 15 nodes and 15 leaves.
+  check(live == 61);
+
+  {
+    UsingRegion rr(root);
+    region_collect();
+    check(live == 61);
+
+    root->right = nullptr;
+    region_collect();
+    check(live == 31);
+  }
+
+  region_release(root);
+  check(live == 0);
+  heap::debug_check_empty();
+}
+
+void test_freeze()
+{
+  auto* root = new (RegionType::Trace) Node;
+  {
+    UsingRegion rr(root);
+    root->left = make_tree(2);
+    root->leaf = new Leaf;
+  }
+
+  freeze(root);
+  check(root->debug_is_rc());
+
+  Immutable::release(root);
+  check(live == 0);
+  heap::debug_check_empty();
+}
+
+int main(int argc, char** argv)
+{
+  (void)argc;
+  (void)argv;
+
+  test_descriptor();
+  test_gc();
+  test_freeze();
+
+  return 0;
+}
@@ -0,0 +1,92 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+/**
+ * Behaviours whose cowns and closure fit without allocating beyond the
+ * behaviour: `when_noalloc`, and batches small enough to be held inline,
+ * alongside batches that are not.
+ */
+
+using namespace verona::cpp;
+
+struct Account
+{
+  size_t balance = 0;
+};
+
+static constexpr size_t ROUNDS = 10;
+static constexpr size_t COWNS = 2 * AccessBatch<Account>::INLINE_COWNS;
+
+void test_noalloc()
+{
+  auto a = make_cown<Account>();
+  auto b = make_cown<Account>();
+
+  for (size_t i = 0; i < ROUNDS; i++)
+  {
+    when_noalloc(a) << [i](acquired_cown<Account> x) { x->balance += i; };
+    when_noalloc(b, read(a)) <<
+      [](acquired_cown<Account> x, acquired_cown<const Account> y) {
+        x->balance += y->balance;
+      };
+  }
+
+  when_noalloc(read(b)).with_priority(Priority::High) <<
+    [](acquired_cown<const Account> x) {
+      // b adds the running sum of a after each round.
+      size_t expected = 0;
+      for (size_t i = 0; i < ROUNDS; i++)
+        expected += i * (i + 1) / 2;
+      check(x->balance == expected);
+    };
+}
+
+void test_batches()
+{
+  cown_ptr<Account> cowns[COWNS];
+  for (auto& c : cowns)
+    c = make_cown<Account>();
+
+  auto extra = make_cown<Account>();
+
+  for (size_t n = 1; n <= COWNS; n++)
+  {
+    cown_array<Account> batch{cowns, n};
+    when(batch) << [n](acquired_cown_span<Account> s) {
+      check(s.length == n);
+      for (size_t i = 0; i < s.length; i++)
+        s.array[i]->balance++;
+    };
+
+    // A batch with another cown builds its requests in the `When`.
+    when(batch, extra) <<
+      [n](acquired_cown_span<Account> s, acquired_cown<Account> e) {
+        check(s.length == n);
+        for (size_t i = 0; i < s.length; i++)
+          s.array[i]->balance++;
+        e->balance++;
+      };
+  }
+
+  cown_array<Account> all{cowns, COWNS};
+  when(all, extra) <<
+    [](acquired_cown_span<Account> s, acquired_cown<Account> e) {
+      // Cown i is in the batches of length i + 1 and above, twice each.
+      for (size_t i = 0; i < s.length; i++)
+        check(s.array[i]->balance == 2 * (COWNS - i));
+      check(e->balance == COWNS);
+    };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_noalloc);
+  harness.run(test_batches);
+
+  return 0;
+}
@@ -0,0 +1,153 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks the Chase-Lev deque behind `Core::local_q`, first on one thread,
+ * where the owner takes the newest work and thieves and `take_all` the
+ * oldest, and then with an owner pushing and popping while thieves steal,
+ * where every item must be taken exactly once.
+ */
+#include <debug/harness.h>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <verona.h>
+
+using namespace verona::rt;
+
+static std::vector<Work*> make_items(size_t count)
+{
+  std::vector<Work*> items;
+  for (size_t i = 0; i < count; i++)
+    items.push_back(Closure::make([](Work*) { return true; }));
+  return items;
+}
+
+static void free_items(std::vector<Work*>& items)
+{
+  for (auto w : items)
+    w->run();
+  items.clear();
+}
+
+void test_sequential()
+{
+  auto q = std::make_unique<WorkDeque<8>>();
+  auto items = make_items(8);
+  QueueStatus status;
+
+  check(q->is_empty());
+  check(q->pop() == nullptr);
+  check(q->steal(status) == nullptr);
+  check(status == QueueStatus::Empty);
+
+  for (size_t lap = 0; lap < 4; lap++)
+  {
+    for (auto w : items)
+      check(q->push(w));
+    check(!q->push(items[0]));
+
+    check(q->pop() == items[7]);
+    check(q->steal(status) == items[0]);
+    check(status == QueueStatus::Taken);
+    check(q->pop() == items[6]);
+
+    auto [segment, count] = q->take_all();
+    check(count == 4);
+    auto w = segment.start;
+    for (size_t i = 1; i < 5; i++)
+    {
+      check(w == items[i]);
+      if (i < 4)
+        w = w->next_in_queue.load();
+    }
+    check(segment.end == &items[4]->next_in_queue);
+    check(q->is_empty());
+    check(q->pop() == nullptr);
+  }
+
+  free_items(items);
+}
+
+void test_concurrent()
+{
+  static constexpr size_t THIEVES = 3;
+  static constexpr size_t COUNT = 100000;
+
+  auto q = std::make_unique<WorkDeque<64>>();
+  auto items = make_items(COUNT);
+  std::unordered_map<Work*, size_t> index;
+  for (size_t i = 0; i < COUNT; i++)
+    index[items[i]] = i;
+
+  std::vector<std::atomic<size_t>> seen(COUNT);
+  std::atomic<size_t> taken{0};
+  auto take = [&](Work* w) {
+    check(seen[index.at(w)].fetch_add(1) == 0);
+    taken++;
+  };
+
+  std::vector<std::thread> thieves;
+  for (size_t t = 0; t < THIEVES; t++)
+  {
+    thieves.emplace_back([&]() {
+      while (taken.load() < COUNT)
+      {
+        QueueStatus status;
+        auto w = q->steal(status);
+        if (w != nullptr)
+          take(w);
+        else
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  // The owner pushes everything, popping one item after every other push,
+  // and handing over the rest with `take_all` from time to time.
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    while (!q->push(items[i]))
+    {
+      auto w = q->pop();
+      if (w != nullptr)
+        take(w);
+    }
+
+    if ((i % 2) == 1)
+    {
+      auto w = q->pop();
+      if (w != nullptr)
+        take(w);
+    }
+
+    if ((i % 1000) == 999)
+    {
+      auto [segment, count] = q->take_all();
+      auto w = segment.start;
+      for (size_t j = 0; j < count; j++)
+      {
+        auto next = w->next_in_queue.load();
+        take(w);
+        w = next;
+      }
+    }
+  }
+
+  while (auto w = q->pop())
+    take(w);
+
+  for (auto& t : thieves)
+    t.join();
+
+  check(taken == COUNT);
+  free_items(items);
+}
+
+int main(int, char**)
+{
+  test_sequential();
+  test_concurrent();
+  return 0;
+}
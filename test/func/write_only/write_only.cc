@@ -0,0 +1,79 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks cowns of a `write_only_cown` type.  They are smaller than other
+ * cowns, and behaviours on them, alone or with cowns that are read, run
+ * exclusively and in order.
+ */
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+template<>
+struct verona::cpp::write_only_cown<Counter> : std::true_type
+{};
+
+struct Total
+{
+  size_t value = 0;
+};
+
+static constexpr size_t ROUNDS = 20;
+
+void test_size()
+{
+  static_assert(
+    sizeof(ActualCown<Counter>) + 3 * sizeof(void*) ==
+    sizeof(ActualCown<Total>));
+}
+
+void test_order()
+{
+  auto c = make_cown<Counter>();
+
+  for (size_t i = 0; i < ROUNDS; i++)
+  {
+    when(c) << [i](acquired_cown<Counter> c) {
+      check(c->count == i);
+      yield();
+      c->count++;
+    };
+  }
+}
+
+void test_with_readers()
+{
+  auto c = make_cown<Counter>();
+  auto s = make_cown<Total>();
+
+  for (size_t i = 0; i < ROUNDS; i++)
+  {
+    when(s) << [](acquired_cown<Total> s) { s->value++; };
+
+    // The reader of `s` has the write only cown exclusively.
+    when(c, read(s)) << [i](acquired_cown<Counter> c,
+                             acquired_cown<const Total> s) {
+      check(c->count == i);
+      check(s->value == i + 1);
+      c->count++;
+    };
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_size);
+  harness.run(test_order);
+  harness.run(test_with_readers);
+
+  return 0;
+}
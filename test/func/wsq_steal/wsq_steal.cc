@@ -0,0 +1,179 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Checks the steal modes of `WorkStealingQueue`, first with a single steal
+ * from a victim, where the mode decides how much the thief takes and how
+ * much goes back, and then with an owner queuing and taking work while
+ * thieves steal from it and from each other, where every item must be
+ * taken exactly once.
+ */
+#include <debug/harness.h>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <verona.h>
+
+using namespace verona::rt;
+
+static constexpr size_t QUEUES = 4;
+using Queue = WorkStealingQueue<QUEUES>;
+
+static std::vector<Work*> make_items(size_t count)
+{
+  std::vector<Work*> items;
+  for (size_t i = 0; i < count; i++)
+    items.push_back(Closure::make([](Work*) { return true; }));
+  return items;
+}
+
+static void free_items(std::vector<Work*>& items)
+{
+  for (auto w : items)
+    w->run();
+  items.clear();
+}
+
+static size_t drain(Queue& q, std::unordered_map<Work*, size_t>& seen)
+{
+  size_t count = 0;
+  while (auto w = q.dequeue())
+  {
+    check(seen[w]++ == 0);
+    count++;
+  }
+  return count;
+}
+
+/**
+ * Steal once from a victim with `PER_QUEUE` items in each sub-queue, and
+ * check the thief takes `expected` of them, and the victim keeps the rest.
+ */
+void test_sequential(StealMode mode, size_t bound, size_t expected)
+{
+  static constexpr size_t PER_QUEUE = 10;
+  static constexpr size_t COUNT = QUEUES * PER_QUEUE;
+
+  auto victim = std::make_unique<Queue>();
+  auto thief = std::make_unique<Queue>();
+  thief->set_steal_mode(mode, bound);
+  auto items = make_items(COUNT);
+
+  for (auto w : items)
+    victim->enqueue(w);
+
+  QueueStatus status;
+  size_t moved;
+  auto r = thief->steal(*victim, status, moved);
+  check(r != nullptr);
+  check(moved + 1 == expected);
+
+  std::unordered_map<Work*, size_t> seen;
+  seen[r]++;
+  check(drain(*thief, seen) == moved);
+  check(drain(*victim, seen) == COUNT - expected);
+  check(seen.size() == COUNT);
+
+  free_items(items);
+}
+
+/**
+ * The owner of `queues[0]` queues every item, and takes some back, while
+ * the owners of the other queues steal from any queue but their own, and
+ * take what the steals moved to them.
+ */
+void test_concurrent(StealMode mode, size_t bound)
+{
+  static constexpr size_t THIEVES = 3;
+  static constexpr size_t COUNT = 100000;
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  for (size_t i = 0; i <= THIEVES; i++)
+  {
+    queues.push_back(std::make_unique<Queue>());
+    queues.back()->set_steal_mode(mode, bound);
+  }
+
+  auto items = make_items(COUNT);
+  std::unordered_map<Work*, size_t> index;
+  for (size_t i = 0; i < COUNT; i++)
+    index[items[i]] = i;
+
+  std::vector<std::atomic<size_t>> seen(COUNT);
+  std::atomic<size_t> taken{0};
+  auto take = [&](Work* w) {
+    check(seen[index.at(w)].fetch_add(1) == 0);
+    taken++;
+  };
+
+  std::vector<std::thread> thieves;
+  for (size_t t = 1; t <= THIEVES; t++)
+  {
+    thieves.emplace_back([&, t]() {
+      auto& self = *queues[t];
+      size_t victim = 0;
+      while (taken.load() < COUNT)
+      {
+        if (auto w = self.dequeue())
+        {
+          take(w);
+          continue;
+        }
+
+        // Visit the other queues in turn, mostly the owner's.
+        victim = (victim + 1) % (2 * THIEVES);
+        auto target = (victim < THIEVES) ? 0 : (victim - THIEVES + 1);
+        if (target == t)
+          target = 0;
+
+        if (auto w = self.steal(*queues[target]))
+          take(w);
+        else
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  // The owner queues everything, taking one item back after every other.
+  auto& owner = *queues[0];
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    owner.enqueue(items[i]);
+    if ((i % 2) == 1)
+    {
+      if (auto w = owner.dequeue())
+        take(w);
+    }
+  }
+
+  while (taken.load() < COUNT)
+  {
+    if (auto w = owner.dequeue())
+      take(w);
+    else
+      std::this_thread::yield();
+  }
+
+  for (auto& t : thieves)
+    t.join();
+
+  check(taken == COUNT);
+  for (auto& q : queues)
+    check(q->is_empty());
+  free_items(items);
+}
+
+int main(int, char**)
+{
+  test_sequential(StealMode::All, 0, 10);
+  test_sequential(StealMode::Half, 0, 5);
+  test_sequential(StealMode::Bounded, 3, 3);
+  test_sequential(StealMode::Bounded, 20, 10);
+
+  test_concurrent(StealMode::All, 0);
+  test_concurrent(StealMode::Half, 0);
+  test_concurrent(StealMode::Bounded, 1);
+  test_concurrent(StealMode::Bounded, 4);
+  return 0;
+}
@@ -133,6 +133,11 @@ void test_body()
 
 int verona_main(SystematicTestHarness& harness)
 {
+  // --home_affinity schedules each account's next transaction on the core
+  // that last wrote it, so that its state stays in that core's cache.
+  if (harness.opt.has("--home_affinity"))
+    Scheduler::set_cown_home_affinity(true);
+
   harness.run(test_body);
 
   return 0;
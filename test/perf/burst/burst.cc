@@ -0,0 +1,100 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Measures how quickly the runtime gets back to work after going idle.
+ *
+ * Each round is a burst of short behaviours, spread over all the cores,
+ * followed by an idle gap: the last behaviour of the burst sleeps, so that
+ * every other scheduler thread runs out of work and pauses at about the same
+ * moment.  The next burst is then scheduled from that behaviour, and has to
+ * wake them again.  This stresses the pause and unpause paths, and the lock
+ * that `ThreadSync` holds across them.
+ *
+ * The time taken from the start of each burst to the end of its last
+ * behaviour is written to standard error, as a median and maximum over the
+ * rounds.  The total time is reported by
+ * `PerfHarness`.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <debug/perfharness.h>
+#include <thread>
+
+using namespace verona::cpp;
+using clk = std::chrono::steady_clock;
+
+static constexpr size_t ROUNDS = 100;
+
+static size_t items = 0;
+static size_t idle_us = 1000;
+
+struct Burst
+{
+  size_t round = 0;
+  size_t remaining = 0;
+  clk::time_point start{};
+  std::vector<uint64_t> times;
+
+  ~Burst()
+  {
+    std::sort(times.begin(), times.end());
+    fprintf(
+      stderr,
+      "Burst of %zu: median %zu us max %zu us\n",
+      items,
+      (size_t)times[times.size() / 2],
+      (size_t)times.back());
+  }
+};
+
+static void start_burst(cown_ptr<Burst> burst)
+{
+  when(burst) << [burst](auto b) {
+    b->start = clk::now();
+    b->remaining = items;
+    for (size_t i = 0; i < items; i++)
+    {
+      when().on(Scheduler::get_core(i)) << [burst]() {
+        busy_loop(1);
+        when(burst) << [burst](auto b) {
+          if (--b->remaining != 0)
+            return;
+
+          b->times.push_back(
+            (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+              clk::now() - b->start)
+              .count());
+          if (++b->round == ROUNDS)
+            return;
+
+          // Idle long enough for every other thread to pause.
+          std::this_thread::sleep_for(std::chrono::microseconds(idle_us));
+          start_burst(burst);
+        };
+      };
+    }
+  };
+}
+
+void test()
+{
+  start_burst(make_cown<Burst>());
+}
+
+int main(int argc, char** argv)
+{
+  PerfHarness harness(argc, argv);
+
+  // --items is the number of behaviours in each burst, by default 64 per
+  // core, and --idle_us the gap between bursts.
+  items = harness.opt.is<size_t>("--items", 64 * harness.cores);
+  idle_us = harness.opt.is<size_t>("--idle_us", 1000);
+
+  harness.run("burst", test, ROUNDS * items);
+
+  return 0;
+}
@@ -0,0 +1,95 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Measures false sharing between a cown's payload and the runtime's fields.
+ * Each round schedules many read-only behaviours on a few cowns, so that
+ * the readers on every core update each cown's read count while reading its
+ * payload.  This is run with plain cowns and with `padded_cown`, and reports
+ * the cycles per behaviour.
+ */
+
+#include "debug/log.h"
+#include "test/opt.h"
+
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+namespace sn = snmalloc;
+namespace rt = verona::rt;
+using namespace verona::cpp;
+
+struct Plain
+{
+  size_t values[4] = {1, 2, 3, 4};
+};
+
+struct Padded
+{
+  size_t values[4] = {1, 2, 3, 4};
+};
+
+template<>
+struct verona::cpp::padded_cown<Padded> : std::true_type
+{};
+
+std::atomic<size_t> total{0};
+
+template<typename T>
+void run_readers(size_t cowns, size_t readers)
+{
+  for (size_t c = 0; c < cowns; c++)
+  {
+    auto cown = make_cown<T>();
+    for (size_t i = 0; i < readers; i++)
+    {
+      when(read(cown)) << [](acquired_cown<const T> t) {
+        size_t sum = 0;
+        for (auto v : t->values)
+          sum += v;
+        total.fetch_add(sum, std::memory_order_relaxed);
+      };
+    }
+  }
+}
+
+template<typename T>
+void bench(
+  const char* name, size_t cores, size_t cowns, size_t readers, size_t rounds)
+{
+  auto& sched = rt::Scheduler::get();
+  for (size_t r = 0; r < rounds; r++)
+  {
+    total = 0;
+    sched.init(cores);
+    when() << [cowns, readers]() { run_readers<T>(cowns, readers); };
+
+    auto start = sn::Aal::tick();
+    sched.run();
+    auto end = sn::Aal::tick();
+
+    check(total == cowns * readers * 10);
+    std::cout << name << ":" << (end - start) / (cowns * readers)
+              << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  for (int i = 0; i < argc; i++)
+  {
+    printf(" %s", argv[i]);
+  }
+  printf("\n");
+  opt::Opt opt(argc, argv);
+
+  const auto cores = opt.is<size_t>("--cores", 4);
+  const auto cowns = opt.is<size_t>("--cowns", 4);
+  const auto readers = opt.is<size_t>("--readers", 100000);
+  const auto rounds = opt.is<size_t>("--rounds", 5);
+
+  bench<Plain>("Plain", cores, cowns, readers, rounds);
+  bench<Padded>("Padded", cores, cowns, readers, rounds);
+
+  heap::debug_check_empty();
+}
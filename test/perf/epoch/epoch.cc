@@ -7,6 +7,29 @@
 using namespace snmalloc;
 using namespace verona::rt;
 
+/**
+ * Reports how the epoch advanced, and the most memory that was waiting on it,
+ * since it was constructed.
+ */
+struct EpochReport
+{
+  uint64_t epoch = GlobalEpoch::get();
+  size_t ejections = Epoch::ejections();
+  size_t max_pending = 0;
+
+  void sample()
+  {
+    max_pending = std::max(max_pending, Epoch::pending_bytes());
+  }
+
+  ~EpochReport()
+  {
+    std::cout << "  advances: " << (GlobalEpoch::get() - epoch)
+              << " ejections: " << (Epoch::ejections() - ejections)
+              << " max pending bytes: " << max_pending << std::endl;
+  }
+};
+
 void test_epoch()
 {
   // Used to prevent malloc from being optimised away.
@@ -20,13 +43,17 @@ void test_epoch()
   std::cout << "Start epoch test" << std::endl;
 
   {
+    EpochReport r;
     MeasureTime m;
     m << "with_epoch   ";
     for (int n = 0; n < count; n++)
     {
-      Epoch e;
-      obj = heap::alloc(size);
-      e.delete_in_epoch(obj);
+      {
+        Epoch e;
+        obj = heap::alloc(size);
+        e.delete_in_epoch(obj, size);
+      }
+      r.sample();
     }
 
     Epoch::flush();
@@ -54,6 +81,39 @@ void test_epoch()
     }
   }
 
+  {
+    // A burst of delayed deletes is performed a budget at a time as the epoch
+    // advances, so no single exit from an epoch should pay for all of it.
+    constexpr int burst = 1000000;
+    {
+      Epoch e;
+      for (int n = 0; n < burst; n++)
+        e.delete_in_epoch(heap::alloc(size), size);
+    }
+
+    uint64_t longest = 0;
+    {
+      EpochReport r;
+      MeasureTime m;
+      m << "after_burst  ";
+      for (int n = 0; n < count / 10; n++)
+      {
+        uint64_t start = Aal::tick();
+        {
+          Epoch e;
+          obj = heap::alloc(size);
+          e.delete_in_epoch(obj, size);
+        }
+        r.sample();
+        longest = std::max(longest, Aal::tick() - start);
+      }
+
+      Epoch::flush();
+    }
+    std::cout << "longest epoch exit after burst: " << longest << " ticks"
+              << std::endl;
+  }
+
   heap::dealloc(special);
   heap::debug_check_empty();
   (void)old;
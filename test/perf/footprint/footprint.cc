@@ -0,0 +1,121 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Measures the memory overhead of cowns and of behaviours waiting on them,
+ * for applications holding many cowns.
+ *
+ * The resident set grows as `--cowns` idle cowns are made, and as
+ * `--behaviours` behaviours are scheduled on a cown that is in use, so they
+ * are all pending.  The growth per cown, also for cowns of a
+ * `write_only_cown` type, and per pending behaviour are reported, with the
+ * static sizes they are made of, as CSV.  With
+ * `--max_cown_bytes` or `--max_behaviour_bytes`, the program fails if the
+ * growth exceeds the threshold, so that CI can catch regressions.
+ *
+ * The resident set is only read on Linux; elsewhere only the static sizes
+ * are reported.
+ */
+
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <fstream>
+#ifdef __linux__
+#  include <unistd.h>
+#endif
+
+using namespace verona::cpp;
+
+struct Empty
+{};
+
+struct WriteOnly
+{};
+
+template<>
+struct verona::cpp::write_only_cown<WriteOnly> : std::true_type
+{};
+
+static size_t rss_bytes()
+{
+#ifdef __linux__
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0;
+  size_t resident = 0;
+  statm >> pages >> resident;
+  return resident * (size_t)sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+/// Resident set growth per pending behaviour, measured inside the runtime.
+static double behaviour_bytes = 0;
+
+template<typename T>
+static double measure_cowns(size_t count)
+{
+  std::vector<cown_ptr<T>> cowns;
+  cowns.reserve(count);
+
+  auto before = rss_bytes();
+  for (size_t i = 0; i < count; i++)
+    cowns.push_back(make_cown<T>());
+  auto after = rss_bytes();
+
+  return ((double)after - (double)before) / (double)count;
+}
+
+static void measure_behaviours(size_t count)
+{
+  auto c = make_cown<Empty>();
+  when(c) << [c, count](acquired_cown<Empty>) {
+    // Each waits for this behaviour to finish.
+    auto before = rss_bytes();
+    for (size_t i = 0; i < count; i++)
+      when(c) << [](acquired_cown<Empty>) {};
+    auto after = rss_bytes();
+    behaviour_bytes = ((double)after - (double)before) / (double)count;
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  auto cowns = harness.opt.is<size_t>("--cowns", 250'000);
+  auto behaviours = harness.opt.is<size_t>("--behaviours", 250'000);
+  auto max_cown_bytes = harness.opt.is<size_t>("--max_cown_bytes", 0);
+  auto max_behaviour_bytes = harness.opt.is<size_t>("--max_behaviour_bytes", 0);
+
+  double cown_bytes = 0;
+  double write_only_bytes = 0;
+  harness.run([&cown_bytes, &write_only_bytes, cowns, behaviours]() {
+    cown_bytes = measure_cowns<Empty>(cowns);
+    write_only_bytes = measure_cowns<WriteOnly>(cowns);
+    measure_behaviours(behaviours);
+  });
+
+  // Roughly, as the payload also holds the closure and its cown.
+  auto behaviour_size = BehaviourCore::alloc_size(1, sizeof(void*));
+
+  CSVStream csv(std::cout);
+  csv << "Kind"
+      << "Static bytes"
+      << "Resident bytes" << std::endl;
+  csv << "Cown" << sizeof(ActualCown<Empty>) << cown_bytes << std::endl;
+  csv << "Write only cown" << sizeof(ActualCown<WriteOnly>)
+      << write_only_bytes << std::endl;
+  csv << "Pending behaviour" << behaviour_size << behaviour_bytes
+      << std::endl;
+
+  if (rss_bytes() == 0)
+    return 0;
+
+  if (max_cown_bytes != 0)
+    check(cown_bytes <= (double)max_cown_bytes);
+  if (max_behaviour_bytes != 0)
+    check(behaviour_bytes <= (double)max_behaviour_bytes);
+
+  return 0;
+}
@@ -12,7 +12,8 @@
  * rw_ratio_denom). A behaviour can also spin for extra time to simulate
  * short/long read (read_loop_count) and write (write_loop_count) critical
  * sections. The benchmark creates X behaviours (num_operations) before
- * executing them.
+ * executing them. The buckets can count their readers with a scalable count
+ * (scalable_readers).
  */
 
 /**
@@ -34,6 +35,7 @@ long rw_ratio = 90;
 long rw_ratio_denom = 100;
 long read_loop_count = 0;
 long write_loop_count = 0;
+bool scalable_readers = false;
 
 class Entry
 {
@@ -92,7 +94,10 @@ void test_hash_table()
     std::vector<std::shared_ptr<Entry>> list;
     for (size_t j = 0; j < (num_entries_per_bucket); j++)
       list.push_back(std::shared_ptr<Entry>(new Entry((num_buckets * j) + i)));
-    buckets->push_back(make_cown<Bucket>(list));
+    if (scalable_readers)
+      buckets->push_back(make_cown<Bucket>(ScalableReaders{}, list));
+    else
+      buckets->push_back(make_cown<Bucket>(list));
   }
 
   for (size_t i = 0; i < num_operations; i++)
@@ -231,6 +236,7 @@ int main(int argc, char** argv)
   rw_ratio_denom = opt.is<size_t>("--rw_ratio_denom", rw_ratio_denom);
   read_loop_count = opt.is<size_t>("--read_loop_count", read_loop_count);
   write_loop_count = opt.is<size_t>("--write_loop_count", write_loop_count);
+  scalable_readers = opt.has("--scalable_readers");
 
   check(num_dependent_buckets <= num_buckets);
 
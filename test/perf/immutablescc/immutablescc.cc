@@ -315,6 +315,69 @@ void test_alloc_freeze_release(std::string ds, Make make, bool print)
   //  std::cerr << std::endl;
 }
 
+/**
+ * Creates a region holding a chain of `regions` objects, each of which owns
+ * a subregion holding a doubly linked list of `list_size` objects.
+ */
+Object* make_many_regions(size_t regions, size_t list_size)
+{
+  auto* root = new (RegionType::Trace) C1;
+  C1<>* curr = root;
+  for (size_t i = 0; i < regions; i++)
+  {
+    auto* sub = new (RegionType::Trace) C1;
+    {
+      UsingRegion rr(sub);
+      sub->f1 = make_list<true>(list_size);
+    }
+
+    UsingRegion rr(root);
+    auto* next = new C1;
+    curr->f1 = next;
+    next->f2 = sub;
+    curr = next;
+  }
+  return root;
+}
+
+/**
+ * Compares `Freeze::apply` with `ParallelFreeze::apply` on graphs spread over
+ * many regions.  This runs in a behaviour, so that helpers can be scheduled.
+ */
+void test_parallel_freeze(size_t cores)
+{
+#ifdef CI_BUILD
+  size_t list_size = 1 << 8;
+#else
+  size_t list_size = 1 << 14;
+#endif
+  size_t regions = 64;
+
+  auto& sched = Scheduler::get();
+  sched.init(cores);
+
+  schedule_lambda([cores, regions, list_size]() {
+    size_t work = regions * list_size;
+    for (bool parallel : {false, true})
+    {
+      auto* root = make_many_regions(regions, list_size);
+      {
+        MeasureTime m(true);
+        if (parallel)
+          ParallelFreeze::apply(root);
+        else
+          freeze(root);
+        std::cout << (parallel ? "Parallel Freeze," : "Freeze,") << cores
+                  << "," << work << ","
+                  << (double)m.get_time().count() / work << std::endl;
+      }
+      Immutable::release(root);
+    }
+  });
+
+  sched.run();
+}
+
 int main(int, char**)
 {
 #ifdef CI_BUILD
@@ -360,5 +423,8 @@ int main(int, char**)
       make_horrible_cycles_two<true>,
       i != 0);
   }
+
+  for (size_t cores : {1, 2, 4})
+    test_parallel_freeze(cores);
   return 0;
 }
@@ -0,0 +1,185 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Measures the distribution of end-to-end latency of requests under a given
+ * load, rather than throughput.
+ *
+ * A client thread outside the runtime, registered as an external event
+ * source, sends requests with Poisson arrivals at the offered rate.  It is
+ * open loop: a request is sent when it is due, whether or not earlier ones
+ * have completed.  As the client is not a scheduler thread, each request is
+ * scheduled with `schedule_lifo` on a core chosen round robin.  Each request
+ * is a behaviour on `--touch` distinct cowns, chosen at random from
+ * `--cowns`, and its latency is from when it was due to when its behaviour
+ * ends, so that a client falling behind does not hide queueing.
+ *
+ * For each offered load, starting at `--rate` requests a second and
+ * doubling for `--steps` steps, a CSV row gives the rate the client managed
+ * to send at, and the 50th, 99th and 99.9th percentile latencies.
+ */
+
+#include <chrono>
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <random>
+
+using namespace verona::cpp;
+using clk = std::chrono::steady_clock;
+
+static constexpr size_t MAX_TOUCH = 8;
+
+struct Shard
+{
+  size_t count = 0;
+};
+
+struct Load
+{
+  size_t rate;
+  size_t requests;
+  size_t cowns;
+  size_t touch;
+  size_t work_us;
+};
+
+/// Latency of each request in ns, written by its behaviour.
+static std::vector<uint64_t> latencies;
+/// When the client finished sending, in ns from its start.
+static uint64_t send_ns = 0;
+
+static uint64_t since(clk::time_point start)
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           clk::now() - start)
+    .count();
+}
+
+static void client(Load load, size_t seed)
+{
+  std::vector<cown_ptr<Shard>> cowns;
+  for (size_t i = 0; i < load.cowns; i++)
+    cowns.push_back(make_cown<Shard>());
+
+  std::mt19937_64 rng(seed);
+  // Gaps between arrivals in ns.
+  std::exponential_distribution<double> gap((double)load.rate / 1e9);
+  std::uniform_int_distribution<size_t> pick(0, load.cowns - 1);
+
+  auto start = clk::now();
+  double due = 0;
+  for (size_t i = 0; i < load.requests; i++)
+  {
+    due += gap(rng);
+    auto due_ns = (uint64_t)due;
+
+    // Sleep for most of a long gap, and spin for the rest.
+    auto now = since(start);
+    if (due_ns > now + 100'000)
+      std::this_thread::sleep_for(
+        std::chrono::nanoseconds(due_ns - now - 50'000));
+    while (since(start) < due_ns)
+      Systematic::yield();
+
+    std::array<cown_ptr<Shard>, MAX_TOUCH> picked;
+    size_t picked_count = 0;
+    while (picked_count < load.touch)
+    {
+      auto& c = cowns[pick(rng)];
+      auto end = picked.begin() + picked_count;
+      if (std::find(picked.begin(), end, c) == end)
+        picked[picked_count++] = c;
+    }
+
+    when(cown_array<Shard>::borrow(picked.data(), picked_count))
+      << [i, due_ns, start, work_us = load.work_us](
+           acquired_cown_span<Shard> shards) {
+           for (size_t j = 0; j < shards.length; j++)
+             shards.array[j]->count++;
+           busy_loop(work_us);
+           latencies[i] = since(start) - due_ns;
+         };
+  }
+  send_ns = since(start);
+
+  // Drop the cowns before the runtime can stop.
+  cowns.clear();
+  when() << []() { Scheduler::remove_external_event_source(); };
+}
+
+static void test(SystematicTestHarness* harness, Load load)
+{
+  when() << [harness, load]() {
+    Scheduler::add_external_event_source();
+    harness->external_thread(
+      [load, seed = harness->current_seed()]() { client(load, seed); });
+  };
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p)
+{
+  // Nearest rank.
+  auto rank = (size_t)((p / 100.0) * (double)sorted.size() + 0.999999);
+  return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+#ifdef USE_SYSTEMATIC_TESTING
+  auto default_duration = 10;
+#else
+  auto default_duration = 1000;
+#endif
+  const auto rate = harness.opt.is<size_t>("--rate", 10'000);
+  const auto steps = harness.opt.is<size_t>("--steps", 4);
+  const auto duration_ms =
+    harness.opt.is<size_t>("--duration_ms", default_duration);
+
+  Load load;
+  load.cowns = harness.opt.is<size_t>("--cowns", 64);
+  load.touch = harness.opt.is<size_t>("--touch", 2);
+  load.work_us = harness.opt.is<size_t>("--work_us", 1);
+  check(rate > 0);
+  check((load.touch > 0) && (load.touch <= MAX_TOUCH));
+  check(load.touch <= load.cowns);
+
+  std::vector<std::array<uint64_t, 6>> rows;
+  for (size_t step = 0; step < steps; step++)
+  {
+    load.rate = rate << step;
+    load.requests = std::max<size_t>((load.rate * duration_ms) / 1000, 1);
+    latencies.assign(load.requests, 0);
+
+    harness.run(test, &harness, load);
+
+    std::sort(latencies.begin(), latencies.end());
+    auto achieved = (uint64_t)((double)load.requests * 1e9 /
+                               (double)std::max<uint64_t>(send_ns, 1));
+    rows.push_back(
+      {load.rate,
+       achieved,
+       percentile(latencies, 50) / 1000,
+       percentile(latencies, 99) / 1000,
+       percentile(latencies, 99.9) / 1000,
+       latencies.back() / 1000});
+  }
+
+  // Written after the harness's own output, so it can be cut out whole.
+  CSVStream csv(std::cout);
+  csv << "Offered/s"
+      << "Sent/s"
+      << "p50 us"
+      << "p99 us"
+      << "p99.9 us"
+      << "Max us" << std::endl;
+  for (auto& row : rows)
+  {
+    for (auto v : row)
+      csv << v;
+    csv << std::endl;
+  }
+
+  return 0;
+}
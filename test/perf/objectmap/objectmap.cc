@@ -0,0 +1,94 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <iostream>
+#include <test/measuretime.h>
+#include <vector>
+#include <verona.h>
+
+/**
+ * Measures the `ObjectMap` operations that the remembered sets and external
+ * reference tables of regions rely on: inserting, with and without reserving
+ * room first, finding, and iterating.
+ */
+
+using namespace snmalloc;
+using namespace verona::rt;
+
+struct Key : public VCown<Key>
+{};
+
+using Map = ObjectMap<std::pair<Key*, size_t>>;
+
+void test_map(const std::vector<Key*>& keys, bool print)
+{
+  size_t n = keys.size();
+
+  for (bool reserve : {false, true})
+  {
+    Map map;
+    {
+      MeasureTime m(true);
+      if (reserve)
+        map.reserve(n);
+      for (size_t i = 0; i < n; i++)
+        map.insert(std::make_pair(keys[i], i));
+      if (print)
+        std::cout << (reserve ? "Insert (reserved)," : "Insert,") << n << ","
+                  << (double)m.get_time().count() / n << std::endl;
+    }
+
+    if (reserve)
+      continue;
+
+    {
+      MeasureTime m(true);
+      size_t found = 0;
+      for (auto* key : keys)
+        found += (map.find(key) != map.end()) ? 1 : 0;
+      if (found != n)
+        abort();
+      if (print)
+        std::cout << "Find," << n << "," << (double)m.get_time().count() / n
+                  << std::endl;
+    }
+
+    {
+      MeasureTime m(true);
+      size_t sum = 0;
+      for (auto it = map.begin(); it != map.end(); ++it)
+        sum += it.value();
+      if (sum != n * (n - 1) / 2)
+        abort();
+      if (print)
+        std::cout << "Iterate," << n << "," << (double)m.get_time().count() / n
+                  << std::endl;
+    }
+  }
+}
+
+int main(int, char**)
+{
+#ifdef CI_BUILD
+  size_t max_index = 12;
+#else
+  size_t max_index = 20;
+#endif
+
+  for (int i = 0; i < 2; i++)
+  {
+    for (size_t index = 4; index < max_index; index++)
+    {
+      std::vector<Key*> keys;
+      for (size_t j = 0; j < ((size_t)1 << index); j++)
+        keys.push_back(new Key());
+
+      test_map(keys, i != 0);
+
+      for (auto* key : keys)
+        Cown::release(key);
+    }
+  }
+
+  heap::debug_check_empty();
+  return 0;
+}
@@ -0,0 +1,284 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Measures a stream processing workload: events flowing through a pipeline
+ * of partitioned stages, with fan-out and fan-in, fed from outside the
+ * runtime.
+ *
+ * `--producers` client threads, each registered as an external event
+ * source, send `--events` events between them.  An event is first ingested
+ * by one of the `--width` partitions of the ingest stage, chosen by its key.
+ * It then passes through `--blocks` blocks, each of which
+ *
+ *   - fans out to two branch stages, a partition of each, scheduled together
+ *     as one `Batch` with `operator+`, and
+ *   - once both branches have handled it, fans in to a window stage, with a
+ *     behaviour on `--join` adjacent partitions at once, as a `cown_array`.
+ *
+ * Each stage runs `--work_us` of work.  Producers send as fast as they can,
+ * but keep at most `--inflight` events in the pipeline between them, so the
+ * rate measured is the rate the pipeline sustains.
+ *
+ * Reports, as CSV, the sustained events per second, then for each stage the
+ * 50th and 99th percentile latency from when the event was sent to when the
+ * stage finished with it.
+ */
+
+#include <chrono>
+#include <cpp/when.h>
+#include <debug/harness.h>
+
+using namespace verona::cpp;
+using clk = std::chrono::steady_clock;
+
+static constexpr size_t MAX_BLOCKS = 4;
+static constexpr size_t MAX_JOIN = 8;
+/// Ingest, and then a fan-out and a fan-in stage per block.
+static constexpr size_t MAX_STAGES = 1 + (2 * MAX_BLOCKS);
+
+struct Partition
+{
+  size_t handled = 0;
+};
+
+using Stage = std::vector<cown_ptr<Partition>>;
+
+struct Config
+{
+  size_t producers;
+  size_t events;
+  size_t width;
+  size_t blocks;
+  size_t join;
+  size_t work_us;
+  size_t inflight;
+};
+
+struct Pipeline
+{
+  Config config;
+  clk::time_point start;
+  Stage ingest;
+  std::vector<Stage> left;
+  std::vector<Stage> right;
+  std::vector<Stage> window;
+  std::atomic<size_t> inflight{0};
+
+  Pipeline(Config config_) : config(config_), start(clk::now())
+  {
+    auto make = [this]() {
+      Stage s;
+      for (size_t i = 0; i < config.width; i++)
+        s.push_back(make_cown<Partition>());
+      return s;
+    };
+
+    ingest = make();
+    for (size_t b = 0; b < config.blocks; b++)
+    {
+      left.push_back(make());
+      right.push_back(make());
+      window.push_back(make());
+    }
+  }
+};
+
+struct Event
+{
+  size_t id;
+  size_t key;
+  uint64_t sent_ns;
+  /// Branches of the current block yet to handle this event.
+  std::atomic<size_t> pending{0};
+};
+
+/// Time each event finished each stage, in ns from the start.
+static std::vector<std::array<uint64_t, MAX_STAGES>> stage_ns;
+/// When the last event finished, in ns from the start.
+static std::atomic<uint64_t> end_ns{0};
+
+static uint64_t since(clk::time_point start)
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           clk::now() - start)
+    .count();
+}
+
+static void
+handle(Pipeline& p, Partition& part, const Event& e, size_t stage)
+{
+  part.handled++;
+  busy_loop(p.config.work_us);
+  stage_ns[e.id][stage] = since(p.start) - e.sent_ns;
+}
+
+static void finish(Pipeline& p)
+{
+  auto now = since(p.start);
+  auto prev = end_ns.load(std::memory_order_relaxed);
+  while ((prev < now) && !end_ns.compare_exchange_weak(prev, now))
+    ;
+  p.inflight.fetch_sub(1, std::memory_order_release);
+}
+
+static void fan_out(
+  std::shared_ptr<Pipeline> p, std::shared_ptr<Event> e, size_t block);
+
+static void
+fan_in(std::shared_ptr<Pipeline> p, std::shared_ptr<Event> e, size_t block)
+{
+  auto& window = p->window[block];
+  std::array<cown_ptr<Partition>, MAX_JOIN> picked;
+  for (size_t j = 0; j < p->config.join; j++)
+    picked[j] = window[(e->key + j) % window.size()];
+
+  when(cown_array<Partition>::borrow(picked.data(), p->config.join))
+    << [p, e, block](acquired_cown_span<Partition> parts) {
+         for (size_t j = 0; j < parts.length; j++)
+           parts.array[j]->handled++;
+         handle(*p, *parts.array[0], *e, 2 + (2 * block));
+
+         if (block + 1 < p->config.blocks)
+           fan_out(p, e, block + 1);
+         else
+           finish(*p);
+       };
+}
+
+static void
+fan_out(std::shared_ptr<Pipeline> p, std::shared_ptr<Event> e, size_t block)
+{
+  e->pending.store(2, std::memory_order_relaxed);
+
+  // The later of the two branches carries the event on.
+  auto branch = [p, e, block](Partition& part) {
+    if (e->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+      part.handled++;
+      busy_loop(p->config.work_us);
+      return;
+    }
+    handle(*p, part, *e, 1 + (2 * block));
+    fan_in(p, e, block);
+  };
+
+  auto key = e->key % p->config.width;
+  // Both branches are scheduled together.
+  (when(p->left[block][key]) <<
+   [branch](acquired_cown<Partition> part) { branch(*part); }) +
+    (when(p->right[block][key]) <<
+     [branch](acquired_cown<Partition> part) { branch(*part); });
+}
+
+static void producer(std::shared_ptr<Pipeline> p, size_t index, size_t seed)
+{
+  PRNG<> rng(seed + index);
+  auto& config = p->config;
+
+  for (size_t id = index; id < config.events; id += config.producers)
+  {
+    // Wait for room in the pipeline.
+    while (p->inflight.load(std::memory_order_acquire) >= config.inflight)
+      Systematic::yield();
+    p->inflight.fetch_add(1, std::memory_order_acq_rel);
+
+    auto e = std::make_shared<Event>();
+    e->id = id;
+    e->key = rng.next();
+    e->sent_ns = since(p->start);
+
+    when(p->ingest[e->key % config.width])
+      << [p, e](acquired_cown<Partition> part) {
+           handle(*p, *part, *e, 0);
+           fan_out(p, e, 0);
+         };
+  }
+
+  // Drop the cowns before the runtime can stop.
+  p.reset();
+  when() << []() { Scheduler::remove_external_event_source(); };
+}
+
+static void test(SystematicTestHarness* harness, Config config)
+{
+  end_ns = 0;
+  when() << [harness, config]() {
+    auto p = std::make_shared<Pipeline>(config);
+    for (size_t i = 0; i < config.producers; i++)
+    {
+      Scheduler::add_external_event_source();
+      // Moved out, so that only the producer holds its reference.
+      harness->external_thread(
+        [p, i, seed = harness->current_seed()]() mutable {
+          producer(std::move(p), i, seed);
+        });
+    }
+  };
+}
+
+static uint64_t percentile(std::vector<uint64_t>& v, double p)
+{
+  std::sort(v.begin(), v.end());
+  // Nearest rank.
+  auto rank = (size_t)((p / 100.0) * (double)v.size() + 0.999999);
+  return v[std::max<size_t>(rank, 1) - 1];
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+#ifdef USE_SYSTEMATIC_TESTING
+  size_t default_events = 200;
+#else
+  size_t default_events = 20'000;
+#endif
+
+  Config config;
+  config.producers = harness.opt.is<size_t>("--producers", 2);
+  config.events = harness.opt.is<size_t>("--events", default_events);
+  config.width = harness.opt.is<size_t>("--width", 16);
+  config.blocks = harness.opt.is<size_t>("--blocks", 2);
+  config.join = harness.opt.is<size_t>("--join", 2);
+  config.work_us = harness.opt.is<size_t>("--work_us", 0);
+  config.inflight = harness.opt.is<size_t>("--inflight", 1024);
+  check((config.producers > 0) && (config.events > 0));
+  check((config.blocks > 0) && (config.blocks <= MAX_BLOCKS));
+  check((config.join > 0) && (config.join <= MAX_JOIN));
+  check(config.join <= config.width);
+  check(config.inflight > 0);
+
+  stage_ns.assign(config.events, {});
+  harness.run(test, &harness, config);
+
+  // Written after the harness's own output, so it can be cut out whole.
+  CSVStream csv(std::cout);
+  csv << "Events"
+      << "Events/s" << std::endl;
+  csv << config.events
+      << (uint64_t)((double)config.events * 1e9 /
+                    (double)std::max<uint64_t>(end_ns, 1))
+      << std::endl;
+
+  csv << "Stage"
+      << "p50 us"
+      << "p99 us" << std::endl;
+  for (size_t s = 0; s < 1 + (2 * config.blocks); s++)
+  {
+    std::vector<uint64_t> ns;
+    for (auto& e : stage_ns)
+      ns.push_back(e[s]);
+
+    std::string name = "ingest";
+    if (s > 0)
+    {
+      name = "block" + std::to_string((s - 1) / 2) +
+        ((s % 2 == 1) ? "-fanout" : "-fanin");
+    }
+    csv << name << percentile(ns, 50) / 1000 << percentile(ns, 99) / 1000
+        << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,273 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Measures the cost of each primitive operation of the scheduler, as a
+ * guardrail for changes to the hot paths.  Each is timed with `Aal::tick`
+ * over `--iterations` operations, `--rounds` times, and the median is
+ * written as a CSV row of ticks and nanoseconds per operation:
+ *
+ *   make                 `BehaviourCore::make` and freeing the behaviour
+ *   when                 a behaviour on one cown scheduling the next, end to
+ *                        end, on an otherwise idle single core runtime
+ *   when_k               scheduling a behaviour on k = 1, 2, 4 or 8 cowns,
+ *                        that is the two phase locking of `schedule_many`
+ *   mpmcq                `MPMCQ::enqueue` and `dequeue`, uncontended
+ *   mpmcq_contended      the same, from `--threads` threads on one queue
+ *   steal                `WorkStealingQueue::steal` of a sub-queue, with 64
+ *                        items queued on the victim
+ *   unpause              from scheduling work for a paused core to it
+ *                        running, the wake latency of `ThreadPool::unpause`
+ *
+ * Only concurrent builds measure anything, as systematic testing serialises
+ * threads.
+ */
+
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <deque>
+
+using namespace verona::cpp;
+
+static size_t iterations = 100'000;
+static size_t rounds = 5;
+
+struct Empty
+{};
+
+static double ns_per_tick = 0;
+
+static void calibrate()
+{
+  auto start = std::chrono::steady_clock::now();
+  auto start_tick = Aal::tick();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  auto ticks = Aal::tick() - start_tick;
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count();
+  ns_per_tick = (double)ns / (double)std::max<uint64_t>(ticks, 1);
+}
+
+static void
+report(const std::string& name, size_t ops, std::vector<double>& per_op)
+{
+  std::sort(per_op.begin(), per_op.end());
+  auto ticks = per_op[per_op.size() / 2];
+
+  CSVStream csv(std::cout);
+  csv << name << ops << ticks << ticks * ns_per_tick << std::endl;
+}
+
+/**
+ * Run `f`, which returns the ticks for `ops` operations, `rounds` times.
+ */
+template<typename F>
+static void measure(const std::string& name, size_t ops, F f)
+{
+  std::vector<double> per_op;
+  for (size_t r = 0; r < rounds; r++)
+    per_op.push_back((double)f() / (double)ops);
+  report(name, ops, per_op);
+}
+
+static void nop(Work*) {}
+
+static void bench_make()
+{
+  measure("make", iterations, []() {
+    auto start = Aal::tick();
+    for (size_t i = 0; i < iterations; i++)
+    {
+      auto* b = BehaviourCore::make(1, nop, 0);
+      b->as_work()->dealloc();
+    }
+    return Aal::tick() - start;
+  });
+}
+
+/// Ticks of the last run of a runtime benchmark.
+static uint64_t runtime_ticks = 0;
+
+static void chain(cown_ptr<Empty> c, size_t remaining, uint64_t start)
+{
+  if (remaining == 0)
+  {
+    runtime_ticks = Aal::tick() - start;
+    return;
+  }
+  when(c) << [c, remaining, start](acquired_cown<Empty>) {
+    chain(c, remaining - 1, start);
+  };
+}
+
+static void bench_when()
+{
+  measure("when", iterations, []() {
+    auto& sched = Scheduler::get();
+    sched.init(1);
+    chain(make_cown<Empty>(), iterations, Aal::tick());
+    sched.run();
+    return runtime_ticks;
+  });
+}
+
+static void bench_when_k(size_t k)
+{
+  measure("when_" + std::to_string(k), iterations, [k]() {
+    auto& sched = Scheduler::get();
+    sched.init(1);
+
+    when() << [k]() {
+      std::vector<cown_ptr<Empty>> cowns;
+      for (size_t i = 0; i < k; i++)
+        cowns.push_back(make_cown<Empty>());
+      auto span = cown_array<Empty>::borrow(cowns.data(), k);
+
+      // Only the scheduling is timed, the behaviours run afterwards.
+      auto start = Aal::tick();
+      for (size_t i = 0; i < iterations; i++)
+        when(span) << [](acquired_cown_span<Empty>) {};
+      runtime_ticks = Aal::tick() - start;
+    };
+
+    sched.run();
+    return runtime_ticks;
+  });
+}
+
+static void bench_mpmcq(size_t threads)
+{
+  auto name = threads == 1 ? "mpmcq" : "mpmcq_contended";
+  measure(name, iterations * threads, [threads]() {
+    MPMCQ<Work> q;
+    std::atomic<uint64_t> ticks{0};
+
+    auto body = [&q, &ticks]() {
+      std::deque<Work> items;
+      for (size_t i = 0; i < 64; i++)
+        items.emplace_back(nop);
+      auto start = Aal::tick();
+      for (size_t i = 0; i < iterations; i++)
+      {
+        q.enqueue(&items[i % items.size()]);
+        // A dequeue may fail spuriously under contention.
+        while (q.dequeue() == nullptr)
+          ;
+      }
+      ticks += Aal::tick() - start;
+    };
+
+    if (threads == 1)
+    {
+      body();
+      return ticks.load();
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++)
+      workers.emplace_back(body);
+    for (auto& w : workers)
+      w.join();
+    // Threads run at once, so report the average time each took.
+    return ticks.load() / threads;
+  });
+}
+
+static void bench_steal()
+{
+  static constexpr size_t ITEMS = 64;
+
+  measure("steal", iterations, []() {
+    WorkStealingQueue victim;
+    WorkStealingQueue thief;
+    std::deque<Work> items;
+    for (size_t i = 0; i < ITEMS; i++)
+      items.emplace_back(nop);
+
+    uint64_t ticks = 0;
+    for (size_t i = 0; i < iterations; i++)
+    {
+      for (auto& w : items)
+        victim.enqueue(&w);
+
+      auto start = Aal::tick();
+      auto* w = thief.steal(victim);
+      ticks += Aal::tick() - start;
+      check(w != nullptr);
+
+      while (thief.dequeue() != nullptr)
+        ;
+      while (victim.dequeue() != nullptr)
+        ;
+    }
+    return ticks;
+  });
+}
+
+static void bench_unpause()
+{
+  // Each wake waits for the other core to pause, so do fewer.
+  static constexpr size_t WAKES = 20;
+
+  measure("unpause", WAKES, []() {
+    auto& sched = Scheduler::get();
+    sched.init(2);
+
+    runtime_ticks = 0;
+    when().on(Scheduler::get_core(0)) << []() {
+      for (size_t i = 0; i < WAKES; i++)
+      {
+        // Give the other core time to run out of work and pause.
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        std::atomic<uint64_t> woken{0};
+        auto start = Aal::tick();
+        when().on(Scheduler::get_core(1)) << [&woken]() {
+          woken = Aal::tick();
+        };
+        // Spin, so that this core does not take the work itself.
+        while (woken.load() == 0)
+          Aal::pause();
+        runtime_ticks += woken.load() - start;
+      }
+    };
+
+    sched.run();
+    return runtime_ticks;
+  });
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  iterations = opt.is<size_t>("--iterations", iterations);
+  rounds = std::max<size_t>(opt.is<size_t>("--rounds", rounds), 1);
+  auto threads = opt.is<size_t>("--threads", 4);
+
+#ifdef USE_SYSTEMATIC_TESTING
+  UNUSED(threads);
+  std::cout << "Primitive costs are only measured in concurrent builds"
+            << std::endl;
+#else
+  calibrate();
+
+  CSVStream csv(std::cout);
+  csv << "Primitive"
+      << "Operations"
+      << "Ticks/op"
+      << "ns/op" << std::endl;
+
+  bench_make();
+  bench_when();
+  for (size_t k : {1, 2, 4, 8})
+    bench_when_k(k);
+  bench_mpmcq(1);
+  bench_mpmcq(threads);
+  bench_steal();
+  bench_unpause();
+
+  heap::debug_check_empty();
+#endif
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Compares the cost of `Promise` and `OneShotPromise` used as one-shot
+ * futures.  Each round creates a number of promises, fulfills each from a
+ * behaviour and reads each once, and reports the cycles per promise.
+ */
+
+#include "debug/log.h"
+#include "test/opt.h"
+#include "verona.h"
+
+#include <chrono>
+#include <debug/harness.h>
+
+namespace sn = snmalloc;
+namespace rt = verona::rt;
+
+std::atomic<size_t> total{0};
+
+template<typename P>
+void run_promises(size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    auto pp = P::create_promise();
+    schedule_lambda([wp = std::move(pp.second), i]() mutable {
+      P::fulfill(std::move(wp), std::move(i));
+    });
+    std::move(pp.first).then(
+      [](std::variant<size_t, typename P::PromiseErr> val) {
+        total += std::get<size_t>(val);
+      });
+  }
+}
+
+template<typename P>
+void bench(const char* name, size_t cores, size_t count, size_t rounds)
+{
+  auto& sched = rt::Scheduler::get();
+  for (size_t r = 0; r < rounds; r++)
+  {
+    total = 0;
+    sched.init(cores);
+    schedule_lambda([count]() { run_promises<P>(count); });
+
+    auto start = sn::Aal::tick();
+    sched.run();
+    auto end = sn::Aal::tick();
+
+    check(total == (count * (count - 1)) / 2);
+    std::cout << name << ":" << (end - start) / count << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  for (int i = 0; i < argc; i++)
+  {
+    printf(" %s", argv[i]);
+  }
+  printf("\n");
+  opt::Opt opt(argc, argv);
+
+  const auto cores = opt.is<size_t>("--cores", 4);
+  const auto count = opt.is<size_t>("--promises", 100000);
+  const auto rounds = opt.is<size_t>("--rounds", 5);
+
+  bench<Promise<size_t>>("Promise", cores, count, rounds);
+  bench<OneShotPromise<size_t>>("OneShotPromise", cores, count, rounds);
+
+  heap::debug_check_empty();
+}
@@ -0,0 +1,176 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Measures how reader-writer cowns scale with cores, as the baseline for
+ * changes to how readers are counted and woken.
+ *
+ * Each trial, one generator behaviour per core schedules its share of
+ * `--behaviours` behaviours, each on one of `--cowns` cowns chosen at
+ * random, as a reader with probability `--ratio` percent and otherwise as a
+ * writer.  Each runs a critical section of `--cs` iterations.  Runs of
+ * readers on a cown are woken together and run in parallel, so this
+ * exercises the reader count of each cown and the chains of readers made
+ * available when a writer finishes.
+ *
+ * Unless `--ratio` or `--cs` is given, each combination of reader ratios
+ * from 50% to 100% and critical sections of 0, 100 and 1000 iterations is
+ * run.  Each is a benchmark of `PerfHarness`, so `--sweep` runs each on 1 up
+ * to `--cores` cores, with the speedup over one core.  `--scalable_readers`
+ * uses a scalable reader count on each cown.
+ *
+ * With `--baseline`, the same operations are also run on one thread per
+ * core, with a `std::shared_mutex` in place of each cown.
+ */
+
+#include <cpp/when.h>
+#include <debug/harness.h>
+#include <debug/perfharness.h>
+#include <shared_mutex>
+
+using namespace verona::cpp;
+
+struct Data
+{
+  std::atomic<size_t> value{0};
+};
+
+struct Config
+{
+  size_t cowns;
+  size_t behaviours;
+  size_t ratio;
+  size_t cs;
+  bool scalable_readers;
+  size_t generators;
+};
+
+static void critical_section(const Data& d, size_t cs)
+{
+  for (size_t i = 0; i < cs; i++)
+    (void)d.value.load(std::memory_order_relaxed);
+}
+
+static void generate(
+  std::vector<cown_ptr<Data>> cowns, const Config& config, size_t seed)
+{
+  PRNG<> rng;
+  rng.set_seed(seed);
+
+  auto count = config.behaviours / config.generators;
+  for (size_t i = 0; i < count; i++)
+  {
+    auto& c = cowns[rng.next() % cowns.size()];
+    if ((rng.next() % 100) < config.ratio)
+    {
+      when(read(c)) << [cs = config.cs](acquired_cown<const Data> d) {
+        critical_section(*d, cs);
+      };
+    }
+    else
+    {
+      when(c) << [cs = config.cs](acquired_cown<Data> d) {
+        critical_section(*d, cs);
+        d->value.store(
+          d->value.load(std::memory_order_relaxed) + 1,
+          std::memory_order_relaxed);
+      };
+    }
+  }
+}
+
+static void baseline(const Config& config, size_t threads)
+{
+  std::vector<Data> data(config.cowns);
+  std::vector<std::shared_mutex> locks(config.cowns);
+
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; t++)
+  {
+    workers.emplace_back([&, t]() {
+      PRNG<> rng;
+      rng.set_seed(t + 1);
+
+      auto count = config.behaviours / threads;
+      for (size_t i = 0; i < count; i++)
+      {
+        auto c = rng.next() % config.cowns;
+        auto& d = data[c];
+        if ((rng.next() % 100) < config.ratio)
+        {
+          std::shared_lock<std::shared_mutex> lock(locks[c]);
+          critical_section(d, config.cs);
+        }
+        else
+        {
+          std::unique_lock<std::shared_mutex> lock(locks[c]);
+          critical_section(d, config.cs);
+          d.value.store(
+            d.value.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+        }
+      }
+    });
+  }
+  for (auto& w : workers)
+    w.join();
+}
+
+static void run(PerfHarness& harness, Config config)
+{
+  auto name = std::string("readers-r") + std::to_string(config.ratio) +
+    "-cs" + std::to_string(config.cs);
+
+  harness.run(
+    name,
+    [config]() mutable {
+      std::vector<cown_ptr<Data>> cowns;
+      for (size_t i = 0; i < config.cowns; i++)
+      {
+        cowns.push_back(make_cown<Data>());
+        if (config.scalable_readers)
+          cowns.back().enable_scalable_readers();
+      }
+
+      // The same behaviours are generated on any number of cores.
+      for (size_t g = 0; g < config.generators; g++)
+        when() << [cowns, config, g]() { generate(cowns, config, g + 1); };
+    },
+    (config.behaviours / config.generators) * config.generators);
+
+  harness.run_baseline(
+    name + "-shared_mutex",
+    [config](size_t threads) { baseline(config, threads); },
+    config.behaviours);
+}
+
+int main(int argc, char** argv)
+{
+  PerfHarness harness(argc, argv);
+
+  Config config;
+  config.cowns = harness.opt.is<size_t>("--cowns", 16);
+  config.behaviours = harness.opt.is<size_t>("--behaviours", 100'000);
+  config.scalable_readers = harness.opt.has("--scalable_readers");
+  config.generators = std::max<size_t>(harness.cores, 1);
+  check(config.cowns > 0);
+
+  std::vector<size_t> ratios{50, 75, 90, 99, 100};
+  if (harness.opt.has("--ratio"))
+    ratios = {harness.opt.is<size_t>("--ratio", 90)};
+  std::vector<size_t> sections{0, 100, 1000};
+  if (harness.opt.has("--cs"))
+    sections = {harness.opt.is<size_t>("--cs", 0)};
+
+  for (auto ratio : ratios)
+  {
+    for (auto cs : sections)
+    {
+      config.ratio = ratio;
+      config.cs = cs;
+      run(harness, config);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,319 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <iostream>
+#include <test/measuretime.h>
+#include <vector>
+#include <verona.h>
+
+using namespace snmalloc;
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+/**
+ * Each benchmark is run on graphs of 2^4 up to 2^(MAX_INDEX - 1) objects,
+ * and writes CSV rows of the data structure, region type, operation, size
+ * and nanoseconds per object.
+ */
+#ifdef CI_BUILD
+static constexpr size_t MAX_INDEX = 10;
+#else
+static constexpr size_t MAX_INDEX = 20;
+#endif
+
+struct C1 : public V<C1>
+{
+  C1* f1{nullptr};
+  C1* f2{nullptr};
+
+  void trace(ObjectStack& st) const
+  {
+    if (f1 != nullptr)
+      st.push(f1);
+
+    if (f2 != nullptr)
+      st.push(f2);
+  }
+};
+
+/**
+ * Create a linked list of a given size in the open region.
+ */
+C1* make_list(size_t list_size)
+{
+  auto* root = new C1;
+  auto* curr = root;
+  for (size_t i = 0; i < list_size; i++)
+  {
+    auto* next = new C1;
+    curr->f1 = next;
+    curr = next;
+  }
+  return root;
+}
+
+/**
+ * Creates a balanced binary tree of a given size in the open region.
+ */
+C1* make_tree(size_t tree_size)
+{
+  if (tree_size == 0)
+    return nullptr;
+
+  auto* curr = new C1;
+  tree_size--;
+
+  size_t left_size = tree_size >> 1;
+
+  curr->f1 = make_tree(left_size);
+  curr->f2 = make_tree(tree_size - left_size);
+  return curr;
+}
+
+/**
+ * Creates a random graph of a given size in the open region.  Each object is
+ * reachable along `f1` from the one before, and its `f2` refers to an object
+ * chosen at random, so the graph has cycles and shared objects.  This only
+ * suits trace and arena regions, as nothing counts the references.
+ */
+C1* make_graph(size_t graph_size)
+{
+  PRNG<> rng(graph_size);
+  std::vector<C1*> objects;
+  objects.push_back(new C1);
+  for (size_t i = 0; i < graph_size; i++)
+  {
+    auto* next = new C1;
+    objects.back()->f1 = next;
+    objects.push_back(next);
+  }
+  for (auto* o : objects)
+    o->f2 = objects[rng.next() % objects.size()];
+  return objects.front();
+}
+
+/**
+ * Walk the graph reachable from `o`, taking and dropping a reference to each
+ * object in rc regions, as a program holding temporary references would.
+ */
+void walk(RegionType type, C1* o)
+{
+  ObjectStack dfs;
+  dfs.push(o);
+  while (!dfs.empty())
+  {
+    auto* p = (C1*)dfs.pop();
+    if (type == RegionType::Rc)
+    {
+      incref(p);
+      decref(p);
+    }
+    p->trace(dfs);
+  }
+}
+
+const char* name(RegionType type)
+{
+  switch (type)
+  {
+    case RegionType::Trace:
+      return "Trace";
+    case RegionType::Arena:
+      return "Arena";
+    case RegionType::Rc:
+      return "Rc";
+    default:
+      abort();
+  }
+}
+
+void report(
+  bool print,
+  const std::string& ds,
+  RegionType type,
+  const char* op,
+  size_t size,
+  MeasureTime& m)
+{
+  if (print)
+    std::cout << ds << "," << name(type) << "," << op << "," << size << ","
+              << (double)m.get_time().count() / size << std::endl;
+}
+
+/**
+ * Measures allocating, walking, and releasing a graph made by `make` in each
+ * of the kinds of region `types`.  Graphs with shared objects are not
+ * walked, as the walk does not track what it has visited.
+ */
+template<typename Make>
+void test_regions(
+  std::string ds,
+  Make make,
+  bool print,
+  std::vector<RegionType> types = {
+    RegionType::Trace, RegionType::Arena, RegionType::Rc},
+  bool walkable = true)
+{
+  for (auto type : types)
+    for (size_t index = 4; index < MAX_INDEX; index++)
+    {
+      size_t size = (size_t)1 << index;
+      auto* root = new (type) C1;
+
+      {
+        MeasureTime m(true);
+        {
+          UsingRegion rr(root);
+          root->f1 = make(size);
+        }
+        report(print, ds, type, "Alloc", size, m);
+      }
+
+      if (walkable)
+      {
+        MeasureTime m(true);
+        {
+          UsingRegion rr(root);
+          walk(type, root->f1);
+        }
+        report(print, ds, type, "Walk", size, m);
+      }
+
+      {
+        MeasureTime m(true);
+        region_release(root);
+        report(print, ds, type, "Release", size, m);
+      }
+    }
+
+  heap::debug_check_empty();
+}
+
+/**
+ * Measures the pause of collecting a trace region whose live graph, made by
+ * `make`, is of each size, after as many objects that are unreachable were
+ * allocated.  The time is per live object.
+ */
+template<typename Make>
+void test_collect(std::string ds, Make make, bool print)
+{
+  for (size_t index = 4; index < MAX_INDEX; index++)
+  {
+    size_t size = (size_t)1 << index;
+    auto* root = new (RegionType::Trace) C1;
+
+    {
+      UsingRegion rr(root);
+      root->f1 = make(size);
+      make(size);
+
+      MeasureTime m(true);
+      region_collect();
+      report(print, ds, RegionType::Trace, "Collect", size, m);
+    }
+
+    region_release(root);
+  }
+
+  heap::debug_check_empty();
+}
+
+/**
+ * Measures merging a region holding a graph made by `make` into another
+ * holding the same, for trace and arena regions, the kinds that can be
+ * merged.  The time is per object merged.
+ */
+template<typename Make>
+void test_merge(std::string ds, Make make, bool print)
+{
+  for (auto type : {RegionType::Trace, RegionType::Arena})
+    for (size_t index = 4; index < MAX_INDEX; index++)
+    {
+      size_t size = (size_t)1 << index;
+      auto* root = new (type) C1;
+      auto* other = new (type) C1;
+
+      {
+        UsingRegion rr(other);
+        other->f1 = make(size);
+      }
+
+      {
+        UsingRegion rr(root);
+        root->f1 = make(size);
+
+        MeasureTime m(true);
+        root->f2 = merge(other);
+        report(print, ds, type, "Merge", size, m);
+      }
+
+      region_release(root);
+    }
+
+  heap::debug_check_empty();
+}
+
+/**
+ * Measures freezing a trace region, the only kind that can be frozen,
+ * holding a graph made by `make`, and releasing the immutable graph.
+ */
+template<typename Make>
+void test_freeze(std::string ds, Make make, bool print)
+{
+  for (size_t index = 4; index < MAX_INDEX; index++)
+  {
+    size_t size = (size_t)1 << index;
+    auto* root = new (RegionType::Trace) C1;
+
+    {
+      UsingRegion rr(root);
+      root->f1 = make(size);
+    }
+
+    {
+      MeasureTime m(true);
+      freeze(root);
+      report(print, ds, RegionType::Trace, "Freeze", size, m);
+    }
+
+    {
+      MeasureTime m(true);
+      Immutable::release(root);
+      report(print, ds, RegionType::Trace, "ReleaseFrozen", size, m);
+    }
+  }
+
+  heap::debug_check_empty();
+}
+
+int main(int, char**)
+{
+#ifdef CI_BUILD
+  int repeats = 1;
+#else
+  int repeats = 2;
+#endif
+  for (int i = 0; i < repeats; i++)
+  {
+    bool print = i != 0;
+    test_regions("Linked List", make_list, print);
+    test_regions("Balanced Binary Tree", make_tree, print);
+    test_regions(
+      "Random Graph",
+      make_graph,
+      print,
+      {RegionType::Trace, RegionType::Arena},
+      false);
+
+    test_collect("Linked List", make_list, print);
+    test_collect("Balanced Binary Tree", make_tree, print);
+    test_collect("Random Graph", make_graph, print);
+
+    test_merge("Balanced Binary Tree", make_tree, print);
+    test_merge("Random Graph", make_graph, print);
+
+    test_freeze("Balanced Binary Tree", make_tree, print);
+    test_freeze("Random Graph", make_graph, print);
+  }
+  return 0;
+}
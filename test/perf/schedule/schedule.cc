@@ -5,7 +5,11 @@
  *  This benchmark is for testing performance of the scheduling code.
  *
  * There are n cowns, each executing m writes to a large statically allocated
- * array of memory.  Each cown performs c behaviours.
+ * array of memory.  Each cown performs c behaviours.  The time per behaviour
+ * is reported by `PerfHarness`.
+ *
+ * With `--baseline`, the same chains of work are also run as tasks on a
+ * `TaskPool`, each resubmitting the next.
  */
 
 #include "debug/log.h"
@@ -14,6 +18,7 @@
 
 #include <chrono>
 #include <debug/harness.h>
+#include <debug/perfharness.h>
 
 namespace sn = snmalloc;
 namespace rt = verona::rt;
@@ -25,6 +30,16 @@ size_t global_array_size;
 // Number of writes on each iteration
 size_t writes;
 
+void work(PRNG<>& rng)
+{
+  for (size_t i = 0; i < writes; i++)
+  {
+    auto& cell = global_array[rng.next() & (global_array_size - 1)];
+    auto x = cell.load(std::memory_order_acquire);
+    cell.store(x + 7, std::memory_order_release);
+  }
+}
+
 struct LoopCown : public VCown<LoopCown>
 {
   size_t count;
@@ -41,7 +56,7 @@ struct LoopCown : public VCown<LoopCown>
     {
       count--;
       schedule_lambda(this, [this]() {
-        work();
+        work(rng);
         go();
       });
     }
@@ -50,51 +65,67 @@ struct LoopCown : public VCown<LoopCown>
       Cown::release(this);
     }
   }
+};
+
+struct LoopTask
+{
+  size_t count;
+  PRNG<> rng;
+
+  LoopTask(size_t count, size_t seed) : count(count)
+  {
+    rng.set_seed(seed);
+  }
 
-  void work()
+  void go(TaskPool& pool)
   {
-    for (size_t i = 0; i < writes; i++)
+    if (count > 0)
     {
-      auto& cell = global_array[rng.next() & (global_array_size - 1)];
-      auto x = cell.load(std::memory_order_acquire);
-      cell.store(x + 7, std::memory_order_release);
+      count--;
+      pool.submit([this, &pool]() {
+        work(rng);
+        go(pool);
+      });
     }
   }
 };
 
 int main(int argc, char** argv)
 {
-  for (int i = 0; i < argc; i++)
-  {
-    printf(" %s", argv[i]);
-  }
-  printf("\n");
-  opt::Opt opt(argc, argv);
+  PerfHarness harness(argc, argv);
 
-  const auto cores = opt.is<size_t>("--cores", 4);
-  const auto cowns = (size_t)1 << opt.is<size_t>("--cowns", 8);
-  global_array_size = (size_t)1 << opt.is<size_t>("--size", 22);
+  const auto cowns = (size_t)1 << harness.opt.is<size_t>("--cowns", 8);
+  global_array_size = (size_t)1 << harness.opt.is<size_t>("--size", 22);
   global_array = new std::atomic<size_t>[global_array_size];
-  const auto loops = opt.is<size_t>("--loops", 100);
-  writes = opt.is<size_t>("--writes", 0);
+  const auto loops = harness.opt.is<size_t>("--loops", 100);
+  writes = harness.opt.is<size_t>("--writes", 0);
 
-  auto& sched = rt::Scheduler::get();
-  sched.set_fair(true);
-  for (int l = 0; l < 20; l++)
-  {
-    sched.init(cores);
+  rt::Scheduler::get().set_fair(true);
+  harness.run(
+    "schedule",
+    [cowns, loops]() {
+      for (size_t i = 0; i < cowns; i++)
+      {
+        auto c = new LoopCown(loops, i + 200);
+        c->go();
+      }
+    },
+    cowns * loops);
 
-    for (size_t i = 0; i < cowns; i++)
-    {
-      auto c = new LoopCown(loops, i + 200);
-      c->go();
-    }
+  harness.run_baseline(
+    "schedule-taskpool",
+    [cowns, loops](size_t threads) {
+      TaskPool pool(threads);
+      std::vector<LoopTask> tasks;
+      tasks.reserve(cowns);
+      for (size_t i = 0; i < cowns; i++)
+        tasks.emplace_back(loops, i + 200);
+      for (auto& t : tasks)
+        t.go(pool);
+      pool.wait();
+    },
+    cowns * loops);
 
-    auto start = sn::Aal::tick();
-    sched.run();
-    auto end = sn::Aal::tick();
-    std::cout << "Time:" << (end - start) / (cowns * loops) << std::endl;
-  }
   delete[] global_array;
   heap::debug_check_empty();
 }
@@ -0,0 +1,86 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <iostream>
+#include <test/measuretime.h>
+#include <verona.h>
+
+/**
+ * Compares block sizes for `Stack`, which backs the traversals of garbage
+ * collection and freezing.  A deep stack pushes and pops many entries, and
+ * a shallow stack is created for a few entries, as for a small graph.
+ */
+
+using namespace snmalloc;
+using namespace verona::rt;
+
+static Object* item(size_t i)
+{
+  return (Object*)((i + 1) * sizeof(void*));
+}
+
+template<size_t BlockBytes>
+void test_deep(size_t n, bool print)
+{
+  MeasureTime m(true);
+  {
+    Stack<Object, BlockBytes> stack;
+    for (size_t i = 0; i < n; i++)
+      stack.push(item(i));
+    size_t sum = 0;
+    while (!stack.empty())
+      sum += (size_t)stack.pop();
+    if (sum == 0)
+      abort();
+  }
+  if (print)
+    std::cout << "Deep," << BlockBytes << "," << n << ","
+              << (double)m.get_time().count() / n << std::endl;
+}
+
+template<size_t BlockBytes>
+void test_shallow(size_t n, bool print)
+{
+  constexpr size_t DEPTH = 8;
+  MeasureTime m(true);
+  for (size_t j = 0; j < n; j++)
+  {
+    Stack<Object, BlockBytes> stack;
+    for (size_t i = 0; i < DEPTH; i++)
+      stack.push(item(i));
+    while (!stack.empty())
+      stack.pop();
+  }
+  if (print)
+    std::cout << "Shallow," << BlockBytes << "," << n << ","
+              << (double)m.get_time().count() / n << std::endl;
+}
+
+template<size_t BlockBytes>
+void test_block_size(size_t n, bool print)
+{
+  test_deep<BlockBytes>(n, print);
+  test_shallow<BlockBytes>(n, print);
+}
+
+int main(int, char**)
+{
+#ifdef CI_BUILD
+  size_t max_index = 14;
+#else
+  size_t max_index = 22;
+#endif
+
+  for (int i = 0; i < 2; i++)
+  {
+    for (size_t index = 10; index < max_index; index += 2)
+    {
+      size_t n = (size_t)1 << index;
+      test_block_size<512>(n, i != 0);
+      test_block_size<1024>(n, i != 0);
+      test_block_size<4096>(n, i != 0);
+    }
+  }
+
+  heap::debug_check_empty();
+  return 0;
+}
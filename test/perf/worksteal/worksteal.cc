@@ -20,8 +20,8 @@
  *        -> work -> sync
  *        ...
  *
- * The time taken to schedule all the work is measured.
- * The time taken to execute all the work is measured.
+ * The time taken to schedule all the work is measured, and written to standard
+ * error.  The time taken to execute all the work is reported by `PerfHarness`.
  *
  * The core aim is to generate a lot of work on a single scheduler thread to tax
  * the work stealing code.  As the main behaviour in test is long running,
@@ -29,6 +29,9 @@
  *
  * We generate a nop work so that not everything has to contend for the sync
  * cown to complete.
+ *
+ * With `--baseline`, the same work is also run as tasks on a `TaskPool`, with
+ * a mutex in place of the sync cown.
  */
 
 #include "debug/log.h"
@@ -39,6 +42,7 @@
 #include <chrono>
 #include <cpp/when.h>
 #include <debug/harness.h>
+#include <debug/perfharness.h>
 
 using namespace verona::cpp;
 
@@ -49,6 +53,12 @@ struct Sync
   size_t remaining_count{0};
 };
 
+/// If set, the uncounted work items are sent round robin to other cores,
+/// rather than the current one.
+static bool remote = false;
+
+static constexpr size_t ITEMS = 1'000'000;
+
 void test()
 {
   auto sync = verona::cpp::make_cown<Sync>();
@@ -56,15 +66,23 @@ void test()
   when(sync) << [](auto sync) {
     sync->start = high_resolution_clock::now();
 
-    sync->remaining_count = 1'000'000;
+    sync->remaining_count = ITEMS;
 
     for (size_t i = 0; i < sync->remaining_count; i++)
     {
       // Schedule some work to be done
-      when() << []() {};
-      when() << []() {};
-      when() << []() {};
-      when() << []() {};
+      if (remote)
+      {
+        for (size_t j = 0; j < 4; j++)
+          when().on(Scheduler::get_core((4 * i) + j)) << []() {};
+      }
+      else
+      {
+        when() << []() {};
+        when() << []() {};
+        when() << []() {};
+        when() << []() {};
+      }
       // Every 5th work item will be counted back in for timing purposes
       when() << [sync = sync.cown()]() {
         when(sync) << [](auto sync) {
@@ -72,26 +90,67 @@ void test()
           if (--sync->remaining_count == 0)
           {
             sync->end = high_resolution_clock::now();
-            printf(
-              "Elapsed:\n\t%zu ms\n",
-              duration_cast<milliseconds>(sync->end - sync->start).count());
             return;
           }
         };
       };
     }
-    printf(
+    fprintf(
+      stderr,
       "Scheduled all work took:\n\t%zu ms\n",
       duration_cast<milliseconds>(high_resolution_clock::now() - sync->start)
         .count());
   };
 }
 
+void baseline(size_t threads)
+{
+  TaskPool pool(threads);
+  std::mutex sync;
+  size_t remaining_count = ITEMS;
+
+  pool.submit([&]() {
+    for (size_t i = 0; i < ITEMS; i++)
+    {
+      for (size_t j = 0; j < 4; j++)
+        pool.submit([]() {});
+      pool.submit([&]() {
+        pool.submit([&]() {
+          std::lock_guard<std::mutex> lock(sync);
+          remaining_count--;
+        });
+      });
+    }
+  });
+  pool.wait();
+  check(remaining_count == 0);
+}
+
 int main(int argc, char** argv)
 {
-  SystematicTestHarness harness(argc, argv);
+  PerfHarness harness(argc, argv);
+
+  // --steal_half takes half of a victim's sub-queue on each steal, and
+  // --steal_bound n takes at most n items.  By default, a steal takes the
+  // whole sub-queue.
+  if (harness.opt.has("--steal_half"))
+    Scheduler::set_steal_mode(StealMode::Half);
+  else if (harness.opt.has("--steal_bound"))
+    Scheduler::set_steal_mode(
+      StealMode::Bounded, harness.opt.is<size_t>("--steal_bound", 16));
+
+  // --remote sends most of the work to other cores, and --no_staging
+  // enqueues each such item on its target core individually, rather than
+  // batching them per core.
+  remote = harness.opt.has("--remote");
+  if (harness.opt.has("--no_staging"))
+    Scheduler::set_stage_remote_work(false);
 
-  harness.run(test);
+  // Each of the million items of work is six behaviours: four nops, the
+  // counted one, and the one it schedules on sync.
+  harness.run(remote ? "worksteal-remote" : "worksteal", test, 6 * ITEMS);
+  if (!remote)
+    harness.run_baseline("worksteal-taskpool", baseline, 6 * ITEMS);
 
   return 0;
 }
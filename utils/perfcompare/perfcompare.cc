@@ -0,0 +1,267 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Compares two files of benchmark results written with `--json` by
+ * `PerfHarness` or `SystematicTestHarness`, see `src/rt/debug/perfresult.h`,
+ * for instance the `perf.json` of the `rt_perf` target on two releases.
+ *
+ * Results are matched by `id`, and the samples of each pair of results are
+ * compared with a two-sided Mann-Whitney U test, as trial times are rarely
+ * normally distributed.  A result is flagged as a regression if its median
+ * time grew by more than the threshold and the difference is significant.
+ * Results with the same `id` in one file, such as from runs appended to the
+ * same file, are pooled.  The test uses the normal approximation, so needs
+ * at least five trials on each side to find anything significant.
+ *
+ * Build with, for instance:
+ *
+ *   c++ -std=c++17 -O2 utils/perfcompare/perfcompare.cc
+ *
+ * Usage: perfcompare <base file> <new file> [--threshold percent]
+ *                    [--alpha p]
+ *
+ * The threshold defaults to 5%, and the significance level to 0.05.  Exits
+ * with 1 if any result regressed, so that it can gate CI.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+  struct Samples
+  {
+    std::vector<double> ns;
+    /// Medians of results without samples, from before they were written.
+    std::vector<double> medians;
+
+    const std::vector<double>& values() const
+    {
+      return ns.empty() ? medians : ns;
+    }
+  };
+
+  /**
+   * The text after `"key":` in `line`, or nullptr.  The results are flat
+   * objects written by `PerfResult::write_json`, so this is all the parsing
+   * they need.
+   */
+  const char* field(const std::string& line, const char* key)
+  {
+    auto pattern = std::string("\"") + key + "\":";
+    auto pos = line.find(pattern);
+    if (pos == std::string::npos)
+      return nullptr;
+    return line.c_str() + pos + pattern.size();
+  }
+
+  std::string string_field(const std::string& line, const char* key)
+  {
+    auto p = field(line, key);
+    std::string s;
+    if ((p == nullptr) || (*p != '"'))
+      return s;
+    for (p++; (*p != '\0') && (*p != '"'); p++)
+    {
+      if ((*p == '\\') && (p[1] != '\0'))
+        p++;
+      s += *p;
+    }
+    return s;
+  }
+
+  bool read_results(const char* path, std::map<std::string, Samples>& results)
+  {
+    std::ifstream in(path);
+    if (!in)
+      return false;
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+      // Harness output may be interleaved with the results.
+      if ((line.size() < 2) || (line[0] != '{') || (line[1] != '"'))
+        continue;
+
+      auto id = string_field(line, "id");
+      if (id.empty())
+      {
+        auto cores = field(line, "cores");
+        id = string_field(line, "benchmark") + "/" +
+          std::to_string(cores == nullptr ? 0 : std::atol(cores));
+      }
+      auto& r = results[id];
+
+      auto p = field(line, "samples_ns");
+      if ((p != nullptr) && (*p == '['))
+      {
+        p++;
+        while ((*p != ']') && (*p != '\0'))
+        {
+          char* end;
+          r.ns.push_back(std::strtod(p, &end));
+          if (end == p)
+            break;
+          p = end;
+          if (*p == ',')
+            p++;
+        }
+      }
+      else if ((p = field(line, "median_ns")) != nullptr)
+      {
+        r.medians.push_back(std::strtod(p, nullptr));
+      }
+    }
+    return true;
+  }
+
+  double median(std::vector<double> v)
+  {
+    if (v.empty())
+      return 0;
+    std::sort(v.begin(), v.end());
+    auto n = v.size();
+    return (n % 2 == 1) ? v[n / 2] : (v[(n / 2) - 1] + v[n / 2]) / 2;
+  }
+
+  /**
+   * Two-sided p-value of the Mann-Whitney U test that `a` and `b` come from
+   * the same distribution, by the normal approximation with a correction
+   * for ties and for continuity.
+   */
+  double
+  mann_whitney(const std::vector<double>& a, const std::vector<double>& b)
+  {
+    auto n1 = (double)a.size();
+    auto n2 = (double)b.size();
+    if ((n1 == 0) || (n2 == 0))
+      return 1;
+
+    std::vector<std::pair<double, bool>> all;
+    for (auto x : a)
+      all.push_back({x, true});
+    for (auto x : b)
+      all.push_back({x, false});
+    std::sort(all.begin(), all.end());
+
+    // Sum the ranks of `a`, giving tied values the mean of their ranks.
+    double rank_sum = 0;
+    double ties = 0;
+    for (size_t i = 0; i < all.size();)
+    {
+      size_t j = i;
+      while ((j < all.size()) && (all[j].first == all[i].first))
+        j++;
+      auto t = (double)(j - i);
+      auto rank = ((double)(i + 1) + (double)j) / 2;
+      for (size_t k = i; k < j; k++)
+      {
+        if (all[k].second)
+          rank_sum += rank;
+      }
+      ties += (t * t * t) - t;
+      i = j;
+    }
+
+    auto n = n1 + n2;
+    auto u = rank_sum - (n1 * (n1 + 1) / 2);
+    auto mean = n1 * n2 / 2;
+    auto var = (n1 * n2 / 12) * ((n + 1) - ties / (n * (n - 1)));
+    if (var <= 0)
+      return 1;
+
+    auto z = std::max(std::fabs(u - mean) - 0.5, 0.0) / std::sqrt(var);
+    return std::erfc(z / std::sqrt(2.0));
+  }
+}
+
+int main(int argc, char** argv)
+{
+  double threshold = 5;
+  double alpha = 0.05;
+  std::vector<const char*> files;
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "--threshold") == 0) && (i + 1 < argc))
+      threshold = std::atof(argv[++i]);
+    else if ((strcmp(argv[i], "--alpha") == 0) && (i + 1 < argc))
+      alpha = std::atof(argv[++i]);
+    else
+      files.push_back(argv[i]);
+  }
+
+  if (files.size() != 2)
+  {
+    std::cerr << "Usage: " << argv[0]
+              << " <base file> <new file> [--threshold percent] [--alpha p]"
+              << std::endl;
+    return 1;
+  }
+
+  std::map<std::string, Samples> base;
+  std::map<std::string, Samples> next;
+  for (size_t i = 0; i < 2; i++)
+  {
+    if (!read_results(files[i], i == 0 ? base : next))
+    {
+      std::cerr << "Cannot read " << files[i] << std::endl;
+      return 1;
+    }
+  }
+
+  size_t regressions = 0;
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Benchmark,Base median ns,New median ns,Change %,p,Verdict"
+            << std::endl;
+  for (auto& [id, b] : base)
+  {
+    auto it = next.find(id);
+    if (it == next.end())
+    {
+      std::cout << id << ",,,,,missing" << std::endl;
+      continue;
+    }
+
+    auto& n = it->second;
+    auto before = median(b.values());
+    auto after = median(n.values());
+    auto change = before == 0 ? 0 : 100 * (after - before) / before;
+
+    // Without samples on both sides, only the change can be reported.
+    bool sampled = !b.ns.empty() && !n.ns.empty();
+    auto p = sampled ? mann_whitney(b.ns, n.ns) : 1;
+
+    const char* verdict = "same";
+    if (!sampled)
+      verdict = "no samples";
+    else if ((p < alpha) && (change > threshold))
+    {
+      verdict = "REGRESSION";
+      regressions++;
+    }
+    else if ((p < alpha) && (change < -threshold))
+      verdict = "improved";
+
+    std::cout << id << "," << before << "," << after << "," << change << ","
+              << p << "," << verdict << std::endl;
+  }
+
+  for (auto& [id, n] : next)
+  {
+    if (base.find(id) == base.end())
+      std::cout << id << ",,,,,new" << std::endl;
+  }
+
+  std::cerr << regressions << " regression(s) beyond " << threshold
+            << "% at p < " << alpha << std::endl;
+  return regressions == 0 ? 0 : 1;
+}
@@ -0,0 +1,316 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Rebuilds the dependency graph of the behaviours in a trace written by
+ * `verona::rt::Trace::dump`, from its `Handoff` events, and reports
+ *
+ *   - the critical path: starting from the behaviour that finished last,
+ *     the chain of behaviours each made runnable by handing a cown to the
+ *     next, with the cown of each step, and
+ *   - for each cown, how many times it was handed from one behaviour to
+ *     another, how long the behaviours handing it on ran, which is the time
+ *     it serialised its successors, and how much of the critical path it
+ *     accounts for,
+ *
+ * so that the cown that serialises a pipeline can be found before it is
+ * split.
+ *
+ * Behaviours are identified by address, so each edge is matched to the
+ * predecessor that most recently started before it and the successor that
+ * next started after it.  Edges whose behaviours are not in the trace, for
+ * instance as they were overwritten in the ring, are dropped.
+ *
+ * Build with, for instance:
+ *
+ *   c++ -std=c++17 -O2 -I src/rt utils/tracedag/tracedag.cc
+ *
+ * Usage: tracedag <trace file>
+ */
+#include "debug/traceformat.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+using namespace verona::rt;
+
+namespace
+{
+  constexpr size_t NONE = SIZE_MAX;
+
+  struct Instance
+  {
+    uint64_t behaviour;
+    uint64_t start;
+    uint64_t end;
+    /// The edge that made this behaviour runnable, the last to arrive.
+    size_t last_in = NONE;
+  };
+
+  struct Edge
+  {
+    uint64_t cown;
+    uint64_t time;
+    size_t from;
+    size_t to;
+  };
+
+  struct RawEdge
+  {
+    uint64_t from;
+    uint64_t to;
+    uint64_t cown;
+    uint64_t time;
+  };
+
+  struct CownTotals
+  {
+    size_t handoffs = 0;
+    uint64_t serialised = 0;
+    size_t critical_steps = 0;
+    uint64_t critical = 0;
+  };
+
+  class Graph
+  {
+    std::vector<Instance> instances;
+    /// Instances of each behaviour address, in order of starting.
+    std::unordered_map<uint64_t, std::vector<size_t>> by_address;
+
+    /// The instance of `behaviour` that started last at or before `time`.
+    size_t started_before(uint64_t behaviour, uint64_t time)
+    {
+      auto it = by_address.find(behaviour);
+      if (it == by_address.end())
+        return NONE;
+      auto& v = it->second;
+      auto i = std::upper_bound(
+        v.begin(), v.end(), time, [this](uint64_t t, size_t index) {
+          return t < instances[index].start;
+        });
+      return (i == v.begin()) ? NONE : *(i - 1);
+    }
+
+    /// The instance of `behaviour` that started first at or after `time`.
+    size_t started_after(uint64_t behaviour, uint64_t time)
+    {
+      auto it = by_address.find(behaviour);
+      if (it == by_address.end())
+        return NONE;
+      auto& v = it->second;
+      auto i = std::lower_bound(
+        v.begin(), v.end(), time, [this](size_t index, uint64_t t) {
+          return instances[index].start < t;
+        });
+      return (i == v.end()) ? NONE : *i;
+    }
+
+  public:
+    std::vector<Edge> edges;
+
+    void build(std::vector<TraceThread>& threads)
+    {
+      std::vector<RawEdge> raw;
+
+      for (auto& t : threads)
+      {
+        // Behaviours running on this thread, innermost last.
+        std::vector<size_t> running;
+        uint64_t releasing = 0;
+        uint64_t cown = 0;
+
+        for (auto& e : t.events)
+        {
+          switch (e.kind)
+          {
+            case TraceKind::BehaviourStart:
+              running.push_back(instances.size());
+              instances.push_back({e.arg, e.time, e.time});
+              releasing = 0;
+              break;
+
+            case TraceKind::BehaviourEnd:
+              if (
+                !running.empty() &&
+                (instances[running.back()].behaviour == e.arg))
+              {
+                instances[running.back()].end = e.time;
+                running.pop_back();
+              }
+              break;
+
+            case TraceKind::Release:
+              releasing = e.arg;
+              cown = 0;
+              break;
+
+            case TraceKind::Handoff:
+              cown = e.arg;
+              break;
+
+            case TraceKind::HandoffTo:
+              if ((releasing != 0) && (cown != 0))
+                raw.push_back({releasing, e.arg, cown, e.time});
+              cown = 0;
+              break;
+
+            default:
+              break;
+          }
+        }
+      }
+
+      for (size_t i = 0; i < instances.size(); i++)
+        by_address[instances[i].behaviour].push_back(i);
+      for (auto& [address, v] : by_address)
+      {
+        std::sort(v.begin(), v.end(), [this](size_t a, size_t b) {
+          return instances[a].start < instances[b].start;
+        });
+      }
+
+      for (auto& r : raw)
+      {
+        auto from = started_before(r.from, r.time);
+        auto to = started_after(r.to, r.time);
+        if ((from == NONE) || (to == NONE) || (from == to))
+          continue;
+
+        auto index = edges.size();
+        edges.push_back({r.cown, r.time, from, to});
+        auto& last = instances[to].last_in;
+        if ((last == NONE) || (edges[last].time < r.time))
+          last = index;
+      }
+    }
+
+    const Instance& operator[](size_t i) const
+    {
+      return instances[i];
+    }
+
+    /**
+     * The critical path, as instances from the first to the one that
+     * finished last.
+     */
+    std::vector<size_t> critical_path() const
+    {
+      std::vector<size_t> path;
+      if (instances.empty())
+        return path;
+
+      size_t last = 0;
+      for (size_t i = 1; i < instances.size(); i++)
+      {
+        if (instances[i].end > instances[last].end)
+          last = i;
+      }
+
+      // Edges always go forward in time, but guard against torn events.
+      std::set<size_t> seen;
+      for (size_t i = last; (i != NONE) && seen.insert(i).second;)
+      {
+        path.push_back(i);
+        auto in = instances[i].last_in;
+        i = (in == NONE) ? NONE : edges[in].from;
+      }
+      std::reverse(path.begin(), path.end());
+      return path;
+    }
+  };
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <trace file>" << std::endl;
+    return 1;
+  }
+
+  std::ifstream in(argv[1], std::ios::binary);
+  TraceFileHeader header;
+  std::vector<TraceThread> threads;
+  if (!read_trace(in, header, threads))
+  {
+    std::cerr << argv[1] << " is not a whole Verona trace" << std::endl;
+    return 1;
+  }
+
+  auto us = [&header](uint64_t ticks) {
+    return (double)ticks / header.ticks_per_us;
+  };
+
+  Graph g;
+  g.build(threads);
+
+  std::map<uint64_t, CownTotals> cowns;
+  // A behaviour handing a cown to several readers serialised them once.
+  std::set<std::pair<uint64_t, size_t>> counted;
+  for (auto& e : g.edges)
+  {
+    auto& c = cowns[e.cown];
+    c.handoffs++;
+    if (counted.insert({e.cown, e.from}).second)
+      c.serialised += g[e.from].end - g[e.from].start;
+  }
+
+  auto path = g.critical_path();
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Critical path: " << path.size() << " behaviours";
+  if (!path.empty())
+  {
+    std::cout << ", " << us(g[path.back()].end - g[path.front()].start)
+              << " us";
+  }
+  std::cout << std::endl;
+  std::cout << "Behaviour,Cown,Start us,Run us,Wait us" << std::endl;
+
+  uint64_t origin = path.empty() ? 0 : g[path.front()].start;
+  for (auto i : path)
+  {
+    auto& b = g[i];
+    uint64_t cown = 0;
+    uint64_t wait = 0;
+    if (b.last_in != NONE)
+    {
+      auto& e = g.edges[b.last_in];
+      cown = e.cown;
+      // A writer that downgrades hands on readers before it ends.
+      if (b.start > g[e.from].end)
+        wait = b.start - g[e.from].end;
+      auto& c = cowns[cown];
+      c.critical_steps++;
+      c.critical += (b.end - b.start) + wait;
+    }
+    std::cout << "0x" << std::hex << b.behaviour << ",0x" << cown << std::dec
+              << "," << us(b.start - origin) << "," << us(b.end - b.start)
+              << "," << us(wait) << std::endl;
+  }
+
+  std::vector<std::pair<uint64_t, CownTotals>> sorted(
+    cowns.begin(), cowns.end());
+  std::sort(sorted.begin(), sorted.end(), [](auto& a, auto& b) {
+    if (a.second.critical != b.second.critical)
+      return a.second.critical > b.second.critical;
+    return a.second.serialised > b.second.serialised;
+  });
+
+  std::cout << std::endl
+            << "Cown,Handoffs,Serialised us,Critical steps,Critical us"
+            << std::endl;
+  for (auto& [cown, c] : sorted)
+  {
+    std::cout << "0x" << std::hex << cown << std::dec << "," << c.handoffs
+              << "," << us(c.serialised) << "," << c.critical_steps << ","
+              << us(c.critical) << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,151 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Converts a trace written by `verona::rt::Trace::dump` into Chrome trace
+ * JSON, which can be opened in Perfetto or chrome://tracing.
+ *
+ * Build with, for instance:
+ *
+ *   c++ -std=c++17 -O2 -I src/rt utils/tracedecode/tracedecode.cc
+ *
+ * Usage: tracedecode <trace file> [<json file>]
+ */
+#include "debug/traceformat.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace verona::rt;
+
+namespace
+{
+  /**
+   * The name of the span an event begins or ends, or nullptr if the event
+   * is an instant.
+   */
+  const char* span(TraceKind kind)
+  {
+    switch (kind)
+    {
+      case TraceKind::BehaviourStart:
+      case TraceKind::BehaviourEnd:
+        return "behaviour";
+      case TraceKind::GCStart:
+      case TraceKind::GCEnd:
+        return "gc";
+      default:
+        return nullptr;
+    }
+  }
+
+  bool is_begin(TraceKind kind)
+  {
+    return (kind == TraceKind::BehaviourStart) || (kind == TraceKind::GCStart);
+  }
+
+  const char* instant(TraceKind kind)
+  {
+    switch (kind)
+    {
+      case TraceKind::Runnable:
+        return "runnable";
+      case TraceKind::Steal:
+        return "steal";
+      case TraceKind::Pause:
+        return "pause";
+      case TraceKind::Unpause:
+        return "unpause";
+      case TraceKind::Release:
+        return "release";
+      case TraceKind::Handoff:
+        return "handoff";
+      case TraceKind::HandoffTo:
+        return "handoff to";
+      default:
+        return "unknown";
+    }
+  }
+
+  /// The name of the argument of an event.
+  const char* arg_name(TraceKind kind)
+  {
+    switch (kind)
+    {
+      case TraceKind::Steal:
+      case TraceKind::Pause:
+      case TraceKind::Unpause:
+        return "core";
+      case TraceKind::GCStart:
+      case TraceKind::GCEnd:
+        return "region";
+      case TraceKind::Handoff:
+        return "cown";
+      default:
+        return "behaviour";
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if ((argc < 2) || (argc > 3))
+  {
+    std::cerr << "Usage: " << argv[0] << " <trace file> [<json file>]"
+              << std::endl;
+    return 1;
+  }
+
+  std::ifstream in(argv[1], std::ios::binary);
+  TraceFileHeader header;
+  std::vector<TraceThread> threads;
+  if (!read_trace(in, header, threads))
+  {
+    std::cerr << argv[1] << " is not a whole Verona trace" << std::endl;
+    return 1;
+  }
+
+  uint64_t start = UINT64_MAX;
+  for (auto& t : threads)
+  {
+    if (!t.events.empty())
+      start = std::min(start, t.events.front().time);
+  }
+
+  std::ofstream file;
+  if (argc == 3)
+    file.open(argv[2]);
+  std::ostream& out = (argc == 3) ? file : std::cout;
+
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  for (auto& t : threads)
+  {
+    for (auto& e : t.events)
+    {
+      out << (first ? "\n" : ",\n");
+      first = false;
+
+      double ts = (double)(e.time - start) / header.ticks_per_us;
+      auto name = span(e.kind);
+      if (name != nullptr)
+      {
+        out << "{\"name\":\"" << name << "\",\"ph\":\""
+            << (is_begin(e.kind) ? "B" : "E") << "\"";
+      }
+      else
+      {
+        out << "{\"name\":\"" << instant(e.kind)
+            << "\",\"ph\":\"i\",\"s\":\"t\"";
+      }
+      out << ",\"ts\":" << ts << ",\"pid\":0,\"tid\":" << t.thread
+          << ",\"args\":{\"" << arg_name(e.kind) << "\":\"0x" << std::hex
+          << e.arg << std::dec << "\"}}";
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ns\"}" << std::endl;
+
+  return 0;
+}